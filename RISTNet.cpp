@@ -4,6 +4,8 @@
 
 #include "RISTNet.h"
 #include "RISTNetInternal.h"
+#include "RISTNetMockTransport.h"
+#include "RISTNetProbes.h"
 
 //---------------------------------------------------------------------------------------------------------------------
 //
@@ -23,7 +25,81 @@ bool RISTNetTools::isIPv6(const std::string &rStr) {
     return inet_pton(AF_INET6, rStr.c_str(), &(lsa.sin6_addr)) != 0;
 }
 
+bool RISTNetTools::isPort(const std::string &rPort) {
+    int32_t lPortNum = 0;
+    std::stringstream lPortNumStr(rPort);
+    lPortNumStr >> lPortNum;
+    if (lPortNum < 1 || lPortNum > UINT16_MAX) {
+        LOGGER(true, LOGG_ERROR, " " << "Provided Port number not valid.")
+        return false;
+    }
+    return true;
+}
+
 bool RISTNetTools::buildRISTURL(const std::string &lIP, const std::string &lPort, std::string &rURL, bool lListen) {
+    if (!isPort(lPort)) {
+        return false;
+    }
+    if (!isIPv4(lIP) && !isIPv6(lIP)) {
+        LOGGER(true, LOGG_ERROR, " " << "Provided IP-Address not valid.")
+        return false;
+    }
+    return buildAddressURL(lIP, lPort, rURL, lListen);
+}
+
+bool RISTNetTools::resolveRISTURL(const std::string &lHost, const std::string &lPort, std::string &rURL, bool lListen,
+                                  RISTNetResolver *pResolver) {
+    if (!isPort(lPort)) {
+        return false;
+    }
+    if (isIPv4(lHost) || isIPv6(lHost)) {
+        return buildAddressURL(lHost, lPort, rURL, lListen);
+    }
+    if (!RISTNetResolver::isHostName(lHost)) {
+        LOGGER(true, LOGG_ERROR, " " << "Provided host name not valid.")
+        return false;
+    }
+    RISTNetResolver::Resolution lResolution;
+    RISTNetResolver &rResolver = pResolver ? *pResolver : RISTNetResolver::globalResolver();
+    if (!rResolver.resolveBlocking(lHost, lResolution)) {
+        LOGGER(true, LOGG_ERROR, "Could not resolve " << lHost << ": " << lResolution.mError)
+        return false;
+    }
+    return buildAddressURL(lResolution.mAddresses.front(), lPort, rURL, lListen);
+}
+
+bool RISTNetTools::buildRISTURLs(const std::vector<std::tuple<std::string, std::string>> &rPeers,
+                                 std::vector<std::string> &rURLs, bool lListen, RISTNetResolver *pResolver) {
+    rURLs.clear();
+    std::vector<std::string> lHosts;
+    for (auto &rPeer: rPeers) {
+        if (!isPort(std::get<1>(rPeer))) {
+            return false;
+        }
+        lHosts.push_back(std::get<0>(rPeer));
+    }
+    std::vector<RISTNetResolver::Resolution> lResolutions;
+    RISTNetResolver &rResolver = pResolver ? *pResolver : RISTNetResolver::globalResolver();
+    if (!rResolver.resolveAll(lHosts, lResolutions)) {
+        for (auto &rResolution: lResolutions) {
+            if (rResolution.mAddresses.empty()) {
+                LOGGER(true, LOGG_ERROR, "Could not resolve " << rResolution.mHost << ": " << rResolution.mError)
+            }
+        }
+        return false;
+    }
+    rURLs.resize(rPeers.size());
+    for (size_t i = 0; i < rPeers.size(); i++) {
+        if (!buildAddressURL(lResolutions[i].mAddresses.front(), std::get<1>(rPeers[i]), rURLs[i], lListen)) {
+            rURLs.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RISTNetTools::buildAddressURL(const std::string &lIP, const std::string &lPort, std::string &rURL,
+                                   bool lListen) {
     int lIPType;
     if (isIPv4(lIP)) {
         lIPType = AF_INET;
@@ -33,13 +109,6 @@ bool RISTNetTools::buildRISTURL(const std::string &lIP, const std::string &lPort
         LOGGER(true, LOGG_ERROR, " " << "Provided IP-Address not valid.")
         return false;
     }
-    int32_t lPortNum = 0;
-    std::stringstream lPortNumStr(lPort);
-    lPortNumStr >> lPortNum;
-    if (lPortNum < 1 || lPortNum > UINT16_MAX) {
-        LOGGER(true, LOGG_ERROR, " " << "Provided Port number not valid.")
-        return false;
-    }
     std::string lRistURL{};
     if (lIPType == AF_INET) {
         lRistURL += "rist://";
@@ -72,10 +141,14 @@ RISTNetReceiver::RISTNetReceiver() {
                                            std::placeholders::_2);
     networkDataCallback = std::bind(&RISTNetReceiver::dataFromClientStub, this, std::placeholders::_1,
                                     std::placeholders::_2, std::placeholders::_3);
+    mEmptyConnection->mObject.reset();
     LOGGER(false, LOGG_NOTIFY, "RISTNetReceiver constructed")
 }
 
 RISTNetReceiver::~RISTNetReceiver() {
+    if (mMockTransport) {
+        destroyReceiver();
+    }
     if (mRistContext) {
         int lStatus = rist_destroy(mRistContext);
         if (lStatus) {
@@ -106,34 +179,206 @@ int RISTNetReceiver::dataFromClientStub(const uint8_t *pBuf, size_t lSize,
 
 int RISTNetReceiver::receiveData(void *pArg, rist_data_block *pDataBlock) {
     RISTNetReceiver *lWeakSelf = (RISTNetReceiver *) pArg;
-    std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
 
+    // Decompress the flows selected, every payload of them has the header. The payload lives until the next packet
+    // of the thread.
+    rist_data_block lDecompressedBlock;
+    if (lWeakSelf->mCompressor && lWeakSelf->mCompressor->isSelected(pDataBlock->flow_id)) {
+        thread_local std::vector<uint8_t> lDecompressed;
+        if (!lWeakSelf->mCompressor->decompress((const uint8_t *) pDataBlock->payload, pDataBlock->payload_len,
+                                                lDecompressed)) {
+            LOGGER(true, LOGG_ERROR, "Payload without a valid compression header, packet dropped.")
+            return -1;
+        }
+        lDecompressedBlock = *pDataBlock;
+        lDecompressedBlock.payload = lDecompressed.data();
+        lDecompressedBlock.payload_len = lDecompressed.size();
+        pDataBlock = &lDecompressedBlock;
+    }
+
+    // Re-insert the TS nulls the sender deleted, every payload has the header. The restored payload lives until the
+    // next packet of the thread.
+    rist_data_block lRestoredBlock;
+    if (lWeakSelf->mTsOptimizer) {
+        thread_local std::vector<uint8_t> lRestored;
+        if (!lWeakSelf->mTsOptimizer->restore((const uint8_t *) pDataBlock->payload, pDataBlock->payload_len,
+                                              lRestored)) {
+            LOGGER(true, LOGG_ERROR, "Payload without a valid TS optimizer header, packet dropped.")
+            return -1;
+        }
+        lRestoredBlock = *pDataBlock;
+        lRestoredBlock.payload = lRestored.data();
+        lRestoredBlock.payload_len = lRestored.size();
+        pDataBlock = &lRestoredBlock;
+    }
+
+    RISTNetProbeLock lLock(lWeakSelf->mClientListMtx, lWeakSelf, "receiveData");
+    uint64_t lProbeStart = RISTNET_PROBE_START(receive_data);
+
+    int lResult = -1;
+    bool lDropped = false;
     auto netObj = lWeakSelf->mClientListReceiver.find(pDataBlock->peer);
     if (netObj != lWeakSelf->mClientListReceiver.end()) {
         auto netCon = netObj->second;
-        return lWeakSelf->networkDataCallback((const uint8_t *) pDataBlock->payload, pDataBlock->payload_len, netCon, pDataBlock->peer, pDataBlock->flow_id);
+        if (lWeakSelf->mQueueEvents) {
+            NetworkEvent lEvent;
+            lEvent.mType = RISTNetEventType::kData;
+            if (!lWeakSelf->mMemorySession->reserveQueue(pDataBlock->payload_len)) {
+                // Over the queue limit of the memory governor
+                lDropped = true;
+            } else {
+                lEvent.mData = lWeakSelf->mPacketPool->copy((const uint8_t *) pDataBlock->payload, pDataBlock->payload_len);
+                if (!lEvent.mData) {
+                    LOGGER(true, LOGG_ERROR, "Packet pool exhausted, packet dropped.")
+                    lDropped = true;
+                } else {
+                    lEvent.mConnection = netCon;
+                    lEvent.pPeer = pDataBlock->peer;
+                    lEvent.mConnectionID = pDataBlock->flow_id;
+                    lDropped = !lWeakSelf->mEventQueue.push(std::move(lEvent), true);
+                }
+                if (lDropped) {
+                    lWeakSelf->mMemorySession->releaseQueue(pDataBlock->payload_len);
+                }
+            }
+            lResult = 0;
+        } else if (lWeakSelf->mWatchdog) {
+            lResult = lWeakSelf->watchData(*pDataBlock, netCon, lDropped);
+        } else {
+            lResult = lWeakSelf->deliverData(*pDataBlock, netCon, lDropped);
+        }
     } else {
         LOGGER(true, LOGG_ERROR, "receivesendDataData mClientListReceiver <-> peer mismatch.")
     }
-    return -1;
+    RISTNET_PROBE(receive_data, lWeakSelf, pDataBlock->peer, pDataBlock->flow_id, pDataBlock->payload_len,
+                  ristnetProbeSince(lProbeStart), lResult);
+
+    bool lError = lDropped || lResult != 0;
+    bool lDiscontinuity = pDataBlock->flags & RIST_DATA_FLAGS_DISCONTINUITY;
+    lWeakSelf->mFlowCounters.countPacket(pDataBlock->flow_id, pDataBlock->payload_len, lError, lDiscontinuity,
+                                         pDataBlock->seq);
+    lWeakSelf->mPeerCounters.countPacket((uintptr_t) pDataBlock->peer, pDataBlock->payload_len, lError,
+                                         lDiscontinuity);
+    return lResult;
+}
+
+int RISTNetReceiver::deliverData(const rist_data_block &rDataBlock, std::shared_ptr<NetworkConnection> &rConnection,
+                                 bool &rDropped) {
+    if (networkDataBlockCallback) {
+        return networkDataBlockCallback(rDataBlock, rConnection);
+    }
+    if (networkBufferCallback) {
+        RISTNetPacketBuffer lBuffer = mPacketPool->copy((const uint8_t *) rDataBlock.payload, rDataBlock.payload_len);
+        if (!lBuffer) {
+            LOGGER(true, LOGG_ERROR, "Packet pool exhausted, packet dropped.")
+            rDropped = true;
+            return 0;
+        }
+        return networkBufferCallback(lBuffer, rConnection, rDataBlock.peer, rDataBlock.flow_id);
+    }
+    return networkDataCallback((const uint8_t *) rDataBlock.payload, rDataBlock.payload_len, rConnection,
+                               rDataBlock.peer, rDataBlock.flow_id);
+}
+
+int RISTNetReceiver::watchData(const rist_data_block &rDataBlock, std::shared_ptr<NetworkConnection> &rConnection,
+                               bool &rDropped) {
+    using CallbackKind = RISTNetCallbackWatchdog::CallbackKind;
+    if (mWatchdog->isOffloaded(CallbackKind::kData, rDataBlock.peer)) {
+        // Copied, the payload of librist is only valid during the callback
+        RISTNetPacketBuffer lBuffer = mPacketPool->copy((const uint8_t *) rDataBlock.payload, rDataBlock.payload_len);
+        if (!lBuffer) {
+            LOGGER(true, LOGG_ERROR, "Packet pool exhausted, packet dropped.")
+            rDropped = true;
+            return 0;
+        }
+        rist_data_block lDataBlock = rDataBlock;
+        lDataBlock.ref = nullptr;
+        rDropped = !mWatchdog->offload(RISTNetCallbackWatchdog::makeTask(CallbackKind::kData,
+                [this, lDataBlock, lBuffer = std::move(lBuffer), lConnection = rConnection]() mutable {
+            lDataBlock.payload = lBuffer.data();
+            bool lDropped = false;
+            deliverData(lDataBlock, lConnection, lDropped);
+        }));
+        return 0;
+    }
+    auto lStart = std::chrono::steady_clock::now();
+    int lResult = deliverData(rDataBlock, rConnection, rDropped);
+    auto lNow = std::chrono::steady_clock::now();
+    mWatchdog->record(CallbackKind::kData, rDataBlock.peer, lNow - lStart, lNow);
+    return lResult;
+}
+
+void RISTNetReceiver::watchStatistics(const rist_stats &rStatistics) {
+    using CallbackKind = RISTNetCallbackWatchdog::CallbackKind;
+    if (mWatchdog->isOffloaded(CallbackKind::kStatistics, nullptr)) {
+        // Copied, librist frees the statistics after the callback
+        rist_stats lStatistics = rStatistics;
+        lStatistics.stats_json = nullptr;
+        std::string lJSON = rStatistics.stats_json ? rStatistics.stats_json : "";
+        mWatchdog->offload(RISTNetCallbackWatchdog::makeTask(CallbackKind::kStatistics,
+                [this, lStatistics, lJSON]() mutable {
+            if (!lJSON.empty()) {
+                lStatistics.stats_json = &lJSON[0];
+            }
+            statisticsCallback(lStatistics);
+        }));
+        return;
+    }
+    auto lStart = std::chrono::steady_clock::now();
+    statisticsCallback(rStatistics);
+    auto lNow = std::chrono::steady_clock::now();
+    mWatchdog->record(CallbackKind::kStatistics, nullptr, lNow - lStart, lNow);
 }
 
 int RISTNetReceiver::receiveOOBData(void *pArg, const rist_oob_block *pOOBBlock) {
     RISTNetReceiver *lWeakSelf = (RISTNetReceiver *) pArg;
-    if (lWeakSelf->networkOOBDataCallback) {  //This is a optional callback
-        if (lWeakSelf->mClientListReceiver.empty()) {
-            auto lEmptyContext = std::make_shared<NetworkConnection>(); //In this case we got no connections the NetworkConnection will contain a std::any == nullptr
-            lEmptyContext->mObject.reset();
-            lWeakSelf->networkOOBDataCallback((const uint8_t *) pOOBBlock->payload, pOOBBlock->payload_len, lEmptyContext, pOOBBlock->peer);
+    uint64_t lProbeStart = RISTNET_PROBE_START(receive_oob);
+    RISTNetProbeScope lProbe([&] {
+        RISTNET_PROBE(receive_oob, lWeakSelf, pOOBBlock->peer, pOOBBlock->payload_len, ristnetProbeSince(lProbeStart));
+    });
+    if (lWeakSelf->mQueueEvents) {
+        if (!lWeakSelf->mMemorySession->reserveQueue(pOOBBlock->payload_len)) {
+            // Over the queue limit of the memory governor
             return 0;
         }
-        std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
-        auto netObj = lWeakSelf->mClientListReceiver.find(pOOBBlock->peer);
-        if (netObj != lWeakSelf->mClientListReceiver.end()) {
-            auto netCon = netObj->second;
-            lWeakSelf->networkOOBDataCallback((const uint8_t *) pOOBBlock->payload, pOOBBlock->payload_len, netCon, pOOBBlock->peer);
+        NetworkEvent lEvent;
+        lEvent.mType = RISTNetEventType::kOOBData;
+        lEvent.mData = lWeakSelf->mPacketPool->copy((const uint8_t *) pOOBBlock->payload, pOOBBlock->payload_len);
+        if (!lEvent.mData) {
+            LOGGER(true, LOGG_ERROR, "Packet pool exhausted, OOB data dropped.")
+            lWeakSelf->mMemorySession->releaseQueue(pOOBBlock->payload_len);
             return 0;
         }
+        lEvent.pPeer = pOOBBlock->peer;
+        RISTNetProbeLock lLock(lWeakSelf->mClientListMtx, lWeakSelf, "receiveOOBData");
+        auto netObj = lWeakSelf->mClientListReceiver.find(pOOBBlock->peer);
+        lEvent.mConnection = netObj != lWeakSelf->mClientListReceiver.end() ? netObj->second : lWeakSelf->mEmptyConnection;
+        if (!lWeakSelf->mEventQueue.push(std::move(lEvent), true)) {
+            lWeakSelf->mMemorySession->releaseQueue(pOOBBlock->payload_len);
+        }
+        return 0;
+    }
+    if (lWeakSelf->networkOOBDataCallback) {  //This is a optional callback
+        std::shared_ptr<NetworkConnection> netCon;
+        {
+            RISTNetProbeLock lLock(lWeakSelf->mClientListMtx, lWeakSelf, "receiveOOBData");
+            auto netObj = lWeakSelf->mClientListReceiver.find(pOOBBlock->peer);
+            if (netObj != lWeakSelf->mClientListReceiver.end()) {
+                netCon = netObj->second;
+            } else if (lWeakSelf->mClientListReceiver.empty()) {
+                //In this case we got no connections the NetworkConnection will contain a std::any == nullptr
+                netCon = lWeakSelf->mEmptyConnection;
+            } else {
+                return 0;
+            }
+        }
+        // Not holding the lock, the callback may answer with sendOOBData
+        auto lStart = std::chrono::steady_clock::now();
+        lWeakSelf->networkOOBDataCallback((const uint8_t *) pOOBBlock->payload, pOOBBlock->payload_len, netCon, pOOBBlock->peer);
+        if (lWeakSelf->mWatchdog) {
+            lWeakSelf->mWatchdog->record(RISTNetCallbackWatchdog::CallbackKind::kOOBData, pOOBBlock->peer,
+                                         std::chrono::steady_clock::now() - lStart);
+        }
     }
     return 0;
 }
@@ -141,11 +386,27 @@ int RISTNetReceiver::receiveOOBData(void *pArg, const rist_oob_block *pOOBBlock)
 
 int RISTNetReceiver::clientConnect(void *pArg, const char* pConnectingIP, uint16_t lConnectingPort, const char* pIP, uint16_t lPort, rist_peer *pPeer) {
     RISTNetReceiver *lWeakSelf = (RISTNetReceiver *) pArg;
+    uint64_t lProbeStart = RISTNET_PROBE_START(client_connect);
+    auto lStart = std::chrono::steady_clock::now();
     auto lNetObj = lWeakSelf->validateConnectionCallback(std::string(pConnectingIP), lConnectingPort);
+    if (lWeakSelf->mWatchdog) {
+        lWeakSelf->mWatchdog->record(RISTNetCallbackWatchdog::CallbackKind::kValidate, pPeer,
+                                     std::chrono::steady_clock::now() - lStart);
+    }
+    RISTNET_PROBE(client_connect, lWeakSelf, pPeer, pConnectingIP, lConnectingPort, ristnetProbeSince(lProbeStart),
+                  (int) (lNetObj != nullptr));
     if (lNetObj) {
-        std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
+        RISTNetProbeLock lLock(lWeakSelf->mClientListMtx, lWeakSelf, "clientConnect");
 
         lWeakSelf->mClientListReceiver[pPeer] = lNetObj;
+        lWeakSelf->chargePeers();
+        if (lWeakSelf->mQueueEvents) {
+            NetworkEvent lEvent;
+            lEvent.mType = RISTNetEventType::kConnect;
+            lEvent.mConnection = lNetObj;
+            lEvent.pPeer = pPeer;
+            lWeakSelf->mEventQueue.push(std::move(lEvent), false);
+        }
         return 0; // Accept the connection
     }
     return -1; // Reject the connection
@@ -154,7 +415,7 @@ int RISTNetReceiver::clientConnect(void *pArg, const char* pConnectingIP, uint16
 int RISTNetReceiver::clientDisconnect(void *pArg, rist_peer *pPeer) {
     RISTNetReceiver *lWeakSelf = (RISTNetReceiver *) pArg;
     // TODO: closeAllClientConnections/closeClientConnection already holds this lock se we are stuck here. See STAR-255.
-    std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
+    RISTNetProbeLock lLock(lWeakSelf->mClientListMtx, lWeakSelf, "clientDisconnect");
     if (lWeakSelf->mClientListReceiver.empty()) {
         return 0;
     }
@@ -165,20 +426,50 @@ int RISTNetReceiver::clientDisconnect(void *pArg, rist_peer *pPeer) {
         return 0;
     }
 
-    if (lWeakSelf->clientDisconnectedCallback) {
+    uint64_t lProbeStart = RISTNET_PROBE_START(client_disconnect);
+    if (lWeakSelf->mQueueEvents) {
+        NetworkEvent lEvent;
+        lEvent.mType = RISTNetEventType::kDisconnect;
+        lEvent.mConnection = netObj->second;
+        lEvent.pPeer = pPeer;
+        lWeakSelf->mEventQueue.push(std::move(lEvent), false);
+    } else if (lWeakSelf->clientDisconnectedCallback) {
+        auto lStart = std::chrono::steady_clock::now();
         lWeakSelf->clientDisconnectedCallback(netObj->second, *pPeer);
+        if (lWeakSelf->mWatchdog) {
+            lWeakSelf->mWatchdog->record(RISTNetCallbackWatchdog::CallbackKind::kDisconnect, pPeer,
+                                         std::chrono::steady_clock::now() - lStart);
+        }
+    }
+    RISTNET_PROBE(client_disconnect, lWeakSelf, pPeer, ristnetProbeSince(lProbeStart));
+    if (lWeakSelf->mWatchdog) {
+        lWeakSelf->mWatchdog->forgetPeer(pPeer);
     }
 
     lWeakSelf->mClientListReceiver.erase(pPeer);
+    lWeakSelf->chargePeers();
     return 0;
 }
 
 int RISTNetReceiver::gotStatistics(void *pArg, const rist_stats *stats) {
     RISTNetReceiver *lWeakSelf = static_cast<RISTNetReceiver*>(pArg);
-    if (lWeakSelf->statisticsCallback) {
+    uint64_t lProbeStart = RISTNET_PROBE_START(statistics);
+    if (lWeakSelf->mQueueEvents) {
+        NetworkEvent lEvent;
+        lEvent.mType = RISTNetEventType::kStatistics;
+        lEvent.mStatistics = *stats;
+        lEvent.mStatistics.stats_json = nullptr;
+        if (stats->stats_json) {
+            lEvent.mStatisticsJSON = stats->stats_json;
+        }
+        lWeakSelf->mEventQueue.push(std::move(lEvent), false);
+    } else if (lWeakSelf->statisticsCallback && lWeakSelf->mWatchdog) {
+        lWeakSelf->watchStatistics(*stats);
+    } else if (lWeakSelf->statisticsCallback) {
         lWeakSelf->statisticsCallback(*stats);
     }
-    return rist_stats_free(stats);
+    RISTNET_PROBE(statistics, lWeakSelf, stats->stats_type, ristnetProbeSince(lProbeStart));
+    return lWeakSelf->mMockTransport ? 0 : rist_stats_free(stats);
 }
 
 //---------------------------------------------------------------------------------------------------------------------
@@ -202,7 +493,8 @@ bool RISTNetReceiver::closeClientConnection(rist_peer *lPeer) {
         return false;
     }
     mClientListReceiver.erase(lPeer);
-    int lStatus = rist_peer_destroy(mRistContext, lPeer);
+    chargePeers();
+    int lStatus = mMockTransport ? mMockTransport->closePeer(lPeer) : rist_peer_destroy(mRistContext, lPeer);
     if (lStatus) {
         LOGGER(true, LOGG_ERROR, "rist_receiver_peer_destroy failed: ")
         return false;
@@ -214,20 +506,101 @@ void RISTNetReceiver::closeAllClientConnections() {
     std::lock_guard<std::mutex> lLock(mClientListMtx);
     for (auto &rPeer: mClientListReceiver) {
         rist_peer *lPeer = rPeer.first;
-        int lStatus = rist_peer_destroy(mRistContext, lPeer);
+        int lStatus = mMockTransport ? mMockTransport->closePeer(lPeer) : rist_peer_destroy(mRistContext, lPeer);
         if (lStatus) {
             LOGGER(true, LOGG_ERROR, "rist_receiver_peer_destroy failed: ")
         }
     }
     mClientListReceiver.clear();
+    chargePeers();
+}
+
+int RISTNetReceiver::getEventFd() {
+    return mQueueEvents ? mEventQueue.getFd() : -1;
+}
+
+size_t RISTNetReceiver::drain(std::vector<NetworkEvent> &rEvents, size_t lMaxEvents) {
+    if (!mQueueEvents) {
+        rEvents.clear();
+        return 0;
+    }
+    size_t lDrained = mEventQueue.drain(rEvents, lMaxEvents);
+    size_t lBytes = 0;
+    for (auto &rEvent: rEvents) {
+        if (rEvent.mType == RISTNetEventType::kData || rEvent.mType == RISTNetEventType::kOOBData) {
+            lBytes += rEvent.mData.size();
+        }
+    }
+    mMemorySession->releaseQueue(lBytes);
+    return lDrained;
+}
+
+uint64_t RISTNetReceiver::getDroppedEvents() {
+    return mEventQueue.getDropped();
+}
+
+void RISTNetReceiver::getCounters(std::vector<RISTNetCounterSnapshot> &rFlows, std::vector<RISTNetCounterSnapshot> &rPeers) {
+    mFlowCounters.getCounters(rFlows);
+    mPeerCounters.getCounters(rPeers);
+}
+
+bool RISTNetReceiver::getTsStatistics(RISTNetTsOptimizer::TsOptimizerStatistics &rStatistics) {
+    if (!mTsOptimizer) {
+        return false;
+    }
+    mTsOptimizer->getStatistics(rStatistics);
+    return true;
+}
+
+bool RISTNetReceiver::getCompressionStatistics(RISTNetCompressor::CompressorStatistics &rStatistics) {
+    if (!mCompressor) {
+        return false;
+    }
+    mCompressor->getStatistics(rStatistics);
+    return true;
+}
+
+bool RISTNetReceiver::getCallbackHistograms(std::vector<RISTNetCallbackWatchdog::CallbackHistogram> &rHistograms) {
+    if (!mWatchdog) {
+        return false;
+    }
+    mWatchdog->getHistograms(rHistograms);
+    return true;
+}
+
+bool RISTNetReceiver::getWatchdogStatistics(RISTNetCallbackWatchdog::WatchdogStatistics &rStatistics) {
+    if (!mWatchdog) {
+        return false;
+    }
+    mWatchdog->getStatistics(rStatistics);
+    return true;
+}
+
+bool RISTNetReceiver::getMemoryUsage(RISTNetMemoryGovernor::SessionUsage &rUsage) {
+    if (!mMemorySession) {
+        return false;
+    }
+    mMemorySession->getGovernor().getUsage(*mMemorySession, rUsage);
+    return true;
 }
 
 bool RISTNetReceiver::destroyReceiver() {
-    if (mRistContext) {
-        int lStatus = rist_destroy(mRistContext);
+    uint64_t lProbeStart = RISTNET_PROBE_START(destroy_receiver);
+    RISTNetProbeScope lProbe([&] {
+        RISTNET_PROBE(destroy_receiver, this, ristnetProbeSince(lProbeStart));
+    });
+    if (mRistContext || mMockTransport) {
+        int lStatus = mRistContext ? rist_destroy(mRistContext) : 0;
         mRistContext = nullptr;
+        if (mMockTransport) {
+            mMockTransport->targetDestroyed();
+            mMockTransport = nullptr;
+        }
+        // Before the lock, the offloaded callbacks may take it
+        mWatchdog.reset();
         std::lock_guard<std::mutex> lLock(mClientListMtx);
         mClientListReceiver.clear();
+        releaseWrapper();
         if (lStatus) {
             LOGGER(true, LOGG_ERROR, "rist_receiver_destroy fail.")
             return false;
@@ -239,28 +612,118 @@ bool RISTNetReceiver::destroyReceiver() {
     return true;
 }
 
+bool RISTNetReceiver::initWrapper(RISTNetReceiverSettings &rSettings, const std::string &rName, size_t lPeers) {
+    mPacketPool = rSettings.mPacketPool ? rSettings.mPacketPool : &RISTNetPacketPool::defaultPool();
+
+    // Log settings, to RISTNetLog if started else to stderr
+    rist_logging_settings* lSettingsPtr = rSettings.mLogSetting.get();
+    int lStatus = RISTNetLog::globalLog().setupLibristLogging(&lSettingsPtr, rSettings.mLogLevel);
+    mLoggingScope.reset(lSettingsPtr);
+    if (lStatus) {
+        LOGGER(true, LOGG_ERROR, "rist_logging_set failed.")
+        return false;
+    }
+
+    // Account the recovery buffers and the event queue, the recovery length shortened to what was granted
+    releaseWrapper();
+    RISTNetMemoryGovernor *pGovernor = rSettings.mMemoryGovernor ? rSettings.mMemoryGovernor
+                                                                 : &RISTNetMemoryGovernor::globalGovernor();
+    size_t lRecoveryBytes = RISTNetMemoryGovernor::estimateRecoveryBytes(rSettings.mPeerConfig, lPeers);
+    if (!pGovernor->openSession(rName, lRecoveryBytes, rSettings.mEventQueueSize * RIST_MAX_PACKET_SIZE,
+                                mMemorySession, lPeers)) {
+        return false;
+    }
+    mConfiguredPeers = lPeers;
+    mRecoveryLengthMax = rSettings.mPeerConfig.recovery_length_max;
+    if (mMemorySession->getRecoveryGranted() < lRecoveryBytes) {
+        mRecoveryLengthMax = (uint32_t) ((uint64_t) mRecoveryLengthMax * mMemorySession->getRecoveryGranted() /
+                                         lRecoveryBytes);
+        // Shorter than the round trip nothing is recovered
+        if (mRecoveryLengthMax < std::max<uint32_t>(rSettings.mPeerConfig.recovery_rtt_min, 1)) {
+            LOGGER(true, LOGG_ERROR, "Memory budget leaves a recovery length of " << mRecoveryLengthMax
+                                     << " ms, under recovery_rtt_min.")
+            releaseWrapper();
+            return false;
+        }
+    }
+
+    // Events for drain() instead of the callbacks
+    if (rSettings.mEventQueueSize) {
+        if (!mEventQueue.initEventQueue(rSettings.mEventQueueSize)) {
+            LOGGER(true, LOGG_ERROR, "Event queue init failed.")
+            releaseWrapper();
+            return false;
+        }
+        mQueueEvents = true;
+    }
+
+    mTsOptimizer.reset();
+    if (rSettings.mTsNullReinsertion) {
+        mTsOptimizer = std::make_unique<RISTNetTsOptimizer>();
+    }
+
+    mCompressor.reset();
+    if (rSettings.mDecompress) {
+        mCompressor = std::make_unique<RISTNetCompressor>();
+        if (!mCompressor->initCompressor(rSettings.mDecompressorSettings)) {
+            LOGGER(true, LOGG_ERROR, "Decompressor init failed.")
+            mCompressor.reset();
+            releaseWrapper();
+            return false;
+        }
+    }
+
+    mWatchdog.reset();
+    if (rSettings.mCallbackWatchdog) {
+        mWatchdog = std::make_unique<RISTNetCallbackWatchdog>();
+        if (!mWatchdog->initWatchdog(rSettings.mWatchdogSettings)) {
+            releaseWrapper();
+            return false;
+        }
+        mWatchdog->offloadCallback = [this](const RISTNetCallbackWatchdog::WatchdogEvent &rEvent) {
+            if (watchdogCallback) {
+                watchdogCallback(rEvent);
+            }
+        };
+    }
+    return true;
+}
+
+void RISTNetReceiver::releaseWrapper() {
+    // Stops the offload thread, it may call into the receiver
+    mWatchdog.reset();
+    mQueueEvents = false;
+    mEventQueue.destroyEventQueue();
+    mMemorySession.reset();
+}
+
+void RISTNetReceiver::chargePeers() {
+    if (mMemorySession) {
+        mMemorySession->setPeers(std::max(mConfiguredPeers, mClientListReceiver.size()));
+    }
+}
+
 bool RISTNetReceiver::initReceiver(std::vector<std::string> &rURLList,
                                    RISTNetReceiver::RISTNetReceiverSettings &rSettings) {
+    uint64_t lProbeStart = RISTNET_PROBE_START(init_receiver);
+    // What is returned, set before the one successful return
+    bool lInitialised = false;
+    RISTNetProbeScope lProbe([&] {
+        RISTNET_PROBE(init_receiver, this, rURLList.size(), (int) lInitialised, ristnetProbeSince(lProbeStart));
+    });
     if (rURLList.empty()) {
         LOGGER(true, LOGG_ERROR, "URL list is empty.")
         return false;
     }
 
-    int lStatus;
-
-    // Default log settings
-    rist_logging_settings* lSettingsPtr = rSettings.mLogSetting.get();
-    lStatus = rist_logging_set(&lSettingsPtr, rSettings.mLogLevel, nullptr, nullptr, nullptr, stderr);
-    mLoggingScope.reset(lSettingsPtr);
-    if (lStatus) {
-        LOGGER(true, LOGG_ERROR, "rist_logging_set failed.")
+    if (!initWrapper(rSettings, rSettings.mCNAME.empty() ? rURLList.front() : rSettings.mCNAME, rURLList.size())) {
         return false;
     }
 
-
-    lStatus = rist_receiver_create(&mRistContext, rSettings.mProfile, rSettings.mLogSetting.get());
+    int lStatus = rist_receiver_create(&mRistContext, rSettings.mProfile, rSettings.mLogSetting.get());
     if (lStatus) {
         LOGGER(true, LOGG_ERROR, "rist_receiver_create fail.")
+        releaseWrapper();
         return false;
     }
     for (auto &rURL: rURLList) {
@@ -273,8 +736,8 @@ bool RISTNetReceiver::initReceiver(std::vector<std::string> &rURLList,
         mRistPeerConfig.recovery_mode = rSettings.mPeerConfig.recovery_mode;
         mRistPeerConfig.recovery_maxbitrate = rSettings.mPeerConfig.recovery_maxbitrate;
         mRistPeerConfig.recovery_maxbitrate_return = rSettings.mPeerConfig.recovery_maxbitrate_return;
-        mRistPeerConfig.recovery_length_min = rSettings.mPeerConfig.recovery_length_min;
-        mRistPeerConfig.recovery_length_max = rSettings.mPeerConfig.recovery_length_max;
+        mRistPeerConfig.recovery_length_min = std::min(rSettings.mPeerConfig.recovery_length_min, mRecoveryLengthMax);
+        mRistPeerConfig.recovery_length_max = mRecoveryLengthMax;
         mRistPeerConfig.recovery_rtt_min = rSettings.mPeerConfig.recovery_rtt_min;
         mRistPeerConfig.recovery_rtt_max = rSettings.mPeerConfig.recovery_rtt_max;
         mRistPeerConfig.weight = 5;
@@ -354,11 +817,12 @@ bool RISTNetReceiver::initReceiver(std::vector<std::string> &rURLList,
         destroyReceiver();
         return false;
     }
+    lInitialised = true;
     return true;
 }
 
 bool RISTNetReceiver::sendOOBData(rist_peer *pPeer, const uint8_t *pData, size_t lSize) {
-    if (!mRistContext) {
+    if (!mRistContext && !mMockTransport) {
         LOGGER(true, LOGG_ERROR, "RISTNetReceiver not initialised.")
         return false;
     }
@@ -368,7 +832,7 @@ bool RISTNetReceiver::sendOOBData(rist_peer *pPeer, const uint8_t *pData, size_t
     myOOBBlock.payload = pData;
     myOOBBlock.payload_len = lSize;
 
-    int lStatus = rist_oob_write(mRistContext, &myOOBBlock);
+    int lStatus = mMockTransport ? mMockTransport->writeOOBData(myOOBBlock) : rist_oob_write(mRistContext, &myOOBBlock);
     if (lStatus) {
         LOGGER(true, LOGG_ERROR, "rist_receiver_oob_write failed.")
         destroyReceiver();
@@ -394,10 +858,14 @@ void RISTNetReceiver::getVersion(uint32_t &rCppWrapper, uint32_t &rRistMajor, ui
 RISTNetSender::RISTNetSender() {
     validateConnectionCallback = std::bind(&RISTNetSender::validateConnectionStub, this, std::placeholders::_1,
                                            std::placeholders::_2);
+    mEmptyConnection->mObject.reset();
     LOGGER(false, LOGG_NOTIFY, "RISTNetSender constructed")
 }
 
 RISTNetSender::~RISTNetSender() {
+    if (mMockTransport) {
+        destroySender();
+    }
     if (mRistContext) {
         int lStatus = rist_destroy(mRistContext);
         if (lStatus) {
@@ -421,30 +889,69 @@ std::shared_ptr<RISTNetSender::NetworkConnection> RISTNetSender::validateConnect
 
 int RISTNetSender::receiveOOBData(void *pArg, const rist_oob_block *pOOBBlock) {
     RISTNetSender *lWeakSelf = (RISTNetSender *) pArg;
-    if (lWeakSelf->networkOOBDataCallback) {  //This is a optional callback
-        if (lWeakSelf->mClientListSender.empty()) {
-            auto lEmptyContext = std::make_shared<NetworkConnection>(); //In this case we got no connections the NetworkConnection will contain a std::any == nullptr
-            lEmptyContext->mObject.reset();
-            lWeakSelf->networkOOBDataCallback((const uint8_t *) pOOBBlock->payload, pOOBBlock->payload_len, lEmptyContext, pOOBBlock->peer);
+    uint64_t lProbeStart = RISTNET_PROBE_START(receive_oob);
+    RISTNetProbeScope lProbe([&] {
+        RISTNET_PROBE(receive_oob, lWeakSelf, pOOBBlock->peer, pOOBBlock->payload_len, ristnetProbeSince(lProbeStart));
+    });
+    if (lWeakSelf->mQueueEvents) {
+        if (!lWeakSelf->mMemorySession->reserveQueue(pOOBBlock->payload_len)) {
+            // Over the queue limit of the memory governor
             return 0;
         }
-        std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
-        auto netObj = lWeakSelf->mClientListSender.find(pOOBBlock->peer);
-        if (netObj != lWeakSelf->mClientListSender.end()) {
-            auto netCon = netObj->second;
-            lWeakSelf->networkOOBDataCallback((const uint8_t *) pOOBBlock->payload, pOOBBlock->payload_len, netCon, pOOBBlock->peer);
+        NetworkEvent lEvent;
+        lEvent.mType = RISTNetEventType::kOOBData;
+        lEvent.mData = lWeakSelf->mPacketPool->copy((const uint8_t *) pOOBBlock->payload, pOOBBlock->payload_len);
+        if (!lEvent.mData) {
+            LOGGER(true, LOGG_ERROR, "Packet pool exhausted, OOB data dropped.")
+            lWeakSelf->mMemorySession->releaseQueue(pOOBBlock->payload_len);
             return 0;
         }
+        lEvent.pPeer = pOOBBlock->peer;
+        RISTNetProbeLock lLock(lWeakSelf->mClientListMtx, lWeakSelf, "receiveOOBData");
+        auto netObj = lWeakSelf->mClientListSender.find(pOOBBlock->peer);
+        lEvent.mConnection = netObj != lWeakSelf->mClientListSender.end() ? netObj->second : lWeakSelf->mEmptyConnection;
+        if (!lWeakSelf->mEventQueue.push(std::move(lEvent), true)) {
+            lWeakSelf->mMemorySession->releaseQueue(pOOBBlock->payload_len);
+        }
+        return 0;
+    }
+    if (lWeakSelf->networkOOBDataCallback) {  //This is a optional callback
+        std::shared_ptr<NetworkConnection> netCon;
+        {
+            RISTNetProbeLock lLock(lWeakSelf->mClientListMtx, lWeakSelf, "receiveOOBData");
+            auto netObj = lWeakSelf->mClientListSender.find(pOOBBlock->peer);
+            if (netObj != lWeakSelf->mClientListSender.end()) {
+                netCon = netObj->second;
+            } else if (lWeakSelf->mClientListSender.empty()) {
+                //In this case we got no connections the NetworkConnection will contain a std::any == nullptr
+                netCon = lWeakSelf->mEmptyConnection;
+            } else {
+                return 0;
+            }
+        }
+        // Not holding the lock, the callback may answer with sendOOBData
+        lWeakSelf->networkOOBDataCallback((const uint8_t *) pOOBBlock->payload, pOOBBlock->payload_len, netCon, pOOBBlock->peer);
     }
     return 0;
 }
 
 int RISTNetSender::clientConnect(void *pArg, const char* pConnectingIP, uint16_t lConnectingPort, const char* pIP, uint16_t lPort, rist_peer *pPeer) {
     RISTNetSender *lWeakSelf = (RISTNetSender *) pArg;
+    uint64_t lProbeStart = RISTNET_PROBE_START(client_connect);
     auto lNetObj = lWeakSelf->validateConnectionCallback(std::string(pConnectingIP), lConnectingPort);
+    RISTNET_PROBE(client_connect, lWeakSelf, pPeer, pConnectingIP, lConnectingPort, ristnetProbeSince(lProbeStart),
+                  (int) (lNetObj != nullptr));
     if (lNetObj) {
-        std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
+        RISTNetProbeLock lLock(lWeakSelf->mClientListMtx, lWeakSelf, "clientConnect");
         lWeakSelf->mClientListSender[pPeer] = lNetObj;
+        lWeakSelf->chargePeers();
+        if (lWeakSelf->mQueueEvents) {
+            NetworkEvent lEvent;
+            lEvent.mType = RISTNetEventType::kConnect;
+            lEvent.mConnection = lNetObj;
+            lEvent.pPeer = pPeer;
+            lWeakSelf->mEventQueue.push(std::move(lEvent), false);
+        }
         return 0; // Accept the connection
     }
     return -1; // Reject the connection
@@ -452,7 +959,7 @@ int RISTNetSender::clientConnect(void *pArg, const char* pConnectingIP, uint16_t
 
 int RISTNetSender::clientDisconnect(void *pArg, rist_peer *pPeer) {
     RISTNetSender *lWeakSelf = (RISTNetSender *) pArg;
-    std::lock_guard<std::mutex> lLock(lWeakSelf->mClientListMtx);
+    RISTNetProbeLock lLock(lWeakSelf->mClientListMtx, lWeakSelf, "clientDisconnect");
     if (lWeakSelf->mClientListSender.empty()) {
         return 0;
     }
@@ -463,20 +970,43 @@ int RISTNetSender::clientDisconnect(void *pArg, rist_peer *pPeer) {
         return 0;
     }
 
-    if (lWeakSelf->clientDisconnectedCallback) {
+    uint64_t lProbeStart = RISTNET_PROBE_START(client_disconnect);
+    if (lWeakSelf->mQueueEvents) {
+        NetworkEvent lEvent;
+        lEvent.mType = RISTNetEventType::kDisconnect;
+        lEvent.mConnection = netObj->second;
+        lEvent.pPeer = pPeer;
+        lWeakSelf->mEventQueue.push(std::move(lEvent), false);
+    } else if (lWeakSelf->clientDisconnectedCallback) {
         lWeakSelf->clientDisconnectedCallback(netObj->second, *pPeer);
     }
+    RISTNET_PROBE(client_disconnect, lWeakSelf, pPeer, ristnetProbeSince(lProbeStart));
 
     lWeakSelf->mClientListSender.erase(pPeer);
+    lWeakSelf->chargePeers();
     return 0;
 }
 
 int RISTNetSender::gotStatistics(void *pArg, const rist_stats *stats) {
     RISTNetSender *lWeakSelf = static_cast<RISTNetSender*>(pArg);
-    if (lWeakSelf->statisticsCallback) {
+    uint64_t lProbeStart = RISTNET_PROBE_START(statistics);
+    if (lWeakSelf->mCongestionMonitor && stats->stats_type == RIST_STATS_SENDER_PEER) {
+        lWeakSelf->mCongestionMonitor->pushStatistics(stats->stats.sender_peer);
+    }
+    if (lWeakSelf->mQueueEvents) {
+        NetworkEvent lEvent;
+        lEvent.mType = RISTNetEventType::kStatistics;
+        lEvent.mStatistics = *stats;
+        lEvent.mStatistics.stats_json = nullptr;
+        if (stats->stats_json) {
+            lEvent.mStatisticsJSON = stats->stats_json;
+        }
+        lWeakSelf->mEventQueue.push(std::move(lEvent), false);
+    } else if (lWeakSelf->statisticsCallback) {
         lWeakSelf->statisticsCallback(*stats);
     }
-    return rist_stats_free(stats);
+    RISTNET_PROBE(statistics, lWeakSelf, stats->stats_type, ristnetProbeSince(lProbeStart));
+    return lWeakSelf->mMockTransport ? 0 : rist_stats_free(stats);
 }
 
 //---------------------------------------------------------------------------------------------------------------------
@@ -499,7 +1029,8 @@ bool RISTNetSender::closeClientConnection(rist_peer *lPeer) {
         return false;
     }
     mClientListSender.erase(lPeer);
-    int lStatus = rist_peer_destroy(mRistContext, lPeer);
+    chargePeers();
+    int lStatus = mMockTransport ? mMockTransport->closePeer(lPeer) : rist_peer_destroy(mRistContext, lPeer);
     if (lStatus) {
         LOGGER(true, LOGG_ERROR, "rist_sender_peer_destroy failed: ")
         return false;
@@ -507,24 +1038,172 @@ bool RISTNetSender::closeClientConnection(rist_peer *lPeer) {
     return true;
 }
 
+bool RISTNetSender::addPeer(const std::string &rURL, int lWeight) {
+    std::lock_guard<std::mutex> lLock(mPeerMtx);
+    if (!mRistContext && !mMockTransport) {
+        LOGGER(true, LOGG_ERROR, "RIST Sender not running.")
+        return false;
+    }
+    if (mPeers.count(rURL)) {
+        LOGGER(true, LOGG_ERROR, "Peer already added: " << rURL)
+        return false;
+    }
+    return createPeer(rURL, lWeight);
+}
+
+bool RISTNetSender::removePeer(const std::string &rURL) {
+    std::lock_guard<std::mutex> lLock(mPeerMtx);
+    auto lIterator = mPeers.find(rURL);
+    if (lIterator == mPeers.end()) {
+        LOGGER(true, LOGG_ERROR, "Could not find peer: " << rURL)
+        return false;
+    }
+    rist_peer *pPeer = lIterator->second;
+    mPeers.erase(lIterator);
+    {
+        std::lock_guard<std::mutex> lClientLock(mClientListMtx);
+        mClientListSender.erase(pPeer);
+    }
+    countPeers();
+    int lStatus = mMockTransport ? mMockTransport->closePeer(pPeer) : rist_peer_destroy(mRistContext, pPeer);
+    if (lStatus) {
+        LOGGER(true, LOGG_ERROR, "rist_sender_peer_destroy failed: " << rURL)
+        return false;
+    }
+    return true;
+}
+
+bool RISTNetSender::createPeer(const std::string &rURL, int lWeight) {
+    rist_peer *pPeer = nullptr;
+    if (mMockTransport) {
+        mMockTransport->createPeer(rURL, &pPeer);
+        mPeers[rURL] = pPeer;
+        countPeers();
+        return true;
+    }
+
+    mRistPeerConfig = mPeerDefaults;
+    mRistPeerConfig.weight = lWeight;
+    rist_peer_config* lTmp = &mRistPeerConfig;
+    int lStatus = rist_parse_address2(rURL.c_str(), &lTmp);
+    if (lStatus)
+    {
+        LOGGER(true, LOGG_ERROR, "rist_parse_address fail: " << rURL)
+        return false;
+    }
+
+    lStatus =  rist_peer_create(mRistContext, &pPeer, &mRistPeerConfig);
+    if (lStatus) {
+        LOGGER(true, LOGG_ERROR, "rist_sender_peer_create fail: " << rURL)
+        return false;
+    }
+    mPeers[rURL] = pPeer;
+    countPeers();
+    return true;
+}
+
+void RISTNetSender::countPeers() {
+    std::lock_guard<std::mutex> lLock(mClientListMtx);
+    mConfiguredPeers = mPeers.size();
+    chargePeers();
+}
+
 void RISTNetSender::closeAllClientConnections() {
     std::lock_guard<std::mutex> lLock(mClientListMtx);
     for (auto &rPeer: mClientListSender) {
         rist_peer *pPeer = rPeer.first;
-        int status = rist_peer_destroy(mRistContext, pPeer);
+        int status = mMockTransport ? mMockTransport->closePeer(pPeer) : rist_peer_destroy(mRistContext, pPeer);
         if (status) {
             LOGGER(true, LOGG_ERROR, "rist_sender_peer_destroy failed: ")
         }
     }
     mClientListSender.clear();
+    chargePeers();
+}
+
+int RISTNetSender::getEventFd() {
+    return mQueueEvents ? mEventQueue.getFd() : -1;
+}
+
+size_t RISTNetSender::drain(std::vector<NetworkEvent> &rEvents, size_t lMaxEvents) {
+    if (!mQueueEvents) {
+        rEvents.clear();
+        return 0;
+    }
+    size_t lDrained = mEventQueue.drain(rEvents, lMaxEvents);
+    size_t lBytes = 0;
+    for (auto &rEvent: rEvents) {
+        if (rEvent.mType == RISTNetEventType::kOOBData) {
+            lBytes += rEvent.mData.size();
+        }
+    }
+    mMemorySession->releaseQueue(lBytes);
+    return lDrained;
+}
+
+uint64_t RISTNetSender::getDroppedEvents() {
+    return mEventQueue.getDropped();
+}
+
+void RISTNetSender::getCounters(std::vector<RISTNetCounterSnapshot> &rFlows) {
+    mFlowCounters.getCounters(rFlows);
+}
+
+bool RISTNetSender::getTsStatistics(RISTNetTsOptimizer::TsOptimizerStatistics &rStatistics) {
+    if (!mTsOptimizer) {
+        return false;
+    }
+    mTsOptimizer->getStatistics(rStatistics);
+    return true;
+}
+
+bool RISTNetSender::getCompressionStatistics(RISTNetCompressor::CompressorStatistics &rStatistics) {
+    if (!mCompressor) {
+        return false;
+    }
+    mCompressor->getStatistics(rStatistics);
+    return true;
+}
+
+bool RISTNetSender::getMemoryUsage(RISTNetMemoryGovernor::SessionUsage &rUsage) {
+    if (!mMemorySession) {
+        return false;
+    }
+    mMemorySession->getGovernor().getUsage(*mMemorySession, rUsage);
+    return true;
+}
+
+bool RISTNetSender::getCongestion(RISTNetCongestionMonitor::CongestionSnapshot &rSnapshot) {
+    if (!mCongestionMonitor) {
+        return false;
+    }
+    mCongestionMonitor->getSnapshot(rSnapshot);
+    return true;
+}
+
+uint64_t RISTNetSender::getTargetBitrate() {
+    return mCongestionMonitor ? mCongestionMonitor->getTargetBitrate() : 0;
 }
 
 bool RISTNetSender::destroySender() {
-    if (mRistContext) {
-        int lStatus = rist_destroy(mRistContext);
+    uint64_t lProbeStart = RISTNET_PROBE_START(destroy_sender);
+    RISTNetProbeScope lProbe([&] {
+        RISTNET_PROBE(destroy_sender, this, ristnetProbeSince(lProbeStart));
+    });
+    if (mRistContext || mMockTransport) {
+        int lStatus = mRistContext ? rist_destroy(mRistContext) : 0;
         mRistContext = nullptr;
+        if (mMockTransport) {
+            mMockTransport->targetDestroyed();
+            mMockTransport = nullptr;
+        }
+        {
+            std::lock_guard<std::mutex> lLock(mPeerMtx);
+            mPeers.clear();
+        }
         std::lock_guard<std::mutex> lLock(mClientListMtx);
         mClientListSender.clear();
+        releaseWrapper();
         if (lStatus) {
             LOGGER(true, LOGG_ERROR, "rist_sender_destroy fail.")
             return false;
@@ -535,75 +1214,167 @@ bool RISTNetSender::destroySender() {
     return true;
 }
 
-bool RISTNetSender::initSender(std::vector<std::tuple<std::string,int>> &rPeerList,
-                               RISTNetSenderSettings &rSettings) {
+bool RISTNetSender::initWrapper(RISTNetSenderSettings &rSettings, const std::string &rName, size_t lPeers) {
+    mPacketPool = rSettings.mPacketPool ? rSettings.mPacketPool : &RISTNetPacketPool::defaultPool();
 
-    if (rPeerList.empty()) {
-        LOGGER(true, LOGG_ERROR, "URL list is empty.")
-        return false;
-    }
-
-    int lStatus;
-    // Default log settings
+    // Log settings, to RISTNetLog if started else to stderr
     rist_logging_settings* lSettingsPtr = rSettings.mLogSetting.get();
-    lStatus = rist_logging_set(&lSettingsPtr, rSettings.mLogLevel, nullptr, nullptr, nullptr, stderr);
+    int lStatus = RISTNetLog::globalLog().setupLibristLogging(&lSettingsPtr, rSettings.mLogLevel);
     mLoggingScope.reset(lSettingsPtr);
     if (lStatus) {
         LOGGER(true, LOGG_ERROR, "rist_logging_set failed.")
         return false;
     }
 
-    lStatus = rist_sender_create(&mRistContext, rSettings.mProfile, 0, rSettings.mLogSetting.get());
-    if (lStatus) {
-        LOGGER(true, LOGG_ERROR, "rist_sender_create fail.")
+    // Account the recovery buffers and the event queue, the recovery length shortened to what was granted
+    releaseWrapper();
+    RISTNetMemoryGovernor *pGovernor = rSettings.mMemoryGovernor ? rSettings.mMemoryGovernor
+                                                                 : &RISTNetMemoryGovernor::globalGovernor();
+    size_t lRecoveryBytes = RISTNetMemoryGovernor::estimateRecoveryBytes(rSettings.mPeerConfig, lPeers);
+    if (!pGovernor->openSession(rName, lRecoveryBytes, rSettings.mEventQueueSize * RIST_MAX_PACKET_SIZE,
+                                mMemorySession, lPeers)) {
         return false;
     }
-    for (auto &rPeerInfo: rPeerList) {
-
-        auto peerURL = std::get<0>(rPeerInfo);
+    mConfiguredPeers = lPeers;
+    mRecoveryLengthMax = rSettings.mPeerConfig.recovery_length_max;
+    if (mMemorySession->getRecoveryGranted() < lRecoveryBytes) {
+        mRecoveryLengthMax = (uint32_t) ((uint64_t) mRecoveryLengthMax * mMemorySession->getRecoveryGranted() /
+                                         lRecoveryBytes);
+        // Shorter than the round trip nothing is recovered
+        if (mRecoveryLengthMax < std::max<uint32_t>(rSettings.mPeerConfig.recovery_rtt_min, 1)) {
+            LOGGER(true, LOGG_ERROR, "Memory budget leaves a recovery length of " << mRecoveryLengthMax
+                                     << " ms, under recovery_rtt_min.")
+            releaseWrapper();
+            return false;
+        }
+    }
 
-        int keysize = 0;
-        if (!rSettings.mPSK.empty()) {
-            keysize = 128;
+    // Events for drain() instead of the callbacks
+    if (rSettings.mEventQueueSize) {
+        if (!mEventQueue.initEventQueue(rSettings.mEventQueueSize)) {
+            LOGGER(true, LOGG_ERROR, "Event queue init failed.")
+            releaseWrapper();
+            return false;
         }
-        mRistPeerConfig.version = RIST_PEER_CONFIG_VERSION;
-        mRistPeerConfig.virt_dst_port = RIST_DEFAULT_VIRT_DST_PORT;
-        mRistPeerConfig.recovery_mode = rSettings.mPeerConfig.recovery_mode;
-        mRistPeerConfig.recovery_maxbitrate = rSettings.mPeerConfig.recovery_maxbitrate;
-        mRistPeerConfig.recovery_maxbitrate_return = rSettings.mPeerConfig.recovery_maxbitrate_return;
-        mRistPeerConfig.recovery_length_min = rSettings.mPeerConfig.recovery_length_min;
-        mRistPeerConfig.recovery_length_max = rSettings.mPeerConfig.recovery_length_max;
-        mRistPeerConfig.recovery_rtt_min = rSettings.mPeerConfig.recovery_rtt_min;
-        mRistPeerConfig.recovery_rtt_max = rSettings.mPeerConfig.recovery_rtt_max;
-        mRistPeerConfig.weight = std::get<1>(rPeerInfo);
-        mRistPeerConfig.congestion_control_mode = rSettings.mPeerConfig.congestion_control_mode;
-        mRistPeerConfig.min_retries = rSettings.mPeerConfig.min_retries;
-        mRistPeerConfig.max_retries = rSettings.mPeerConfig.max_retries;
-        mRistPeerConfig.session_timeout = rSettings.mSessionTimeout;
-        mRistPeerConfig.keepalive_interval =  rSettings.mKeepAliveInterval;
-        mRistPeerConfig.key_size = keysize;
+        mQueueEvents = true;
+    }
 
-        if (keysize) {
-            strncpy((char *) &mRistPeerConfig.secret[0], rSettings.mPSK.c_str(), 128);
+    mTsOptimizer.reset();
+    if (rSettings.mTsOptimize) {
+        mTsOptimizer = std::make_unique<RISTNetTsOptimizer>();
+        if (!mTsOptimizer->initOptimizer(rSettings.mTsOptimizerSettings)) {
+            LOGGER(true, LOGG_ERROR, "TS optimizer init failed.")
+            mTsOptimizer.reset();
+            releaseWrapper();
+            return false;
         }
+    }
 
-        if (!rSettings.mCNAME.empty()) {
-            strncpy((char *) &mRistPeerConfig.cname[0], rSettings.mCNAME.c_str(), 128);
+    mCompressor.reset();
+    if (rSettings.mCompress) {
+        mCompressor = std::make_unique<RISTNetCompressor>();
+        if (!mCompressor->initCompressor(rSettings.mCompressorSettings)) {
+            LOGGER(true, LOGG_ERROR, "Compressor init failed.")
+            mCompressor.reset();
+            releaseWrapper();
+            return false;
         }
+    }
 
-        rist_peer_config* lTmp = &mRistPeerConfig;
-        lStatus = rist_parse_address2(peerURL.c_str(), &lTmp);
-        if (lStatus)
-        {
-            LOGGER(true, LOGG_ERROR, "rist_parse_address fail: " << peerURL)
-            destroySender();
+    mCongestionMonitor.reset();
+    mStatisticsInterval = std::chrono::milliseconds(1000);
+    if (rSettings.mCongestionFeedback) {
+        mCongestionMonitor = std::make_unique<RISTNetCongestionMonitor>();
+        if (!mCongestionMonitor->initMonitor(rSettings.mCongestionSettings)) {
+            LOGGER(true, LOGG_ERROR, "Congestion monitor init failed.")
+            mCongestionMonitor.reset();
+            releaseWrapper();
             return false;
         }
+        mCongestionMonitor->congestionCallback = [this](const RISTNetCongestionMonitor::CongestionSnapshot &rSnapshot) {
+            if (congestionCallback) {
+                congestionCallback(rSnapshot);
+            }
+        };
+        mStatisticsInterval = rSettings.mCongestionSettings.mInterval;
+    }
+    return true;
+}
 
-        rist_peer *peer;
-        lStatus =  rist_peer_create(mRistContext, &peer, &mRistPeerConfig);
-        if (lStatus) {
-            LOGGER(true, LOGG_ERROR, "rist_sender_peer_create fail: " << peerURL)
+void RISTNetSender::releaseWrapper() {
+    mQueueEvents = false;
+    mEventQueue.destroyEventQueue();
+    mMemorySession.reset();
+}
+
+void RISTNetSender::chargePeers() {
+    if (mMemorySession) {
+        mMemorySession->setPeers(std::max(mConfiguredPeers, mClientListSender.size()));
+    }
+}
+
+bool RISTNetSender::initSender(std::vector<std::tuple<std::string,int>> &rPeerList,
+                               RISTNetSenderSettings &rSettings) {
+    uint64_t lProbeStart = RISTNET_PROBE_START(init_sender);
+    // What is returned, set before the one successful return
+    bool lInitialised = false;
+    RISTNetProbeScope lProbe([&] {
+        RISTNET_PROBE(init_sender, this, rPeerList.size(), (int) lInitialised, ristnetProbeSince(lProbeStart));
+    });
+
+    if (rPeerList.empty()) {
+        LOGGER(true, LOGG_ERROR, "URL list is empty.")
+        return false;
+    }
+
+    if (!initWrapper(rSettings, rSettings.mCNAME.empty() ? std::get<0>(rPeerList.front()) : rSettings.mCNAME,
+                     rPeerList.size())) {
+        return false;
+    }
+
+    int lStatus = rist_sender_create(&mRistContext, rSettings.mProfile, 0, rSettings.mLogSetting.get());
+    if (lStatus) {
+        LOGGER(true, LOGG_ERROR, "rist_sender_create fail.")
+        releaseWrapper();
+        return false;
+    }
+
+    int keysize = 0;
+    if (!rSettings.mPSK.empty()) {
+        keysize = 128;
+    }
+    mPeerDefaults = rist_peer_config{};
+    mPeerDefaults.version = RIST_PEER_CONFIG_VERSION;
+    mPeerDefaults.virt_dst_port = RIST_DEFAULT_VIRT_DST_PORT;
+    mPeerDefaults.recovery_mode = rSettings.mPeerConfig.recovery_mode;
+    mPeerDefaults.recovery_maxbitrate = rSettings.mPeerConfig.recovery_maxbitrate;
+    mPeerDefaults.recovery_maxbitrate_return = rSettings.mPeerConfig.recovery_maxbitrate_return;
+    mPeerDefaults.recovery_length_min = std::min(rSettings.mPeerConfig.recovery_length_min, mRecoveryLengthMax);
+    mPeerDefaults.recovery_length_max = mRecoveryLengthMax;
+    mPeerDefaults.recovery_rtt_min = rSettings.mPeerConfig.recovery_rtt_min;
+    mPeerDefaults.recovery_rtt_max = rSettings.mPeerConfig.recovery_rtt_max;
+    mPeerDefaults.congestion_control_mode = rSettings.mPeerConfig.congestion_control_mode;
+    mPeerDefaults.min_retries = rSettings.mPeerConfig.min_retries;
+    mPeerDefaults.max_retries = rSettings.mPeerConfig.max_retries;
+    mPeerDefaults.session_timeout = rSettings.mSessionTimeout;
+    mPeerDefaults.keepalive_interval =  rSettings.mKeepAliveInterval;
+    mPeerDefaults.key_size = keysize;
+
+    if (keysize) {
+        strncpy((char *) &mPeerDefaults.secret[0], rSettings.mPSK.c_str(), 128);
+    }
+
+    if (!rSettings.mCNAME.empty()) {
+        strncpy((char *) &mPeerDefaults.cname[0], rSettings.mCNAME.c_str(), 128);
+    }
+
+    for (auto &rPeerInfo: rPeerList) {
+        bool lCreated;
+        {
+            std::lock_guard<std::mutex> lLock(mPeerMtx);
+            lCreated = createPeer(std::get<0>(rPeerInfo), std::get<1>(rPeerInfo));
+        }
+        if (!lCreated) {
             destroySender();
             return false;
         }
@@ -632,7 +1403,7 @@ bool RISTNetSender::initSender(std::vector<std::tuple<std::string,int>> &rPeerLi
         return false;
     }
 
-    lStatus = rist_stats_callback_set(mRistContext, 1000, gotStatistics, this);
+    lStatus = rist_stats_callback_set(mRistContext, (int) mStatisticsInterval.count(), gotStatistics, this);
     if (lStatus) {
         LOGGER(true, LOGG_ERROR, "rist_stats_callback_set fail.")
         destroySender();
@@ -646,11 +1417,12 @@ bool RISTNetSender::initSender(std::vector<std::tuple<std::string,int>> &rPeerLi
         return false;
     }
 
+    lInitialised = true;
     return true;
 }
 
 bool RISTNetSender::sendData(const uint8_t *pData, size_t lSize, uint16_t lConnectionID) {
-    if (!mRistContext) {
+    if (!mRistContext && !mMockTransport) {
         LOGGER(true, LOGG_ERROR, "RISTNetSender not initialised.")
         return false;
     }
@@ -660,7 +1432,33 @@ bool RISTNetSender::sendData(const uint8_t *pData, size_t lSize, uint16_t lConne
     myRISTDataBlock.payload_len = lSize;
     myRISTDataBlock.flow_id = lConnectionID;
 
-    int lStatus = rist_sender_data_write(mRistContext, &myRISTDataBlock);
+    // Without the TS nulls, retransmissions included. Every payload gets the header, optimized or not.
+    thread_local std::vector<uint8_t> lOptimized;
+    if (mTsOptimizer) {
+        mTsOptimizer->optimize(pData, lSize, lOptimized);
+        myRISTDataBlock.payload = lOptimized.data();
+        myRISTDataBlock.payload_len = lSize = lOptimized.size();
+    }
+
+    // Compressed once, retransmissions send the compressed payload
+    thread_local std::vector<uint8_t> lCompressed;
+    if (mCompressor && mCompressor->compress((const uint8_t *) myRISTDataBlock.payload, lSize, lConnectionID,
+                                             lCompressed)) {
+        myRISTDataBlock.payload = lCompressed.data();
+        myRISTDataBlock.payload_len = lSize = lCompressed.size();
+    }
+
+    if (mCongestionMonitor) {
+        mCongestionMonitor->countOffered(1);
+    }
+    uint64_t lProbeStart = RISTNET_PROBE_START(send_data);
+    int lStatus = mMockTransport ? mMockTransport->writeData(myRISTDataBlock)
+                                 : rist_sender_data_write(mRistContext, &myRISTDataBlock);
+    RISTNET_PROBE(send_data, this, lConnectionID, lSize, ristnetProbeSince(lProbeStart), lStatus);
+    {
+        std::lock_guard<std::mutex> lLock(mFlowCountersMtx);
+        mFlowCounters.countPacket(lConnectionID, lStatus > 0 ? lStatus : 0, (size_t) lStatus != lSize);
+    }
     if (lStatus < 0) {
         LOGGER(true, LOGG_ERROR, "rist_client_write failed.")
         destroySender();
@@ -675,8 +1473,12 @@ bool RISTNetSender::sendData(const uint8_t *pData, size_t lSize, uint16_t lConne
     return true;
 }
 
+bool RISTNetSender::sendData(const RISTNetPacketBuffer &rBuffer, uint16_t lConnectionID) {
+    return sendData(rBuffer.data(), rBuffer.size(), lConnectionID);
+}
+
 bool RISTNetSender::sendOOBData(rist_peer *pPeer, const uint8_t *pData, size_t lSize) {
-    if (!mRistContext) {
+    if (!mRistContext && !mMockTransport) {
         LOGGER(true, LOGG_ERROR, "RISTNetSender not initialised.")
         return false;
     }
@@ -686,7 +1488,7 @@ bool RISTNetSender::sendOOBData(rist_peer *pPeer, const uint8_t *pData, size_t l
     myOOBBlock.payload = pData;
     myOOBBlock.payload_len = lSize;
 
-    int lStatus = rist_oob_write(mRistContext, &myOOBBlock);
+    int lStatus = mMockTransport ? mMockTransport->writeOOBData(myOOBBlock) : rist_oob_write(mRistContext, &myOOBBlock);
     if (lStatus) {
         LOGGER(true, LOGG_ERROR, "rist_sender_oob_write failed.")
         destroySender();
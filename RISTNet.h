@@ -15,6 +15,16 @@
 
 #include "librist.h"
 #include "version.h"
+#include "RISTNetPacketPool.h"
+#include "RISTNetLog.h"
+#include "RISTNetEventQueue.h"
+#include "RISTNetCounters.h"
+#include "RISTNetTsOptimizer.h"
+#include "RISTNetCompressor.h"
+#include "RISTNetCongestionMonitor.h"
+#include "RISTNetMemoryGovernor.h"
+#include "RISTNetResolver.h"
+#include "RISTNetCallbackWatchdog.h"
 #include <string.h>
 #include <any>
 #include <tuple>
@@ -34,6 +44,11 @@
 #include <arpa/inet.h>
 #endif
 
+// Test seam, replaces librist for a receiver or sender (RISTNetMockTransport.h)
+class RISTNetMockTransport;
+// Records from the data callback with the pool of the receiver (RISTNetTrace.h)
+class RISTNetTraceRecorder;
+
 
 
 /**
@@ -46,8 +61,38 @@
  */
 class RISTNetTools {
 public:
-    /// Build the librist url based on name/ip, port and if it's a listen or not peer
+    /// Build the librist url based on ip, port and if it's a listen or not peer.
     static bool buildRISTURL(const std::string &lIP, const std::string &lPort, std::string &rURL, bool lListen);
+
+    /**
+     * @brief Build the librist url of a peer given by name or ip
+     *
+     * Blocks the calling thread on DNS when the name is not in the cache of the resolver (up to its query timeout),
+     * do not call it from a librist callback. The first address is used.
+     *
+     * @param the name/ip of the peer
+     * @param the port of the peer
+     * @param the url
+     * @param listen or not
+     * @param the resolver, nullptr for RISTNetResolver::globalResolver()
+     * @return true if the url was built
+     */
+    static bool resolveRISTURL(const std::string &lHost, const std::string &lPort, std::string &rURL, bool lListen,
+                               RISTNetResolver *pResolver = nullptr);
+
+    /**
+     * @brief Build the librist urls of many peers
+     *
+     * The names are resolved in parallel, for the peer lists of many senders and receivers at once.
+     *
+     * @param the name/ip and port of the peers
+     * @param the urls, in the order of the peers
+     * @param listen or not
+     * @param the resolver, nullptr for RISTNetResolver::globalResolver()
+     * @return true if every url was built
+     */
+    static bool buildRISTURLs(const std::vector<std::tuple<std::string, std::string>> &rPeers,
+                              std::vector<std::string> &rURLs, bool lListen, RISTNetResolver *pResolver = nullptr);
 private:
 
     /// This class cannot be instantiated
@@ -55,6 +100,9 @@ private:
 
     static bool isIPv4(const std::string &rStr);
     static bool isIPv6(const std::string &rStr);
+    static bool isPort(const std::string &rPort);
+    // The url of a numeric address
+    static bool buildAddressURL(const std::string &lIP, const std::string &lPort, std::string &rURL, bool lListen);
 };
 
 //---------------------------------------------------------------------------------------------------------------------
@@ -90,6 +138,24 @@ public:
         std::any mObject = nullptr; //Contains your object
     };
 
+    /**
+     * \class NetworkEvent
+     *
+     * \brief
+     *
+     * A event queued for drain() when the settings have mEventQueueSize set.
+     *
+     */
+    struct NetworkEvent {
+        RISTNetEventType mType = RISTNetEventType::kConnect;
+        std::shared_ptr<NetworkConnection> mConnection;   // May hold a empty object for OOB data without connections
+        rist_peer *pPeer = nullptr;                       // Identifies the peer, not to be dereferenced after kDisconnect
+        uint16_t mConnectionID = 0;                       // kData
+        RISTNetPacketBuffer mData;                        // kOOBData and kData
+        rist_stats mStatistics{};                         // kStatistics, stats_json is nullptr
+        std::string mStatisticsJSON;                      // kStatistics
+    };
+
 
     struct RISTNetReceiverSettings {
       RISTNetReceiverSettings() {
@@ -119,6 +185,14 @@ public:
     int mSessionTimeout = 5000;
     int mKeepAliveInterval = 10000;
     int mMaxjitter = 0;
+    RISTNetPacketPool *mPacketPool = nullptr; // Pool for networkBufferCallback and events, nullptr is RISTNetPacketPool::defaultPool()
+    size_t mEventQueueSize = 0; // Max data events queued for drain() instead of the callbacks, 0 uses the callbacks
+    bool mTsNullReinsertion = false; // Restore the payloads of a sender with mTsOptimize, re-inserting the nulls, all of them have the header
+    bool mDecompress = false; // Decompress the payloads of a sender with mCompress before the data callbacks
+    RISTNetCompressor::RISTNetCompressorSettings mDecompressorSettings; // Used with mDecompress, mFlows as the sender's
+    RISTNetMemoryGovernor *mMemoryGovernor = nullptr; // Accounts the buffers, nullptr is RISTNetMemoryGovernor::globalGovernor()
+    bool mCallbackWatchdog = false; // Measure the callbacks against a time budget, offload the slow data and statistics callbacks
+    RISTNetCallbackWatchdog::RISTNetCallbackWatchdogSettings mWatchdogSettings; // Used with mCallbackWatchdog
 
   };
 
@@ -179,6 +253,59 @@ public:
    */
   bool sendOOBData(rist_peer *pPeer, const uint8_t *pData, size_t lSize);
 
+  /**
+   * @brief The event file descriptor
+   *
+   * A eventfd readable while events are queued, to be polled by epoll or io_uring.
+   * Valid from initReceiver until destroyReceiver when the settings have mEventQueueSize set.
+   *
+   * @return the file descriptor, -1 if the events are not queued
+   */
+  int getEventFd();
+
+  /**
+   * @brief Drain the queued events
+   *
+   * Does not block. Replaces the content of rEvents with the queued events in the order they happened.
+   * When the settings have mEventQueueSize set the data, OOB data, disconnect and statistics callbacks are not
+   * called, the events are queued instead. validateConnectionCallback is still called on the librist thread to
+   * accept a connection, a kConnect event follows if accepted.
+   *
+   * @param the events
+   * @param the max events returned, the eventfd stays readable if more are queued
+   * @return the number of events
+   */
+  size_t drain(std::vector<NetworkEvent> &rEvents, size_t lMaxEvents = SIZE_MAX);
+
+  /// Data events dropped because mEventQueueSize data events were queued
+  uint64_t getDroppedEvents();
+
+  /**
+   * @brief The data path counters
+   *
+   * Counted in the librist receive thread for every packet, before the librist statistics of the next second.
+   * Lock-free, each flow and peer is a consistent snapshot. Peers are keyed by the rist_peer pointer.
+   *
+   * @param the counters per flow_id, with the sequence gaps and reordered packets at the callback
+   * @param the counters per peer
+   */
+  void getCounters(std::vector<RISTNetCounterSnapshot> &rFlows, std::vector<RISTNetCounterSnapshot> &rPeers);
+
+  /// Get the null re-insertion statistics, false if the settings do not have mTsNullReinsertion
+  bool getTsStatistics(RISTNetTsOptimizer::TsOptimizerStatistics &rStatistics);
+
+  /// Get the decompression statistics, false if the settings do not have mDecompress
+  bool getCompressionStatistics(RISTNetCompressor::CompressorStatistics &rStatistics);
+
+  /// Get the recovery buffers granted and the event queue use accounted by the memory governor, false if not initialised
+  bool getMemoryUsage(RISTNetMemoryGovernor::SessionUsage &rUsage);
+
+  /// Get the durations of the callbacks measured by the watchdog, false without mCallbackWatchdog
+  bool getCallbackHistograms(std::vector<RISTNetCallbackWatchdog::CallbackHistogram> &rHistograms);
+
+  /// Get the violations and the offload queue of the watchdog, false without mCallbackWatchdog
+  bool getWatchdogStatistics(RISTNetCallbackWatchdog::WatchdogStatistics &rStatistics);
+
   /**
    * @brief Destroys the receiver
    *
@@ -209,6 +336,32 @@ public:
   std::function<int(const uint8_t *pBuf, size_t lSize, std::shared_ptr<NetworkConnection> &rConnection, rist_peer *pPeer, uint16_t lConnectionID)>
       networkDataCallback = nullptr;
 
+  /**
+   * @brief Data block receive callback (__NULLABLE)
+   *
+   * Same as networkDataCallback but you get the complete librist data block, meaning you also get the
+   * RIST sequence number, the NTP timestamp and the flags of the packet.
+   * If set it is called instead of networkDataCallback.
+   *
+   * @param function getting data from the sender.
+   * @return 0 to keep the connection else -1.
+   */
+  std::function<int(const rist_data_block &rDataBlock, std::shared_ptr<NetworkConnection> &rConnection)>
+      networkDataBlockCallback = nullptr;
+
+  /**
+   * @brief Data buffer receive callback (__NULLABLE)
+   *
+   * Same as networkDataCallback but the data is delivered in a packet buffer from the packet pool of the
+   * settings. Move the buffer to keep the payload past the callback without copying it again.
+   * If set it is called instead of networkDataCallback.
+   *
+   * @param function getting data from the sender.
+   * @return 0 to keep the connection else -1.
+   */
+  std::function<int(RISTNetPacketBuffer &rBuffer, std::shared_ptr<NetworkConnection> &rConnection, rist_peer *pPeer, uint16_t lConnectionID)>
+      networkBufferCallback = nullptr;
+
   /**
    * @brief OOB Data receive callback (__NULLABLE)
    *
@@ -242,6 +395,18 @@ public:
   /// Callback for statistics, called once every second
   std::function<void(const rist_stats& statistics)> statisticsCallback = nullptr;
 
+  /**
+   * @brief Watchdog callback (__NULLABLE)
+   *
+   * With mCallbackWatchdog, called when the data callback of a peer or the statistics callback went over budget
+   * too often and is offloaded. From then on the data of the peer (the statistics) are copied and the callback is
+   * called from the offload thread, concurrently with the data callbacks of the other peers, and its return value
+   * is ignored. Called from the offload thread.
+   *
+   * @param the callback offloaded
+   */
+  std::function<void(const RISTNetCallbackWatchdog::WatchdogEvent &rEvent)> watchdogCallback = nullptr;
+
   // Delete copy and move constructors and assign operators
   RISTNetReceiver(RISTNetReceiver const &) = delete;             // Copy construct
   RISTNetReceiver(RISTNetReceiver &&) = delete;                  // Move construct
@@ -250,9 +415,21 @@ public:
 
 private:
 
+  friend class RISTNetMockTransport;
+  friend class RISTNetTraceRecorder;
+
   std::shared_ptr<NetworkConnection> validateConnectionStub(std::string lIPAddress, uint16_t lPort);
   int dataFromClientStub(const uint8_t *pBuf, size_t lSize, std::shared_ptr<NetworkConnection> &rConnection);
 
+  // The wrapper side of initReceiver (packet pool, logging, event queue and memory session of lPeers peers)
+  bool initWrapper(RISTNetReceiverSettings &rSettings, const std::string &rName, size_t lPeers);
+
+  // Releases what initWrapper set up, when the init fails or the receiver is destroyed
+  void releaseWrapper();
+
+  // Accounts the recovery buffers of the URLs or of the clients connected if more, mClientListMtx held
+  void chargePeers();
+
   // Private method receiving the data from librist C-API
   static int receiveData(void *pArg, rist_data_block *data_block);
 
@@ -268,6 +445,13 @@ private:
   // Private method called when a statistics are delivered
   static int gotStatistics(void *pArg, const rist_stats *stats);
 
+  // Calls the data callback set
+  int deliverData(const rist_data_block &rDataBlock, std::shared_ptr<NetworkConnection> &rConnection, bool &rDropped);
+
+  // The callbacks measured by mWatchdog, or queued for the offload thread
+  int watchData(const rist_data_block &rDataBlock, std::shared_ptr<NetworkConnection> &rConnection, bool &rDropped);
+  void watchStatistics(const rist_stats &rStatistics);
+
   // The context of a RIST receiver
   rist_ctx *mRistContext = nullptr;
 
@@ -276,12 +460,42 @@ private:
 
   // The mutex protecting the list. since the list can be accessed from both librist and the C++ layer
   std::mutex mClientListMtx;
+  // Given to the OOB callbacks for peers without connection (mObject empty), allocated once
+  std::shared_ptr<NetworkConnection> mEmptyConnection = std::make_shared<NetworkConnection>();
 
   // The list of connected clients
   std::map<rist_peer *, std::shared_ptr<NetworkConnection>> mClientListReceiver;
 
   std::unique_ptr<rist_logging_settings, decltype(&free)> mLoggingScope{nullptr, &free};
 
+  // The pool of networkBufferCallback and the events
+  RISTNetPacketPool *mPacketPool = nullptr;
+
+  // The events for drain(), used if mQueueEvents. Set before the librist context is created, read by its callbacks
+  RISTNetEventQueue<NetworkEvent> mEventQueue;
+  std::atomic<bool> mQueueEvents{false};
+
+  // Written by receiveData under mClientListMtx
+  RISTNetCounterTable mFlowCounters;
+  RISTNetCounterTable mPeerCounters;
+
+  // Set with mTsNullReinsertion
+  std::unique_ptr<RISTNetTsOptimizer> mTsOptimizer;
+
+  // Set with mDecompress
+  std::unique_ptr<RISTNetCompressor> mCompressor;
+
+  // Set with mCallbackWatchdog
+  std::unique_ptr<RISTNetCallbackWatchdog> mWatchdog;
+
+  // The account in the memory governor, the recovery length fitting what it granted
+  std::unique_ptr<RISTNetMemorySession> mMemorySession;
+  uint32_t mRecoveryLengthMax = 0;
+  size_t mConfiguredPeers = 0;
+
+  // Set when a RISTNetMockTransport drives the receiver instead of librist
+  RISTNetMockTransport *mMockTransport = nullptr;
+
 };
 
 //---------------------------------------------------------------------------------------------------------------------
@@ -317,6 +531,23 @@ public:
         std::any mObject = nullptr; //Contains your object
     };
 
+    /**
+     * \class NetworkEvent
+     *
+     * \brief
+     *
+     * A event queued for drain() when the settings have mEventQueueSize set.
+     *
+     */
+    struct NetworkEvent {
+        RISTNetEventType mType = RISTNetEventType::kConnect;
+        std::shared_ptr<NetworkConnection> mConnection;   // May hold a empty object for OOB data without connections
+        rist_peer *pPeer = nullptr;                       // Identifies the peer, not to be dereferenced after kDisconnect
+        RISTNetPacketBuffer mData;                        // kOOBData
+        rist_stats mStatistics{};                         // kStatistics, stats_json is nullptr
+        std::string mStatisticsJSON;                      // kStatistics
+    };
+
   struct RISTNetSenderSettings {
       RISTNetSenderSettings() {
           mPeerConfig.version = RIST_PEER_CONFIG_VERSION;
@@ -345,6 +576,15 @@ public:
     uint32_t mSessionTimeout = 5000;
     uint32_t mKeepAliveInterval = 10000;
     int mMaxJitter = 0;
+    RISTNetPacketPool *mPacketPool = nullptr; // Pool for the OOB data events, nullptr is RISTNetPacketPool::defaultPool()
+    size_t mEventQueueSize = 0; // Max OOB data events queued for drain() instead of the callbacks, 0 uses the callbacks
+    bool mTsOptimize = false; // Delete the TS null packets before sending, the receivers need mTsNullReinsertion
+    RISTNetTsOptimizer::RISTNetTsOptimizerSettings mTsOptimizerSettings; // Used with mTsOptimize
+    bool mCompress = false; // LZ4 compress the payloads of the flows selected, the receivers need mDecompress
+    RISTNetCompressor::RISTNetCompressorSettings mCompressorSettings; // Used with mCompress
+    bool mCongestionFeedback = false; // Target bitrate for the encoder, statistics every mCongestionSettings.mInterval
+    RISTNetCongestionMonitor::RISTNetCongestionSettings mCongestionSettings; // Used with mCongestionFeedback
+    RISTNetMemoryGovernor *mMemoryGovernor = nullptr; // Accounts the buffers, nullptr is RISTNetMemoryGovernor::globalGovernor()
    };
 
   /// Constructor
@@ -395,6 +635,22 @@ public:
    */
   void closeAllClientConnections();
 
+  /**
+   * @brief Add a peer
+   *
+   * Adds a peer to the running sender, for example when a watched name (RISTNetResolver::watch) resolves to a
+   * new address. The settings of initSender apply. The peer is charged to the memory session like the peers of
+   * initSender, removePeer releases the charge.
+   *
+   * @param RIST formated URL
+   * @param the weight, see initSender
+   * @return true on success, false if the URL is a peer already
+   */
+  bool addPeer(const std::string &rURL, int lWeight);
+
+  /// Remove a peer of initSender or addPeer by its URL
+  bool removePeer(const std::string &rURL);
+
   /**
    * @brief Send data
    *
@@ -407,6 +663,17 @@ public:
    */
   bool sendData(const uint8_t *pData, size_t lSize, uint16_t lConnectionID=0);
 
+  /**
+   * @brief Send data
+   *
+   * Sends the data of a packet buffer to the connected peers
+   *
+   * @param the packet buffer
+   * @param a optional uint16_t value sent to the receiver
+   *
+   */
+  bool sendData(const RISTNetPacketBuffer &rBuffer, uint16_t lConnectionID=0);
+
   /**
   * @brief Send OOB data (Currently not working in librist)
   *
@@ -420,6 +687,58 @@ public:
   */
   bool sendOOBData(rist_peer *pPeer, const uint8_t *pData, size_t lSize);
 
+  /**
+   * @brief The event file descriptor
+   *
+   * A eventfd readable while events are queued, to be polled by epoll or io_uring.
+   * Valid from initSender until destroySender when the settings have mEventQueueSize set.
+   *
+   * @return the file descriptor, -1 if the events are not queued
+   */
+  int getEventFd();
+
+  /**
+   * @brief Drain the queued events
+   *
+   * Does not block. Replaces the content of rEvents with the queued events in the order they happened.
+   * When the settings have mEventQueueSize set the OOB data, disconnect and statistics callbacks are not
+   * called, the events are queued instead. validateConnectionCallback is still called on the librist thread to
+   * accept a connection, a kConnect event follows if accepted.
+   *
+   * @param the events
+   * @param the max events returned, the eventfd stays readable if more are queued
+   * @return the number of events
+   */
+  size_t drain(std::vector<NetworkEvent> &rEvents, size_t lMaxEvents = SIZE_MAX);
+
+  /// Data events dropped because mEventQueueSize data events were queued
+  uint64_t getDroppedEvents();
+
+  /**
+   * @brief The data path counters
+   *
+   * Counted by sendData per connection ID (flow), also when sendData is called from many threads.
+   * Lock-free, each flow is a consistent snapshot.
+   *
+   * @param the counters per flow
+   */
+  void getCounters(std::vector<RISTNetCounterSnapshot> &rFlows);
+
+  /// Get the TS optimizer statistics, mBytesIn - mBytesOut is the bandwidth saved. False without mTsOptimize.
+  bool getTsStatistics(RISTNetTsOptimizer::TsOptimizerStatistics &rStatistics);
+
+  /// Get the compression statistics, ratio and time spent compressing. False without mCompress.
+  bool getCompressionStatistics(RISTNetCompressor::CompressorStatistics &rStatistics);
+
+  /// Get the recovery buffers granted and the event queue use accounted by the memory governor, false if not initialised
+  bool getMemoryUsage(RISTNetMemoryGovernor::SessionUsage &rUsage);
+
+  /// Get the last congestion evaluation, false without mCongestionFeedback
+  bool getCongestion(RISTNetCongestionMonitor::CongestionSnapshot &rSnapshot);
+
+  /// The target bitrate (bps) for the encoder, lock free. 0 without mCongestionFeedback.
+  uint64_t getTargetBitrate();
+
   /**
    * @brief Destroys the sender
    *
@@ -467,9 +786,12 @@ public:
   /// Callback handling disconnecting clients
   std::function<void(const std::shared_ptr<NetworkConnection>&, const rist_peer&)> clientDisconnectedCallback = nullptr;
 
-  /// Callback for statistics, called once every second
+  /// Callback for statistics, called once every second (every mCongestionSettings.mInterval with mCongestionFeedback)
   std::function<void(const rist_stats& statistics)> statisticsCallback = nullptr;
 
+  /// Callback for the encoder when the target bitrate changes, with mCongestionFeedback. Called from librist.
+  std::function<void(const RISTNetCongestionMonitor::CongestionSnapshot &rSnapshot)> congestionCallback = nullptr;
+
   // Delete copy and move constructors and assign operators
   RISTNetSender(RISTNetSender const &) = delete;             // Copy construct
   RISTNetSender(RISTNetSender &&) = delete;                  // Move construct
@@ -478,9 +800,20 @@ public:
 
 private:
 
+  friend class RISTNetMockTransport;
+
   std::shared_ptr<NetworkConnection> validateConnectionStub(const std::string &ipAddress, uint16_t port);
   void dataFromClientStub(const uint8_t *pBuf, size_t lSize, std::shared_ptr<NetworkConnection> &rConnection);
 
+  // The wrapper side of initSender (logging, event queue and memory session of lPeers peers)
+  bool initWrapper(RISTNetSenderSettings &rSettings, const std::string &rName, size_t lPeers);
+
+  // Releases what initWrapper set up, when the init fails or the sender is destroyed
+  void releaseWrapper();
+
+  // Accounts the recovery buffers of the peers created or of the clients connected if more, mClientListMtx held
+  void chargePeers();
+
   // Private method receiving OOB data from librist C-API
   static int receiveOOBData(void *pArg, const rist_oob_block *pOOBBlock);
 
@@ -499,14 +832,58 @@ private:
   // The configuration of the RIST sender
   rist_peer_config mRistPeerConfig{};
 
+  // Creates the peer of a URL from mPeerDefaults, mPeerMtx held
+  bool createPeer(const std::string &rURL, int lWeight);
+
+  // mConfiguredPeers from mPeers, charged, mPeerMtx held
+  void countPeers();
+
+  // The peer configuration of initSender, the URL and weight set per peer
+  rist_peer_config mPeerDefaults{};
+
+  // The mutex protecting the peers created and mRistPeerConfig
+  std::mutex mPeerMtx;
+  std::map<std::string, rist_peer *> mPeers;
+
   // The mutex protecting the list. since the list can be accessed from both librist and the C++ layer
   std::mutex mClientListMtx;
+  // Given to the OOB callbacks for peers without connection (mObject empty), allocated once
+  std::shared_ptr<NetworkConnection> mEmptyConnection = std::make_shared<NetworkConnection>();
 
   // The list of connected clients
   std::map<rist_peer *, std::shared_ptr<NetworkConnection>> mClientListSender;
 
   std::unique_ptr<rist_logging_settings, decltype(&free)> mLoggingScope{nullptr, &free};
 
+  // The pool of the OOB data events
+  RISTNetPacketPool *mPacketPool = nullptr;
+
+  // The events for drain(), used if mQueueEvents. Set before the librist context is created, read by its callbacks
+  RISTNetEventQueue<NetworkEvent> mEventQueue;
+  std::atomic<bool> mQueueEvents{false};
+
+  // Written by sendData under mFlowCountersMtx, the table has one writer at a time
+  RISTNetCounterTable mFlowCounters;
+  std::mutex mFlowCountersMtx;
+
+  // Set with mTsOptimize
+  std::unique_ptr<RISTNetTsOptimizer> mTsOptimizer;
+
+  // Set with mCompress
+  std::unique_ptr<RISTNetCompressor> mCompressor;
+
+  // Set with mCongestionFeedback
+  std::unique_ptr<RISTNetCongestionMonitor> mCongestionMonitor;
+
+  // The account in the memory governor, the recovery length fitting what it granted
+  std::unique_ptr<RISTNetMemorySession> mMemorySession;
+  uint32_t mRecoveryLengthMax = 0;
+  size_t mConfiguredPeers = 0;                  // Under mClientListMtx once initialised
+  std::chrono::milliseconds mStatisticsInterval = std::chrono::milliseconds(1000);
+
+  // Set when a RISTNetMockTransport drives the sender instead of librist
+  RISTNetMockTransport *mMockTransport = nullptr;
+
 };
 
 #endif //CPPRISTWRAPPER__RISTNET_H
@@ -0,0 +1,269 @@
+//
+// RISTNetCallbackWatchdog -- Time budget of the user callbacks, slow handlers offloaded to a thread of their own
+//
+
+#include "RISTNetCallbackWatchdog.h"
+#include "RISTNetInternal.h"
+
+RISTNetCallbackWatchdog::RISTNetCallbackWatchdog() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetCallbackWatchdog constructed")
+}
+
+RISTNetCallbackWatchdog::~RISTNetCallbackWatchdog() {
+    if (mOffloadThread.joinable()) {
+        destroyWatchdog();
+    }
+    LOGGER(false, LOGG_NOTIFY, "RISTNetCallbackWatchdog destruct")
+}
+
+bool RISTNetCallbackWatchdog::initWatchdog(RISTNetCallbackWatchdogSettings &rSettings) {
+    if (rSettings.mDataBudget.count() <= 0 || rSettings.mControlBudget.count() <= 0 ||
+        rSettings.mViolationWindow.count() <= 0 || !rSettings.mOffloadQueueSize) {
+        LOGGER(true, LOGG_ERROR, "Watchdog settings not valid.")
+        return false;
+    }
+    if (mOffloadThread.joinable()) {
+        LOGGER(true, LOGG_ERROR, "RISTNetCallbackWatchdog already initialised.")
+        return false;
+    }
+    mSettings = rSettings;
+    {
+        std::lock_guard<std::mutex> lLock(mStateMtx);
+        mStates.clear();
+        mOffloads = 0;
+        mOffloadEvents = 0;
+        for (auto &rSlot: mPeerSlots) {
+            rSlot = nullptr;
+        }
+        mPeerSlotsUsed = 0;
+        mOverflowPeers = 0;
+    }
+    {
+        std::lock_guard<std::mutex> lLock(mQueueMtx);
+        mQueue.clear();
+        mEvents.clear();
+        mQueued = 0;
+        mDropped = 0;
+        mOffloadRun = true;
+    }
+    mOffloadThread = std::thread(&RISTNetCallbackWatchdog::offloadWorker, this);
+    return true;
+}
+
+bool RISTNetCallbackWatchdog::isOffloadedLocked(CallbackKind lKind, rist_peer *pPeer) {
+    std::lock_guard<std::mutex> lLock(mStateMtx);
+    auto lState = mStates.find({lKind, lKind == CallbackKind::kData ? pPeer : nullptr});
+    return lState != mStates.end() && lState->second.mOffloaded;
+}
+
+void RISTNetCallbackWatchdog::count(CallbackKind lKind, uint64_t lDuration, bool lViolation, bool lOffloaded) {
+    Histogram &rHistogram = mHistograms[(size_t) lKind];
+    uint64_t lMicroseconds = lDuration / 1000;
+    size_t lBucket = lMicroseconds ? std::min<size_t>(kBuckets - 1, 64 - __builtin_clzll(lMicroseconds)) : 0;
+    rHistogram.mBuckets[lBucket].fetch_add(1, std::memory_order_relaxed);
+    if (lViolation) {
+        rHistogram.mViolations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (lOffloaded) {
+        rHistogram.mOffloaded.fetch_add(1, std::memory_order_relaxed);
+    }
+    uint64_t lMax = rHistogram.mMaxDuration.load(std::memory_order_relaxed);
+    while (lDuration > lMax &&
+           !rHistogram.mMaxDuration.compare_exchange_weak(lMax, lDuration, std::memory_order_relaxed)) {
+    }
+}
+
+void RISTNetCallbackWatchdog::record(CallbackKind lKind, rist_peer *pPeer, std::chrono::nanoseconds lDuration,
+                                     std::chrono::steady_clock::time_point lNow) {
+    bool lData = lKind == CallbackKind::kData || lKind == CallbackKind::kOOBData;
+    bool lViolation = lDuration > (lData ? mSettings.mDataBudget : mSettings.mControlBudget);
+    count(lKind, (uint64_t) lDuration.count(), lViolation, false);
+    if (!lViolation || !mSettings.mViolationLimit || !canOffload(lKind)) {
+        return;
+    }
+
+    WatchdogEvent lEvent;
+    {
+        std::lock_guard<std::mutex> lLock(mStateMtx);
+        ViolationState &rState = mStates[{lKind, lKind == CallbackKind::kData ? pPeer : nullptr}];
+        if (rState.mOffloaded) {
+            return;
+        }
+        if (!rState.mViolations || lNow - rState.mWindowStart > mSettings.mViolationWindow) {
+            rState.mViolations = 0;
+            rState.mWindowStart = lNow;
+        }
+        if (++rState.mViolations < mSettings.mViolationLimit) {
+            return;
+        }
+        rState.mOffloaded = true;
+        if (lKind == CallbackKind::kData) {
+            insertPeer(pPeer);
+        }
+        mOffloads.fetch_add(1, std::memory_order_release);
+        mOffloadEvents++;
+        lEvent.mKind = lKind;
+        lEvent.pPeer = lKind == CallbackKind::kData ? pPeer : nullptr;
+        lEvent.mViolations = rState.mViolations;
+        lEvent.mDuration = (uint64_t) lDuration.count();
+    }
+    LOGGER(true, LOGG_WARN, "Callback " << (uint32_t) lKind << " over budget " << lEvent.mViolations
+                                        << " times, offloaded.")
+
+    // The event handler runs on the offload thread, not on the librist thread
+    std::lock_guard<std::mutex> lLock(mQueueMtx);
+    mEvents.push_back(lEvent);
+    mQueueCondition.notify_one();
+}
+
+bool RISTNetCallbackWatchdog::offload(std::unique_ptr<OffloadTask> pTask) {
+    std::lock_guard<std::mutex> lLock(mQueueMtx);
+    if (!mOffloadRun || mQueue.size() >= mSettings.mOffloadQueueSize) {
+        mDropped++;
+        return false;
+    }
+    mQueue.push_back(std::move(pTask));
+    mQueued++;
+    mQueueCondition.notify_one();
+    return true;
+}
+
+void RISTNetCallbackWatchdog::forgetPeer(rist_peer *pPeer) {
+    std::lock_guard<std::mutex> lLock(mStateMtx);
+    auto lState = mStates.find({CallbackKind::kData, pPeer});
+    if (lState == mStates.end()) {
+        return;
+    }
+    if (lState->second.mOffloaded) {
+        erasePeer(pPeer);
+        mOffloads.fetch_sub(1, std::memory_order_release);
+    }
+    mStates.erase(lState);
+}
+
+void RISTNetCallbackWatchdog::insertPeer(rist_peer *pPeer) {
+    // 3/4 used, the probes stay short, the next peers go to mStates only
+    if (mPeerSlotsUsed >= kPeerSlots * 3 / 4) {
+        mOverflowPeers.fetch_add(1, std::memory_order_release);
+        return;
+    }
+    size_t lSlot = peerSlot(pPeer);
+    while (true) {
+        rist_peer *pSlotPeer = mPeerSlots[lSlot].load(std::memory_order_relaxed);
+        if (!pSlotPeer || pSlotPeer == peerTombstone()) {
+            if (!pSlotPeer) {
+                mPeerSlotsUsed++;
+            }
+            mPeerSlots[lSlot].store(pPeer, std::memory_order_release);
+            return;
+        }
+        lSlot = (lSlot + 1) & (kPeerSlots - 1);
+    }
+}
+
+void RISTNetCallbackWatchdog::erasePeer(rist_peer *pPeer) {
+    size_t lSlot = peerSlot(pPeer);
+    for (size_t i = 0; i < kPeerSlots; i++) {
+        rist_peer *pSlotPeer = mPeerSlots[lSlot].load(std::memory_order_relaxed);
+        if (pSlotPeer == pPeer) {
+            mPeerSlots[lSlot].store(peerTombstone(), std::memory_order_release);
+            return;
+        }
+        if (!pSlotPeer) {
+            break;
+        }
+        lSlot = (lSlot + 1) & (kPeerSlots - 1);
+    }
+    mOverflowPeers.fetch_sub(1, std::memory_order_release);
+}
+
+void RISTNetCallbackWatchdog::offloadWorker() {
+    std::unique_lock<std::mutex> lLock(mQueueMtx);
+    while (true) {
+        mQueueCondition.wait(lLock, [this] { return !mOffloadRun || !mQueue.empty() || !mEvents.empty(); });
+        if (!mOffloadRun) {
+            break;
+        }
+        if (!mEvents.empty()) {
+            std::vector<WatchdogEvent> lEvents;
+            lEvents.swap(mEvents);
+            lLock.unlock();
+            if (offloadCallback) {
+                for (auto &rEvent: lEvents) {
+                    offloadCallback(rEvent);
+                }
+            }
+            lLock.lock();
+            continue;
+        }
+        std::unique_ptr<OffloadTask> pTask = std::move(mQueue.front());
+        mQueue.pop_front();
+        lLock.unlock();
+        auto lStart = std::chrono::steady_clock::now();
+        pTask->run();
+        auto lDuration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - lStart).count();
+        bool lData = pTask->mKind == CallbackKind::kData || pTask->mKind == CallbackKind::kOOBData;
+        count(pTask->mKind, (uint64_t) lDuration,
+              lDuration > (lData ? mSettings.mDataBudget : mSettings.mControlBudget).count() * 1000, true);
+        pTask.reset();
+        lLock.lock();
+    }
+}
+
+void RISTNetCallbackWatchdog::getHistograms(std::vector<CallbackHistogram> &rHistograms) {
+    rHistograms.resize(kKinds);
+    for (size_t i = 0; i < kKinds; i++) {
+        Histogram &rHistogram = mHistograms[i];
+        CallbackHistogram &rOut = rHistograms[i];
+        rOut.mKind = (CallbackKind) i;
+        rOut.mViolations = rHistogram.mViolations.load(std::memory_order_relaxed);
+        rOut.mOffloaded = rHistogram.mOffloaded.load(std::memory_order_relaxed);
+        rOut.mMaxDuration = rHistogram.mMaxDuration.load(std::memory_order_relaxed);
+        rOut.mCalls = 0;
+        for (size_t j = 0; j < kBuckets; j++) {
+            rOut.mBuckets[j] = rHistogram.mBuckets[j].load(std::memory_order_relaxed);
+            rOut.mCalls += rOut.mBuckets[j];
+        }
+    }
+}
+
+void RISTNetCallbackWatchdog::getStatistics(WatchdogStatistics &rStatistics) {
+    rStatistics = WatchdogStatistics();
+    for (auto &rHistogram: mHistograms) {
+        rStatistics.mViolations += rHistogram.mViolations.load(std::memory_order_relaxed);
+    }
+    {
+        std::lock_guard<std::mutex> lLock(mStateMtx);
+        rStatistics.mOffloadEvents = mOffloadEvents;
+        for (auto &rState: mStates) {
+            if (rState.second.mOffloaded && rState.first.first == CallbackKind::kData) {
+                rStatistics.mOffloadedPeers++;
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lLock(mQueueMtx);
+    rStatistics.mQueued = mQueued;
+    rStatistics.mDropped = mDropped;
+    rStatistics.mQueueDepth = mQueue.size();
+}
+
+bool RISTNetCallbackWatchdog::destroyWatchdog() {
+    {
+        std::lock_guard<std::mutex> lLock(mQueueMtx);
+        if (!mOffloadRun) {
+            LOGGER(true, LOGG_WARN, "RISTNetCallbackWatchdog not initialised.")
+            return false;
+        }
+        mOffloadRun = false;
+        mDropped += mQueue.size();
+        mQueueCondition.notify_one();
+    }
+    if (mOffloadThread.joinable()) {
+        mOffloadThread.join();
+    }
+    std::lock_guard<std::mutex> lLock(mQueueMtx);
+    mQueue.clear();
+    mEvents.clear();
+    return true;
+}
@@ -0,0 +1,264 @@
+//
+// RISTNetCallbackWatchdog -- Time budget of the user callbacks, slow handlers offloaded to a thread of their own
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+// k constant
+
+#ifndef CPPRISTWRAPPER__RISTNETCALLBACKWATCHDOG_H
+#define CPPRISTWRAPPER__RISTNETCALLBACKWATCHDOG_H
+
+#include "librist.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \class RISTNetCallbackWatchdog
+ *
+ * \brief
+ *
+ * Measures the user callbacks of a receiver against a time budget, in a log2 histogram per callback. The
+ * callbacks run on the librist threads, the data callback under the client list lock, so one slow handler
+ * delays the ARQ of every peer. A peer whose data callback goes over budget mViolationLimit times within
+ * mViolationWindow is offloaded: its packets are copied into a bounded queue and delivered by the offload thread
+ * from then on, in order. The statistics callback is offloaded the same way. validateConnectionCallback (the
+ * librist thread waits for its answer), networkOOBDataCallback and clientDisconnectedCallback are measured only.
+ *
+ */
+class RISTNetCallbackWatchdog {
+public:
+
+    enum class CallbackKind : uint32_t {
+        kData,              // networkDataCallback, networkDataBlockCallback or networkBufferCallback
+        kOOBData,           // networkOOBDataCallback
+        kValidate,          // validateConnectionCallback
+        kDisconnect,        // clientDisconnectedCallback
+        kStatistics         // statisticsCallback
+    };
+
+    static constexpr size_t kKinds = 5;
+    static constexpr size_t kBuckets = 24;  // Bucket 0 under 1 us, bucket i from 2^(i-1) us to 2^i us, the last open
+
+    struct RISTNetCallbackWatchdogSettings {
+        std::chrono::microseconds mDataBudget{500};         // kData and kOOBData
+        std::chrono::microseconds mControlBudget{10000};    // kValidate, kDisconnect and kStatistics
+        uint32_t mViolationLimit = 8;                       // Violations within mViolationWindow offloading, 0 never
+        std::chrono::milliseconds mViolationWindow{1000};
+        size_t mOffloadQueueSize = 4096;                    // Callbacks queued for the offload thread, more are dropped
+    };
+
+    struct CallbackHistogram {
+        CallbackKind mKind = CallbackKind::kData;
+        uint64_t mCalls = 0;
+        uint64_t mViolations = 0;           // Calls over budget
+        uint64_t mOffloaded = 0;            // Calls made by the offload thread, included in mCalls
+        uint64_t mMaxDuration = 0;          // ns
+        std::array<uint64_t, kBuckets> mBuckets{};
+    };
+
+    struct WatchdogEvent {
+        CallbackKind mKind = CallbackKind::kData;
+        rist_peer *pPeer = nullptr;         // kData, not to be dereferenced after the peer disconnected
+        uint32_t mViolations = 0;           // Within the window
+        uint64_t mDuration = 0;             // ns, of the call that offloaded
+    };
+
+    struct WatchdogStatistics {
+        uint64_t mViolations = 0;
+        uint64_t mOffloadEvents = 0;
+        uint64_t mQueued = 0;               // Callbacks queued for the offload thread
+        uint64_t mDropped = 0;              // Not queued because mOffloadQueueSize were queued
+        size_t mQueueDepth = 0;
+        size_t mOffloadedPeers = 0;         // Connected
+    };
+
+    // A callback for the offload thread
+    struct OffloadTask {
+        virtual ~OffloadTask() = default;
+        virtual void run() = 0;
+        CallbackKind mKind = CallbackKind::kData;
+    };
+
+    /// Constructor
+    RISTNetCallbackWatchdog();
+
+    /// Destructor
+    virtual ~RISTNetCallbackWatchdog();
+
+    /**
+     * @brief Initialize the watchdog
+     *
+     * Starts the offload thread.
+     *
+     * @param The watchdog settings
+     * @return true on success
+     */
+    bool initWatchdog(RISTNetCallbackWatchdogSettings &rSettings);
+
+    /// True if the callbacks of the kind (and of the peer for kData) go to the offload thread. Lock free for kData
+    /// unless more than 3/4 of kPeerSlots peers were offloaded, for the other kinds until one was offloaded.
+    bool isOffloaded(CallbackKind lKind, rist_peer *pPeer) {
+        if (!mOffloads.load(std::memory_order_acquire)) {
+            return false;
+        }
+        if (lKind != CallbackKind::kData) {
+            return isOffloadedLocked(lKind, pPeer);
+        }
+        size_t lSlot = peerSlot(pPeer);
+        for (size_t i = 0; i < kPeerSlots; i++) {
+            rist_peer *pSlotPeer = mPeerSlots[lSlot].load(std::memory_order_acquire);
+            if (pSlotPeer == pPeer) {
+                return true;
+            }
+            if (!pSlotPeer) {
+                break;
+            }
+            lSlot = (lSlot + 1) & (kPeerSlots - 1);
+        }
+        return mOverflowPeers.load(std::memory_order_acquire) && isOffloadedLocked(lKind, pPeer);
+    }
+
+    /**
+     * @brief Record a call
+     *
+     * Called after every callback made on a librist thread. A call over budget counts as a violation, the limit of
+     * violations within the window offloads the callback (of the peer for kData) and queues the event.
+     *
+     * @param the callback
+     * @param the peer, kData only
+     * @param the duration of the call
+     * @param the time, now
+     */
+    void record(CallbackKind lKind, rist_peer *pPeer, std::chrono::nanoseconds lDuration,
+                std::chrono::steady_clock::time_point lNow = std::chrono::steady_clock::now());
+
+    /**
+     * @brief Queue a callback for the offload thread
+     *
+     * Never blocks.
+     *
+     * @param the callback
+     * @return false if mOffloadQueueSize callbacks are queued, the callback is dropped
+     */
+    bool offload(std::unique_ptr<OffloadTask> pTask);
+
+    /// An OffloadTask running lFunction, lFunction may be move only
+    template<typename F>
+    static std::unique_ptr<OffloadTask> makeTask(CallbackKind lKind, F &&lFunction) {
+        struct Task : OffloadTask {
+            explicit Task(F &&lF) : mFunction(std::forward<F>(lF)) {}
+            void run() override {
+                mFunction();
+            }
+            typename std::decay<F>::type mFunction;
+        };
+        auto pTask = std::make_unique<Task>(std::forward<F>(lFunction));
+        pTask->mKind = lKind;
+        return pTask;
+    }
+
+    /// A peer disconnected, its data callback is measured again if it connects again
+    void forgetPeer(rist_peer *pPeer);
+
+    /// The histogram of every callback kind
+    void getHistograms(std::vector<CallbackHistogram> &rHistograms);
+
+    void getStatistics(WatchdogStatistics &rStatistics);
+
+    /**
+     * @brief Destroys the watchdog
+     *
+     * Stops the offload thread after the callback it runs, the callbacks queued are dropped.
+     * Not to be called from an offloaded callback.
+     *
+     */
+    bool destroyWatchdog();
+
+    /// A callback was offloaded, called from the offload thread (__NULLABLE)
+    std::function<void(const WatchdogEvent &rEvent)> offloadCallback = nullptr;
+
+    // Delete copy and move constructors and assign operators
+    RISTNetCallbackWatchdog(RISTNetCallbackWatchdog const &) = delete;             // Copy construct
+    RISTNetCallbackWatchdog(RISTNetCallbackWatchdog &&) = delete;                  // Move construct
+    RISTNetCallbackWatchdog &operator=(RISTNetCallbackWatchdog const &) = delete;  // Copy assign
+    RISTNetCallbackWatchdog &operator=(RISTNetCallbackWatchdog &&) = delete;       // Move assign
+
+private:
+
+    // One increment per call, the calls are the sum of the buckets
+    struct alignas(64) Histogram {
+        std::atomic<uint64_t> mViolations{0};
+        std::atomic<uint64_t> mOffloaded{0};
+        std::atomic<uint64_t> mMaxDuration{0};
+        std::array<std::atomic<uint64_t>, kBuckets> mBuckets{};
+    };
+
+    struct ViolationState {
+        uint32_t mViolations = 0;
+        std::chrono::steady_clock::time_point mWindowStart;
+        bool mOffloaded = false;
+    };
+
+    // The peer is nullptr for the kinds offloaded as a whole
+    using StateKey = std::pair<CallbackKind, rist_peer *>;
+
+    // The peers offloaded, open addressing written under mStateMtx and read lock free. A peer forgotten leaves a
+    // tombstone reused by the next ones, the slots never emptied keep the probes valid for the readers.
+    static constexpr size_t kPeerSlots = 256;
+
+    static size_t peerSlot(rist_peer *pPeer) {
+        return (size_t) (((uint64_t) (uintptr_t) pPeer * 0x9E3779B97F4A7C15ULL) >> 56) & (kPeerSlots - 1);
+    }
+
+    static rist_peer *peerTombstone() {
+        return reinterpret_cast<rist_peer *>(uintptr_t(1));
+    }
+
+    void insertPeer(rist_peer *pPeer);
+    void erasePeer(rist_peer *pPeer);
+
+    bool isOffloadedLocked(CallbackKind lKind, rist_peer *pPeer);
+    void count(CallbackKind lKind, uint64_t lDuration, bool lViolation, bool lOffloaded);
+    void offloadWorker();
+
+    static bool canOffload(CallbackKind lKind) {
+        return lKind == CallbackKind::kData || lKind == CallbackKind::kStatistics;
+    }
+
+    RISTNetCallbackWatchdogSettings mSettings;
+    std::array<Histogram, kKinds> mHistograms;
+    std::atomic<size_t> mOffloads{0};           // Entries of mStates offloaded
+
+    // Protects mStates, taken on violations and, once the statistics callback was offloaded, by isOffloaded
+    std::mutex mStateMtx;
+    std::map<StateKey, ViolationState> mStates;
+    uint64_t mOffloadEvents = 0;
+    std::array<std::atomic<rist_peer *>, kPeerSlots> mPeerSlots{};
+    size_t mPeerSlotsUsed = 0;                  // Peers and tombstones, under mStateMtx
+    std::atomic<size_t> mOverflowPeers{0};      // Offloaded peers not in mPeerSlots, looked up in mStates
+
+    // The offload queue
+    std::mutex mQueueMtx;
+    std::condition_variable mQueueCondition;
+    std::deque<std::unique_ptr<OffloadTask>> mQueue;
+    std::vector<WatchdogEvent> mEvents;
+    uint64_t mQueued = 0;
+    uint64_t mDropped = 0;
+    bool mOffloadRun = false;
+    std::thread mOffloadThread;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETCALLBACKWATCHDOG_H
@@ -0,0 +1,141 @@
+//
+// RISTNetCompressor -- LZ4 compression of the payloads of selected flows, decompressed on receive
+//
+
+#include "RISTNetCompressor.h"
+#include "RISTNetInternal.h"
+#include "lz4.h"
+#include <chrono>
+#include <cstring>
+
+namespace {
+uint64_t nsSince(std::chrono::steady_clock::time_point lStart) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - lStart).count();
+}
+
+// The payload behind a raw header
+void frameRaw(const uint8_t *pData, size_t lSize, std::vector<uint8_t> &rOut) {
+    rOut.resize(RISTNetCompressor::kRawHeaderSize + lSize);
+    rOut[0] = RISTNetCompressor::kCompressedMarker;
+    rOut[1] = RISTNetCompressor::kFormatRaw;
+    if (lSize) {
+        memcpy(rOut.data() + RISTNetCompressor::kRawHeaderSize, pData, lSize);
+    }
+}
+} // namespace
+
+RISTNetCompressor::RISTNetCompressor() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetCompressor constructed")
+}
+
+RISTNetCompressor::~RISTNetCompressor() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetCompressor destruct")
+}
+
+bool RISTNetCompressor::initCompressor(RISTNetCompressorSettings &rSettings) {
+    if (rSettings.mAcceleration < 1) {
+        LOGGER(true, LOGG_ERROR, "LZ4 acceleration not valid: " << rSettings.mAcceleration)
+        return false;
+    }
+    mAcceleration = rSettings.mAcceleration;
+    mMinSize = rSettings.mMinSize;
+    mBackoff = rSettings.mBackoff;
+    mFlowBackoff.reset(new std::atomic<uint8_t>[65536]());
+    mAllFlows = rSettings.mFlows.empty();
+    mFlows.reset();
+    for (auto lFlow: rSettings.mFlows) {
+        mFlows.set(lFlow);
+    }
+    return true;
+}
+
+bool RISTNetCompressor::compress(const uint8_t *pData, size_t lSize, uint16_t lConnectionID,
+                                 std::vector<uint8_t> &rOut) {
+    if (!mFlowBackoff) {
+        LOGGER(true, LOGG_ERROR, "RISTNetCompressor not initialised.")
+        return false;
+    }
+    if (!isSelected(lConnectionID)) {
+        return false;
+    }
+    mBytesIn += lSize;
+    // Racing threads may skip one payload more or less, that is fine
+    std::atomic<uint8_t> &rBackoff = mFlowBackoff[lConnectionID];
+    uint8_t lBackoff = rBackoff.load(std::memory_order_relaxed);
+    if (lBackoff) {
+        rBackoff.store(lBackoff - 1, std::memory_order_relaxed);
+    }
+    if (lBackoff || lSize < mMinSize || lSize <= kHeaderSize + 1 || lSize > kMaxPayloadSize) {
+        frameRaw(pData, lSize, rOut);
+        mSkipped++;
+        mBytesOut += rOut.size();
+        return true;
+    }
+
+    // The state is reset by LZ4_compress_fast_extState, one per thread is enough
+    thread_local std::vector<uint64_t> lState((LZ4_sizeofState() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    // At least one byte smaller or LZ4 gives up
+    int lCapacity = (int) (lSize - kHeaderSize - 1);
+    rOut.resize(kHeaderSize + lCapacity);
+    auto lStart = std::chrono::steady_clock::now();
+    int lCompressedSize = LZ4_compress_fast_extState(lState.data(), (const char *) pData,
+                                                     (char *) rOut.data() + kHeaderSize, (int) lSize, lCapacity,
+                                                     mAcceleration);
+    mCompressNs += nsSince(lStart);
+    if (lCompressedSize <= 0) {
+        rBackoff.store(mBackoff, std::memory_order_relaxed);
+        frameRaw(pData, lSize, rOut);
+        mSkipped++;
+        mBytesOut += rOut.size();
+        return true;
+    }
+    rOut.resize(kHeaderSize + lCompressedSize);
+    rOut[0] = kCompressedMarker;
+    rOut[1] = kFormatLz4;
+    rOut[2] = lSize & 0xff;
+    rOut[3] = (lSize >> 8) & 0xff;
+    mCompressed++;
+    mBytesOut += rOut.size();
+    return true;
+}
+
+bool RISTNetCompressor::decompress(const uint8_t *pData, size_t lSize, std::vector<uint8_t> &rOut) {
+    if (lSize < kRawHeaderSize || pData[0] != kCompressedMarker) {
+        mDecompressErrors++;
+        return false;
+    }
+    if (pData[1] == kFormatRaw) {
+        rOut.assign(pData + kRawHeaderSize, pData + lSize);
+        mRawReceived++;
+        return true;
+    }
+    if (pData[1] != kFormatLz4 || lSize < kHeaderSize) {
+        mDecompressErrors++;
+        return false;
+    }
+    size_t lOriginalSize = pData[2] | (pData[3] << 8);
+    rOut.resize(lOriginalSize);
+    auto lStart = std::chrono::steady_clock::now();
+    int lDecompressedSize = LZ4_decompress_safe((const char *) pData + kHeaderSize, (char *) rOut.data(),
+                                                (int) (lSize - kHeaderSize), (int) lOriginalSize);
+    mDecompressNs += nsSince(lStart);
+    if (lDecompressedSize < 0 || (size_t) lDecompressedSize != lOriginalSize) {
+        mDecompressErrors++;
+        return false;
+    }
+    mDecompressed++;
+    return true;
+}
+
+void RISTNetCompressor::getStatistics(CompressorStatistics &rStatistics) {
+    rStatistics.mCompressed = mCompressed;
+    rStatistics.mSkipped = mSkipped;
+    rStatistics.mBytesIn = mBytesIn;
+    rStatistics.mBytesOut = mBytesOut;
+    rStatistics.mRatio = rStatistics.mBytesIn ? (double) rStatistics.mBytesOut / rStatistics.mBytesIn : 1.0;
+    rStatistics.mCompressNs = mCompressNs;
+    rStatistics.mDecompressed = mDecompressed;
+    rStatistics.mRawReceived = mRawReceived;
+    rStatistics.mDecompressNs = mDecompressNs;
+    rStatistics.mDecompressErrors = mDecompressErrors;
+}
@@ -0,0 +1,141 @@
+//
+// RISTNetCompressor -- LZ4 compression of the payloads of selected flows, decompressed on receive
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+// k constant
+
+#ifndef CPPRISTWRAPPER__RISTNETCOMPRESSOR_H
+#define CPPRISTWRAPPER__RISTNETCOMPRESSOR_H
+
+#include <atomic>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Every payload of a flow selected carries the header, compressed or not, so no payload is told apart by its first
+// bytes. The receiver selects the same flows.
+//
+//   uint8_t  marker         kCompressedMarker
+//   uint8_t  format         kFormatRaw or kFormatLz4
+//   uint16_t size           kFormatLz4 only, the original size, little endian
+//   the payload (kFormatRaw) or the LZ4 block (kFormatLz4)
+
+/**
+ * \class RISTNetCompressor
+ *
+ * \brief
+ *
+ * Compresses the payloads of the flows selected with LZ4, for telemetry, metadata or file transfer, not video.
+ * A payload LZ4 can not make smaller is sent as it is behind a raw header, LZ4 gives up as soon as the output would
+ * not fit, and the next mBackoff payloads of the flow are not tried. The compression state is per thread so compress() and
+ * decompress() can be called from many threads.
+ *
+ */
+class RISTNetCompressor {
+public:
+
+    static constexpr uint8_t kCompressedMarker = 0xC4;
+    static constexpr uint8_t kFormatRaw = 0x00;
+    static constexpr uint8_t kFormatLz4 = 0x01;
+    static constexpr size_t kRawHeaderSize = 2;
+    static constexpr size_t kHeaderSize = 4;
+    static constexpr size_t kMaxPayloadSize = 0xFFFF;
+
+    struct RISTNetCompressorSettings {
+        std::vector<uint16_t> mFlows;           // Connection IDs of sendData compressed, empty compresses all.
+                                                // The receiver decompresses the same connection IDs.
+        int mAcceleration = 1;                  // LZ4 acceleration, higher is faster and compresses less
+        size_t mMinSize = 64;                   // Smaller payloads are sent as they are
+        uint8_t mBackoff = 8;                   // Payloads of a flow sent raw after one not compressible
+    };
+
+    struct CompressorStatistics {
+        uint64_t mCompressed = 0;           // Payloads compressed
+        uint64_t mSkipped = 0;              // Payloads of the flows selected not compressible, sent as kFormatRaw
+        uint64_t mBytesIn = 0;              // Payload bytes of the flows selected
+        uint64_t mBytesOut = 0;             // Payload bytes sent for them
+        double mRatio = 1.0;                // mBytesOut / mBytesIn
+        uint64_t mCompressNs = 0;           // Time spent compressing
+        uint64_t mDecompressed = 0;         // kFormatLz4 payloads received
+        uint64_t mRawReceived = 0;          // kFormatRaw payloads received
+        uint64_t mDecompressNs = 0;         // Time spent decompressing
+        uint64_t mDecompressErrors = 0;     // Payloads of the flows selected without a valid header
+    };
+
+    /// Constructor
+    RISTNetCompressor();
+
+    /// Destructor
+    virtual ~RISTNetCompressor();
+
+    /**
+     * @brief Initialize the compressor
+     *
+     * @param The compressor settings
+     * @return true on success
+     */
+    bool initCompressor(RISTNetCompressorSettings &rSettings);
+
+    /**
+     * @brief Compress a payload
+     *
+     * @param the payload
+     * @param the size
+     * @param the connection ID of sendData
+     * @param the payload to send with its header, compressed or not, a scratch buffer when false is returned
+     * @return true if rOut holds the payload to send, false if the flow is not selected (send the payload as it is)
+     */
+    bool compress(const uint8_t *pData, size_t lSize, uint16_t lConnectionID, std::vector<uint8_t> &rOut);
+
+    /**
+     * @brief Decompress a payload of a flow selected
+     *
+     * @param the payload with its header
+     * @param the size
+     * @param the payload
+     * @return true on success, false if the header or the compressed payload is not valid
+     */
+    bool decompress(const uint8_t *pData, size_t lSize, std::vector<uint8_t> &rOut);
+
+    /// True if the payloads of the flow carry the header
+    bool isSelected(uint16_t lConnectionID) const {
+        return mAllFlows || mFlows[lConnectionID];
+    }
+
+    /// Get the compressor statistics
+    void getStatistics(CompressorStatistics &rStatistics);
+
+    // Delete copy and move constructors and assign operators
+    RISTNetCompressor(RISTNetCompressor const &) = delete;              // Copy construct
+    RISTNetCompressor(RISTNetCompressor &&) = delete;                   // Move construct
+    RISTNetCompressor &operator=(RISTNetCompressor const &) = delete;   // Copy assign
+    RISTNetCompressor &operator=(RISTNetCompressor &&) = delete;        // Move assign
+
+private:
+
+    bool mAllFlows = true;
+    std::bitset<65536> mFlows;
+    int mAcceleration = 1;
+    size_t mMinSize = 64;
+    uint8_t mBackoff = 8;
+    std::unique_ptr<std::atomic<uint8_t>[]> mFlowBackoff; // Payloads left to skip per connection ID
+
+    std::atomic<uint64_t> mCompressed{0};
+    std::atomic<uint64_t> mSkipped{0};
+    std::atomic<uint64_t> mBytesIn{0};
+    std::atomic<uint64_t> mBytesOut{0};
+    std::atomic<uint64_t> mCompressNs{0};
+    std::atomic<uint64_t> mDecompressed{0};
+    std::atomic<uint64_t> mRawReceived{0};
+    std::atomic<uint64_t> mDecompressNs{0};
+    std::atomic<uint64_t> mDecompressErrors{0};
+};
+
+#endif //CPPRISTWRAPPER__RISTNETCOMPRESSOR_H
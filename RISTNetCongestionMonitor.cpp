@@ -0,0 +1,174 @@
+//
+// RISTNetCongestionMonitor -- Target bitrate for adaptive bitrate encoders from the sender peer statistics
+//
+
+#include "RISTNetCongestionMonitor.h"
+#include "RISTNetInternal.h"
+#include <algorithm>
+
+// Peers not reporting for this many intervals are forgotten
+#define CONGESTION_PEER_TIMEOUT_INTERVALS 5
+
+RISTNetCongestionMonitor::RISTNetCongestionMonitor() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetCongestionMonitor constructed")
+}
+
+RISTNetCongestionMonitor::~RISTNetCongestionMonitor() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetCongestionMonitor destruct")
+}
+
+bool RISTNetCongestionMonitor::initMonitor(RISTNetCongestionSettings &rSettings) {
+    if (rSettings.mInterval.count() <= 0 || !rSettings.mMinBitrate || rSettings.mMinBitrate > rSettings.mMaxBitrate ||
+        rSettings.mDecrease <= 0.0 || rSettings.mDecrease >= 1.0 || rSettings.mIncrease <= 0.0) {
+        LOGGER(true, LOGG_ERROR, "Congestion settings not valid.")
+        return false;
+    }
+    std::lock_guard<std::mutex> lLock(mMtx);
+    mSettings = rSettings;
+    mPeers.clear();
+    mLastReport = {};
+    mClearIntervals = 0;
+    mQueueGrowth = 0.0;
+    mSnapshot = CongestionSnapshot();
+    mSnapshot.mTargetBitrate = std::clamp(rSettings.mStartBitrate, rSettings.mMinBitrate, rSettings.mMaxBitrate);
+    mTargetBitrate = mSnapshot.mTargetBitrate;
+    mOffered = 0;
+    return true;
+}
+
+void RISTNetCongestionMonitor::pushStatistics(const rist_stats_sender_peer &rStatistics,
+                                              std::chrono::steady_clock::time_point lNow) {
+    CongestionSnapshot lChanged;
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        if (!mSnapshot.mTargetBitrate) {
+            return;
+        }
+        uint64_t lTarget = mSnapshot.mTargetBitrate;
+        // librist reports all peers at once every interval, a report half an interval after the last one starts
+        // the next burst: the peers fresh from the last burst are evaluated first
+        bool lNewBurst = lNow - mLastReport >= mSettings.mInterval / 2;
+        mLastReport = lNow;
+        if (lNewBurst && std::any_of(mPeers.begin(), mPeers.end(), [](const auto &rEntry) {
+            return rEntry.second.mFresh;
+        })) {
+            evaluate(lNow);
+        }
+
+        PeerState &rPeer = mPeers[rStatistics.peer_id];
+        if (rPeer.mWindowStart.time_since_epoch().count() == 0) {
+            rPeer.mWindowStart = lNow;
+        }
+        rPeer.mSent = rStatistics.sent;
+        rPeer.mRetransmitted = rStatistics.retransmitted;
+        rPeer.mBandwidth = rStatistics.bandwidth;
+        rPeer.mRtt = rStatistics.rtt;
+        rPeer.mLastReport = lNow;
+        rPeer.mFresh = true;
+
+        // The base RTT follows a path change after one window
+        rPeer.mWindowRtt = std::min(rPeer.mWindowRtt, rStatistics.rtt);
+        rPeer.mBaseRtt = std::min(rPeer.mBaseRtt, rStatistics.rtt);
+        if (lNow - rPeer.mWindowStart >= mSettings.mRttWindow) {
+            rPeer.mBaseRtt = rPeer.mWindowRtt;
+            rPeer.mWindowRtt = rStatistics.rtt;
+            rPeer.mWindowStart = lNow;
+        }
+
+        bool lAllFresh = std::all_of(mPeers.begin(), mPeers.end(), [](const auto &rEntry) {
+            return rEntry.second.mFresh;
+        });
+        if (lAllFresh) {
+            evaluate(lNow);
+        }
+        if (mSnapshot.mTargetBitrate == lTarget || !congestionCallback) {
+            return;
+        }
+        lChanged = mSnapshot;
+    }
+    congestionCallback(lChanged);
+}
+
+void RISTNetCongestionMonitor::evaluate(std::chrono::steady_clock::time_point lNow) {
+    auto lTimeout = mSettings.mInterval * CONGESTION_PEER_TIMEOUT_INTERVALS;
+    for (auto lIt = mPeers.begin(); lIt != mPeers.end();) {
+        lIt = lNow - lIt->second.mLastReport > lTimeout ? mPeers.erase(lIt) : std::next(lIt);
+    }
+
+    // The worst peer, relative to the high marks
+    double lWorstScore = -1.0;
+    uint64_t lSent = 0;
+    uint64_t lDelivered = 0;
+    for (auto &rEntry: mPeers) {
+        PeerState &rPeer = rEntry.second;
+        if (!rPeer.mFresh) {
+            continue;
+        }
+        rPeer.mFresh = false;
+        if (mSettings.mLoadBalanced) {
+            lSent += rPeer.mSent;
+            lDelivered += rPeer.mBandwidth;
+        } else {
+            lSent = std::max(lSent, rPeer.mSent);
+            lDelivered = std::max<uint64_t>(lDelivered, rPeer.mBandwidth);
+        }
+        double lRetransmitRatio = (double) rPeer.mRetransmitted / (double) std::max<uint64_t>(rPeer.mSent, 1);
+        // RTT in ms, below 1 ms counts as 1 ms. Up to mRttMargin above the base is jitter, not inflation: one ms
+        // more on a link of one ms is not twice the RTT.
+        double lRttInflation = 1.0;
+        if ((uint64_t) rPeer.mRtt > (uint64_t) rPeer.mBaseRtt + mSettings.mRttMargin) {
+            lRttInflation = (double) rPeer.mRtt / (double) std::max<uint32_t>(rPeer.mBaseRtt, 1);
+        }
+        double lScore = std::max(lRetransmitRatio / mSettings.mRetransmitHigh,
+                                 (lRttInflation - 1.0) / (mSettings.mRttInflationHigh - 1.0));
+        if (lScore > lWorstScore) {
+            lWorstScore = lScore;
+            mSnapshot.mRetransmitRatio = lRetransmitRatio;
+            mSnapshot.mRttInflation = lRttInflation;
+            mSnapshot.mWorstPeer = rEntry.first;
+        }
+    }
+    uint64_t lOffered = mOffered.exchange(0, std::memory_order_relaxed);
+    double lQueueGrowth = lOffered > lSent ? (double) (lOffered - lSent) / (double) lOffered : 0.0;
+    mQueueGrowth = (mQueueGrowth + lQueueGrowth) / 2.0;
+    mSnapshot.mQueueGrowth = mQueueGrowth;
+    mSnapshot.mDeliveredBitrate = lDelivered;
+    mSnapshot.mPeers = mPeers.size();
+    mSnapshot.mUpdates++;
+
+    bool lCongested = mSnapshot.mRetransmitRatio > mSettings.mRetransmitHigh ||
+                      mSnapshot.mRttInflation > mSettings.mRttInflationHigh ||
+                      mSnapshot.mQueueGrowth > mSettings.mQueueGrowthHigh;
+    bool lClear = mSnapshot.mRetransmitRatio < mSettings.mRetransmitLow &&
+                  mSnapshot.mRttInflation < mSettings.mRttInflationLow &&
+                  mSnapshot.mQueueGrowth < mSettings.mQueueGrowthLow;
+    uint64_t lTarget = mSnapshot.mTargetBitrate;
+    if (lCongested) {
+        // Cut once, then wait one interval for the cut to show in the statistics
+        if (mSnapshot.mState != CongestionState::kCongested) {
+            lTarget = (uint64_t) ((double) lTarget * mSettings.mDecrease);
+            if (lDelivered) {
+                lTarget = std::min(lTarget, lDelivered);
+            }
+            mSnapshot.mState = CongestionState::kCongested;
+        } else {
+            mSnapshot.mState = CongestionState::kHolding;
+        }
+        mClearIntervals = 0;
+    } else if (lClear && ++mClearIntervals >= mSettings.mHoldIntervals) {
+        lTarget = (uint64_t) ((double) lTarget * (1.0 + mSettings.mIncrease));
+        mSnapshot.mState = CongestionState::kProbing;
+    } else {
+        if (!lClear) {
+            mClearIntervals = 0;
+        }
+        mSnapshot.mState = CongestionState::kHolding;
+    }
+    mSnapshot.mTargetBitrate = std::clamp(lTarget, mSettings.mMinBitrate, mSettings.mMaxBitrate);
+    mTargetBitrate.store(mSnapshot.mTargetBitrate, std::memory_order_relaxed);
+}
+
+void RISTNetCongestionMonitor::getSnapshot(CongestionSnapshot &rSnapshot) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    rSnapshot = mSnapshot;
+}
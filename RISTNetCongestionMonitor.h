@@ -0,0 +1,152 @@
+//
+// RISTNetCongestionMonitor -- Target bitrate for adaptive bitrate encoders from the sender peer statistics
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+// k constant
+
+#ifndef CPPRISTWRAPPER__RISTNETCONGESTIONMONITOR_H
+#define CPPRISTWRAPPER__RISTNETCONGESTIONMONITOR_H
+
+#include "librist.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+
+/**
+ * \class RISTNetCongestionMonitor
+ *
+ * \brief
+ *
+ * Derives a congestion signal from the per peer statistics of a sender, every statistics interval: the
+ * retransmit ratio, the RTT inflation (RTT over the lowest RTT of the last mRttWindow, once more than mRttMargin
+ * above it) and the send queue growth (packets offered to sendData not sent). The worst peer counts. Peers
+ * duplicating the stream each send every packet, the queue growth and the bitrate delivered are the ones of the
+ * peer sending the most; with mLoadBalanced the peers share the packets and their counts add up. The target
+ * bitrate is cut by mDecrease, not above the bitrate delivered, as soon as one signal is over its high mark, and
+ * raised by mIncrease after mHoldIntervals intervals with all signals under their low marks. In between it holds.
+ *
+ */
+class RISTNetCongestionMonitor {
+public:
+
+    enum class CongestionState {
+        kProbing,       // Signals clear, the target is raised
+        kHolding,       // Between the marks or clear for less than mHoldIntervals
+        kCongested      // A signal over its high mark, the target was cut
+    };
+
+    struct RISTNetCongestionSettings {
+        std::chrono::milliseconds mInterval = std::chrono::milliseconds(200); // Statistics interval of the sender
+        uint64_t mMinBitrate = 500000;          // bps
+        uint64_t mMaxBitrate = 20000000;        // bps
+        uint64_t mStartBitrate = 5000000;       // bps
+        double mRetransmitHigh = 0.05;          // Retransmitted over sent
+        double mRetransmitLow = 0.01;
+        double mRttInflationHigh = 1.5;         // RTT over the base RTT
+        double mRttInflationLow = 1.15;
+        uint32_t mRttMargin = 5;                // ms, an RTT up to the base RTT + mRttMargin is not inflated (jitter)
+        double mQueueGrowthHigh = 0.05;         // Share of the packets offered not sent
+        double mQueueGrowthLow = 0.01;
+        double mDecrease = 0.85;                // Target multiplied by, when congested
+        double mIncrease = 0.05;                // Target raised by, when probing
+        uint32_t mHoldIntervals = 3;            // Clear intervals before raising the target
+        std::chrono::seconds mRttWindow = std::chrono::seconds(10); // The base RTT is the lowest RTT of the window
+        bool mLoadBalanced = false;             // The peers share the packets (weights above 0), else they duplicate
+    };
+
+    struct CongestionSnapshot {
+        uint64_t mTargetBitrate = 0;            // bps, the encoder bitrate recommended
+        CongestionState mState = CongestionState::kHolding;
+        double mRetransmitRatio = 0.0;          // Of the worst peer
+        double mRttInflation = 1.0;             // Of the worst peer
+        double mQueueGrowth = 0.0;
+        uint64_t mDeliveredBitrate = 0;         // bps, sent by the peer sending the most (all with mLoadBalanced),
+                                                // retransmissions not included
+        uint32_t mWorstPeer = 0;                // peer_id of the statistics
+        size_t mPeers = 0;
+        uint64_t mUpdates = 0;                  // Intervals evaluated
+    };
+
+    /// Constructor
+    RISTNetCongestionMonitor();
+
+    /// Destructor
+    virtual ~RISTNetCongestionMonitor();
+
+    /**
+     * @brief Initialize the monitor
+     *
+     * @param The monitor settings
+     * @return true on success
+     */
+    bool initMonitor(RISTNetCongestionSettings &rSettings);
+
+    /// Count the packets offered to sendData
+    void countOffered(uint64_t lPackets) {
+        mOffered.fetch_add(lPackets, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Push the statistics of a peer
+     *
+     * The statistics of one interval, as librist gives them to the statistics callback. The interval is evaluated
+     * when all peers have reported, or when the next interval starts.
+     *
+     * @param the sender peer statistics
+     * @param the time, now
+     */
+    void pushStatistics(const rist_stats_sender_peer &rStatistics,
+                        std::chrono::steady_clock::time_point lNow = std::chrono::steady_clock::now());
+
+    /// The target bitrate (bps), lock free
+    uint64_t getTargetBitrate() {
+        return mTargetBitrate.load(std::memory_order_relaxed);
+    }
+
+    /// Get the last evaluation
+    void getSnapshot(CongestionSnapshot &rSnapshot);
+
+    /// Called when the target bitrate changes, from the statistics callback of librist
+    std::function<void(const CongestionSnapshot &rSnapshot)> congestionCallback = nullptr;
+
+    // Delete copy and move constructors and assign operators
+    RISTNetCongestionMonitor(RISTNetCongestionMonitor const &) = delete;             // Copy construct
+    RISTNetCongestionMonitor(RISTNetCongestionMonitor &&) = delete;                  // Move construct
+    RISTNetCongestionMonitor &operator=(RISTNetCongestionMonitor const &) = delete;  // Copy assign
+    RISTNetCongestionMonitor &operator=(RISTNetCongestionMonitor &&) = delete;       // Move assign
+
+private:
+
+    struct PeerState {
+        uint64_t mSent = 0;                     // Of the interval
+        uint64_t mRetransmitted = 0;
+        uint64_t mBandwidth = 0;
+        uint32_t mRtt = 0;
+        uint32_t mBaseRtt = UINT32_MAX;         // Lowest RTT of the window
+        uint32_t mWindowRtt = UINT32_MAX;       // Lowest RTT since the window started
+        std::chrono::steady_clock::time_point mWindowStart;
+        std::chrono::steady_clock::time_point mLastReport;
+        bool mFresh = false;                    // Reported since the last evaluation
+    };
+
+    void evaluate(std::chrono::steady_clock::time_point lNow);
+
+    RISTNetCongestionSettings mSettings;
+    std::mutex mMtx;
+    std::map<uint32_t, PeerState> mPeers;
+    std::chrono::steady_clock::time_point mLastReport;
+    uint32_t mClearIntervals = 0;
+    double mQueueGrowth = 0.0;                  // Smoothed
+    CongestionSnapshot mSnapshot;
+    std::atomic<uint64_t> mOffered{0};
+    std::atomic<uint64_t> mTargetBitrate{0};
+};
+
+#endif //CPPRISTWRAPPER__RISTNETCONGESTIONMONITOR_H
@@ -0,0 +1,226 @@
+//
+// RISTNetControlChannel -- Framed control messages over OOB, typed, with request/response correlation
+//
+
+#include "RISTNetControlChannel.h"
+#include "RISTNetInternal.h"
+#include <cstring>
+
+#define CONTROL_FRAME_BUFFERS 4
+
+RISTNetControlChannel::RISTNetControlChannel() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetControlChannel constructed")
+}
+
+RISTNetControlChannel::~RISTNetControlChannel() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetControlChannel destruct")
+}
+
+bool RISTNetControlChannel::setHandler(uint16_t lType, std::function<void(const ControlMessage &rMessage)> lHandler) {
+    if (mReceiver || mSender) {
+        LOGGER(true, LOGG_ERROR, "Handlers are set before attaching.")
+        return false;
+    }
+    if (lType >= kMaxTypes) {
+        LOGGER(true, LOGG_ERROR, "Message type not valid: " << lType)
+        return false;
+    }
+    mHandlers[lType] = std::move(lHandler);
+    return true;
+}
+
+bool RISTNetControlChannel::attachReceiver(RISTNetReceiver &rReceiver) {
+    if (mReceiver || mSender) {
+        LOGGER(true, LOGG_ERROR, "RISTNetControlChannel already attached.")
+        return false;
+    }
+    mReceiver = &rReceiver;
+    rReceiver.networkOOBDataCallback = [this](const uint8_t *pBuf, size_t lSize,
+                                              std::shared_ptr<RISTNetReceiver::NetworkConnection> &rConnection,
+                                              rist_peer *pPeer) {
+        receiveFrame(pBuf, lSize, pPeer);
+    };
+    return true;
+}
+
+bool RISTNetControlChannel::attachSender(RISTNetSender &rSender) {
+    if (mReceiver || mSender) {
+        LOGGER(true, LOGG_ERROR, "RISTNetControlChannel already attached.")
+        return false;
+    }
+    mSender = &rSender;
+    rSender.networkOOBDataCallback = [this](const uint8_t *pBuf, size_t lSize,
+                                            std::shared_ptr<RISTNetSender::NetworkConnection> &rConnection,
+                                            rist_peer *pPeer) {
+        receiveFrame(pBuf, lSize, pPeer);
+    };
+    return true;
+}
+
+bool RISTNetControlChannel::sendFrame(rist_peer *pPeer, uint8_t lKind, uint16_t lType, uint32_t lID,
+                                      const uint8_t *pData, size_t lSize) {
+    if (!mReceiver && !mSender) {
+        LOGGER(true, LOGG_ERROR, "RISTNetControlChannel not attached.")
+        return false;
+    }
+    // Grow to the largest frame once per thread. A handler responding from within sendOOBData (a transport
+    // delivering on the sending thread) gets the next buffer, deeper than that is allocated.
+    thread_local std::vector<uint8_t> lFrames[CONTROL_FRAME_BUFFERS];
+    thread_local size_t lDepth = 0;
+    std::vector<uint8_t> lOverflowFrame;
+    std::vector<uint8_t> &lFrame = lDepth < CONTROL_FRAME_BUFFERS ? lFrames[lDepth] : lOverflowFrame;
+    lFrame.resize(kHeaderSize + lSize);
+    uint8_t *pFrame = lFrame.data();
+    pFrame[0] = kControlMarker;
+    pFrame[1] = lKind;
+    pFrame[2] = lType & 0xff;
+    pFrame[3] = lType >> 8;
+    pFrame[4] = lID & 0xff;
+    pFrame[5] = (lID >> 8) & 0xff;
+    pFrame[6] = (lID >> 16) & 0xff;
+    pFrame[7] = lID >> 24;
+    if (lSize) {
+        memcpy(pFrame + kHeaderSize, pData, lSize);
+    }
+    lDepth++;
+    bool lSent = mReceiver ? mReceiver->sendOOBData(pPeer, pFrame, lFrame.size())
+                           : mSender->sendOOBData(pPeer, pFrame, lFrame.size());
+    lDepth--;
+    if (!lSent) {
+        mSendErrors++;
+        return false;
+    }
+    mSent++;
+    return true;
+}
+
+bool RISTNetControlChannel::notify(rist_peer *pPeer, uint16_t lType, const uint8_t *pData, size_t lSize) {
+    return sendFrame(pPeer, kNotify, lType, 0, pData, lSize);
+}
+
+uint32_t RISTNetControlChannel::request(rist_peer *pPeer, uint16_t lType, const uint8_t *pData, size_t lSize,
+                                        uint64_t lUserData) {
+    uint32_t lID;
+    uint32_t lPushedOutID = 0;
+    uint64_t lPushedOutUserData = 0;
+    {
+        std::lock_guard<std::mutex> lLock(mPendingMtx);
+        lID = mNextID++;
+        if (!mNextID) {
+            mNextID = 1;
+        }
+        PendingRequest &rPending = mPending[lID % kMaxPending];
+        if (rPending.mID) {
+            lPushedOutID = rPending.mID;
+            lPushedOutUserData = rPending.mUserData;
+        }
+        rPending.mID = lID;
+        rPending.pPeer = pPeer;
+        rPending.mUserData = lUserData;
+        rPending.mSent = std::chrono::steady_clock::now();
+    }
+    if (lPushedOutID) {
+        mTimeouts++;
+        if (timeoutCallback) {
+            timeoutCallback(lPushedOutID, lPushedOutUserData);
+        }
+    }
+    mRequests++;
+    if (!sendFrame(pPeer, kRequest, lType, lID, pData, lSize)) {
+        std::lock_guard<std::mutex> lLock(mPendingMtx);
+        PendingRequest &rPending = mPending[lID % kMaxPending];
+        if (rPending.mID == lID) {
+            rPending.mID = 0;
+        }
+        return 0;
+    }
+    return lID;
+}
+
+bool RISTNetControlChannel::respond(const ControlMessage &rRequest, const uint8_t *pData, size_t lSize) {
+    if (rRequest.mKind != kRequest) {
+        LOGGER(true, LOGG_ERROR, "Not a request.")
+        return false;
+    }
+    return sendFrame(rRequest.pPeer, kResponse, rRequest.mType, rRequest.mID, pData, lSize);
+}
+
+void RISTNetControlChannel::receiveFrame(const uint8_t *pBuf, size_t lSize, rist_peer *pPeer) {
+    if (lSize < kHeaderSize || pBuf[0] != kControlMarker || pBuf[1] > kResponse) {
+        mInvalid++;
+        return;
+    }
+    mReceived++;
+    ControlMessage lMessage;
+    lMessage.mKind = pBuf[1];
+    lMessage.mType = pBuf[2] | (pBuf[3] << 8);
+    lMessage.mID = pBuf[4] | (pBuf[5] << 8) | (pBuf[6] << 16) | ((uint32_t) pBuf[7] << 24);
+    lMessage.pPayload = pBuf + kHeaderSize;
+    lMessage.mSize = lSize - kHeaderSize;
+    lMessage.pPeer = pPeer;
+
+    if (lMessage.mKind == kResponse) {
+        uint64_t lUserData;
+        std::chrono::steady_clock::time_point lSent;
+        {
+            std::lock_guard<std::mutex> lLock(mPendingMtx);
+            // The full ID, not only the slot, and the peer asked, a stale or foreign response completes nothing
+            PendingRequest &rPending = mPending[lMessage.mID % kMaxPending];
+            if (!lMessage.mID || rPending.mID != lMessage.mID || (rPending.pPeer && rPending.pPeer != pPeer)) {
+                mUnmatched++;
+                return;
+            }
+            rPending.mID = 0;
+            lUserData = rPending.mUserData;
+            lSent = rPending.mSent;
+        }
+        mResponses++;
+        if (responseCallback) {
+            responseCallback(lMessage, lUserData, std::chrono::steady_clock::now() - lSent);
+        }
+        return;
+    }
+
+    if (lMessage.mType >= kMaxTypes || !mHandlers[lMessage.mType]) {
+        mUnhandled++;
+        return;
+    }
+    mHandlers[lMessage.mType](lMessage);
+}
+
+size_t RISTNetControlChannel::expireRequests(std::chrono::microseconds lTimeout) {
+    auto lOldest = std::chrono::steady_clock::now() - lTimeout;
+    size_t lExpired = 0;
+    for (size_t i = 0; i < kMaxPending; i++) {
+        uint32_t lID;
+        uint64_t lUserData;
+        {
+            std::lock_guard<std::mutex> lLock(mPendingMtx);
+            PendingRequest &rPending = mPending[i];
+            if (!rPending.mID || rPending.mSent > lOldest) {
+                continue;
+            }
+            lID = rPending.mID;
+            lUserData = rPending.mUserData;
+            rPending.mID = 0;
+        }
+        lExpired++;
+        mTimeouts++;
+        if (timeoutCallback) {
+            timeoutCallback(lID, lUserData);
+        }
+    }
+    return lExpired;
+}
+
+void RISTNetControlChannel::getStatistics(ControlStatistics &rStatistics) {
+    rStatistics.mSent = mSent;
+    rStatistics.mReceived = mReceived;
+    rStatistics.mRequests = mRequests;
+    rStatistics.mResponses = mResponses;
+    rStatistics.mUnmatched = mUnmatched;
+    rStatistics.mTimeouts = mTimeouts;
+    rStatistics.mInvalid = mInvalid;
+    rStatistics.mUnhandled = mUnhandled;
+    rStatistics.mSendErrors = mSendErrors;
+}
@@ -0,0 +1,195 @@
+//
+// RISTNetControlChannel -- Framed control messages over OOB, typed, with request/response correlation
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+// k constant
+
+#ifndef CPPRISTWRAPPER__RISTNETCONTROLCHANNEL_H
+#define CPPRISTWRAPPER__RISTNETCONTROLCHANNEL_H
+
+#include "RISTNet.h"
+#include <array>
+
+// A control frame, the OOB payload
+//
+//   uint8_t  marker         kControlMarker
+//   uint8_t  kind           kNotify, kRequest or kResponse
+//   uint16_t type           the message type, little endian
+//   uint32_t id             the correlation ID of a request and its response, 0 for notifications, little endian
+//   the message payload
+
+/**
+ * \class RISTNetControlChannel
+ *
+ * \brief
+ *
+ * Typed control messages (bitrate requests, keyframe requests...) over the OOB data of a receiver or a sender,
+ * in both directions. Messages are dispatched to the handler of their type, requests are matched to their
+ * response. Nothing is allocated per message: the handlers and the requests pending are in fixed tables and
+ * frames are built in a per thread buffer. Handlers are called from the OOB callback of the receiver/sender.
+ *
+ */
+class RISTNetControlChannel {
+public:
+
+    static constexpr uint8_t kControlMarker = 0xC7;
+    static constexpr size_t kHeaderSize = 8;
+    static constexpr size_t kMaxTypes = 256;        // Message types 0 to kMaxTypes - 1
+    static constexpr size_t kMaxPending = 1024;     // Requests waiting for a response, the oldest is timed out
+
+    static constexpr uint8_t kNotify = 0;
+    static constexpr uint8_t kRequest = 1;
+    static constexpr uint8_t kResponse = 2;
+
+    struct ControlMessage {
+        uint8_t mKind = kNotify;
+        uint16_t mType = 0;
+        uint32_t mID = 0;                       // Correlation ID, 0 for notifications
+        const uint8_t *pPayload = nullptr;      // Valid during the handler only
+        size_t mSize = 0;
+        rist_peer *pPeer = nullptr;             // The peer it came from, respond() sends the response there
+    };
+
+    struct ControlStatistics {
+        uint64_t mSent = 0;                 // Frames sent
+        uint64_t mReceived = 0;             // Frames received
+        uint64_t mRequests = 0;             // Requests sent
+        uint64_t mResponses = 0;            // Responses matched to a request
+        uint64_t mUnmatched = 0;            // Responses to no request pending (late or duplicate)
+        uint64_t mTimeouts = 0;             // Requests expired or pushed out of the table
+        uint64_t mInvalid = 0;              // OOB data not a control frame
+        uint64_t mUnhandled = 0;            // Frames of a type without handler
+        uint64_t mSendErrors = 0;
+    };
+
+    /// Constructor
+    RISTNetControlChannel();
+
+    /// Destructor
+    virtual ~RISTNetControlChannel();
+
+    /**
+     * @brief Set a handler
+     *
+     * Called for the notifications and requests of the type, respond to a request with respond().
+     * The handlers are set before attaching.
+     *
+     * @param the message type
+     * @param the handler
+     * @return true on success
+     */
+    bool setHandler(uint16_t lType, std::function<void(const ControlMessage &rMessage)> lHandler);
+
+    /**
+     * @brief Attach a receiver
+     *
+     * The control channel then uses the OOB data of the receiver. Sets networkOOBDataCallback.
+     * The control channel must outlive the receiver.
+     *
+     * @param the receiver
+     * @return true on success
+     */
+    bool attachReceiver(RISTNetReceiver &rReceiver);
+
+    /// Attach a sender, see above
+    bool attachSender(RISTNetSender &rSender);
+
+    /**
+     * @brief Send a notification
+     *
+     * @param the peer
+     * @param the message type
+     * @param the payload
+     * @param the size
+     * @return true on success
+     */
+    bool notify(rist_peer *pPeer, uint16_t lType, const uint8_t *pData, size_t lSize);
+
+    /**
+     * @brief Send a request
+     *
+     * responseCallback gets the response with lUserData, unless the request times out. Only a response of the peer
+     * the request was sent to (any peer if nullptr) with the same correlation ID completes it.
+     *
+     * @param the peer
+     * @param the message type
+     * @param the payload
+     * @param the size
+     * @param given back with the response
+     * @return the correlation ID, 0 on failure
+     */
+    uint32_t request(rist_peer *pPeer, uint16_t lType, const uint8_t *pData, size_t lSize, uint64_t lUserData = 0);
+
+    /**
+     * @brief Respond to a request
+     *
+     * @param the request, as given to the handler
+     * @param the payload
+     * @param the size
+     * @return true on success
+     */
+    bool respond(const ControlMessage &rRequest, const uint8_t *pData, size_t lSize);
+
+    /**
+     * @brief Expire the requests
+     *
+     * Call it now and then, timeoutCallback is called for the requests older than lTimeout.
+     *
+     * @param the timeout
+     * @return the requests expired
+     */
+    size_t expireRequests(std::chrono::microseconds lTimeout);
+
+    /// Get the control channel statistics
+    void getStatistics(ControlStatistics &rStatistics);
+
+    /// Called with the response to a request, the user data of the request and the round trip time
+    std::function<void(const ControlMessage &rResponse, uint64_t lUserData, std::chrono::nanoseconds lRoundTrip)>
+        responseCallback = nullptr;
+
+    /// Called for a request without response
+    std::function<void(uint32_t lID, uint64_t lUserData)> timeoutCallback = nullptr;
+
+    // Delete copy and move constructors and assign operators
+    RISTNetControlChannel(RISTNetControlChannel const &) = delete;             // Copy construct
+    RISTNetControlChannel(RISTNetControlChannel &&) = delete;                  // Move construct
+    RISTNetControlChannel &operator=(RISTNetControlChannel const &) = delete;  // Copy assign
+    RISTNetControlChannel &operator=(RISTNetControlChannel &&) = delete;       // Move assign
+
+private:
+
+    struct PendingRequest {
+        uint32_t mID = 0;               // 0 when free
+        rist_peer *pPeer = nullptr;     // Only a response of this peer completes it, any if nullptr
+        uint64_t mUserData = 0;
+        std::chrono::steady_clock::time_point mSent;
+    };
+
+    bool sendFrame(rist_peer *pPeer, uint8_t lKind, uint16_t lType, uint32_t lID, const uint8_t *pData, size_t lSize);
+    void receiveFrame(const uint8_t *pBuf, size_t lSize, rist_peer *pPeer);
+
+    RISTNetReceiver *mReceiver = nullptr;
+    RISTNetSender *mSender = nullptr;
+    std::array<std::function<void(const ControlMessage &rMessage)>, kMaxTypes> mHandlers;
+
+    std::mutex mPendingMtx;
+    std::array<PendingRequest, kMaxPending> mPending;
+    uint32_t mNextID = 1;
+
+    std::atomic<uint64_t> mSent{0};
+    std::atomic<uint64_t> mReceived{0};
+    std::atomic<uint64_t> mRequests{0};
+    std::atomic<uint64_t> mResponses{0};
+    std::atomic<uint64_t> mUnmatched{0};
+    std::atomic<uint64_t> mTimeouts{0};
+    std::atomic<uint64_t> mInvalid{0};
+    std::atomic<uint64_t> mUnhandled{0};
+    std::atomic<uint64_t> mSendErrors{0};
+};
+
+#endif //CPPRISTWRAPPER__RISTNETCONTROLCHANNEL_H
@@ -0,0 +1,555 @@
+//
+// RISTNetCoroutine -- C++20 coroutine interface of the receiver and sender
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+// k constant
+
+#ifndef CPPRISTWRAPPER__RISTNETCOROUTINE_H
+#define CPPRISTWRAPPER__RISTNETCOROUTINE_H
+
+#if !defined(__cpp_impl_coroutine)
+#error "RISTNetCoroutine.h needs C++20 coroutines"
+#endif
+
+#include "RISTNet.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <thread>
+
+/**
+ * \class RISTNetExecutor
+ *
+ * \brief
+ *
+ * Where the coroutines awaiting the receiver and sender are resumed. post() is called from the librist and
+ * wrapper threads, the executor resumes the coroutine on a thread of its own.
+ *
+ */
+class RISTNetExecutor {
+public:
+    virtual ~RISTNetExecutor() = default;
+
+    /// Resume the coroutine on the executor, called from any thread
+    virtual void post(std::coroutine_handle<> lHandle) = 0;
+
+    /// co_await schedule() continues the coroutine on the executor
+    auto schedule() {
+        struct ScheduleAwaiter {
+            RISTNetExecutor *pExecutor;
+            bool await_ready() { return false; }
+            void await_suspend(std::coroutine_handle<> lHandle) { pExecutor->post(lHandle); }
+            void await_resume() {}
+        };
+        return ScheduleAwaiter{this};
+    }
+};
+
+/**
+ * \class RISTNetLoopExecutor
+ *
+ * \brief
+ *
+ * An executor resuming the coroutines on the thread calling run() or poll(), one thread at a time. The posted
+ * coroutines wait in a ring allocated up front, it only grows when more than lCapacity wait at once.
+ *
+ */
+class RISTNetLoopExecutor : public RISTNetExecutor {
+public:
+
+    explicit RISTNetLoopExecutor(size_t lCapacity = 1024) : mReady(lCapacity ? lCapacity : 1) {}
+
+    void post(std::coroutine_handle<> lHandle) override {
+        {
+            std::lock_guard<std::mutex> lLock(mReadyMtx);
+            if (mReadyCount == mReady.size()) {
+                growReady();
+            }
+            mReady[(mReadyHead + mReadyCount) % mReady.size()] = lHandle;
+            mReadyCount++;
+        }
+        mReadyCondition.notify_one();
+    }
+
+    /// Resume the posted coroutines until stop() is called
+    void run() {
+        while (true) {
+            size_t lTaken;
+            {
+                std::unique_lock<std::mutex> lLock(mReadyMtx);
+                mReadyCondition.wait(lLock, [&]() { return mStop || mReadyCount; });
+                if (!mReadyCount) {
+                    mStop = false;
+                    return;
+                }
+                lTaken = takeReady(mResuming.size());
+            }
+            resumeTaken(lTaken);
+        }
+    }
+
+    /// Resume the coroutines posted so far, does not block
+    size_t poll() {
+        size_t lLeft;
+        {
+            std::lock_guard<std::mutex> lLock(mReadyMtx);
+            lLeft = mReadyCount;
+        }
+        size_t lResumed = 0;
+        while (lLeft) {
+            size_t lTaken;
+            {
+                std::lock_guard<std::mutex> lLock(mReadyMtx);
+                lTaken = takeReady(std::min(lLeft, mResuming.size()));
+            }
+            resumeTaken(lTaken);
+            lResumed += lTaken;
+            lLeft -= lTaken;
+        }
+        return lResumed;
+    }
+
+    /// Make run() return when nothing is left to resume
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lLock(mReadyMtx);
+            mStop = true;
+        }
+        mReadyCondition.notify_one();
+    }
+
+private:
+    // Holding mReadyMtx, moves up to lMax handles to mResuming
+    size_t takeReady(size_t lMax) {
+        size_t lTaken = std::min(lMax, mReadyCount);
+        for (size_t i = 0; i < lTaken; i++) {
+            mResuming[i] = mReady[mReadyHead];
+            mReadyHead = (mReadyHead + 1) % mReady.size();
+        }
+        mReadyCount -= lTaken;
+        return lTaken;
+    }
+
+    void resumeTaken(size_t lTaken) {
+        for (size_t i = 0; i < lTaken; i++) {
+            mResuming[i].resume();
+        }
+    }
+
+    // Holding mReadyMtx, the ring is full
+    void growReady() {
+        std::vector<std::coroutine_handle<>> lReady(mReady.size() * 2);
+        for (size_t i = 0; i < mReadyCount; i++) {
+            lReady[i] = mReady[(mReadyHead + i) % mReady.size()];
+        }
+        mReady.swap(lReady);
+        mReadyHead = 0;
+    }
+
+    std::mutex mReadyMtx;
+    std::condition_variable mReadyCondition;
+    std::vector<std::coroutine_handle<>> mReady;                // Ring of mReadyCount from mReadyHead
+    size_t mReadyHead = 0;
+    size_t mReadyCount = 0;
+    std::array<std::coroutine_handle<>, 64> mResuming;          // run() / poll() thread only
+    bool mStop = false;
+};
+
+/**
+ * \class RISTNetTask
+ *
+ * \brief
+ *
+ * The return type of a detached coroutine. It starts at once and frees itself when it returns.
+ *
+ */
+struct RISTNetTask {
+    struct promise_type {
+        RISTNetTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+/**
+ * \class RISTNetCoChannel
+ *
+ * \brief
+ *
+ * A bounded queue from the librist threads to one coroutine awaiting pop(). The slots are allocated up front,
+ * a full queue drops. close() resumes the awaiting coroutine with a empty value.
+ *
+ */
+template<typename T>
+class RISTNetCoChannel {
+public:
+
+    class PopAwaiter {
+    public:
+        explicit PopAwaiter(RISTNetCoChannel &rChannel) : pChannel(&rChannel) {}
+        bool await_ready() { return false; }
+        bool await_suspend(std::coroutine_handle<> lHandle) {
+            std::lock_guard<std::mutex> lLock(pChannel->mChannelMtx);
+            if (pChannel->mCount) {
+                mValue = std::move(pChannel->mSlots[pChannel->mHead]);
+                pChannel->mHead = (pChannel->mHead + 1) % pChannel->mSlots.size();
+                pChannel->mCount--;
+                return false;
+            }
+            if (pChannel->mClosed) {
+                return false;
+            }
+            mHandle = lHandle;
+            pChannel->pWaiter = this;
+            return true;
+        }
+        T await_resume() { return std::move(mValue); }
+
+    private:
+        friend class RISTNetCoChannel;
+        RISTNetCoChannel *pChannel;
+        std::coroutine_handle<> mHandle;
+        T mValue{};
+    };
+
+    RISTNetCoChannel(RISTNetExecutor &rExecutor, size_t lSize) : pExecutor(&rExecutor), mSlots(lSize ? lSize : 1) {}
+
+    /// Queue a value or hand it to the awaiting coroutine, false if dropped or closed
+    bool push(T &&rValue) {
+        std::coroutine_handle<> lResume;
+        {
+            std::lock_guard<std::mutex> lLock(mChannelMtx);
+            if (mClosed) {
+                return false;
+            }
+            if (pWaiter) {
+                pWaiter->mValue = std::move(rValue);
+                lResume = pWaiter->mHandle;
+                pWaiter = nullptr;
+            } else if (mCount == mSlots.size()) {
+                mDropped++;
+                return false;
+            } else {
+                mSlots[(mHead + mCount) % mSlots.size()] = std::move(rValue);
+                mCount++;
+            }
+        }
+        if (lResume) {
+            pExecutor->post(lResume);
+        }
+        return true;
+    }
+
+    PopAwaiter pop() { return PopAwaiter(*this); }
+
+    void close() {
+        std::coroutine_handle<> lResume;
+        {
+            std::lock_guard<std::mutex> lLock(mChannelMtx);
+            mClosed = true;
+            if (pWaiter) {
+                lResume = pWaiter->mHandle;
+                pWaiter = nullptr;
+            }
+        }
+        if (lResume) {
+            pExecutor->post(lResume);
+        }
+    }
+
+    uint64_t getDropped() {
+        std::lock_guard<std::mutex> lLock(mChannelMtx);
+        return mDropped;
+    }
+
+private:
+    RISTNetExecutor *pExecutor;
+    std::mutex mChannelMtx;
+    std::vector<T> mSlots;
+    size_t mHead = 0;
+    size_t mCount = 0;
+    PopAwaiter *pWaiter = nullptr;
+    bool mClosed = false;
+    uint64_t mDropped = 0;
+};
+
+/**
+ * \class RISTNetCoReceiver
+ *
+ * \brief
+ *
+ * Awaitable receive and connection events of a RISTNetReceiver. One coroutine at a time may await read() and
+ * one nextConnection(). Packets arriving while the queue is full are dropped. Must outlive the receiver.
+ *
+ */
+class RISTNetCoReceiver {
+public:
+
+    // A received packet, mData is empty when closed
+    struct CoPacket {
+        RISTNetPacketBuffer mData;
+        std::shared_ptr<RISTNetReceiver::NetworkConnection> mConnection;
+        rist_peer *pPeer = nullptr;
+        uint16_t mConnectionID = 0;
+    };
+
+    // An accepted connection, mConnection is empty when closed
+    struct CoConnection {
+        std::shared_ptr<RISTNetReceiver::NetworkConnection> mConnection;
+        std::string mIPAddress;
+        uint16_t mPort = 0;
+    };
+
+    RISTNetCoReceiver(RISTNetExecutor &rExecutor, size_t lQueueSize = 1024) :
+            mPackets(rExecutor, lQueueSize), mConnections(rExecutor, 64) {}
+
+    /**
+     * @brief Attach to a receiver
+     *
+     * Sets networkBufferCallback. validateConnectionCallback must be set before, it still decides on the
+     * connections. Attach before initReceiver.
+     *
+     * @param The receiver
+     */
+    void attachReceiver(RISTNetReceiver &rReceiver) {
+        rReceiver.networkBufferCallback = [this](RISTNetPacketBuffer &rBuffer,
+                                                 std::shared_ptr<RISTNetReceiver::NetworkConnection> &rConnection,
+                                                 rist_peer *pPeer, uint16_t lConnectionID) {
+            mPackets.push(CoPacket{std::move(rBuffer), rConnection, pPeer, lConnectionID});
+            return 0;
+        };
+        auto lValidate = rReceiver.validateConnectionCallback;
+        rReceiver.validateConnectionCallback = [this, lValidate](const std::string &rIPAddress, uint16_t lPort) {
+            auto lConnection = lValidate ? lValidate(rIPAddress, lPort) : nullptr;
+            if (lConnection) {
+                mConnections.push(CoConnection{lConnection, rIPAddress, lPort});
+            }
+            return lConnection;
+        };
+    }
+
+    /// co_await read() gives the next packet
+    RISTNetCoChannel<CoPacket>::PopAwaiter read() { return mPackets.pop(); }
+
+    /// co_await nextConnection() gives the next accepted connection
+    RISTNetCoChannel<CoConnection>::PopAwaiter nextConnection() { return mConnections.pop(); }
+
+    /// Resume the awaiting coroutines with empty results, no more packets are queued
+    void close() {
+        mPackets.close();
+        mConnections.close();
+    }
+
+    /// Packets dropped because the queue was full
+    uint64_t getDropped() { return mPackets.getDropped(); }
+
+    // Delete copy and move constructors and assign operators
+    RISTNetCoReceiver(RISTNetCoReceiver const &) = delete;             // Copy construct
+    RISTNetCoReceiver(RISTNetCoReceiver &&) = delete;                  // Move construct
+    RISTNetCoReceiver &operator=(RISTNetCoReceiver const &) = delete;  // Copy assign
+    RISTNetCoReceiver &operator=(RISTNetCoReceiver &&) = delete;       // Move assign
+
+private:
+    RISTNetCoChannel<CoPacket> mPackets;
+    RISTNetCoChannel<CoConnection> mConnections;
+};
+
+/**
+ * \class RISTNetCoSender
+ *
+ * \brief
+ *
+ * Awaitable sends to a RISTNetSender. The packets are copied to pool buffers and queued for a thread
+ * calling sendData, a full queue suspends the sending coroutines until there is room (backpressure)
+ * instead of failing. The packets are sent in the order the sends completed. The queue is a ring of
+ * lQueueSize slots allocated up front.
+ *
+ */
+class RISTNetCoSender {
+public:
+
+    class SendAwaiter {
+    public:
+        bool await_ready() { return !mBuffer; }
+        bool await_suspend(std::coroutine_handle<> lHandle) {
+            std::lock_guard<std::mutex> lLock(pSender->mQueueMtx);
+            if (pSender->mClosed) {
+                return false;
+            }
+            if (pSender->mQueueCount < pSender->mQueue.size()) {
+                pSender->pushQueue(std::move(mBuffer), mConnectionID);
+                pSender->mQueueCondition.notify_one();
+                mQueued = true;
+                return false;
+            }
+            // Wait in line, the send thread queues the buffer when there is room
+            mHandle = lHandle;
+            if (pSender->pLastWaiter) {
+                pSender->pLastWaiter->pNext = this;
+            } else {
+                pSender->pFirstWaiter = this;
+            }
+            pSender->pLastWaiter = this;
+            return true;
+        }
+        /// True if queued, false if the pool is exhausted or the sender closed
+        bool await_resume() { return mQueued; }
+
+    private:
+        friend class RISTNetCoSender;
+        SendAwaiter(RISTNetCoSender &rSender, RISTNetPacketBuffer &&rBuffer, uint16_t lConnectionID) :
+                pSender(&rSender), mBuffer(std::move(rBuffer)), mConnectionID(lConnectionID) {}
+
+        RISTNetCoSender *pSender;
+        RISTNetPacketBuffer mBuffer;
+        uint16_t mConnectionID;
+        bool mQueued = false;
+        std::coroutine_handle<> mHandle;
+        SendAwaiter *pNext = nullptr;
+    };
+
+    RISTNetCoSender(RISTNetExecutor &rExecutor, size_t lQueueSize = 1024, RISTNetPacketPool *pPool = nullptr) :
+            pExecutor(&rExecutor), pPool(pPool ? pPool : &RISTNetPacketPool::defaultPool()),
+            mQueue(lQueueSize ? lQueueSize : 1) {}
+
+    virtual ~RISTNetCoSender() { close(); }
+
+    /// Attach to a sender and start the send thread
+    bool attachSender(RISTNetSender &rSender) {
+        return attachSendFunction([&rSender](const uint8_t *pData, size_t lSize, uint16_t lConnectionID) {
+            return rSender.sendData(pData, lSize, lConnectionID);
+        });
+    }
+
+    /// Attach to a send function (sendData of a sender or a stand-in) and start the send thread
+    bool attachSendFunction(std::function<bool(const uint8_t *pData, size_t lSize, uint16_t lConnectionID)> lSendFunction) {
+        if (!lSendFunction || mSendThread.joinable()) {
+            return false;
+        }
+        mSendFunction = std::move(lSendFunction);
+        mSendThread = std::thread(&RISTNetCoSender::sendThread, this);
+        return true;
+    }
+
+    /// co_await send(...) queues a copy of the data, suspends while the queue is full
+    SendAwaiter send(const uint8_t *pData, size_t lSize, uint16_t lConnectionID = 0) {
+        return SendAwaiter(*this, pPool->copy(pData, lSize), lConnectionID);
+    }
+
+    /// co_await send(...) queues the buffer, suspends while the queue is full
+    SendAwaiter send(RISTNetPacketBuffer &&rBuffer, uint16_t lConnectionID = 0) {
+        return SendAwaiter(*this, std::move(rBuffer), lConnectionID);
+    }
+
+    /// Send what is queued and stop the send thread, suspended senders resume with false
+    void close() {
+        SendAwaiter *pWaiters;
+        {
+            std::lock_guard<std::mutex> lLock(mQueueMtx);
+            mClosed = true;
+            pWaiters = pFirstWaiter;
+            pFirstWaiter = nullptr;
+            pLastWaiter = nullptr;
+        }
+        mQueueCondition.notify_one();
+        resumeWaiters(pWaiters);
+        if (mSendThread.joinable()) {
+            mSendThread.join();
+        }
+    }
+
+    /// Packets sendData failed on
+    uint64_t getFailures() { return mFailures; }
+
+    // Delete copy and move constructors and assign operators
+    RISTNetCoSender(RISTNetCoSender const &) = delete;             // Copy construct
+    RISTNetCoSender(RISTNetCoSender &&) = delete;                  // Move construct
+    RISTNetCoSender &operator=(RISTNetCoSender const &) = delete;  // Copy assign
+    RISTNetCoSender &operator=(RISTNetCoSender &&) = delete;       // Move assign
+
+private:
+
+    struct QueuedPacket {
+        RISTNetPacketBuffer mBuffer;
+        uint16_t mConnectionID = 0;
+    };
+
+    // Holding mQueueMtx, the ring has room
+    void pushQueue(RISTNetPacketBuffer &&rBuffer, uint16_t lConnectionID) {
+        QueuedPacket &rPacket = mQueue[(mQueueHead + mQueueCount) % mQueue.size()];
+        rPacket.mBuffer = std::move(rBuffer);
+        rPacket.mConnectionID = lConnectionID;
+        mQueueCount++;
+    }
+
+    void resumeWaiters(SendAwaiter *pWaiters) {
+        while (pWaiters) {
+            SendAwaiter *pNext = pWaiters->pNext;
+            pExecutor->post(pWaiters->mHandle);
+            pWaiters = pNext;
+        }
+    }
+
+    void sendThread() {
+        QueuedPacket lPacket;
+        while (true) {
+            SendAwaiter *pResume = nullptr;
+            {
+                std::unique_lock<std::mutex> lLock(mQueueMtx);
+                mQueueCondition.wait(lLock, [&]() { return mClosed || mQueueCount; });
+                if (!mQueueCount) {
+                    return;
+                }
+                lPacket = std::move(mQueue[mQueueHead]);
+                mQueueHead = (mQueueHead + 1) % mQueue.size();
+                mQueueCount--;
+                // The room goes to the first coroutine in line
+                if (pFirstWaiter) {
+                    pResume = pFirstWaiter;
+                    pFirstWaiter = pResume->pNext;
+                    if (!pFirstWaiter) {
+                        pLastWaiter = nullptr;
+                    }
+                    pResume->pNext = nullptr;
+                    pushQueue(std::move(pResume->mBuffer), pResume->mConnectionID);
+                    pResume->mQueued = true;
+                }
+            }
+            if (pResume) {
+                pExecutor->post(pResume->mHandle);
+            }
+            if (!mSendFunction(lPacket.mBuffer.data(), lPacket.mBuffer.size(), lPacket.mConnectionID)) {
+                mFailures++;
+            }
+            lPacket.mBuffer.reset();
+        }
+    }
+
+    RISTNetExecutor *pExecutor;
+    RISTNetPacketPool *pPool;
+    std::function<bool(const uint8_t *pData, size_t lSize, uint16_t lConnectionID)> mSendFunction;
+
+    std::mutex mQueueMtx;
+    std::condition_variable mQueueCondition;
+    std::vector<QueuedPacket> mQueue;           // Ring of mQueueCount from mQueueHead
+    size_t mQueueHead = 0;
+    size_t mQueueCount = 0;
+    SendAwaiter *pFirstWaiter = nullptr;
+    SendAwaiter *pLastWaiter = nullptr;
+    bool mClosed = false;
+    std::thread mSendThread;
+    std::atomic<uint64_t> mFailures{0};
+};
+
+#endif //CPPRISTWRAPPER__RISTNETCOROUTINE_H
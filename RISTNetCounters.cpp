@@ -0,0 +1,36 @@
+//
+// RISTNetCounters -- Per flow and per peer data path counters, single writer, lock-free snapshots
+//
+
+#include "RISTNetCounters.h"
+#include <thread>
+
+void RISTNetCounterTable::getCounters(std::vector<RISTNetCounterSnapshot> &rCounters) const {
+    rCounters.clear();
+    for (const Slot &rSlot: mSlots) {
+        if (!rSlot.mUsed.load(std::memory_order_acquire)) {
+            continue;
+        }
+        RISTNetCounterSnapshot lSnapshot;
+        lSnapshot.mKey = rSlot.mKey.load(std::memory_order_relaxed);
+        while (true) {
+            uint32_t lVersion = rSlot.mVersion.load(std::memory_order_acquire);
+            if (lVersion & 1) {
+                // The writer is in the middle of a update, it is a few instructions long
+                std::this_thread::yield();
+                continue;
+            }
+            lSnapshot.mPackets = rSlot.mPackets.load(std::memory_order_relaxed);
+            lSnapshot.mBytes = rSlot.mBytes.load(std::memory_order_relaxed);
+            lSnapshot.mSeqGaps = rSlot.mSeqGaps.load(std::memory_order_relaxed);
+            lSnapshot.mReordered = rSlot.mReordered.load(std::memory_order_relaxed);
+            lSnapshot.mDiscontinuities = rSlot.mDiscontinuities.load(std::memory_order_relaxed);
+            lSnapshot.mErrors = rSlot.mErrors.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (rSlot.mVersion.load(std::memory_order_relaxed) == lVersion) {
+                break;
+            }
+        }
+        rCounters.push_back(lSnapshot);
+    }
+}
@@ -0,0 +1,170 @@
+//
+// RISTNetCounters -- Per flow and per peer data path counters, single writer, lock-free snapshots
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+// k constant
+
+#ifndef CPPRISTWRAPPER__RISTNETCOUNTERS_H
+#define CPPRISTWRAPPER__RISTNETCOUNTERS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The counters of a flow or a peer at a point in time
+struct RISTNetCounterSnapshot {
+    uint64_t mKey = 0;              // The flow_id, or the rist_peer pointer
+    uint64_t mPackets = 0;
+    uint64_t mBytes = 0;
+    uint64_t mSeqGaps = 0;          // Packets missing between the sequence numbers delivered (flows)
+    uint64_t mReordered = 0;        // Packets older than the last sequence number delivered (flows)
+    uint64_t mDiscontinuities = 0;  // Packets flagged RIST_DATA_FLAGS_DISCONTINUITY (receiver)
+    uint64_t mErrors = 0;           // Callbacks returning not 0 and packets dropped (receiver), failed sends (sender)
+};
+
+/**
+ * \class RISTNetCounterTable
+ *
+ * \brief
+ *
+ * Counters by key (flow_id or peer) written by one thread at a time and read from any thread. Every key has its own
+ * cache line, the writer never takes a lock or a locked instruction and a reader never blocks the writer.
+ * Holds kSlots keys, packets of further keys are only counted by getOverflow().
+ *
+ */
+class RISTNetCounterTable {
+public:
+
+    static constexpr size_t kSlots = 256;       // Power of 2
+    static constexpr int32_t kMaxSeqGap = 65536; // A larger jump is a restarted sender, not a loss
+
+    RISTNetCounterTable() = default;
+
+    /// Count a packet without sequence number. Writer only.
+    void countPacket(uint64_t lKey, size_t lBytes, bool lError, bool lDiscontinuity = false) {
+        Slot *pSlot = findSlot(lKey);
+        if (!pSlot) {
+            return;
+        }
+        beginWrite(*pSlot);
+        addTo(pSlot->mPackets, 1);
+        addTo(pSlot->mBytes, lBytes);
+        addTo(pSlot->mDiscontinuities, lDiscontinuity);
+        addTo(pSlot->mErrors, lError);
+        endWrite(*pSlot);
+    }
+
+    /// Count a packet and check its sequence number against the last one of the key. Writer only.
+    void countPacket(uint64_t lKey, size_t lBytes, bool lError, bool lDiscontinuity, uint64_t lSeq) {
+        Slot *pSlot = findSlot(lKey);
+        if (!pSlot) {
+            return;
+        }
+        uint64_t lGap = 0;
+        uint64_t lReordered = 0;
+        if (pSlot->mHasSeq) {
+            // 32 bit distance, librist sequence numbers wrap at 2^32 or less
+            int32_t lDelta = (int32_t) (uint32_t) (lSeq - pSlot->mNextSeq);
+            if (lDelta < 0 && lDelta > -kMaxSeqGap) {
+                lReordered = 1;
+            } else if (lDelta > 0 && lDelta < kMaxSeqGap) {
+                lGap = lDelta;
+            }
+        }
+        if (!lReordered) {
+            pSlot->mNextSeq = lSeq + 1;
+            pSlot->mHasSeq = true;
+        }
+        beginWrite(*pSlot);
+        addTo(pSlot->mPackets, 1);
+        addTo(pSlot->mBytes, lBytes);
+        addTo(pSlot->mSeqGaps, lGap);
+        addTo(pSlot->mReordered, lReordered);
+        addTo(pSlot->mDiscontinuities, lDiscontinuity);
+        addTo(pSlot->mErrors, lError);
+        endWrite(*pSlot);
+    }
+
+    /// Replace the content of rCounters with a consistent snapshot of every key. Any thread.
+    void getCounters(std::vector<RISTNetCounterSnapshot> &rCounters) const;
+
+    /// Packets not counted because kSlots keys were in use
+    uint64_t getOverflow() const { return mOverflow.load(std::memory_order_relaxed); }
+
+    // Delete copy and move constructors and assign operators
+    RISTNetCounterTable(RISTNetCounterTable const &) = delete;             // Copy construct
+    RISTNetCounterTable(RISTNetCounterTable &&) = delete;                  // Move construct
+    RISTNetCounterTable &operator=(RISTNetCounterTable const &) = delete;  // Copy assign
+    RISTNetCounterTable &operator=(RISTNetCounterTable &&) = delete;       // Move assign
+
+private:
+
+    // A seqlock per slot, the version is odd while the writer updates the counters
+    struct alignas(64) Slot {
+        std::atomic<uint32_t> mVersion{0};
+        std::atomic<bool> mUsed{false};
+        std::atomic<uint64_t> mKey{0};
+        std::atomic<uint64_t> mPackets{0};
+        std::atomic<uint64_t> mBytes{0};
+        std::atomic<uint64_t> mSeqGaps{0};
+        std::atomic<uint64_t> mReordered{0};
+        std::atomic<uint64_t> mDiscontinuities{0};
+        std::atomic<uint64_t> mErrors{0};
+        uint64_t mNextSeq = 0;  // Writer only
+        bool mHasSeq = false;   // Writer only
+    };
+
+    // Single writer, a plain load and store instead of a locked add
+    static void addTo(std::atomic<uint64_t> &rCounter, uint64_t lValue) {
+        rCounter.store(rCounter.load(std::memory_order_relaxed) + lValue, std::memory_order_relaxed);
+    }
+
+    static void beginWrite(Slot &rSlot) {
+        rSlot.mVersion.store(rSlot.mVersion.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    static void endWrite(Slot &rSlot) {
+        rSlot.mVersion.store(rSlot.mVersion.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    Slot *findSlot(uint64_t lKey) {
+        // Consecutive packets are mostly of the same flow and peer
+        if (pLastSlot && mLastKey == lKey) {
+            return pLastSlot;
+        }
+        size_t lIndex = (size_t) ((lKey * 0x9E3779B97F4A7C15ULL) >> 56) & (kSlots - 1);
+        for (size_t i = 0; i < kSlots; i++) {
+            Slot &rSlot = mSlots[(lIndex + i) & (kSlots - 1)];
+            if (!rSlot.mUsed.load(std::memory_order_relaxed)) {
+                rSlot.mKey.store(lKey, std::memory_order_relaxed);
+                rSlot.mUsed.store(true, std::memory_order_release);
+                return remember(lKey, &rSlot);
+            }
+            if (rSlot.mKey.load(std::memory_order_relaxed) == lKey) {
+                return remember(lKey, &rSlot);
+            }
+        }
+        mOverflow.store(mOverflow.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Slot *remember(uint64_t lKey, Slot *pSlot) {
+        mLastKey = lKey;
+        pLastSlot = pSlot;
+        return pSlot;
+    }
+
+    Slot mSlots[kSlots];
+    alignas(64) uint64_t mLastKey = 0;  // Writer only
+    Slot *pLastSlot = nullptr;          // Writer only
+    std::atomic<uint64_t> mOverflow{0};
+};
+
+#endif //CPPRISTWRAPPER__RISTNETCOUNTERS_H
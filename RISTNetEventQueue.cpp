@@ -0,0 +1,44 @@
+//
+// RISTNetEventQueue -- Events of a receiver or sender queued for a reactor thread, signalled by an eventfd
+//
+
+#include "RISTNetEventQueue.h"
+#include "RISTNetInternal.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+bool RISTNetEventSignal::openSignal() {
+    if (mFd >= 0) {
+        LOGGER(true, LOGG_ERROR, "Event signal already open.")
+        return false;
+    }
+    mFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mFd < 0) {
+        LOGGER(true, LOGG_ERROR, "eventfd failed: " << strerror(errno))
+        return false;
+    }
+    return true;
+}
+
+void RISTNetEventSignal::closeSignal() {
+    if (mFd >= 0) {
+        close(mFd);
+        mFd = -1;
+    }
+}
+
+void RISTNetEventSignal::signal() {
+    uint64_t lValue = 1;
+    if (write(mFd, &lValue, sizeof(lValue)) < 0 && errno != EAGAIN) {
+        LOGGER(true, LOGG_ERROR, "eventfd write failed: " << strerror(errno))
+    }
+}
+
+void RISTNetEventSignal::clear() {
+    uint64_t lValue;
+    if (read(mFd, &lValue, sizeof(lValue)) < 0 && errno != EAGAIN) {
+        LOGGER(true, LOGG_ERROR, "eventfd read failed: " << strerror(errno))
+    }
+}
@@ -0,0 +1,149 @@
+//
+// RISTNetEventQueue -- Events of a receiver or sender queued for a reactor thread, signalled by an eventfd
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+// k constant
+
+#ifndef CPPRISTWRAPPER__RISTNETEVENTQUEUE_H
+#define CPPRISTWRAPPER__RISTNETEVENTQUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+// The events of a receiver or sender
+enum class RISTNetEventType {
+    kData,          // Data received (receiver)
+    kOOBData,       // OOB data received
+    kConnect,       // A connection accepted by validateConnectionCallback
+    kDisconnect,
+    kStatistics
+};
+
+/**
+ * \class RISTNetEventSignal
+ *
+ * \brief
+ *
+ * An eventfd readable while signalled.
+ *
+ */
+class RISTNetEventSignal {
+public:
+
+    RISTNetEventSignal() = default;
+    ~RISTNetEventSignal() { closeSignal(); }
+
+    /// Create the eventfd, non-blocking
+    bool openSignal();
+
+    /// Close the eventfd
+    void closeSignal();
+
+    /// Make the eventfd readable
+    void signal();
+
+    /// Make the eventfd not readable
+    void clear();
+
+    /// The eventfd, -1 if not open
+    int getFd() const { return mFd; }
+
+    // Delete copy and move constructors and assign operators
+    RISTNetEventSignal(RISTNetEventSignal const &) = delete;             // Copy construct
+    RISTNetEventSignal(RISTNetEventSignal &&) = delete;                  // Move construct
+    RISTNetEventSignal &operator=(RISTNetEventSignal const &) = delete;  // Copy assign
+    RISTNetEventSignal &operator=(RISTNetEventSignal &&) = delete;       // Move assign
+
+private:
+    int mFd = -1;
+};
+
+/**
+ * \class RISTNetEventQueue
+ *
+ * \brief
+ *
+ * A queue of events pushed by the librist threads and drained in batches by the thread owning the instance.
+ * The eventfd is readable while events are queued, the first event pushed to an empty queue signals it.
+ * Droppable events (data) are dropped when the queue holds the max events, the others are always queued.
+ *
+ */
+template<typename T>
+class RISTNetEventQueue {
+public:
+
+    bool initEventQueue(size_t lMaxEvents) {
+        std::lock_guard<std::mutex> lLock(mQueueMtx);
+        if (!mSignal.openSignal()) {
+            return false;
+        }
+        mMaxEvents = lMaxEvents;
+        mEvents.clear();
+        mEvents.reserve(std::min<size_t>(lMaxEvents, 1024));
+        mDropped = 0;
+        return true;
+    }
+
+    void destroyEventQueue() {
+        std::lock_guard<std::mutex> lLock(mQueueMtx);
+        mSignal.closeSignal();
+        mEvents.clear();
+    }
+
+    int getFd() const { return mSignal.getFd(); }
+
+    /// Queue a event, false if dropped
+    bool push(T &&rEvent, bool lDroppable) {
+        bool lSignal;
+        {
+            std::lock_guard<std::mutex> lLock(mQueueMtx);
+            if (lDroppable && mEvents.size() >= mMaxEvents) {
+                mDropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            lSignal = mEvents.empty();
+            mEvents.push_back(std::move(rEvent));
+        }
+        if (lSignal) {
+            mSignal.signal();
+        }
+        return true;
+    }
+
+    /// Replace the content of rEvents with up to lMaxEvents events, the eventfd stays readable if more are queued
+    size_t drain(std::vector<T> &rEvents, size_t lMaxEvents) {
+        rEvents.clear();
+        mSignal.clear();
+        std::lock_guard<std::mutex> lLock(mQueueMtx);
+        if (mEvents.size() <= lMaxEvents) {
+            // The whole batch, the capacity of rEvents is reused by the next one
+            std::swap(mEvents, rEvents);
+        } else {
+            std::move(mEvents.begin(), mEvents.begin() + lMaxEvents, std::back_inserter(rEvents));
+            mEvents.erase(mEvents.begin(), mEvents.begin() + lMaxEvents);
+            mSignal.signal();
+        }
+        return rEvents.size();
+    }
+
+    uint64_t getDropped() const { return mDropped.load(std::memory_order_relaxed); }
+
+private:
+    RISTNetEventSignal mSignal;
+    std::mutex mQueueMtx;
+    std::vector<T> mEvents;
+    size_t mMaxEvents = 0;
+    std::atomic<uint64_t> mDropped{0};
+};
+
+#endif //CPPRISTWRAPPER__RISTNETEVENTQUEUE_H
@@ -0,0 +1,468 @@
+//
+// RISTNetFileSink -- Recording of received data to disk without blocking the librist threads
+//
+
+#include "RISTNetFileSink.h"
+#include "RISTNetInternal.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef RISTNET_HAVE_LIBURING
+#include <liburing.h>
+struct RISTNetFileSink::IoUringState {
+    struct io_uring mRing;
+    unsigned mDepth = 0;
+};
+#else
+struct RISTNetFileSink::IoUringState {
+};
+#endif
+
+#define DIRECT_IO_ALIGNMENT 4096
+
+RISTNetFileSink::RISTNetFileSink() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetFileSink constructed")
+}
+
+RISTNetFileSink::~RISTNetFileSink() {
+    if (mInitialised) {
+        destroyFileSink();
+    }
+    LOGGER(false, LOGG_NOTIFY, "RISTNetFileSink destruct")
+}
+
+bool RISTNetFileSink::initFileSink(RISTNetFileSinkSettings &rSettings) {
+    if (mInitialised) {
+        LOGGER(true, LOGG_ERROR, "RISTNetFileSink already initialised.")
+        return false;
+    }
+    if (rSettings.mPath.empty() || !rSettings.mBufferSize || rSettings.mBufferCount < 2) {
+        LOGGER(true, LOGG_ERROR, "RISTNetFileSink needs a path and at least two buffers.")
+        return false;
+    }
+    mSettings = rSettings;
+    mSettings.mBufferSize = (rSettings.mBufferSize + DIRECT_IO_ALIGNMENT - 1) & ~(size_t) (DIRECT_IO_ALIGNMENT - 1);
+
+    mBuffers.resize(mSettings.mBufferCount);
+    for (auto &rBuffer: mBuffers) {
+        void *pData = nullptr;
+        if (posix_memalign(&pData, DIRECT_IO_ALIGNMENT, mSettings.mBufferSize)) {
+            LOGGER(true, LOGG_ERROR, "RISTNetFileSink buffer allocation failed.")
+            for (auto &rAllocated: mBuffers) {
+                free(rAllocated.mData);
+            }
+            mBuffers.clear();
+            return false;
+        }
+        rBuffer.mData = (uint8_t *) pData;
+    }
+
+#ifdef RISTNET_HAVE_LIBURING
+    if (mSettings.mUseIoUring) {
+        mIoUring = std::make_unique<IoUringState>();
+        mIoUring->mDepth = mSettings.mBufferCount;
+        if (io_uring_queue_init(mIoUring->mDepth, &mIoUring->mRing, 0) < 0) {
+            LOGGER(true, LOGG_WARN, "io_uring not available, using pwritev.")
+            mIoUring.reset();
+        }
+    }
+#endif
+
+    mSegmentNumber = 0;
+    mBytesWritten = 0;
+    mSegments = 0;
+    mWriteErrors = 0;
+    if (!openSegment()) {
+        for (auto &rBuffer: mBuffers) {
+            free(rBuffer.mData);
+        }
+        mBuffers.clear();
+        mIoUring.reset();
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lLock(mBufferMtx);
+    mFree.clear();
+    mFull.clear();
+    for (auto &rBuffer: mBuffers) {
+        mFree.push_back(&rBuffer);
+    }
+    mCurrent = nullptr;
+    mSegmentBytes = 0;
+    mSegmentStart = std::chrono::steady_clock::now();
+    mStatistics = FileSinkStatistics();
+    mWriterRun = true;
+    mWriterThread = std::thread(&RISTNetFileSink::writerWorker, this);
+    mInitialised = true;
+    return true;
+}
+
+bool RISTNetFileSink::attachReceiver(RISTNetReceiver &rReceiver) {
+    if (!mInitialised) {
+        LOGGER(true, LOGG_ERROR, "RISTNetFileSink not initialised.")
+        return false;
+    }
+    rReceiver.networkDataCallback = [this](const uint8_t *pBuf, size_t lSize,
+                                           std::shared_ptr<RISTNetReceiver::NetworkConnection> &rConnection,
+                                           rist_peer *pPeer, uint16_t lConnectionID) {
+        writeData(pBuf, lSize);
+        return 0;
+    };
+    return true;
+}
+
+bool RISTNetFileSink::writeData(const uint8_t *pBuf, size_t lSize) {
+    std::lock_guard<std::mutex> lLock(mBufferMtx);
+    if (!mWriterRun) {
+        return false;
+    }
+    if (lSize > mSettings.mBufferSize) {
+        mStatistics.mDroppedPackets++;
+        mStatistics.mDroppedBytes += lSize;
+        return false;
+    }
+
+    if (mSegmentBytes && (mSettings.mSegmentMaxBytes || mSettings.mSegmentMaxDuration.count())) {
+        bool lRotate = mSettings.mSegmentMaxBytes && mSegmentBytes + lSize > mSettings.mSegmentMaxBytes;
+        auto lNow = std::chrono::steady_clock::time_point();
+        if (mSettings.mSegmentMaxDuration.count()) {
+            lNow = std::chrono::steady_clock::now();
+            lRotate |= lNow - mSegmentStart >= mSettings.mSegmentMaxDuration;
+        }
+        if (lRotate) {
+            if (!mCurrent) {
+                // The end of segment mark needs a buffer to travel in
+                if (mFree.empty()) {
+                    mStatistics.mDroppedPackets++;
+                    mStatistics.mDroppedBytes += lSize;
+                    return false;
+                }
+                mCurrent = mFree.back();
+                mFree.pop_back();
+            }
+            mCurrent->mEndOfSegment = true;
+            queueCurrent();
+            mSegmentBytes = 0;
+            mSegmentStart = mSettings.mSegmentMaxDuration.count() ? lNow : std::chrono::steady_clock::now();
+        }
+    }
+
+    // Buffers are filled completely, a packet can continue in the next buffer. That keeps the writes aligned.
+    size_t lSpace = mCurrent ? mSettings.mBufferSize - mCurrent->mUsed : 0;
+    if (lSize > lSpace && mFree.empty()) {
+        // The writer is behind, never wait for the disk
+        mStatistics.mDroppedPackets++;
+        mStatistics.mDroppedBytes += lSize;
+        return false;
+    }
+    mSegmentBytes += lSize;
+    mStatistics.mPackets++;
+    mStatistics.mBytes += lSize;
+    while (lSize) {
+        if (!mCurrent) {
+            mCurrent = mFree.back();
+            mFree.pop_back();
+            mCurrentSince = std::chrono::steady_clock::now();
+        }
+        size_t lChunk = std::min(lSize, mSettings.mBufferSize - mCurrent->mUsed);
+        memcpy(mCurrent->mData + mCurrent->mUsed, pBuf, lChunk);
+        mCurrent->mUsed += lChunk;
+        pBuf += lChunk;
+        lSize -= lChunk;
+        if (mCurrent->mUsed == mSettings.mBufferSize) {
+            queueCurrent();
+        }
+    }
+    return true;
+}
+
+void RISTNetFileSink::queueCurrent() {
+    if (!mCurrent) {
+        return;
+    }
+    mFull.push_back(mCurrent);
+    mCurrent = nullptr;
+    mStatistics.mBuffersQueuedMax = std::max(mStatistics.mBuffersQueuedMax, mFull.size());
+    mWriterCondition.notify_one();
+}
+
+bool RISTNetFileSink::openSegment() {
+    std::string lPath = mSettings.mPath;
+    if (mSettings.mSegmentMaxBytes || mSettings.mSegmentMaxDuration.count()) {
+        char lNumber[32];
+        snprintf(lNumber, sizeof(lNumber), "_%06llu", (unsigned long long) mSegmentNumber);
+        size_t lDot = lPath.find_last_of('.');
+        size_t lSlash = lPath.find_last_of('/');
+        if (lDot == std::string::npos || (lSlash != std::string::npos && lDot < lSlash)) {
+            lDot = lPath.size();
+        }
+        lPath.insert(lDot, lNumber);
+    }
+
+    int lFlags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+    if (mSettings.mDirectIO) {
+        lFlags |= O_DIRECT;
+    }
+#endif
+    mFileDescriptor = open(lPath.c_str(), lFlags, 0644);
+    if (mFileDescriptor < 0) {
+        LOGGER(true, LOGG_ERROR, "RISTNetFileSink could not open: " << lPath)
+        mWriteErrors++;
+        return false;
+    }
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+    if (mSettings.mDirectIO) {
+        fcntl(mFileDescriptor, F_NOCACHE, 1);
+    }
+#endif
+    mFileOffset = 0;
+    mSegmentNumber++;
+    mSegments++;
+    return true;
+}
+
+void RISTNetFileSink::closeSegment() {
+    if (mFileDescriptor < 0) {
+        return;
+    }
+    if (mSettings.mFsyncPolicy != FsyncPolicy::kNone) {
+        fsync(mFileDescriptor);
+    }
+    close(mFileDescriptor);
+    mFileDescriptor = -1;
+}
+
+bool RISTNetFileSink::writeFully(const uint8_t *pData, size_t lSize) {
+    while (lSize) {
+        ssize_t lWritten = pwrite(mFileDescriptor, pData, lSize, mFileOffset);
+        if (lWritten < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        pData += lWritten;
+        lSize -= lWritten;
+        mFileOffset += lWritten;
+        mBytesWritten += lWritten;
+    }
+    return true;
+}
+
+bool RISTNetFileSink::writeVectored(std::vector<SinkBuffer *> &rBuffers, size_t lFirst, size_t lCount) {
+    std::vector<iovec> lVectors;
+    lVectors.reserve(lCount);
+    for (size_t i = lFirst; i < lFirst + lCount; i++) {
+        if (rBuffers[i]->mUsed) {
+            lVectors.push_back({rBuffers[i]->mData, rBuffers[i]->mUsed});
+        }
+    }
+    size_t lIndex = 0;
+    while (lIndex < lVectors.size()) {
+        int lVectorCount = (int) std::min<size_t>(lVectors.size() - lIndex, IOV_MAX);
+        ssize_t lWritten = pwritev(mFileDescriptor, &lVectors[lIndex], lVectorCount, mFileOffset);
+        if (lWritten < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        mFileOffset += lWritten;
+        mBytesWritten += lWritten;
+        // Step past what was written, a short write leaves a partial vector
+        while (lWritten > 0) {
+            if ((size_t) lWritten >= lVectors[lIndex].iov_len) {
+                lWritten -= lVectors[lIndex].iov_len;
+                lIndex++;
+            } else {
+                lVectors[lIndex].iov_base = (uint8_t *) lVectors[lIndex].iov_base + lWritten;
+                lVectors[lIndex].iov_len -= lWritten;
+                lWritten = 0;
+            }
+        }
+    }
+    return true;
+}
+
+bool RISTNetFileSink::writeIoUring(std::vector<SinkBuffer *> &rBuffers, size_t lFirst, size_t lCount) {
+#ifdef RISTNET_HAVE_LIBURING
+    struct Pending {
+        const uint8_t *pData;
+        size_t lSize;
+        uint64_t lOffset;
+    };
+    std::vector<Pending> lPending;
+    lPending.reserve(lCount);
+    for (size_t i = lFirst; i < lFirst + lCount; i++) {
+        if (rBuffers[i]->mUsed) {
+            lPending.push_back({rBuffers[i]->mData, rBuffers[i]->mUsed, mFileOffset});
+            mFileOffset += rBuffers[i]->mUsed;
+        }
+    }
+
+    bool lSuccess = true;
+    size_t lNext = 0;
+    while (lNext < lPending.size()) {
+        // Submit as many writes as the ring takes in one system call, then reap them
+        unsigned lSubmitted = 0;
+        while (lNext < lPending.size() && lSubmitted < mIoUring->mDepth) {
+            struct io_uring_sqe *pSqe = io_uring_get_sqe(&mIoUring->mRing);
+            if (!pSqe) {
+                break;
+            }
+            Pending &rPending = lPending[lNext];
+            io_uring_prep_write(pSqe, mFileDescriptor, rPending.pData, rPending.lSize, rPending.lOffset);
+            io_uring_sqe_set_data(pSqe, &rPending);
+            lNext++;
+            lSubmitted++;
+        }
+        if (io_uring_submit(&mIoUring->mRing) < 0) {
+            return false;
+        }
+        for (unsigned i = 0; i < lSubmitted; i++) {
+            struct io_uring_cqe *pCqe = nullptr;
+            if (io_uring_wait_cqe(&mIoUring->mRing, &pCqe) < 0) {
+                return false;
+            }
+            auto *pPending = (Pending *) io_uring_cqe_get_data(pCqe);
+            int lResult = pCqe->res;
+            io_uring_cqe_seen(&mIoUring->mRing, pCqe);
+            if (lResult < 0) {
+                lSuccess = false;
+                continue;
+            }
+            mBytesWritten += lResult;
+            if ((size_t) lResult < pPending->lSize) {
+                // Short write, finish it synchronously
+                uint64_t lOffset = mFileOffset;
+                mFileOffset = pPending->lOffset + lResult;
+                lSuccess &= writeFully(pPending->pData + lResult, pPending->lSize - lResult);
+                mFileOffset = lOffset;
+            }
+        }
+    }
+    return lSuccess;
+#else
+    return writeVectored(rBuffers, lFirst, lCount);
+#endif
+}
+
+bool RISTNetFileSink::writeTail(SinkBuffer *pBuffer, size_t lAligned) {
+#ifdef O_DIRECT
+    // O_DIRECT can not write a length that is not aligned, finish the file with buffered I/O
+    int lFlags = fcntl(mFileDescriptor, F_GETFL);
+    fcntl(mFileDescriptor, F_SETFL, lFlags & ~O_DIRECT);
+#endif
+    return writeFully(pBuffer->mData + lAligned, pBuffer->mUsed - lAligned);
+}
+
+void RISTNetFileSink::writeBuffers(std::vector<SinkBuffer *> &rBuffers) {
+    size_t lFirst = 0;
+    for (size_t i = 0; i < rBuffers.size(); i++) {
+        SinkBuffer *pLast = rBuffers[i];
+        if (!pLast->mEndOfSegment && i + 1 < rBuffers.size()) {
+            continue;
+        }
+        // Buffers lFirst to i go to the same file. Only the last one can be partial.
+        size_t lTail = mSettings.mDirectIO ? pLast->mUsed % DIRECT_IO_ALIGNMENT : 0;
+        if (mFileDescriptor >= 0) {
+            pLast->mUsed -= lTail;
+            bool lSuccess = mIoUring ? writeIoUring(rBuffers, lFirst, i - lFirst + 1)
+                                     : writeVectored(rBuffers, lFirst, i - lFirst + 1);
+            pLast->mUsed += lTail;
+            if (lSuccess && lTail) {
+                lSuccess = writeTail(pLast, pLast->mUsed - lTail);
+            }
+            if (!lSuccess) {
+                LOGGER(true, LOGG_ERROR, "RISTNetFileSink write failed.")
+                mWriteErrors++;
+            }
+            if (mSettings.mFsyncPolicy == FsyncPolicy::kEveryWrite) {
+                fdatasync(mFileDescriptor);
+            }
+        } else {
+            mWriteErrors++;
+        }
+        if (pLast->mEndOfSegment) {
+            closeSegment();
+            openSegment();
+        }
+        lFirst = i + 1;
+    }
+}
+
+void RISTNetFileSink::writerWorker() {
+    std::vector<SinkBuffer *> lBatch;
+    std::unique_lock<std::mutex> lLock(mBufferMtx);
+    while (true) {
+        mWriterCondition.wait_for(lLock, mSettings.mFlushInterval, [&]() { return !mFull.empty() || !mWriterRun; });
+        if (mFull.empty() && mWriterRun && !mSettings.mDirectIO && mCurrent && mCurrent->mUsed &&
+            std::chrono::steady_clock::now() - mCurrentSince >= mSettings.mFlushInterval) {
+            // Do not let a slow stream sit in a partial buffer
+            queueCurrent();
+        }
+        if (mFull.empty()) {
+            if (!mWriterRun) {
+                break;
+            }
+            continue;
+        }
+        lBatch.assign(mFull.begin(), mFull.end());
+        mFull.clear();
+
+        lLock.unlock();
+        writeBuffers(lBatch);
+        lLock.lock();
+
+        for (auto pBuffer: lBatch) {
+            pBuffer->mUsed = 0;
+            pBuffer->mEndOfSegment = false;
+            mFree.push_back(pBuffer);
+        }
+    }
+}
+
+void RISTNetFileSink::getStatistics(FileSinkStatistics &rStatistics) {
+    std::lock_guard<std::mutex> lLock(mBufferMtx);
+    rStatistics = mStatistics;
+    rStatistics.mBytesWritten = mBytesWritten;
+    rStatistics.mSegments = mSegments;
+    rStatistics.mWriteErrors = mWriteErrors;
+}
+
+bool RISTNetFileSink::destroyFileSink() {
+    if (!mInitialised) {
+        LOGGER(true, LOGG_WARN, "RISTNetFileSink not initialised.")
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lLock(mBufferMtx);
+        queueCurrent();
+        mWriterRun = false;
+    }
+    mWriterCondition.notify_one();
+    if (mWriterThread.joinable()) {
+        mWriterThread.join();
+    }
+    closeSegment();
+#ifdef RISTNET_HAVE_LIBURING
+    if (mIoUring) {
+        io_uring_queue_exit(&mIoUring->mRing);
+    }
+#endif
+    mIoUring.reset();
+    std::lock_guard<std::mutex> lLock(mBufferMtx);
+    mFree.clear();
+    mFull.clear();
+    for (auto &rBuffer: mBuffers) {
+        free(rBuffer.mData);
+    }
+    mBuffers.clear();
+    mInitialised = false;
+    return mWriteErrors == 0;
+}
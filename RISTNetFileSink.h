@@ -0,0 +1,171 @@
+//
+// RISTNetFileSink -- Recording of received data to disk without blocking the librist threads
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETFILESINK_H
+#define CPPRISTWRAPPER__RISTNETFILESINK_H
+
+#include "RISTNet.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+/**
+ * \class RISTNetFileSink
+ *
+ * \brief
+ *
+ * A RISTNetFileSink records payloads to disk. writeData only copies the payload into a large aligned
+ * buffer, full buffers are handed to a background writer thread. The writer uses io_uring when the library
+ * is built with liburing (RISTNET_HAVE_LIBURING) and pwritev otherwise, optionally with O_DIRECT.
+ * If the disk falls behind and all buffers are queued, packets are dropped and counted, the caller is never
+ * blocked by disk latency.
+ *
+ * The output can be split in segments, rotated by size and/or duration. Segments always hold whole packets.
+ * Segment files are named by inserting the segment number before the extension, rec.ts -> rec_000000.ts
+ *
+ */
+class RISTNetFileSink {
+public:
+
+    enum class FsyncPolicy {
+        kNone,            // Leave it to the kernel
+        kSegmentClose,    // fsync when a segment is closed
+        kEveryWrite       // fdatasync after every batch of buffers written
+    };
+
+    struct RISTNetFileSinkSettings {
+        std::string mPath;
+        size_t mBufferSize = 4 * 1024 * 1024;   // Rounded up to a multiple of 4096
+        size_t mBufferCount = 16;
+        uint64_t mSegmentMaxBytes = 0;          // 0 means no size rotation
+        std::chrono::milliseconds mSegmentMaxDuration{0}; // 0 means no duration rotation
+        std::chrono::milliseconds mFlushInterval{1000};   // Max time data waits in a partial buffer (not with O_DIRECT)
+        FsyncPolicy mFsyncPolicy = FsyncPolicy::kSegmentClose;
+        bool mDirectIO = false;
+        bool mUseIoUring = true;                // Ignored if not built with liburing
+    };
+
+    struct FileSinkStatistics {
+        uint64_t mPackets = 0;          // Packets accepted
+        uint64_t mBytes = 0;            // Bytes accepted
+        uint64_t mBytesWritten = 0;     // Bytes written to disk
+        uint64_t mDroppedPackets = 0;   // Packets dropped because the disk fell behind
+        uint64_t mDroppedBytes = 0;
+        uint64_t mSegments = 0;         // Segment files opened
+        uint64_t mWriteErrors = 0;
+        size_t mBuffersQueuedMax = 0;   // High water mark of buffers waiting for the writer
+    };
+
+    /// Constructor
+    RISTNetFileSink();
+
+    /// Destructor
+    virtual ~RISTNetFileSink();
+
+    /**
+     * @brief Initialize the file sink
+     *
+     * Allocates the buffers, opens the first file and starts the writer.
+     *
+     * @param The file sink settings
+     * @return true on success
+     */
+    bool initFileSink(RISTNetFileSinkSettings &rSettings);
+
+    /**
+     * @brief Attach a receiver
+     *
+     * Records all data received by the receiver. This replaces the networkDataCallback of the receiver.
+     * The sink must outlive the receiver.
+     *
+     * @param the receiver
+     * @return true on success
+     */
+    bool attachReceiver(RISTNetReceiver &rReceiver);
+
+    /**
+     * @brief Write data
+     *
+     * Copies the data to the current buffer. Never blocks on the disk.
+     *
+     * @param pointer to the data
+     * @param length of the data
+     * @return true if the data was accepted, false if it was dropped
+     */
+    bool writeData(const uint8_t *pBuf, size_t lSize);
+
+    /// Get the file sink statistics
+    void getStatistics(FileSinkStatistics &rStatistics);
+
+    /**
+     * @brief Destroys the file sink
+     *
+     * Writes what is buffered, closes the file and stops the writer.
+     *
+     */
+    bool destroyFileSink();
+
+    // Delete copy and move constructors and assign operators
+    RISTNetFileSink(RISTNetFileSink const &) = delete;             // Copy construct
+    RISTNetFileSink(RISTNetFileSink &&) = delete;                  // Move construct
+    RISTNetFileSink &operator=(RISTNetFileSink const &) = delete;  // Copy assign
+    RISTNetFileSink &operator=(RISTNetFileSink &&) = delete;       // Move assign
+
+private:
+
+    struct SinkBuffer {
+        uint8_t *mData = nullptr;
+        size_t mUsed = 0;
+        bool mEndOfSegment = false;
+    };
+
+    struct IoUringState;
+
+    void queueCurrent();
+    bool openSegment();
+    void closeSegment();
+    void writeBuffers(std::vector<SinkBuffer *> &rBuffers);
+    bool writeVectored(std::vector<SinkBuffer *> &rBuffers, size_t lFirst, size_t lCount);
+    bool writeIoUring(std::vector<SinkBuffer *> &rBuffers, size_t lFirst, size_t lCount);
+    bool writeFully(const uint8_t *pData, size_t lSize);
+    bool writeTail(SinkBuffer *pBuffer, size_t lAligned);
+    void writerWorker();
+
+    RISTNetFileSinkSettings mSettings;
+    bool mInitialised = false;
+
+    // The buffers, allocated once
+    std::vector<SinkBuffer> mBuffers;
+
+    // The mutex protecting the buffer lists, the segment accounting and the statistics
+    std::mutex mBufferMtx;
+    std::condition_variable mWriterCondition;
+    SinkBuffer *mCurrent = nullptr;
+    std::vector<SinkBuffer *> mFree;
+    std::deque<SinkBuffer *> mFull;
+    uint64_t mSegmentBytes = 0;
+    std::chrono::steady_clock::time_point mSegmentStart;
+    std::chrono::steady_clock::time_point mCurrentSince;
+    FileSinkStatistics mStatistics;
+    bool mWriterRun = false;
+
+    // Owned by the writer thread
+    std::thread mWriterThread;
+    int mFileDescriptor = -1;
+    uint64_t mFileOffset = 0;
+    uint64_t mSegmentNumber = 0;
+    std::unique_ptr<IoUringState> mIoUring;
+    std::atomic<uint64_t> mBytesWritten = 0;
+    std::atomic<uint64_t> mSegments = 0;
+    std::atomic<uint64_t> mWriteErrors = 0;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETFILESINK_H
@@ -0,0 +1,359 @@
+//
+// RISTNetFileSource -- Real-time playout of MPEG-TS files into a RISTNetSender
+//
+
+#include "RISTNetFileSource.h"
+#include "RISTNetInternal.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TS_SYNC_BYTE 0x47
+#define PCR_TICKS_PER_SECOND 27000000
+#define PCR_WRAP ((1ULL << 33) * 300)
+#define PCR_MAX_DELTA PCR_TICKS_PER_SECOND // A PCR jump larger than this is a discontinuity
+#define PREFETCH_BYTES (8 * 1024 * 1024)
+
+static bool parsePCR(const uint8_t *pPacket, uint64_t &rPCR) {
+    uint8_t lAdaptationFieldControl = (pPacket[3] >> 4) & 0x3;
+    if (!(lAdaptationFieldControl & 0x2) || pPacket[4] < 7 || !(pPacket[5] & 0x10)) {
+        return false;
+    }
+    uint64_t lBase = ((uint64_t) pPacket[6] << 25) | ((uint64_t) pPacket[7] << 17) | ((uint64_t) pPacket[8] << 9) |
+                     ((uint64_t) pPacket[9] << 1) | (pPacket[10] >> 7);
+    uint64_t lExtension = ((uint64_t) (pPacket[10] & 0x1) << 8) | pPacket[11];
+    rPCR = lBase * 300 + lExtension;
+    return true;
+}
+
+RISTNetFileSource::RISTNetFileSource() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetFileSource constructed")
+}
+
+RISTNetFileSource::~RISTNetFileSource() {
+    if (mFileData) {
+        closeFile();
+    }
+    LOGGER(false, LOGG_NOTIFY, "RISTNetFileSource destruct")
+}
+
+bool RISTNetFileSource::openFile(const std::string &rPath, RISTNetFileSourceSettings &rSettings) {
+    if (mFileData) {
+        LOGGER(true, LOGG_ERROR, "RISTNetFileSource already has an open file.")
+        return false;
+    }
+    if (!rSettings.mPacketsPerChunk || rSettings.mPacketsPerChunk * kTSPacketSize > RIST_MAX_PACKET_SIZE) {
+        LOGGER(true, LOGG_ERROR, "Packets per chunk not valid.")
+        return false;
+    }
+    mSettings = rSettings;
+
+    mFileDescriptor = open(rPath.c_str(), O_RDONLY);
+    if (mFileDescriptor < 0) {
+        LOGGER(true, LOGG_ERROR, "Could not open: " << rPath)
+        return false;
+    }
+    struct stat lStat{};
+    if (fstat(mFileDescriptor, &lStat) || lStat.st_size < (off_t) (kTSPacketSize * 3)) {
+        LOGGER(true, LOGG_ERROR, "File too small to be a transport stream: " << rPath)
+        closeFile();
+        return false;
+    }
+    mMapSize = lStat.st_size;
+    void *pMap = mmap(nullptr, mMapSize, PROT_READ, MAP_PRIVATE, mFileDescriptor, 0);
+    if (pMap == MAP_FAILED) {
+        LOGGER(true, LOGG_ERROR, "mmap failed: " << rPath)
+        mMapSize = 0;
+        closeFile();
+        return false;
+    }
+    mFileData = (const uint8_t *) pMap;
+    madvise(pMap, mMapSize, MADV_SEQUENTIAL);
+
+    // Find the first position where three packets in a row are in sync
+    size_t lOffset = 0;
+    for (; lOffset < kTSPacketSize; lOffset++) {
+        if (mFileData[lOffset] == TS_SYNC_BYTE && mFileData[lOffset + kTSPacketSize] == TS_SYNC_BYTE &&
+            mFileData[lOffset + 2 * kTSPacketSize] == TS_SYNC_BYTE) {
+            break;
+        }
+    }
+    if (lOffset == kTSPacketSize) {
+        LOGGER(true, LOGG_ERROR, "No TS sync found: " << rPath)
+        closeFile();
+        return false;
+    }
+    mFirstPacket = mFileData + lOffset;
+    mPackets = (mMapSize - lOffset) / kTSPacketSize;
+
+    if (!buildPCRIndex()) {
+        LOGGER(true, LOGG_ERROR, "No usable PCR and no fallback bitrate: " << rPath)
+        closeFile();
+        return false;
+    }
+
+    mNextPacket = 0;
+    mPrefetchedTo = 0;
+    mStatistics = FileSourceStatistics();
+    prefetch(0);
+    return true;
+}
+
+bool RISTNetFileSource::buildPCRIndex() {
+    mPCRIndex.clear();
+    uint16_t lPCRPid = mSettings.mPCRPid;
+    uint64_t lLastPCR = 0;
+    uint64_t lLastPacket = 0;
+    int64_t lTime = 0;
+    int64_t lTicksPerPacket = 0;
+
+    for (uint64_t lPacket = 0; lPacket < mPackets; lPacket++) {
+        const uint8_t *pPacket = mFirstPacket + lPacket * kTSPacketSize;
+        if (pPacket[0] != TS_SYNC_BYTE) {
+            continue;
+        }
+        uint16_t lPid = ((pPacket[1] & 0x1f) << 8) | pPacket[2];
+        if (lPCRPid != kAutoPCRPid && lPid != lPCRPid) {
+            continue;
+        }
+        uint64_t lPCR;
+        if (!parsePCR(pPacket, lPCR)) {
+            continue;
+        }
+        lPCRPid = lPid;
+
+        if (!mPCRIndex.empty()) {
+            uint64_t lDelta = (lPCR + PCR_WRAP - lLastPCR) % PCR_WRAP;
+            uint64_t lPacketDelta = lPacket - lLastPacket;
+            if (lDelta == 0 || lDelta > PCR_MAX_DELTA) {
+                // Discontinuity, assume the rate did not change over the jump
+                lTime += lTicksPerPacket * lPacketDelta;
+            } else {
+                lTime += lDelta;
+                lTicksPerPacket = std::max<int64_t>(lDelta / lPacketDelta, 1);
+            }
+        }
+        mPCRIndex.push_back({lPacket, lTime});
+        lLastPCR = lPCR;
+        lLastPacket = lPacket;
+    }
+
+    if (mPCRIndex.size() >= 2 && mPCRIndex.back().mTime > mPCRIndex.front().mTime) {
+        // Outside the PCR range the average rate of the file is used
+        mTicksPerPacket = (mPCRIndex.back().mTime - mPCRIndex.front().mTime) /
+                          (int64_t) (mPCRIndex.back().mPacket - mPCRIndex.front().mPacket);
+        mTicksPerPacket = std::max<int64_t>(mTicksPerPacket, 1);
+        return true;
+    }
+    mPCRIndex.clear();
+    if (!mSettings.mFallbackBitrate) {
+        return false;
+    }
+    mTicksPerPacket = (int64_t) (kTSPacketSize * 8 * (uint64_t) PCR_TICKS_PER_SECOND / mSettings.mFallbackBitrate);
+    mTicksPerPacket = std::max<int64_t>(mTicksPerPacket, 1);
+    return true;
+}
+
+int64_t RISTNetFileSource::packetTime(uint64_t lPacket) {
+    if (mPCRIndex.empty()) {
+        return (int64_t) lPacket * mTicksPerPacket;
+    }
+    const PCRPoint &rFirst = mPCRIndex.front();
+    const PCRPoint &rLast = mPCRIndex.back();
+    if (lPacket <= rFirst.mPacket) {
+        return rFirst.mTime - (int64_t) (rFirst.mPacket - lPacket) * mTicksPerPacket;
+    }
+    if (lPacket >= rLast.mPacket) {
+        return rLast.mTime + (int64_t) (lPacket - rLast.mPacket) * mTicksPerPacket;
+    }
+    auto lNext = std::upper_bound(mPCRIndex.begin(), mPCRIndex.end(), lPacket,
+                                  [](uint64_t lValue, const PCRPoint &rPoint) { return lValue < rPoint.mPacket; });
+    auto lPrevious = lNext - 1;
+    return lPrevious->mTime + (lNext->mTime - lPrevious->mTime) * (int64_t) (lPacket - lPrevious->mPacket) /
+                              (int64_t) (lNext->mPacket - lPrevious->mPacket);
+}
+
+void RISTNetFileSource::prefetch(uint64_t lPacket) {
+    size_t lOffset = (mFirstPacket - mFileData) + lPacket * kTSPacketSize;
+    if (lOffset + PREFETCH_BYTES / 2 < mPrefetchedTo || lOffset >= mMapSize) {
+        return;
+    }
+    static const size_t lPageSize = sysconf(_SC_PAGESIZE);
+    size_t lStart = lOffset - (lOffset % lPageSize);
+    size_t lLength = std::min<size_t>(PREFETCH_BYTES, mMapSize - lStart);
+    madvise((void *) (mFileData + lStart), lLength, MADV_WILLNEED);
+    mPrefetchedTo = lStart + lLength;
+}
+
+bool RISTNetFileSource::startPlayout(RISTNetSender &rSender) {
+    chunkCallback = [&rSender](const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID) {
+        return rSender.sendData(pBuf, lSize, lConnectionID);
+    };
+    return startPlayout();
+}
+
+bool RISTNetFileSource::startPlayout() {
+    if (!mFileData) {
+        LOGGER(true, LOGG_ERROR, "RISTNetFileSource no file open.")
+        return false;
+    }
+    if (!chunkCallback) {
+        LOGGER(true, LOGG_ERROR, "chunkCallback not set.")
+        return false;
+    }
+    if (mPlaying) {
+        LOGGER(true, LOGG_ERROR, "RISTNetFileSource already playing.")
+        return false;
+    }
+    if (mPlayoutThread.joinable()) {
+        mPlayoutThread.join(); // The previous playout reached the end of the file
+    }
+    std::lock_guard<std::mutex> lLock(mPlayoutMtx);
+    if (mNextPacket >= mPackets) {
+        mNextPacket = 0;
+        mPrefetchedTo = 0;
+    }
+    mSeekPending = false;
+    mPlayoutRun = true;
+    mPlaying = true;
+    mPlayoutThread = std::thread(&RISTNetFileSource::playoutWorker, this);
+    return true;
+}
+
+void RISTNetFileSource::stopPlayout() {
+    {
+        std::lock_guard<std::mutex> lLock(mPlayoutMtx);
+        mPlayoutRun = false;
+    }
+    mPlayoutCondition.notify_one();
+    if (mPlayoutThread.joinable()) {
+        mPlayoutThread.join();
+    }
+}
+
+void RISTNetFileSource::playoutWorker() {
+    std::unique_lock<std::mutex> lLock(mPlayoutMtx);
+    auto lBase = std::chrono::steady_clock::now();
+    int64_t lBaseTime = packetTime(mNextPacket);
+
+    while (mPlayoutRun) {
+        if (mSeekPending) {
+            mSeekPending = false;
+            lBase = std::chrono::steady_clock::now();
+            lBaseTime = packetTime(mNextPacket);
+            mPrefetchedTo = 0;
+            prefetch(mNextPacket);
+        }
+        if (mNextPacket >= mPackets) {
+            if (!mSettings.mLoop) {
+                break;
+            }
+            // Continue the timeline as if the file was appended to itself
+            lBaseTime -= packetTime(mPackets) - packetTime(0);
+            mNextPacket = 0;
+            mPrefetchedTo = 0;
+            prefetch(0);
+            mStatistics.mLoops++;
+        }
+
+        auto lDeadline = lBase + std::chrono::nanoseconds((packetTime(mNextPacket) - lBaseTime) * 1000 / 27);
+        if (mPlayoutCondition.wait_until(lLock, lDeadline, [&]() { return !mPlayoutRun || mSeekPending; })) {
+            continue;
+        }
+        auto lLateness = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - lDeadline);
+        if (lLateness > std::chrono::milliseconds(1)) {
+            mStatistics.mChunksLate++;
+        }
+        mStatistics.mMaxLateness = std::max(mStatistics.mMaxLateness, lLateness);
+
+        uint64_t lCount = std::min<uint64_t>(mSettings.mPacketsPerChunk, mPackets - mNextPacket);
+        const uint8_t *pChunk = mFirstPacket + mNextPacket * kTSPacketSize;
+        mNextPacket += lCount;
+        prefetch(mNextPacket);
+
+        lLock.unlock();
+        bool lAccepted = chunkCallback(pChunk, lCount * kTSPacketSize, mSettings.mConnectionID);
+        lLock.lock();
+        if (lAccepted) {
+            mStatistics.mChunksSent++;
+        } else {
+            mStatistics.mChunksFailed++;
+        }
+    }
+    mPlaying = false;
+}
+
+bool RISTNetFileSource::seek(std::chrono::milliseconds lPosition) {
+    if (!mFileData) {
+        LOGGER(true, LOGG_ERROR, "RISTNetFileSource no file open.")
+        return false;
+    }
+    if (lPosition < std::chrono::milliseconds(0) || lPosition > getDuration()) {
+        LOGGER(true, LOGG_ERROR, "Seek position outside the file.")
+        return false;
+    }
+    int64_t lTarget = packetTime(0) + lPosition.count() * (PCR_TICKS_PER_SECOND / 1000);
+    // The packet times are monotonic, binary search for the first packet at or after the position
+    uint64_t lLow = 0;
+    uint64_t lHigh = mPackets;
+    while (lLow < lHigh) {
+        uint64_t lMiddle = lLow + (lHigh - lLow) / 2;
+        if (packetTime(lMiddle) < lTarget) {
+            lLow = lMiddle + 1;
+        } else {
+            lHigh = lMiddle;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lLock(mPlayoutMtx);
+        mNextPacket = lLow;
+        mSeekPending = true;
+    }
+    mPlayoutCondition.notify_one();
+    return true;
+}
+
+std::chrono::milliseconds RISTNetFileSource::getPosition() {
+    std::lock_guard<std::mutex> lLock(mPlayoutMtx);
+    if (!mFileData) {
+        return std::chrono::milliseconds(0);
+    }
+    return std::chrono::milliseconds((packetTime(mNextPacket) - packetTime(0)) / (PCR_TICKS_PER_SECOND / 1000));
+}
+
+std::chrono::milliseconds RISTNetFileSource::getDuration() {
+    if (!mFileData) {
+        return std::chrono::milliseconds(0);
+    }
+    return std::chrono::milliseconds((packetTime(mPackets) - packetTime(0)) / (PCR_TICKS_PER_SECOND / 1000));
+}
+
+bool RISTNetFileSource::isPlaying() {
+    return mPlaying;
+}
+
+void RISTNetFileSource::getStatistics(FileSourceStatistics &rStatistics) {
+    std::lock_guard<std::mutex> lLock(mPlayoutMtx);
+    rStatistics = mStatistics;
+}
+
+bool RISTNetFileSource::closeFile() {
+    stopPlayout();
+    if (mFileData) {
+        munmap((void *) mFileData, mMapSize);
+        mFileData = nullptr;
+        mFirstPacket = nullptr;
+        mMapSize = 0;
+        mPackets = 0;
+    }
+    if (mFileDescriptor >= 0) {
+        close(mFileDescriptor);
+        mFileDescriptor = -1;
+        return true;
+    }
+    LOGGER(true, LOGG_WARN, "RISTNetFileSource no file open.")
+    return false;
+}
@@ -0,0 +1,171 @@
+//
+// RISTNetFileSource -- Real-time playout of MPEG-TS files into a RISTNetSender
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETFILESOURCE_H
+#define CPPRISTWRAPPER__RISTNETFILESOURCE_H
+
+#include "RISTNet.h"
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+
+/**
+ * \class RISTNetFileSource
+ *
+ * \brief
+ *
+ * A RISTNetFileSource plays out a recorded MPEG transport stream file in real time.
+ * The file is memory mapped and read sequentially. The timing is derived from the PCR of the stream,
+ * every TS packet gets a send time interpolated between the surrounding PCRs, and the packets are sent in
+ * chunks of mPacketsPerChunk (7 x 188 bytes default) at the send time of the first packet in the chunk.
+ *
+ */
+class RISTNetFileSource {
+public:
+
+    static constexpr size_t kTSPacketSize = 188;
+    static constexpr uint16_t kAutoPCRPid = 0xffff;
+
+    struct RISTNetFileSourceSettings {
+        bool mLoop = false;
+        uint16_t mConnectionID = 0;
+        uint16_t mPCRPid = kAutoPCRPid;  // kAutoPCRPid uses the first PID carrying a PCR
+        size_t mPacketsPerChunk = 7;
+        uint64_t mFallbackBitrate = 0;   // bit/s used if the file has no usable PCR, 0 means fail instead
+    };
+
+    struct FileSourceStatistics {
+        uint64_t mChunksSent = 0;
+        uint64_t mChunksFailed = 0;       // Chunks the chunk callback (or sendData) did not accept
+        uint64_t mChunksLate = 0;         // Chunks sent more than a millisecond after their send time
+        std::chrono::microseconds mMaxLateness{0};
+        uint64_t mLoops = 0;
+    };
+
+    /// Constructor
+    RISTNetFileSource();
+
+    /// Destructor
+    virtual ~RISTNetFileSource();
+
+    /**
+     * @brief Open a file
+     *
+     * Maps the file and builds the PCR timing index.
+     *
+     * @param path to the .ts file
+     * @param The file source settings
+     * @return true on success
+     */
+    bool openFile(const std::string &rPath, RISTNetFileSourceSettings &rSettings);
+
+    /**
+     * @brief Start playout to a sender
+     *
+     * Starts the playout thread sending the chunks to the sender using sendData.
+     * The sender must outlive the playout.
+     *
+     * @param the sender
+     * @return true on success
+     */
+    bool startPlayout(RISTNetSender &rSender);
+
+    /**
+     * @brief Start playout to the chunk callback
+     *
+     * Starts the playout thread delivering the chunks to chunkCallback.
+     *
+     * @return true on success
+     */
+    bool startPlayout();
+
+    /**
+     * @brief Stop playout
+     *
+     * Stops the playout thread. Playout can be started again from where it stopped.
+     *
+     */
+    void stopPlayout();
+
+    /**
+     * @brief Seek
+     *
+     * Moves the playout position, relative to the first PCR of the file. Can be called while playing.
+     *
+     * @param the position
+     * @return true if the position is within the file
+     */
+    bool seek(std::chrono::milliseconds lPosition);
+
+    /// The current playout position relative to the start of the file
+    std::chrono::milliseconds getPosition();
+
+    /// The duration of the file according to its PCR
+    std::chrono::milliseconds getDuration();
+
+    /// True while the playout thread is sending
+    bool isPlaying();
+
+    /// Get the playout statistics
+    void getStatistics(FileSourceStatistics &rStatistics);
+
+    /**
+     * @brief Close the file
+     *
+     * Stops playout and unmaps the file.
+     *
+     */
+    bool closeFile();
+
+    /// Callback getting the chunks when started without a sender. Return false if the chunk was not accepted.
+    std::function<bool(const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID)> chunkCallback = nullptr;
+
+    // Delete copy and move constructors and assign operators
+    RISTNetFileSource(RISTNetFileSource const &) = delete;             // Copy construct
+    RISTNetFileSource(RISTNetFileSource &&) = delete;                  // Move construct
+    RISTNetFileSource &operator=(RISTNetFileSource const &) = delete;  // Copy assign
+    RISTNetFileSource &operator=(RISTNetFileSource &&) = delete;       // Move assign
+
+private:
+
+    // A PCR in 27MHz ticks, unwrapped and with discontinuities removed
+    struct PCRPoint {
+        uint64_t mPacket;
+        int64_t mTime;
+    };
+
+    bool buildPCRIndex();
+    int64_t packetTime(uint64_t lPacket);
+    void prefetch(uint64_t lPacket);
+    void playoutWorker();
+
+    RISTNetFileSourceSettings mSettings;
+
+    int mFileDescriptor = -1;
+    const uint8_t *mFileData = nullptr;
+    size_t mMapSize = 0;
+    const uint8_t *mFirstPacket = nullptr;
+    uint64_t mPackets = 0;
+    std::vector<PCRPoint> mPCRIndex;
+    int64_t mTicksPerPacket = 0; // Used when there are not enough PCRs
+    uint64_t mPrefetchedTo = 0; // File offset the prefetch (MADV_WILLNEED) has reached
+
+    // The mutex protecting the playout state and statistics
+    std::mutex mPlayoutMtx;
+    std::condition_variable mPlayoutCondition;
+    std::thread mPlayoutThread;
+    bool mPlayoutRun = false;
+    std::atomic<bool> mPlaying = false;
+    uint64_t mNextPacket = 0;
+    bool mSeekPending = false;
+    FileSourceStatistics mStatistics;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETFILESOURCE_H
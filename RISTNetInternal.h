@@ -5,6 +5,7 @@
 #ifndef CPPRISTWRAPPER__RISTNETINTERNAL_H
 #define CPPRISTWRAPPER__RISTNETINTERNAL_H
 
+#include "RISTNetLog.h"
 #include <iostream>
 #include <sstream>
 
@@ -15,23 +16,25 @@
 #define LOGG_FATAL 8
 #define LOGG_MASK  LOGG_NOTIFY | LOGG_WARN | LOGG_ERROR | LOGG_FATAL //What to logg?
 
-#ifdef DEBUG
+static inline rist_log_level loggLevel(int g) {
+    if (g == (LOGG_NOTIFY & (LOGG_MASK))) return RIST_LOG_NOTICE;
+    if (g == (LOGG_WARN & (LOGG_MASK))) return RIST_LOG_WARN;
+    if (g == (LOGG_ERROR & (LOGG_MASK)) || g == (LOGG_FATAL & (LOGG_MASK))) return RIST_LOG_ERROR;
+    return RIST_LOG_DISABLE;
+}
+
+// Costs a level check when the level is disabled, the message is only formatted if it passes the rate limit
 #define LOGGER(l,g,f) \
 { \
+if (loggLevel(g) != RIST_LOG_DISABLE && RISTNetLog::isEnabled(loggLevel(g))) { \
+static RISTNetLogSite lLogSite; \
+if (lLogSite.allow()) { \
 std::ostringstream a; \
-if (g == (LOGG_NOTIFY & (LOGG_MASK))) {a << "Notification: ";} \
-else if (g == (LOGG_WARN & (LOGG_MASK))) {a << "Warning: ";} \
-else if (g == (LOGG_ERROR & (LOGG_MASK))) {a << "Error: ";} \
-else if (g == (LOGG_FATAL & (LOGG_MASK))) {a << "Fatal: ";} \
-if (a.str().length()) { \
-if (l) {a << __FILE__ << " " << __LINE__ << " ";} \
-a << f << std::endl; \
-std::cout << a.str(); \
+a << f; \
+RISTNetLog::globalLog().log(loggLevel(g), lLogSite, (l) ? __FILE__ : nullptr, __LINE__, a.str()); \
+} \
 } \
 }
-#else
-#define LOGGER(l,g,f)
-#endif
 // GLobal Logger -- End
 
 #endif //CPPRISTWRAPPER__RISTNETINTERNAL_H
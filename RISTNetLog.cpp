@@ -0,0 +1,276 @@
+//
+// RISTNetLog -- Asynchronous rate limited logging of the wrapper and librist
+//
+
+#include "RISTNetLog.h"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#ifdef DEBUG
+#define DEFAULT_LOG_LEVEL RIST_LOG_NOTICE
+#else
+#define DEFAULT_LOG_LEVEL RIST_LOG_WARN
+#endif
+
+std::atomic<int> RISTNetLog::mLevel{DEFAULT_LOG_LEVEL};
+std::atomic<uint32_t> RISTNetLog::mRateLimitBurst{20};
+std::atomic<int64_t> RISTNetLog::mRateLimitInterval{1000000000};
+std::atomic<uint64_t> RISTNetLog::mSuppressed{0};
+
+static int64_t steadyNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+//
+//
+// RISTNetLogSite
+//
+//
+//---------------------------------------------------------------------------------------------------------------------
+
+bool RISTNetLogSite::allow() {
+    int64_t lNow = steadyNanoseconds();
+    int64_t lWindowStart = mWindowStart.load(std::memory_order_relaxed);
+    if (lNow - lWindowStart >= RISTNetLog::mRateLimitInterval.load(std::memory_order_relaxed) &&
+        mWindowStart.compare_exchange_strong(lWindowStart, lNow, std::memory_order_relaxed)) {
+        mWindowCount.store(0, std::memory_order_relaxed);
+    }
+    if (mWindowCount.fetch_add(1, std::memory_order_relaxed) < RISTNetLog::mRateLimitBurst.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    mSuppressed.fetch_add(1, std::memory_order_relaxed);
+    RISTNetLog::mSuppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+//
+//
+// RISTNetLog
+//
+//
+//---------------------------------------------------------------------------------------------------------------------
+
+RISTNetLog::RISTNetLog() {
+    mRing = std::make_unique<RingSlot[]>(kRingSize);
+    for (size_t i = 0; i < kRingSize; i++) {
+        mRing[i].mSequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+RISTNetLog &RISTNetLog::globalLog() {
+    // Never destroyed, threads may log during static destruction
+    static RISTNetLog *pLog = new RISTNetLog();
+    return *pLog;
+}
+
+bool RISTNetLog::startLog(RISTNetLogSettings &rSettings) {
+    std::lock_guard<std::mutex> lLock(mControlMtx);
+    if (mRunning) {
+        return false;
+    }
+    if (!rSettings.mRateLimitBurst || rSettings.mRateLimitInterval.count() <= 0 ||
+        rSettings.mDrainInterval.count() <= 0) {
+        return false;
+    }
+    mSettings = rSettings;
+    mRateLimitBurst = rSettings.mRateLimitBurst;
+    mRateLimitInterval = std::chrono::duration_cast<std::chrono::nanoseconds>(rSettings.mRateLimitInterval).count();
+    mDrainRun = true;
+    mDrainThread = std::thread(&RISTNetLog::drainThread, this);
+    mRunning = true;
+    return true;
+}
+
+bool RISTNetLog::stopLog() {
+    std::lock_guard<std::mutex> lLock(mControlMtx);
+    if (!mRunning) {
+        return false;
+    }
+    mRunning = false;
+    mDrainRun = false;
+    mDrainThread.join();
+    // Records put while stopping, a put that saw mRunning set has claimed and published its slot once it left
+    while (mWriters.load()) {
+        std::this_thread::yield();
+    }
+    RISTNetLogRecord lRecord;
+    while (mDequeue != mEnqueue.load(std::memory_order_acquire)) {
+        if (take(lRecord)) {
+            deliver(lRecord);
+        }
+    }
+    return true;
+}
+
+void RISTNetLog::getStatistics(LogStatistics &rStatistics) {
+    rStatistics.mRecords = mRecords;
+    rStatistics.mDropped = mDropped;
+    rStatistics.mSuppressed = mSuppressed;
+}
+
+void RISTNetLog::log(rist_log_level lLevel, RISTNetLogSite &rSite, const char *pFile, int lLine,
+                     const std::string &rMessage) {
+    put(lLevel, false, rSite, pFile, lLine, rMessage.c_str(), rMessage.length());
+}
+
+int RISTNetLog::setupLibristLogging(rist_logging_settings **ppSettings, rist_log_level lLevel) {
+    if (isRunning()) {
+        return rist_logging_set(ppSettings, lLevel, &RISTNetLog::libristLog, this, nullptr, nullptr);
+    }
+    return rist_logging_set(ppSettings, lLevel, nullptr, nullptr, nullptr, stderr);
+}
+
+int RISTNetLog::libristLog(void *pArg, rist_log_level lLevel, const char *pMessage) {
+    RISTNetLog *lWeakSelf = (RISTNetLog *) pArg;
+    if (!isEnabled(lLevel)) {
+        return 0;
+    }
+    size_t lLength = strlen(pMessage);
+    while (lLength && (pMessage[lLength - 1] == '\n' || pMessage[lLength - 1] == '\r')) {
+        lLength--;
+    }
+    // librist has no call sites to tell apart, messages equal but for the numbers in them share a rate limit
+    uint32_t lHash = 2166136261u;
+    for (size_t i = 0; i < lLength && i < 64; i++) {
+        if (pMessage[i] < '0' || pMessage[i] > '9') {
+            lHash = (lHash ^ (uint8_t) pMessage[i]) * 16777619u;
+        }
+    }
+    RISTNetLogSite &rSite = lWeakSelf->mLibristSites[lHash % kLibristSites];
+    if (rSite.allow()) {
+        lWeakSelf->put(lLevel, true, rSite, nullptr, 0, pMessage, lLength);
+    }
+    return 0;
+}
+
+void RISTNetLog::put(rist_log_level lLevel, bool lLibrist, RISTNetLogSite &rSite, const char *pFile, int lLine,
+                     const char *pMessage, size_t lLength) {
+    auto lFill = [&](RISTNetLogRecord &rRecord) {
+        rRecord.mTime = std::chrono::system_clock::now();
+        rRecord.mLevel = lLevel;
+        rRecord.mLibrist = lLibrist;
+        rRecord.pFile = pFile;
+        rRecord.mLine = lLine;
+        rRecord.mSuppressed = rSite.takeSuppressed();
+        size_t lCopy = std::min(lLength, RISTNetLogRecord::kMaxMessage - 1);
+        memcpy(rRecord.mMessage, pMessage, lCopy);
+        rRecord.mMessage[lCopy] = 0;
+    };
+
+    // Counted before mRunning is read, stopLog clears mRunning and then waits for mWriters to drop to 0
+    mWriters.fetch_add(1);
+    if (!mRunning.load()) {
+        mWriters.fetch_sub(1, std::memory_order_release);
+        RISTNetLogRecord lRecord;
+        lFill(lRecord);
+        deliver(lRecord);
+        return;
+    }
+
+    // Claim a slot, give up instead of waiting if the ring is full
+    size_t lPosition = mEnqueue.load(std::memory_order_relaxed);
+    RingSlot *pSlot;
+    while (true) {
+        pSlot = &mRing[lPosition & (kRingSize - 1)];
+        size_t lSequence = pSlot->mSequence.load(std::memory_order_acquire);
+        intptr_t lDifference = (intptr_t) lSequence - (intptr_t) lPosition;
+        if (lDifference == 0) {
+            if (mEnqueue.compare_exchange_weak(lPosition, lPosition + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (lDifference < 0) {
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            mWriters.fetch_sub(1, std::memory_order_release);
+            return;
+        } else {
+            lPosition = mEnqueue.load(std::memory_order_relaxed);
+        }
+    }
+    lFill(pSlot->mRecord);
+    pSlot->mSequence.store(lPosition + 1, std::memory_order_release);
+    mRecords.fetch_add(1, std::memory_order_relaxed);
+    mWriters.fetch_sub(1, std::memory_order_release);
+}
+
+bool RISTNetLog::take(RISTNetLogRecord &rRecord) {
+    RingSlot &rSlot = mRing[mDequeue & (kRingSize - 1)];
+    if (rSlot.mSequence.load(std::memory_order_acquire) != mDequeue + 1) {
+        return false;
+    }
+    rRecord = rSlot.mRecord;
+    rSlot.mSequence.store(mDequeue + kRingSize, std::memory_order_release);
+    mDequeue++;
+    return true;
+}
+
+std::string RISTNetLog::formatRecord(const RISTNetLogRecord &rRecord) {
+    std::time_t lSeconds = std::chrono::system_clock::to_time_t(rRecord.mTime);
+    auto lMilliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+            rRecord.mTime.time_since_epoch()).count() % 1000;
+    std::tm lTime{};
+    gmtime_r(&lSeconds, &lTime);
+    char lPrefix[64];
+    strftime(lPrefix, sizeof(lPrefix), "%Y-%m-%dT%H:%M:%S", &lTime);
+
+    std::string lLine(lPrefix);
+    char lFraction[8];
+    snprintf(lFraction, sizeof(lFraction), ".%03dZ ", (int) lMilliseconds);
+    lLine += lFraction;
+    switch (rRecord.mLevel) {
+        case RIST_LOG_ERROR:
+            lLine += "Error: ";
+            break;
+        case RIST_LOG_WARN:
+            lLine += "Warning: ";
+            break;
+        case RIST_LOG_NOTICE:
+            lLine += "Notification: ";
+            break;
+        case RIST_LOG_INFO:
+            lLine += "Info: ";
+            break;
+        default:
+            lLine += "Debug: ";
+            break;
+    }
+    if (rRecord.mLibrist) {
+        lLine += "librist ";
+    }
+    if (rRecord.pFile) {
+        lLine += std::string(rRecord.pFile) + " " + std::to_string(rRecord.mLine) + " ";
+    }
+    lLine += rRecord.mMessage;
+    if (rRecord.mSuppressed) {
+        lLine += " (" + std::to_string(rRecord.mSuppressed) + " similar suppressed)";
+    }
+    return lLine;
+}
+
+void RISTNetLog::deliver(const RISTNetLogRecord &rRecord) {
+    std::lock_guard<std::mutex> lLock(mSinkMtx);
+    if (logSinkCallback) {
+        logSinkCallback(rRecord);
+        return;
+    }
+    std::string lLine = formatRecord(rRecord);
+    lLine += "\n";
+    fputs(lLine.c_str(), stderr);
+}
+
+void RISTNetLog::drainThread() {
+    RISTNetLogRecord lRecord;
+    while (mDrainRun) {
+        bool lDelivered = false;
+        while (take(lRecord)) {
+            deliver(lRecord);
+            lDelivered = true;
+        }
+        if (!lDelivered) {
+            std::this_thread::sleep_for(mSettings.mDrainInterval);
+        }
+    }
+}
@@ -0,0 +1,208 @@
+//
+// RISTNetLog -- Asynchronous rate limited logging of the wrapper and librist
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+// k constant
+
+#ifndef CPPRISTWRAPPER__RISTNETLOG_H
+#define CPPRISTWRAPPER__RISTNETLOG_H
+
+#include "librist.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// A log record as handed to the sink
+struct RISTNetLogRecord {
+    static constexpr size_t kMaxMessage = 256;
+
+    std::chrono::system_clock::time_point mTime;
+    rist_log_level mLevel = RIST_LOG_ERROR;
+    bool mLibrist = false;          // From librist, else from the wrapper
+    const char *pFile = nullptr;    // Source location of wrapper records, nullptr if not logged
+    int mLine = 0;
+    uint32_t mSuppressed = 0;       // Records of the same site dropped by the rate limit before this one
+    char mMessage[kMaxMessage] = {}; // Truncated, zero terminated
+};
+
+// A place in the code that logs. Rate limited on its own, constant initialised so a static one costs no guard.
+class RISTNetLogSite {
+public:
+    constexpr RISTNetLogSite() = default;
+
+    /// True if the rate limit lets a record through now
+    bool allow();
+
+    /// Records suppressed since the last call
+    uint32_t takeSuppressed() { return mSuppressed.exchange(0, std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> mWindowStart{0};
+    std::atomic<uint32_t> mWindowCount{0};
+    std::atomic<uint32_t> mSuppressed{0};
+};
+
+/**
+ * \class RISTNetLog
+ *
+ * \brief
+ *
+ * The process wide log of the wrapper (the LOGGER macro) and of librist. Once started, records are put in a
+ * lock-free ring and a background thread hands them to the sink, so a thread logging never waits for the sink or
+ * for another thread. A full ring drops the record. Every log site is rate limited on its own and the level can
+ * be changed at any time, a disabled level costs one atomic load.
+ *
+ * Receivers and senders initialised while the log is started send the librist logs here, else librist writes
+ * to stderr. Until started (and after stopped) records are written synchronously.
+ *
+ */
+class RISTNetLog {
+public:
+
+    static constexpr size_t kRingSize = 8192;       // Records, a power of 2
+    static constexpr size_t kLibristSites = 256;    // Rate limit slots of the librist messages
+
+    struct RISTNetLogSettings {
+        uint32_t mRateLimitBurst = 20;                          // Max records per site and interval
+        std::chrono::milliseconds mRateLimitInterval{1000};
+        std::chrono::milliseconds mDrainInterval{10};           // Sleep of the drain thread when the ring is empty
+    };
+
+    struct LogStatistics {
+        uint64_t mRecords = 0;      // Put in the ring
+        uint64_t mDropped = 0;      // Ring full
+        uint64_t mSuppressed = 0;   // Rate limited
+    };
+
+    /// The process wide log, never destroyed
+    static RISTNetLog &globalLog();
+
+    /**
+     * @brief Start the asynchronous logging
+     *
+     * Start it before initReceiver / initSender. The librist logging of a context is set up by initReceiver /
+     * initSender (setupLibristLogging), contexts created before keep logging librist messages to stderr.
+     *
+     * @param The log settings
+     * @return true on success
+     */
+    bool startLog(RISTNetLogSettings &rSettings);
+
+    /**
+     * @brief Stop the asynchronous logging
+     *
+     * Waits for the records being put and hands the records left in the ring to the sink. Call it before the
+     * process exits.
+     *
+     * @return true on success
+     */
+    bool stopLog();
+
+    /// True if started
+    bool isRunning() const { return mRunning.load(std::memory_order_acquire); }
+
+    /// Change the level, records above it are discarded where they are logged
+    static void setLevel(rist_log_level lLevel) { mLevel.store(lLevel, std::memory_order_relaxed); }
+    static rist_log_level getLevel() { return (rist_log_level) mLevel.load(std::memory_order_relaxed); }
+    static bool isEnabled(rist_log_level lLevel) { return lLevel <= mLevel.load(std::memory_order_relaxed); }
+
+    /// Get the statistics
+    void getStatistics(LogStatistics &rStatistics);
+
+    /**
+     * @brief Log a record
+     *
+     * Used by the LOGGER macro. The level is expected to be checked with isEnabled() and the rate limit with
+     * allow() of the site already.
+     *
+     * @param the level
+     * @param the log site
+     * @param source file or nullptr
+     * @param source line
+     * @param the message
+     */
+    void log(rist_log_level lLevel, RISTNetLogSite &rSite, const char *pFile, int lLine, const std::string &rMessage);
+
+    /**
+     * @brief Set up librist logging
+     *
+     * Routes the librist logs of a context created with the settings here if the log is started, else to stderr.
+     *
+     * @param the librist logging settings, allocated by librist if *ppSettings is nullptr
+     * @param the librist log level
+     * @return the rist_logging_set result
+     */
+    int setupLibristLogging(rist_logging_settings **ppSettings, rist_log_level lLevel);
+
+    /// Format a record as a line of text, without line end
+    static std::string formatRecord(const RISTNetLogRecord &rRecord);
+
+    /**
+     * @brief Sink callback (__NULLABLE)
+     *
+     * Gets the records in the order they were put in the ring, on the drain thread. Set it before startLog.
+     * nullptr writes the records to stderr.
+     *
+     * @param the record
+     */
+    std::function<void(const RISTNetLogRecord &rRecord)> logSinkCallback = nullptr;
+
+    // Delete copy and move constructors and assign operators
+    RISTNetLog(RISTNetLog const &) = delete;             // Copy construct
+    RISTNetLog(RISTNetLog &&) = delete;                  // Move construct
+    RISTNetLog &operator=(RISTNetLog const &) = delete;  // Copy assign
+    RISTNetLog &operator=(RISTNetLog &&) = delete;       // Move assign
+
+private:
+
+    // A slot of the ring, the sequence tells whose turn it is (bounded queue by D. Vyukov)
+    struct RingSlot {
+        std::atomic<size_t> mSequence{0};
+        RISTNetLogRecord mRecord;
+    };
+
+    RISTNetLog();
+    ~RISTNetLog() = default;
+
+    static int libristLog(void *pArg, rist_log_level lLevel, const char *pMessage);
+    void put(rist_log_level lLevel, bool lLibrist, RISTNetLogSite &rSite, const char *pFile, int lLine,
+             const char *pMessage, size_t lLength);
+    bool take(RISTNetLogRecord &rRecord);
+    void deliver(const RISTNetLogRecord &rRecord);
+    void drainThread();
+
+    static std::atomic<int> mLevel;
+    static std::atomic<uint32_t> mRateLimitBurst;
+    static std::atomic<int64_t> mRateLimitInterval;  // Nanoseconds
+    static std::atomic<uint64_t> mSuppressed;
+    friend class RISTNetLogSite;
+
+    RISTNetLogSettings mSettings;
+    std::mutex mControlMtx;                 // Start and stop
+    std::atomic<bool> mRunning{false};
+    std::thread mDrainThread;
+    std::atomic<bool> mDrainRun{false};
+
+    std::unique_ptr<RingSlot[]> mRing;
+    alignas(64) std::atomic<size_t> mEnqueue{0};
+    alignas(64) std::atomic<size_t> mWriters{0};   // Threads in put, waited for by stopLog
+    alignas(64) size_t mDequeue = 0;        // Drain thread only, stopLog after joining it
+
+    std::mutex mSinkMtx;                    // One record at a time to the sink
+    RISTNetLogSite mLibristSites[kLibristSites];
+
+    std::atomic<uint64_t> mRecords{0};
+    std::atomic<uint64_t> mDropped{0};
+};
+
+#endif //CPPRISTWRAPPER__RISTNETLOG_H
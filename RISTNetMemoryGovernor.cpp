@@ -0,0 +1,314 @@
+//
+// RISTNetMemoryGovernor -- Process-wide memory budget of the RIST receivers and senders
+//
+
+#include "RISTNetMemoryGovernor.h"
+#include "RISTNetInternal.h"
+#include <algorithm>
+
+//---------------------------------------------------------------------------------------------------------------------
+// RISTNetMemorySession
+//---------------------------------------------------------------------------------------------------------------------
+
+RISTNetMemorySession::RISTNetMemorySession(RISTNetMemoryGovernor &rGovernor, uint64_t lID, const std::string &rName,
+                                           size_t lRecoveryEstimate, size_t lRecoveryGranted, size_t lQueueEstimate,
+                                           size_t lPeers)
+        : mGovernor(rGovernor), mID(lID), mName(rName), mPeerEstimate(lRecoveryEstimate / std::max<size_t>(lPeers, 1)),
+          mPeerGranted(lRecoveryGranted / std::max<size_t>(lPeers, 1)), mQueueEstimate(lQueueEstimate),
+          mPeers(lPeers), mRecoveryEstimate(lRecoveryEstimate), mRecoveryGranted(lRecoveryGranted),
+          mQueueLimit(lQueueEstimate) {
+}
+
+RISTNetMemorySession::~RISTNetMemorySession() {
+    mGovernor.closeSession(*this);
+}
+
+bool RISTNetMemorySession::reserveQueue(size_t lBytes) {
+    size_t lUsed = mQueueUsed.fetch_add(lBytes, std::memory_order_relaxed) + lBytes;
+    if (lUsed > mQueueLimit.load(std::memory_order_relaxed)) {
+        mQueueUsed.fetch_sub(lBytes, std::memory_order_relaxed);
+        mQueueDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    size_t lPeak = mQueuePeak.load(std::memory_order_relaxed);
+    while (lUsed > lPeak && !mQueuePeak.compare_exchange_weak(lPeak, lUsed, std::memory_order_relaxed)) {
+    }
+    mGovernor.queueChanged(mGovernor.mQueueUsed.fetch_add(lBytes, std::memory_order_relaxed) + lBytes);
+    return true;
+}
+
+void RISTNetMemorySession::releaseQueue(size_t lBytes) {
+    if (!lBytes) {
+        return;
+    }
+    mQueueUsed.fetch_sub(lBytes, std::memory_order_relaxed);
+    mGovernor.queueChanged(mGovernor.mQueueUsed.fetch_sub(lBytes, std::memory_order_relaxed) - lBytes);
+}
+
+void RISTNetMemorySession::setPeers(size_t lPeers) {
+    mGovernor.peersChanged(*this, lPeers);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// RISTNetMemoryGovernor
+//---------------------------------------------------------------------------------------------------------------------
+
+RISTNetMemoryGovernor::RISTNetMemoryGovernor() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetMemoryGovernor constructed")
+}
+
+RISTNetMemoryGovernor::~RISTNetMemoryGovernor() {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    if (!mSessions.empty()) {
+        LOGGER(true, LOGG_ERROR, "RISTNetMemoryGovernor destroyed with " << mSessions.size() << " sessions open.")
+    }
+    LOGGER(false, LOGG_NOTIFY, "RISTNetMemoryGovernor destruct")
+}
+
+RISTNetMemoryGovernor &RISTNetMemoryGovernor::globalGovernor() {
+    // Never destroyed, sessions may close during static destruction
+    static RISTNetMemoryGovernor *pGovernor = new RISTNetMemoryGovernor();
+    return *pGovernor;
+}
+
+bool RISTNetMemoryGovernor::initGovernor(RISTNetMemoryGovernorSettings &rSettings) {
+    if (rSettings.mShrinkAt <= 0.0 || rSettings.mShrinkAt > 1.0 || rSettings.mMinRecoveryShare < 0.0 ||
+        rSettings.mMinRecoveryShare > 1.0) {
+        LOGGER(true, LOGG_ERROR, "Memory governor settings not valid.")
+        return false;
+    }
+    SessionUsage lOverload;
+    bool lOverloaded;
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mSettings = rSettings;
+        mShrinkBytes = (size_t) ((double) rSettings.mBudget * rSettings.mShrinkAt);
+        lOverloaded = rebalance(lOverload);
+    }
+    if (lOverloaded) {
+        callOverload(lOverload);
+    }
+    return true;
+}
+
+size_t RISTNetMemoryGovernor::estimateRecoveryBytes(const rist_peer_config &rConfig, size_t lPeers) {
+    // kbps x ms / 8 is bytes
+    return lPeers * (size_t) rConfig.recovery_maxbitrate * (size_t) rConfig.recovery_length_max / 8;
+}
+
+bool RISTNetMemoryGovernor::openSession(const std::string &rName, size_t lRecoveryBytes, size_t lQueueBytes,
+                                        std::unique_ptr<RISTNetMemorySession> &rSession, size_t lPeers) {
+    rSession.reset();
+    SessionUsage lOverload;
+    bool lOverloaded;
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        size_t lGranted = lRecoveryBytes;
+        if (mSettings.mBudget) {
+            // The queues can shrink to their floor, the recovery buffers can not
+            size_t lReserved = std::min(mSettings.mMinQueueBytes, lQueueBytes);
+            for (auto *pSession: mSessions) {
+                lReserved += pSession->mRecoveryGranted + std::min(mSettings.mMinQueueBytes, pSession->mQueueEstimate);
+            }
+            size_t lAvailable = mSettings.mBudget > lReserved ? mSettings.mBudget - lReserved : 0;
+            if (lRecoveryBytes > lAvailable) {
+                if (mSettings.mPolicy == AdmissionPolicy::kReject ||
+                    (double) lAvailable < (double) lRecoveryBytes * mSettings.mMinRecoveryShare || !lAvailable) {
+                    mRejected.fetch_add(1, std::memory_order_relaxed);
+                    LOGGER(true, LOGG_ERROR, "Memory budget exceeded, session " << rName << " rejected, asked "
+                                             << lRecoveryBytes << " bytes, " << lAvailable << " available.")
+                    return false;
+                }
+                lGranted = lAvailable;
+                mClamped.fetch_add(1, std::memory_order_relaxed);
+                LOGGER(true, LOGG_WARN, "Memory budget exceeded, session " << rName << " clamped to " << lGranted
+                                        << " of " << lRecoveryBytes << " recovery bytes.")
+            }
+        }
+        rSession.reset(new RISTNetMemorySession(*this, mNextID++, rName, lRecoveryBytes, lGranted, lQueueBytes,
+                                                lPeers));
+        mSessions.push_back(rSession.get());
+        mRecoveryGranted.fetch_add(lGranted, std::memory_order_relaxed);
+        mAdmitted.fetch_add(1, std::memory_order_relaxed);
+        lOverloaded = rebalance(lOverload);
+    }
+    if (lOverloaded) {
+        callOverload(lOverload);
+    }
+    return true;
+}
+
+void RISTNetMemoryGovernor::closeSession(RISTNetMemorySession &rSession) {
+    SessionUsage lOverload;
+    bool lOverloaded;
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mSessions.erase(std::remove(mSessions.begin(), mSessions.end(), &rSession), mSessions.end());
+        mRecoveryGranted.fetch_sub(rSession.mRecoveryGranted, std::memory_order_relaxed);
+        mQueueUsed.fetch_sub(rSession.mQueueUsed.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        lOverloaded = rebalance(lOverload);
+    }
+    if (lOverloaded) {
+        callOverload(lOverload);
+    }
+}
+
+void RISTNetMemoryGovernor::peersChanged(RISTNetMemorySession &rSession, size_t lPeers) {
+    SessionUsage lOverload;
+    bool lOverloaded;
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        if (lPeers == rSession.mPeers) {
+            return;
+        }
+        size_t lGranted = lPeers * rSession.mPeerGranted;
+        mRecoveryGranted.fetch_add(lGranted, std::memory_order_relaxed);
+        mRecoveryGranted.fetch_sub(rSession.mRecoveryGranted, std::memory_order_relaxed);
+        rSession.mPeers = lPeers;
+        rSession.mRecoveryEstimate = lPeers * rSession.mPeerEstimate;
+        rSession.mRecoveryGranted = lGranted;
+        lOverloaded = rebalance(lOverload);
+    }
+    if (lOverloaded) {
+        callOverload(lOverload);
+    }
+}
+
+void RISTNetMemoryGovernor::queueChanged(size_t lUsed) {
+    size_t lShrinkBytes = mShrinkBytes.load(std::memory_order_relaxed);
+    if (!lShrinkBytes) {
+        return;
+    }
+    lUsed += mRecoveryGranted.load(std::memory_order_relaxed);
+    bool lShrunk = mShrunk.load(std::memory_order_relaxed);
+    if (lShrunk ? lUsed >= lShrinkBytes / 2 : lUsed <= lShrinkBytes) {
+        return;
+    }
+    // Crossed, the thread holding the lock rebalances if busy
+    SessionUsage lOverload;
+    bool lOverloaded;
+    {
+        std::unique_lock<std::mutex> lLock(mMtx, std::try_to_lock);
+        if (!lLock.owns_lock()) {
+            return;
+        }
+        lOverloaded = rebalance(lOverload);
+    }
+    if (lOverloaded) {
+        callOverload(lOverload);
+    }
+}
+
+bool RISTNetMemoryGovernor::rebalance(SessionUsage &rOverload) {
+    if (!mSettings.mBudget) {
+        for (auto *pSession: mSessions) {
+            pSession->mQueueLimit = pSession->mQueueEstimate;
+        }
+        mShrunk = false;
+        return false;
+    }
+
+    size_t lGranted = mRecoveryGranted.load(std::memory_order_relaxed);
+    size_t lUsed = lGranted + mQueueUsed.load(std::memory_order_relaxed);
+    size_t lShrinkBytes = mShrinkBytes.load(std::memory_order_relaxed);
+    if (lUsed > lShrinkBytes || (mShrunk && lUsed >= lShrinkBytes / 2)) {
+        // The queues share what the recovery buffers leave under the shrink level, by their size
+        size_t lQueueBudget = lShrinkBytes > lGranted ? lShrinkBytes - lGranted : 0;
+        double lEstimates = 0.0;
+        for (auto *pSession: mSessions) {
+            lEstimates += (double) pSession->mQueueEstimate;
+        }
+        for (auto *pSession: mSessions) {
+            size_t lShare = lEstimates > 0.0 ?
+                    (size_t) ((double) lQueueBudget * (double) pSession->mQueueEstimate / lEstimates) : 0;
+            size_t lLimit = std::min(pSession->mQueueEstimate,
+                                     std::max(lShare, std::min(mSettings.mMinQueueBytes, pSession->mQueueEstimate)));
+            if (lLimit < pSession->mQueueLimit.load(std::memory_order_relaxed)) {
+                mShrinks.fetch_add(1, std::memory_order_relaxed);
+            }
+            pSession->mQueueLimit = lLimit;
+        }
+        mShrunk = true;
+    } else {
+        for (auto *pSession: mSessions) {
+            pSession->mQueueLimit = pSession->mQueueEstimate;
+        }
+        mShrunk = false;
+        return false;
+    }
+
+    // Shrunk, overloaded if the recovery buffers and the queue limits are still over the budget
+    size_t lCommitted = lGranted;
+    RISTNetMemorySession *pLargest = nullptr;
+    size_t lLargest = 0;
+    for (auto *pSession: mSessions) {
+        if (pSession->mOverload) {
+            // Reported, waiting for it to close
+            return false;
+        }
+        lCommitted += pSession->mQueueLimit.load(std::memory_order_relaxed);
+        size_t lFootprint = pSession->mRecoveryGranted + pSession->mQueueUsed.load(std::memory_order_relaxed);
+        if (!pLargest || lFootprint > lLargest) {
+            pLargest = pSession;
+            lLargest = lFootprint;
+        }
+    }
+    if (lCommitted <= mSettings.mBudget || !pLargest) {
+        return false;
+    }
+    pLargest->mOverload = true;
+    mOverloads.fetch_add(1, std::memory_order_relaxed);
+    copyUsage(*pLargest, rOverload);
+    LOGGER(true, LOGG_ERROR, "Memory budget overloaded, " << lCommitted << " bytes committed, session "
+                             << pLargest->mName << " is the largest.")
+    return true;
+}
+
+void RISTNetMemoryGovernor::callOverload(const SessionUsage &rOverload) {
+    if (overloadCallback) {
+        overloadCallback(rOverload);
+    }
+}
+
+void RISTNetMemoryGovernor::copyUsage(const RISTNetMemorySession &rSession, SessionUsage &rUsage) {
+    rUsage.mID = rSession.mID;
+    rUsage.mName = rSession.mName;
+    rUsage.mPeers = rSession.mPeers;
+    rUsage.mRecoveryEstimate = rSession.mRecoveryEstimate;
+    rUsage.mRecoveryGranted = rSession.mRecoveryGranted;
+    rUsage.mQueueEstimate = rSession.mQueueEstimate;
+    rUsage.mQueueLimit = rSession.mQueueLimit.load(std::memory_order_relaxed);
+    rUsage.mQueueUsed = rSession.mQueueUsed.load(std::memory_order_relaxed);
+    rUsage.mQueuePeak = rSession.mQueuePeak.load(std::memory_order_relaxed);
+    rUsage.mQueueDropped = rSession.mQueueDropped.load(std::memory_order_relaxed);
+    rUsage.mOverload = rSession.mOverload;
+}
+
+void RISTNetMemoryGovernor::getSessions(std::vector<SessionUsage> &rSessions) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    rSessions.resize(mSessions.size());
+    for (size_t i = 0; i < mSessions.size(); i++) {
+        copyUsage(*mSessions[i], rSessions[i]);
+    }
+}
+
+void RISTNetMemoryGovernor::getUsage(const RISTNetMemorySession &rSession, SessionUsage &rUsage) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    copyUsage(rSession, rUsage);
+}
+
+void RISTNetMemoryGovernor::getStatistics(GovernorStatistics &rStatistics) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    rStatistics.mBudget = mSettings.mBudget;
+    rStatistics.mUsed = mRecoveryGranted.load(std::memory_order_relaxed) + mQueueUsed.load(std::memory_order_relaxed);
+    rStatistics.mCommitted = mRecoveryGranted.load(std::memory_order_relaxed);
+    for (auto *pSession: mSessions) {
+        rStatistics.mCommitted += pSession->mQueueLimit.load(std::memory_order_relaxed);
+    }
+    rStatistics.mSessions = mSessions.size();
+    rStatistics.mAdmitted = mAdmitted.load(std::memory_order_relaxed);
+    rStatistics.mClamped = mClamped.load(std::memory_order_relaxed);
+    rStatistics.mRejected = mRejected.load(std::memory_order_relaxed);
+    rStatistics.mShrinks = mShrinks.load(std::memory_order_relaxed);
+    rStatistics.mOverloads = mOverloads.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,255 @@
+//
+// RISTNetMemoryGovernor -- Process-wide memory budget of the RIST receivers and senders
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+// k constant
+
+#ifndef CPPRISTWRAPPER__RISTNETMEMORYGOVERNOR_H
+#define CPPRISTWRAPPER__RISTNETMEMORYGOVERNOR_H
+
+#include "librist.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class RISTNetMemoryGovernor;
+
+/**
+ * \class RISTNetMemorySession
+ *
+ * \brief
+ *
+ * The account of one receiver or sender in a RISTNetMemoryGovernor, closed when destroyed. The recovery buffers of
+ * librist are accounted at their estimate (granted at open) per peer, the event queue at the bytes queued.
+ *
+ */
+class RISTNetMemorySession {
+public:
+
+    /// Destructor, closes the session
+    virtual ~RISTNetMemorySession();
+
+    /**
+     * @brief Account bytes pushed to the event queue
+     *
+     * Lock free unless the use crosses the shrink or restore level of the governor.
+     *
+     * @param the bytes
+     * @return false if over the queue limit, the event is to be dropped (not accounted)
+     */
+    bool reserveQueue(size_t lBytes);
+
+    /// Account bytes drained from the event queue
+    void releaseQueue(size_t lBytes);
+
+    /**
+     * @brief Account the recovery buffers of lPeers peers
+     *
+     * Each peer at the share of one peer granted at open. The peers are connected already: not rejected over the
+     * budget, the queues shrink and overloadCallback is called as for the event queues.
+     *
+     * @param the peers, connected or configured
+     */
+    void setPeers(size_t lPeers);
+
+    /// The bytes the event queue may hold now
+    size_t getQueueLimit() const {
+        return mQueueLimit.load(std::memory_order_relaxed);
+    }
+
+    /// The recovery bytes granted, less than the estimate if the governor clamped the session
+    size_t getRecoveryGranted() const {
+        return mRecoveryGranted.load(std::memory_order_relaxed);
+    }
+
+    /// The governor of the session
+    RISTNetMemoryGovernor &getGovernor() const {
+        return mGovernor;
+    }
+
+    // Delete copy and move constructors and assign operators
+    RISTNetMemorySession(RISTNetMemorySession const &) = delete;             // Copy construct
+    RISTNetMemorySession(RISTNetMemorySession &&) = delete;                  // Move construct
+    RISTNetMemorySession &operator=(RISTNetMemorySession const &) = delete;  // Copy assign
+    RISTNetMemorySession &operator=(RISTNetMemorySession &&) = delete;       // Move assign
+
+private:
+
+    friend class RISTNetMemoryGovernor;
+
+    RISTNetMemorySession(RISTNetMemoryGovernor &rGovernor, uint64_t lID, const std::string &rName,
+                         size_t lRecoveryEstimate, size_t lRecoveryGranted, size_t lQueueEstimate, size_t lPeers);
+
+    RISTNetMemoryGovernor &mGovernor;
+    const uint64_t mID;
+    const std::string mName;
+    const size_t mPeerEstimate;                 // Recovery bytes of one peer
+    const size_t mPeerGranted;
+    const size_t mQueueEstimate;
+    size_t mPeers;                              // Under the mutex of the governor
+    size_t mRecoveryEstimate;                   // Under the mutex of the governor
+    std::atomic<size_t> mRecoveryGranted;       // Written under the mutex of the governor
+    std::atomic<size_t> mQueueLimit;
+    std::atomic<size_t> mQueueUsed{0};
+    std::atomic<size_t> mQueuePeak{0};
+    std::atomic<uint64_t> mQueueDropped{0};
+    bool mOverload = false;                     // Under the mutex of the governor
+};
+
+/**
+ * \class RISTNetMemoryGovernor
+ *
+ * \brief
+ *
+ * Accounts the memory of the receivers and senders against one budget. A session asks at init for the librist
+ * recovery buffers it may fill (peers x recovery_maxbitrate x recovery_length_max) and is rejected, or with kClamp
+ * granted what is left, the wrapper then shortens recovery_length_max to fit. At runtime the event queues are
+ * accounted by the bytes queued. When the use passes mShrinkAt of the budget the queue limits shrink, shared by
+ * queue size and not below mMinQueueBytes, dropping data instead of growing. Only when the recovery buffers and
+ * the shrunk queues still do not fit is overloadCallback called, with the largest session, to stop it.
+ * The budget 0 only accounts.
+ *
+ */
+class RISTNetMemoryGovernor {
+public:
+
+    enum class AdmissionPolicy {
+        kReject,        // Reject a session over the budget
+        kClamp          // Grant what is left if at least mMinRecoveryShare of the estimate, else reject
+    };
+
+    struct RISTNetMemoryGovernorSettings {
+        size_t mBudget = 0;                     // Bytes of all the sessions, 0 only accounts
+        AdmissionPolicy mPolicy = AdmissionPolicy::kClamp;
+        double mMinRecoveryShare = 0.25;        // Of the recovery estimate, the least kClamp grants
+        double mShrinkAt = 0.85;                // Share of the budget used where the queues shrink
+        size_t mMinQueueBytes = 64 * 1024;      // Queue limits do not shrink below
+    };
+
+    struct SessionUsage {
+        uint64_t mID = 0;
+        std::string mName;                      // The CNAME or the first URL
+        size_t mPeers = 0;                      // Peers the recovery buffers are accounted for
+        size_t mRecoveryEstimate = 0;           // Bytes asked for the librist recovery buffers
+        size_t mRecoveryGranted = 0;
+        size_t mQueueEstimate = 0;              // Bytes of the event queue full, the limit when not shrunk
+        size_t mQueueLimit = 0;                 // Bytes the event queue may hold now
+        size_t mQueueUsed = 0;
+        size_t mQueuePeak = 0;
+        uint64_t mQueueDropped = 0;             // Events dropped over the queue limit
+        bool mOverload = false;                 // Given to overloadCallback, not yet closed
+    };
+
+    struct GovernorStatistics {
+        size_t mBudget = 0;
+        size_t mUsed = 0;                       // Recovery granted and queues used
+        size_t mCommitted = 0;                  // Recovery granted and queue limits
+        size_t mSessions = 0;
+        uint64_t mAdmitted = 0;
+        uint64_t mClamped = 0;                  // Admitted with less recovery than the estimate
+        uint64_t mRejected = 0;
+        uint64_t mShrinks = 0;                  // Queue limits lowered
+        uint64_t mOverloads = 0;                // overloadCallback calls
+    };
+
+    /// Constructor
+    RISTNetMemoryGovernor();
+
+    /// Destructor, the sessions are to be closed before
+    virtual ~RISTNetMemoryGovernor();
+
+    /// The governor of the receivers and senders not given one, budget 0 until initGovernor
+    static RISTNetMemoryGovernor &globalGovernor();
+
+    /**
+     * @brief Initialize the governor
+     *
+     * May be called with sessions open, the new budget applies to the queues at once and to the next sessions.
+     *
+     * @param The governor settings
+     * @return true on success
+     */
+    bool initGovernor(RISTNetMemoryGovernorSettings &rSettings);
+
+    /// The recovery buffer bytes of lPeers peers configured by rConfig
+    static size_t estimateRecoveryBytes(const rist_peer_config &rConfig, size_t lPeers);
+
+    /**
+     * @brief Open a session
+     *
+     * @param the name reported
+     * @param the recovery buffer bytes asked
+     * @param the event queue bytes when full (max events x RIST_MAX_PACKET_SIZE)
+     * @param the session, closed when released
+     * @param the peers lRecoveryBytes is for, RISTNetMemorySession::setPeers charges their share per peer
+     * @return false if rejected
+     */
+    bool openSession(const std::string &rName, size_t lRecoveryBytes, size_t lQueueBytes,
+                     std::unique_ptr<RISTNetMemorySession> &rSession, size_t lPeers = 1);
+
+    /// The use of every session
+    void getSessions(std::vector<SessionUsage> &rSessions);
+
+    /// The use of one session
+    void getUsage(const RISTNetMemorySession &rSession, SessionUsage &rUsage);
+
+    void getStatistics(GovernorStatistics &rStatistics);
+
+    /**
+     * @brief Called when the shrunk queues do not bring the sessions under the budget (__NULLABLE)
+     *
+     * Given the largest session, once until it closes. Called from the thread opening a session or pushing an
+     * event (a librist thread), stop the session from another thread.
+     */
+    std::function<void(const SessionUsage &rUsage)> overloadCallback = nullptr;
+
+    // Delete copy and move constructors and assign operators
+    RISTNetMemoryGovernor(RISTNetMemoryGovernor const &) = delete;             // Copy construct
+    RISTNetMemoryGovernor(RISTNetMemoryGovernor &&) = delete;                  // Move construct
+    RISTNetMemoryGovernor &operator=(RISTNetMemoryGovernor const &) = delete;  // Copy assign
+    RISTNetMemoryGovernor &operator=(RISTNetMemoryGovernor &&) = delete;       // Move assign
+
+private:
+
+    friend class RISTNetMemorySession;
+
+    void closeSession(RISTNetMemorySession &rSession);
+
+    void peersChanged(RISTNetMemorySession &rSession, size_t lPeers);
+
+    // Called by the sessions, rebalance when the use crosses the shrink or restore level
+    void queueChanged(size_t lUsed);
+
+    // Set the queue limits and find the overload, under mMtx. The overloaded session is copied to rOverload.
+    bool rebalance(SessionUsage &rOverload);
+
+    void copyUsage(const RISTNetMemorySession &rSession, SessionUsage &rUsage);
+
+    void callOverload(const SessionUsage &rOverload);
+
+    RISTNetMemoryGovernorSettings mSettings;
+    std::mutex mMtx;
+    std::vector<RISTNetMemorySession *> mSessions;
+    uint64_t mNextID = 1;
+    std::atomic<size_t> mShrinkBytes{0};        // Used over, the queues shrink
+    std::atomic<size_t> mRecoveryGranted{0};
+    std::atomic<size_t> mQueueUsed{0};
+    std::atomic<bool> mShrunk{false};
+    std::atomic<uint64_t> mAdmitted{0};
+    std::atomic<uint64_t> mClamped{0};
+    std::atomic<uint64_t> mRejected{0};
+    std::atomic<uint64_t> mShrinks{0};
+    std::atomic<uint64_t> mOverloads{0};
+};
+
+#endif //CPPRISTWRAPPER__RISTNETMEMORYGOVERNOR_H
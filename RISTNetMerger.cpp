@@ -0,0 +1,437 @@
+//
+// RISTNetMerger -- Seamless merging of several RISTNetReceiver legs (SMPTE 2022-7 style)
+//
+
+#include "RISTNetMerger.h"
+#include "RISTNetInternal.h"
+#include "xxhash.h"
+
+static size_t roundUpPowerOfTwo(size_t lValue) {
+    size_t lPower = 1;
+    while (lPower < lValue) {
+        lPower <<= 1;
+    }
+    return lPower;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// RISTNetMerger  --  Fingerprint window --- Start
+//---------------------------------------------------------------------------------------------------------------------
+
+void RISTNetMerger::FingerprintWindow::init(size_t lWindowSize) {
+    mTable.assign(roundUpPowerOfTwo(lWindowSize * 2), 0);
+    mTableMask = mTable.size() - 1;
+    mRing.assign(lWindowSize, 0);
+    mRingPos = 0;
+    mRingFill = 0;
+}
+
+bool RISTNetMerger::FingerprintWindow::insert(uint64_t lFingerprint) {
+    if (!lFingerprint) {
+        lFingerprint = 1; // 0 marks an empty slot
+    }
+    size_t lIndex = lFingerprint & mTableMask;
+    while (mTable[lIndex]) {
+        if (mTable[lIndex] == lFingerprint) {
+            return false;
+        }
+        lIndex = (lIndex + 1) & mTableMask;
+    }
+
+    if (mRingFill == mRing.size()) {
+        erase(mRing[mRingPos]);
+        // The erase may have moved entries, find the free slot again
+        lIndex = lFingerprint & mTableMask;
+        while (mTable[lIndex]) {
+            lIndex = (lIndex + 1) & mTableMask;
+        }
+    } else {
+        mRingFill++;
+    }
+    mTable[lIndex] = lFingerprint;
+    mRing[mRingPos] = lFingerprint;
+    mRingPos = (mRingPos + 1) % mRing.size();
+    return true;
+}
+
+void RISTNetMerger::FingerprintWindow::erase(uint64_t lFingerprint) {
+    size_t lHole = lFingerprint & mTableMask;
+    while (mTable[lHole] != lFingerprint) {
+        if (!mTable[lHole]) {
+            return;
+        }
+        lHole = (lHole + 1) & mTableMask;
+    }
+    // Backward shift deletion, keeps every entry reachable from its home slot without tombstones
+    size_t lNext = lHole;
+    while (true) {
+        lNext = (lNext + 1) & mTableMask;
+        if (!mTable[lNext]) {
+            break;
+        }
+        size_t lHome = mTable[lNext] & mTableMask;
+        bool lStays = (lHole <= lNext) ? (lHole < lHome && lHome <= lNext) : (lHole < lHome || lHome <= lNext);
+        if (lStays) {
+            continue;
+        }
+        mTable[lHole] = mTable[lNext];
+        lHole = lNext;
+    }
+    mTable[lHole] = 0;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+// RISTNetMerger  --  Fingerprint window --- End
+//---------------------------------------------------------------------------------------------------------------------
+
+RISTNetMerger::RISTNetMerger() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetMerger constructed")
+}
+
+RISTNetMerger::~RISTNetMerger() {
+    if (mInitialised) {
+        destroyMerger();
+    }
+    LOGGER(false, LOGG_NOTIFY, "RISTNetMerger destruct")
+}
+
+bool RISTNetMerger::initMerger(RISTNetMergerSettings &rSettings) {
+    if (mInitialised) {
+        LOGGER(true, LOGG_ERROR, "RISTNetMerger already initialised.")
+        return false;
+    }
+    if (!rSettings.mLegs || !rSettings.mWindowSize) {
+        LOGGER(true, LOGG_ERROR, "RISTNetMerger needs at least one leg and a window.")
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lLock(mMergerMtx);
+    mSettings = rSettings;
+    mSettings.mWindowSize = roundUpPowerOfTwo(rSettings.mWindowSize);
+    mStatistics = MergerStatistics();
+    mStatistics.mLegs.resize(mSettings.mLegs);
+    mReleased.clear();
+    mSpareBuffers.clear();
+    mDelivering = false;
+
+    if (mSettings.mSequenceComparable) {
+        mFlows.clear();
+        mWindowMask = mSettings.mWindowSize - 1;
+        mHeldCount = 0;
+        mHoldTimerRun = true;
+        mHoldTimerThread = std::thread(&RISTNetMerger::holdTimerWorker, this);
+    } else {
+        mFingerprints.init(mSettings.mWindowSize);
+    }
+    mInitialised = true;
+    return true;
+}
+
+bool RISTNetMerger::attachReceiver(uint32_t lLeg, RISTNetReceiver &rReceiver) {
+    if (!mInitialised || lLeg >= mSettings.mLegs) {
+        LOGGER(true, LOGG_ERROR, "RISTNetMerger not initialised or leg out of range.")
+        return false;
+    }
+    rReceiver.networkDataBlockCallback = [this, lLeg](const rist_data_block &rDataBlock,
+                                                      std::shared_ptr<RISTNetReceiver::NetworkConnection> &rConnection) {
+        pushData(lLeg, (const uint8_t *) rDataBlock.payload, rDataBlock.payload_len, rDataBlock.flow_id,
+                 rDataBlock.seq);
+        return 0;
+    };
+    return true;
+}
+
+bool RISTNetMerger::pushData(uint32_t lLeg, const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID,
+                             uint64_t lSeq) {
+    if (!mInitialised || lLeg >= mSettings.mLegs) {
+        LOGGER(true, LOGG_ERROR, "RISTNetMerger not initialised or leg out of range.")
+        return false;
+    }
+    std::unique_lock<std::mutex> lLock(mMergerMtx);
+    mStatistics.mLegs[lLeg].mPackets++;
+    mStatistics.mLegs[lLeg].mBytes += lSize;
+    if (mSettings.mSequenceComparable) {
+        bool lAccepted = pushSequenced(lLeg, pBuf, lSize, lConnectionID, lSeq);
+        deliverReleased(lLock);
+        return lAccepted;
+    }
+    if (!pushFingerprinted(lLeg, pBuf, lSize, lConnectionID)) {
+        return false;
+    }
+    deliverReleased(lLock, pBuf, lSize, lConnectionID);
+    return true;
+}
+
+bool RISTNetMerger::pushFingerprinted(uint32_t lLeg, const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID) {
+    uint64_t lFingerprint = XXH64(pBuf, lSize, lConnectionID);
+    if (!mFingerprints.insert(lFingerprint)) {
+        mStatistics.mLegs[lLeg].mDuplicates++;
+        return false;
+    }
+    mStatistics.mLegs[lLeg].mContributed++;
+    mStatistics.mDelivered++;
+    return true;
+}
+
+uint64_t RISTNetMerger::extendSeq(const SequencedFlow &rFlow, uint64_t lSeq) const {
+    if (!rFlow.mHaveNextSeq || lSeq > UINT32_MAX) {
+        return lSeq;
+    }
+    // A 32 bit sequence number, in the wrap of the expected one or the one next to it
+    const uint64_t lWrap = (uint64_t) UINT32_MAX + 1;
+    uint64_t lExtended = (rFlow.mNextSeq & ~(uint64_t) UINT32_MAX) | lSeq;
+    if (lExtended + lWrap / 2 < rFlow.mNextSeq) {
+        lExtended += lWrap;
+    } else if (lExtended >= lWrap && lExtended > rFlow.mNextSeq + lWrap / 2) {
+        lExtended -= lWrap;
+    }
+    return lExtended;
+}
+
+bool RISTNetMerger::pushSequenced(uint32_t lLeg, const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID,
+                                  uint64_t lSeq) {
+    auto lNow = std::chrono::steady_clock::now();
+    std::unique_ptr<SequencedFlow> &rFlowSlot = mFlows[lConnectionID];
+    if (!rFlowSlot) {
+        rFlowSlot = std::make_unique<SequencedFlow>();
+        rFlowSlot->mHeld.resize(mSettings.mWindowSize);
+        rFlowSlot->mDeliveredSeq.assign(mSettings.mWindowSize, 0);
+    }
+    SequencedFlow &rFlow = *rFlowSlot;
+    lSeq = extendSeq(rFlow, lSeq);
+    if (!rFlow.mHaveNextSeq) {
+        rFlow.mNextSeq = lSeq;
+        rFlow.mHaveNextSeq = true;
+    }
+
+    auto lWindow = static_cast<int64_t>(mSettings.mWindowSize);
+    auto lDelta = static_cast<int64_t>(lSeq - rFlow.mNextSeq);
+
+    if (lDelta >= 2 * lWindow || lDelta <= -2 * lWindow) {
+        // The stream jumped (sender restart or a leg far behind). Deliver what we hold and start over, what a jump
+        // forward skips is lost.
+        LOGGER(true, LOGG_WARN, "RISTNetMerger sequence discontinuity, resynchronizing.")
+        while (rFlow.mHeldCount) {
+            if (rFlow.mHeld[rFlow.mNextSeq & mWindowMask].mValid) {
+                deliverInOrder(rFlow);
+            } else {
+                mStatistics.mLost++;
+                advanceNextSeq(rFlow, false);
+            }
+        }
+        if (static_cast<int64_t>(lSeq - rFlow.mNextSeq) > 0) {
+            mStatistics.mLost += lSeq - rFlow.mNextSeq;
+        }
+        rFlow.mNextSeq = lSeq;
+        lDelta = 0;
+    }
+
+    if (lDelta < 0) {
+        if (rFlow.mDeliveredSeq[lSeq & mWindowMask] == lSeq + 1) {
+            mStatistics.mLegs[lLeg].mDuplicates++;
+        } else {
+            mStatistics.mLegs[lLeg].mLate++;
+        }
+        return false;
+    }
+
+    // Make room in the window, whatever is in the way is delivered or declared lost
+    while (lDelta >= lWindow) {
+        if (rFlow.mHeld[rFlow.mNextSeq & mWindowMask].mValid) {
+            deliverInOrder(rFlow);
+        } else {
+            mStatistics.mLost++;
+            advanceNextSeq(rFlow, false);
+        }
+        lDelta = static_cast<int64_t>(lSeq - rFlow.mNextSeq);
+    }
+
+    HeldPacket &rSlot = rFlow.mHeld[lSeq & mWindowMask];
+    if (rSlot.mValid) {
+        mStatistics.mLegs[lLeg].mDuplicates++;
+        return false;
+    }
+    rSlot.mValid = true;
+    rSlot.mSeq = lSeq;
+    rSlot.mLeg = lLeg;
+    rSlot.mConnectionID = lConnectionID;
+    rSlot.mArrival = lNow;
+    if (!rSlot.mData.capacity() && !mSpareBuffers.empty()) {
+        rSlot.mData.swap(mSpareBuffers.back());
+        mSpareBuffers.pop_back();
+    }
+    rSlot.mData.assign(pBuf, pBuf + lSize);
+    mHeldCount++;
+    if (!rFlow.mHeldCount++ && lDelta) {
+        // First packet waiting for a gap to be filled
+        rFlow.mGapSince = lNow;
+        mHoldTimerCondition.notify_one();
+    }
+
+    deliverInOrder(rFlow);
+    if (rFlow.mHeldCount && lNow - rFlow.mGapSince >= mSettings.mMaxHoldTime) {
+        skipGap(rFlow, lNow);
+    }
+    return true;
+}
+
+void RISTNetMerger::advanceNextSeq(SequencedFlow &rFlow, bool lDelivered) {
+    rFlow.mDeliveredSeq[rFlow.mNextSeq & mWindowMask] = lDelivered ? rFlow.mNextSeq + 1 : 0;
+    rFlow.mNextSeq++;
+}
+
+void RISTNetMerger::release(HeldPacket &rSlot) {
+    mReleased.emplace_back();
+    ReleasedPacket &rReleased = mReleased.back();
+    rReleased.mConnectionID = rSlot.mConnectionID;
+    rReleased.mData.swap(rSlot.mData);
+    rSlot.mValid = false;
+}
+
+void RISTNetMerger::deliverInOrder(SequencedFlow &rFlow) {
+    bool lDelivered = false;
+    while (rFlow.mHeldCount) {
+        HeldPacket &rSlot = rFlow.mHeld[rFlow.mNextSeq & mWindowMask];
+        if (!rSlot.mValid || rSlot.mSeq != rFlow.mNextSeq) {
+            break;
+        }
+        mStatistics.mLegs[rSlot.mLeg].mContributed++;
+        mStatistics.mDelivered++;
+        release(rSlot);
+        rFlow.mHeldCount--;
+        mHeldCount--;
+        advanceNextSeq(rFlow, true);
+        lDelivered = true;
+    }
+    if (lDelivered && rFlow.mHeldCount) {
+        // A new gap, the hold time starts from the arrival of the first packet behind it
+        for (uint64_t lSeq = rFlow.mNextSeq; ; lSeq++) {
+            HeldPacket &rSlot = rFlow.mHeld[lSeq & mWindowMask];
+            if (rSlot.mValid) {
+                rFlow.mGapSince = rSlot.mArrival;
+                break;
+            }
+        }
+    }
+}
+
+void RISTNetMerger::skipGap(SequencedFlow &rFlow, std::chrono::steady_clock::time_point lNow) {
+    while (rFlow.mHeldCount && !rFlow.mHeld[rFlow.mNextSeq & mWindowMask].mValid) {
+        mStatistics.mLost++;
+        advanceNextSeq(rFlow, false);
+    }
+    rFlow.mGapSince = lNow;
+    deliverInOrder(rFlow);
+}
+
+void RISTNetMerger::deliverReleased(std::unique_lock<std::mutex> &rLock, const uint8_t *pDirect, size_t lSize,
+                                    uint16_t lConnectionID) {
+    if (mDelivering) {
+        // The thread delivering keeps the order, it takes a copy
+        if (pDirect) {
+            mReleased.emplace_back();
+            ReleasedPacket &rReleased = mReleased.back();
+            rReleased.mConnectionID = lConnectionID;
+            if (!mSpareBuffers.empty()) {
+                rReleased.mData.swap(mSpareBuffers.back());
+                mSpareBuffers.pop_back();
+            }
+            rReleased.mData.assign(pDirect, pDirect + lSize);
+        }
+        return;
+    }
+    mDelivering = true;
+    if (pDirect) {
+        rLock.unlock();
+        if (mergedDataCallback) {
+            mergedDataCallback(pDirect, lSize, lConnectionID);
+        }
+        rLock.lock();
+    }
+    while (!mReleased.empty()) {
+        mDelivery.swap(mReleased);
+        rLock.unlock();
+        if (mergedDataCallback) {
+            for (auto &rReleased: mDelivery) {
+                mergedDataCallback(rReleased.mData.data(), rReleased.mData.size(), rReleased.mConnectionID);
+            }
+        }
+        rLock.lock();
+        for (auto &rReleased: mDelivery) {
+            if (mSpareBuffers.size() < mSettings.mWindowSize) {
+                mSpareBuffers.push_back(std::move(rReleased.mData));
+            }
+        }
+        mDelivery.clear();
+    }
+    mDelivering = false;
+}
+
+void RISTNetMerger::holdTimerWorker() {
+    std::unique_lock<std::mutex> lLock(mMergerMtx);
+    while (mHoldTimerRun) {
+        if (!mHeldCount) {
+            mHoldTimerCondition.wait(lLock);
+            continue;
+        }
+        // Skip the gaps held too long, wait for the next one
+        auto lNow = std::chrono::steady_clock::now();
+        auto lDeadline = std::chrono::steady_clock::time_point::max();
+        bool lSkipped = false;
+        for (auto &rEntry: mFlows) {
+            SequencedFlow &rFlow = *rEntry.second;
+            if (!rFlow.mHeldCount) {
+                continue;
+            }
+            if (lNow >= rFlow.mGapSince + mSettings.mMaxHoldTime) {
+                skipGap(rFlow, lNow);
+                lSkipped = true;
+            } else {
+                lDeadline = std::min(lDeadline, rFlow.mGapSince + mSettings.mMaxHoldTime);
+            }
+        }
+        if (lSkipped) {
+            deliverReleased(lLock);
+            continue;
+        }
+        mHoldTimerCondition.wait_until(lLock, lDeadline);
+    }
+}
+
+void RISTNetMerger::getStatistics(MergerStatistics &rStatistics) {
+    std::lock_guard<std::mutex> lLock(mMergerMtx);
+    rStatistics = mStatistics;
+}
+
+bool RISTNetMerger::destroyMerger() {
+    if (!mInitialised) {
+        LOGGER(true, LOGG_WARN, "RISTNetMerger not initialised.")
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lLock(mMergerMtx);
+        mHoldTimerRun = false;
+    }
+    mHoldTimerCondition.notify_one();
+    if (mHoldTimerThread.joinable()) {
+        // From mergedDataCallback on the hold timer thread, it ends once the callback returns
+        if (mHoldTimerThread.get_id() == std::this_thread::get_id()) {
+            mHoldTimerThread.detach();
+        } else {
+            mHoldTimerThread.join();
+        }
+    }
+
+    std::unique_lock<std::mutex> lLock(mMergerMtx);
+    if (mSettings.mSequenceComparable) {
+        // Flush what is held, gaps can not be filled anymore
+        for (auto &rEntry: mFlows) {
+            while (rEntry.second->mHeldCount) {
+                skipGap(*rEntry.second, std::chrono::steady_clock::now());
+            }
+        }
+    }
+    mInitialised = false;
+    deliverReleased(lLock);
+    return true;
+}
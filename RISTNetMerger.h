@@ -0,0 +1,217 @@
+//
+// RISTNetMerger -- Seamless merging of several RISTNetReceiver legs (SMPTE 2022-7 style)
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETMERGER_H
+#define CPPRISTWRAPPER__RISTNETMERGER_H
+
+#include "RISTNet.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+
+/**
+ * \class RISTNetMerger
+ *
+ * \brief
+ *
+ * A RISTNetMerger takes the packets from N independent RISTNetReceivers (legs) carrying the same stream
+ * and outputs one deduplicated stream. librist only deduplicates within one context, the merger does it
+ * across contexts.
+ *
+ * If the legs are fed by the same RIST sender the RIST sequence numbers are comparable and are used both
+ * for deduplication and for ordering, per flow (flow id and sequence number). Packets are then held until the
+ * gap in front of them is filled by any leg, or until mMaxHoldTime has passed, then the gap is declared lost.
+ * Sequence numbers are 64 bit, the ones under 2^32 (librist wrapping at 32 bit) are extended across the wrap.
+ *
+ * If the legs are fed by independent senders the sequence numbers are not comparable. The packets are then
+ * fingerprinted (xxhash of flow id and payload) and the fingerprints of the last mWindowSize packets are kept
+ * in a sliding window with O(1) lookups. Packets are delivered in first arrival order.
+ *
+ * mergedDataCallback is called without the merger lock held, by one thread at a time, in order. It may call
+ * getStatistics and destroyMerger.
+ *
+ */
+class RISTNetMerger {
+public:
+
+    struct RISTNetMergerSettings {
+        uint32_t mLegs = 2;
+        bool mSequenceComparable = true;
+        size_t mWindowSize = 4096; // Rounded up to a power of two
+        std::chrono::milliseconds mMaxHoldTime{100};
+    };
+
+    struct LegStatistics {
+        uint64_t mPackets = 0;      // Packets received on this leg
+        uint64_t mBytes = 0;        // Bytes received on this leg
+        uint64_t mContributed = 0;  // Packets where this leg was first, meaning the packet delivered came from this leg
+        uint64_t mDuplicates = 0;   // Packets already received from another (or this) leg
+        uint64_t mLate = 0;         // Packets arriving after the merger gave up waiting for them
+    };
+
+    struct MergerStatistics {
+        uint64_t mDelivered = 0;    // Packets delivered by mergedDataCallback
+        uint64_t mLost = 0;         // Packets not received by any leg within the hold time or skipped by a jump forward
+        std::vector<LegStatistics> mLegs;
+    };
+
+    /// Constructor
+    RISTNetMerger();
+
+    /// Destructor
+    virtual ~RISTNetMerger();
+
+    /**
+     * @brief Initialize merger
+     *
+     * Initialize the merger using the provided settings.
+     *
+     * @param The merger settings
+     * @return true on success
+     */
+    bool initMerger(RISTNetMergerSettings &rSettings);
+
+    /**
+     * @brief Attach a receiver
+     *
+     * Routes all data received by the receiver to the given leg of the merger.
+     * This replaces the networkDataBlockCallback of the receiver. The merger must outlive the receiver.
+     *
+     * @param the leg (0 to mLegs - 1)
+     * @param the receiver
+     * @return true on success
+     */
+    bool attachReceiver(uint32_t lLeg, RISTNetReceiver &rReceiver);
+
+    /**
+     * @brief Push data
+     *
+     * Feeds a packet received on a leg to the merger. Thread safe, can be called from any thread.
+     *
+     * @param the leg (0 to mLegs - 1)
+     * @param pointer to the data
+     * @param length of the data
+     * @param the connection id (flow id) of the packet
+     * @param the RIST sequence number of the packet (ignored if the sequence numbers are not comparable)
+     * @return true if the packet was accepted, false if it was a duplicate, late or the merger is not initialised
+     */
+    bool pushData(uint32_t lLeg, const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID, uint64_t lSeq);
+
+    /**
+     * @brief Get statistics
+     *
+     * Gets the merger and per leg statistics.
+     *
+     * @param the statistics
+     */
+    void getStatistics(MergerStatistics &rStatistics);
+
+    /**
+     * @brief Destroys the merger
+     *
+     * Delivers what is held and stops the merger.
+     *
+     */
+    bool destroyMerger();
+
+    /// Callback delivering the merged stream, from the thread pushing or the hold timer thread
+    std::function<void(const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID)> mergedDataCallback = nullptr;
+
+    // Delete copy and move constructors and assign operators
+    RISTNetMerger(RISTNetMerger const &) = delete;             // Copy construct
+    RISTNetMerger(RISTNetMerger &&) = delete;                  // Move construct
+    RISTNetMerger &operator=(RISTNetMerger const &) = delete;  // Copy assign
+    RISTNetMerger &operator=(RISTNetMerger &&) = delete;       // Move assign
+
+private:
+
+    // Fixed size sliding window of fingerprints with O(1) lookup.
+    // Open addressing (linear probing) table indexed by the fingerprint plus a ring remembering the insert order.
+    class FingerprintWindow {
+    public:
+        void init(size_t lWindowSize);
+        // Returns false if the fingerprint is already in the window
+        bool insert(uint64_t lFingerprint);
+    private:
+        void erase(uint64_t lFingerprint);
+        std::vector<uint64_t> mTable;
+        std::vector<uint64_t> mRing;
+        size_t mTableMask = 0;
+        size_t mRingPos = 0;
+        size_t mRingFill = 0;
+    };
+
+    struct HeldPacket {
+        bool mValid = false;
+        uint64_t mSeq = 0;
+        uint32_t mLeg = 0;
+        uint16_t mConnectionID = 0;
+        std::chrono::steady_clock::time_point mArrival;
+        std::vector<uint8_t> mData;
+    };
+
+    // The window of one flow in sequence mode
+    struct SequencedFlow {
+        std::vector<HeldPacket> mHeld;
+        std::vector<uint64_t> mDeliveredSeq; // seq + 1 of delivered packets, 0 means empty or skipped
+        size_t mHeldCount = 0;
+        bool mHaveNextSeq = false;
+        uint64_t mNextSeq = 0;
+        std::chrono::steady_clock::time_point mGapSince;
+    };
+
+    // A packet released in order, delivered once the lock is released
+    struct ReleasedPacket {
+        uint16_t mConnectionID = 0;
+        std::vector<uint8_t> mData;
+    };
+
+    bool pushSequenced(uint32_t lLeg, const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID, uint64_t lSeq);
+    bool pushFingerprinted(uint32_t lLeg, const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID);
+    uint64_t extendSeq(const SequencedFlow &rFlow, uint64_t lSeq) const;
+    void deliverInOrder(SequencedFlow &rFlow);
+    void skipGap(SequencedFlow &rFlow, std::chrono::steady_clock::time_point lNow);
+    void advanceNextSeq(SequencedFlow &rFlow, bool lDelivered);
+    void release(HeldPacket &rSlot);
+    // Calls mergedDataCallback with the packets released (pDirect first if set) with rLock released, unless another
+    // thread is, it then delivers them
+    void deliverReleased(std::unique_lock<std::mutex> &rLock, const uint8_t *pDirect = nullptr, size_t lSize = 0,
+                         uint16_t lConnectionID = 0);
+    void holdTimerWorker();
+
+    RISTNetMergerSettings mSettings;
+    std::atomic<bool> mInitialised{false};
+
+    // The mutex protecting all merger state below
+    std::mutex mMergerMtx;
+    MergerStatistics mStatistics;
+
+    // Sequence mode, a window per flow id
+    std::map<uint16_t, std::unique_ptr<SequencedFlow>> mFlows;
+    size_t mWindowMask = 0;
+    size_t mHeldCount = 0; // Of all the flows
+
+    // Fingerprint mode
+    FingerprintWindow mFingerprints;
+
+    // Released in order, mDelivering while a thread delivers them. The buffers delivered are kept for the next packets.
+    std::vector<ReleasedPacket> mReleased;
+    std::vector<ReleasedPacket> mDelivery;
+    std::vector<std::vector<uint8_t>> mSpareBuffers;
+    bool mDelivering = false;
+
+    // The hold timer
+    std::thread mHoldTimerThread;
+    std::condition_variable mHoldTimerCondition;
+    bool mHoldTimerRun = false;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETMERGER_H
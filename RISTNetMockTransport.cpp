@@ -0,0 +1,262 @@
+//
+// RISTNetMockTransport -- In-process replacement of librist for testing and benchmarking the wrapper
+//
+
+#include "RISTNetMockTransport.h"
+#include "RISTNetInternal.h"
+
+RISTNetMockTransport::RISTNetMockTransport() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetMockTransport constructed")
+}
+
+RISTNetMockTransport::~RISTNetMockTransport() {
+    detach();
+    LOGGER(false, LOGG_NOTIFY, "RISTNetMockTransport destruct")
+}
+
+bool RISTNetMockTransport::attachReceiver(RISTNetReceiver &rReceiver,
+                                          RISTNetReceiver::RISTNetReceiverSettings &rSettings) {
+    {
+        std::lock_guard<std::mutex> lLock(mPeerMtx);
+        if (mReceiver || mSender) {
+            LOGGER(true, LOGG_ERROR, "RISTNetMockTransport already attached.")
+            return false;
+        }
+    }
+    if (rReceiver.mRistContext || rReceiver.mMockTransport) {
+        LOGGER(true, LOGG_ERROR, "RISTNetReceiver already initialised.")
+        return false;
+    }
+    if (!rReceiver.initWrapper(rSettings, rSettings.mCNAME.empty() ? "mock" : rSettings.mCNAME, 1)) {
+        return false;
+    }
+    rReceiver.mMockTransport = this;
+    std::lock_guard<std::mutex> lLock(mPeerMtx);
+    mReceiver = &rReceiver;
+    return true;
+}
+
+bool RISTNetMockTransport::attachSender(RISTNetSender &rSender, RISTNetSender::RISTNetSenderSettings &rSettings) {
+    {
+        std::lock_guard<std::mutex> lLock(mPeerMtx);
+        if (mReceiver || mSender) {
+            LOGGER(true, LOGG_ERROR, "RISTNetMockTransport already attached.")
+            return false;
+        }
+    }
+    if (rSender.mRistContext || rSender.mMockTransport) {
+        LOGGER(true, LOGG_ERROR, "RISTNetSender already initialised.")
+        return false;
+    }
+    if (!rSender.initWrapper(rSettings, rSettings.mCNAME.empty() ? "mock" : rSettings.mCNAME, 1)) {
+        return false;
+    }
+    rSender.mMockTransport = this;
+    std::lock_guard<std::mutex> lLock(mPeerMtx);
+    mSender = &rSender;
+    return true;
+}
+
+rist_peer *RISTNetMockTransport::connectPeer(const std::string &rIPAddress, uint16_t lPort) {
+    auto lMockPeer = std::make_unique<MockPeer>();
+    lMockPeer->mIPAddress = rIPAddress;
+    lMockPeer->mPort = lPort;
+    rist_peer *pPeer = reinterpret_cast<rist_peer *>(lMockPeer.get());
+    RISTNetReceiver *lReceiver;
+    RISTNetSender *lSender;
+    {
+        std::lock_guard<std::mutex> lLock(mPeerMtx);
+        lReceiver = mReceiver;
+        lSender = mSender;
+        if (!lReceiver && !lSender) {
+            LOGGER(true, LOGG_ERROR, "RISTNetMockTransport not attached.")
+            return nullptr;
+        }
+        mPeers[pPeer] = std::move(lMockPeer);
+    }
+
+    int lStatus = lReceiver ? RISTNetReceiver::clientConnect(lReceiver, rIPAddress.c_str(), lPort, "0.0.0.0", 0, pPeer)
+                            : RISTNetSender::clientConnect(lSender, rIPAddress.c_str(), lPort, "0.0.0.0", 0, pPeer);
+    if (lStatus) {
+        mPeersRejected++;
+        std::lock_guard<std::mutex> lLock(mPeerMtx);
+        mPeers.erase(pPeer);
+        return nullptr;
+    }
+    mPeersConnected++;
+    return pPeer;
+}
+
+bool RISTNetMockTransport::disconnectPeer(rist_peer *pPeer) {
+    std::unique_ptr<MockPeer> lMockPeer;
+    RISTNetReceiver *lReceiver;
+    RISTNetSender *lSender;
+    {
+        std::lock_guard<std::mutex> lLock(mPeerMtx);
+        auto lIterator = mPeers.find(pPeer);
+        if (lIterator == mPeers.end()) {
+            return false;
+        }
+        // Kept until the wrapper has forgotten the peer so the pointer is not reused meanwhile
+        lMockPeer = std::move(lIterator->second);
+        mPeers.erase(lIterator);
+        lReceiver = mReceiver;
+        lSender = mSender;
+    }
+    if (lReceiver) {
+        RISTNetReceiver::clientDisconnect(lReceiver, pPeer);
+    } else if (lSender) {
+        RISTNetSender::clientDisconnect(lSender, pPeer);
+    }
+    mPeersDisconnected++;
+    return true;
+}
+
+int RISTNetMockTransport::injectData(rist_data_block &rDataBlock) {
+    RISTNetReceiver *lReceiver;
+    {
+        std::lock_guard<std::mutex> lLock(mPeerMtx);
+        lReceiver = mReceiver;
+    }
+    if (!lReceiver) {
+        LOGGER(true, LOGG_ERROR, "No RISTNetReceiver attached.")
+        return -1;
+    }
+    return RISTNetReceiver::receiveData(lReceiver, &rDataBlock);
+}
+
+int RISTNetMockTransport::injectData(rist_peer *pPeer, const uint8_t *pData, size_t lSize, uint16_t lFlowID,
+                                     uint64_t lSeq) {
+    rist_data_block lDataBlock{};
+    lDataBlock.payload = pData;
+    lDataBlock.payload_len = lSize;
+    lDataBlock.peer = pPeer;
+    lDataBlock.flow_id = lFlowID;
+    lDataBlock.seq = lSeq;
+    return injectData(lDataBlock);
+}
+
+int RISTNetMockTransport::injectOOBData(rist_peer *pPeer, const uint8_t *pData, size_t lSize) {
+    rist_oob_block lOOBBlock{};
+    lOOBBlock.peer = pPeer;
+    lOOBBlock.payload = pData;
+    lOOBBlock.payload_len = lSize;
+    RISTNetReceiver *lReceiver;
+    RISTNetSender *lSender;
+    {
+        std::lock_guard<std::mutex> lLock(mPeerMtx);
+        lReceiver = mReceiver;
+        lSender = mSender;
+    }
+    if (lReceiver) {
+        return RISTNetReceiver::receiveOOBData(lReceiver, &lOOBBlock);
+    }
+    if (lSender) {
+        return RISTNetSender::receiveOOBData(lSender, &lOOBBlock);
+    }
+    LOGGER(true, LOGG_ERROR, "RISTNetMockTransport not attached.")
+    return -1;
+}
+
+int RISTNetMockTransport::injectStatistics(const rist_stats &rStatistics) {
+    RISTNetReceiver *lReceiver;
+    RISTNetSender *lSender;
+    {
+        std::lock_guard<std::mutex> lLock(mPeerMtx);
+        lReceiver = mReceiver;
+        lSender = mSender;
+    }
+    if (lReceiver) {
+        return RISTNetReceiver::gotStatistics(lReceiver, &rStatistics);
+    }
+    if (lSender) {
+        return RISTNetSender::gotStatistics(lSender, &rStatistics);
+    }
+    LOGGER(true, LOGG_ERROR, "RISTNetMockTransport not attached.")
+    return -1;
+}
+
+size_t RISTNetMockTransport::getPeers() {
+    std::lock_guard<std::mutex> lLock(mPeerMtx);
+    return mPeers.size();
+}
+
+void RISTNetMockTransport::getPeerURLs(std::vector<std::string> &rURLs) {
+    std::lock_guard<std::mutex> lLock(mPeerMtx);
+    rURLs.clear();
+    for (auto &rPeer: mPeers) {
+        if (!rPeer.second->mURL.empty()) {
+            rURLs.push_back(rPeer.second->mURL);
+        }
+    }
+}
+
+void RISTNetMockTransport::getStatistics(MockTransportStatistics &rStatistics) {
+    rStatistics.mPeersConnected = mPeersConnected;
+    rStatistics.mPeersRejected = mPeersRejected;
+    rStatistics.mPeersDisconnected = mPeersDisconnected;
+    rStatistics.mPeersClosed = mPeersClosed;
+    rStatistics.mPeersCreated = mPeersCreated;
+    rStatistics.mPacketsWritten = mPacketsWritten;
+    rStatistics.mBytesWritten = mBytesWritten;
+    rStatistics.mOOBWritten = mOOBWritten;
+}
+
+void RISTNetMockTransport::detach() {
+    RISTNetReceiver *lReceiver;
+    RISTNetSender *lSender;
+    {
+        std::lock_guard<std::mutex> lLock(mPeerMtx);
+        lReceiver = mReceiver;
+        lSender = mSender;
+    }
+    // Calls targetDestroyed
+    if (lReceiver) {
+        lReceiver->destroyReceiver();
+    } else if (lSender) {
+        lSender->destroySender();
+    }
+}
+
+int RISTNetMockTransport::writeData(const rist_data_block &rDataBlock) {
+    int lStatus = dataWriteCallback ? dataWriteCallback(rDataBlock) : (int) rDataBlock.payload_len;
+    if (lStatus > 0) {
+        mPacketsWritten++;
+        mBytesWritten += lStatus;
+    }
+    return lStatus;
+}
+
+int RISTNetMockTransport::writeOOBData(const rist_oob_block &rOOBBlock) {
+    int lStatus = oobWriteCallback ? oobWriteCallback(rOOBBlock) : 0;
+    if (!lStatus) {
+        mOOBWritten++;
+    }
+    return lStatus;
+}
+
+int RISTNetMockTransport::createPeer(const std::string &rURL, rist_peer **ppPeer) {
+    auto lMockPeer = std::make_unique<MockPeer>();
+    lMockPeer->mURL = rURL;
+    *ppPeer = reinterpret_cast<rist_peer *>(lMockPeer.get());
+    std::lock_guard<std::mutex> lLock(mPeerMtx);
+    mPeers[*ppPeer] = std::move(lMockPeer);
+    mPeersCreated++;
+    return 0;
+}
+
+int RISTNetMockTransport::closePeer(rist_peer *pPeer) {
+    std::lock_guard<std::mutex> lLock(mPeerMtx);
+    if (!mPeers.erase(pPeer)) {
+        return -1;
+    }
+    mPeersClosed++;
+    return 0;
+}
+
+void RISTNetMockTransport::targetDestroyed() {
+    std::lock_guard<std::mutex> lLock(mPeerMtx);
+    mReceiver = nullptr;
+    mSender = nullptr;
+    mPeers.clear();
+}
@@ -0,0 +1,178 @@
+//
+// RISTNetMockTransport -- In-process replacement of librist for testing and benchmarking the wrapper
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETMOCKTRANSPORT_H
+#define CPPRISTWRAPPER__RISTNETMOCKTRANSPORT_H
+
+#include "RISTNet.h"
+
+/**
+ * \class RISTNetMockTransport
+ *
+ * \brief
+ *
+ * A RISTNetMockTransport takes the place of librist for one RISTNetReceiver or RISTNetSender. No sockets, no
+ * librist threads or timers: the connect, disconnect, data, OOB and statistics events are injected by the
+ * calling (driver) thread and run the same wrapper code librist would call, synchronously. What the wrapper
+ * writes (sendData, sendOOBData, closeClientConnection) ends up in the mock.
+ *
+ * The inject methods may be called from several threads at once, like librist calls the wrapper from its
+ * own threads. Peers are fake rist_peer pointers, never dereferenced.
+ *
+ */
+class RISTNetMockTransport {
+public:
+
+    struct MockTransportStatistics {
+        uint64_t mPeersConnected = 0;       // Accepted by the validate connection callback
+        uint64_t mPeersRejected = 0;
+        uint64_t mPeersDisconnected = 0;    // By disconnectPeer
+        uint64_t mPeersClosed = 0;          // By closeClientConnection/closeAllClientConnections/removePeer
+        uint64_t mPeersCreated = 0;         // By addPeer of the sender
+        uint64_t mPacketsWritten = 0;       // By sendData
+        uint64_t mBytesWritten = 0;
+        uint64_t mOOBWritten = 0;           // By sendOOBData
+    };
+
+    /// Constructor
+    RISTNetMockTransport();
+
+    /// Destructor
+    virtual ~RISTNetMockTransport();
+
+    /**
+     * @brief Attach a receiver
+     *
+     * Initialises the receiver as initReceiver does but without librist, the receiver is then driven by the
+     * mock until destroyReceiver or detach.
+     *
+     * @param the receiver, not initialised
+     * @param The receiver settings, only the wrapper settings (event queue, packet pool, logging) are used, accounted as one peer
+     * @return true on success
+     */
+    bool attachReceiver(RISTNetReceiver &rReceiver, RISTNetReceiver::RISTNetReceiverSettings &rSettings);
+
+    /**
+     * @brief Attach a sender
+     *
+     * Initialises the sender as initSender does but without librist, the sender is then driven by the
+     * mock until destroySender or detach.
+     *
+     * @param the sender, not initialised
+     * @param The sender settings, only the wrapper settings (event queue, logging) are used, accounted as one peer
+     * @return true on success
+     */
+    bool attachSender(RISTNetSender &rSender, RISTNetSender::RISTNetSenderSettings &rSettings);
+
+    /**
+     * @brief Connect a peer
+     *
+     * Runs the connect path (clientConnect and validateConnectionCallback) for a new fake peer.
+     *
+     * @param the IP address of the peer
+     * @param the port of the peer
+     * @return the peer, nullptr if the connection was rejected or nothing is attached
+     */
+    rist_peer *connectPeer(const std::string &rIPAddress, uint16_t lPort);
+
+    /**
+     * @brief Disconnect a peer
+     *
+     * Runs the disconnect path (clientDisconnect and clientDisconnectedCallback), as a peer timing out.
+     *
+     * @param the peer
+     * @return true if the peer was connected
+     */
+    bool disconnectPeer(rist_peer *pPeer);
+
+    /**
+     * @brief Inject data
+     *
+     * Delivers the data block to the attached receiver as librist does, rDataBlock.peer selects the peer.
+     *
+     * @param the data block
+     * @return what the data callback returned, -1 if no receiver is attached
+     */
+    int injectData(rist_data_block &rDataBlock);
+
+    /// Inject data from the peer, see above
+    int injectData(rist_peer *pPeer, const uint8_t *pData, size_t lSize, uint16_t lFlowID = 0, uint64_t lSeq = 0);
+
+    /// Inject OOB data from the peer (nullptr for no peer), -1 if nothing is attached
+    int injectOOBData(rist_peer *pPeer, const uint8_t *pData, size_t lSize);
+
+    /// Inject statistics, -1 if nothing is attached
+    int injectStatistics(const rist_stats &rStatistics);
+
+    /// The number of peers connected or created and not yet disconnected or closed
+    size_t getPeers();
+
+    /// The URLs of the peers created by addPeer of the sender and not yet removed
+    void getPeerURLs(std::vector<std::string> &rURLs);
+
+    /// Get the mock statistics
+    void getStatistics(MockTransportStatistics &rStatistics);
+
+    /**
+     * @brief Detach
+     *
+     * Destroys the attached receiver or sender (destroyReceiver/destroySender) and forgets the peers.
+     *
+     */
+    void detach();
+
+    /// Called for every packet written by sendData, return the bytes written. When not set all bytes are written.
+    std::function<int(const rist_data_block &rDataBlock)> dataWriteCallback = nullptr;
+
+    /// Called for every sendOOBData, return 0 if written. When not set everything is written.
+    std::function<int(const rist_oob_block &rOOBBlock)> oobWriteCallback = nullptr;
+
+    // Delete copy and move constructors and assign operators
+    RISTNetMockTransport(RISTNetMockTransport const &) = delete;             // Copy construct
+    RISTNetMockTransport(RISTNetMockTransport &&) = delete;                  // Move construct
+    RISTNetMockTransport &operator=(RISTNetMockTransport const &) = delete;  // Copy assign
+    RISTNetMockTransport &operator=(RISTNetMockTransport &&) = delete;       // Move assign
+
+private:
+
+    friend class RISTNetReceiver;
+    friend class RISTNetSender;
+
+    // A fake peer, its address is the rist_peer pointer
+    struct MockPeer {
+        std::string mIPAddress;
+        uint16_t mPort = 0;
+        std::string mURL;                   // Created by addPeer
+    };
+
+    // Called by the attached receiver or sender in place of librist
+    int writeData(const rist_data_block &rDataBlock);
+    int writeOOBData(const rist_oob_block &rOOBBlock);
+    int createPeer(const std::string &rURL, rist_peer **ppPeer);
+    int closePeer(rist_peer *pPeer);
+    void targetDestroyed();
+
+    // The mutex protecting the peers and the attached receiver or sender. Never held while calling the wrapper.
+    std::mutex mPeerMtx;
+    std::map<rist_peer *, std::unique_ptr<MockPeer>> mPeers;
+    RISTNetReceiver *mReceiver = nullptr;
+    RISTNetSender *mSender = nullptr;
+
+    std::atomic<uint64_t> mPeersConnected{0};
+    std::atomic<uint64_t> mPeersRejected{0};
+    std::atomic<uint64_t> mPeersDisconnected{0};
+    std::atomic<uint64_t> mPeersClosed{0};
+    std::atomic<uint64_t> mPeersCreated{0};
+    std::atomic<uint64_t> mPacketsWritten{0};
+    std::atomic<uint64_t> mBytesWritten{0};
+    std::atomic<uint64_t> mOOBWritten{0};
+};
+
+#endif //CPPRISTWRAPPER__RISTNETMOCKTRANSPORT_H
@@ -0,0 +1,435 @@
+//
+// RISTNetPacketPool -- Pooled packet buffers for payloads held by the wrapper
+//
+
+#include "RISTNetPacketPool.h"
+#include "RISTNetInternal.h"
+#include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
+
+#define NO_THREAD_SLOT RISTNetPacketPool::kMaxThreadSlots
+#define BUFFER_ALIGNMENT 64 // Buffers do not share cache lines
+#define CACHE_REFILL_MAX 32
+
+static const size_t kClassSizes[RISTNetPacketPool::kSizeClasses] = {256, 512, 1024, 1536, 2048, 4096, 8192,
+                                                                     RIST_MAX_PACKET_SIZE};
+
+static size_t classForSize(size_t lSize) {
+    size_t lClass = 0;
+    while (kClassSizes[lClass] < lSize) {
+        lClass++;
+    }
+    return lClass;
+}
+
+static size_t classStride(size_t lClass) {
+    size_t lStride = sizeof(RISTNetPacketBufferHeader) + kClassSizes[lClass];
+    return (lStride + BUFFER_ALIGNMENT - 1) & ~(size_t) (BUFFER_ALIGNMENT - 1);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+//
+//
+// Thread slots
+//
+//
+//---------------------------------------------------------------------------------------------------------------------
+
+// The pools alive and the thread slots not in use, process wide. Never destroyed so threads exiting during static
+// destruction still find it.
+struct ThreadSlotRegistry {
+    std::mutex mRegistryMtx;
+    std::vector<RISTNetPacketPool *> mPools;
+    std::vector<size_t> mFreeSlots;
+    size_t mNextSlot = 0;
+};
+
+static ThreadSlotRegistry &threadSlotRegistry() {
+    static auto *pRegistry = new ThreadSlotRegistry();
+    return *pRegistry;
+}
+
+// Gives every thread a slot index, on thread exit the caches of the slot are flushed and the slot is reused
+struct RISTNetPacketPool::ThreadSlot {
+    ThreadSlot() {
+        auto &rRegistry = threadSlotRegistry();
+        std::lock_guard<std::mutex> lLock(rRegistry.mRegistryMtx);
+        if (!rRegistry.mFreeSlots.empty()) {
+            mIndex = rRegistry.mFreeSlots.back();
+            rRegistry.mFreeSlots.pop_back();
+        } else if (rRegistry.mNextSlot < kMaxThreadSlots) {
+            mIndex = rRegistry.mNextSlot++;
+        }
+    }
+
+    ~ThreadSlot() {
+        if (mIndex == NO_THREAD_SLOT) {
+            return;
+        }
+        auto &rRegistry = threadSlotRegistry();
+        std::lock_guard<std::mutex> lLock(rRegistry.mRegistryMtx);
+        for (auto *pPool: rRegistry.mPools) {
+            pPool->flushThreadSlot(mIndex);
+        }
+        rRegistry.mFreeSlots.push_back(mIndex);
+    }
+
+    size_t mIndex = NO_THREAD_SLOT;
+};
+
+size_t RISTNetPacketPool::threadSlot() {
+    static thread_local ThreadSlot tThreadSlot;
+    return tThreadSlot.mIndex;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+//
+//
+// RISTNetPacketBuffer
+//
+//
+//---------------------------------------------------------------------------------------------------------------------
+
+RISTNetPacketBuffer &RISTNetPacketBuffer::operator=(RISTNetPacketBuffer &&rOther) noexcept {
+    if (this != &rOther) {
+        reset();
+        mHeader = rOther.mHeader;
+        rOther.mHeader = nullptr;
+    }
+    return *this;
+}
+
+RISTNetPacketBuffer RISTNetPacketBuffer::share() const {
+    if (!mHeader) {
+        return RISTNetPacketBuffer();
+    }
+    mHeader->mReferences.fetch_add(1, std::memory_order_relaxed);
+    return RISTNetPacketBuffer(mHeader);
+}
+
+bool RISTNetPacketBuffer::resize(size_t lSize) {
+    if (!mHeader || lSize > mHeader->mCapacity) {
+        return false;
+    }
+    mHeader->mSize = lSize;
+    return true;
+}
+
+void RISTNetPacketBuffer::reset() {
+    if (!mHeader) {
+        return;
+    }
+    if (mHeader->mReferences.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        mHeader->mPool->release(mHeader);
+    }
+    mHeader = nullptr;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+//
+//
+// RISTNetPacketPool
+//
+//
+//---------------------------------------------------------------------------------------------------------------------
+
+RISTNetPacketPool::RISTNetPacketPool() {
+    auto &rRegistry = threadSlotRegistry();
+    std::lock_guard<std::mutex> lLock(rRegistry.mRegistryMtx);
+    rRegistry.mPools.push_back(this);
+    LOGGER(false, LOGG_NOTIFY, "RISTNetPacketPool constructed")
+}
+
+RISTNetPacketPool::~RISTNetPacketPool() {
+    if (mInitialised) {
+        destroyPacketPool();
+    }
+    auto &rRegistry = threadSlotRegistry();
+    std::lock_guard<std::mutex> lLock(rRegistry.mRegistryMtx);
+    rRegistry.mPools.erase(std::remove(rRegistry.mPools.begin(), rRegistry.mPools.end(), this),
+                           rRegistry.mPools.end());
+    LOGGER(false, LOGG_NOTIFY, "RISTNetPacketPool destruct")
+}
+
+RISTNetPacketPool &RISTNetPacketPool::defaultPool() {
+    // Never destroyed, buffers may be released during static destruction
+    static RISTNetPacketPool *pPool = []() {
+        auto *pNewPool = new RISTNetPacketPool();
+        RISTNetPacketPoolSettings lSettings;
+        pNewPool->initPacketPool(lSettings);
+        return pNewPool;
+    }();
+    return *pPool;
+}
+
+bool RISTNetPacketPool::initPacketPool(RISTNetPacketPoolSettings &rSettings) {
+    if (mInitialised) {
+        LOGGER(true, LOGG_ERROR, "RISTNetPacketPool already initialised.")
+        return false;
+    }
+    if (rSettings.mMaxBytes < kSlabSize || !rSettings.mThreadCacheSize) {
+        LOGGER(true, LOGG_ERROR, "Max bytes or thread cache size not valid.")
+        return false;
+    }
+    mSettings = rSettings;
+    mCaches = std::make_unique<ThreadCache[]>(kMaxThreadSlots * kSizeClasses);
+    mCounters = std::make_unique<ThreadCounters[]>(kMaxThreadSlots + 1);
+    mHugeTLB = false;
+    mFailures = 0;
+    mInitialised = true;
+    return true;
+}
+
+bool RISTNetPacketPool::addSlab(size_t lClass) {
+    std::lock_guard<std::mutex> lLock(mSlabMtx);
+    if (mBytesReserved + kSlabSize > mSettings.mMaxBytes) {
+        return false;
+    }
+    void *pMemory = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (mSettings.mHugePages == HugePages::kHugeTLB) {
+        pMemory = mmap(nullptr, kSlabSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (pMemory != MAP_FAILED) {
+            mHugeTLB = true;
+        } else if (mSlabs.empty()) {
+            LOGGER(true, LOGG_WARN, "MAP_HUGETLB failed, using normal pages: " << strerror(errno))
+        }
+    }
+#endif
+    if (pMemory == MAP_FAILED) {
+        pMemory = mmap(nullptr, kSlabSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (pMemory == MAP_FAILED) {
+            LOGGER(true, LOGG_ERROR, "mmap failed: " << strerror(errno))
+            return false;
+        }
+#ifdef MADV_HUGEPAGE
+        if (mSettings.mHugePages != HugePages::kNone) {
+            madvise(pMemory, kSlabSize, MADV_HUGEPAGE);
+        }
+#endif
+    }
+    mSlabs.push_back({pMemory, kSlabSize});
+    mBytesReserved += kSlabSize;
+    mClasses[lClass].mCarve = (uint8_t *) pMemory;
+    mClasses[lClass].mCarveEnd = (uint8_t *) pMemory + kSlabSize;
+    return true;
+}
+
+size_t RISTNetPacketPool::takeShared(size_t lClass, size_t lCount, RISTNetPacketBufferHeader *&rList) {
+    SizeClass &rClass = mClasses[lClass];
+    const size_t lStride = classStride(lClass);
+    std::lock_guard<std::mutex> lLock(rClass.mClassMtx);
+    size_t lTaken = 0;
+    while (lTaken < lCount) {
+        RISTNetPacketBufferHeader *pHeader;
+        if (rClass.mFree) {
+            pHeader = rClass.mFree;
+            rClass.mFree = pHeader->mNext;
+            rClass.mFreeCount--;
+        } else {
+            if (rClass.mCarveEnd - rClass.mCarve < (ptrdiff_t) lStride && !addSlab(lClass)) {
+                break;
+            }
+            pHeader = new(rClass.mCarve) RISTNetPacketBufferHeader();
+            pHeader->mPool = this;
+            pHeader->mCapacity = kClassSizes[lClass];
+            pHeader->mClass = lClass;
+            rClass.mCarve += lStride;
+            rClass.mCreated++;
+        }
+        pHeader->mNext = rList;
+        rList = pHeader;
+        lTaken++;
+    }
+    rClass.mPeakTaken = std::max(rClass.mPeakTaken, rClass.mCreated - rClass.mFreeCount);
+    return lTaken;
+}
+
+void RISTNetPacketPool::returnShared(size_t lClass, RISTNetPacketBufferHeader *pList, size_t lCount) {
+    if (!pList) {
+        return;
+    }
+    RISTNetPacketBufferHeader *pLast = pList;
+    while (pLast->mNext) {
+        pLast = pLast->mNext;
+    }
+    SizeClass &rClass = mClasses[lClass];
+    std::lock_guard<std::mutex> lLock(rClass.mClassMtx);
+    pLast->mNext = rClass.mFree;
+    rClass.mFree = pList;
+    rClass.mFreeCount += lCount;
+}
+
+RISTNetPacketBuffer RISTNetPacketPool::allocate(size_t lSize) {
+    if (!mInitialised || lSize > RIST_MAX_PACKET_SIZE) {
+        mFailures.fetch_add(1, std::memory_order_relaxed);
+        return RISTNetPacketBuffer();
+    }
+    size_t lClass = classForSize(lSize);
+    size_t lSlot = threadSlot();
+    RISTNetPacketBufferHeader *pHeader = nullptr;
+
+    if (lSlot != NO_THREAD_SLOT) {
+        ThreadCache &rCache = cache(lSlot, lClass);
+        if (!rCache.mLocal) {
+            // Take back what other threads released, else refill from the shared list
+            rCache.mLocal = rCache.mRemote.exchange(nullptr, std::memory_order_acquire);
+            rCache.mLocalCount = 0;
+            for (auto *pCounted = rCache.mLocal; pCounted; pCounted = pCounted->mNext) {
+                rCache.mLocalCount++;
+            }
+            if (!rCache.mLocal) {
+                rCache.mLocalCount = takeShared(lClass, std::min<size_t>(CACHE_REFILL_MAX,
+                                                                         (mSettings.mThreadCacheSize + 1) / 2),
+                                                rCache.mLocal);
+            }
+        }
+        pHeader = rCache.mLocal;
+        if (pHeader) {
+            rCache.mLocal = pHeader->mNext;
+            rCache.mLocalCount--;
+        }
+    } else {
+        takeShared(lClass, 1, pHeader);
+    }
+    if (!pHeader) {
+        mFailures.fetch_add(1, std::memory_order_relaxed);
+        return RISTNetPacketBuffer();
+    }
+
+    pHeader->mNext = nullptr;
+    pHeader->mOwner = lSlot;
+    pHeader->mSize = lSize;
+    pHeader->mReferences.store(1, std::memory_order_relaxed);
+    ThreadCounters &rCounters = mCounters[lSlot];
+    if (lSlot != NO_THREAD_SLOT) {
+        rCounters.mAllocations.store(rCounters.mAllocations.load(std::memory_order_relaxed) + 1,
+                                     std::memory_order_relaxed);
+    } else {
+        rCounters.mAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    return RISTNetPacketBuffer(pHeader);
+}
+
+RISTNetPacketBuffer RISTNetPacketPool::copy(const uint8_t *pData, size_t lSize) {
+    RISTNetPacketBuffer lBuffer = allocate(lSize);
+    if (lBuffer) {
+        memcpy(lBuffer.data(), pData, lSize);
+    }
+    return lBuffer;
+}
+
+void RISTNetPacketPool::release(RISTNetPacketBufferHeader *pHeader) {
+    size_t lSlot = threadSlot();
+    ThreadCounters &rCounters = mCounters[lSlot];
+    if (lSlot != NO_THREAD_SLOT) {
+        rCounters.mReleases.store(rCounters.mReleases.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    } else {
+        rCounters.mReleases.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t lOwner = pHeader->mOwner;
+    if (lOwner == NO_THREAD_SLOT) {
+        pHeader->mNext = nullptr;
+        returnShared(pHeader->mClass, pHeader, 1);
+        return;
+    }
+    ThreadCache &rCache = cache(lOwner, pHeader->mClass);
+    if (lOwner != lSlot) {
+        // Lock-free push to the owner, the owner takes the whole list at once so there is no ABA
+        RISTNetPacketBufferHeader *pHead = rCache.mRemote.load(std::memory_order_relaxed);
+        do {
+            pHeader->mNext = pHead;
+        } while (!rCache.mRemote.compare_exchange_weak(pHead, pHeader, std::memory_order_release,
+                                                       std::memory_order_relaxed));
+        return;
+    }
+    pHeader->mNext = rCache.mLocal;
+    rCache.mLocal = pHeader;
+    if (++rCache.mLocalCount > mSettings.mThreadCacheSize) {
+        // Spill half of the cache to the shared list
+        size_t lSpill = rCache.mLocalCount / 2;
+        RISTNetPacketBufferHeader *pSpill = rCache.mLocal;
+        RISTNetPacketBufferHeader *pLast = pSpill;
+        for (size_t i = 1; i < lSpill; i++) {
+            pLast = pLast->mNext;
+        }
+        rCache.mLocal = pLast->mNext;
+        rCache.mLocalCount -= lSpill;
+        pLast->mNext = nullptr;
+        returnShared(pHeader->mClass, pSpill, lSpill);
+    }
+}
+
+void RISTNetPacketPool::flushThreadSlot(size_t lSlot) {
+    if (!mInitialised) {
+        return;
+    }
+    for (size_t lClass = 0; lClass < kSizeClasses; lClass++) {
+        ThreadCache &rCache = cache(lSlot, lClass);
+        returnShared(lClass, rCache.mLocal, rCache.mLocalCount);
+        rCache.mLocal = nullptr;
+        rCache.mLocalCount = 0;
+        RISTNetPacketBufferHeader *pRemote = rCache.mRemote.exchange(nullptr, std::memory_order_acquire);
+        size_t lCount = 0;
+        for (auto *pCounted = pRemote; pCounted; pCounted = pCounted->mNext) {
+            lCount++;
+        }
+        returnShared(lClass, pRemote, lCount);
+    }
+}
+
+void RISTNetPacketPool::getStatistics(PacketPoolStatistics &rStatistics) {
+    rStatistics = PacketPoolStatistics();
+    if (!mInitialised) {
+        return;
+    }
+    uint64_t lReleases = 0;
+    for (size_t i = 0; i <= kMaxThreadSlots; i++) {
+        rStatistics.mAllocations += mCounters[i].mAllocations.load(std::memory_order_relaxed);
+        lReleases += mCounters[i].mReleases.load(std::memory_order_relaxed);
+    }
+    // The counters are read one by one, a release may be seen before its allocation
+    rStatistics.mInUse = rStatistics.mAllocations > lReleases ? rStatistics.mAllocations - lReleases : 0;
+    for (auto &rClass: mClasses) {
+        std::lock_guard<std::mutex> lLock(rClass.mClassMtx);
+        rStatistics.mPeakTaken += rClass.mPeakTaken;
+    }
+    rStatistics.mFailures = mFailures;
+    rStatistics.mBytesReserved = mBytesReserved;
+    std::lock_guard<std::mutex> lLock(mSlabMtx);
+    rStatistics.mHugeTLB = mHugeTLB;
+}
+
+bool RISTNetPacketPool::destroyPacketPool() {
+    if (!mInitialised) {
+        LOGGER(true, LOGG_WARN, "RISTNetPacketPool not initialised.")
+        return false;
+    }
+    PacketPoolStatistics lStatistics;
+    getStatistics(lStatistics);
+    if (lStatistics.mInUse) {
+        LOGGER(true, LOGG_ERROR, "RISTNetPacketPool has " << lStatistics.mInUse << " buffers in use.")
+        return false;
+    }
+    mInitialised = false;
+    for (auto &rClass: mClasses) {
+        std::lock_guard<std::mutex> lLock(rClass.mClassMtx);
+        rClass.mFree = nullptr;
+        rClass.mFreeCount = 0;
+        rClass.mCarve = nullptr;
+        rClass.mCarveEnd = nullptr;
+        rClass.mCreated = 0;
+        rClass.mPeakTaken = 0;
+    }
+    std::lock_guard<std::mutex> lLock(mSlabMtx);
+    for (auto &rSlab: mSlabs) {
+        munmap(rSlab.pMemory, rSlab.mSize);
+    }
+    mSlabs.clear();
+    mBytesReserved = 0;
+    mCaches.reset();
+    mCounters.reset();
+    return true;
+}
@@ -0,0 +1,229 @@
+//
+// RISTNetPacketPool -- Pooled packet buffers for payloads held by the wrapper
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+// k constant
+
+#ifndef CPPRISTWRAPPER__RISTNETPACKETPOOL_H
+#define CPPRISTWRAPPER__RISTNETPACKETPOOL_H
+
+#include "librist.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class RISTNetPacketPool;
+
+// Placed in front of the payload of every pool buffer
+struct alignas(16) RISTNetPacketBufferHeader {
+    RISTNetPacketBufferHeader *mNext = nullptr;
+    RISTNetPacketPool *mPool = nullptr;
+    std::atomic<uint32_t> mReferences{0};
+    uint32_t mSize = 0;
+    uint32_t mCapacity = 0;
+    uint16_t mClass = 0;
+    uint16_t mOwner = 0;        // Thread slot whose cache the buffer returns to
+};
+
+/**
+ * \class RISTNetPacketBuffer
+ *
+ * \brief
+ *
+ * A handle to a buffer from a RISTNetPacketPool. The buffer returns to the pool when the last handle to it
+ * is destroyed or reset. share() returns another handle to the same buffer, a shared buffer must not be modified.
+ *
+ */
+class RISTNetPacketBuffer {
+public:
+
+    RISTNetPacketBuffer() = default;
+    ~RISTNetPacketBuffer() { reset(); }
+
+    RISTNetPacketBuffer(RISTNetPacketBuffer &&rOther) noexcept : mHeader(rOther.mHeader) { rOther.mHeader = nullptr; }
+    RISTNetPacketBuffer &operator=(RISTNetPacketBuffer &&rOther) noexcept;
+
+    // Use share() for another handle
+    RISTNetPacketBuffer(RISTNetPacketBuffer const &) = delete;
+    RISTNetPacketBuffer &operator=(RISTNetPacketBuffer const &) = delete;
+
+    /// Another handle to the same buffer
+    RISTNetPacketBuffer share() const;
+
+    uint8_t *data() { return reinterpret_cast<uint8_t *>(mHeader + 1); }
+    const uint8_t *data() const { return reinterpret_cast<const uint8_t *>(mHeader + 1); }
+    size_t size() const { return mHeader ? mHeader->mSize : 0; }
+    size_t capacity() const { return mHeader ? mHeader->mCapacity : 0; }
+
+    /// Set the size of the data, false if larger than the capacity
+    bool resize(size_t lSize);
+
+    /// Release this handle
+    void reset();
+
+    explicit operator bool() const { return mHeader != nullptr; }
+
+private:
+    friend class RISTNetPacketPool;
+    explicit RISTNetPacketBuffer(RISTNetPacketBufferHeader *pHeader) : mHeader(pHeader) {}
+
+    RISTNetPacketBufferHeader *mHeader = nullptr;
+};
+
+/**
+ * \class RISTNetPacketPool
+ *
+ * \brief
+ *
+ * A RISTNetPacketPool hands out packet buffers up to RIST_MAX_PACKET_SIZE from size classes carved out of
+ * large slabs, optionally backed by huge pages. Every thread allocates from its own cache without locking.
+ * A buffer released on another thread goes back to the cache of the thread that allocated it through a
+ * lock-free list, so producer/consumer threads do not meet in a lock per packet. Caches fill from and spill
+ * to the shared lists of the pool in batches. The memory reserved by the pool is capped.
+ *
+ * A pool must outlive its buffers. defaultPool() is never destroyed.
+ *
+ */
+class RISTNetPacketPool {
+public:
+
+    static constexpr size_t kSizeClasses = 8;
+    static constexpr size_t kMaxThreadSlots = 256;    // Threads beyond this use the shared lists directly
+    static constexpr size_t kSlabSize = 2 * 1024 * 1024;
+
+    enum class HugePages {
+        kNone,
+        kTransparent,   // madvise(MADV_HUGEPAGE) on the slabs
+        kHugeTLB        // MAP_HUGETLB slabs, falls back to normal pages if none are reserved
+    };
+
+    struct RISTNetPacketPoolSettings {
+        size_t mMaxBytes = 256 * 1024 * 1024;  // Cap on the slab memory reserved
+        HugePages mHugePages = HugePages::kNone;
+        size_t mThreadCacheSize = 256;          // Max buffers per size class in a thread cache
+    };
+
+    struct PacketPoolStatistics {
+        uint64_t mInUse = 0;            // Buffers held by users now
+        uint64_t mPeakTaken = 0;        // Max buffers taken from the shared lists, held by users or in thread caches,
+                                        // per class summed. An upper bound of the peak of mInUse
+        uint64_t mAllocations = 0;
+        uint64_t mFailures = 0;         // Allocations failed because of the cap or the size
+        size_t mBytesReserved = 0;      // Slab memory
+        bool mHugeTLB = false;          // Slabs backed by MAP_HUGETLB
+    };
+
+    /// Constructor
+    RISTNetPacketPool();
+
+    /// Destructor
+    virtual ~RISTNetPacketPool();
+
+    /**
+     * @brief Initialize the pool
+     *
+     * @param The pool settings
+     * @return true on success
+     */
+    bool initPacketPool(RISTNetPacketPoolSettings &rSettings);
+
+    /**
+     * @brief Allocate a buffer
+     *
+     * @param the size, max RIST_MAX_PACKET_SIZE
+     * @return the buffer, empty if the pool is exhausted
+     */
+    RISTNetPacketBuffer allocate(size_t lSize);
+
+    /**
+     * @brief Allocate a buffer holding a copy of the data
+     *
+     * @param pointer to the data
+     * @param length of the data, max RIST_MAX_PACKET_SIZE
+     * @return the buffer, empty if the pool is exhausted
+     */
+    RISTNetPacketBuffer copy(const uint8_t *pData, size_t lSize);
+
+    /// Get the pool statistics
+    void getStatistics(PacketPoolStatistics &rStatistics);
+
+    /**
+     * @brief Destroys the pool
+     *
+     * Releases the slabs. Fails if buffers are in use. No other thread may use the pool meanwhile.
+     *
+     */
+    bool destroyPacketPool();
+
+    /// The process wide pool with the default settings
+    static RISTNetPacketPool &defaultPool();
+
+    // Delete copy and move constructors and assign operators
+    RISTNetPacketPool(RISTNetPacketPool const &) = delete;             // Copy construct
+    RISTNetPacketPool(RISTNetPacketPool &&) = delete;                  // Move construct
+    RISTNetPacketPool &operator=(RISTNetPacketPool const &) = delete;  // Copy assign
+    RISTNetPacketPool &operator=(RISTNetPacketPool &&) = delete;       // Move assign
+
+private:
+    friend class RISTNetPacketBuffer;
+
+    struct ThreadSlot;
+
+    struct alignas(64) ThreadCache {
+        RISTNetPacketBufferHeader *mLocal = nullptr;
+        size_t mLocalCount = 0;
+        std::atomic<RISTNetPacketBufferHeader *> mRemote{nullptr}; // Released by other threads
+    };
+
+    // Written by the thread owning the slot only
+    struct alignas(64) ThreadCounters {
+        std::atomic<uint64_t> mAllocations{0};
+        std::atomic<uint64_t> mReleases{0};
+    };
+
+    struct SizeClass {
+        std::mutex mClassMtx;
+        RISTNetPacketBufferHeader *mFree = nullptr;
+        size_t mFreeCount = 0;
+        uint8_t *mCarve = nullptr;      // Unused part of the last slab
+        uint8_t *mCarveEnd = nullptr;
+        uint64_t mCreated = 0;
+        uint64_t mPeakTaken = 0;
+    };
+
+    struct Slab {
+        void *pMemory = nullptr;
+        size_t mSize = 0;
+    };
+
+    void release(RISTNetPacketBufferHeader *pHeader);
+    size_t takeShared(size_t lClass, size_t lCount, RISTNetPacketBufferHeader *&rList);
+    void returnShared(size_t lClass, RISTNetPacketBufferHeader *pList, size_t lCount);
+    bool addSlab(size_t lClass);
+    void flushThreadSlot(size_t lSlot);
+    static size_t threadSlot();
+    ThreadCache &cache(size_t lSlot, size_t lClass) { return mCaches[lSlot * kSizeClasses + lClass]; }
+
+    RISTNetPacketPoolSettings mSettings;
+    bool mInitialised = false;
+    bool mHugeTLB = false;
+
+    std::unique_ptr<ThreadCache[]> mCaches;          // kMaxThreadSlots x kSizeClasses
+    std::unique_ptr<ThreadCounters[]> mCounters;     // kMaxThreadSlots + 1, the last for threads without a slot
+    SizeClass mClasses[kSizeClasses];
+
+    std::mutex mSlabMtx;
+    std::vector<Slab> mSlabs;
+    std::atomic<size_t> mBytesReserved = 0;
+    std::atomic<uint64_t> mFailures = 0;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETPACKETPOOL_H
@@ -0,0 +1,350 @@
+//
+// RISTNetPlayout -- Constant delay, timestamp paced delivery of received packets
+//
+
+#include "RISTNetPlayout.h"
+#include "RISTNetInternal.h"
+#include <algorithm>
+
+// Packet nodes allocated at a time
+#define PLAYOUT_CHUNK_PACKETS 1024
+
+// The tick bits covered by level 0 and by each level above
+#define PLAYOUT_LEVEL0_BITS 8
+#define PLAYOUT_LEVEL_BITS 6
+
+RISTNetPlayout::RISTNetPlayout() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetPlayout constructed")
+}
+
+RISTNetPlayout::~RISTNetPlayout() {
+    if (mInitialised) {
+        destroyPlayout();
+    }
+    LOGGER(false, LOGG_NOTIFY, "RISTNetPlayout destruct")
+}
+
+bool RISTNetPlayout::initPlayout(RISTNetPlayoutSettings &rSettings) {
+    if (mInitialised) {
+        LOGGER(true, LOGG_ERROR, "RISTNetPlayout already initialised.")
+        return false;
+    }
+    if (rSettings.mTick.count() <= 0 || rSettings.mDelay.count() < 0 || !rSettings.mMaxPacketsPerFlow ||
+        rSettings.mFlowTimeout.count() <= 0) {
+        LOGGER(true, LOGG_ERROR, "Tick, delay, max packets or flow timeout not valid.")
+        return false;
+    }
+    mSettings = rSettings;
+    mPacketPool = rSettings.mPacketPool ? rSettings.mPacketPool : &RISTNetPacketPool::defaultPool();
+    mTickNs = std::chrono::duration_cast<std::chrono::nanoseconds>(rSettings.mTick).count();
+    mStart = std::chrono::steady_clock::now();
+    mCurrentTick = 0;
+    mWakeTick = 0;
+    mNextReap = 0;
+    mStatistics = PlayoutStatistics();
+    mTimerRun = true;
+    mTimerThread = std::thread(&RISTNetPlayout::timerWorker, this);
+    mInitialised = true;
+    return true;
+}
+
+bool RISTNetPlayout::attachReceiver(RISTNetReceiver &rReceiver) {
+    if (!mInitialised) {
+        LOGGER(true, LOGG_ERROR, "RISTNetPlayout not initialised.")
+        return false;
+    }
+    rReceiver.networkDataBlockCallback = [this](const rist_data_block &rDataBlock,
+                                                std::shared_ptr<RISTNetReceiver::NetworkConnection> &rConnection) {
+        pushPacket(rDataBlock);
+        return 0;
+    };
+    return true;
+}
+
+bool RISTNetPlayout::pushPacket(const rist_data_block &rDataBlock) {
+    if (!mInitialised) {
+        LOGGER(true, LOGG_ERROR, "RISTNetPlayout not initialised.")
+        return false;
+    }
+    int64_t lArrival = nowNs();
+    int64_t lDelayNs = std::chrono::duration_cast<std::chrono::nanoseconds>(mSettings.mDelay).count();
+    RISTNetPacketBuffer lBuffer = mPacketPool->copy((const uint8_t *) rDataBlock.payload, rDataBlock.payload_len);
+
+    std::lock_guard<std::mutex> lLock(mWheelMtx);
+    if (!lBuffer) {
+        LOGGER(true, LOGG_ERROR, "Packet pool exhausted, packet dropped.")
+        mStatistics.mDropped++;
+        return false;
+    }
+    if (lArrival >= mNextReap) {
+        reapFlows(lArrival);
+    }
+    PlayoutFlow &rFlow = mFlows[rDataBlock.flow_id];
+    rFlow.mLastPush = lArrival;
+
+    // The deadline, the sender time relative to the first packet of the flow plus the delay
+    int64_t lDeadlineNs = lArrival + lDelayNs;
+    if (mSettings.mUseSenderTime && rDataBlock.ts_ntp) {
+        if (rFlow.mAnchored) {
+            int64_t lSenderNs = rFlow.mTimeBase + ntpToNs((int64_t) (rDataBlock.ts_ntp - rFlow.mNTPBase)) + lDelayNs;
+            int64_t lDrift = lSenderNs - lDeadlineNs;
+            if ((rDataBlock.flags & RIST_DATA_FLAGS_DISCONTINUITY) ||
+                std::abs(lDrift) > std::chrono::duration_cast<std::chrono::nanoseconds>(mSettings.mResyncThreshold).count()) {
+                rFlow.mAnchored = false;
+                mStatistics.mResyncs++;
+            } else {
+                lDeadlineNs = lSenderNs;
+            }
+        }
+        if (!rFlow.mAnchored) {
+            rFlow.mAnchored = true;
+            rFlow.mTimeBase = lArrival;
+            rFlow.mNTPBase = rDataBlock.ts_ntp;
+        }
+    }
+
+    if (lDeadlineNs < lArrival) {
+        mStatistics.mLate++;
+        if (!rFlow.mQueued) {
+            mStatistics.mUnderruns++;
+        }
+        return false;
+    }
+    if (!mStatistics.mQueued) {
+        // An empty wheel can move to any tick, the timer thread may have slept long
+        mCurrentTick = std::max(mCurrentTick, (uint64_t) (lArrival / mTickNs));
+    }
+    // Never before the deadline, the first tick at or after it
+    uint64_t lDeadline = (uint64_t) ((lDeadlineNs + mTickNs - 1) / mTickNs);
+    if (rFlow.mQueued >= mSettings.mMaxPacketsPerFlow) {
+        mStatistics.mOverruns++;
+        return false;
+    }
+    PlayoutPacket *pPacket = allocatePacket();
+    pPacket->mBuffer = std::move(lBuffer);
+    pPacket->mDeadline = lDeadline;
+    pPacket->mFlowID = rDataBlock.flow_id;
+    schedule(pPacket);
+    rFlow.mQueued++;
+    mStatistics.mQueued++;
+    if (lDeadline < mWakeTick) {
+        mWheelCondition.notify_one();
+    }
+    return true;
+}
+
+void RISTNetPlayout::getStatistics(PlayoutStatistics &rStatistics) {
+    std::lock_guard<std::mutex> lLock(mWheelMtx);
+    rStatistics = mStatistics;
+    rStatistics.mFlows = mFlows.size();
+}
+
+bool RISTNetPlayout::destroyPlayout() {
+    if (!mInitialised) {
+        LOGGER(true, LOGG_WARN, "RISTNetPlayout not initialised.")
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lLock(mWheelMtx);
+        mTimerRun = false;
+    }
+    mWheelCondition.notify_one();
+    if (mTimerThread.joinable()) {
+        mTimerThread.join();
+    }
+    std::lock_guard<std::mutex> lLock(mWheelMtx);
+    for (auto &rSlot: mLevel0) {
+        rSlot = SlotList();
+    }
+    for (auto &rLevel: mLevels) {
+        for (auto &rSlot: rLevel) {
+            rSlot = SlotList();
+        }
+    }
+    mOverflow = SlotList();
+    std::fill(std::begin(mLevel0Bits), std::end(mLevel0Bits), 0);
+    // Releases the buffers of the packets still waiting
+    mChunks.clear();
+    mFree = nullptr;
+    mFlows.clear();
+    mStatistics.mQueued = 0;
+    mInitialised = false;
+    return true;
+}
+
+int64_t RISTNetPlayout::nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mStart).count();
+}
+
+// NTP 64 bit time, 32 bit seconds and 32 bit fraction
+int64_t RISTNetPlayout::ntpToNs(int64_t lNTPDelta) {
+    uint64_t lMagnitude = lNTPDelta < 0 ? -(uint64_t) lNTPDelta : (uint64_t) lNTPDelta;
+    int64_t lNs = (int64_t) ((lMagnitude >> 32) * 1000000000ULL + (((lMagnitude & 0xffffffffULL) * 1000000000ULL) >> 32));
+    return lNTPDelta < 0 ? -lNs : lNs;
+}
+
+// Forgets the flows with nothing queued and no packet for mFlowTimeout, a sweep every half timeout at most
+void RISTNetPlayout::reapFlows(int64_t lNow) {
+    int64_t lTimeoutNs = std::chrono::duration_cast<std::chrono::nanoseconds>(mSettings.mFlowTimeout).count();
+    for (auto lIterator = mFlows.begin(); lIterator != mFlows.end();) {
+        if (!lIterator->second.mQueued && lNow - lIterator->second.mLastPush >= lTimeoutNs) {
+            lIterator = mFlows.erase(lIterator);
+        } else {
+            ++lIterator;
+        }
+    }
+    mNextReap = lNow + lTimeoutNs / 2;
+}
+
+RISTNetPlayout::PlayoutPacket *RISTNetPlayout::allocatePacket() {
+    if (!mFree) {
+        mChunks.emplace_back(new PlayoutPacket[PLAYOUT_CHUNK_PACKETS]);
+        PlayoutPacket *pChunk = mChunks.back().get();
+        for (size_t i = 0; i < PLAYOUT_CHUNK_PACKETS; i++) {
+            pChunk[i].pNext = mFree;
+            mFree = &pChunk[i];
+        }
+    }
+    PlayoutPacket *pPacket = mFree;
+    mFree = pPacket->pNext;
+    pPacket->pNext = nullptr;
+    return pPacket;
+}
+
+void RISTNetPlayout::append(SlotList &rList, PlayoutPacket *pPacket) {
+    pPacket->pNext = nullptr;
+    if (rList.pTail) {
+        rList.pTail->pNext = pPacket;
+    } else {
+        rList.pHead = pPacket;
+    }
+    rList.pTail = pPacket;
+}
+
+// The level is the highest tick bits the deadline shares with the current tick, so a slot above level 0 is
+// cascaded exactly when the current tick enters its range and the order of equal deadlines is kept
+void RISTNetPlayout::schedule(PlayoutPacket *pPacket) {
+    uint64_t lDeadline = std::max(pPacket->mDeadline, mCurrentTick);
+    uint64_t lNow = mCurrentTick;
+    if ((lDeadline >> PLAYOUT_LEVEL0_BITS) == (lNow >> PLAYOUT_LEVEL0_BITS)) {
+        size_t lSlot = lDeadline & (kLevel0Slots - 1);
+        append(mLevel0[lSlot], pPacket);
+        mLevel0Bits[lSlot / 64] |= 1ULL << (lSlot % 64);
+        return;
+    }
+    for (size_t lLevel = 0; lLevel < kLevels; lLevel++) {
+        int lShift = PLAYOUT_LEVEL0_BITS + (lLevel + 1) * PLAYOUT_LEVEL_BITS;
+        if ((lDeadline >> lShift) == (lNow >> lShift)) {
+            append(mLevels[lLevel][(lDeadline >> (lShift - PLAYOUT_LEVEL_BITS)) & (kLevelSlots - 1)], pPacket);
+            return;
+        }
+    }
+    append(mOverflow, pPacket);
+}
+
+void RISTNetPlayout::cascade(SlotList &rList) {
+    PlayoutPacket *pPacket = rList.pHead;
+    rList = SlotList();
+    while (pPacket) {
+        PlayoutPacket *pNext = pPacket->pNext;
+        schedule(pPacket);
+        pPacket = pNext;
+    }
+}
+
+// Expires mCurrentTick, cascading the levels entering their range first
+void RISTNetPlayout::advance(SlotList &rExpired) {
+    uint64_t lNow = mCurrentTick;
+    if (!(lNow & ((1ULL << PLAYOUT_LEVEL0_BITS) - 1))) {
+        int lTop = 0;
+        while (lTop < (int) kLevels &&
+               !(lNow & ((1ULL << (PLAYOUT_LEVEL0_BITS + (lTop + 1) * PLAYOUT_LEVEL_BITS)) - 1))) {
+            lTop++;
+        }
+        if (lTop == (int) kLevels) {
+            cascade(mOverflow);
+            lTop--;
+        }
+        for (int lLevel = lTop; lLevel >= 0; lLevel--) {
+            int lShift = PLAYOUT_LEVEL0_BITS + lLevel * PLAYOUT_LEVEL_BITS;
+            cascade(mLevels[lLevel][(lNow >> lShift) & (kLevelSlots - 1)]);
+        }
+    }
+    size_t lSlot = lNow & (kLevel0Slots - 1);
+    SlotList &rSlot = mLevel0[lSlot];
+    if (rSlot.pHead) {
+        if (rExpired.pTail) {
+            rExpired.pTail->pNext = rSlot.pHead;
+        } else {
+            rExpired.pHead = rSlot.pHead;
+        }
+        rExpired.pTail = rSlot.pTail;
+        rSlot = SlotList();
+        mLevel0Bits[lSlot / 64] &= ~(1ULL << (lSlot % 64));
+    }
+    mCurrentTick++;
+}
+
+// The next tick with packets in level 0, or the next cascade
+uint64_t RISTNetPlayout::nextWakeTick() {
+    if (!mStatistics.mQueued) {
+        return UINT64_MAX;
+    }
+    size_t lSlot = mCurrentTick & (kLevel0Slots - 1);
+    for (size_t lWord = lSlot / 64; lWord < kLevel0Slots / 64; lWord++) {
+        uint64_t lBits = mLevel0Bits[lWord];
+        if (lWord == lSlot / 64) {
+            lBits &= ~0ULL << (lSlot % 64);
+        }
+        if (lBits) {
+            return (mCurrentTick & ~(uint64_t) (kLevel0Slots - 1)) + lWord * 64 + __builtin_ctzll(lBits);
+        }
+    }
+    return (mCurrentTick | (kLevel0Slots - 1)) + 1;
+}
+
+void RISTNetPlayout::timerWorker() {
+    std::unique_lock<std::mutex> lLock(mWheelMtx);
+    while (mTimerRun) {
+        int64_t lNow = nowNs();
+        uint64_t lNowTick = lNow / mTickNs;
+        SlotList lExpired;
+        if (!mStatistics.mQueued) {
+            mCurrentTick = std::max(mCurrentTick, lNowTick);
+        }
+        while (mCurrentTick <= lNowTick) {
+            advance(lExpired);
+        }
+        if (!lExpired.pHead) {
+            mWakeTick = nextWakeTick();
+            if (mWakeTick == UINT64_MAX) {
+                mWheelCondition.wait(lLock);
+            } else {
+                mWheelCondition.wait_until(lLock, mStart + std::chrono::nanoseconds(mWakeTick * mTickNs));
+            }
+            mWakeTick = 0;
+            continue;
+        }
+
+        for (PlayoutPacket *pPacket = lExpired.pHead; pPacket; pPacket = pPacket->pNext) {
+            auto lFlow = mFlows.find(pPacket->mFlowID);
+            if (lFlow != mFlows.end()) {
+                lFlow->second.mQueued--;
+            }
+            mStatistics.mQueued--;
+            mStatistics.mPackets++;
+            auto lLateness = std::chrono::microseconds((lNow - (int64_t) (pPacket->mDeadline * mTickNs)) / 1000);
+            mStatistics.mMaxLateness = std::max(mStatistics.mMaxLateness, lLateness);
+        }
+        lLock.unlock();
+        for (PlayoutPacket *pPacket = lExpired.pHead; pPacket; pPacket = pPacket->pNext) {
+            if (playoutCallback) {
+                playoutCallback(pPacket->mBuffer, pPacket->mFlowID);
+            }
+            pPacket->mBuffer.reset();
+        }
+        lLock.lock();
+        lExpired.pTail->pNext = mFree;
+        mFree = lExpired.pHead;
+    }
+}
@@ -0,0 +1,182 @@
+//
+// RISTNetPlayout -- Constant delay, timestamp paced delivery of received packets
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+// k constant
+
+#ifndef CPPRISTWRAPPER__RISTNETPLAYOUT_H
+#define CPPRISTWRAPPER__RISTNETPLAYOUT_H
+
+#include "RISTNet.h"
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * \class RISTNetPlayout
+ *
+ * \brief
+ *
+ * A RISTNetPlayout delivers every packet at its sender timestamp (ts_ntp, or the arrival time) plus a constant
+ * delay, so bursts after recoveries leave it paced as sent. Each flow is anchored on its first packet. The
+ * packets wait in a hierarchical timer wheel (256 slots of mTick, then three levels of 64 slots) driven by one
+ * thread for all flows, scheduling and expiring a packet is O(1) whatever the number of flows.
+ *
+ * A packet arriving after its deadline is discarded (late), a packet beyond mMaxPacketsPerFlow is discarded
+ * (overrun) and a late packet of a flow with nothing queued, the flow ran dry at its playout time, counts an
+ * underrun. A flow with nothing queued for mFlowTimeout is forgotten.
+ *
+ */
+class RISTNetPlayout {
+public:
+
+    static constexpr size_t kLevel0Slots = 256;
+    static constexpr size_t kLevelSlots = 64;
+    static constexpr size_t kLevels = 3;            // Above level 0
+
+    struct RISTNetPlayoutSettings {
+        std::chrono::microseconds mDelay{100000};           // The constant delay added to the timestamps
+        std::chrono::microseconds mTick{100};               // Timer wheel resolution
+        bool mUseSenderTime = true;                         // Pace by ts_ntp, else by the arrival time
+        std::chrono::microseconds mResyncThreshold{500000}; // Re-anchor a flow drifting more than this from the delay
+        size_t mMaxPacketsPerFlow = 16384;
+        std::chrono::milliseconds mFlowTimeout{10000};      // A flow idle this long is forgotten, re-anchored on its next packet
+        RISTNetPacketPool *mPacketPool = nullptr;           // Pool of the packet copies, nullptr is RISTNetPacketPool::defaultPool()
+    };
+
+    struct PlayoutStatistics {
+        uint64_t mPackets = 0;              // Packets played out
+        uint64_t mLate = 0;                 // Discarded, arrived after their deadline
+        uint64_t mOverruns = 0;             // Discarded, the flow had mMaxPacketsPerFlow waiting
+        uint64_t mUnderruns = 0;            // A packet's playout time came with nothing of its flow queued
+        uint64_t mResyncs = 0;              // Flows re-anchored (discontinuity or drift)
+        uint64_t mDropped = 0;              // Packet pool exhausted
+        size_t mQueued = 0;                 // Packets waiting now
+        size_t mFlows = 0;
+        std::chrono::microseconds mMaxLateness{0};  // Max time from a deadline to its delivery
+    };
+
+    /// Constructor
+    RISTNetPlayout();
+
+    /// Destructor
+    virtual ~RISTNetPlayout();
+
+    /**
+     * @brief Initialize the playout
+     *
+     * Starts the timer thread.
+     *
+     * @param The playout settings
+     * @return true on success
+     */
+    bool initPlayout(RISTNetPlayoutSettings &rSettings);
+
+    /**
+     * @brief Attach a receiver
+     *
+     * The packets of the receiver are played out to playoutCallback. Sets networkDataBlockCallback.
+     * The playout must outlive the receiver.
+     *
+     * @param the receiver
+     * @return true on success
+     */
+    bool attachReceiver(RISTNetReceiver &rReceiver);
+
+    /**
+     * @brief Push a packet
+     *
+     * Copies the packet and schedules it for its timestamp (ts_ntp) plus the delay. Never blocks on the playout.
+     *
+     * @param the data block
+     * @return true if scheduled, false if discarded
+     */
+    bool pushPacket(const rist_data_block &rDataBlock);
+
+    /// Get the playout statistics
+    void getStatistics(PlayoutStatistics &rStatistics);
+
+    /**
+     * @brief Destroys the playout
+     *
+     * Stops the timer thread, the packets waiting are discarded.
+     *
+     */
+    bool destroyPlayout();
+
+    /// Callback getting the packets at their playout time, on the timer thread
+    std::function<void(RISTNetPacketBuffer &rBuffer, uint32_t lFlowID)> playoutCallback = nullptr;
+
+    // Delete copy and move constructors and assign operators
+    RISTNetPlayout(RISTNetPlayout const &) = delete;             // Copy construct
+    RISTNetPlayout(RISTNetPlayout &&) = delete;                  // Move construct
+    RISTNetPlayout &operator=(RISTNetPlayout const &) = delete;  // Copy assign
+    RISTNetPlayout &operator=(RISTNetPlayout &&) = delete;       // Move assign
+
+private:
+
+    struct PlayoutPacket {
+        RISTNetPacketBuffer mBuffer;
+        uint64_t mDeadline = 0;     // Tick
+        uint32_t mFlowID = 0;
+        PlayoutPacket *pNext = nullptr;
+    };
+
+    struct SlotList {
+        PlayoutPacket *pHead = nullptr;
+        PlayoutPacket *pTail = nullptr;
+    };
+
+    struct PlayoutFlow {
+        bool mAnchored = false;
+        uint64_t mNTPBase = 0;
+        int64_t mTimeBase = 0;      // ns, steady clock
+        int64_t mLastPush = 0;      // ns, the arrival of the last packet
+        size_t mQueued = 0;
+    };
+
+    int64_t nowNs();
+    static int64_t ntpToNs(int64_t lNTPDelta);
+    void reapFlows(int64_t lNow);
+    PlayoutPacket *allocatePacket();
+    void schedule(PlayoutPacket *pPacket);
+    static void append(SlotList &rList, PlayoutPacket *pPacket);
+    void cascade(SlotList &rList);
+    void advance(SlotList &rExpired);
+    uint64_t nextWakeTick();
+    void timerWorker();
+
+    RISTNetPlayoutSettings mSettings;
+    RISTNetPacketPool *mPacketPool = nullptr;
+    std::chrono::steady_clock::time_point mStart;
+    int64_t mTickNs = 0;
+    bool mInitialised = false;
+
+    // The mutex protecting the wheel, the flows and the statistics
+    std::mutex mWheelMtx;
+    std::condition_variable mWheelCondition;
+    uint64_t mCurrentTick = 0;      // The next tick to expire
+    uint64_t mWakeTick = UINT64_MAX;  // The tick the timer thread sleeps until
+    SlotList mLevel0[kLevel0Slots];
+    uint64_t mLevel0Bits[kLevel0Slots / 64] = {};
+    SlotList mLevels[kLevels][kLevelSlots];
+    SlotList mOverflow;             // Beyond the levels, rescheduled when level 3 wraps
+    std::unordered_map<uint32_t, PlayoutFlow> mFlows;
+    int64_t mNextReap = 0;          // ns, the next idle flow sweep
+    PlayoutStatistics mStatistics;
+
+    // The packet nodes, allocated in chunks and reused
+    std::vector<std::unique_ptr<PlayoutPacket[]>> mChunks;
+    PlayoutPacket *mFree = nullptr;
+
+    std::thread mTimerThread;
+    bool mTimerRun = false;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETPLAYOUT_H
@@ -0,0 +1,16 @@
+//
+// RISTNetProbes -- USDT (SystemTap SDT) probes on the hot paths of the wrapper, for perf and bpftrace
+//
+
+#include "RISTNetProbes.h"
+
+#ifdef RISTNET_HAVE_SDT
+
+// The semaphores referenced by the probe notes, in .probes where the tracers look for them
+extern "C" {
+#define RISTNET_PROBE_DEFINE(lName) \
+    __attribute__((section(".probes"))) volatile unsigned short RISTNET_PROBE_SEMAPHORE(lName) = 0;
+RISTNET_PROBE_LIST(RISTNET_PROBE_DEFINE)
+}
+
+#endif
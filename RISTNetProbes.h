@@ -0,0 +1,131 @@
+//
+// RISTNetProbes -- USDT (SystemTap SDT) probes on the hot paths of the wrapper, for perf and bpftrace
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+// k constant
+
+#ifndef CPPRISTWRAPPER__RISTNETPROBES_H
+#define CPPRISTWRAPPER__RISTNETPROBES_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// The probes of provider ristnet, arg0 is the RISTNetReceiver or RISTNetSender. Durations are ns.
+//
+//   lock_wait          (object, const char *site, wait)          mClientListMtx acquired after wait
+//   receive_data       (receiver, peer, flow_id, size, callback, result)
+//   receive_oob        (object, peer, size, duration)           duration: the queue push or networkOOBDataCallback
+//   client_connect     (object, peer, const char *ip, port, callback, accepted)   callback: validateConnectionCallback
+//   client_disconnect  (object, peer, callback)
+//   statistics         (object, stats_type, callback)           callback: the queue push or statisticsCallback
+//   send_data          (sender, flow_id, size, write, result)   write: rist_sender_data_write
+//   init_receiver      (receiver, urls, ok, duration)
+//   init_sender        (sender, peers, ok, duration)
+//   destroy_receiver   (receiver, duration)
+//   destroy_sender     (sender, duration)
+//
+// Built with probes when CMake finds sys/sdt.h (RISTNET_HAVE_SDT, public on the ristnet target: everything including
+// this header has to agree on it). A probe has a semaphore the tracer sets when
+// attached, until then a probe is a load and a not taken branch: the arguments and the clock reads are skipped.
+#define RISTNET_PROBE_LIST(X) \
+    X(lock_wait)              \
+    X(receive_data)           \
+    X(receive_oob)            \
+    X(client_connect)         \
+    X(client_disconnect)      \
+    X(statistics)             \
+    X(send_data)              \
+    X(init_receiver)          \
+    X(init_sender)            \
+    X(destroy_receiver)       \
+    X(destroy_sender)
+
+#ifdef RISTNET_HAVE_SDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#define SDT_USE_VARIADIC 1
+#include <sys/sdt.h>
+
+#define RISTNET_PROBE_SEMAPHORE(lName) ristnet_##lName##_semaphore
+#define RISTNET_PROBE_DECLARE(lName) extern "C" volatile unsigned short RISTNET_PROBE_SEMAPHORE(lName);
+RISTNET_PROBE_LIST(RISTNET_PROBE_DECLARE)
+
+#define RISTNET_PROBE_ENABLED(lName) __builtin_expect(RISTNET_PROBE_SEMAPHORE(lName) != 0, 0)
+#define RISTNET_PROBE(lName, ...) do { \
+    if (RISTNET_PROBE_ENABLED(lName)) { STAP_PROBEV(ristnet, lName, __VA_ARGS__); } \
+} while (0)
+
+#else
+
+template<typename... T>
+inline void ristnetProbeUnused(const T &...) {}
+
+#define RISTNET_PROBE_ENABLED(lName) false
+#define RISTNET_PROBE(lName, ...) do { if (false) { ristnetProbeUnused(__VA_ARGS__); } } while (0)
+
+#endif
+
+inline uint64_t ristnetProbeNow() {
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// The start of a measured section, 0 if the probe is not enabled
+#define RISTNET_PROBE_START(lName) (RISTNET_PROBE_ENABLED(lName) ? ristnetProbeNow() : 0)
+
+/// Since a RISTNET_PROBE_START, 0 if the probe was enabled within the section
+inline uint64_t ristnetProbeSince(uint64_t lStart) {
+    return lStart ? ristnetProbeNow() - lStart : 0;
+}
+
+/**
+ * \class RISTNetProbeLock
+ *
+ * \brief
+ *
+ * A std::lock_guard reporting the time waited for the mutex through the lock_wait probe.
+ *
+ */
+class RISTNetProbeLock {
+public:
+    RISTNetProbeLock(std::mutex &rMutex, const void *pObject, const char *pSite) : mMutex(rMutex) {
+        uint64_t lStart = RISTNET_PROBE_START(lock_wait);
+        mMutex.lock();
+        RISTNET_PROBE(lock_wait, pObject, pSite, ristnetProbeSince(lStart));
+    }
+
+    ~RISTNetProbeLock() {
+        mMutex.unlock();
+    }
+
+    RISTNetProbeLock(RISTNetProbeLock const &) = delete;
+    RISTNetProbeLock &operator=(RISTNetProbeLock const &) = delete;
+
+private:
+    std::mutex &mMutex;
+};
+
+/// Runs lDone when the scope ends, for the probes of functions with many returns
+template<typename F>
+class RISTNetProbeScope {
+public:
+    explicit RISTNetProbeScope(F lDone) : mDone(std::move(lDone)) {}
+
+    ~RISTNetProbeScope() {
+        mDone();
+    }
+
+    RISTNetProbeScope(RISTNetProbeScope const &) = delete;
+    RISTNetProbeScope &operator=(RISTNetProbeScope const &) = delete;
+
+private:
+    F mDone;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETPROBES_H
@@ -0,0 +1,294 @@
+//
+// RISTNetRelay -- Fan-out of one received stream to many outputs
+//
+
+#include "RISTNetRelay.h"
+#include "RISTNetInternal.h"
+#include <algorithm>
+
+RISTNetRelay::RISTNetRelay() {
+    mOutputs = std::make_shared<const std::vector<std::shared_ptr<RelayOutput>>>();
+    LOGGER(false, LOGG_NOTIFY, "RISTNetRelay constructed")
+}
+
+RISTNetRelay::~RISTNetRelay() {
+    if (mInitialised) {
+        destroyRelay();
+    }
+    LOGGER(false, LOGG_NOTIFY, "RISTNetRelay destruct")
+}
+
+bool RISTNetRelay::initRelay(RISTNetRelaySettings &rSettings) {
+    if (mInitialised) {
+        LOGGER(true, LOGG_ERROR, "RISTNetRelay already initialised.")
+        return false;
+    }
+    if (!rSettings.mThreads || !rSettings.mBurst) {
+        LOGGER(true, LOGG_ERROR, "Threads or burst not valid.")
+        return false;
+    }
+    mSettings = rSettings;
+    mPacketPool = rSettings.mPacketPool ? rSettings.mPacketPool : &RISTNetPacketPool::defaultPool();
+    mPackets = 0;
+    mBytes = 0;
+    mWorkersRun = true;
+    for (size_t i = 0; i < mSettings.mThreads; i++) {
+        mWorkers.emplace_back(&RISTNetRelay::workerThread, this);
+    }
+    mInitialised = true;
+    return true;
+}
+
+uint32_t RISTNetRelay::addOutput(RISTNetSender &rSender, RelayOutputSettings &rSettings) {
+    return addOutput([&rSender](const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID) {
+        return rSender.sendData(pBuf, lSize, lConnectionID);
+    }, rSettings);
+}
+
+uint32_t RISTNetRelay::addOutput(std::function<bool(const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID)> lSendFunction,
+                                 RelayOutputSettings &rSettings) {
+    if (!mInitialised) {
+        LOGGER(true, LOGG_ERROR, "RISTNetRelay not initialised.")
+        return 0;
+    }
+    if (!lSendFunction || !rSettings.mQueueSize) {
+        LOGGER(true, LOGG_ERROR, "No send function or queue size not valid.")
+        return 0;
+    }
+    auto lOutput = std::make_shared<RelayOutput>();
+    lOutput->mSettings = rSettings;
+    lOutput->mSendFunction = std::move(lSendFunction);
+
+    std::lock_guard<std::mutex> lLock(mOutputsMtx);
+    lOutput->mOutputID = mNextOutputID++;
+    auto lOutputs = std::make_shared<std::vector<std::shared_ptr<RelayOutput>>>(*mOutputs);
+    lOutputs->push_back(lOutput);
+    mOutputs = lOutputs;
+    return lOutput->mOutputID;
+}
+
+bool RISTNetRelay::removeOutput(uint32_t lOutputID) {
+    std::shared_ptr<RelayOutput> lOutput;
+    {
+        std::lock_guard<std::mutex> lLock(mOutputsMtx);
+        auto lOutputs = std::make_shared<std::vector<std::shared_ptr<RelayOutput>>>(*mOutputs);
+        auto lIterator = std::find_if(lOutputs->begin(), lOutputs->end(),
+                                      [&](const std::shared_ptr<RelayOutput> &rOutput) {
+                                          return rOutput->mOutputID == lOutputID;
+                                      });
+        if (lIterator == lOutputs->end()) {
+            LOGGER(true, LOGG_ERROR, "No output with id: " << lOutputID)
+            return false;
+        }
+        lOutput = *lIterator;
+        lOutputs->erase(lIterator);
+        mOutputs = lOutputs;
+    }
+    // A worker may still hold a reference, it skips the output from now on
+    std::unique_lock<std::mutex> lLock(lOutput->mQueueMtx);
+    lOutput->mRemoved = true;
+    lOutput->mQueue.clear();
+    if (lOutput->mSending && lOutput->mSendingThread == std::this_thread::get_id()) {
+        // From the send function, the worker stops sending the batch when it returns
+        return true;
+    }
+    lOutput->mIdleCondition.wait(lLock, [&]() { return !lOutput->mSending; });
+    return true;
+}
+
+bool RISTNetRelay::attachReceiver(RISTNetReceiver &rReceiver) {
+    if (!mInitialised) {
+        LOGGER(true, LOGG_ERROR, "RISTNetRelay not initialised.")
+        return false;
+    }
+    rReceiver.networkDataCallback = [this](const uint8_t *pBuf, size_t lSize,
+                                           std::shared_ptr<RISTNetReceiver::NetworkConnection> &rConnection,
+                                           rist_peer *pPeer, uint16_t lConnectionID) {
+        pushData(pBuf, lSize, lConnectionID);
+        return 0;
+    };
+    return true;
+}
+
+bool RISTNetRelay::pushData(const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID) {
+    if (!mInitialised) {
+        LOGGER(true, LOGG_ERROR, "RISTNetRelay not initialised.")
+        return false;
+    }
+    // The only copy of the payload, the queues share it
+    RISTNetPacketBuffer lBuffer = mPacketPool->copy(pBuf, lSize);
+    if (!lBuffer) {
+        LOGGER(true, LOGG_ERROR, "Packet pool exhausted, packet dropped.")
+        return false;
+    }
+    auto lReceived = std::chrono::steady_clock::now();
+    mPackets++;
+    mBytes += lSize;
+
+    std::shared_ptr<const std::vector<std::shared_ptr<RelayOutput>>> lOutputs;
+    {
+        std::lock_guard<std::mutex> lLock(mOutputsMtx);
+        lOutputs = mOutputs;
+    }
+    bool lAllQueued = true;
+    for (auto &rOutput: *lOutputs) {
+        bool lSchedule = false;
+        {
+            std::lock_guard<std::mutex> lLock(rOutput->mQueueMtx);
+            if (rOutput->mRemoved) {
+                continue;
+            }
+            if (rOutput->mQueue.size() >= rOutput->mSettings.mQueueSize) {
+                rOutput->mStatistics.mDropped++;
+                if (rOutput->mSettings.mDropPolicy == DropPolicy::kDropNewest) {
+                    lAllQueued = false;
+                    continue;
+                }
+                rOutput->mQueue.pop_front();
+            }
+            rOutput->mQueue.push_back({lReceived, lConnectionID, lBuffer.share()});
+            if (!rOutput->mScheduled) {
+                rOutput->mScheduled = true;
+                lSchedule = true;
+            }
+        }
+        if (lSchedule) {
+            schedule(rOutput);
+        }
+    }
+    return lAllQueued;
+}
+
+void RISTNetRelay::schedule(const std::shared_ptr<RelayOutput> &rOutput) {
+    {
+        std::lock_guard<std::mutex> lLock(mRunQueueMtx);
+        mRunQueue.push_back(rOutput);
+    }
+    mRunQueueCondition.notify_one();
+}
+
+void RISTNetRelay::serveOutput(const std::shared_ptr<RelayOutput> &rOutput,
+                               std::vector<RelayPacket> &rBatch) {
+    {
+        std::lock_guard<std::mutex> lLock(rOutput->mQueueMtx);
+        if (rOutput->mRemoved) {
+            rOutput->mScheduled = false;
+            return;
+        }
+        size_t lCount = std::min(rOutput->mQueue.size(), mSettings.mBurst);
+        for (size_t i = 0; i < lCount; i++) {
+            rBatch.push_back(std::move(rOutput->mQueue.front()));
+            rOutput->mQueue.pop_front();
+        }
+        if (!rBatch.empty()) {
+            rOutput->mSendingOldest = rBatch.front().mReceived;
+        }
+        rOutput->mSending = true;
+        rOutput->mSendingThread = std::this_thread::get_id();
+    }
+
+    // Send without holding the queue lock so pushData never waits for a slow output
+    uint64_t lSent = 0;
+    uint64_t lFailures = 0;
+    std::chrono::steady_clock::duration lMaxLag{0};
+    for (auto &rPacket: rBatch) {
+        if (rOutput->mRemoved.load(std::memory_order_relaxed)) {
+            break;
+        }
+        if (rOutput->mSendFunction(rPacket.mBuffer.data(), rPacket.mBuffer.size(), rPacket.mConnectionID)) {
+            lSent++;
+        } else {
+            lFailures++;
+        }
+        lMaxLag = std::max(lMaxLag, std::chrono::steady_clock::now() - rPacket.mReceived);
+    }
+    rBatch.clear();
+
+    bool lReschedule = false;
+    {
+        std::lock_guard<std::mutex> lLock(rOutput->mQueueMtx);
+        rOutput->mSending = false;
+        rOutput->mStatistics.mSent += lSent;
+        rOutput->mStatistics.mSendFailures += lFailures;
+        rOutput->mStatistics.mMaxLag = std::max(rOutput->mStatistics.mMaxLag,
+                                                std::chrono::duration_cast<std::chrono::microseconds>(lMaxLag));
+        if (!rOutput->mRemoved && !rOutput->mQueue.empty()) {
+            lReschedule = true;
+        } else {
+            rOutput->mScheduled = false;
+        }
+    }
+    rOutput->mIdleCondition.notify_all();
+    if (lReschedule) {
+        // To the back of the run queue so the other outputs get their turn
+        schedule(rOutput);
+    }
+}
+
+void RISTNetRelay::workerThread() {
+    std::vector<RelayPacket> lBatch;
+    lBatch.reserve(mSettings.mBurst);
+    while (true) {
+        std::shared_ptr<RelayOutput> lOutput;
+        {
+            std::unique_lock<std::mutex> lLock(mRunQueueMtx);
+            mRunQueueCondition.wait(lLock, [&]() { return !mWorkersRun || !mRunQueue.empty(); });
+            if (!mWorkersRun) {
+                return;
+            }
+            lOutput = std::move(mRunQueue.front());
+            mRunQueue.pop_front();
+        }
+        serveOutput(lOutput, lBatch);
+    }
+}
+
+void RISTNetRelay::getStatistics(RelayStatistics &rStatistics) {
+    rStatistics.mPackets = mPackets;
+    rStatistics.mBytes = mBytes;
+    std::lock_guard<std::mutex> lLock(mOutputsMtx);
+    rStatistics.mOutputs = mOutputs->size();
+}
+
+bool RISTNetRelay::getOutputStatistics(uint32_t lOutputID, RelayOutputStatistics &rStatistics) {
+    std::shared_ptr<const std::vector<std::shared_ptr<RelayOutput>>> lOutputs;
+    {
+        std::lock_guard<std::mutex> lLock(mOutputsMtx);
+        lOutputs = mOutputs;
+    }
+    for (auto &rOutput: *lOutputs) {
+        if (rOutput->mOutputID != lOutputID) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lLock(rOutput->mQueueMtx);
+        rStatistics = rOutput->mStatistics;
+        rStatistics.mQueued = rOutput->mQueue.size();
+        auto lNow = std::chrono::steady_clock::now();
+        auto lOldest = rOutput->mSending ? rOutput->mSendingOldest :
+                       rOutput->mQueue.empty() ? lNow : rOutput->mQueue.front().mReceived;
+        rStatistics.mLag = std::chrono::duration_cast<std::chrono::microseconds>(lNow - lOldest);
+        return true;
+    }
+    return false;
+}
+
+bool RISTNetRelay::destroyRelay() {
+    if (!mInitialised) {
+        LOGGER(true, LOGG_WARN, "RISTNetRelay not initialised.")
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lLock(mRunQueueMtx);
+        mWorkersRun = false;
+    }
+    mRunQueueCondition.notify_all();
+    for (auto &rWorker: mWorkers) {
+        rWorker.join();
+    }
+    mWorkers.clear();
+    mRunQueue.clear();
+    std::lock_guard<std::mutex> lLock(mOutputsMtx);
+    mOutputs = std::make_shared<const std::vector<std::shared_ptr<RelayOutput>>>();
+    mInitialised = false;
+    return true;
+}
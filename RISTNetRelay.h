@@ -0,0 +1,214 @@
+//
+// RISTNetRelay -- Fan-out of one received stream to many outputs
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETRELAY_H
+#define CPPRISTWRAPPER__RISTNETRELAY_H
+
+#include "RISTNet.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+/**
+ * \class RISTNetRelay
+ *
+ * \brief
+ *
+ * A RISTNetRelay re-sends every packet pushed to it (or received by an attached receiver) to all its outputs,
+ * typically RISTNetSenders. A packet is copied once into a reference counted buffer, every output queues a
+ * reference in its own bounded queue. The outputs are driven from a thread pool, one worker at a time per
+ * output so the order is kept, so a slow output fills its own queue and drops by its own policy without
+ * delaying the other outputs.
+ *
+ */
+class RISTNetRelay {
+public:
+
+    enum class DropPolicy {
+        kDropNewest,    // A full queue rejects new packets
+        kDropOldest     // A full queue discards its oldest packet for the new one
+    };
+
+    struct RISTNetRelaySettings {
+        size_t mThreads = 4;        // Worker threads driving the outputs, more than the outputs that may block at once
+        size_t mBurst = 32;         // Max packets sent to an output before the worker moves on
+        RISTNetPacketPool *mPacketPool = nullptr; // Pool of the packet copies, nullptr is RISTNetPacketPool::defaultPool()
+    };
+
+    struct RelayOutputSettings {
+        size_t mQueueSize = 1024;   // Max packets queued for the output
+        DropPolicy mDropPolicy = DropPolicy::kDropOldest;
+    };
+
+    struct RelayOutputStatistics {
+        uint64_t mSent = 0;
+        uint64_t mSendFailures = 0;
+        uint64_t mDropped = 0;                  // Dropped by the queue policy
+        size_t mQueued = 0;                     // Packets waiting now
+        std::chrono::microseconds mLag{0};      // Age of the oldest packet not sent yet
+        std::chrono::microseconds mMaxLag{0};   // Max time from push to send
+    };
+
+    struct RelayStatistics {
+        uint64_t mPackets = 0;      // Packets pushed
+        uint64_t mBytes = 0;
+        size_t mOutputs = 0;
+    };
+
+    /// Constructor
+    RISTNetRelay();
+
+    /// Destructor
+    virtual ~RISTNetRelay();
+
+    /**
+     * @brief Initialize the relay
+     *
+     * Starts the worker threads.
+     *
+     * @param The relay settings
+     * @return true on success
+     */
+    bool initRelay(RISTNetRelaySettings &rSettings);
+
+    /**
+     * @brief Add an output sender
+     *
+     * The sender must outlive the output. Packets are sent with the flow id (connection id) they were pushed with.
+     *
+     * @param the sender
+     * @param the output settings
+     * @return the output id, 0 on failure
+     */
+    uint32_t addOutput(RISTNetSender &rSender, RelayOutputSettings &rSettings);
+
+    /**
+     * @brief Add an output callback
+     *
+     * @param called from a worker thread for every packet, return false if the packet was not sent
+     * @param the output settings
+     * @return the output id, 0 on failure
+     */
+    uint32_t addOutput(std::function<bool(const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID)> lSendFunction,
+                       RelayOutputSettings &rSettings);
+
+    /**
+     * @brief Remove an output
+     *
+     * Discards what is queued for it. Waits for a send in progress to the output to complete, unless called from
+     * the send function of the output itself: then the rest of the batch is discarded and it returns at once.
+     *
+     * @param the output id
+     * @return true on success
+     */
+    bool removeOutput(uint32_t lOutputID);
+
+    /**
+     * @brief Attach a receiver
+     *
+     * Relays all data received by the receiver. This replaces the networkDataCallback of the receiver.
+     * The relay must outlive the receiver.
+     *
+     * @param the receiver
+     * @return true on success
+     */
+    bool attachReceiver(RISTNetReceiver &rReceiver);
+
+    /**
+     * @brief Push data
+     *
+     * Queues the data to all outputs, never blocks on an output.
+     *
+     * @param pointer to the data
+     * @param length of the data
+     * @param the connection id (flow id)
+     * @return true if the data was queued to all outputs
+     */
+    bool pushData(const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID = 0);
+
+    /// Get the relay statistics
+    void getStatistics(RelayStatistics &rStatistics);
+
+    /**
+     * @brief Get the statistics of an output
+     *
+     * @param the output id
+     * @param the statistics
+     * @return true if the output exists
+     */
+    bool getOutputStatistics(uint32_t lOutputID, RelayOutputStatistics &rStatistics);
+
+    /**
+     * @brief Destroys the relay
+     *
+     * Stops the workers and removes all outputs, what is queued is discarded.
+     *
+     */
+    bool destroyRelay();
+
+    // Delete copy and move constructors and assign operators
+    RISTNetRelay(RISTNetRelay const &) = delete;             // Copy construct
+    RISTNetRelay(RISTNetRelay &&) = delete;                  // Move construct
+    RISTNetRelay &operator=(RISTNetRelay const &) = delete;  // Copy assign
+    RISTNetRelay &operator=(RISTNetRelay &&) = delete;       // Move assign
+
+private:
+
+    // A queued packet, the queues hold handles to the same pool buffer
+    struct RelayPacket {
+        std::chrono::steady_clock::time_point mReceived;
+        uint16_t mConnectionID = 0;
+        RISTNetPacketBuffer mBuffer;
+    };
+
+    struct RelayOutput {
+        uint32_t mOutputID = 0;
+        RelayOutputSettings mSettings;
+        std::function<bool(const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID)> mSendFunction;
+
+        // The mutex protecting the queue, the scheduling state and the statistics
+        std::mutex mQueueMtx;
+        std::condition_variable mIdleCondition;
+        std::deque<RelayPacket> mQueue;
+        bool mScheduled = false;     // In the run queue or being served by a worker
+        bool mSending = false;       // Being served by a worker
+        std::thread::id mSendingThread;                       // The worker serving it, while mSending
+        std::chrono::steady_clock::time_point mSendingOldest; // Oldest packet of the batch being sent
+        std::atomic<bool> mRemoved{false};  // Written under mQueueMtx, read without it between sends
+        RelayOutputStatistics mStatistics;
+    };
+
+    void schedule(const std::shared_ptr<RelayOutput> &rOutput);
+    void serveOutput(const std::shared_ptr<RelayOutput> &rOutput,
+                     std::vector<RelayPacket> &rBatch);
+    void workerThread();
+
+    RISTNetRelaySettings mSettings;
+    bool mInitialised = false;
+    RISTNetPacketPool *mPacketPool = nullptr;
+
+    // The output list is copied on change, pushData works on a snapshot without holding the lock
+    std::mutex mOutputsMtx;
+    std::shared_ptr<const std::vector<std::shared_ptr<RelayOutput>>> mOutputs;
+    uint32_t mNextOutputID = 1;
+
+    // Outputs with packets waiting for a worker
+    std::mutex mRunQueueMtx;
+    std::condition_variable mRunQueueCondition;
+    std::deque<std::shared_ptr<RelayOutput>> mRunQueue;
+    bool mWorkersRun = false;
+    std::vector<std::thread> mWorkers;
+
+    std::atomic<uint64_t> mPackets = 0;
+    std::atomic<uint64_t> mBytes = 0;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETRELAY_H
@@ -0,0 +1,735 @@
+//
+// RISTNetResolver -- Asynchronous host name resolution with a TTL cache, for the URLs of many peers
+//
+
+#include "RISTNetResolver.h"
+#include "RISTNetInternal.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <random>
+
+#ifdef WIN32
+#include <Winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// DNS record types and classes (RFC 1035, RFC 3596)
+constexpr uint16_t kTypeA = 1;
+constexpr uint16_t kTypeAAAA = 28;
+constexpr uint16_t kClassIN = 1;
+constexpr uint8_t kRcodeNameError = 3;
+
+std::string toLower(const std::string &rStr) {
+    std::string lLower = rStr;
+    std::transform(lLower.begin(), lLower.end(), lLower.begin(),
+                   [](unsigned char lChar) { return (char) std::tolower(lChar); });
+    return lLower;
+}
+
+uint16_t read16(const uint8_t *pData) {
+    return (uint16_t) ((pData[0] << 8) | pData[1]);
+}
+
+uint32_t read32(const uint8_t *pData) {
+    return ((uint32_t) pData[0] << 24) | ((uint32_t) pData[1] << 16) | ((uint32_t) pData[2] << 8) | pData[3];
+}
+
+// Skips a (possibly compressed) name, false if malformed
+bool skipName(const uint8_t *pData, size_t lSize, size_t &rPos) {
+    while (rPos < lSize) {
+        uint8_t lLength = pData[rPos];
+        if (lLength == 0) {
+            rPos++;
+            return true;
+        }
+        if ((lLength & 0xc0) == 0xc0) {
+            rPos += 2;
+            return rPos <= lSize;
+        }
+        if (lLength & 0xc0) {
+            return false;
+        }
+        rPos += 1 + lLength;
+    }
+    return false;
+}
+
+// A recursive query for one name and type
+void buildQuery(uint16_t lID, const std::string &rHost, uint16_t lType, std::vector<uint8_t> &rQuery) {
+    rQuery = {(uint8_t) (lID >> 8), (uint8_t) lID, 0x01, 0x00, 0, 1, 0, 0, 0, 0, 0, 0};
+    size_t lStart = 0;
+    while (lStart < rHost.size()) {
+        size_t lEnd = rHost.find('.', lStart);
+        if (lEnd == std::string::npos) {
+            lEnd = rHost.size();
+        }
+        rQuery.push_back((uint8_t) (lEnd - lStart));
+        rQuery.insert(rQuery.end(), rHost.begin() + lStart, rHost.begin() + lEnd);
+        lStart = lEnd + 1;
+    }
+    rQuery.push_back(0);
+    rQuery.insert(rQuery.end(), {(uint8_t) (lType >> 8), (uint8_t) lType, 0, kClassIN});
+}
+
+// The addresses of an answer and their smallest TTL, false if malformed
+bool parseAnswer(const uint8_t *pData, size_t lSize, uint8_t &rRcode, std::vector<std::string> &rAddresses,
+                 uint32_t &rTTL) {
+    if (lSize < 12) {
+        return false;
+    }
+    rRcode = pData[3] & 0x0f;
+    uint16_t lQuestions = read16(pData + 4);
+    uint16_t lAnswers = read16(pData + 6);
+    size_t lPos = 12;
+    for (uint16_t i = 0; i < lQuestions; i++) {
+        if (!skipName(pData, lSize, lPos)) {
+            return false;
+        }
+        lPos += 4;
+    }
+    for (uint16_t i = 0; i < lAnswers; i++) {
+        if (!skipName(pData, lSize, lPos) || lPos + 10 > lSize) {
+            return false;
+        }
+        uint16_t lType = read16(pData + lPos);
+        uint16_t lClass = read16(pData + lPos + 2);
+        uint32_t lTTL = read32(pData + lPos + 4);
+        uint16_t lLength = read16(pData + lPos + 8);
+        lPos += 10;
+        if (lPos + lLength > lSize) {
+            return false;
+        }
+        if (lClass == kClassIN) {
+            // CNAME records count, the addresses expire with the alias
+            rTTL = std::min(rTTL, lTTL);
+            char lAddress[INET6_ADDRSTRLEN];
+            if (lType == kTypeA && lLength == 4 && inet_ntop(AF_INET, pData + lPos, lAddress, sizeof(lAddress))) {
+                rAddresses.emplace_back(lAddress);
+            } else if (lType == kTypeAAAA && lLength == 16 &&
+                       inet_ntop(AF_INET6, pData + lPos, lAddress, sizeof(lAddress))) {
+                rAddresses.emplace_back(lAddress);
+            }
+        }
+        lPos += lLength;
+    }
+    return true;
+}
+} // namespace
+
+RISTNetResolver::RISTNetResolver() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetResolver constructed")
+}
+
+RISTNetResolver::~RISTNetResolver() {
+    if (mInitialised) {
+        destroyResolver();
+    }
+    LOGGER(false, LOGG_NOTIFY, "RISTNetResolver destruct")
+}
+
+RISTNetResolver &RISTNetResolver::globalResolver() {
+    // Never destroyed, the threads wait until the process exits
+    static RISTNetResolver *pResolver = [] {
+        auto *pNew = new RISTNetResolver();
+        RISTNetResolverSettings lSettings;
+        pNew->initResolver(lSettings);
+        return pNew;
+    }();
+    return *pResolver;
+}
+
+bool RISTNetResolver::initResolver(RISTNetResolverSettings &rSettings) {
+    if (mInitialised) {
+        LOGGER(true, LOGG_ERROR, "RISTNetResolver already initialised.")
+        return false;
+    }
+    if (!rSettings.mThreads || rSettings.mMinTTL.count() < 0 || rSettings.mMinTTL > rSettings.mMaxTTL ||
+        rSettings.mDefaultTTL.count() < 0 || rSettings.mNegativeTTL.count() < 0 ||
+        rSettings.mQueryTimeout.count() <= 0) {
+        LOGGER(true, LOGG_ERROR, "Resolver threads, TTL or timeout not valid.")
+        return false;
+    }
+    if (rSettings.mFamily != 0 && rSettings.mFamily != AF_INET && rSettings.mFamily != AF_INET6) {
+        LOGGER(true, LOGG_ERROR, "Resolver address family not valid.")
+        return false;
+    }
+    mNameServers.clear();
+    for (auto &rServer: rSettings.mNameServers) {
+        NameServer lNameServer;
+        if (!parseNameServer(rServer, lNameServer)) {
+            LOGGER(true, LOGG_ERROR, "Name server not valid: " << rServer)
+            return false;
+        }
+        mNameServers.push_back(lNameServer);
+    }
+#ifdef WIN32
+    if (!mNameServers.empty()) {
+        LOGGER(true, LOGG_ERROR, "Name servers not supported on this platform.")
+        return false;
+    }
+#endif
+    mSettings = rSettings;
+    std::lock_guard<std::mutex> lLock(mMtx);
+    mStatistics = ResolverStatistics();
+    mRun = true;
+    for (size_t i = 0; i < mSettings.mThreads; i++) {
+        mWorkers.emplace_back(&RISTNetResolver::resolverWorker, this);
+    }
+    mWatchThread = std::thread(&RISTNetResolver::watchWorker, this);
+    mInitialised = true;
+    return true;
+}
+
+bool RISTNetResolver::isAddress(const std::string &rHost) {
+    uint8_t lAddress[16];
+    return inet_pton(AF_INET, rHost.c_str(), lAddress) == 1 || inet_pton(AF_INET6, rHost.c_str(), lAddress) == 1;
+}
+
+bool RISTNetResolver::isHostName(const std::string &rHost) {
+    std::string lHost = !rHost.empty() && rHost.back() == '.' ? rHost.substr(0, rHost.size() - 1) : rHost;
+    if (lHost.empty() || lHost.size() > 253) {
+        return false;
+    }
+    size_t lLabel = 0;
+    for (size_t i = 0; i <= lHost.size(); i++) {
+        if (i == lHost.size() || lHost[i] == '.') {
+            if (!lLabel || lLabel > 63 || lHost[i - 1] == '-' || lHost[i - lLabel] == '-') {
+                return false;
+            }
+            lLabel = 0;
+        } else if (std::isalnum((unsigned char) lHost[i]) || lHost[i] == '-' || lHost[i] == '_') {
+            lLabel++;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RISTNetResolver::resolve(const std::string &rHost, ResolveCallback lCallback) {
+    if (isAddress(rHost)) {
+        Resolution lResolution;
+        lResolution.mHost = rHost;
+        lResolution.mAddresses.push_back(rHost);
+        lCallback(lResolution);
+        return true;
+    }
+    if (!isHostName(rHost)) {
+        LOGGER(true, LOGG_ERROR, "Host name not valid: " << rHost)
+        return false;
+    }
+    std::string lHost = toLower(rHost);
+    if (lHost.back() == '.') {
+        lHost.pop_back();
+    }
+    auto lNow = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lLock(mMtx);
+    if (!mRun) {
+        LOGGER(true, LOGG_ERROR, "RISTNetResolver not initialised.")
+        return false;
+    }
+    mStatistics.mLookups++;
+    if (mCache.size() >= mSettings.mMaxCacheEntries && !mCache.count(lHost)) {
+        pruneCache(lNow);
+    }
+    CacheEntry &rEntry = mCache[lHost];
+    if (rEntry.mInFlight) {
+        rEntry.mWaiters.push_back(std::move(lCallback));
+        mStatistics.mCoalesced++;
+        return true;
+    }
+    if (rEntry.mValid && lNow < rEntry.mExpires) {
+        Resolution lResolution;
+        lResolution.mHost = lHost;
+        lResolution.mAddresses = rEntry.mAddresses;
+        lResolution.mError = rEntry.mError;
+        lResolution.mTTL = rEntry.mTTL;
+        lResolution.mExpires = rEntry.mExpires;
+        lResolution.mCached = true;
+        mStatistics.mCacheHits++;
+        lLock.unlock();
+        lCallback(lResolution);
+        return true;
+    }
+    rEntry.mInFlight = true;
+    rEntry.mWaiters.push_back(std::move(lCallback));
+    mQueue.push_back(lHost);
+    lLock.unlock();
+    mQueueCondition.notify_one();
+    return true;
+}
+
+bool RISTNetResolver::resolveAll(const std::vector<std::string> &rHosts, std::vector<Resolution> &rResolutions) {
+    // Shared with the callbacks, the last one may still notify when this returns
+    struct Pending {
+        std::mutex mMtx;
+        std::condition_variable mCondition;
+        size_t mCount = 0;
+    };
+    auto lPending = std::make_shared<Pending>();
+    lPending->mCount = rHosts.size();
+    rResolutions.assign(rHosts.size(), Resolution());
+    for (size_t i = 0; i < rHosts.size(); i++) {
+        Resolution *pResolution = &rResolutions[i];
+        bool lQueued = resolve(rHosts[i], [lPending, pResolution](const Resolution &rResolution) {
+            *pResolution = rResolution;
+            std::lock_guard<std::mutex> lLock(lPending->mMtx);
+            if (!--lPending->mCount) {
+                lPending->mCondition.notify_one();
+            }
+        });
+        if (!lQueued) {
+            pResolution->mHost = rHosts[i];
+            pResolution->mError = "Not resolved.";
+            std::lock_guard<std::mutex> lLock(lPending->mMtx);
+            lPending->mCount--;
+        }
+    }
+    std::unique_lock<std::mutex> lLock(lPending->mMtx);
+    lPending->mCondition.wait(lLock, [&lPending] { return !lPending->mCount; });
+    return std::all_of(rResolutions.begin(), rResolutions.end(),
+                       [](const Resolution &rResolution) { return !rResolution.mAddresses.empty(); });
+}
+
+bool RISTNetResolver::resolveBlocking(const std::string &rHost, Resolution &rResolution) {
+    std::vector<Resolution> lResolutions;
+    bool lResolved = resolveAll({rHost}, lResolutions);
+    rResolution = std::move(lResolutions.front());
+    return lResolved;
+}
+
+uint64_t RISTNetResolver::watch(const std::string &rHost, WatchCallback lCallback) {
+    if (!isAddress(rHost) && !isHostName(rHost)) {
+        LOGGER(true, LOGG_ERROR, "Host name not valid: " << rHost)
+        return 0;
+    }
+    auto lWatch = std::make_shared<Watch>();
+    lWatch->mHost = rHost;
+    lWatch->mCallback = std::move(lCallback);
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        if (!mRun) {
+            LOGGER(true, LOGG_ERROR, "RISTNetResolver not initialised.")
+            return 0;
+        }
+        lWatch->mID = mNextWatchID++;
+        lWatch->mNext = std::chrono::steady_clock::now();
+        mWatches[lWatch->mID] = lWatch;
+    }
+    mWatchCondition.notify_one();
+    return lWatch->mID;
+}
+
+bool RISTNetResolver::unwatch(uint64_t lWatchID) {
+    std::shared_ptr<Watch> lWatch;
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        auto lIterator = mWatches.find(lWatchID);
+        if (lIterator == mWatches.end()) {
+            LOGGER(true, LOGG_ERROR, "Watch " << lWatchID << " not found.")
+            return false;
+        }
+        lWatch = std::move(lIterator->second);
+        mWatches.erase(lIterator);
+        lWatch->mRemoved = true;
+    }
+    // Waits for a callback running
+    std::lock_guard<std::mutex> lLock(lWatch->mCallbackMtx);
+    return true;
+}
+
+void RISTNetResolver::flushCache() {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    for (auto lIterator = mCache.begin(); lIterator != mCache.end();) {
+        lIterator = lIterator->second.mInFlight ? std::next(lIterator) : mCache.erase(lIterator);
+    }
+}
+
+void RISTNetResolver::getStatistics(ResolverStatistics &rStatistics) {
+    std::lock_guard<std::mutex> lLock(mMtx);
+    rStatistics = mStatistics;
+    rStatistics.mCacheEntries = mCache.size();
+    rStatistics.mWatches = mWatches.size();
+}
+
+bool RISTNetResolver::destroyResolver() {
+    if (!mInitialised) {
+        LOGGER(true, LOGG_WARN, "RISTNetResolver not running.")
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        mRun = false;
+    }
+    mQueueCondition.notify_all();
+    mWatchCondition.notify_all();
+    for (auto &rWorker: mWorkers) {
+        rWorker.join();
+    }
+    mWorkers.clear();
+    mWatchThread.join();
+
+    std::vector<std::pair<std::string, ResolveCallback>> lWaiters;
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        for (auto &rEntry: mCache) {
+            for (auto &rWaiter: rEntry.second.mWaiters) {
+                lWaiters.emplace_back(rEntry.first, std::move(rWaiter));
+            }
+        }
+        mCache.clear();
+        mQueue.clear();
+        for (auto &rWatch: mWatches) {
+            rWatch.second->mRemoved = true;
+        }
+        mWatches.clear();
+    }
+    for (auto &rWaiter: lWaiters) {
+        Resolution lResolution;
+        lResolution.mHost = rWaiter.first;
+        lResolution.mError = "Resolver destroyed.";
+        rWaiter.second(lResolution);
+    }
+    mInitialised = false;
+    return true;
+}
+
+void RISTNetResolver::pruneCache(std::chrono::steady_clock::time_point lNow) {
+    for (auto lIterator = mCache.begin(); lIterator != mCache.end();) {
+        bool lExpired = !lIterator->second.mInFlight && lIterator->second.mExpires <= lNow;
+        lIterator = lExpired ? mCache.erase(lIterator) : std::next(lIterator);
+    }
+}
+
+void RISTNetResolver::resolverWorker() {
+    // The answers of the name servers
+    std::vector<uint8_t> lBuffer(65536);
+    std::unique_lock<std::mutex> lLock(mMtx);
+    while (true) {
+        mQueueCondition.wait(lLock, [this] { return !mRun || !mQueue.empty(); });
+        if (!mRun) {
+            break;
+        }
+        std::string lHost = std::move(mQueue.front());
+        mQueue.pop_front();
+        lLock.unlock();
+
+        Resolution lResolution;
+        lResolution.mHost = lHost;
+        lookup(lHost, lResolution, lBuffer);
+        lResolution.mExpires = std::chrono::steady_clock::now() +
+                               (lResolution.mAddresses.empty() ? mSettings.mNegativeTTL : lResolution.mTTL);
+
+        std::vector<ResolveCallback> lWaiters;
+        lLock.lock();
+        mStatistics.mQueries++;
+        if (lResolution.mAddresses.empty()) {
+            mStatistics.mFailures++;
+        }
+        CacheEntry &rEntry = mCache[lHost];
+        rEntry.mAddresses = lResolution.mAddresses;
+        rEntry.mError = lResolution.mError;
+        rEntry.mTTL = lResolution.mTTL;
+        rEntry.mExpires = lResolution.mExpires;
+        rEntry.mValid = true;
+        rEntry.mInFlight = false;
+        lWaiters.swap(rEntry.mWaiters);
+        lLock.unlock();
+        for (auto &rWaiter: lWaiters) {
+            rWaiter(lResolution);
+        }
+        lLock.lock();
+    }
+}
+
+void RISTNetResolver::lookup(const std::string &rHost, Resolution &rResolution, std::vector<uint8_t> &rBuffer) {
+    bool lResolved;
+    if (lookupCallback) {
+        rResolution.mTTL = mSettings.mDefaultTTL;
+        lResolved = lookupCallback(rHost, rResolution.mAddresses, rResolution.mTTL, rResolution.mError);
+    } else if (!mNameServers.empty()) {
+        lResolved = lookupNameServers(rHost, rResolution, rBuffer);
+    } else {
+        lResolved = lookupSystem(rHost, rResolution);
+    }
+    if (!lResolved || rResolution.mAddresses.empty()) {
+        rResolution.mAddresses.clear();
+        if (rResolution.mError.empty()) {
+            rResolution.mError = "No address.";
+        }
+        rResolution.mTTL = mSettings.mNegativeTTL;
+        LOGGER(true, LOGG_WARN, "Resolving " << rHost << " failed: " << rResolution.mError)
+        return;
+    }
+    rResolution.mError.clear();
+    rResolution.mTTL = std::max(mSettings.mMinTTL, std::min(rResolution.mTTL, mSettings.mMaxTTL));
+}
+
+bool RISTNetResolver::lookupSystem(const std::string &rHost, Resolution &rResolution) {
+    addrinfo lHints{};
+    lHints.ai_family = mSettings.mFamily ? mSettings.mFamily : AF_UNSPEC;
+    lHints.ai_socktype = SOCK_DGRAM;
+    addrinfo *pResult = nullptr;
+    int lStatus = getaddrinfo(rHost.c_str(), nullptr, &lHints, &pResult);
+    if (lStatus) {
+        rResolution.mError = gai_strerror(lStatus);
+        return false;
+    }
+    for (addrinfo *pInfo = pResult; pInfo; pInfo = pInfo->ai_next) {
+        char lAddress[INET6_ADDRSTRLEN];
+        const void *pAddress = pInfo->ai_family == AF_INET
+                               ? (const void *) &((const sockaddr_in *) pInfo->ai_addr)->sin_addr
+                               : (const void *) &((const sockaddr_in6 *) pInfo->ai_addr)->sin6_addr;
+        if ((pInfo->ai_family == AF_INET || pInfo->ai_family == AF_INET6) &&
+            inet_ntop(pInfo->ai_family, pAddress, lAddress, sizeof(lAddress)) &&
+            std::find(rResolution.mAddresses.begin(), rResolution.mAddresses.end(), lAddress) ==
+            rResolution.mAddresses.end()) {
+            rResolution.mAddresses.emplace_back(lAddress);
+        }
+    }
+    freeaddrinfo(pResult);
+    // getaddrinfo does not tell the TTL
+    rResolution.mTTL = mSettings.mDefaultTTL;
+    return true;
+}
+
+bool RISTNetResolver::parseNameServer(const std::string &rServer, NameServer &rNameServer) {
+    std::string lAddress = rServer;
+    std::string lPort;
+    if (!lAddress.empty() && lAddress.front() == '[') {
+        size_t lEnd = lAddress.find(']');
+        if (lEnd == std::string::npos) {
+            return false;
+        }
+        if (lEnd + 1 < lAddress.size()) {
+            if (lAddress[lEnd + 1] != ':') {
+                return false;
+            }
+            lPort = lAddress.substr(lEnd + 2);
+        }
+        lAddress = lAddress.substr(1, lEnd - 1);
+    } else if (std::count(lAddress.begin(), lAddress.end(), ':') == 1) {
+        lPort = lAddress.substr(lAddress.find(':') + 1);
+        lAddress = lAddress.substr(0, lAddress.find(':'));
+    }
+    if (!lPort.empty()) {
+        if (lPort.size() > 5 || !std::all_of(lPort.begin(), lPort.end(), ::isdigit) || std::stoi(lPort) < 1 ||
+            std::stoi(lPort) > UINT16_MAX) {
+            return false;
+        }
+        rNameServer.mPort = (uint16_t) std::stoi(lPort);
+    }
+    if (inet_pton(AF_INET, lAddress.c_str(), rNameServer.mAddress) == 1) {
+        rNameServer.mFamily = AF_INET;
+    } else if (inet_pton(AF_INET6, lAddress.c_str(), rNameServer.mAddress) == 1) {
+        rNameServer.mFamily = AF_INET6;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool RISTNetResolver::lookupNameServers(const std::string &rHost, Resolution &rResolution,
+                                        std::vector<uint8_t> &rBuffer) {
+    // The next name server only when one does not answer
+    for (auto &rServer: mNameServers) {
+        rResolution.mAddresses.clear();
+        int lStatus = queryNameServer(rServer, rHost, rResolution, rBuffer);
+        if (lStatus >= 0) {
+            return lStatus == 0;
+        }
+    }
+    rResolution.mError = "No answer from the name servers.";
+    return false;
+}
+
+int RISTNetResolver::queryNameServer(const NameServer &rServer, const std::string &rHost,
+                                     Resolution &rResolution, std::vector<uint8_t> &rBuffer) {
+#ifdef WIN32
+    return -1;
+#else
+    sockaddr_storage lServerAddress{};
+    socklen_t lServerSize;
+    if (rServer.mFamily == AF_INET) {
+        auto *pAddress = (sockaddr_in *) &lServerAddress;
+        pAddress->sin_family = AF_INET;
+        pAddress->sin_port = htons(rServer.mPort);
+        memcpy(&pAddress->sin_addr, rServer.mAddress, 4);
+        lServerSize = sizeof(sockaddr_in);
+    } else {
+        auto *pAddress = (sockaddr_in6 *) &lServerAddress;
+        pAddress->sin6_family = AF_INET6;
+        pAddress->sin6_port = htons(rServer.mPort);
+        memcpy(&pAddress->sin6_addr, rServer.mAddress, 16);
+        lServerSize = sizeof(sockaddr_in6);
+    }
+    int lSocket = socket(rServer.mFamily, SOCK_DGRAM, 0);
+    if (lSocket < 0) {
+        return -1;
+    }
+    // Connected, answers from other sources are not received
+    if (connect(lSocket, (sockaddr *) &lServerAddress, lServerSize)) {
+        close(lSocket);
+        return -1;
+    }
+
+    // The A and AAAA queries in parallel, random IDs
+    thread_local std::mt19937 lRandom(std::random_device{}());
+    struct Query {
+        uint16_t mType;
+        uint16_t mID;
+        bool mAnswered;
+    };
+    std::vector<Query> lQueries;
+    if (mSettings.mFamily != AF_INET6) {
+        lQueries.push_back({kTypeA, (uint16_t) lRandom(), false});
+    }
+    if (mSettings.mFamily != AF_INET) {
+        lQueries.push_back({kTypeAAAA, (uint16_t) lRandom(), false});
+    }
+    std::vector<uint8_t> lQuery;
+    for (auto &rQuery: lQueries) {
+        buildQuery(rQuery.mID, rHost, rQuery.mType, lQuery);
+        if (send(lSocket, lQuery.data(), lQuery.size(), 0) != (ssize_t) lQuery.size()) {
+            close(lSocket);
+            return -1;
+        }
+    }
+
+    // IPv4 first whatever the order of the answers
+    std::vector<std::string> lAddresses[2];
+    uint32_t lTTL = UINT32_MAX;
+    size_t lAnswered = 0;
+    bool lNameError = false;
+    auto lDeadline = std::chrono::steady_clock::now() + mSettings.mQueryTimeout;
+    while (lAnswered < lQueries.size()) {
+        auto lRemaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                lDeadline - std::chrono::steady_clock::now()).count();
+        pollfd lPoll{lSocket, POLLIN, 0};
+        if (lRemaining <= 0 || poll(&lPoll, 1, (int) lRemaining) <= 0) {
+            break;
+        }
+        ssize_t lSize = recv(lSocket, rBuffer.data(), rBuffer.size(), 0);
+        if (lSize < 0) {
+            // Refused, no name server on the port
+            break;
+        }
+        if (lSize < 12 || !(rBuffer[2] & 0x80)) {
+            continue;
+        }
+        uint16_t lID = read16(rBuffer.data());
+        for (size_t i = 0; i < lQueries.size(); i++) {
+            if (lQueries[i].mID != lID || lQueries[i].mAnswered) {
+                continue;
+            }
+            uint8_t lRcode = 0;
+            // A truncated answer is used for the addresses it holds
+            if (parseAnswer(rBuffer.data(), (size_t) lSize, lRcode, lAddresses[lQueries[i].mType == kTypeAAAA],
+                            lTTL)) {
+                lQueries[i].mAnswered = true;
+                lAnswered++;
+                lNameError |= lRcode == kRcodeNameError;
+            }
+        }
+    }
+    close(lSocket);
+    if (!lAnswered) {
+        return -1;
+    }
+    rResolution.mAddresses = std::move(lAddresses[0]);
+    rResolution.mAddresses.insert(rResolution.mAddresses.end(), lAddresses[1].begin(), lAddresses[1].end());
+    if (rResolution.mAddresses.empty()) {
+        rResolution.mError = lNameError ? "Host not found." : "No address.";
+        return 1;
+    }
+    rResolution.mTTL = std::chrono::seconds(lTTL);
+    return 0;
+#endif
+}
+
+void RISTNetResolver::watchWorker() {
+    std::unique_lock<std::mutex> lLock(mMtx);
+    while (mRun) {
+        auto lNow = std::chrono::steady_clock::now();
+        auto lWake = std::chrono::steady_clock::time_point::max();
+        std::vector<std::shared_ptr<Watch>> lDue;
+        for (auto &rWatch: mWatches) {
+            if (rWatch.second->mPending) {
+                continue;
+            }
+            if (rWatch.second->mNext <= lNow) {
+                rWatch.second->mPending = true;
+                lDue.push_back(rWatch.second);
+            } else {
+                lWake = std::min(lWake, rWatch.second->mNext);
+            }
+        }
+        if (!lDue.empty()) {
+            lLock.unlock();
+            for (auto &rWatch: lDue) {
+                // A cached resolution calls back here
+                std::shared_ptr<Watch> lWatch = rWatch;
+                if (!resolve(lWatch->mHost, [this, lWatch](const Resolution &rResolution) {
+                    watchResolved(lWatch, rResolution);
+                })) {
+                    std::lock_guard<std::mutex> lWatchLock(mMtx);
+                    lWatch->mPending = false;
+                    lWatch->mNext = std::chrono::steady_clock::now() + mSettings.mNegativeTTL;
+                }
+            }
+            lLock.lock();
+            continue;
+        }
+        if (lWake == std::chrono::steady_clock::time_point::max()) {
+            mWatchCondition.wait(lLock);
+        } else {
+            mWatchCondition.wait_until(lLock, lWake);
+        }
+    }
+}
+
+void RISTNetResolver::watchResolved(const std::shared_ptr<Watch> &rWatch, const Resolution &rResolution) {
+    std::vector<std::string> lAddresses = rResolution.mAddresses;
+    std::sort(lAddresses.begin(), lAddresses.end());
+    std::vector<std::string> lPrevious;
+    bool lReport = false;
+    {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        rWatch->mPending = false;
+        // Not sooner than mMinTTL or a second, an address literal never again
+        if (isAddress(rWatch->mHost)) {
+            rWatch->mNext = std::chrono::steady_clock::time_point::max();
+        } else {
+            auto lEarliest = std::chrono::steady_clock::now() +
+                             std::max<std::chrono::seconds>(mSettings.mMinTTL, std::chrono::seconds(1));
+            rWatch->mNext = std::max(rResolution.mExpires, lEarliest);
+        }
+        if (rWatch->mRemoved) {
+            return;
+        }
+        if (!lAddresses.empty() && (!rWatch->mReported || lAddresses != rWatch->mAddresses)) {
+            lPrevious = std::move(rWatch->mAddresses);
+            rWatch->mAddresses = lAddresses;
+            if (rWatch->mReported) {
+                mStatistics.mChanges++;
+            }
+            rWatch->mReported = true;
+            lReport = true;
+        }
+    }
+    mWatchCondition.notify_one();
+    if (lReport) {
+        std::lock_guard<std::mutex> lLock(rWatch->mCallbackMtx);
+        if (!rWatch->mRemoved) {
+            rWatch->mCallback(rResolution, lPrevious);
+        }
+    }
+}
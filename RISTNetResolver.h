@@ -0,0 +1,242 @@
+//
+// RISTNetResolver -- Asynchronous host name resolution with a TTL cache, for the URLs of many peers
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+// k constant
+
+#ifndef CPPRISTWRAPPER__RISTNETRESOLVER_H
+#define CPPRISTWRAPPER__RISTNETRESOLVER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * \class RISTNetResolver
+ *
+ * \brief
+ *
+ * A RISTNetResolver resolves host names to numeric addresses on a small pool of threads, so the peers of many
+ * senders and receivers are resolved in parallel instead of one blocking lookup after the other. Results are
+ * cached for their TTL, failures for mNegativeTTL, and concurrent lookups of the same name are coalesced into
+ * one query.
+ *
+ * With mNameServers set the names are queried directly (A and AAAA over UDP) and cached for the TTL of the
+ * answers. Without, the system resolver (getaddrinfo, hosts file included) is used, it does not expose the TTL
+ * and mDefaultTTL applies.
+ *
+ * A watched name is resolved again when its TTL expires and the watcher is called when the addresses change,
+ * to update the peers of a running sender (RISTNetSender::addPeer/removePeer).
+ *
+ */
+class RISTNetResolver {
+public:
+
+    struct RISTNetResolverSettings {
+        size_t mThreads = 4;                                                // The resolver pool
+        int mFamily = 0;                                                    // AF_INET, AF_INET6 or 0 for both
+        std::vector<std::string> mNameServers;                              // "ip" or "ip:port", empty: getaddrinfo
+        std::chrono::milliseconds mQueryTimeout = std::chrono::seconds(2);  // Per name server, with mNameServers
+        std::chrono::seconds mDefaultTTL = std::chrono::seconds(60);        // When the lookup has no TTL (getaddrinfo)
+        std::chrono::seconds mMinTTL = std::chrono::seconds(1);             // The TTL of the answers clamped to
+        std::chrono::seconds mMaxTTL = std::chrono::hours(1);
+        std::chrono::seconds mNegativeTTL = std::chrono::seconds(5);        // Failures cached for
+        size_t mMaxCacheEntries = 10000;                                    // Expired entries dropped above
+    };
+
+    struct Resolution {
+        std::string mHost;
+        std::vector<std::string> mAddresses;    // Numeric, in the order of the answer. Empty on failure.
+        std::string mError;                     // Why it failed
+        std::chrono::seconds mTTL{0};           // 0 for an address literal
+        std::chrono::steady_clock::time_point mExpires = std::chrono::steady_clock::time_point::max();
+        bool mCached = false;                   // Served from the cache
+    };
+
+    struct ResolverStatistics {
+        uint64_t mLookups = 0;                  // Names asked for, literals not counted
+        uint64_t mCacheHits = 0;
+        uint64_t mCoalesced = 0;                // Joined a query in flight
+        uint64_t mQueries = 0;                  // Lookups done by the pool
+        uint64_t mFailures = 0;                 // Of the lookups done
+        uint64_t mChanges = 0;                  // Address changes reported to watchers
+        size_t mCacheEntries = 0;
+        size_t mWatches = 0;
+    };
+
+    /// Called once with the resolution, from a resolver thread or from resolve on a cache hit
+    using ResolveCallback = std::function<void(const Resolution &rResolution)>;
+
+    /// Called with the new resolution and the addresses before (empty the first time)
+    using WatchCallback = std::function<void(const Resolution &rResolution, const std::vector<std::string> &rPrevious)>;
+
+    /// Constructor
+    RISTNetResolver();
+
+    /// Destructor
+    virtual ~RISTNetResolver();
+
+    /// The resolver of RISTNetTools, initialised with the default settings. destroyResolver, initResolver to change.
+    static RISTNetResolver &globalResolver();
+
+    /**
+     * @brief Initialize the resolver
+     *
+     * Starts the resolver threads.
+     *
+     * @param The resolver settings
+     * @return true on success
+     */
+    bool initResolver(RISTNetResolverSettings &rSettings);
+
+    /**
+     * @brief Resolve a name
+     *
+     * Does not block. An address literal or a cached name calls back before returning, else a resolver thread
+     * calls back when the lookup is done.
+     *
+     * @param the host name or address literal
+     * @param the callback, called once
+     * @return false if the name is not valid or the resolver not initialised (a literal is always resolved), the
+     *         callback is then not called
+     */
+    bool resolve(const std::string &rHost, ResolveCallback lCallback);
+
+    /**
+     * @brief Resolve names in parallel
+     *
+     * Blocks until every name is resolved. Not to be called from a resolver callback.
+     *
+     * @param the host names or address literals
+     * @param the resolutions, in the order of the names
+     * @return true if every name resolved to at least one address
+     */
+    bool resolveAll(const std::vector<std::string> &rHosts, std::vector<Resolution> &rResolutions);
+
+    /// Resolve a name and wait for it, see resolveAll
+    bool resolveBlocking(const std::string &rHost, Resolution &rResolution);
+
+    /**
+     * @brief Watch a name
+     *
+     * The name is resolved now and again when the TTL of the last resolution expires. The callback is called
+     * with the first resolution and every time the addresses change, failures keep the last addresses.
+     * The callback is not to call unwatch.
+     *
+     * @param the host name
+     * @param the callback
+     * @return the watch ID, 0 on failure
+     */
+    uint64_t watch(const std::string &rHost, WatchCallback lCallback);
+
+    /// Stop watching, the callback is not called after this returns
+    bool unwatch(uint64_t lWatchID);
+
+    /// Drop the cached names, the lookups in flight are kept
+    void flushCache();
+
+    void getStatistics(ResolverStatistics &rStatistics);
+
+    /**
+     * @brief Destroys the resolver
+     *
+     * Stops the threads, the lookups not done call back with an error. The cache and the watches are dropped.
+     *
+     */
+    bool destroyResolver();
+
+    /// Replaces the lookups of the pool, set before initResolver. rTTL is mDefaultTTL when called (__NULLABLE)
+    std::function<bool(const std::string &rHost, std::vector<std::string> &rAddresses, std::chrono::seconds &rTTL,
+                       std::string &rError)> lookupCallback = nullptr;
+
+    /// True for an IPv4 or IPv6 address literal
+    static bool isAddress(const std::string &rHost);
+
+    /// True for a syntactically valid host name (RFC 1123 labels)
+    static bool isHostName(const std::string &rHost);
+
+    // Delete copy and move constructors and assign operators
+    RISTNetResolver(RISTNetResolver const &) = delete;             // Copy construct
+    RISTNetResolver(RISTNetResolver &&) = delete;                  // Move construct
+    RISTNetResolver &operator=(RISTNetResolver const &) = delete;  // Copy assign
+    RISTNetResolver &operator=(RISTNetResolver &&) = delete;       // Move assign
+
+private:
+
+    struct CacheEntry {
+        std::vector<std::string> mAddresses;
+        std::string mError;
+        std::chrono::seconds mTTL{0};
+        std::chrono::steady_clock::time_point mExpires;
+        bool mValid = false;                    // Resolved at least once
+        bool mInFlight = false;
+        std::vector<ResolveCallback> mWaiters;
+    };
+
+    struct Watch {
+        uint64_t mID = 0;
+        std::string mHost;
+        WatchCallback mCallback;
+        // Held while calling mCallback, taken by unwatch
+        std::mutex mCallbackMtx;
+        std::vector<std::string> mAddresses;    // Sorted, as reported
+        std::chrono::steady_clock::time_point mNext;
+        bool mPending = false;                  // A resolve in flight
+        bool mReported = false;
+        std::atomic<bool> mRemoved{false};
+    };
+
+    struct NameServer {
+        int mFamily = 0;
+        uint8_t mAddress[16] = {};
+        uint16_t mPort = 53;
+    };
+
+    // Done by a pool thread, mMtx not held
+    void lookup(const std::string &rHost, Resolution &rResolution, std::vector<uint8_t> &rBuffer);
+    bool lookupSystem(const std::string &rHost, Resolution &rResolution);
+    bool lookupNameServers(const std::string &rHost, Resolution &rResolution, std::vector<uint8_t> &rBuffer);
+    int queryNameServer(const NameServer &rServer, const std::string &rHost, Resolution &rResolution,
+                        std::vector<uint8_t> &rBuffer);
+    static bool parseNameServer(const std::string &rServer, NameServer &rNameServer);
+
+    void resolverWorker();
+    void watchWorker();
+    void watchResolved(const std::shared_ptr<Watch> &rWatch, const Resolution &rResolution);
+    void pruneCache(std::chrono::steady_clock::time_point lNow);
+
+    RISTNetResolverSettings mSettings;
+    std::vector<NameServer> mNameServers;
+    bool mInitialised = false;
+
+    // The mutex protecting the cache, the queue, the watches and the statistics
+    std::mutex mMtx;
+    std::unordered_map<std::string, CacheEntry> mCache;
+    std::deque<std::string> mQueue;
+    std::condition_variable mQueueCondition;
+    std::vector<std::thread> mWorkers;
+    bool mRun = false;
+
+    std::map<uint64_t, std::shared_ptr<Watch>> mWatches;
+    uint64_t mNextWatchID = 1;
+    std::condition_variable mWatchCondition;
+    std::thread mWatchThread;
+
+    ResolverStatistics mStatistics;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETRESOLVER_H
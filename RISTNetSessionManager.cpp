@@ -0,0 +1,352 @@
+//
+// RISTNetSessionManager -- Many receivers keyed by channel, created on first use and reaped when idle
+//
+
+#include "RISTNetSessionManager.h"
+#include "RISTNetInternal.h"
+
+RISTNetSessionManager::RISTNetSessionManager() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetSessionManager constructed")
+}
+
+RISTNetSessionManager::~RISTNetSessionManager() {
+    if (mInitialised) {
+        destroySessionManager();
+    }
+    LOGGER(false, LOGG_NOTIFY, "RISTNetSessionManager destruct")
+}
+
+bool RISTNetSessionManager::initSessionManager(RISTNetSessionManagerSettings &rSettings) {
+    if (mInitialised) {
+        LOGGER(true, LOGG_ERROR, "RISTNetSessionManager already initialised.")
+        return false;
+    }
+    if (rSettings.mIdleTimeout.count() < 0 || rSettings.mReapInterval.count() < 0) {
+        LOGGER(true, LOGG_ERROR, "Idle timeout or reap interval not valid.")
+        return false;
+    }
+    mSettings = rSettings;
+    mStatistics = SessionManagerStatistics();
+    mInitialised = true;
+    if (mSettings.mReapInterval.count()) {
+        mReaperRun = true;
+        mReaperThread = std::thread(&RISTNetSessionManager::reaperWorker, this);
+    }
+    return true;
+}
+
+bool RISTNetSessionManager::addChannel(uint32_t lChannelID, const std::vector<std::string> &rURLList) {
+    if (!mInitialised) {
+        LOGGER(true, LOGG_ERROR, "RISTNetSessionManager not initialised.")
+        return false;
+    }
+    if (rURLList.empty()) {
+        LOGGER(true, LOGG_ERROR, "URL list is empty.")
+        return false;
+    }
+    auto lChannel = std::make_shared<Channel>();
+    lChannel->mID = lChannelID;
+    lChannel->mURLList = rURLList;
+    std::lock_guard<std::mutex> lLock(mChannelsMtx);
+    if (!mChannels.emplace(lChannelID, std::move(lChannel)).second) {
+        LOGGER(true, LOGG_ERROR, "Channel " << lChannelID << " already added.")
+        return false;
+    }
+    return true;
+}
+
+bool RISTNetSessionManager::removeChannel(uint32_t lChannelID) {
+    std::shared_ptr<Channel> lChannel;
+    {
+        std::lock_guard<std::mutex> lLock(mChannelsMtx);
+        auto lIterator = mChannels.find(lChannelID);
+        if (lIterator == mChannels.end()) {
+            LOGGER(true, LOGG_ERROR, "Channel " << lChannelID << " not found.")
+            return false;
+        }
+        lChannel = std::move(lIterator->second);
+        mChannels.erase(lIterator);
+    }
+    std::lock_guard<std::mutex> lLock(lChannel->mMtx);
+    lChannel->mRemoved = true;
+    destroyReceiver(*lChannel);
+    return true;
+}
+
+bool RISTNetSessionManager::activateChannel(uint32_t lChannelID) {
+    auto lChannel = findChannel(lChannelID);
+    if (!lChannel) {
+        LOGGER(true, LOGG_ERROR, "Channel " << lChannelID << " not found.")
+        return false;
+    }
+    lChannel->mLastUse.store(toNs(std::chrono::steady_clock::now()), std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lLock(lChannel->mMtx);
+    if (lChannel->mReceiver) {
+        return true;
+    }
+    if (lChannel->mRemoved) {
+        return false;
+    }
+    return createReceiver(lChannel);
+}
+
+bool RISTNetSessionManager::deactivateChannel(uint32_t lChannelID) {
+    auto lChannel = findChannel(lChannelID);
+    if (!lChannel) {
+        LOGGER(true, LOGG_ERROR, "Channel " << lChannelID << " not found.")
+        return false;
+    }
+    std::lock_guard<std::mutex> lLock(lChannel->mMtx);
+    if (!lChannel->mReceiver) {
+        return false;
+    }
+    destroyReceiver(*lChannel);
+    return true;
+}
+
+bool RISTNetSessionManager::isActive(uint32_t lChannelID) {
+    auto lChannel = findChannel(lChannelID);
+    if (!lChannel) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lLock(lChannel->mMtx);
+    return lChannel->mReceiver != nullptr;
+}
+
+std::shared_ptr<RISTNetSessionManager::Channel> RISTNetSessionManager::findChannel(uint32_t lChannelID) {
+    std::lock_guard<std::mutex> lLock(mChannelsMtx);
+    auto lIterator = mChannels.find(lChannelID);
+    return lIterator != mChannels.end() ? lIterator->second : nullptr;
+}
+
+bool RISTNetSessionManager::createReceiver(const std::shared_ptr<Channel> &rChannel) {
+    auto lReceiver = std::make_unique<RISTNetReceiver>();
+    // The channel outlives its receiver
+    Channel *pChannel = rChannel.get();
+    lReceiver->validateConnectionCallback = [this, pChannel](std::string lIPAddress, uint16_t lPort)
+            -> std::shared_ptr<RISTNetReceiver::NetworkConnection> {
+        if (!validateConnectionCallback) {
+            LOGGER(true, LOGG_ERROR, "validateConnectionCallback not implemented. Will not accept connection from: "
+                    << lIPAddress << ":" << unsigned(lPort))
+            return nullptr;
+        }
+        return validateConnectionCallback(pChannel->mID, lIPAddress, lPort);
+    };
+    lReceiver->networkDataCallback = [this, pChannel](const uint8_t *pBuf, size_t lSize,
+                                                      std::shared_ptr<RISTNetReceiver::NetworkConnection> &rConnection,
+                                                      rist_peer *pPeer, uint16_t lConnectionID) {
+        pChannel->mPackets.fetch_add(1, std::memory_order_relaxed);
+        pChannel->mBytes.fetch_add(lSize, std::memory_order_relaxed);
+        if (channelDataCallback) {
+            return channelDataCallback(pChannel->mID, pBuf, lSize, rConnection, pPeer, lConnectionID);
+        }
+        return 0;
+    };
+    lReceiver->statisticsCallback = [pChannel](const rist_stats &rStatistics) {
+        std::lock_guard<std::mutex> lLock(pChannel->mStatisticsMtx);
+        pChannel->mStatistics = rStatistics;
+        pChannel->mStatistics.stats_json = nullptr;
+        pChannel->mStatisticsFresh = true;
+    };
+
+    RISTNetReceiver::RISTNetReceiverSettings lSettings;
+    if (configureCallback) {
+        configureCallback(pChannel->mID, lSettings);
+    }
+    bool lInitialised = initCallback ? initCallback(pChannel->mID, *lReceiver, pChannel->mURLList, lSettings)
+                                     : lReceiver->initReceiver(pChannel->mURLList, lSettings);
+    if (!lInitialised) {
+        LOGGER(true, LOGG_ERROR, "Channel " << pChannel->mID << " receiver init failed.")
+        std::lock_guard<std::mutex> lLock(mChannelsMtx);
+        mStatistics.mCreateFailures++;
+        return false;
+    }
+    pChannel->mReceiver = std::move(lReceiver);
+    pChannel->mCreated = toNs(std::chrono::steady_clock::now());
+    pChannel->mCreations++;
+    std::lock_guard<std::mutex> lLock(mChannelsMtx);
+    pChannel->mActiveIndex = mActive.size();
+    mActive.push_back(rChannel);
+    mStatistics.mCreated++;
+    return true;
+}
+
+void RISTNetSessionManager::destroyReceiver(Channel &rChannel) {
+    if (!rChannel.mReceiver) {
+        return;
+    }
+    rChannel.mReceiver->destroyReceiver();
+    rChannel.mReceiver.reset();
+    {
+        std::lock_guard<std::mutex> lLock(rChannel.mStatisticsMtx);
+        rChannel.mStatisticsFresh = false;
+    }
+    std::lock_guard<std::mutex> lLock(mChannelsMtx);
+    size_t lIndex = rChannel.mActiveIndex;
+    if (lIndex != mActive.size() - 1) {
+        mActive[lIndex] = std::move(mActive.back());
+        mActive[lIndex]->mActiveIndex = lIndex;
+    }
+    mActive.pop_back();
+}
+
+void RISTNetSessionManager::reapIdle(std::chrono::steady_clock::time_point lNow) {
+    std::lock_guard<std::mutex> lReapLock(mReapMtx);
+    {
+        std::lock_guard<std::mutex> lLock(mChannelsMtx);
+        mReapActive = mActive;
+    }
+    int64_t lNowNs = toNs(lNow);
+    int64_t lTimeoutNs = std::chrono::duration_cast<std::chrono::nanoseconds>(mSettings.mIdleTimeout).count();
+    mReapStatistics.clear();
+    for (auto &rChannel: mReapActive) {
+        // Data since the last pass is a use
+        uint64_t lPackets = rChannel->mPackets.load(std::memory_order_relaxed);
+        if (lPackets != rChannel->mSeenPackets) {
+            rChannel->mSeenPackets = lPackets;
+            rChannel->mLastUse.store(lNowNs, std::memory_order_relaxed);
+        }
+        {
+            std::lock_guard<std::mutex> lLock(rChannel->mStatisticsMtx);
+            if (rChannel->mStatisticsFresh) {
+                mReapStatistics.push_back({rChannel->mID, rChannel->mStatistics});
+                rChannel->mStatisticsFresh = false;
+            }
+        }
+        if (!lTimeoutNs || lNowNs - rChannel->mLastUse.load(std::memory_order_relaxed) < lTimeoutNs) {
+            continue;
+        }
+        // Busy being created or destroyed, the next pass
+        std::unique_lock<std::mutex> lLock(rChannel->mMtx, std::try_to_lock);
+        if (!lLock.owns_lock()) {
+            continue;
+        }
+        // Checked again, activateChannel may have used it since
+        if (!rChannel->mReceiver || lNowNs - rChannel->mLastUse.load(std::memory_order_relaxed) < lTimeoutNs ||
+            rChannel->mPackets.load(std::memory_order_relaxed) != rChannel->mSeenPackets) {
+            continue;
+        }
+        destroyReceiver(*rChannel);
+        LOGGER(false, LOGG_NOTIFY, "Channel " << rChannel->mID << " idle, receiver destroyed.")
+        std::lock_guard<std::mutex> lStatisticsLock(mChannelsMtx);
+        mStatistics.mReaped++;
+    }
+    // Not keeping the channels removed alive
+    mReapActive.clear();
+
+    if (!mReapStatistics.empty() && statisticsCallback) {
+        statisticsCallback(mReapStatistics);
+        std::lock_guard<std::mutex> lLock(mChannelsMtx);
+        mStatistics.mStatisticsBatches++;
+    }
+}
+
+void RISTNetSessionManager::fillCost(Channel &rChannel, SessionCost &rCost, int64_t lNowNs) {
+    std::lock_guard<std::mutex> lLock(rChannel.mMtx);
+    rCost = SessionCost();
+    rCost.mChannelID = rChannel.mID;
+    rCost.mActive = rChannel.mReceiver != nullptr;
+    rCost.mPeers = rChannel.mURLList.size();
+    rCost.mPackets = rChannel.mPackets.load(std::memory_order_relaxed);
+    rCost.mBytes = rChannel.mBytes.load(std::memory_order_relaxed);
+    rCost.mCreations = rChannel.mCreations;
+    int64_t lLastUse = rChannel.mLastUse.load(std::memory_order_relaxed);
+    if (lLastUse && lNowNs > lLastUse) {
+        rCost.mIdle = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::nanoseconds(lNowNs - lLastUse));
+    }
+    if (rChannel.mReceiver) {
+        RISTNetMemoryGovernor::SessionUsage lUsage;
+        if (rChannel.mReceiver->getMemoryUsage(lUsage)) {
+            rCost.mRecoveryBytes = lUsage.mRecoveryGranted;
+            rCost.mQueueBytes = lUsage.mQueueUsed;
+        }
+        rCost.mUptime = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::nanoseconds(std::max<int64_t>(lNowNs - rChannel.mCreated, 0)));
+    }
+}
+
+bool RISTNetSessionManager::getSessionCost(uint32_t lChannelID, SessionCost &rCost) {
+    auto lChannel = findChannel(lChannelID);
+    if (!lChannel) {
+        return false;
+    }
+    fillCost(*lChannel, rCost, toNs(std::chrono::steady_clock::now()));
+    return true;
+}
+
+void RISTNetSessionManager::getSessionCosts(std::vector<SessionCost> &rCosts) {
+    std::vector<std::shared_ptr<Channel>> lChannels;
+    {
+        std::lock_guard<std::mutex> lLock(mChannelsMtx);
+        lChannels.reserve(mChannels.size());
+        for (auto &rChannel: mChannels) {
+            lChannels.push_back(rChannel.second);
+        }
+    }
+    int64_t lNowNs = toNs(std::chrono::steady_clock::now());
+    rCosts.resize(lChannels.size());
+    for (size_t i = 0; i < lChannels.size(); i++) {
+        fillCost(*lChannels[i], rCosts[i], lNowNs);
+    }
+}
+
+void RISTNetSessionManager::getChannelStatistics(std::vector<ChannelStatistics> &rStatistics) {
+    std::vector<std::shared_ptr<Channel>> lActive;
+    {
+        std::lock_guard<std::mutex> lLock(mChannelsMtx);
+        lActive = mActive;
+    }
+    rStatistics.resize(lActive.size());
+    for (size_t i = 0; i < lActive.size(); i++) {
+        std::lock_guard<std::mutex> lLock(lActive[i]->mStatisticsMtx);
+        rStatistics[i].mChannelID = lActive[i]->mID;
+        rStatistics[i].mStatistics = lActive[i]->mStatistics;
+    }
+}
+
+void RISTNetSessionManager::getStatistics(SessionManagerStatistics &rStatistics) {
+    std::lock_guard<std::mutex> lLock(mChannelsMtx);
+    rStatistics = mStatistics;
+    rStatistics.mChannels = mChannels.size();
+    rStatistics.mActive = mActive.size();
+}
+
+bool RISTNetSessionManager::destroySessionManager() {
+    if (!mInitialised) {
+        LOGGER(true, LOGG_WARN, "RISTNetSessionManager not initialised.")
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lLock(mChannelsMtx);
+        mReaperRun = false;
+    }
+    mReaperCondition.notify_one();
+    if (mReaperThread.joinable()) {
+        mReaperThread.join();
+    }
+    std::unordered_map<uint32_t, std::shared_ptr<Channel>> lChannels;
+    {
+        std::lock_guard<std::mutex> lLock(mChannelsMtx);
+        lChannels.swap(mChannels);
+    }
+    for (auto &rChannel: lChannels) {
+        std::lock_guard<std::mutex> lLock(rChannel.second->mMtx);
+        rChannel.second->mRemoved = true;
+        destroyReceiver(*rChannel.second);
+    }
+    mInitialised = false;
+    return true;
+}
+
+void RISTNetSessionManager::reaperWorker() {
+    std::unique_lock<std::mutex> lLock(mChannelsMtx);
+    while (mReaperRun) {
+        mReaperCondition.wait_for(lLock, mSettings.mReapInterval);
+        if (!mReaperRun) {
+            break;
+        }
+        lLock.unlock();
+        reapIdle();
+        lLock.lock();
+    }
+}
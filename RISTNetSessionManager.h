@@ -0,0 +1,220 @@
+//
+// RISTNetSessionManager -- Many receivers keyed by channel, created on first use and reaped when idle
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+// k constant
+
+#ifndef CPPRISTWRAPPER__RISTNETSESSIONMANAGER_H
+#define CPPRISTWRAPPER__RISTNETSESSIONMANAGER_H
+
+#include "RISTNet.h"
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * \class RISTNetSessionManager
+ *
+ * \brief
+ *
+ * A RISTNetSessionManager owns the receivers of many channels. A channel added is only its configuration, the
+ * receiver (librist context, sockets, threads and buffers) is created by the first activateChannel and destroyed
+ * again when no data arrived and no activateChannel was called for mIdleTimeout. Lookups are O(1), a reap pass
+ * visits the active channels only, so thousands of channels configured cost little more than their URLs.
+ * The statistics of the active receivers are collected by the reaper and handed over in one batch per pass.
+ *
+ */
+class RISTNetSessionManager {
+public:
+
+    struct RISTNetSessionManagerSettings {
+        std::chrono::milliseconds mIdleTimeout = std::chrono::seconds(30);  // Idle receivers are destroyed, 0 never
+        std::chrono::milliseconds mReapInterval = std::chrono::seconds(1);  // Reaper thread period, 0 no thread
+    };
+
+    struct SessionCost {
+        uint32_t mChannelID = 0;
+        bool mActive = false;                   // The receiver exists
+        size_t mPeers = 0;                      // URLs, a socket each when active
+        size_t mRecoveryBytes = 0;              // Granted by the memory governor, when active
+        size_t mQueueBytes = 0;                 // Event queue use, when active
+        uint64_t mPackets = 0;                  // Received, all activations
+        uint64_t mBytes = 0;
+        uint64_t mCreations = 0;                // Receivers created
+        std::chrono::milliseconds mIdle{0};     // Since the last data (seen by a reap pass) or activateChannel
+        std::chrono::milliseconds mUptime{0};   // Of the receiver, when active
+    };
+
+    struct ChannelStatistics {
+        uint32_t mChannelID = 0;
+        rist_stats mStatistics{};               // The last of the receiver, stats_json is nullptr
+    };
+
+    struct SessionManagerStatistics {
+        size_t mChannels = 0;
+        size_t mActive = 0;
+        uint64_t mCreated = 0;                  // Receivers created
+        uint64_t mReaped = 0;                   // Receivers destroyed when idle
+        uint64_t mCreateFailures = 0;
+        uint64_t mStatisticsBatches = 0;        // statisticsCallback calls
+    };
+
+    /// Constructor
+    RISTNetSessionManager();
+
+    /// Destructor
+    virtual ~RISTNetSessionManager();
+
+    /**
+     * @brief Initialize the manager
+     *
+     * Starts the reaper thread if mReapInterval is set.
+     *
+     * @param The manager settings
+     * @return true on success
+     */
+    bool initSessionManager(RISTNetSessionManagerSettings &rSettings);
+
+    /**
+     * @brief Add a channel
+     *
+     * Only the configuration is kept, no receiver is created.
+     *
+     * @param the channel
+     * @param the RIST URLs of the receiver
+     * @return false if the channel exists
+     */
+    bool addChannel(uint32_t lChannelID, const std::vector<std::string> &rURLList);
+
+    /// Remove a channel, its receiver is destroyed
+    bool removeChannel(uint32_t lChannelID);
+
+    /**
+     * @brief Use a channel
+     *
+     * Creates the receiver if not active, else marks the channel used. Not to be called from the callbacks.
+     *
+     * @param the channel
+     * @return true if the receiver is active
+     */
+    bool activateChannel(uint32_t lChannelID);
+
+    /// Destroy the receiver of a channel now, the channel is kept
+    bool deactivateChannel(uint32_t lChannelID);
+
+    /// True if the receiver of the channel exists
+    bool isActive(uint32_t lChannelID);
+
+    /**
+     * @brief Reap the idle receivers and collect the statistics
+     *
+     * Called by the reaper thread every mReapInterval, or by the owner when mReapInterval is 0.
+     * O(active channels).
+     *
+     * @param the time, now
+     */
+    void reapIdle(std::chrono::steady_clock::time_point lNow = std::chrono::steady_clock::now());
+
+    /// The resources of a channel, false if not added
+    bool getSessionCost(uint32_t lChannelID, SessionCost &rCost);
+
+    /// The resources of every channel
+    void getSessionCosts(std::vector<SessionCost> &rCosts);
+
+    /// The last statistics of every active receiver
+    void getChannelStatistics(std::vector<ChannelStatistics> &rStatistics);
+
+    void getStatistics(SessionManagerStatistics &rStatistics);
+
+    /**
+     * @brief Destroys the manager
+     *
+     * Stops the reaper thread, destroys the receivers and removes the channels.
+     *
+     */
+    bool destroySessionManager();
+
+    /// Fills the settings of a receiver created for a channel (__NULLABLE)
+    std::function<void(uint32_t lChannelID, RISTNetReceiver::RISTNetReceiverSettings &rSettings)>
+        configureCallback = nullptr;
+
+    /// Initialises a receiver created for a channel, nullptr calls initReceiver. A test seam for RISTNetMockTransport.
+    std::function<bool(uint32_t lChannelID, RISTNetReceiver &rReceiver, std::vector<std::string> &rURLList,
+                       RISTNetReceiver::RISTNetReceiverSettings &rSettings)> initCallback = nullptr;
+
+    /// The data of the channels, from the librist threads
+    std::function<int(uint32_t lChannelID, const uint8_t *pBuf, size_t lSize,
+                      std::shared_ptr<RISTNetReceiver::NetworkConnection> &rConnection, rist_peer *pPeer,
+                      uint16_t lConnectionID)> channelDataCallback = nullptr;
+
+    /// Validates the connections of the channels, nullptr rejects them
+    std::function<std::shared_ptr<RISTNetReceiver::NetworkConnection>(uint32_t lChannelID, std::string lIPAddress,
+                                                                      uint16_t lPort)> validateConnectionCallback = nullptr;
+
+    /// The statistics the receivers reported since the last reap pass, once per pass (__NULLABLE)
+    std::function<void(const std::vector<ChannelStatistics> &rStatistics)> statisticsCallback = nullptr;
+
+    // Delete copy and move constructors and assign operators
+    RISTNetSessionManager(RISTNetSessionManager const &) = delete;             // Copy construct
+    RISTNetSessionManager(RISTNetSessionManager &&) = delete;                  // Move construct
+    RISTNetSessionManager &operator=(RISTNetSessionManager const &) = delete;  // Copy assign
+    RISTNetSessionManager &operator=(RISTNetSessionManager &&) = delete;       // Move assign
+
+private:
+
+    struct Channel {
+        uint32_t mID = 0;
+        std::vector<std::string> mURLList;
+        // Protects the receiver, taken before mChannelsMtx
+        std::mutex mMtx;
+        std::unique_ptr<RISTNetReceiver> mReceiver;
+        bool mRemoved = false;
+        size_t mActiveIndex = 0;                // In mActive, under mChannelsMtx
+        int64_t mCreated = 0;                   // ns, steady clock
+        uint64_t mCreations = 0;
+        std::atomic<int64_t> mLastUse{0};       // ns, steady clock
+        std::atomic<uint64_t> mPackets{0};
+        std::atomic<uint64_t> mBytes{0};
+        uint64_t mSeenPackets = 0;              // By the reaper
+        std::mutex mStatisticsMtx;
+        rist_stats mStatistics{};
+        bool mStatisticsFresh = false;
+    };
+
+    std::shared_ptr<Channel> findChannel(uint32_t lChannelID);
+    // Creates and destroys the receiver, mMtx of the channel held
+    bool createReceiver(const std::shared_ptr<Channel> &rChannel);
+    void destroyReceiver(Channel &rChannel);
+    void fillCost(Channel &rChannel, SessionCost &rCost, int64_t lNowNs);
+    void reaperWorker();
+
+    static int64_t toNs(std::chrono::steady_clock::time_point lTime) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(lTime.time_since_epoch()).count();
+    }
+
+    RISTNetSessionManagerSettings mSettings;
+    bool mInitialised = false;
+
+    // The mutex protecting the channels, the active list and the statistics
+    std::mutex mChannelsMtx;
+    std::unordered_map<uint32_t, std::shared_ptr<Channel>> mChannels;
+    std::vector<std::shared_ptr<Channel>> mActive;
+    SessionManagerStatistics mStatistics;
+
+    // Used by reapIdle only
+    std::mutex mReapMtx;
+    std::vector<std::shared_ptr<Channel>> mReapActive;
+    std::vector<ChannelStatistics> mReapStatistics;
+
+    std::condition_variable mReaperCondition;
+    std::thread mReaperThread;
+    bool mReaperRun = false;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETSESSIONMANAGER_H
@@ -0,0 +1,192 @@
+//
+// RISTNetShmReader -- Consumer of the shared memory ring of a RISTNetShmSink, for local downstream processes
+//
+
+#include "RISTNetShmReader.h"
+#include "RISTNetInternal.h"
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+RISTNetShmReader::RISTNetShmReader() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetShmReader constructed")
+}
+
+RISTNetShmReader::~RISTNetShmReader() {
+    if (pRing) {
+        closeReader();
+    }
+    LOGGER(false, LOGG_NOTIFY, "RISTNetShmReader destruct")
+}
+
+bool RISTNetShmReader::openReader(RISTNetShmReaderSettings &rSettings) {
+    if (pRing) {
+        LOGGER(true, LOGG_ERROR, "RISTNetShmReader already open.")
+        return false;
+    }
+    int lFd = shm_open(rSettings.mName.c_str(), O_RDWR, 0);
+    if (lFd < 0) {
+        LOGGER(true, LOGG_ERROR, "shm_open failed: " << rSettings.mName << " " << strerror(errno))
+        return false;
+    }
+    struct stat lStat{};
+    if (fstat(lFd, &lStat) || (size_t) lStat.st_size < sizeof(RISTNetShmRing)) {
+        LOGGER(true, LOGG_ERROR, "Shared memory ring not ready: " << rSettings.mName)
+        close(lFd);
+        return false;
+    }
+    void *pMemory = mmap(nullptr, (size_t) lStat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, lFd, 0);
+    close(lFd);
+    if (pMemory == MAP_FAILED) {
+        LOGGER(true, LOGG_ERROR, "mmap failed: " << strerror(errno))
+        return false;
+    }
+    auto *pMapped = static_cast<RISTNetShmRing *>(pMemory);
+    if (pMapped->mMagic.load(std::memory_order_acquire) != RISTNetShmRing::kMagic ||
+        pMapped->mVersion != RISTNetShmRing::kVersion ||
+        RISTNetShmRing::size(pMapped->mSlots, pMapped->mSlotStride) > (size_t) lStat.st_size ||
+        pMapped->mClosed.load(std::memory_order_acquire)) {
+        LOGGER(true, LOGG_ERROR, "Shared memory ring not ready: " << rSettings.mName)
+        munmap(pMemory, (size_t) lStat.st_size);
+        return false;
+    }
+
+    // A consumer slot, claimed with the pid so the producer can release it if we die before it is active
+    auto lPid = (int32_t) getpid();
+    RISTNetShmRing::Consumer *pFree = nullptr;
+    for (auto &rConsumer: pMapped->mConsumers) {
+        uint64_t lFree = RISTNetShmRing::owner(RISTNetShmRing::kFree, 0);
+        if (rConsumer.mOwner.compare_exchange_strong(lFree, RISTNetShmRing::owner(RISTNetShmRing::kClaimed, lPid))) {
+            pFree = &rConsumer;
+            break;
+        }
+    }
+    if (!pFree) {
+        LOGGER(true, LOGG_ERROR, "All " << RISTNetShmRing::kMaxConsumers << " consumers of the ring in use.")
+        munmap(pMemory, (size_t) lStat.st_size);
+        return false;
+    }
+    uint64_t lCursor = pMapped->mCursor.load(std::memory_order_acquire);
+    mNext = lCursor;
+    if (rSettings.mFromOldest) {
+        mNext = lCursor > pMapped->mSlots ? lCursor - pMapped->mSlots + 1 : 0;
+    }
+    pFree->mSequence.store(mNext, std::memory_order_relaxed);
+    pFree->mRead.store(0, std::memory_order_relaxed);
+    pFree->mLapped.store(0, std::memory_order_relaxed);
+    pFree->mOwner.store(RISTNetShmRing::owner(RISTNetShmRing::kActive, lPid), std::memory_order_release);
+
+    pRing = pMapped;
+    mMappedSize = (size_t) lStat.st_size;
+    pConsumer = pFree;
+    mRead = 0;
+    mLapped = 0;
+    return true;
+}
+
+int RISTNetShmReader::readPacket(uint8_t *pBuf, size_t lSize, uint16_t &rConnectionID,
+                                 std::chrono::milliseconds lTimeout) {
+    if (!pRing) {
+        LOGGER(true, LOGG_ERROR, "RISTNetShmReader not open.")
+        return -1;
+    }
+    auto lDeadline = std::chrono::steady_clock::now() + lTimeout;
+    while (true) {
+        uint64_t lCursor = pRing->mCursor.load(std::memory_order_acquire);
+        if (mNext >= lCursor) {
+            if (pRing->mClosed.load(std::memory_order_acquire)) {
+                return -1;
+            }
+            if (lTimeout.count() <= 0 || std::chrono::steady_clock::now() >= lDeadline) {
+                return 0;
+            }
+            waitForData(lDeadline);
+            continue;
+        }
+        if (lCursor - mNext > pRing->mSlots) {
+            lapped(lCursor);
+            continue;
+        }
+
+        // The seqlock, the payload is only valid if the slot still holds mNext after the copy
+        RISTNetShmRing::SlotHeader *pSlot = pRing->slot(mNext);
+        if (pSlot->mSequence.load(std::memory_order_acquire) != mNext) {
+            lapped(pRing->mCursor.load(std::memory_order_acquire));
+            continue;
+        }
+        size_t lPacketSize = std::min<size_t>(pSlot->mSize.load(std::memory_order_relaxed), pRing->mSlotSize);
+        uint16_t lConnectionID = pSlot->mConnectionID.load(std::memory_order_relaxed);
+        size_t lCopy = std::min(lPacketSize, lSize);
+        memcpy(pBuf, RISTNetShmRing::payload(pSlot), lCopy);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (pSlot->mSequence.load(std::memory_order_relaxed) != mNext) {
+            lapped(pRing->mCursor.load(std::memory_order_acquire));
+            continue;
+        }
+
+        mNext++;
+        mRead++;
+        pConsumer->mSequence.store(mNext, std::memory_order_release);
+        pConsumer->mRead.store(mRead, std::memory_order_relaxed);
+        rConnectionID = lConnectionID;
+        return (int) lCopy;
+    }
+}
+
+void RISTNetShmReader::lapped(uint64_t lCursor) {
+    // Half a ring behind, room to catch up before the producer laps again
+    uint64_t lResume = lCursor > pRing->mSlots / 2 ? lCursor - pRing->mSlots / 2 : 0;
+    if (lResume <= mNext) {
+        lResume = lCursor;
+    }
+    mLapped += lResume - mNext;
+    mNext = lResume;
+    pConsumer->mSequence.store(mNext, std::memory_order_release);
+    pConsumer->mLapped.store(mLapped, std::memory_order_relaxed);
+}
+
+void RISTNetShmReader::waitForData(std::chrono::steady_clock::time_point lDeadline) {
+    // Announced before checking the cursor again, the producer reads mWaiters after publishing
+    uint32_t lWakeup = pRing->mWakeup.load(std::memory_order_acquire);
+    pRing->mWaiters.fetch_add(1, std::memory_order_seq_cst);
+    if (pRing->mCursor.load(std::memory_order_seq_cst) <= mNext && !pRing->mClosed.load(std::memory_order_acquire)) {
+        auto lRemaining = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                lDeadline - std::chrono::steady_clock::now()).count();
+        if (lRemaining > 0) {
+            timespec lTimeout{(time_t) (lRemaining / 1000000000), (long) (lRemaining % 1000000000)};
+            // Shared, the producer is another process
+            syscall(SYS_futex, &pRing->mWakeup, FUTEX_WAIT, lWakeup, &lTimeout, nullptr, 0);
+        }
+    }
+    pRing->mWaiters.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+size_t RISTNetShmReader::getSlotSize() const {
+    return pRing ? pRing->mSlotSize : 0;
+}
+
+void RISTNetShmReader::getStatistics(ShmReaderStatistics &rStatistics) {
+    rStatistics.mRead = mRead;
+    rStatistics.mLapped = mLapped;
+    uint64_t lCursor = pRing ? pRing->mCursor.load(std::memory_order_acquire) : 0;
+    rStatistics.mLag = lCursor > mNext ? lCursor - mNext : 0;
+}
+
+bool RISTNetShmReader::closeReader() {
+    if (!pRing) {
+        LOGGER(true, LOGG_WARN, "RISTNetShmReader not open.")
+        return true;
+    }
+    pConsumer->mOwner.store(RISTNetShmRing::owner(RISTNetShmRing::kFree, 0), std::memory_order_release);
+    munmap(pRing, mMappedSize);
+    pRing = nullptr;
+    pConsumer = nullptr;
+    mMappedSize = 0;
+    return true;
+}
@@ -0,0 +1,181 @@
+//
+// RISTNetShmReader -- Consumer of the shared memory ring of a RISTNetShmSink, for local downstream processes
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+// k constant
+
+#ifndef CPPRISTWRAPPER__RISTNETSHMREADER_H
+#define CPPRISTWRAPPER__RISTNETSHMREADER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * \struct RISTNetShmRing
+ *
+ * \brief
+ *
+ * The layout of the shared memory ring written by a RISTNetShmSink and read by RISTNetShmReaders, the header
+ * followed by mSlots slots of mSlotStride bytes. Sequence n is in slot n % mSlots. A seqlock per slot: the slot
+ * sequence is kWriting while the producer writes it, a reader copies the payload and checks the sequence again.
+ *
+ */
+struct RISTNetShmRing {
+    static constexpr uint32_t kMagic = 0x4d485352;      // "RSHM"
+    static constexpr uint32_t kVersion = 2;
+    static constexpr size_t kMaxConsumers = 64;
+    static constexpr uint64_t kWriting = UINT64_MAX;
+
+    // The consumer states
+    static constexpr uint32_t kFree = 0;
+    static constexpr uint32_t kClaimed = 1;             // Being set up by the reader
+    static constexpr uint32_t kActive = 2;
+
+    // A reader, written by the reader only, reclaimed by the producer when its process is gone
+    struct alignas(64) Consumer {
+        std::atomic<uint64_t> mOwner;                   // The state and the pid, claimed in one CAS
+        std::atomic<uint64_t> mSequence;                // The next to read
+        std::atomic<uint64_t> mRead;
+        std::atomic<uint64_t> mLapped;                  // Packets overwritten before read
+    };
+
+    struct SlotHeader {
+        std::atomic<uint64_t> mSequence;                // Of the packet held, kWriting while written
+        std::atomic<uint32_t> mSize;
+        std::atomic<uint16_t> mConnectionID;
+        uint16_t mReserved;
+    };
+
+    std::atomic<uint32_t> mMagic;                       // Set last by the producer
+    uint32_t mVersion;
+    uint32_t mSlots;                                    // A power of two
+    uint32_t mSlotSize;                                 // Max payload
+    uint32_t mSlotStride;
+    std::atomic<uint32_t> mClosed;                      // Set by destroyShmSink
+
+    alignas(64) std::atomic<uint64_t> mCursor;          // Sequences published
+    alignas(64) std::atomic<uint32_t> mWakeup;          // Futex, changed when waiters are woken
+    std::atomic<uint32_t> mWaiters;
+    alignas(64) Consumer mConsumers[kMaxConsumers];
+
+    static uint64_t owner(uint32_t lState, int32_t lPid) {
+        return (uint64_t) (uint32_t) lPid << 32 | lState;
+    }
+
+    static uint32_t state(uint64_t lOwner) {
+        return (uint32_t) lOwner;
+    }
+
+    static int32_t pid(uint64_t lOwner) {
+        return (int32_t) (lOwner >> 32);
+    }
+
+    static size_t size(uint32_t lSlots, uint32_t lSlotStride) {
+        return sizeof(RISTNetShmRing) + (size_t) lSlots * lSlotStride;
+    }
+
+    SlotHeader *slot(uint64_t lSequence) {
+        return reinterpret_cast<SlotHeader *>(reinterpret_cast<uint8_t *>(this) + sizeof(RISTNetShmRing) +
+                                              (size_t) (lSequence & (mSlots - 1)) * mSlotStride);
+    }
+
+    static uint8_t *payload(SlotHeader *pSlot) {
+        return reinterpret_cast<uint8_t *>(pSlot) + sizeof(SlotHeader);
+    }
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The ring needs address free 64 bit atomics");
+
+/**
+ * \class RISTNetShmReader
+ *
+ * \brief
+ *
+ * A RISTNetShmReader reads the packets a RISTNetShmSink publishes, with its own cursor. It does not slow the
+ * producer down: a reader more than the ring behind is lapped, the packets overwritten are counted and reading
+ * resumes half a ring behind the producer. A reader only maps the ring: no librist context, sockets or threads.
+ *
+ * One thread at a time per reader.
+ *
+ */
+class RISTNetShmReader {
+public:
+
+    struct RISTNetShmReaderSettings {
+        std::string mName = "/ristnet";     // The mName of the sink
+        bool mFromOldest = false;           // Start with the packets in the ring, else with the next published
+    };
+
+    struct ShmReaderStatistics {
+        uint64_t mRead = 0;
+        uint64_t mLapped = 0;               // Packets overwritten before read
+        uint64_t mLag = 0;                  // Packets published and not read
+    };
+
+    /// Constructor
+    RISTNetShmReader();
+
+    /// Destructor
+    virtual ~RISTNetShmReader();
+
+    /**
+     * @brief Open the ring
+     *
+     * Maps the ring of the sink and takes a consumer slot.
+     *
+     * @param The reader settings
+     * @return false if the sink is not running or RISTNetShmRing::kMaxConsumers readers are open
+     */
+    bool openReader(RISTNetShmReaderSettings &rSettings);
+
+    /**
+     * @brief Read a packet
+     *
+     * Waits up to lTimeout for a packet, on a futex the producer wakes.
+     *
+     * @param the buffer, getSlotSize() bytes hold any packet, a longer packet is truncated
+     * @param the size of the buffer
+     * @param the connection id (flow id) of the packet
+     * @param max time to wait, 0 does not wait
+     * @return the size of the packet, 0 on timeout, -1 if the sink was destroyed or the reader not open
+     */
+    int readPacket(uint8_t *pBuf, size_t lSize, uint16_t &rConnectionID,
+                   std::chrono::milliseconds lTimeout = std::chrono::milliseconds(0));
+
+    /// The max packet size
+    size_t getSlotSize() const;
+
+    void getStatistics(ShmReaderStatistics &rStatistics);
+
+    /// Release the consumer slot and unmap the ring
+    bool closeReader();
+
+    // Delete copy and move constructors and assign operators
+    RISTNetShmReader(RISTNetShmReader const &) = delete;             // Copy construct
+    RISTNetShmReader(RISTNetShmReader &&) = delete;                  // Move construct
+    RISTNetShmReader &operator=(RISTNetShmReader const &) = delete;  // Copy assign
+    RISTNetShmReader &operator=(RISTNetShmReader &&) = delete;       // Move assign
+
+private:
+
+    // Skips what the producer overwrote
+    void lapped(uint64_t lCursor);
+    void waitForData(std::chrono::steady_clock::time_point lDeadline);
+
+    RISTNetShmRing *pRing = nullptr;
+    size_t mMappedSize = 0;
+    RISTNetShmRing::Consumer *pConsumer = nullptr;
+    uint64_t mNext = 0;
+    uint64_t mRead = 0;
+    uint64_t mLapped = 0;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETSHMREADER_H
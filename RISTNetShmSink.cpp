@@ -0,0 +1,241 @@
+//
+// RISTNetShmSink -- Shared memory ring output of received data for local downstream processes
+//
+
+#include "RISTNetShmSink.h"
+#include "RISTNetInternal.h"
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+RISTNetShmSink::RISTNetShmSink() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetShmSink constructed")
+}
+
+RISTNetShmSink::~RISTNetShmSink() {
+    if (mInitialised) {
+        destroyShmSink();
+    }
+    LOGGER(false, LOGG_NOTIFY, "RISTNetShmSink destruct")
+}
+
+bool RISTNetShmSink::initShmSink(RISTNetShmSinkSettings &rSettings) {
+    std::lock_guard<std::mutex> lLock(mWriteMtx);
+    if (mInitialised) {
+        LOGGER(true, LOGG_ERROR, "RISTNetShmSink already initialised.")
+        return false;
+    }
+    if (rSettings.mSlots < 2 || (rSettings.mSlots & (rSettings.mSlots - 1))) {
+        LOGGER(true, LOGG_ERROR, "mSlots must be a power of two.")
+        return false;
+    }
+    if (!rSettings.mSlotSize || rSettings.mSlotSize > RIST_MAX_PACKET_SIZE) {
+        LOGGER(true, LOGG_ERROR, "mSlotSize must be 1 to " << RIST_MAX_PACKET_SIZE)
+        return false;
+    }
+    uint32_t lStride = (uint32_t) ((sizeof(RISTNetShmRing::SlotHeader) + rSettings.mSlotSize + 63) & ~(size_t) 63);
+    size_t lSize = RISTNetShmRing::size(rSettings.mSlots, lStride);
+
+    // A new ring, readers of a replaced ring keep their mapping of the old one
+    shm_unlink(rSettings.mName.c_str());
+    int lFd = shm_open(rSettings.mName.c_str(), O_RDWR | O_CREAT | O_EXCL, rSettings.mPermissions);
+    if (lFd < 0) {
+        LOGGER(true, LOGG_ERROR, "shm_open failed: " << rSettings.mName << " " << strerror(errno))
+        return false;
+    }
+    fchmod(lFd, rSettings.mPermissions);
+    if (ftruncate(lFd, (off_t) lSize)) {
+        LOGGER(true, LOGG_ERROR, "ftruncate failed: " << strerror(errno))
+        close(lFd);
+        shm_unlink(rSettings.mName.c_str());
+        return false;
+    }
+    void *pMemory = mmap(nullptr, lSize, PROT_READ | PROT_WRITE, MAP_SHARED, lFd, 0);
+    close(lFd);
+    if (pMemory == MAP_FAILED) {
+        LOGGER(true, LOGG_ERROR, "mmap failed: " << strerror(errno))
+        shm_unlink(rSettings.mName.c_str());
+        return false;
+    }
+
+    // ftruncate zeroed the ring, the header is filled before the magic makes it valid for readers
+    pRing = new(pMemory) RISTNetShmRing();
+    pRing->mVersion = RISTNetShmRing::kVersion;
+    pRing->mSlots = rSettings.mSlots;
+    pRing->mSlotSize = rSettings.mSlotSize;
+    pRing->mSlotStride = lStride;
+    pRing->mMagic.store(RISTNetShmRing::kMagic, std::memory_order_release);
+
+    mMappedSize = lSize;
+    mName = rSettings.mName;
+    mSlowLag = std::max<uint64_t>(1, (uint64_t) (rSettings.mSlowConsumerLag * rSettings.mSlots));
+    mScanInterval = std::max<uint32_t>(1, rSettings.mScanInterval);
+    mUntilScan = mScanInterval;
+    std::fill(std::begin(mSlow), std::end(mSlow), false);
+    std::fill(std::begin(mSlowPid), std::end(mSlowPid), 0);
+    mStatistics = ShmSinkStatistics();
+    mInitialised = true;
+    return true;
+}
+
+bool RISTNetShmSink::attachReceiver(RISTNetReceiver &rReceiver) {
+    if (!mInitialised) {
+        LOGGER(true, LOGG_ERROR, "RISTNetShmSink not initialised.")
+        return false;
+    }
+    rReceiver.networkDataCallback = [this](const uint8_t *pBuf, size_t lSize,
+                                           std::shared_ptr<RISTNetReceiver::NetworkConnection> &rConnection,
+                                           rist_peer *pPeer, uint16_t lConnectionID) {
+        writeData(pBuf, lSize, lConnectionID);
+        return 0;
+    };
+    return true;
+}
+
+bool RISTNetShmSink::writeData(const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID) {
+    std::lock_guard<std::mutex> lLock(mWriteMtx);
+    if (!mInitialised) {
+        LOGGER(true, LOGG_ERROR, "RISTNetShmSink not initialised.")
+        return false;
+    }
+    if (lSize > pRing->mSlotSize) {
+        mStatistics.mTooLarge++;
+        return false;
+    }
+
+    // The seqlock of the slot, readers of the sequence overwritten see kWriting or the new sequence
+    uint64_t lSequence = pRing->mCursor.load(std::memory_order_relaxed);
+    RISTNetShmRing::SlotHeader *pSlot = pRing->slot(lSequence);
+    pSlot->mSequence.store(RISTNetShmRing::kWriting, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    pSlot->mSize.store((uint32_t) lSize, std::memory_order_relaxed);
+    pSlot->mConnectionID.store(lConnectionID, std::memory_order_relaxed);
+    memcpy(RISTNetShmRing::payload(pSlot), pBuf, lSize);
+    pSlot->mSequence.store(lSequence, std::memory_order_release);
+    pRing->mCursor.store(lSequence + 1, std::memory_order_seq_cst);
+
+    // Only a syscall when a reader sleeps, readers announce themselves before checking the cursor
+    if (pRing->mWaiters.load(std::memory_order_seq_cst)) {
+        pRing->mWakeup.fetch_add(1, std::memory_order_release);
+        syscall(SYS_futex, &pRing->mWakeup, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+    mStatistics.mPackets++;
+    mStatistics.mBytes += lSize;
+    if (!--mUntilScan) {
+        mUntilScan = mScanInterval;
+        scanConsumers();
+    }
+    return true;
+}
+
+void RISTNetShmSink::fillConsumer(size_t lIndex, uint64_t lCursor, ConsumerStatistics &rConsumer) {
+    RISTNetShmRing::Consumer &rShared = pRing->mConsumers[lIndex];
+    uint64_t lSequence = rShared.mSequence.load(std::memory_order_acquire);
+    rConsumer.mIndex = lIndex;
+    rConsumer.mPid = RISTNetShmRing::pid(rShared.mOwner.load(std::memory_order_acquire));
+    rConsumer.mLag = lCursor > lSequence ? lCursor - lSequence : 0;
+    rConsumer.mRead = rShared.mRead.load(std::memory_order_relaxed);
+    rConsumer.mLapped = rShared.mLapped.load(std::memory_order_relaxed);
+    rConsumer.mSlow = mSlow[lIndex] && mSlowPid[lIndex] == rConsumer.mPid;
+}
+
+void RISTNetShmSink::scanConsumers() {
+    uint64_t lCursor = pRing->mCursor.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < RISTNetShmRing::kMaxConsumers; i++) {
+        RISTNetShmRing::Consumer &rShared = pRing->mConsumers[i];
+        uint64_t lOwner = rShared.mOwner.load(std::memory_order_acquire);
+        uint32_t lState = RISTNetShmRing::state(lOwner);
+        int32_t lPid = RISTNetShmRing::pid(lOwner);
+        if (lState == RISTNetShmRing::kFree) {
+            continue;
+        }
+
+        // A reader that exited without closeReader, also one that died while claiming, would hold the slot forever
+        if (lPid > 0 && kill(lPid, 0) && errno == ESRCH) {
+            if (rShared.mOwner.compare_exchange_strong(lOwner, RISTNetShmRing::owner(RISTNetShmRing::kFree, 0))) {
+                mStatistics.mReclaimed++;
+                LOGGER(true, LOGG_WARN, "Shared memory consumer " << i << " of pid " << lPid << " released.")
+            }
+            mSlow[i] = false;
+            continue;
+        }
+        if (lState != RISTNetShmRing::kActive) {
+            continue;
+        }
+        ConsumerStatistics lConsumer;
+        fillConsumer(i, lCursor, lConsumer);
+        if (mSlowPid[i] != lConsumer.mPid) {
+            mSlowPid[i] = lConsumer.mPid;
+            mSlow[i] = false;
+        }
+
+        // Reported once, until the consumer is back below half the threshold
+        if (!mSlow[i] && lConsumer.mLag > mSlowLag) {
+            mSlow[i] = true;
+            lConsumer.mSlow = true;
+            mStatistics.mSlowEvents++;
+            LOGGER(true, LOGG_WARN, "Shared memory consumer " << i << " of pid " << lConsumer.mPid << " lags "
+                                                               << lConsumer.mLag << " packets.")
+            if (slowConsumerCallback) {
+                slowConsumerCallback(lConsumer);
+            }
+        } else if (mSlow[i] && lConsumer.mLag <= mSlowLag / 2) {
+            mSlow[i] = false;
+        }
+    }
+}
+
+void RISTNetShmSink::getConsumers(std::vector<ConsumerStatistics> &rConsumers) {
+    std::lock_guard<std::mutex> lLock(mWriteMtx);
+    rConsumers.clear();
+    if (!mInitialised) {
+        return;
+    }
+    uint64_t lCursor = pRing->mCursor.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < RISTNetShmRing::kMaxConsumers; i++) {
+        if (RISTNetShmRing::state(pRing->mConsumers[i].mOwner.load(std::memory_order_acquire)) ==
+            RISTNetShmRing::kActive) {
+            rConsumers.emplace_back();
+            fillConsumer(i, lCursor, rConsumers.back());
+        }
+    }
+}
+
+void RISTNetShmSink::getStatistics(ShmSinkStatistics &rStatistics) {
+    std::lock_guard<std::mutex> lLock(mWriteMtx);
+    rStatistics = mStatistics;
+    rStatistics.mConsumers = 0;
+    if (!mInitialised) {
+        return;
+    }
+    for (auto &rConsumer: pRing->mConsumers) {
+        if (RISTNetShmRing::state(rConsumer.mOwner.load(std::memory_order_acquire)) == RISTNetShmRing::kActive) {
+            rStatistics.mConsumers++;
+        }
+    }
+}
+
+bool RISTNetShmSink::destroyShmSink() {
+    std::lock_guard<std::mutex> lLock(mWriteMtx);
+    if (!mInitialised) {
+        LOGGER(true, LOGG_WARN, "RISTNetShmSink not initialised.")
+        return false;
+    }
+    mInitialised = false;
+    pRing->mClosed.store(1, std::memory_order_seq_cst);
+    pRing->mWakeup.fetch_add(1, std::memory_order_release);
+    syscall(SYS_futex, &pRing->mWakeup, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    munmap(pRing, mMappedSize);
+    shm_unlink(mName.c_str());
+    pRing = nullptr;
+    mMappedSize = 0;
+    return true;
+}
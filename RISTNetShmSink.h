@@ -0,0 +1,143 @@
+//
+// RISTNetShmSink -- Shared memory ring output of received data for local downstream processes
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+// k constant
+
+#ifndef CPPRISTWRAPPER__RISTNETSHMSINK_H
+#define CPPRISTWRAPPER__RISTNETSHMSINK_H
+
+#include "RISTNet.h"
+#include "RISTNetShmReader.h"
+#include <sys/types.h>
+
+/**
+ * \class RISTNetShmSink
+ *
+ * \brief
+ *
+ * A RISTNetShmSink publishes received payloads into a named shared memory ring (shm_open), one payload per slot.
+ * Transcoders, recorders and monitors on the same host read the ring with a RISTNetShmReader each, instead of
+ * a RIST or UDP session each. One producer, many consumers with their own cursor: the producer never waits for
+ * a consumer, a consumer more than the ring behind is lapped and skips what was overwritten.
+ *
+ * Every mScanInterval payloads the consumers are checked. A consumer lagging more than mSlowConsumerLag of the
+ * ring is reported once through slowConsumerCallback, a consumer whose process is gone is released.
+ *
+ */
+class RISTNetShmSink {
+public:
+
+    struct RISTNetShmSinkSettings {
+        std::string mName = "/ristnet";     // shm_open name, an existing ring of that name is replaced
+        uint32_t mSlots = 4096;             // Payloads in the ring, a power of two
+        uint32_t mSlotSize = 1500;          // Max payload, larger payloads are dropped
+        double mSlowConsumerLag = 0.5;      // Of the ring, a consumer lagging more is slow
+        uint32_t mScanInterval = 1024;      // Payloads between consumer checks
+        mode_t mPermissions = 0660;
+    };
+
+    struct ConsumerStatistics {
+        size_t mIndex = 0;                  // Consumer slot in the ring
+        pid_t mPid = 0;
+        uint64_t mLag = 0;                  // Payloads published and not read
+        uint64_t mRead = 0;
+        uint64_t mLapped = 0;               // Payloads overwritten before read
+        bool mSlow = false;
+    };
+
+    struct ShmSinkStatistics {
+        uint64_t mPackets = 0;              // Published
+        uint64_t mBytes = 0;
+        uint64_t mTooLarge = 0;             // Payloads larger than mSlotSize, dropped
+        uint64_t mSlowEvents = 0;           // slowConsumerCallback calls
+        uint64_t mReclaimed = 0;            // Consumers released because the process was gone
+        size_t mConsumers = 0;              // Active
+    };
+
+    /// Constructor
+    RISTNetShmSink();
+
+    /// Destructor
+    virtual ~RISTNetShmSink();
+
+    /**
+     * @brief Initialize the sink
+     *
+     * Creates and maps the ring.
+     *
+     * @param The sink settings
+     * @return true on success
+     */
+    bool initShmSink(RISTNetShmSinkSettings &rSettings);
+
+    /**
+     * @brief Attach to receiver
+     *
+     * Sets the networkDataCallback of the receiver, the payloads are published with the connection id.
+     *
+     * @param The receiver
+     * @return true on success
+     */
+    bool attachReceiver(RISTNetReceiver &rReceiver);
+
+    /**
+     * @brief Publish a payload
+     *
+     * Never waits for the consumers. Wakes the consumers waiting in readPacket.
+     *
+     * @param pointer to the data
+     * @param size of the data
+     * @param the connection id (flow id)
+     * @return false if not initialised or larger than mSlotSize
+     */
+    bool writeData(const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID = 0);
+
+    /// The active consumers
+    void getConsumers(std::vector<ConsumerStatistics> &rConsumers);
+
+    void getStatistics(ShmSinkStatistics &rStatistics);
+
+    /**
+     * @brief Destroys the sink
+     *
+     * The consumers get -1 from readPacket once they read what was published, the ring is unlinked.
+     *
+     */
+    bool destroyShmSink();
+
+    /// A consumer lags more than mSlowConsumerLag, once until it caught up, from the writeData thread (__NULLABLE)
+    std::function<void(const ConsumerStatistics &rConsumer)> slowConsumerCallback = nullptr;
+
+    // Delete copy and move constructors and assign operators
+    RISTNetShmSink(RISTNetShmSink const &) = delete;             // Copy construct
+    RISTNetShmSink(RISTNetShmSink &&) = delete;                  // Move construct
+    RISTNetShmSink &operator=(RISTNetShmSink const &) = delete;  // Copy assign
+    RISTNetShmSink &operator=(RISTNetShmSink &&) = delete;       // Move assign
+
+private:
+
+    // Slow and dead consumers, mWriteMtx held
+    void scanConsumers();
+    void fillConsumer(size_t lIndex, uint64_t lCursor, ConsumerStatistics &rConsumer);
+
+    // Serialises writeData, the ring has one producer
+    std::mutex mWriteMtx;
+    bool mInitialised = false;
+    RISTNetShmRing *pRing = nullptr;
+    size_t mMappedSize = 0;
+    std::string mName;
+    uint64_t mSlowLag = 0;
+    uint32_t mScanInterval = 1024;
+    uint32_t mUntilScan = 0;
+    bool mSlow[RISTNetShmRing::kMaxConsumers] = {};
+    pid_t mSlowPid[RISTNetShmRing::kMaxConsumers] = {};
+    ShmSinkStatistics mStatistics;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETSHMSINK_H
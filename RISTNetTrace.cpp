@@ -0,0 +1,599 @@
+//
+// RISTNetTrace -- Capture of received packets to a trace file and replay at the original timing
+//
+
+#include "RISTNetTrace.h"
+#include "RISTNetInternal.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TRACE_ALIGN(x) (((x) + 7) & ~(uint64_t) 7)
+#define TRACE_MIN_RING_SIZE (64 * 1024)
+#define TRACE_SCAN_INDEX_INTERVAL (256 * 1024) // Bytes between index entries when rebuilding the index
+
+//---------------------------------------------------------------------------------------------------------------------
+//
+//
+// RISTNetTraceRecorder
+//
+//
+//---------------------------------------------------------------------------------------------------------------------
+
+RISTNetTraceRecorder::RISTNetTraceRecorder() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetTraceRecorder constructed")
+}
+
+RISTNetTraceRecorder::~RISTNetTraceRecorder() {
+    if (mFileDescriptor >= 0) {
+        destroyRecorder();
+    }
+    LOGGER(false, LOGG_NOTIFY, "RISTNetTraceRecorder destruct")
+}
+
+bool RISTNetTraceRecorder::initRecorder(RISTNetTraceRecorderSettings &rSettings) {
+    if (mFileDescriptor >= 0) {
+        LOGGER(true, LOGG_ERROR, "RISTNetTraceRecorder already initialised.")
+        return false;
+    }
+    mSettings = rSettings;
+
+    size_t lRingSize = TRACE_MIN_RING_SIZE;
+    while (lRingSize < mSettings.mRingSize) {
+        lRingSize <<= 1;
+    }
+    mRing.assign(lRingSize, 0);
+    mRingMask = lRingSize - 1;
+
+    mFileDescriptor = open(mSettings.mPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (mFileDescriptor < 0) {
+        LOGGER(true, LOGG_ERROR, "Could not create: " << mSettings.mPath << " " << strerror(errno))
+        mRing.clear();
+        return false;
+    }
+
+    RISTNetTraceHeader lHeader{};
+    memcpy(lHeader.mMagic, RISTNET_TRACE_MAGIC, sizeof(lHeader.mMagic));
+    lHeader.mVersion = RISTNET_TRACE_VERSION;
+    lHeader.mHeaderSize = sizeof(RISTNetTraceHeader);
+    lHeader.mStartTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    mStart = std::chrono::steady_clock::now();
+    if (!writeFully((const uint8_t *) &lHeader, sizeof(lHeader))) {
+        LOGGER(true, LOGG_ERROR, "Could not write the trace header: " << mSettings.mPath)
+        close(mFileDescriptor);
+        mFileDescriptor = -1;
+        mRing.clear();
+        return false;
+    }
+
+    mFileOffset = sizeof(lHeader);
+    mLastIndexOffset = 0;
+    mWriteFailed = false;
+    mIndex.clear();
+    mHead = 0;
+    mTail = 0;
+    mPackets = 0;
+    mDroppedPackets = 0;
+    mBytes = sizeof(lHeader);
+    mWriteErrors = 0;
+
+    mFlushRun = true;
+    mFlushThread = std::thread(&RISTNetTraceRecorder::flushWorker, this);
+    return true;
+}
+
+bool RISTNetTraceRecorder::attachReceiver(RISTNetReceiver &rReceiver) {
+    if (mFileDescriptor < 0) {
+        LOGGER(true, LOGG_ERROR, "RISTNetTraceRecorder not initialised.")
+        return false;
+    }
+    auto lBlockCallback = rReceiver.networkDataBlockCallback;
+    auto lBufferCallback = rReceiver.networkBufferCallback;
+    auto lDataCallback = rReceiver.networkDataCallback;
+    rReceiver.networkDataBlockCallback = [this, &rReceiver, lBlockCallback, lBufferCallback, lDataCallback](
+            const rist_data_block &rDataBlock, std::shared_ptr<RISTNetReceiver::NetworkConnection> &rConnection) {
+        recordPacket(rDataBlock);
+        if (lBlockCallback) {
+            return lBlockCallback(rDataBlock, rConnection);
+        }
+        if (lBufferCallback) {
+            // The pool of the receiver, set by initReceiver
+            RISTNetPacketBuffer lBuffer = rReceiver.mPacketPool->copy((const uint8_t *) rDataBlock.payload,
+                                                                      rDataBlock.payload_len);
+            if (!lBuffer) {
+                return 0;
+            }
+            return lBufferCallback(lBuffer, rConnection, rDataBlock.peer, rDataBlock.flow_id);
+        }
+        if (lDataCallback) {
+            return lDataCallback((const uint8_t *) rDataBlock.payload, rDataBlock.payload_len, rConnection,
+                                 rDataBlock.peer, rDataBlock.flow_id);
+        }
+        return 0;
+    };
+    return true;
+}
+
+bool RISTNetTraceRecorder::recordPacket(const rist_data_block &rDataBlock) {
+    if (mRing.empty()) {
+        return false;
+    }
+    const size_t lRingSize = mRing.size();
+    const uint64_t lSize = TRACE_ALIGN(sizeof(RISTNetTraceRecord) + rDataBlock.payload_len);
+    uint64_t lHead = mHead.load(std::memory_order_relaxed);
+    uint64_t lTail = mTail.load(std::memory_order_acquire);
+    size_t lPosition = lHead & mRingMask;
+    size_t lToEnd = lRingSize - lPosition;
+    // A record is never split, the rest of the ring is padded if it does not fit
+    uint64_t lNeeded = lSize <= lToEnd ? lSize : lToEnd + lSize;
+    if (lSize > lRingSize / 2 || lHead + lNeeded - lTail > lRingSize) {
+        mDroppedPackets.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (lSize > lToEnd) {
+        RISTNetTraceRecord lPad{};
+        lPad.mSize = lToEnd;
+        lPad.mType = kTraceRecordPad;
+        memcpy(&mRing[lPosition], &lPad, std::min(lToEnd, sizeof(lPad)));
+        lHead += lToEnd;
+        lPosition = 0;
+    }
+
+    RISTNetTraceRecord lRecord{};
+    lRecord.mSize = lSize;
+    lRecord.mType = kTraceRecordPacket;
+    lRecord.mTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - mStart).count();
+    lRecord.mNTPTime = rDataBlock.ts_ntp;
+    lRecord.mPeer = (uintptr_t) rDataBlock.peer;
+    lRecord.mSeq = rDataBlock.seq;
+    lRecord.mFlowID = rDataBlock.flow_id;
+    lRecord.mFlags = rDataBlock.flags;
+    lRecord.mPayloadSize = rDataBlock.payload_len;
+    memcpy(&mRing[lPosition], &lRecord, sizeof(lRecord));
+    memcpy(&mRing[lPosition + sizeof(lRecord)], rDataBlock.payload, rDataBlock.payload_len);
+    mHead.store(lHead + lSize, std::memory_order_release);
+    mPackets.store(mPackets.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return true;
+}
+
+bool RISTNetTraceRecorder::writeFully(const uint8_t *pData, size_t lSize) {
+    while (lSize) {
+        ssize_t lWritten = write(mFileDescriptor, pData, lSize);
+        if (lWritten < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            mWriteErrors++;
+            return false;
+        }
+        pData += lWritten;
+        lSize -= lWritten;
+    }
+    return true;
+}
+
+size_t RISTNetTraceRecorder::flushRing() {
+    uint64_t lTail = mTail.load(std::memory_order_relaxed);
+    const uint64_t lHead = mHead.load(std::memory_order_acquire);
+    size_t lFlushed = 0;
+    while (lTail < lHead) {
+        // Write the run of records up to the end of the ring or a pad record
+        size_t lStart = lTail & mRingMask;
+        size_t lRun = 0;
+        bool lPad = false;
+        while (lTail + lRun < lHead && lStart + lRun < mRing.size()) {
+            RISTNetTraceRecord lRecord;
+            memcpy(&lRecord, &mRing[lStart + lRun], std::min(sizeof(lRecord), mRing.size() - lStart - lRun));
+            if (lRecord.mType == kTraceRecordPad) {
+                lPad = true;
+                break;
+            }
+            if (!mWriteFailed &&
+                (mIndex.empty() || mFileOffset + lRun - mLastIndexOffset >= mSettings.mIndexInterval)) {
+                mLastIndexOffset = mFileOffset + lRun;
+                mIndex.push_back({lRecord.mTime, mLastIndexOffset});
+            }
+            lRun += lRecord.mSize;
+        }
+        if (lRun && !mWriteFailed) {
+            // A failed write leaves the file at an unknown offset, the rest of the trace is dropped
+            if (writeFully(&mRing[lStart], lRun)) {
+                mBytes.fetch_add(lRun, std::memory_order_relaxed);
+                mFileOffset += lRun;
+            } else {
+                mWriteFailed = true;
+                LOGGER(true, LOGG_ERROR, "Could not write the trace, recording stopped: " << mSettings.mPath)
+            }
+        }
+        if (lRun) {
+            lTail += lRun;
+            lFlushed += lRun;
+        }
+        if (lPad) {
+            lTail += mRing.size() - ((lTail) & mRingMask);
+        }
+        mTail.store(lTail, std::memory_order_release);
+    }
+    return lFlushed;
+}
+
+void RISTNetTraceRecorder::flushWorker() {
+    while (true) {
+        bool lStop;
+        {
+            std::unique_lock<std::mutex> lLock(mFlushMtx);
+            mFlushCondition.wait_for(lLock, mSettings.mFlushInterval, [&]() { return !mFlushRun; });
+            lStop = !mFlushRun;
+        }
+        flushRing();
+        if (lStop) {
+            return;
+        }
+    }
+}
+
+void RISTNetTraceRecorder::getStatistics(TraceRecorderStatistics &rStatistics) {
+    rStatistics.mPackets = mPackets.load(std::memory_order_relaxed);
+    rStatistics.mBytes = mBytes.load(std::memory_order_relaxed);
+    rStatistics.mDroppedPackets = mDroppedPackets.load(std::memory_order_relaxed);
+    rStatistics.mWriteErrors = mWriteErrors.load(std::memory_order_relaxed);
+}
+
+bool RISTNetTraceRecorder::destroyRecorder() {
+    if (mFileDescriptor < 0) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lLock(mFlushMtx);
+        mFlushRun = false;
+    }
+    mFlushCondition.notify_one();
+    if (mFlushThread.joinable()) {
+        mFlushThread.join();
+    }
+
+    // The index record and the trailer pointing at it, not after a failed write
+    if (mWriteFailed) {
+        LOGGER(true, LOGG_ERROR, "The trace is truncated, no index written: " << mSettings.mPath)
+        close(mFileDescriptor);
+        mFileDescriptor = -1;
+        mRing.clear();
+        mRing.shrink_to_fit();
+        return false;
+    }
+    RISTNetTraceRecord lRecord{};
+    lRecord.mSize = sizeof(lRecord) + mIndex.size() * sizeof(RISTNetTraceIndexEntry);
+    lRecord.mType = kTraceRecordIndex;
+    lRecord.mPayloadSize = mIndex.size() * sizeof(RISTNetTraceIndexEntry);
+    RISTNetTraceTrailer lTrailer{};
+    memcpy(lTrailer.mMagic, RISTNET_TRACE_INDEX_MAGIC, sizeof(lTrailer.mMagic));
+    lTrailer.mIndexOffset = mFileOffset;
+    lTrailer.mPackets = mPackets.load(std::memory_order_relaxed);
+    bool lResult = writeFully((const uint8_t *) &lRecord, sizeof(lRecord)) &&
+                   writeFully((const uint8_t *) mIndex.data(), lRecord.mPayloadSize) &&
+                   writeFully((const uint8_t *) &lTrailer, sizeof(lTrailer));
+    if (!lResult) {
+        LOGGER(true, LOGG_ERROR, "Could not write the trace index: " << mSettings.mPath)
+    }
+    if (close(mFileDescriptor)) {
+        lResult = false;
+    }
+    mFileDescriptor = -1;
+    mRing.clear();
+    mRing.shrink_to_fit();
+    return lResult;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+//
+//
+// RISTNetTracePlayer
+//
+//
+//---------------------------------------------------------------------------------------------------------------------
+
+RISTNetTracePlayer::RISTNetTracePlayer() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetTracePlayer constructed")
+}
+
+RISTNetTracePlayer::~RISTNetTracePlayer() {
+    if (mFileData) {
+        closeTrace();
+    }
+    LOGGER(false, LOGG_NOTIFY, "RISTNetTracePlayer destruct")
+}
+
+bool RISTNetTracePlayer::openTrace(const std::string &rPath, RISTNetTracePlayerSettings &rSettings) {
+    if (mFileData) {
+        LOGGER(true, LOGG_ERROR, "RISTNetTracePlayer already has an open trace.")
+        return false;
+    }
+    if (rSettings.mSpeed < 0) {
+        LOGGER(true, LOGG_ERROR, "Replay speed not valid.")
+        return false;
+    }
+    mSettings = rSettings;
+
+    mFileDescriptor = open(rPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (mFileDescriptor < 0) {
+        LOGGER(true, LOGG_ERROR, "Could not open: " << rPath)
+        return false;
+    }
+    struct stat lStat{};
+    if (fstat(mFileDescriptor, &lStat) || lStat.st_size < (off_t) sizeof(RISTNetTraceHeader)) {
+        LOGGER(true, LOGG_ERROR, "File too small to be a trace: " << rPath)
+        closeTrace();
+        return false;
+    }
+    mMapSize = lStat.st_size;
+    void *pMap = mmap(nullptr, mMapSize, PROT_READ, MAP_PRIVATE, mFileDescriptor, 0);
+    if (pMap == MAP_FAILED) {
+        LOGGER(true, LOGG_ERROR, "mmap failed: " << rPath)
+        mMapSize = 0;
+        closeTrace();
+        return false;
+    }
+    mFileData = (const uint8_t *) pMap;
+    madvise(pMap, mMapSize, MADV_SEQUENTIAL);
+
+    auto pHeader = (const RISTNetTraceHeader *) mFileData;
+    if (memcmp(pHeader->mMagic, RISTNET_TRACE_MAGIC, sizeof(pHeader->mMagic)) ||
+        pHeader->mVersion != RISTNET_TRACE_VERSION || pHeader->mHeaderSize < sizeof(RISTNetTraceHeader) ||
+        pHeader->mHeaderSize > mMapSize || pHeader->mHeaderSize % 8) {
+        LOGGER(true, LOGG_ERROR, "Not a trace of version " << RISTNET_TRACE_VERSION << ": " << rPath)
+        closeTrace();
+        return false;
+    }
+    if (!readIndex()) {
+        LOGGER(true, LOGG_NOTIFY, "Trace not closed, index rebuilt: " << rPath)
+    }
+    mNextOffset = pHeader->mHeaderSize;
+    mStatistics = TracePlayerStatistics();
+    return true;
+}
+
+const RISTNetTraceRecord *RISTNetTracePlayer::recordAt(uint64_t lOffset) {
+    if (lOffset + sizeof(RISTNetTraceRecord) > mMapSize) {
+        return nullptr;
+    }
+    auto pRecord = (const RISTNetTraceRecord *) (mFileData + lOffset);
+    if (pRecord->mSize < sizeof(RISTNetTraceRecord) || pRecord->mSize % 8 || lOffset + pRecord->mSize > mMapSize ||
+        pRecord->mPayloadSize > pRecord->mSize - sizeof(RISTNetTraceRecord)) {
+        return nullptr;
+    }
+    return pRecord;
+}
+
+bool RISTNetTracePlayer::readIndex() {
+    mIndex.clear();
+    mPackets = 0;
+    uint64_t lOffset = ((const RISTNetTraceHeader *) mFileData)->mHeaderSize;
+    bool lFromTrailer = false;
+
+    if (mMapSize >= lOffset + sizeof(RISTNetTraceRecord) + sizeof(RISTNetTraceTrailer)) {
+        auto pTrailer = (const RISTNetTraceTrailer *) (mFileData + mMapSize - sizeof(RISTNetTraceTrailer));
+        auto pRecord = recordAt(pTrailer->mIndexOffset);
+        if (!memcmp(pTrailer->mMagic, RISTNET_TRACE_INDEX_MAGIC, sizeof(pTrailer->mMagic)) && pRecord &&
+            pRecord->mType == kTraceRecordIndex && pTrailer->mIndexOffset >= lOffset) {
+            auto pEntries = (const RISTNetTraceIndexEntry *) (pRecord + 1);
+            mIndex.assign(pEntries, pEntries + pRecord->mPayloadSize / sizeof(RISTNetTraceIndexEntry));
+            mRecordsEnd = pTrailer->mIndexOffset;
+            mPackets = pTrailer->mPackets;
+            lFromTrailer = true;
+        }
+    }
+
+    // Without a trailer every record is visited, with one only the last indexed stretch for the duration
+    if (lFromTrailer && !mIndex.empty()) {
+        lOffset = mIndex.back().mOffset;
+    }
+    uint64_t lLastIndexOffset = 0;
+    uint64_t lEnd = lFromTrailer ? mRecordsEnd : mMapSize;
+    mDuration = 0;
+    while (lOffset < lEnd) {
+        auto pRecord = recordAt(lOffset);
+        if (!pRecord || pRecord->mType != kTraceRecordPacket) {
+            break;
+        }
+        if (!lFromTrailer) {
+            if (mIndex.empty() || lOffset - lLastIndexOffset >= TRACE_SCAN_INDEX_INTERVAL) {
+                mIndex.push_back({pRecord->mTime, lOffset});
+                lLastIndexOffset = lOffset;
+            }
+            mPackets++;
+        }
+        mDuration = pRecord->mTime;
+        lOffset += pRecord->mSize;
+    }
+    if (!lFromTrailer) {
+        mRecordsEnd = lOffset;
+    }
+    return lFromTrailer;
+}
+
+bool RISTNetTracePlayer::startReplay(RISTNetSender &rSender) {
+    uint16_t lConnectionID = mSettings.mConnectionID;
+    packetCallback = [&rSender, lConnectionID](const RISTNetTraceRecord &rRecord, const uint8_t *pPayload) {
+        return rSender.sendData(pPayload, rRecord.mPayloadSize, lConnectionID) ? 0 : -1;
+    };
+    return startReplay();
+}
+
+bool RISTNetTracePlayer::startReplay() {
+    if (!mFileData) {
+        LOGGER(true, LOGG_ERROR, "RISTNetTracePlayer no trace open.")
+        return false;
+    }
+    if (!packetCallback) {
+        LOGGER(true, LOGG_ERROR, "packetCallback not set.")
+        return false;
+    }
+    if (mReplaying) {
+        LOGGER(true, LOGG_ERROR, "RISTNetTracePlayer already replaying.")
+        return false;
+    }
+    if (mReplayThread.joinable()) {
+        mReplayThread.join(); // The previous replay reached the end of the trace
+    }
+    std::lock_guard<std::mutex> lLock(mReplayMtx);
+    if (mNextOffset >= mRecordsEnd) {
+        mNextOffset = ((const RISTNetTraceHeader *) mFileData)->mHeaderSize;
+    }
+    mReplayRun = true;
+    mReplaying = true;
+    mReplayThread = std::thread(&RISTNetTracePlayer::replayWorker, this);
+    return true;
+}
+
+void RISTNetTracePlayer::stopReplay() {
+    {
+        std::lock_guard<std::mutex> lLock(mReplayMtx);
+        mReplayRun = false;
+    }
+    mReplayCondition.notify_all();
+    if (mReplayThread.joinable()) {
+        mReplayThread.join();
+    }
+}
+
+bool RISTNetTracePlayer::isReplaying() {
+    return mReplaying;
+}
+
+void RISTNetTracePlayer::replayWorker() {
+    const uint64_t lFirstOffset = ((const RISTNetTraceHeader *) mFileData)->mHeaderSize;
+    std::unique_lock<std::mutex> lLock(mReplayMtx);
+    auto lBase = std::chrono::steady_clock::now();
+    auto pFirst = recordAt(mNextOffset);
+    uint64_t lBaseTime = pFirst ? pFirst->mTime : 0;
+
+    while (mReplayRun) {
+        if (mNextOffset >= mRecordsEnd) {
+            if (!mSettings.mLoop || mRecordsEnd == lFirstOffset) {
+                break;
+            }
+            mNextOffset = lFirstOffset;
+            mStatistics.mLoops++;
+            lBase = std::chrono::steady_clock::now();
+            lBaseTime = recordAt(mNextOffset)->mTime;
+            continue;
+        }
+        auto pRecord = recordAt(mNextOffset);
+        if (!pRecord || pRecord->mType != kTraceRecordPacket) {
+            break;
+        }
+        if (mSettings.mSpeed > 0) {
+            auto lDeadline = lBase + std::chrono::nanoseconds(
+                    (int64_t) ((double) (int64_t) (pRecord->mTime - lBaseTime) / mSettings.mSpeed));
+            if (mReplayCondition.wait_until(lLock, lDeadline, [&]() { return !mReplayRun; })) {
+                break;
+            }
+            auto lLateness = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - lDeadline);
+            if (lLateness > std::chrono::milliseconds(1)) {
+                mStatistics.mPacketsLate++;
+            }
+            mStatistics.mMaxLateness = std::max(mStatistics.mMaxLateness, lLateness);
+        }
+        mNextOffset += pRecord->mSize;
+
+        lLock.unlock();
+        auto pPayload = (const uint8_t *) (pRecord + 1);
+        bool lSent = packetCallback(*pRecord, pPayload) == 0;
+        lLock.lock();
+        if (lSent) {
+            mStatistics.mPacketsSent++;
+        } else {
+            mStatistics.mPacketsFailed++;
+        }
+    }
+    mReplaying = false;
+}
+
+uint64_t RISTNetTracePlayer::replayAll() {
+    if (!mFileData || !packetCallback || mReplaying) {
+        LOGGER(true, LOGG_ERROR, "No trace open, packetCallback not set or replaying.")
+        return 0;
+    }
+    uint64_t lDelivered = 0;
+    uint64_t lOffset = mNextOffset;
+    while (lOffset < mRecordsEnd) {
+        auto pRecord = recordAt(lOffset);
+        if (!pRecord || pRecord->mType != kTraceRecordPacket) {
+            break;
+        }
+        packetCallback(*pRecord, (const uint8_t *) (pRecord + 1));
+        lOffset += pRecord->mSize;
+        lDelivered++;
+    }
+    std::lock_guard<std::mutex> lLock(mReplayMtx);
+    mNextOffset = lOffset;
+    mStatistics.mPacketsSent += lDelivered;
+    return lDelivered;
+}
+
+bool RISTNetTracePlayer::seek(std::chrono::nanoseconds lTime) {
+    if (!mFileData || mReplaying) {
+        return false;
+    }
+    uint64_t lOffset = ((const RISTNetTraceHeader *) mFileData)->mHeaderSize;
+    auto lEntry = std::upper_bound(mIndex.begin(), mIndex.end(), (uint64_t) lTime.count(),
+                                   [](uint64_t lValue, const RISTNetTraceIndexEntry &rEntry) {
+                                       return lValue < rEntry.mTime;
+                                   });
+    if (lEntry != mIndex.begin()) {
+        lOffset = std::prev(lEntry)->mOffset;
+    }
+    while (lOffset < mRecordsEnd) {
+        auto pRecord = recordAt(lOffset);
+        if (!pRecord || pRecord->mTime >= (uint64_t) lTime.count()) {
+            break;
+        }
+        lOffset += pRecord->mSize;
+    }
+    std::lock_guard<std::mutex> lLock(mReplayMtx);
+    mNextOffset = lOffset;
+    return lOffset < mRecordsEnd;
+}
+
+std::chrono::nanoseconds RISTNetTracePlayer::getDuration() {
+    return std::chrono::nanoseconds(mDuration);
+}
+
+uint64_t RISTNetTracePlayer::getPackets() {
+    return mPackets;
+}
+
+const RISTNetTraceHeader &RISTNetTracePlayer::getHeader() {
+    static const RISTNetTraceHeader kNoHeader{};
+    return mFileData ? *(const RISTNetTraceHeader *) mFileData : kNoHeader;
+}
+
+void RISTNetTracePlayer::getStatistics(TracePlayerStatistics &rStatistics) {
+    std::lock_guard<std::mutex> lLock(mReplayMtx);
+    rStatistics = mStatistics;
+}
+
+bool RISTNetTracePlayer::closeTrace() {
+    stopReplay();
+    if (mFileData) {
+        munmap((void *) mFileData, mMapSize);
+        mFileData = nullptr;
+        mMapSize = 0;
+    }
+    if (mFileDescriptor >= 0) {
+        close(mFileDescriptor);
+        mFileDescriptor = -1;
+    }
+    mIndex.clear();
+    mRecordsEnd = 0;
+    mPackets = 0;
+    mDuration = 0;
+    return true;
+}
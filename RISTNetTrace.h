@@ -0,0 +1,321 @@
+//
+// RISTNetTrace -- Capture of received packets to a trace file and replay at the original timing
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+// k constant
+
+#ifndef CPPRISTWRAPPER__RISTNETTRACE_H
+#define CPPRISTWRAPPER__RISTNETTRACE_H
+
+#include "RISTNet.h"
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+
+// The trace file format, little endian. A header, the records and, if the recording was closed, the index
+// and the trailer. Every record starts 8 byte aligned, a file cut short is read up to its last whole record.
+//
+//   RISTNetTraceHeader
+//   RISTNetTraceRecord + payload + padding     (kTraceRecordPacket)
+//   ...
+//   RISTNetTraceRecord + RISTNetTraceIndexEntry[] (kTraceRecordIndex)
+//   RISTNetTraceTrailer
+
+#define RISTNET_TRACE_MAGIC "RISTTRC1"
+#define RISTNET_TRACE_INDEX_MAGIC "RISTIDX1"
+#define RISTNET_TRACE_VERSION 1
+
+struct RISTNetTraceHeader {
+    char mMagic[8];             // RISTNET_TRACE_MAGIC
+    uint32_t mVersion;
+    uint32_t mHeaderSize;       // sizeof(RISTNetTraceHeader), the first record follows
+    uint64_t mStartTime;        // ns since the epoch (system clock) of record time 0
+    uint64_t mReserved[5];
+};
+
+enum RISTNetTraceRecordType : uint16_t {
+    kTraceRecordPacket = 1,
+    kTraceRecordIndex = 2,
+    kTraceRecordPad = 3         // Only in the recording ring, never written
+};
+
+struct RISTNetTraceRecord {
+    uint32_t mSize;             // Record header, payload and padding to 8 bytes
+    uint16_t mType;             // RISTNetTraceRecordType
+    uint16_t mReserved;
+    uint64_t mTime;             // ns since the start of the recording (steady clock)
+    uint64_t mNTPTime;          // ts_ntp of the data block
+    uint64_t mPeer;             // The rist_peer pointer, identifies the peer within the recording
+    uint64_t mSeq;              // seq of the data block
+    uint32_t mFlowID;
+    uint32_t mFlags;            // flags of the data block
+    uint32_t mPayloadSize;
+    uint32_t mReserved2;
+};
+
+struct RISTNetTraceIndexEntry {
+    uint64_t mTime;             // Time of the record at the offset
+    uint64_t mOffset;           // File offset of a packet record
+};
+
+struct RISTNetTraceTrailer {
+    char mMagic[8];             // RISTNET_TRACE_INDEX_MAGIC
+    uint64_t mIndexOffset;      // File offset of the index record
+    uint64_t mPackets;
+};
+
+static_assert(sizeof(RISTNetTraceHeader) == 64, "Trace header layout");
+static_assert(sizeof(RISTNetTraceRecord) == 56, "Trace record layout");
+
+/**
+ * \class RISTNetTraceRecorder
+ *
+ * \brief
+ *
+ * Records packets to a trace file. recordPacket copies the packet into a lock-free ring (one producer, the
+ * librist receive thread) and a background thread appends the ring to the file every mFlushInterval.
+ * If the file falls behind and the ring is full, packets are dropped and counted, the caller never blocks.
+ *
+ */
+class RISTNetTraceRecorder {
+public:
+
+    struct RISTNetTraceRecorderSettings {
+        std::string mPath;
+        size_t mRingSize = 16 * 1024 * 1024;             // Rounded up to a power of 2
+        std::chrono::milliseconds mFlushInterval{10};
+        uint64_t mIndexInterval = 256 * 1024;            // Bytes of trace between index entries
+    };
+
+    struct TraceRecorderStatistics {
+        uint64_t mPackets = 0;          // Packets recorded
+        uint64_t mBytes = 0;            // Bytes written to the file
+        uint64_t mDroppedPackets = 0;   // Packets dropped because the ring was full
+        uint64_t mWriteErrors = 0;
+    };
+
+    /// Constructor
+    RISTNetTraceRecorder();
+
+    /// Destructor
+    virtual ~RISTNetTraceRecorder();
+
+    /**
+     * @brief Initialize the recorder
+     *
+     * Creates the file, writes the header and starts the flush thread.
+     *
+     * @param The recorder settings
+     * @return true on success
+     */
+    bool initRecorder(RISTNetTraceRecorderSettings &rSettings);
+
+    /**
+     * @brief Attach a receiver
+     *
+     * Records all data the receiver delivers. Sets networkDataBlockCallback, the data callback set before
+     * (networkDataBlockCallback, networkBufferCallback or networkDataCallback) is still called after recording,
+     * networkBufferCallback with a buffer of the mPacketPool of the receiver.
+     * The recorder must outlive the receiver.
+     *
+     * @param the receiver
+     * @return true on success
+     */
+    bool attachReceiver(RISTNetReceiver &rReceiver);
+
+    /**
+     * @brief Record a packet
+     *
+     * Copies the packet into the ring. Never blocks. One thread at a time.
+     *
+     * @param the data block
+     * @return true if recorded, false if dropped
+     */
+    bool recordPacket(const rist_data_block &rDataBlock);
+
+    /// Get the recorder statistics
+    void getStatistics(TraceRecorderStatistics &rStatistics);
+
+    /**
+     * @brief Destroys the recorder
+     *
+     * Writes what is left in the ring, the index and the trailer, and closes the file.
+     * After a write error the file is closed without an index and false is returned.
+     *
+     */
+    bool destroyRecorder();
+
+    // Delete copy and move constructors and assign operators
+    RISTNetTraceRecorder(RISTNetTraceRecorder const &) = delete;             // Copy construct
+    RISTNetTraceRecorder(RISTNetTraceRecorder &&) = delete;                  // Move construct
+    RISTNetTraceRecorder &operator=(RISTNetTraceRecorder const &) = delete;  // Copy assign
+    RISTNetTraceRecorder &operator=(RISTNetTraceRecorder &&) = delete;       // Move assign
+
+private:
+
+    size_t flushRing();
+    bool writeFully(const uint8_t *pData, size_t lSize);
+    void flushWorker();
+
+    RISTNetTraceRecorderSettings mSettings;
+    int mFileDescriptor = -1;
+    std::chrono::steady_clock::time_point mStart;
+
+    // The ring, written by recordPacket and read by the flush thread
+    std::vector<uint8_t> mRing;
+    size_t mRingMask = 0;
+    alignas(64) std::atomic<uint64_t> mHead{0};     // Producer position
+    alignas(64) std::atomic<uint64_t> mTail{0};     // Flush thread position
+    alignas(64) std::atomic<uint64_t> mPackets{0};
+    std::atomic<uint64_t> mDroppedPackets{0};
+
+    // Owned by the flush thread
+    uint64_t mFileOffset = 0;
+    uint64_t mLastIndexOffset = 0;
+    bool mWriteFailed = false;
+    std::vector<RISTNetTraceIndexEntry> mIndex;
+    std::atomic<uint64_t> mBytes{0};
+    std::atomic<uint64_t> mWriteErrors{0};
+
+    std::mutex mFlushMtx;
+    std::condition_variable mFlushCondition;
+    std::thread mFlushThread;
+    bool mFlushRun = false;
+};
+
+/**
+ * \class RISTNetTracePlayer
+ *
+ * \brief
+ *
+ * Replays a trace file. The file is memory mapped, the index of the trailer (or a scan of the file when it was
+ * not closed) is used for seeking. The packets are sent to a RISTNetSender or delivered to packetCallback, at
+ * the recorded timing scaled by mSpeed or as fast as possible.
+ *
+ */
+class RISTNetTracePlayer {
+public:
+
+    struct RISTNetTracePlayerSettings {
+        double mSpeed = 1.0;            // 2.0 plays twice as fast, 0 as fast as possible
+        bool mLoop = false;
+        uint16_t mConnectionID = 0;     // Given to sendData when replaying to a sender
+    };
+
+    struct TracePlayerStatistics {
+        uint64_t mPacketsSent = 0;
+        uint64_t mPacketsFailed = 0;    // Packets the callback (or sendData) did not accept
+        uint64_t mPacketsLate = 0;      // Packets sent more than a millisecond after their time
+        std::chrono::microseconds mMaxLateness{0};
+        uint64_t mLoops = 0;
+    };
+
+    /// Constructor
+    RISTNetTracePlayer();
+
+    /// Destructor
+    virtual ~RISTNetTracePlayer();
+
+    /**
+     * @brief Open a trace
+     *
+     * Maps the file and reads (or rebuilds) the index.
+     *
+     * @param path to the trace
+     * @param The player settings
+     * @return true on success
+     */
+    bool openTrace(const std::string &rPath, RISTNetTracePlayerSettings &rSettings);
+
+    /// Start replay to a sender using sendData, replaces packetCallback. The sender must outlive the replay.
+    bool startReplay(RISTNetSender &rSender);
+
+    /// Start replay to packetCallback
+    bool startReplay();
+
+    /// Stop replay, it can be started again from where it stopped
+    void stopReplay();
+
+    /// True while the replay thread is sending
+    bool isReplaying();
+
+    /**
+     * @brief Replay on the calling thread
+     *
+     * Delivers the packets from the current position to packetCallback as fast as possible, without the replay
+     * thread. For benchmarks and tools.
+     *
+     * @return the packets delivered
+     */
+    uint64_t replayAll();
+
+    /**
+     * @brief Seek
+     *
+     * Moves the replay position to the first packet at or after the time. Not while replaying.
+     *
+     * @param the time relative to the start of the recording
+     * @return true if the position is within the trace
+     */
+    bool seek(std::chrono::nanoseconds lTime);
+
+    /// The time of the last packet
+    std::chrono::nanoseconds getDuration();
+
+    /// The number of packets in the trace
+    uint64_t getPackets();
+
+    /// The header of the trace
+    const RISTNetTraceHeader &getHeader();
+
+    /// Get the replay statistics
+    void getStatistics(TracePlayerStatistics &rStatistics);
+
+    /**
+     * @brief Close the trace
+     *
+     * Stops replay and unmaps the file.
+     *
+     */
+    bool closeTrace();
+
+    /// Callback getting the packets when replaying without a sender. Return 0 if the packet was accepted.
+    std::function<int(const RISTNetTraceRecord &rRecord, const uint8_t *pPayload)> packetCallback = nullptr;
+
+    // Delete copy and move constructors and assign operators
+    RISTNetTracePlayer(RISTNetTracePlayer const &) = delete;             // Copy construct
+    RISTNetTracePlayer(RISTNetTracePlayer &&) = delete;                  // Move construct
+    RISTNetTracePlayer &operator=(RISTNetTracePlayer const &) = delete;  // Copy assign
+    RISTNetTracePlayer &operator=(RISTNetTracePlayer &&) = delete;       // Move assign
+
+private:
+
+    const RISTNetTraceRecord *recordAt(uint64_t lOffset);
+    bool readIndex();
+    void replayWorker();
+
+    RISTNetTracePlayerSettings mSettings;
+    int mFileDescriptor = -1;
+    const uint8_t *mFileData = nullptr;
+    size_t mMapSize = 0;
+    uint64_t mRecordsEnd = 0;       // File offset after the last packet record
+    std::vector<RISTNetTraceIndexEntry> mIndex;
+    uint64_t mPackets = 0;
+    uint64_t mDuration = 0;
+
+    // The mutex protecting the replay state and statistics
+    std::mutex mReplayMtx;
+    std::condition_variable mReplayCondition;
+    std::thread mReplayThread;
+    bool mReplayRun = false;
+    std::atomic<bool> mReplaying = false;
+    uint64_t mNextOffset = 0;
+    TracePlayerStatistics mStatistics;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETTRACE_H
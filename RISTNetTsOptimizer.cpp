@@ -0,0 +1,219 @@
+//
+// RISTNetTsOptimizer -- MPEG-TS null packet deletion and PID filtering, re-inserting the nulls on receive
+//
+
+#include "RISTNetTsOptimizer.h"
+#include "RISTNetInternal.h"
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// The header of the nulls inserted for blocked PIDs when the payload had no null to copy
+#define TS_DEFAULT_NULL_HEADER 0x10
+#define TS_DEFAULT_NULL_FILL 0xFF
+
+RISTNetTsOptimizer::RISTNetTsOptimizer() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetTsOptimizer constructed")
+}
+
+RISTNetTsOptimizer::~RISTNetTsOptimizer() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetTsOptimizer destruct")
+}
+
+bool RISTNetTsOptimizer::initOptimizer(RISTNetTsOptimizerSettings &rSettings) {
+    mDeleteNulls = rSettings.mDeleteNulls;
+    mDropPIDs.reset();
+    for (auto lPID: rSettings.mDropPIDs) {
+        if (lPID >= kNullPID) {
+            LOGGER(true, LOGG_ERROR, "PID not valid: " << lPID)
+            return false;
+        }
+        mDropPIDs.set(lPID);
+    }
+    return true;
+}
+
+// True if all bytes are lFill, 16 bytes at a time
+bool RISTNetTsOptimizer::isFilled(const uint8_t *pData, size_t lSize, uint8_t lFill) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i lFillVector = _mm_set1_epi8((char) lFill);
+    for (; i + 16 <= lSize; i += 16) {
+        __m128i lBytes = _mm_loadu_si128((const __m128i *) (pData + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(lBytes, lFillVector)) != 0xFFFF) {
+            return false;
+        }
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t lFillVector = vdupq_n_u8(lFill);
+    for (; i + 16 <= lSize; i += 16) {
+        uint8x16_t lEqual = vceqq_u8(vld1q_u8(pData + i), lFillVector);
+        if (vminvq_u8(lEqual) != 0xFF) {
+            return false;
+        }
+    }
+#endif
+    for (; i < lSize; i++) {
+        if (pData[i] != lFill) {
+            return false;
+        }
+    }
+    return true;
+}
+
+namespace {
+// The payload behind a raw header
+void frameRaw(const uint8_t *pData, size_t lSize, std::vector<uint8_t> &rOut) {
+    rOut.resize(RISTNetTsOptimizer::kRawHeaderSize + lSize);
+    rOut[0] = RISTNetTsOptimizer::kTsOptimizedMarker;
+    rOut[1] = 0;
+    if (lSize) {
+        memcpy(rOut.data() + RISTNetTsOptimizer::kRawHeaderSize, pData, lSize);
+    }
+}
+} // namespace
+
+bool RISTNetTsOptimizer::optimize(const uint8_t *pData, size_t lSize, std::vector<uint8_t> &rOut) {
+    mBytesIn += lSize;
+    size_t lPackets = lSize / kTsPacketSize;
+    if (!lSize || lSize % kTsPacketSize || lPackets > kMaxPackets) {
+        frameRaw(pData, lSize, rOut);
+        mBytesOut += rOut.size();
+        return false;
+    }
+
+    uint8_t lMap[(kMaxPackets + 7) / 8] = {};
+    size_t lMapSize = (lPackets + 7) / 8;
+    size_t lDeleted = 0;
+    size_t lDropped = 0;
+    bool lHaveNull = false;
+    uint8_t lNullHeader = TS_DEFAULT_NULL_HEADER;
+    uint8_t lNullFill = TS_DEFAULT_NULL_FILL;
+    for (size_t i = 0; i < lPackets; i++) {
+        const uint8_t *pPacket = pData + i * kTsPacketSize;
+        if (pPacket[0] != kTsSyncByte) {
+            frameRaw(pData, lSize, rOut);
+            mBytesOut += rOut.size();
+            return false;
+        }
+        uint16_t lPID = ((pPacket[1] & 0x1f) << 8) | pPacket[2];
+        bool lDelete = false;
+        if (lPID == kNullPID) {
+            // Only nulls restored bit exact, no flags set and the payload one fill byte
+            if (mDeleteNulls && pPacket[1] == 0x1f) {
+                if (!lHaveNull && isFilled(pPacket + 5, kTsPacketSize - 5, pPacket[4])) {
+                    lHaveNull = true;
+                    lNullHeader = pPacket[3];
+                    lNullFill = pPacket[4];
+                    lDelete = true;
+                } else if (lHaveNull && pPacket[3] == lNullHeader &&
+                           isFilled(pPacket + 4, kTsPacketSize - 4, lNullFill)) {
+                    lDelete = true;
+                }
+            }
+        } else if (mDropPIDs[lPID]) {
+            lDelete = true;
+            lDropped++;
+        }
+        if (lDelete) {
+            lMap[i / 8] |= 1 << (i % 8);
+            lDeleted++;
+        }
+    }
+    if (!lDeleted) {
+        frameRaw(pData, lSize, rOut);
+        mBytesOut += rOut.size();
+        return false;
+    }
+
+    rOut.resize(kHeaderSize + lMapSize + (lPackets - lDeleted) * kTsPacketSize);
+    uint8_t *pOut = rOut.data();
+    pOut[0] = kTsOptimizedMarker;
+    pOut[1] = (uint8_t) lPackets;
+    pOut[2] = lNullHeader;
+    pOut[3] = lNullFill;
+    memcpy(pOut + kHeaderSize, lMap, lMapSize);
+    pOut += kHeaderSize + lMapSize;
+    for (size_t i = 0; i < lPackets; i++) {
+        if (!(lMap[i / 8] & (1 << (i % 8)))) {
+            memcpy(pOut, pData + i * kTsPacketSize, kTsPacketSize);
+            pOut += kTsPacketSize;
+        }
+    }
+    mPackets += lPackets;
+    mNullsDeleted += lDeleted - lDropped;
+    mPIDsDropped += lDropped;
+    mBytesOut += rOut.size();
+    return true;
+}
+
+bool RISTNetTsOptimizer::restore(const uint8_t *pData, size_t lSize, std::vector<uint8_t> &rOut) {
+    if (lSize < kRawHeaderSize || pData[0] != kTsOptimizedMarker) {
+        mRestoreErrors++;
+        return false;
+    }
+    size_t lPackets = pData[1];
+    if (!lPackets) {
+        rOut.assign(pData + kRawHeaderSize, pData + lSize);
+        mRawReceived++;
+        return true;
+    }
+    if (lSize < kHeaderSize) {
+        mRestoreErrors++;
+        return false;
+    }
+    size_t lMapSize = (lPackets + 7) / 8;
+    if (lSize < kHeaderSize + lMapSize) {
+        mRestoreErrors++;
+        return false;
+    }
+    const uint8_t *pMap = pData + kHeaderSize;
+    size_t lDeleted = 0;
+    for (size_t i = 0; i < lPackets; i++) {
+        lDeleted += (pMap[i / 8] >> (i % 8)) & 1;
+    }
+    if (lSize != kHeaderSize + lMapSize + (lPackets - lDeleted) * kTsPacketSize) {
+        mRestoreErrors++;
+        return false;
+    }
+
+    rOut.resize(lPackets * kTsPacketSize);
+    uint8_t *pOut = rOut.data();
+    const uint8_t *pKept = pMap + lMapSize;
+    for (size_t i = 0; i < lPackets; i++) {
+        if (pMap[i / 8] & (1 << (i % 8))) {
+            pOut[0] = kTsSyncByte;
+            pOut[1] = 0x1f;
+            pOut[2] = 0xff;
+            pOut[3] = pData[2];
+            memset(pOut + 4, pData[3], kTsPacketSize - 4);
+        } else {
+            memcpy(pOut, pKept, kTsPacketSize);
+            pKept += kTsPacketSize;
+        }
+        pOut += kTsPacketSize;
+    }
+    mRestored++;
+    return true;
+}
+
+uint64_t RISTNetTsOptimizer::getBytesSaved() {
+    uint64_t lBytesIn = mBytesIn;
+    uint64_t lBytesOut = mBytesOut;
+    return lBytesIn > lBytesOut ? lBytesIn - lBytesOut : 0;
+}
+
+void RISTNetTsOptimizer::getStatistics(TsOptimizerStatistics &rStatistics) {
+    rStatistics.mPackets = mPackets;
+    rStatistics.mNullsDeleted = mNullsDeleted;
+    rStatistics.mPIDsDropped = mPIDsDropped;
+    rStatistics.mBytesIn = mBytesIn;
+    rStatistics.mBytesOut = mBytesOut;
+    rStatistics.mRestored = mRestored;
+    rStatistics.mRawReceived = mRawReceived;
+    rStatistics.mRestoreErrors = mRestoreErrors;
+}
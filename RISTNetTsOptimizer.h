@@ -0,0 +1,135 @@
+//
+// RISTNetTsOptimizer -- MPEG-TS null packet deletion and PID filtering, re-inserting the nulls on receive
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+// k constant
+
+#ifndef CPPRISTWRAPPER__RISTNETTSOPTIMIZER_H
+#define CPPRISTWRAPPER__RISTNETTSOPTIMIZER_H
+
+#include <atomic>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Every payload of a sender with mTsOptimize carries the header, optimized or not, so no payload is told apart by its
+// first bytes. Packets 0 is a payload sent as it is (not TS or nothing deleted), it follows the 2 byte header. Else
+// the packets deleted are flagged in the deletion map (bit i of byte i / 8 is packet i) and re-inserted as nulls made
+// of the null header byte 3 and the null fill byte. The packets kept follow in order.
+//
+//   uint8_t  marker         kTsOptimizedMarker
+//   uint8_t  packets        TS packets in the original payload, 0 for a payload sent as it is
+//   uint8_t  null header    byte 3 of the null packets (adaptation field control and continuity counter)
+//   uint8_t  null fill      the 184 byte payload of the null packets
+//   uint8_t  deletion map[(packets + 7) / 8]
+//   the packets kept
+
+/**
+ * \class RISTNetTsOptimizer
+ *
+ * \brief
+ *
+ * Deletes the null packets (PID 0x1FFF) of a TS payload, and the packets of the PIDs blocked, replacing them by
+ * a deletion map. Restoring the payload re-inserts nulls in their place so a CBR multiplex keeps its rate. A
+ * payload with only the nulls deleted is restored bit exact: only nulls made of one fill byte are deleted, all
+ * nulls deleted from one payload share their header byte 3 and fill byte, the others are kept. The check of the
+ * null fill bytes uses SSE2 or NEON, the scan of the sync byte and PID of each packet is scalar.
+ *
+ */
+class RISTNetTsOptimizer {
+public:
+
+    static constexpr size_t kTsPacketSize = 188;
+    static constexpr uint16_t kNullPID = 0x1FFF;
+    static constexpr uint8_t kTsSyncByte = 0x47;
+    static constexpr uint8_t kTsOptimizedMarker = 0xB7;
+    static constexpr size_t kMaxPackets = 255;          // TS packets in one payload
+    static constexpr size_t kRawHeaderSize = 2;
+    static constexpr size_t kHeaderSize = 4;
+
+    struct RISTNetTsOptimizerSettings {
+        bool mDeleteNulls = true;
+        std::vector<uint16_t> mDropPIDs;                // Deleted and re-inserted as nulls
+    };
+
+    struct TsOptimizerStatistics {
+        uint64_t mPackets = 0;              // TS packets optimized
+        uint64_t mNullsDeleted = 0;
+        uint64_t mPIDsDropped = 0;          // Packets of blocked PIDs deleted
+        uint64_t mBytesIn = 0;              // Payload bytes optimized
+        uint64_t mBytesOut = 0;             // Payload bytes after optimizing
+        uint64_t mRestored = 0;             // Optimized payloads restored
+        uint64_t mRawReceived = 0;          // Payloads received as they were sent
+        uint64_t mRestoreErrors = 0;        // Payloads without a valid header
+    };
+
+    /// Constructor
+    RISTNetTsOptimizer();
+
+    /// Destructor
+    virtual ~RISTNetTsOptimizer();
+
+    /**
+     * @brief Initialize the optimizer
+     *
+     * @param The optimizer settings
+     * @return true on success
+     */
+    bool initOptimizer(RISTNetTsOptimizerSettings &rSettings);
+
+    /**
+     * @brief Optimize a payload
+     *
+     * @param the payload, whole TS packets
+     * @param the size
+     * @param the payload to send with its header
+     * @return true if packets were deleted, false if rOut holds the payload as it is (nothing deleted or not TS)
+     */
+    bool optimize(const uint8_t *pData, size_t lSize, std::vector<uint8_t> &rOut);
+
+    /**
+     * @brief Restore a payload
+     *
+     * @param the payload with its header
+     * @param the size
+     * @param the restored payload
+     * @return true on success, false if the header or the optimized payload is not valid
+     */
+    bool restore(const uint8_t *pData, size_t lSize, std::vector<uint8_t> &rOut);
+
+    /// The bytes not sent, the TS packets deleted minus the deletion maps
+    uint64_t getBytesSaved();
+
+    /// Get the optimizer statistics
+    void getStatistics(TsOptimizerStatistics &rStatistics);
+
+    // Delete copy and move constructors and assign operators
+    RISTNetTsOptimizer(RISTNetTsOptimizer const &) = delete;             // Copy construct
+    RISTNetTsOptimizer(RISTNetTsOptimizer &&) = delete;                  // Move construct
+    RISTNetTsOptimizer &operator=(RISTNetTsOptimizer const &) = delete;  // Copy assign
+    RISTNetTsOptimizer &operator=(RISTNetTsOptimizer &&) = delete;       // Move assign
+
+private:
+
+    static bool isFilled(const uint8_t *pData, size_t lSize, uint8_t lFill);
+
+    bool mDeleteNulls = true;
+    std::bitset<8192> mDropPIDs;
+
+    std::atomic<uint64_t> mPackets{0};
+    std::atomic<uint64_t> mNullsDeleted{0};
+    std::atomic<uint64_t> mPIDsDropped{0};
+    std::atomic<uint64_t> mBytesIn{0};
+    std::atomic<uint64_t> mBytesOut{0};
+    std::atomic<uint64_t> mRestored{0};
+    std::atomic<uint64_t> mRawReceived{0};
+    std::atomic<uint64_t> mRestoreErrors{0};
+};
+
+#endif //CPPRISTWRAPPER__RISTNETTSOPTIMIZER_H
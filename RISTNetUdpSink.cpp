@@ -0,0 +1,348 @@
+//
+// RISTNetUdpSink -- UDP (multicast) output of received data with batched sends
+//
+
+#include "RISTNetUdpSink.h"
+#include "RISTNetInternal.h"
+#include <arpa/inet.h>
+#include <cstring>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <unistd.h>
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+
+#define GSO_MAX_SEGMENTS 64
+#define GSO_MAX_BYTES 65000 // A GSO buffer is sent as one (fragmented) IP packet internally, stay below 64k
+
+RISTNetUdpSink::RISTNetUdpSink() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetUdpSink constructed")
+}
+
+RISTNetUdpSink::~RISTNetUdpSink() {
+    if (mInitialised) {
+        destroyUdpSink();
+    }
+    LOGGER(false, LOGG_NOTIFY, "RISTNetUdpSink destruct")
+}
+
+bool RISTNetUdpSink::openOutput(const UdpSinkOutput &rOutputSettings, Output &rOutput) {
+    sockaddr_storage lAddress = {};
+    socklen_t lAddressLength = 0;
+    bool lMulticast = false;
+    int lFamily = AF_INET;
+    in_addr lAddress4 = {};
+    in6_addr lAddress6 = {};
+    if (inet_pton(AF_INET, rOutputSettings.mAddress.c_str(), &lAddress4) == 1) {
+        auto *pAddress = (sockaddr_in *) &lAddress;
+        pAddress->sin_family = AF_INET;
+        pAddress->sin_port = htons(rOutputSettings.mPort);
+        pAddress->sin_addr = lAddress4;
+        lAddressLength = sizeof(sockaddr_in);
+        lMulticast = IN_MULTICAST(ntohl(lAddress4.s_addr));
+    } else if (inet_pton(AF_INET6, rOutputSettings.mAddress.c_str(), &lAddress6) == 1) {
+        auto *pAddress = (sockaddr_in6 *) &lAddress;
+        pAddress->sin6_family = AF_INET6;
+        pAddress->sin6_port = htons(rOutputSettings.mPort);
+        pAddress->sin6_addr = lAddress6;
+        lAddressLength = sizeof(sockaddr_in6);
+        lMulticast = IN6_IS_ADDR_MULTICAST(&lAddress6);
+        lFamily = AF_INET6;
+    } else {
+        LOGGER(true, LOGG_ERROR, "Not a valid IP address: " << rOutputSettings.mAddress)
+        return false;
+    }
+
+    int lSocket = socket(lFamily, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (lSocket < 0) {
+        LOGGER(true, LOGG_ERROR, "socket failed: " << strerror(errno))
+        return false;
+    }
+    rOutput.mSocket = lSocket;
+    if (mSettings.mSendBufferSize > 0) {
+        setsockopt(lSocket, SOL_SOCKET, SO_SNDBUF, &mSettings.mSendBufferSize, sizeof(mSettings.mSendBufferSize));
+    }
+    if (mSettings.mTOS > 0) {
+        int lResult = lFamily == AF_INET ?
+                      setsockopt(lSocket, IPPROTO_IP, IP_TOS, &mSettings.mTOS, sizeof(mSettings.mTOS)) :
+                      setsockopt(lSocket, IPPROTO_IPV6, IPV6_TCLASS, &mSettings.mTOS, sizeof(mSettings.mTOS));
+        if (lResult != 0) {
+            LOGGER(true, LOGG_WARN, "Setting TOS failed: " << strerror(errno))
+        }
+    }
+
+    if (lMulticast && lFamily == AF_INET) {
+        if (setsockopt(lSocket, IPPROTO_IP, IP_MULTICAST_TTL, &mSettings.mTTL, sizeof(mSettings.mTTL)) != 0) {
+            LOGGER(true, LOGG_WARN, "IP_MULTICAST_TTL failed: " << strerror(errno))
+        }
+        if (!rOutputSettings.mInterface.empty()) {
+            in_addr lInterface = {};
+            if (inet_pton(AF_INET, rOutputSettings.mInterface.c_str(), &lInterface) != 1 ||
+                setsockopt(lSocket, IPPROTO_IP, IP_MULTICAST_IF, &lInterface, sizeof(lInterface)) != 0) {
+                LOGGER(true, LOGG_ERROR, "Not a valid interface address: " << rOutputSettings.mInterface)
+                return false;
+            }
+        }
+    } else if (lMulticast) {
+        if (setsockopt(lSocket, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &mSettings.mTTL, sizeof(mSettings.mTTL)) != 0) {
+            LOGGER(true, LOGG_WARN, "IPV6_MULTICAST_HOPS failed: " << strerror(errno))
+        }
+        if (!rOutputSettings.mInterface.empty()) {
+            unsigned int lInterface = if_nametoindex(rOutputSettings.mInterface.c_str());
+            if (!lInterface ||
+                setsockopt(lSocket, IPPROTO_IPV6, IPV6_MULTICAST_IF, &lInterface, sizeof(lInterface)) != 0) {
+                LOGGER(true, LOGG_ERROR, "Unknown interface: " << rOutputSettings.mInterface)
+                return false;
+            }
+        }
+    }
+
+    // Connected so the messages need no address
+    if (connect(lSocket, (sockaddr *) &lAddress, lAddressLength) != 0) {
+        LOGGER(true, LOGG_ERROR, "connect failed: " << rOutputSettings.mAddress << ":" << rOutputSettings.mPort
+                                                    << " " << strerror(errno))
+        return false;
+    }
+    rOutput.mConnectionID = rOutputSettings.mConnectionID;
+    rOutput.mBuffer.resize(mSettings.mBatchSize * RIST_MAX_PACKET_SIZE);
+    rOutput.mSizes.reserve(mSettings.mBatchSize);
+    return true;
+}
+
+bool RISTNetUdpSink::initUdpSink(RISTNetUdpSinkSettings &rSettings) {
+    if (mInitialised) {
+        LOGGER(true, LOGG_ERROR, "RISTNetUdpSink already initialised.")
+        return false;
+    }
+    if (rSettings.mOutputs.empty() || !rSettings.mBatchSize) {
+        LOGGER(true, LOGG_ERROR, "No outputs or batch size not valid.")
+        return false;
+    }
+    mSettings = rSettings;
+    mOutputs.clear();
+    mOutputs.resize(mSettings.mOutputs.size());
+    for (size_t i = 0; i < mOutputs.size(); i++) {
+        if (!openOutput(mSettings.mOutputs[i], mOutputs[i])) {
+            closeSockets();
+            return false;
+        }
+    }
+
+    mUseGSO = false;
+#ifdef UDP_SEGMENT
+    if (mSettings.mUseGSO) {
+        int lSegmentSize = 0;
+        socklen_t lLength = sizeof(lSegmentSize);
+        mUseGSO = getsockopt(mOutputs[0].mSocket, SOL_UDP, UDP_SEGMENT, &lSegmentSize, &lLength) == 0;
+    }
+#endif
+    mMessages.resize(mSettings.mBatchSize);
+    mVectors.resize(mSettings.mBatchSize);
+    mControl.resize(mSettings.mBatchSize * CMSG_SPACE(sizeof(uint16_t)));
+    mMessageDatagrams.resize(mSettings.mBatchSize);
+
+    mStatistics = UdpSinkStatistics();
+    mStatistics.mGSO = mUseGSO;
+    mFlushRun = true;
+    mFlushThread = std::thread(&RISTNetUdpSink::flushWorker, this);
+    mInitialised = true;
+    return true;
+}
+
+bool RISTNetUdpSink::attachReceiver(RISTNetReceiver &rReceiver) {
+    if (!mInitialised) {
+        LOGGER(true, LOGG_ERROR, "RISTNetUdpSink not initialised.")
+        return false;
+    }
+    rReceiver.networkDataCallback = [this](const uint8_t *pBuf, size_t lSize,
+                                           std::shared_ptr<RISTNetReceiver::NetworkConnection> &rConnection,
+                                           rist_peer *pPeer, uint16_t lConnectionID) {
+        sendData(pBuf, lSize, lConnectionID);
+        return 0;
+    };
+    return true;
+}
+
+bool RISTNetUdpSink::sendData(const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID) {
+    if (lSize > RIST_MAX_PACKET_SIZE) {
+        LOGGER(true, LOGG_ERROR, "Data too large for a datagram: " << lSize)
+        return false;
+    }
+    std::lock_guard<std::mutex> lLock(mOutputMtx);
+    if (!mInitialised) {
+        return false;
+    }
+    bool lQueued = false;
+    for (auto &rOutput: mOutputs) {
+        if (rOutput.mConnectionID != kAllFlows && rOutput.mConnectionID != lConnectionID) {
+            continue;
+        }
+        if (rOutput.mBufferUsed + lSize > rOutput.mBuffer.size()) {
+            flushOutput(rOutput);
+        }
+        if (rOutput.mSizes.empty()) {
+            rOutput.mDeadline = std::chrono::steady_clock::now() + mSettings.mFlushDeadline;
+            mFlushCondition.notify_one();
+        }
+        memcpy(rOutput.mBuffer.data() + rOutput.mBufferUsed, pBuf, lSize);
+        rOutput.mBufferUsed += lSize;
+        rOutput.mSizes.push_back(lSize);
+        if (rOutput.mSizes.size() >= mSettings.mBatchSize) {
+            flushOutput(rOutput);
+        }
+        lQueued = true;
+    }
+    return lQueued;
+}
+
+void RISTNetUdpSink::flushOutput(Output &rOutput) {
+    if (rOutput.mSizes.empty()) {
+        return;
+    }
+    const size_t lControlSize = CMSG_SPACE(sizeof(uint16_t));
+
+    // Build the messages, with GSO a run of equally sized payloads is one message
+    size_t lMessageCount = 0;
+    size_t lOffset = 0;
+    for (size_t i = 0; i < rOutput.mSizes.size();) {
+        uint16_t lSegmentSize = rOutput.mSizes[i];
+        size_t lRun = 1;
+        if (mUseGSO && lSegmentSize) {
+            while (i + lRun < rOutput.mSizes.size() && rOutput.mSizes[i + lRun] == lSegmentSize &&
+                   lRun < GSO_MAX_SEGMENTS && (lRun + 1) * lSegmentSize <= GSO_MAX_BYTES) {
+                lRun++;
+            }
+        }
+        mVectors[lMessageCount] = {rOutput.mBuffer.data() + lOffset, lRun * lSegmentSize};
+        mMessages[lMessageCount] = {};
+        msghdr &rHeader = mMessages[lMessageCount].msg_hdr;
+        rHeader.msg_iov = &mVectors[lMessageCount];
+        rHeader.msg_iovlen = 1;
+#ifdef UDP_SEGMENT
+        if (lRun > 1) {
+            rHeader.msg_control = &mControl[lMessageCount * lControlSize];
+            rHeader.msg_controllen = lControlSize;
+            cmsghdr *pControl = CMSG_FIRSTHDR(&rHeader);
+            pControl->cmsg_level = SOL_UDP;
+            pControl->cmsg_type = UDP_SEGMENT;
+            pControl->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            memcpy(CMSG_DATA(pControl), &lSegmentSize, sizeof(lSegmentSize));
+        }
+#endif
+        mMessageDatagrams[lMessageCount] = lRun;
+        lMessageCount++;
+        lOffset += lRun * lSegmentSize;
+        i += lRun;
+    }
+
+    size_t lSent = 0;
+    while (lSent < lMessageCount) {
+        int lResult = sendmmsg(rOutput.mSocket, &mMessages[lSent], lMessageCount - lSent, 0);
+        mStatistics.mSyscalls++;
+        if (lResult < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (mUseGSO && (errno == EIO || errno == EINVAL) && mMessages[lSent].msg_hdr.msg_controllen) {
+                // The route or device can not segment, send the payloads one by one from now on
+                LOGGER(true, LOGG_WARN, "UDP GSO failed, disabled: " << strerror(errno))
+                mUseGSO = false;
+                mStatistics.mGSO = false;
+                size_t lSkipped = 0;
+                for (size_t i = 0; i < lSent; i++) {
+                    lSkipped += mMessageDatagrams[i];
+                }
+                rOutput.mSizes.erase(rOutput.mSizes.begin(), rOutput.mSizes.begin() + lSkipped);
+                size_t lSkippedBytes = (uint8_t *) mVectors[lSent].iov_base - rOutput.mBuffer.data();
+                memmove(rOutput.mBuffer.data(), rOutput.mBuffer.data() + lSkippedBytes,
+                        rOutput.mBufferUsed - lSkippedBytes);
+                rOutput.mBufferUsed -= lSkippedBytes;
+                flushOutput(rOutput);
+                return;
+            }
+            // Connection refused (no listener) and the like, skip the message
+            mStatistics.mSendErrors += mMessageDatagrams[lSent];
+            lSent++;
+            continue;
+        }
+        for (int i = 0; i < lResult; i++) {
+            mStatistics.mPackets += mMessageDatagrams[lSent + i];
+            mStatistics.mBytes += mVectors[lSent + i].iov_len;
+        }
+        lSent += lResult;
+    }
+    rOutput.mSizes.clear();
+    rOutput.mBufferUsed = 0;
+}
+
+void RISTNetUdpSink::flush() {
+    std::lock_guard<std::mutex> lLock(mOutputMtx);
+    for (auto &rOutput: mOutputs) {
+        flushOutput(rOutput);
+    }
+}
+
+void RISTNetUdpSink::flushWorker() {
+    std::unique_lock<std::mutex> lLock(mOutputMtx);
+    while (mFlushRun) {
+        auto lNextDeadline = std::chrono::steady_clock::time_point::max();
+        for (auto &rOutput: mOutputs) {
+            if (!rOutput.mSizes.empty()) {
+                lNextDeadline = std::min(lNextDeadline, rOutput.mDeadline);
+            }
+        }
+        if (lNextDeadline == std::chrono::steady_clock::time_point::max()) {
+            mFlushCondition.wait(lLock);
+            continue;
+        }
+        if (mFlushCondition.wait_until(lLock, lNextDeadline) == std::cv_status::no_timeout) {
+            continue; // New data or stop, compute the deadline again
+        }
+        auto lNow = std::chrono::steady_clock::now();
+        for (auto &rOutput: mOutputs) {
+            if (!rOutput.mSizes.empty() && rOutput.mDeadline <= lNow) {
+                flushOutput(rOutput);
+                mStatistics.mDeadlineFlushes++;
+            }
+        }
+    }
+}
+
+void RISTNetUdpSink::getStatistics(UdpSinkStatistics &rStatistics) {
+    std::lock_guard<std::mutex> lLock(mOutputMtx);
+    rStatistics = mStatistics;
+}
+
+void RISTNetUdpSink::closeSockets() {
+    for (auto &rOutput: mOutputs) {
+        if (rOutput.mSocket >= 0) {
+            close(rOutput.mSocket);
+            rOutput.mSocket = -1;
+        }
+    }
+}
+
+bool RISTNetUdpSink::destroyUdpSink() {
+    if (!mInitialised) {
+        LOGGER(true, LOGG_WARN, "RISTNetUdpSink not initialised.")
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lLock(mOutputMtx);
+        mFlushRun = false;
+    }
+    mFlushCondition.notify_one();
+    if (mFlushThread.joinable()) {
+        mFlushThread.join();
+    }
+    std::lock_guard<std::mutex> lLock(mOutputMtx);
+    for (auto &rOutput: mOutputs) {
+        flushOutput(rOutput);
+    }
+    closeSockets();
+    mInitialised = false;
+    return true;
+}
@@ -0,0 +1,157 @@
+//
+// RISTNetUdpSink -- UDP (multicast) output of received data with batched sends
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETUDPSINK_H
+#define CPPRISTWRAPPER__RISTNETUDPSINK_H
+
+#include "RISTNet.h"
+#include <chrono>
+#include <condition_variable>
+#include <sys/socket.h>
+#include <thread>
+
+/**
+ * \class RISTNetUdpSink
+ *
+ * \brief
+ *
+ * A RISTNetUdpSink re-emits received payloads as UDP datagrams, one payload is one datagram. Payloads are
+ * queued per output and sent in one syscall when the batch is full or the flush deadline expires.
+ * Runs of equally sized payloads are sent as one UDP_SEGMENT (GSO) buffer where the kernel supports it,
+ * the runs of a batch are sent with one sendmmsg.
+ *
+ * Every output can be limited to one flow id (connection id).
+ *
+ */
+class RISTNetUdpSink {
+public:
+
+    static const uint32_t kAllFlows = 0xffffffff;
+
+    struct UdpSinkOutput {
+        std::string mAddress;              // Destination IP, IPv4 or IPv6, unicast or multicast
+        uint16_t mPort = 0;
+        std::string mInterface;            // Multicast: local IPv4 address (IPv4) or interface name (IPv6). Empty is default.
+        uint32_t mConnectionID = kAllFlows; // Only payloads from this flow id (connection id), kAllFlows for all
+    };
+
+    struct RISTNetUdpSinkSettings {
+        std::vector<UdpSinkOutput> mOutputs;
+        size_t mBatchSize = 32;             // Datagrams per flush
+        std::chrono::microseconds mFlushDeadline{1000}; // Max time a payload is queued
+        int mTTL = 16;                      // Multicast TTL / hop limit, unicast uses the system default
+        int mTOS = 0;                       // IP TOS / traffic class byte (DSCP << 2), 0 leaves it unset
+        bool mUseGSO = true;                // Ignored if the kernel does not support UDP_SEGMENT
+        int mSendBufferSize = 4 * 1024 * 1024;
+    };
+
+    struct UdpSinkStatistics {
+        uint64_t mPackets = 0;          // Datagrams sent
+        uint64_t mBytes = 0;
+        uint64_t mSyscalls = 0;         // Send syscalls made
+        uint64_t mDeadlineFlushes = 0;  // Flushes of a partial batch because the deadline expired
+        uint64_t mSendErrors = 0;       // Datagrams not sent
+        bool mGSO = false;              // UDP_SEGMENT in use
+    };
+
+    /// Constructor
+    RISTNetUdpSink();
+
+    /// Destructor
+    virtual ~RISTNetUdpSink();
+
+    /**
+     * @brief Initialize the UDP sink
+     *
+     * Opens a socket per output and starts the flush thread.
+     *
+     * @param The UDP sink settings
+     * @return true on success
+     */
+    bool initUdpSink(RISTNetUdpSinkSettings &rSettings);
+
+    /**
+     * @brief Attach a receiver
+     *
+     * Sends all data received by the receiver. This replaces the networkDataCallback of the receiver.
+     * The sink must outlive the receiver.
+     *
+     * @param the receiver
+     * @return true on success
+     */
+    bool attachReceiver(RISTNetReceiver &rReceiver);
+
+    /**
+     * @brief Send data
+     *
+     * Queues the data on every output matching the connection id.
+     *
+     * @param pointer to the data
+     * @param length of the data, max RIST_MAX_PACKET_SIZE
+     * @param the connection id (flow id)
+     * @return true if the data was queued on at least one output
+     */
+    bool sendData(const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID = 0);
+
+    /// Send everything queued now
+    void flush();
+
+    /// Get the UDP sink statistics
+    void getStatistics(UdpSinkStatistics &rStatistics);
+
+    /**
+     * @brief Destroys the UDP sink
+     *
+     * Sends what is queued, stops the flush thread and closes the sockets.
+     *
+     */
+    bool destroyUdpSink();
+
+    // Delete copy and move constructors and assign operators
+    RISTNetUdpSink(RISTNetUdpSink const &) = delete;             // Copy construct
+    RISTNetUdpSink(RISTNetUdpSink &&) = delete;                  // Move construct
+    RISTNetUdpSink &operator=(RISTNetUdpSink const &) = delete;  // Copy assign
+    RISTNetUdpSink &operator=(RISTNetUdpSink &&) = delete;       // Move assign
+
+private:
+
+    struct Output {
+        int mSocket = -1;
+        uint32_t mConnectionID = kAllFlows;
+        std::vector<uint8_t> mBuffer;       // Queued payloads back to back
+        size_t mBufferUsed = 0;
+        std::vector<uint16_t> mSizes;       // Size of every queued payload
+        std::chrono::steady_clock::time_point mDeadline;
+    };
+
+    bool openOutput(const UdpSinkOutput &rOutputSettings, Output &rOutput);
+    void flushOutput(Output &rOutput);
+    void closeSockets();
+    void flushWorker();
+
+    RISTNetUdpSinkSettings mSettings;
+    bool mInitialised = false;
+    bool mUseGSO = false;
+
+    // The mutex protecting the outputs and the statistics
+    std::mutex mOutputMtx;
+    std::condition_variable mFlushCondition;
+    std::vector<Output> mOutputs;
+    UdpSinkStatistics mStatistics;
+    // Scratch space of flushOutput, one entry per message
+    std::vector<mmsghdr> mMessages;
+    std::vector<iovec> mVectors;
+    std::vector<uint8_t> mControl;
+    std::vector<size_t> mMessageDatagrams;
+    bool mFlushRun = false;
+    std::thread mFlushThread;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETUDPSINK_H
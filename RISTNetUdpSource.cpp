@@ -0,0 +1,307 @@
+//
+// RISTNetUdpSource -- UDP/RTP (multicast) ingest into a RISTNetSender
+//
+
+#include "RISTNetUdpSource.h"
+#include "RISTNetInternal.h"
+#include <arpa/inet.h>
+#include <cstring>
+#include <fcntl.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define RTP_VERSION 2
+#define RTP_HEADER_SIZE 12
+
+// Returns the payload of an RTP packet, false if the packet is not a valid RTP packet
+static bool stripRTP(const uint8_t *pBuf, size_t lSize, size_t &rOffset, size_t &rPayloadSize) {
+    if (lSize < RTP_HEADER_SIZE || (pBuf[0] >> 6) != RTP_VERSION) {
+        return false;
+    }
+    size_t lHeaderSize = RTP_HEADER_SIZE + (pBuf[0] & 0x0f) * 4;
+    if (pBuf[0] & 0x10) {
+        // Header extension, 16 bit profile then 16 bit length in 32 bit words
+        if (lSize < lHeaderSize + 4) {
+            return false;
+        }
+        lHeaderSize += 4 + (((size_t) pBuf[lHeaderSize + 2] << 8) | pBuf[lHeaderSize + 3]) * 4;
+    }
+    size_t lPadding = (pBuf[0] & 0x20) ? pBuf[lSize - 1] : 0;
+    if (lHeaderSize + lPadding > lSize) {
+        return false;
+    }
+    rOffset = lHeaderSize;
+    rPayloadSize = lSize - lHeaderSize - lPadding;
+    return true;
+}
+
+RISTNetUdpSource::RISTNetUdpSource() {
+    LOGGER(false, LOGG_NOTIFY, "RISTNetUdpSource constructed")
+}
+
+RISTNetUdpSource::~RISTNetUdpSource() {
+    if (!mSockets.empty()) {
+        destroyUdpSource();
+    }
+    LOGGER(false, LOGG_NOTIFY, "RISTNetUdpSource destruct")
+}
+
+int RISTNetUdpSource::openInput(const UdpSourceInput &rInput) {
+    sockaddr_storage lAddress = {};
+    socklen_t lAddressLength = 0;
+    bool lMulticast = false;
+    int lFamily = AF_INET;
+    in_addr lAddress4 = {};
+    in6_addr lAddress6 = {};
+    if (inet_pton(AF_INET, rInput.mAddress.c_str(), &lAddress4) == 1) {
+        auto *pAddress = (sockaddr_in *) &lAddress;
+        pAddress->sin_family = AF_INET;
+        pAddress->sin_port = htons(rInput.mPort);
+        pAddress->sin_addr = lAddress4;
+        lAddressLength = sizeof(sockaddr_in);
+        lMulticast = IN_MULTICAST(ntohl(lAddress4.s_addr));
+    } else if (inet_pton(AF_INET6, rInput.mAddress.c_str(), &lAddress6) == 1) {
+        auto *pAddress = (sockaddr_in6 *) &lAddress;
+        pAddress->sin6_family = AF_INET6;
+        pAddress->sin6_port = htons(rInput.mPort);
+        pAddress->sin6_addr = lAddress6;
+        lAddressLength = sizeof(sockaddr_in6);
+        lMulticast = IN6_IS_ADDR_MULTICAST(&lAddress6);
+        lFamily = AF_INET6;
+    } else {
+        LOGGER(true, LOGG_ERROR, "Not a valid IP address: " << rInput.mAddress)
+        return -1;
+    }
+
+    int lSocket = socket(lFamily, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (lSocket < 0) {
+        LOGGER(true, LOGG_ERROR, "socket failed: " << strerror(errno))
+        return -1;
+    }
+    int lOn = 1;
+    setsockopt(lSocket, SOL_SOCKET, SO_REUSEADDR, &lOn, sizeof(lOn));
+    if (mSettings.mReusePort && setsockopt(lSocket, SOL_SOCKET, SO_REUSEPORT, &lOn, sizeof(lOn)) != 0) {
+        LOGGER(true, LOGG_WARN, "SO_REUSEPORT failed: " << strerror(errno))
+    }
+#ifdef SO_BUSY_POLL
+    if (mSettings.mBusyPollMicroseconds > 0 &&
+        setsockopt(lSocket, SOL_SOCKET, SO_BUSY_POLL, &mSettings.mBusyPollMicroseconds,
+                   sizeof(mSettings.mBusyPollMicroseconds)) != 0) {
+        LOGGER(true, LOGG_WARN, "SO_BUSY_POLL failed: " << strerror(errno))
+    }
+#endif
+    if (mSettings.mReceiveBufferSize > 0) {
+        setsockopt(lSocket, SOL_SOCKET, SO_RCVBUF, &mSettings.mReceiveBufferSize,
+                   sizeof(mSettings.mReceiveBufferSize));
+    }
+    if (bind(lSocket, (sockaddr *) &lAddress, lAddressLength) != 0) {
+        LOGGER(true, LOGG_ERROR, "bind failed: " << rInput.mAddress << ":" << rInput.mPort << " " << strerror(errno))
+        close(lSocket);
+        return -1;
+    }
+
+    if (lMulticast && lFamily == AF_INET) {
+        ip_mreq lRequest = {};
+        lRequest.imr_multiaddr = lAddress4;
+        lRequest.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (!rInput.mInterface.empty() && inet_pton(AF_INET, rInput.mInterface.c_str(), &lRequest.imr_interface) != 1) {
+            LOGGER(true, LOGG_ERROR, "Not a valid interface address: " << rInput.mInterface)
+            close(lSocket);
+            return -1;
+        }
+        if (setsockopt(lSocket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &lRequest, sizeof(lRequest)) != 0) {
+            LOGGER(true, LOGG_ERROR, "IP_ADD_MEMBERSHIP failed: " << rInput.mAddress << " " << strerror(errno))
+            close(lSocket);
+            return -1;
+        }
+    } else if (lMulticast) {
+        ipv6_mreq lRequest = {};
+        lRequest.ipv6mr_multiaddr = lAddress6;
+        lRequest.ipv6mr_interface = rInput.mInterface.empty() ? 0 : if_nametoindex(rInput.mInterface.c_str());
+        if (!rInput.mInterface.empty() && !lRequest.ipv6mr_interface) {
+            LOGGER(true, LOGG_ERROR, "Unknown interface: " << rInput.mInterface)
+            close(lSocket);
+            return -1;
+        }
+        if (setsockopt(lSocket, IPPROTO_IPV6, IPV6_JOIN_GROUP, &lRequest, sizeof(lRequest)) != 0) {
+            LOGGER(true, LOGG_ERROR, "IPV6_JOIN_GROUP failed: " << rInput.mAddress << " " << strerror(errno))
+            close(lSocket);
+            return -1;
+        }
+    }
+    return lSocket;
+}
+
+bool RISTNetUdpSource::initUdpSource(RISTNetUdpSourceSettings &rSettings) {
+    if (!mSockets.empty()) {
+        LOGGER(true, LOGG_ERROR, "RISTNetUdpSource already initialised.")
+        return false;
+    }
+    if (rSettings.mInputs.empty() || !rSettings.mBatchSize) {
+        LOGGER(true, LOGG_ERROR, "No inputs or batch size not valid.")
+        return false;
+    }
+    mSettings = rSettings;
+    for (auto &rInput: mSettings.mInputs) {
+        int lSocket = openInput(rInput);
+        if (lSocket < 0) {
+            closeSockets();
+            return false;
+        }
+        mSockets.push_back(lSocket);
+    }
+    if (pipe2(mWakePipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+        LOGGER(true, LOGG_ERROR, "pipe failed: " << strerror(errno))
+        closeSockets();
+        return false;
+    }
+    mStatistics = UdpSourceStatistics();
+    return true;
+}
+
+bool RISTNetUdpSource::startUdpSource(RISTNetSender &rSender) {
+    packetCallback = [&rSender](const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID) {
+        return rSender.sendData(pBuf, lSize, lConnectionID);
+    };
+    return startUdpSource();
+}
+
+bool RISTNetUdpSource::startUdpSource() {
+    if (mSockets.empty()) {
+        LOGGER(true, LOGG_ERROR, "RISTNetUdpSource not initialised.")
+        return false;
+    }
+    if (!packetCallback) {
+        LOGGER(true, LOGG_ERROR, "packetCallback not set.")
+        return false;
+    }
+    if (mReceiveThread.joinable()) {
+        LOGGER(true, LOGG_ERROR, "RISTNetUdpSource already started.")
+        return false;
+    }
+    mReceiveRun = true;
+    mReceiveThread = std::thread(&RISTNetUdpSource::receiveWorker, this);
+    return true;
+}
+
+void RISTNetUdpSource::receiveWorker() {
+    const size_t lBatchSize = mSettings.mBatchSize;
+    // One extra byte per datagram so a datagram larger than RIST_MAX_PACKET_SIZE is detected
+    const size_t lSlotSize = RIST_MAX_PACKET_SIZE + 1;
+    std::vector<uint8_t> lBuffer(lBatchSize * lSlotSize);
+    std::vector<iovec> lVectors(lBatchSize);
+    std::vector<mmsghdr> lMessages(lBatchSize);
+
+    std::vector<pollfd> lPollDescriptors;
+    for (int lSocket: mSockets) {
+        lPollDescriptors.push_back({lSocket, POLLIN, 0});
+    }
+    lPollDescriptors.push_back({mWakePipe[0], POLLIN, 0});
+    // With busy polling the thread spins on poll instead of sleeping in it
+    int lPollTimeout = mSettings.mBusyPollMicroseconds > 0 ? 0 : -1;
+
+    while (mReceiveRun) {
+        if (poll(lPollDescriptors.data(), lPollDescriptors.size(), lPollTimeout) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOGGER(true, LOGG_ERROR, "poll failed: " << strerror(errno))
+            break;
+        }
+        for (size_t lInput = 0; lInput < mSockets.size(); lInput++) {
+            if (!(lPollDescriptors[lInput].revents & POLLIN)) {
+                continue;
+            }
+            for (size_t i = 0; i < lBatchSize; i++) {
+                lVectors[i] = {&lBuffer[i * lSlotSize], lSlotSize};
+                lMessages[i] = {};
+                lMessages[i].msg_hdr.msg_iov = &lVectors[i];
+                lMessages[i].msg_hdr.msg_iovlen = 1;
+            }
+            int lCount = recvmmsg(mSockets[lInput], lMessages.data(), lBatchSize, MSG_DONTWAIT, nullptr);
+            if (lCount <= 0) {
+                continue;
+            }
+
+            const UdpSourceInput &rInput = mSettings.mInputs[lInput];
+            UdpSourceStatistics lBatch;
+            lBatch.mReceiveCalls = 1;
+            for (int i = 0; i < lCount; i++) {
+                const uint8_t *pData = &lBuffer[i * lSlotSize];
+                size_t lSize = lMessages[i].msg_len;
+                if (lSize > RIST_MAX_PACKET_SIZE || (lMessages[i].msg_hdr.msg_flags & MSG_TRUNC)) {
+                    lBatch.mTruncated++;
+                    continue;
+                }
+                if (rInput.mStripRTP) {
+                    size_t lOffset = 0;
+                    if (!stripRTP(pData, lSize, lOffset, lSize)) {
+                        lBatch.mInvalidRTP++;
+                        continue;
+                    }
+                    pData += lOffset;
+                }
+                if (!lSize) {
+                    continue;
+                }
+                if (packetCallback(pData, lSize, rInput.mConnectionID)) {
+                    lBatch.mPackets++;
+                    lBatch.mBytes += lSize;
+                } else {
+                    lBatch.mSendFailures++;
+                }
+            }
+
+            std::lock_guard<std::mutex> lLock(mStatisticsMtx);
+            mStatistics.mPackets += lBatch.mPackets;
+            mStatistics.mBytes += lBatch.mBytes;
+            mStatistics.mReceiveCalls += lBatch.mReceiveCalls;
+            mStatistics.mTruncated += lBatch.mTruncated;
+            mStatistics.mInvalidRTP += lBatch.mInvalidRTP;
+            mStatistics.mSendFailures += lBatch.mSendFailures;
+        }
+        if (lPollDescriptors.back().revents & POLLIN) {
+            uint8_t lDrain[16];
+            while (read(mWakePipe[0], lDrain, sizeof(lDrain)) > 0) {
+            }
+        }
+    }
+}
+
+void RISTNetUdpSource::getStatistics(UdpSourceStatistics &rStatistics) {
+    std::lock_guard<std::mutex> lLock(mStatisticsMtx);
+    rStatistics = mStatistics;
+}
+
+void RISTNetUdpSource::closeSockets() {
+    for (int lSocket: mSockets) {
+        close(lSocket);
+    }
+    mSockets.clear();
+    for (int &rDescriptor: mWakePipe) {
+        if (rDescriptor >= 0) {
+            close(rDescriptor);
+            rDescriptor = -1;
+        }
+    }
+}
+
+bool RISTNetUdpSource::destroyUdpSource() {
+    if (mSockets.empty()) {
+        LOGGER(true, LOGG_WARN, "RISTNetUdpSource not initialised.")
+        return false;
+    }
+    mReceiveRun = false;
+    if (mReceiveThread.joinable()) {
+        uint8_t lWake = 1;
+        if (write(mWakePipe[1], &lWake, sizeof(lWake)) < 0) {
+            LOGGER(true, LOGG_WARN, "Wake write failed: " << strerror(errno))
+        }
+        mReceiveThread.join();
+    }
+    closeSockets();
+    return true;
+}
@@ -0,0 +1,131 @@
+//
+// RISTNetUdpSource -- UDP/RTP (multicast) ingest into a RISTNetSender
+//
+
+// Prefixes used
+// m class member
+// p pointer (*)
+// r reference (&)
+// l local scope
+
+#ifndef CPPRISTWRAPPER__RISTNETUDPSOURCE_H
+#define CPPRISTWRAPPER__RISTNETUDPSOURCE_H
+
+#include "RISTNet.h"
+#include <thread>
+
+/**
+ * \class RISTNetUdpSource
+ *
+ * \brief
+ *
+ * A RISTNetUdpSource receives UDP or RTP over UDP (unicast or multicast) from one or more sockets and feeds
+ * every datagram to a RISTNetSender (or the packet callback), one datagram is one sendData call so packet
+ * boundaries are preserved. Every input has its own flow id (connection id) and RTP setting.
+ *
+ * The sockets are read in batches with recvmmsg from one receive thread. Optionally the sockets use
+ * SO_REUSEPORT (several processes/sources sharing a port) and SO_BUSY_POLL.
+ *
+ */
+class RISTNetUdpSource {
+public:
+
+    struct UdpSourceInput {
+        std::string mAddress;          // Local IP to bind or multicast group, IPv4 or IPv6
+        uint16_t mPort = 0;
+        std::string mInterface;        // Multicast: local IPv4 address (IPv4) or interface name (IPv6). Empty is any.
+        uint16_t mConnectionID = 0;    // Passed as connection id (flow id) to sendData
+        bool mStripRTP = false;        // Remove the RTP header (and padding) before sending
+    };
+
+    struct RISTNetUdpSourceSettings {
+        std::vector<UdpSourceInput> mInputs;
+        size_t mBatchSize = 64;             // Datagrams per recvmmsg call
+        bool mReusePort = false;
+        int mBusyPollMicroseconds = 0;      // SO_BUSY_POLL and a spinning receive thread, 0 means sleep in poll
+        int mReceiveBufferSize = 8 * 1024 * 1024;
+    };
+
+    struct UdpSourceStatistics {
+        uint64_t mPackets = 0;          // Datagrams delivered
+        uint64_t mBytes = 0;            // Bytes delivered (after RTP stripping)
+        uint64_t mReceiveCalls = 0;     // recvmmsg calls returning data
+        uint64_t mTruncated = 0;        // Datagrams larger than RIST_MAX_PACKET_SIZE, dropped
+        uint64_t mInvalidRTP = 0;       // Datagrams without a valid RTP header on an RTP input, dropped
+        uint64_t mSendFailures = 0;     // Datagrams the packet callback (or sendData) did not accept
+    };
+
+    /// Constructor
+    RISTNetUdpSource();
+
+    /// Destructor
+    virtual ~RISTNetUdpSource();
+
+    /**
+     * @brief Initialize the UDP source
+     *
+     * Opens, binds and joins (multicast) all inputs.
+     *
+     * @param The UDP source settings
+     * @return true on success
+     */
+    bool initUdpSource(RISTNetUdpSourceSettings &rSettings);
+
+    /**
+     * @brief Start sending to a sender
+     *
+     * Starts the receive thread sending every datagram using sendData. The sender must outlive the source.
+     *
+     * @param the sender
+     * @return true on success
+     */
+    bool startUdpSource(RISTNetSender &rSender);
+
+    /**
+     * @brief Start sending to the packet callback
+     *
+     * Starts the receive thread delivering every datagram to packetCallback.
+     *
+     * @return true on success
+     */
+    bool startUdpSource();
+
+    /// Get the UDP source statistics
+    void getStatistics(UdpSourceStatistics &rStatistics);
+
+    /**
+     * @brief Destroys the UDP source
+     *
+     * Stops the receive thread and closes all sockets.
+     *
+     */
+    bool destroyUdpSource();
+
+    /// Callback getting the datagrams when started without a sender. Return false if the datagram was not accepted.
+    std::function<bool(const uint8_t *pBuf, size_t lSize, uint16_t lConnectionID)> packetCallback = nullptr;
+
+    // Delete copy and move constructors and assign operators
+    RISTNetUdpSource(RISTNetUdpSource const &) = delete;             // Copy construct
+    RISTNetUdpSource(RISTNetUdpSource &&) = delete;                  // Move construct
+    RISTNetUdpSource &operator=(RISTNetUdpSource const &) = delete;  // Copy assign
+    RISTNetUdpSource &operator=(RISTNetUdpSource &&) = delete;       // Move assign
+
+private:
+
+    int openInput(const UdpSourceInput &rInput);
+    void closeSockets();
+    void receiveWorker();
+
+    RISTNetUdpSourceSettings mSettings;
+    std::vector<int> mSockets;        // One per input, same order as mSettings.mInputs
+    int mWakePipe[2] = {-1, -1};
+
+    std::thread mReceiveThread;
+    std::atomic<bool> mReceiveRun = false;
+
+    // Written by the receive thread only, read with getStatistics
+    std::mutex mStatisticsMtx;
+    UdpSourceStatistics mStatistics;
+};
+
+#endif //CPPRISTWRAPPER__RISTNETUDPSOURCE_H
@@ -0,0 +1,54 @@
+#include <thread>
+
+#include <benchmark/benchmark.h>
+
+#include "RISTNetMockTransport.h"
+
+// Two peers on the librist thread (the thread injecting), the data callback of the first blocks for 1 ms with arg 1.
+// Arg 0 enables the watchdog, the default settings offload the slow peer after 8 violations. The time is the one of the librist thread.
+static void BM_WatchdogReceive(benchmark::State& state) {
+    bool watchdog = state.range(0);
+    bool slow = state.range(1);
+    RISTNetReceiver receiver;
+    receiver.validateConnectionCallback = [](const std::string& ipAddress, uint16_t port) {
+        auto connection = std::make_shared<RISTNetReceiver::NetworkConnection>();
+        connection->mObject = (int)port;
+        return connection;
+    };
+    receiver.networkDataCallback = [slow](const uint8_t* pBuf, size_t size,
+                                          std::shared_ptr<RISTNetReceiver::NetworkConnection>& rConnection,
+                                          rist_peer* pPeer, uint16_t connectionID) {
+        if (slow && std::any_cast<int>(rConnection->mObject) == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return 0;
+    };
+    RISTNetMockTransport transport;
+    RISTNetReceiver::RISTNetReceiverSettings settings;
+    settings.mCallbackWatchdog = watchdog;
+    transport.attachReceiver(receiver, settings);
+    rist_peer* peers[2] = {transport.connectPeer("10.0.0.1", 0), transport.connectPeer("10.0.0.2", 1)};
+
+    std::vector<uint8_t> packet(1316);
+    uint64_t seq = 0;
+    for (auto _ : state) {
+        transport.injectData(peers[seq & 1], packet.data(), packet.size(), 1, seq);
+        seq++;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * packet.size());
+    RISTNetCallbackWatchdog::WatchdogStatistics statistics;
+    if (receiver.getWatchdogStatistics(statistics)) {
+        // Of the packets received, the offload thread is not as fast as the librist thread here
+        state.counters["offloaded"] = (double)statistics.mQueued / (double)state.iterations();
+        state.counters["dropped"] = (double)statistics.mDropped / (double)state.iterations();
+    }
+    transport.detach();
+}
+BENCHMARK(BM_WatchdogReceive)
+    ->ArgNames({"watchdog", "slow"})
+    ->Args({0, 0})
+    ->Args({1, 0})
+    ->Args({0, 1})
+    ->Args({1, 1})
+    ->UseRealTime();
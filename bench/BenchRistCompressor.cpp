@@ -0,0 +1,57 @@
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <string>
+
+#include "RISTNetCompressor.h"
+
+namespace {
+// Arg 0 JSON telemetry, 1 random bytes
+std::vector<uint8_t> makePayload(int kind) {
+    std::vector<uint8_t> payload;
+    std::mt19937 random(42);
+    while (payload.size() < 1316) {
+        if (kind == 0) {
+            std::string json = "{\"sensor\":\"temperature\",\"index\":" + std::to_string(payload.size()) +
+                               ",\"value\":" + std::to_string(20 + random() % 5) + ",\"status\":\"ok\"}";
+            payload.insert(payload.end(), json.begin(), json.end());
+        } else {
+            payload.push_back(random());
+        }
+    }
+    payload.resize(1316);
+    return payload;
+}
+} // namespace
+
+static void BM_Compress(benchmark::State& state) {
+    RISTNetCompressor compressor;
+    RISTNetCompressor::RISTNetCompressorSettings settings;
+    compressor.initCompressor(settings);
+    auto payload = makePayload(state.range(0));
+    std::vector<uint8_t> compressed;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(compressor.compress(payload.data(), payload.size(), 0, compressed));
+    }
+    RISTNetCompressor::CompressorStatistics statistics;
+    compressor.getStatistics(statistics);
+    state.counters["ratio"] = statistics.mRatio;
+    state.counters["compress_ns"] = (double)statistics.mCompressNs / state.iterations();
+    state.SetBytesProcessed(state.iterations() * payload.size());
+}
+BENCHMARK(BM_Compress)->Arg(0)->Arg(1);
+
+static void BM_Decompress(benchmark::State& state) {
+    RISTNetCompressor compressor;
+    RISTNetCompressor::RISTNetCompressorSettings settings;
+    compressor.initCompressor(settings);
+    auto payload = makePayload(0);
+    std::vector<uint8_t> compressed;
+    compressor.compress(payload.data(), payload.size(), 0, compressed);
+    std::vector<uint8_t> decompressed;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(compressor.decompress(compressed.data(), compressed.size(), decompressed));
+    }
+    state.SetBytesProcessed(state.iterations() * payload.size());
+}
+BENCHMARK(BM_Decompress);
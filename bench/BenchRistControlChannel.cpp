@@ -0,0 +1,140 @@
+#include <benchmark/benchmark.h>
+
+#include <condition_variable>
+#include <thread>
+
+#include "RISTNetControlChannel.h"
+#include "RISTNetMockTransport.h"
+
+namespace {
+constexpr uint16_t kKeyframeRequest = 1;
+} // namespace
+
+// Request to response through two mock transports, the framing and dispatch cost without the network
+static void BM_ControlRoundTripMock(benchmark::State& state) {
+    RISTNetReceiver receiver;
+    RISTNetSender sender;
+    receiver.validateConnectionCallback = [](const std::string& ipAddress, uint16_t port) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    sender.validateConnectionCallback = [](const std::string& ipAddress, uint16_t port) {
+        return std::make_shared<RISTNetSender::NetworkConnection>();
+    };
+    RISTNetMockTransport receiverTransport;
+    RISTNetMockTransport senderTransport;
+    rist_peer* receiverPeer = nullptr;
+    rist_peer* senderPeer = nullptr;
+    receiverTransport.oobWriteCallback = [&](const rist_oob_block& rOOBBlock) {
+        return senderTransport.injectOOBData(senderPeer, (const uint8_t*)rOOBBlock.payload, rOOBBlock.payload_len);
+    };
+    senderTransport.oobWriteCallback = [&](const rist_oob_block& rOOBBlock) {
+        return receiverTransport.injectOOBData(receiverPeer, (const uint8_t*)rOOBBlock.payload, rOOBBlock.payload_len);
+    };
+    RISTNetControlChannel receiverChannel;
+    RISTNetControlChannel senderChannel;
+    senderChannel.setHandler(kKeyframeRequest, [&](const RISTNetControlChannel::ControlMessage& rMessage) {
+        senderChannel.respond(rMessage, rMessage.pPayload, rMessage.mSize);
+    });
+    uint64_t responses = 0;
+    receiverChannel.responseCallback = [&](const RISTNetControlChannel::ControlMessage& rResponse, uint64_t userData,
+                                           std::chrono::nanoseconds roundTrip) { responses++; };
+    receiverChannel.attachReceiver(receiver);
+    senderChannel.attachSender(sender);
+    RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    receiverTransport.attachReceiver(receiver, receiverSettings);
+    senderTransport.attachSender(sender, senderSettings);
+    receiverPeer = receiverTransport.connectPeer("10.0.0.2", 2000);
+    senderPeer = senderTransport.connectPeer("10.0.0.1", 1000);
+
+    std::vector<uint8_t> payload(state.range(0));
+    for (auto _ : state) {
+        receiverChannel.request(receiverPeer, kKeyframeRequest, payload.data(), payload.size());
+    }
+    state.counters["responses"] = responses;
+    senderTransport.detach();
+    receiverTransport.detach();
+}
+BENCHMARK(BM_ControlRoundTripMock)->Arg(16)->Arg(256);
+
+// Request from the receiver to the sender and back over librist on loopback, needs librist with OOB support
+static void BM_ControlRoundTripLoopback(benchmark::State& state) {
+    RISTNetReceiver receiver;
+    std::mutex mtx;
+    std::condition_variable condition;
+    rist_peer* peer = nullptr;
+    bool responded = false;
+    receiver.validateConnectionCallback = [](const std::string& ipAddress, uint16_t port) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    // The sender peer, from the data it sends
+    receiver.networkDataBlockCallback = [&](const rist_data_block& rDataBlock,
+                                            std::shared_ptr<RISTNetReceiver::NetworkConnection>& rConnection) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!peer) {
+            peer = rDataBlock.peer;
+            condition.notify_one();
+        }
+        return 0;
+    };
+    RISTNetControlChannel receiverChannel;
+    receiverChannel.responseCallback = [&](const RISTNetControlChannel::ControlMessage& rResponse, uint64_t userData,
+                                           std::chrono::nanoseconds roundTrip) {
+        std::lock_guard<std::mutex> lock(mtx);
+        responded = true;
+        condition.notify_one();
+    };
+    receiverChannel.attachReceiver(receiver);
+    std::string url;
+    RISTNetTools::buildRISTURL("127.0.0.1", "8100", url, true);
+    std::vector<std::string> receiverInterfaces = {url};
+    RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+    if (!receiver.initReceiver(receiverInterfaces, receiverSettings)) {
+        state.SkipWithError("initReceiver failed");
+        return;
+    }
+
+    RISTNetSender sender;
+    RISTNetControlChannel senderChannel;
+    senderChannel.setHandler(kKeyframeRequest, [&](const RISTNetControlChannel::ControlMessage& rMessage) {
+        senderChannel.respond(rMessage, nullptr, 0);
+    });
+    senderChannel.attachSender(sender);
+    RISTNetTools::buildRISTURL("127.0.0.1", "8100", url, false);
+    std::vector<std::tuple<std::string, int>> senderInterfaces = {{url, 5}};
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    if (!sender.initSender(senderInterfaces, senderSettings)) {
+        state.SkipWithError("initSender failed");
+        return;
+    }
+    std::vector<uint8_t> packet(188);
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        for (int i = 0; i < 20 && !peer; i++) {
+            lock.unlock();
+            sender.sendData(packet.data(), packet.size());
+            lock.lock();
+            condition.wait_for(lock, std::chrono::milliseconds(50), [&] { return peer != nullptr; });
+        }
+        if (!peer) {
+            state.SkipWithError("No connection");
+            return;
+        }
+    }
+
+    for (auto _ : state) {
+        std::unique_lock<std::mutex> lock(mtx);
+        responded = false;
+        lock.unlock();
+        receiverChannel.request(peer, kKeyframeRequest, nullptr, 0);
+        lock.lock();
+        if (!condition.wait_for(lock, std::chrono::seconds(1), [&] { return responded; })) {
+            state.SkipWithError("No response, OOB not supported by librist?");
+            break;
+        }
+    }
+    RISTNetControlChannel::ControlStatistics statistics;
+    receiverChannel.getStatistics(statistics);
+    state.counters["timeouts"] = statistics.mTimeouts;
+}
+BENCHMARK(BM_ControlRoundTripLoopback)->UseRealTime()->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,111 @@
+#include <benchmark/benchmark.h>
+
+#include "RISTNetCoroutine.h"
+
+// The raw path, librist calling networkDataCallback
+static void BM_CallbackReceive(benchmark::State& state) {
+    RISTNetReceiver receiver;
+    uint64_t bytes = 0;
+    receiver.networkDataCallback = [&](const uint8_t* data, size_t size,
+                                       std::shared_ptr<RISTNetReceiver::NetworkConnection>& connection,
+                                       rist_peer* peer, uint16_t connectionID) {
+        bytes += size;
+        return 0;
+    };
+    std::vector<uint8_t> packet(1316);
+    std::shared_ptr<RISTNetReceiver::NetworkConnection> connection;
+    for (auto _ : state) {
+        receiver.networkDataCallback(packet.data(), packet.size(), connection, nullptr, 0);
+    }
+    benchmark::DoNotOptimize(bytes);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CallbackReceive);
+
+// The same packets copied to a pool buffer, the raw path of networkBufferCallback
+static void BM_BufferCallbackReceive(benchmark::State& state) {
+    RISTNetReceiver receiver;
+    uint64_t bytes = 0;
+    receiver.networkBufferCallback = [&](RISTNetPacketBuffer& buffer,
+                                         std::shared_ptr<RISTNetReceiver::NetworkConnection>& connection,
+                                         rist_peer* peer, uint16_t connectionID) {
+        bytes += buffer.size();
+        return 0;
+    };
+    std::vector<uint8_t> packet(1316);
+    std::shared_ptr<RISTNetReceiver::NetworkConnection> connection;
+    for (auto _ : state) {
+        auto buffer = RISTNetPacketPool::defaultPool().copy(packet.data(), packet.size());
+        receiver.networkBufferCallback(buffer, connection, nullptr, 0);
+    }
+    benchmark::DoNotOptimize(bytes);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BufferCallbackReceive);
+
+static RISTNetTask readLoop(RISTNetCoReceiver& coReceiver, uint64_t& bytes) {
+    while (true) {
+        auto packet = co_await coReceiver.read();
+        if (!packet.mData) {
+            break;
+        }
+        bytes += packet.mData.size();
+    }
+}
+
+// co_await read() with the executor resuming the reader after state.range(0) packets
+static void BM_CoroutineReceive(benchmark::State& state) {
+    RISTNetLoopExecutor executor;
+    RISTNetReceiver receiver;
+    RISTNetCoReceiver coReceiver(executor, 1024);
+    coReceiver.attachReceiver(receiver);
+    uint64_t bytes = 0;
+    readLoop(coReceiver, bytes);
+
+    std::vector<uint8_t> packet(1316);
+    std::shared_ptr<RISTNetReceiver::NetworkConnection> connection;
+    int64_t batch = state.range(0);
+    for (auto _ : state) {
+        for (int64_t i = 0; i < batch; i++) {
+            auto buffer = RISTNetPacketPool::defaultPool().copy(packet.data(), packet.size());
+            receiver.networkBufferCallback(buffer, connection, nullptr, 0);
+        }
+        executor.poll();
+    }
+    coReceiver.close();
+    executor.poll();
+    benchmark::DoNotOptimize(bytes);
+    state.counters["dropped"] = coReceiver.getDropped();
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_CoroutineReceive)->Arg(1)->Arg(16)->Arg(256);
+
+static RISTNetTask sendLoop(RISTNetLoopExecutor& executor, RISTNetCoSender& coSender, const std::vector<uint8_t>& packet,
+                            std::atomic<bool>& stop, std::atomic<uint64_t>& sends) {
+    co_await executor.schedule();
+    while (!stop) {
+        co_await coSender.send(packet.data(), packet.size());
+        sends++;
+    }
+    coSender.close();
+    executor.stop();
+}
+
+// co_await send() against a send function discarding the data, suspending when the send thread falls behind
+static void BM_CoroutineSend(benchmark::State& state) {
+    RISTNetLoopExecutor executor;
+    RISTNetCoSender coSender(executor, 256);
+    coSender.attachSendFunction([](const uint8_t* data, size_t size, uint16_t connectionID) { return true; });
+    std::vector<uint8_t> packet(1316);
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> sends{0};
+    sendLoop(executor, coSender, packet, stop, sends);
+    std::thread loop([&]() { executor.run(); });
+    for (auto _ : state) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    stop = true;
+    loop.join();
+    state.SetItemsProcessed(sends);
+}
+BENCHMARK(BM_CoroutineSend)->Iterations(20)->UseRealTime();
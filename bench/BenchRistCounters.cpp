@@ -0,0 +1,66 @@
+#include <benchmark/benchmark.h>
+
+#include <thread>
+
+#include "RISTNetCounters.h"
+
+// What receiveData adds per packet, a flow with sequence check and a peer
+static void BM_CountFlowAndPeer(benchmark::State& state) {
+    RISTNetCounterTable flows;
+    RISTNetCounterTable peers;
+    uint64_t seq = 0;
+    for (auto _ : state) {
+        flows.countPacket(1, 1316, false, false, seq++);
+        peers.countPacket(0x7f0012345678, 1316, false, false);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CountFlowAndPeer);
+
+// Interleaved flows, the last key cache misses every packet
+static void BM_CountInterleavedFlows(benchmark::State& state) {
+    RISTNetCounterTable flows;
+    uint64_t flowCount = state.range(0);
+    uint64_t packet = 0;
+    for (auto _ : state) {
+        flows.countPacket(packet % flowCount, 1316, false, false, packet / flowCount);
+        packet++;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CountInterleavedFlows)->Arg(2)->Arg(16)->Arg(128);
+
+// The writer while a thread takes snapshots continuously
+static void BM_CountWithReader(benchmark::State& state) {
+    RISTNetCounterTable flows;
+    std::atomic<bool> stop{false};
+    std::thread reader([&]() {
+        std::vector<RISTNetCounterSnapshot> counters;
+        while (!stop) {
+            flows.getCounters(counters);
+            std::this_thread::yield();
+        }
+    });
+    uint64_t seq = 0;
+    for (auto _ : state) {
+        flows.countPacket(seq % 8, 1316, false, false, seq / 8);
+        seq++;
+    }
+    stop = true;
+    reader.join();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CountWithReader);
+
+static void BM_Snapshot(benchmark::State& state) {
+    RISTNetCounterTable flows;
+    for (int64_t key = 0; key < state.range(0); key++) {
+        flows.countPacket(key, 1316, false);
+    }
+    std::vector<RISTNetCounterSnapshot> counters;
+    for (auto _ : state) {
+        flows.getCounters(counters);
+        benchmark::DoNotOptimize(counters.data());
+    }
+}
+BENCHMARK(BM_Snapshot)->Arg(1)->Arg(64);
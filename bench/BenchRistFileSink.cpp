@@ -0,0 +1,51 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include <benchmark/benchmark.h>
+
+#include "RISTNetFileSink.h"
+
+namespace {
+const size_t kPacketSize = 1316;
+
+std::string benchDirectory() {
+    const char* directory = std::getenv("RISTNET_BENCH_DIR");
+    return directory ? std::string(directory) + "/" : std::string("/tmp/");
+}
+} // namespace
+
+// Every benchmark thread records its own channel, the aggregate rate is the sum over the threads.
+// Arg 0: O_DIRECT off/on. Set RISTNET_BENCH_DIR to a directory on the disk to measure.
+static void BM_FileSinkRecord(benchmark::State& state) {
+    RISTNetFileSink sink;
+    RISTNetFileSink::RISTNetFileSinkSettings settings;
+    settings.mPath = benchDirectory() + "ristnet_bench_sink_" + std::to_string(state.thread_index()) + ".ts";
+    settings.mDirectIO = state.range(0);
+    settings.mFsyncPolicy = RISTNetFileSink::FsyncPolicy::kNone;
+    settings.mSegmentMaxBytes = 1024 * 1024 * 1024;
+    if (!sink.initFileSink(settings)) {
+        state.SkipWithError("initFileSink failed");
+        return;
+    }
+
+    std::vector<uint8_t> packet(kPacketSize, 0x47);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(sink.writeData(packet.data(), packet.size()));
+    }
+    sink.destroyFileSink();
+
+    RISTNetFileSink::FileSinkStatistics stats;
+    sink.getStatistics(stats);
+    state.SetBytesProcessed(state.iterations() * kPacketSize);
+    state.counters["written_bps"] =
+            benchmark::Counter(stats.mBytesWritten * 8.0, benchmark::Counter::kIsRate);
+    state.counters["dropped_pct"] = benchmark::Counter(
+            100.0 * stats.mDroppedPackets / std::max<uint64_t>(stats.mPackets + stats.mDroppedPackets, 1),
+            benchmark::Counter::kAvgThreads);
+    for (uint64_t i = 0; i < stats.mSegments; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "_%06llu.ts", (unsigned long long)i);
+        std::remove((benchDirectory() + "ristnet_bench_sink_" + std::to_string(state.thread_index()) + name).c_str());
+    }
+}
+BENCHMARK(BM_FileSinkRecord)->Arg(0)->Arg(1)->ThreadRange(1, 8)->UseRealTime()->MinTime(2.0);
@@ -0,0 +1,58 @@
+#include <benchmark/benchmark.h>
+
+#include "RISTNetInternal.h"
+
+// A LOGGER at a disabled level, what every debug site costs in production
+static void BM_LoggerDisabled(benchmark::State& state) {
+    RISTNetLog::setLevel(RIST_LOG_ERROR);
+    int value = 0;
+    for (auto _ : state) {
+        LOGGER(true, LOGG_NOTIFY, "Packet " << value)
+        benchmark::DoNotOptimize(value++);
+    }
+    RISTNetLog::setLevel(RIST_LOG_NOTICE);
+}
+BENCHMARK(BM_LoggerDisabled);
+
+// An enabled LOGGER over its rate limit, a loss warning burst after the first records
+static void BM_LoggerRateLimited(benchmark::State& state) {
+    RISTNetLog::globalLog().logSinkCallback = [](const RISTNetLogRecord& record) {};
+    RISTNetLog::RISTNetLogSettings settings;
+    RISTNetLog::globalLog().startLog(settings);
+    int value = 0;
+    for (auto _ : state) {
+        LOGGER(true, LOGG_WARN, "Packet " << value)
+        benchmark::DoNotOptimize(value++);
+    }
+    RISTNetLog::globalLog().stopLog();
+    RISTNetLog::globalLog().logSinkCallback = nullptr;
+}
+BENCHMARK(BM_LoggerRateLimited);
+
+// An enabled LOGGER put in the ring, from 1 to 4 threads. The sink discards the records.
+static void BM_LoggerAsync(benchmark::State& state) {
+    if (state.thread_index() == 0) {
+        RISTNetLog::globalLog().logSinkCallback = [](const RISTNetLogRecord& record) {};
+        RISTNetLog::RISTNetLogSettings settings;
+        settings.mRateLimitBurst = UINT32_MAX;
+        settings.mDrainInterval = std::chrono::milliseconds(1);
+        RISTNetLog::globalLog().startLog(settings);
+    }
+    int value = 0;
+    for (auto _ : state) {
+        LOGGER(true, LOGG_WARN, "Packet " << value)
+        benchmark::DoNotOptimize(value++);
+    }
+    if (state.thread_index() == 0) {
+        RISTNetLog::globalLog().stopLog();
+        RISTNetLog::RISTNetLogSettings defaults;
+        RISTNetLog::globalLog().startLog(defaults);
+        RISTNetLog::globalLog().stopLog();
+        RISTNetLog::globalLog().logSinkCallback = nullptr;
+        RISTNetLog::LogStatistics stats;
+        RISTNetLog::globalLog().getStatistics(stats);
+        state.counters["dropped"] = stats.mDropped;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LoggerAsync)->ThreadRange(1, 4)->UseRealTime();
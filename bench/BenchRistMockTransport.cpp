@@ -0,0 +1,95 @@
+#include <benchmark/benchmark.h>
+
+#include "RISTNetMockTransport.h"
+
+// The wrapper alone, no sockets and no librist. Arg 0 selects the receive callback, arg 1 the peers connected.
+enum BenchCallback { kDataCallback, kBufferCallback, kDataBlockCallback, kEventQueue };
+
+static void BM_MockReceive(benchmark::State& state) {
+    RISTNetReceiver receiver;
+    receiver.validateConnectionCallback = [](const std::string& ipAddress, uint16_t port) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    switch (state.range(0)) {
+        case kDataCallback:
+            receiver.networkDataCallback = [](const uint8_t* pBuf, size_t size,
+                                              std::shared_ptr<RISTNetReceiver::NetworkConnection>& rConnection,
+                                              rist_peer* pPeer, uint16_t connectionID) { return 0; };
+            break;
+        case kBufferCallback:
+            receiver.networkBufferCallback = [](RISTNetPacketBuffer& rBuffer,
+                                                std::shared_ptr<RISTNetReceiver::NetworkConnection>& rConnection,
+                                                rist_peer* pPeer, uint16_t connectionID) { return 0; };
+            break;
+        case kDataBlockCallback:
+            receiver.networkDataBlockCallback = [](const rist_data_block& rDataBlock,
+                                                   std::shared_ptr<RISTNetReceiver::NetworkConnection>& rConnection) {
+                return 0;
+            };
+            break;
+    }
+    RISTNetMockTransport transport;
+    RISTNetReceiver::RISTNetReceiverSettings settings;
+    settings.mEventQueueSize = state.range(0) == kEventQueue ? 1024 : 0;
+    transport.attachReceiver(receiver, settings);
+    std::vector<rist_peer*> peers;
+    for (int64_t i = 0; i < state.range(1); i++) {
+        peers.push_back(transport.connectPeer("10.0.0.1", i));
+    }
+
+    std::vector<uint8_t> packet(1316);
+    std::vector<RISTNetReceiver::NetworkEvent> events;
+    uint64_t seq = 0;
+    for (auto _ : state) {
+        transport.injectData(peers[seq % peers.size()], packet.data(), packet.size(), 1, seq);
+        seq++;
+        if (state.range(0) == kEventQueue && !(seq & 255)) {
+            receiver.drain(events, SIZE_MAX);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * packet.size());
+}
+BENCHMARK(BM_MockReceive)
+    ->ArgNames({"callback", "peers"})
+    ->Args({kDataCallback, 1})
+    ->Args({kBufferCallback, 1})
+    ->Args({kDataBlockCallback, 1})
+    ->Args({kEventQueue, 1})
+    ->Args({kDataCallback, 1000});
+
+// clientConnect and clientDisconnect with peers already connected
+static void BM_MockConnectDisconnect(benchmark::State& state) {
+    RISTNetReceiver receiver;
+    receiver.validateConnectionCallback = [](const std::string& ipAddress, uint16_t port) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    receiver.clientDisconnectedCallback = [](const std::shared_ptr<RISTNetReceiver::NetworkConnection>& rConnection,
+                                             const rist_peer& rPeer) {};
+    RISTNetMockTransport transport;
+    RISTNetReceiver::RISTNetReceiverSettings settings;
+    transport.attachReceiver(receiver, settings);
+    for (int64_t i = 0; i < state.range(0); i++) {
+        transport.connectPeer("10.0.0.1", i);
+    }
+    for (auto _ : state) {
+        rist_peer* pPeer = transport.connectPeer("10.0.0.2", 5000);
+        transport.disconnectPeer(pPeer);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MockConnectDisconnect)->Arg(0)->Arg(100)->Arg(1000);
+
+static void BM_MockSendData(benchmark::State& state) {
+    RISTNetSender sender;
+    RISTNetMockTransport transport;
+    RISTNetSender::RISTNetSenderSettings settings;
+    transport.attachSender(sender, settings);
+    std::vector<uint8_t> packet(state.range(0));
+    for (auto _ : state) {
+        sender.sendData(packet.data(), packet.size(), 1);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * packet.size());
+}
+BENCHMARK(BM_MockSendData)->Arg(188)->Arg(1316);
@@ -0,0 +1,130 @@
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "RISTNetPacketPool.h"
+
+namespace {
+const size_t kPacketSize = 1316;
+const size_t kRingSize = 1024;
+
+// Single producer single consumer ring handing the packets to the thread releasing them
+template <typename T>
+class HandoverRing {
+public:
+    bool push(T& rItem) {
+        size_t head = mHead.load(std::memory_order_relaxed);
+        if (head - mTail.load(std::memory_order_acquire) == kRingSize) {
+            return false;
+        }
+        mItems[head % kRingSize] = std::move(rItem);
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+    bool pop(T& rItem) {
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail == mHead.load(std::memory_order_acquire)) {
+            return false;
+        }
+        rItem = std::move(mItems[tail % kRingSize]);
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    alignas(64) std::atomic<size_t> mHead{0};
+    alignas(64) std::atomic<size_t> mTail{0};
+    T mItems[kRingSize];
+};
+
+// Releases the handed over packets until stopped
+template <typename T, typename Release>
+std::thread startConsumer(HandoverRing<T>& rRing, std::atomic<bool>& rRun, Release release) {
+    return std::thread([&rRing, &rRun, release]() {
+        T item{};
+        while (rRun.load(std::memory_order_relaxed)) {
+            while (rRing.pop(item)) {
+                release(item);
+            }
+            std::this_thread::yield();
+        }
+        while (rRing.pop(item)) {
+            release(item);
+        }
+    });
+}
+}  // namespace
+
+// Allocate, fill and release a packet on the same thread
+static void BM_MallocSameThread(benchmark::State& state) {
+    std::vector<uint8_t> packet(kPacketSize, 0x47);
+    for (auto _ : state) {
+        auto* pBuffer = (uint8_t*)malloc(kPacketSize);
+        memcpy(pBuffer, packet.data(), kPacketSize);
+        benchmark::DoNotOptimize(pBuffer);
+        free(pBuffer);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MallocSameThread);
+
+static void BM_PoolSameThread(benchmark::State& state) {
+    RISTNetPacketPool pool;
+    RISTNetPacketPool::RISTNetPacketPoolSettings settings;
+    settings.mHugePages = (RISTNetPacketPool::HugePages)state.range(0);
+    pool.initPacketPool(settings);
+    std::vector<uint8_t> packet(kPacketSize, 0x47);
+    for (auto _ : state) {
+        RISTNetPacketBuffer buffer = pool.copy(packet.data(), kPacketSize);
+        benchmark::DoNotOptimize(buffer.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PoolSameThread)->Arg(0)->Arg(1)->Arg(2);
+
+// Allocate on the producer (the benchmark thread), release on a consumer thread, the pattern of a receive
+// callback queueing payloads to a worker
+static void BM_MallocCrossThread(benchmark::State& state) {
+    HandoverRing<uint8_t*> ring;
+    std::atomic<bool> run{true};
+    std::thread consumer = startConsumer(ring, run, [](uint8_t* pBuffer) { free(pBuffer); });
+    std::vector<uint8_t> packet(kPacketSize, 0x47);
+    for (auto _ : state) {
+        auto* pBuffer = (uint8_t*)malloc(kPacketSize);
+        memcpy(pBuffer, packet.data(), kPacketSize);
+        while (!ring.push(pBuffer)) {
+            std::this_thread::yield();
+        }
+    }
+    run = false;
+    consumer.join();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MallocCrossThread)->UseRealTime();
+
+static void BM_PoolCrossThread(benchmark::State& state) {
+    RISTNetPacketPool pool;
+    RISTNetPacketPool::RISTNetPacketPoolSettings settings;
+    pool.initPacketPool(settings);
+    HandoverRing<RISTNetPacketBuffer> ring;
+    std::atomic<bool> run{true};
+    std::thread consumer = startConsumer(ring, run, [](RISTNetPacketBuffer& rBuffer) { rBuffer.reset(); });
+    std::vector<uint8_t> packet(kPacketSize, 0x47);
+    for (auto _ : state) {
+        RISTNetPacketBuffer buffer = pool.copy(packet.data(), kPacketSize);
+        while (!ring.push(buffer)) {
+            std::this_thread::yield();
+        }
+    }
+    run = false;
+    consumer.join();
+    RISTNetPacketPool::PacketPoolStatistics stats;
+    pool.getStatistics(stats);
+    state.counters["reserved_mb"] = stats.mBytesReserved / (1024.0 * 1024.0);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PoolCrossThread)->UseRealTime();
@@ -0,0 +1,36 @@
+#include <benchmark/benchmark.h>
+
+#include <thread>
+
+#include "RISTNetPlayout.h"
+
+// Scheduling and playing out packets of many flows on the one timer thread, arg is the number of flows
+static void BM_PlayoutFlows(benchmark::State& state) {
+    RISTNetPlayout playout;
+    RISTNetPlayout::RISTNetPlayoutSettings settings;
+    settings.mDelay = std::chrono::milliseconds(20);
+    settings.mUseSenderTime = false;
+    settings.mMaxPacketsPerFlow = 1 << 20;
+    playout.initPlayout(settings);
+    std::atomic<uint64_t> played{0};
+    playout.playoutCallback = [&](RISTNetPacketBuffer& rBuffer, uint32_t flowID) { played++; };
+    std::vector<uint8_t> payload(1316);
+    rist_data_block block{};
+    block.payload = payload.data();
+    block.payload_len = payload.size();
+    uint32_t flows = state.range(0);
+    uint64_t packet = 0;
+    for (auto _ : state) {
+        block.flow_id = packet++ % flows;
+        playout.pushPacket(block);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    RISTNetPlayout::PlayoutStatistics statistics;
+    playout.getStatistics(statistics);
+    playout.destroyPlayout();
+    state.counters["played"] = played.load();
+    state.counters["overruns"] = statistics.mOverruns;
+    state.counters["max_lateness_us"] = statistics.mMaxLateness.count();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PlayoutFlows)->Arg(1)->Arg(64)->Arg(1024)->Iterations(200000);
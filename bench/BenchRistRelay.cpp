@@ -0,0 +1,84 @@
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include <benchmark/benchmark.h>
+
+#include "RISTNetRelay.h"
+
+namespace {
+const size_t kPacketSize = 1316;
+const uint16_t kFirstPort = 19000;
+}  // namespace
+
+// Fan-out of one stream to 100 outputs. Every output sends its packets as UDP datagrams on the loopback interface
+// (a stand-in for a RISTNetSender), nobody reads them so the kernel discards them after the send.
+// The stream is pushed as fast as possible, when the workers can not keep up the queues drop (dropped_pct).
+// Arg 0: worker threads. Reports the delivered rate over all outputs, the drops and the worst lag of an output.
+static void BM_RelayFanOut100(benchmark::State& state) {
+    const size_t kOutputs = 100;
+    RISTNetRelay relay;
+    RISTNetRelay::RISTNetRelaySettings settings;
+    settings.mThreads = state.range(0);
+    relay.initRelay(settings);
+
+    std::vector<int> sockets;
+    std::vector<uint32_t> outputIDs;
+    RISTNetRelay::RelayOutputSettings outputSettings;
+    outputSettings.mQueueSize = 4096;
+    for (size_t i = 0; i < kOutputs; i++) {
+        int sock = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in destination = {};
+        destination.sin_family = AF_INET;
+        destination.sin_port = htons(kFirstPort + i);
+        inet_pton(AF_INET, "127.0.0.1", &destination.sin_addr);
+        connect(sock, (sockaddr*)&destination, sizeof(destination));
+        sockets.push_back(sock);
+        outputIDs.push_back(relay.addOutput(
+                [sock](const uint8_t* buf, size_t size, uint16_t connectionId) {
+                    send(sock, buf, size, 0);
+                    return true;
+                },
+                outputSettings));
+    }
+
+    std::vector<uint8_t> packet(kPacketSize, 0x47);
+    auto start = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        relay.pushData(packet.data(), packet.size());
+    }
+    // Let the outputs drain so the delivered rate covers all of the work
+    for (uint32_t id : outputIDs) {
+        for (int i = 0; i < 1000; i++) {
+            RISTNetRelay::RelayOutputStatistics stats;
+            relay.getOutputStatistics(id, stats);
+            if (!stats.mQueued && !stats.mLag.count()) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    uint64_t sent = 0;
+    uint64_t dropped = 0;
+    std::chrono::microseconds maxLag{0};
+    for (uint32_t id : outputIDs) {
+        RISTNetRelay::RelayOutputStatistics stats;
+        relay.getOutputStatistics(id, stats);
+        sent += stats.mSent;
+        dropped += stats.mDropped;
+        maxLag = std::max(maxLag, stats.mMaxLag);
+    }
+    relay.destroyRelay();
+    for (int sock : sockets) {
+        close(sock);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["delivered_pps"] = sent / elapsed.count();
+    state.counters["dropped_pct"] = 100.0 * dropped / std::max<uint64_t>(sent + dropped, 1);
+    state.counters["max_lag_us"] = maxLag.count();
+}
+BENCHMARK(BM_RelayFanOut100)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime()->Iterations(20000);
@@ -0,0 +1,145 @@
+#include <atomic>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "RISTNet.h"
+
+namespace {
+constexpr size_t kPeers = 500;
+constexpr auto kLatency = std::chrono::milliseconds(2);
+
+// A local name server answering every A query after kLatency, 64 queries at a time. peerN.bench is 10.0.N/256.N%256.
+class StubNameServer {
+public:
+    StubNameServer() {
+        mSocket = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in lAddress{};
+        lAddress.sin_family = AF_INET;
+        lAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(mSocket, (sockaddr *) &lAddress, sizeof(lAddress));
+        socklen_t lSize = sizeof(lAddress);
+        getsockname(mSocket, (sockaddr *) &lAddress, &lSize);
+        mPort = ntohs(lAddress.sin_port);
+        for (int i = 0; i < 64; i++) {
+            mThreads.emplace_back(&StubNameServer::serve, this);
+        }
+    }
+
+    ~StubNameServer() {
+        mRun = false;
+        for (auto &rThread: mThreads) {
+            rThread.join();
+        }
+        close(mSocket);
+    }
+
+    std::string address() const {
+        return "127.0.0.1:" + std::to_string(mPort);
+    }
+
+private:
+    void serve() {
+        uint8_t lQuery[512];
+        while (mRun) {
+            pollfd lPoll{mSocket, POLLIN, 0};
+            if (poll(&lPoll, 1, 20) <= 0) {
+                continue;
+            }
+            sockaddr_in lFrom{};
+            socklen_t lFromSize = sizeof(lFrom);
+            ssize_t lSize = recvfrom(mSocket, lQuery, sizeof(lQuery), MSG_DONTWAIT, (sockaddr *) &lFrom, &lFromSize);
+            if (lSize < 17) {
+                continue;
+            }
+            std::string lLabel((char *) lQuery + 13, lQuery[12]);
+            uint32_t lPeer = (uint32_t) std::strtoul(lLabel.c_str() + 4, nullptr, 10);
+            std::vector<uint8_t> lAnswer(lQuery, lQuery + lSize);
+            lAnswer[2] = 0x81;
+            lAnswer[3] = 0x80;
+            lAnswer[7] = 1;
+            lAnswer.insert(lAnswer.end(), {0xc0, 12, 0, 1, 0, 1, 0, 0, 0x0e, 0x10, 0, 4, 10, 0,
+                                           (uint8_t) (lPeer >> 8), (uint8_t) lPeer});
+            std::this_thread::sleep_for(kLatency);
+            sendto(mSocket, lAnswer.data(), lAnswer.size(), 0, (sockaddr *) &lFrom, lFromSize);
+        }
+    }
+
+    int mSocket;
+    uint16_t mPort = 0;
+    std::atomic<bool> mRun{true};
+    std::vector<std::thread> mThreads;
+};
+
+StubNameServer &stubNameServer() {
+    static StubNameServer lServer;
+    return lServer;
+}
+
+void initResolver(RISTNetResolver &rResolver, size_t lThreads) {
+    RISTNetResolver::RISTNetResolverSettings lSettings;
+    lSettings.mThreads = lThreads;
+    lSettings.mFamily = AF_INET;
+    lSettings.mNameServers = {stubNameServer().address()};
+    rResolver.initResolver(lSettings);
+}
+
+std::vector<std::tuple<std::string, std::string>> peers() {
+    std::vector<std::tuple<std::string, std::string>> lPeers;
+    for (size_t i = 0; i < kPeers; i++) {
+        lPeers.emplace_back("peer" + std::to_string(i) + ".bench", "8000");
+    }
+    return lPeers;
+}
+}  // namespace
+
+// Startup as before, every peer resolved and waited for in turn
+static void BM_ResolveStartupSerial(benchmark::State& state) {
+    RISTNetResolver resolver;
+    initResolver(resolver, 1);
+    auto lPeers = peers();
+    for (auto _ : state) {
+        resolver.flushCache();
+        for (auto& rPeer : lPeers) {
+            RISTNetResolver::Resolution resolution;
+            benchmark::DoNotOptimize(resolver.resolveBlocking(std::get<0>(rPeer), resolution));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kPeers);
+}
+BENCHMARK(BM_ResolveStartupSerial)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Startup with the URLs of every peer built at once. Arg 0: resolver threads.
+static void BM_ResolveStartupParallel(benchmark::State& state) {
+    RISTNetResolver resolver;
+    initResolver(resolver, state.range(0));
+    auto lPeers = peers();
+    std::vector<std::string> urls;
+    for (auto _ : state) {
+        resolver.flushCache();
+        if (!RISTNetTools::buildRISTURLs(lPeers, urls, false, &resolver)) {
+            state.SkipWithError("Not resolved");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kPeers);
+}
+BENCHMARK(BM_ResolveStartupParallel)->Arg(4)->Arg(16)->Arg(64)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// A restart within the TTL, every peer cached
+static void BM_ResolveStartupCached(benchmark::State& state) {
+    RISTNetResolver resolver;
+    initResolver(resolver, 4);
+    auto lPeers = peers();
+    std::vector<std::string> urls;
+    RISTNetTools::buildRISTURLs(lPeers, urls, false, &resolver);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(RISTNetTools::buildRISTURLs(lPeers, urls, false, &resolver));
+    }
+    state.SetItemsProcessed(state.iterations() * kPeers);
+}
+BENCHMARK(BM_ResolveStartupCached)->Unit(benchmark::kMicrosecond);
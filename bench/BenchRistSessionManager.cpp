@@ -0,0 +1,83 @@
+#include <map>
+
+#include <benchmark/benchmark.h>
+
+#include "RISTNetMockTransport.h"
+#include "RISTNetSessionManager.h"
+
+namespace {
+// Receivers attached to mock transports instead of librist, the cost measured is the manager's
+void attachMocks(RISTNetSessionManager& manager, std::map<uint32_t, std::unique_ptr<RISTNetMockTransport>>& mocks) {
+    manager.initCallback = [&mocks](uint32_t channelID, RISTNetReceiver& receiver, std::vector<std::string>& urls,
+                                    RISTNetReceiver::RISTNetReceiverSettings& settings) {
+        auto& transport = mocks[channelID];
+        transport = std::make_unique<RISTNetMockTransport>();
+        return transport->attachReceiver(receiver, settings);
+    };
+}
+
+void addChannels(RISTNetSessionManager& manager, uint32_t channels) {
+    for (uint32_t i = 0; i < channels; i++) {
+        manager.addChannel(i, {"rist://@0.0.0.0:" + std::to_string(10000 + i % 50000)});
+    }
+}
+}  // namespace
+
+// Startup: configuring the channels, no receiver is created. Arg 0: channels.
+static void BM_SessionManagerConfigure(benchmark::State& state) {
+    const uint32_t channels = state.range(0);
+    for (auto _ : state) {
+        RISTNetSessionManager manager;
+        RISTNetSessionManager::RISTNetSessionManagerSettings settings;
+        settings.mReapInterval = std::chrono::milliseconds(0);
+        manager.initSessionManager(settings);
+        addChannels(manager, channels);
+        manager.destroySessionManager();
+    }
+    state.SetItemsProcessed(state.iterations() * channels);
+}
+BENCHMARK(BM_SessionManagerConfigure)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+// Use of an active channel (lookup and touch) with many configured. Arg 0: channels, 100 active.
+static void BM_SessionManagerActivate(benchmark::State& state) {
+    const uint32_t channels = state.range(0);
+    RISTNetSessionManager manager;
+    std::map<uint32_t, std::unique_ptr<RISTNetMockTransport>> mocks;
+    attachMocks(manager, mocks);
+    RISTNetSessionManager::RISTNetSessionManagerSettings settings;
+    settings.mReapInterval = std::chrono::milliseconds(0);
+    manager.initSessionManager(settings);
+    addChannels(manager, channels);
+    for (uint32_t i = 0; i < 100; i++) {
+        manager.activateChannel(i * (channels / 100));
+    }
+    uint32_t next = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(manager.activateChannel(next * (channels / 100)));
+        next = next == 99 ? 0 : next + 1;
+    }
+    manager.destroySessionManager();
+}
+BENCHMARK(BM_SessionManagerActivate)->Arg(1000)->Arg(10000)->Arg(100000);
+
+// Steady state reap pass, nothing idle, 10000 channels configured. Arg 0: active channels.
+static void BM_SessionManagerReapPass(benchmark::State& state) {
+    const uint32_t active = state.range(0);
+    RISTNetSessionManager manager;
+    std::map<uint32_t, std::unique_ptr<RISTNetMockTransport>> mocks;
+    attachMocks(manager, mocks);
+    RISTNetSessionManager::RISTNetSessionManagerSettings settings;
+    settings.mReapInterval = std::chrono::milliseconds(0);
+    manager.initSessionManager(settings);
+    addChannels(manager, 10000);
+    for (uint32_t i = 0; i < active; i++) {
+        manager.activateChannel(i);
+    }
+    for (auto _ : state) {
+        manager.reapIdle();
+    }
+    state.counters["ns_per_active"] = benchmark::Counter(state.iterations() * active,
+                                                         benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    manager.destroySessionManager();
+}
+BENCHMARK(BM_SessionManagerReapPass)->Arg(10)->Arg(100)->Arg(1000)->Unit(benchmark::kMicrosecond);
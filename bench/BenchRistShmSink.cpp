@@ -0,0 +1,71 @@
+#include <atomic>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+#include <unistd.h>
+
+#include "RISTNetShmSink.h"
+
+namespace {
+constexpr size_t kPacketSize = 1316;
+}  // namespace
+
+// One producer publishing 1316 byte packets, arg 0 consumers reading each with its own mapping of the ring.
+// The consumers are threads here, a reader maps the ring the same way from another process.
+static void BM_ShmSinkPublish(benchmark::State& state) {
+    RISTNetShmSink sink;
+    RISTNetShmSink::RISTNetShmSinkSettings settings;
+    settings.mName = "/ristnet_bench_" + std::to_string(getpid());
+    settings.mSlots = 4096;
+    settings.mSlotSize = kPacketSize;
+    if (!sink.initShmSink(settings)) {
+        state.SkipWithError("initShmSink failed");
+        return;
+    }
+    size_t consumers = state.range(0);
+    std::atomic<size_t> opened{0};
+    std::atomic<uint64_t> read{0};
+    std::atomic<uint64_t> lapped{0};
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < consumers; i++) {
+        threads.emplace_back([&] {
+            RISTNetShmReader reader;
+            RISTNetShmReader::RISTNetShmReaderSettings readerSettings;
+            readerSettings.mName = settings.mName;
+            bool open = reader.openReader(readerSettings);
+            opened++;
+            if (!open) {
+                return;
+            }
+            std::vector<uint8_t> buffer(kPacketSize);
+            uint16_t connectionID;
+            while (reader.readPacket(buffer.data(), buffer.size(), connectionID, std::chrono::milliseconds(100)) >= 0) {
+            }
+            RISTNetShmReader::ShmReaderStatistics statistics;
+            reader.getStatistics(statistics);
+            read += statistics.mRead;
+            lapped += statistics.mLapped;
+        });
+    }
+    while (opened < consumers) {
+        std::this_thread::yield();
+    }
+
+    std::vector<uint8_t> packet(kPacketSize, 0x47);
+    for (auto _ : state) {
+        sink.writeData(packet.data(), packet.size());
+    }
+    sink.destroyShmSink();
+    for (auto& rThread : threads) {
+        rThread.join();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * kPacketSize);
+    if (consumers) {
+        // Per consumer, of the packets published
+        state.counters["read"] = (double) read / (double) (consumers * state.iterations());
+        state.counters["lapped"] = (double) lapped / (double) (consumers * state.iterations());
+    }
+}
+BENCHMARK(BM_ShmSinkPublish)->Arg(0)->Arg(1)->Arg(8)->UseRealTime();
+
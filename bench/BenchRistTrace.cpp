@@ -0,0 +1,86 @@
+#include <benchmark/benchmark.h>
+
+#include <unistd.h>
+
+#include <cstdlib>
+
+#include "RISTNetTrace.h"
+
+// What recording adds to the receive path per packet
+static void BM_TraceRecordPacket(benchmark::State& state) {
+    std::string path = "/tmp/BenchRistTrace_" + std::to_string(getpid()) + ".rtrc";
+    RISTNetTraceRecorder recorder;
+    RISTNetTraceRecorder::RISTNetTraceRecorderSettings settings;
+    settings.mPath = path;
+    settings.mRingSize = 64 * 1024 * 1024;
+    recorder.initRecorder(settings);
+    std::vector<uint8_t> payload(state.range(0));
+    rist_data_block block{};
+    block.payload = payload.data();
+    block.payload_len = payload.size();
+    for (auto _ : state) {
+        recorder.recordPacket(block);
+        block.seq++;
+    }
+    recorder.destroyRecorder();
+    RISTNetTraceRecorder::TraceRecorderStatistics stats;
+    recorder.getStatistics(stats);
+    state.counters["dropped"] = stats.mDroppedPackets;
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * payload.size());
+    unlink(path.c_str());
+}
+// The packets fit the ring, the flush thread is not what is measured
+BENCHMARK(BM_TraceRecordPacket)->Arg(188)->Arg(1316)->Iterations(40000);
+
+// A trace as a workload. RISTNET_TRACE=<trace> replays a recorded trace, otherwise 100000 packets are synthesised.
+static void BM_TraceReplayWorkload(benchmark::State& state) {
+    std::string path;
+    const char* pTrace = std::getenv("RISTNET_TRACE");
+    if (pTrace) {
+        path = pTrace;
+    } else {
+        path = "/tmp/BenchRistTraceWorkload_" + std::to_string(getpid()) + ".rtrc";
+        RISTNetTraceRecorder recorder;
+        RISTNetTraceRecorder::RISTNetTraceRecorderSettings settings;
+        settings.mPath = path;
+        settings.mRingSize = 256 * 1024 * 1024;
+        recorder.initRecorder(settings);
+        std::vector<uint8_t> payload(1316);
+        rist_data_block block{};
+        block.payload = payload.data();
+        block.payload_len = payload.size();
+        for (uint64_t i = 0; i < 100000; i++) {
+            block.seq = i;
+            block.flow_id = i % 4;
+            recorder.recordPacket(block);
+        }
+        recorder.destroyRecorder();
+    }
+
+    RISTNetTracePlayer player;
+    RISTNetTracePlayer::RISTNetTracePlayerSettings settings;
+    settings.mSpeed = 0;
+    if (!player.openTrace(path, settings)) {
+        state.SkipWithError("No trace");
+        return;
+    }
+    uint64_t bytes = 0;
+    player.packetCallback = [&](const RISTNetTraceRecord& rRecord, const uint8_t* pPayload) {
+        bytes += rRecord.mPayloadSize;
+        return 0;
+    };
+    uint64_t packets = 0;
+    for (auto _ : state) {
+        player.seek(std::chrono::nanoseconds(0));
+        packets += player.replayAll();
+    }
+    benchmark::DoNotOptimize(bytes);
+    state.SetItemsProcessed(packets);
+    state.SetBytesProcessed(bytes);
+    player.closeTrace();
+    if (!pTrace) {
+        unlink(path.c_str());
+    }
+}
+BENCHMARK(BM_TraceReplayWorkload)->Unit(benchmark::kMillisecond);
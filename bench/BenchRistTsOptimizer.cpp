@@ -0,0 +1,51 @@
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+
+#include "RISTNetTsOptimizer.h"
+
+namespace {
+// 7 packets, arg of them nulls
+std::vector<uint8_t> makePayload(int nulls) {
+    std::vector<uint8_t> payload(7 * 188);
+    for (int i = 0; i < 7; i++) {
+        uint8_t* pPacket = payload.data() + i * 188;
+        bool null = i < nulls;
+        pPacket[0] = 0x47;
+        pPacket[1] = null ? 0x1f : 0x01;
+        pPacket[2] = null ? 0xff : 0x00;
+        pPacket[3] = 0x10;
+        memset(pPacket + 4, null ? 0xff : i, 184);
+    }
+    return payload;
+}
+} // namespace
+
+static void BM_TsOptimize(benchmark::State& state) {
+    RISTNetTsOptimizer optimizer;
+    RISTNetTsOptimizer::RISTNetTsOptimizerSettings settings;
+    optimizer.initOptimizer(settings);
+    auto payload = makePayload(state.range(0));
+    std::vector<uint8_t> optimized;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(optimizer.optimize(payload.data(), payload.size(), optimized));
+    }
+    state.counters["bytes_saved_per_payload"] = (double)optimizer.getBytesSaved() / state.iterations();
+    state.SetBytesProcessed(state.iterations() * payload.size());
+}
+BENCHMARK(BM_TsOptimize)->Arg(0)->Arg(2)->Arg(7);
+
+static void BM_TsRestore(benchmark::State& state) {
+    RISTNetTsOptimizer optimizer;
+    RISTNetTsOptimizer::RISTNetTsOptimizerSettings settings;
+    optimizer.initOptimizer(settings);
+    auto payload = makePayload(state.range(0));
+    std::vector<uint8_t> optimized;
+    optimizer.optimize(payload.data(), payload.size(), optimized);
+    std::vector<uint8_t> restored;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(optimizer.restore(optimized.data(), optimized.size(), restored));
+    }
+    state.SetBytesProcessed(state.iterations() * payload.size());
+}
+BENCHMARK(BM_TsRestore)->Arg(2)->Arg(7);
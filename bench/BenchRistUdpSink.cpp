@@ -0,0 +1,63 @@
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+
+#include <benchmark/benchmark.h>
+
+#include "RISTNetUdpSink.h"
+
+namespace {
+const size_t kPacketSize = 1316;
+const uint16_t kPort = 18650;
+}  // namespace
+
+// Send rate of a RISTNetUdpSink to a receiving socket on the loopback interface. A thread drains the socket.
+// Arg 0: batch size (1 is one syscall per packet as a plain sendto loop), Arg 1: UDP GSO off/on.
+static void BM_UdpSinkSend(benchmark::State& state) {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    int bufferSize = 8 * 1024 * 1024;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+    timeval timeout = {0, 100000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(kPort);
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    bind(sock, (sockaddr*)&address, sizeof(address));
+    std::atomic<bool> run = true;
+    std::thread drain([&]() {
+        std::vector<uint8_t> buffer(65536);
+        while (run) {
+            recv(sock, buffer.data(), buffer.size(), 0);
+        }
+    });
+
+    RISTNetUdpSink sink;
+    RISTNetUdpSink::RISTNetUdpSinkSettings settings;
+    settings.mOutputs.push_back({"127.0.0.1", kPort, "", RISTNetUdpSink::kAllFlows});
+    settings.mBatchSize = state.range(0);
+    settings.mUseGSO = state.range(1);
+    if (!sink.initUdpSink(settings)) {
+        state.SkipWithError("initUdpSink failed");
+    } else {
+        std::vector<uint8_t> payload(kPacketSize, 0x47);
+        for (auto _ : state) {
+            sink.sendData(payload.data(), payload.size());
+        }
+        sink.destroyUdpSink();
+
+        RISTNetUdpSink::UdpSinkStatistics stats;
+        sink.getStatistics(stats);
+        state.SetItemsProcessed(state.iterations());
+        state.SetBytesProcessed(state.iterations() * kPacketSize);
+        state.counters["syscalls_per_packet"] = (double)stats.mSyscalls / std::max<uint64_t>(stats.mPackets, 1);
+        state.counters["gso"] = stats.mGSO;
+    }
+    run = false;
+    drain.join();
+    close(sock);
+}
+BENCHMARK(BM_UdpSinkSend)->Args({1, 0})->Args({32, 0})->Args({32, 1})->Args({64, 1})->UseRealTime();
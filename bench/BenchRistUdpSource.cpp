@@ -0,0 +1,100 @@
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <ctime>
+
+#include <benchmark/benchmark.h>
+
+#include "RISTNetUdpSource.h"
+
+namespace {
+const size_t kPacketSize = 1316;
+const size_t kSendBatch = 32;
+const uint64_t kMaxInFlight = 2048;  // Stay below the socket receive buffer, a drop would stall the benchmark
+const uint16_t kPort = 18600;
+
+double threadCpuSeconds() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+}  // namespace
+
+// Ingest rate of one RISTNetUdpSource receive thread. The benchmark thread sends 7 TS packets per datagram with
+// sendmmsg to the source over the loopback interface, a stand-in for a multicast feed on a NIC.
+// Set RISTNET_BENCH_MULTICAST=1 to send to a multicast group on the loopback interface instead of unicast.
+// Arg 0: datagrams per recvmmsg call. pps_per_core is the rate per CPU second of the receive thread.
+static void BM_UdpSourceIngest(benchmark::State& state) {
+    bool multicast = std::getenv("RISTNET_BENCH_MULTICAST") != nullptr;
+    std::string group = multicast ? "239.255.18.2" : "127.0.0.1";
+
+    RISTNetUdpSource source;
+    RISTNetUdpSource::RISTNetUdpSourceSettings settings;
+    settings.mBatchSize = state.range(0);
+    settings.mInputs.push_back({group, kPort, multicast ? "127.0.0.1" : "", 1, false});
+    std::atomic<uint64_t> received = 0;
+    std::atomic<double> receiveCpu = 0.0;
+    source.packetCallback = [&](const uint8_t* buf, size_t size, uint16_t connectionId) {
+        uint64_t count = received.load(std::memory_order_relaxed) + 1;
+        if (!(count & 1023)) {
+            receiveCpu.store(threadCpuSeconds(), std::memory_order_relaxed);
+        }
+        received.store(count, std::memory_order_release);
+        return true;
+    };
+    if (!source.initUdpSource(settings) || !source.startUdpSource()) {
+        state.SkipWithError("initUdpSource failed");
+        return;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    in_addr interface = {};
+    inet_pton(AF_INET, "127.0.0.1", &interface);
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &interface, sizeof(interface));
+    sockaddr_in destination = {};
+    destination.sin_family = AF_INET;
+    destination.sin_port = htons(kPort);
+    inet_pton(AF_INET, group.c_str(), &destination.sin_addr);
+    connect(sock, (sockaddr*)&destination, sizeof(destination));
+
+    std::vector<uint8_t> payload(kPacketSize, 0x47);
+    std::vector<iovec> vectors(kSendBatch, {payload.data(), payload.size()});
+    std::vector<mmsghdr> messages(kSendBatch);
+    for (size_t i = 0; i < kSendBatch; i++) {
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    uint64_t sent = 0;
+    double cpuStart = receiveCpu.load();
+    uint64_t receivedStart = received.load();
+    for (auto _ : state) {
+        while (sent - received.load(std::memory_order_acquire) > kMaxInFlight) {
+            std::this_thread::yield();
+        }
+        int count = sendmmsg(sock, messages.data(), kSendBatch, 0);
+        if (count > 0) {
+            sent += count;
+        }
+    }
+    for (int i = 0; i < 1000 && received.load() < sent; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    close(sock);
+    source.destroyUdpSource();
+
+    RISTNetUdpSource::UdpSourceStatistics stats;
+    source.getStatistics(stats);
+    uint64_t packets = received.load() - receivedStart;
+    state.SetItemsProcessed(packets);
+    state.SetBytesProcessed(packets * kPacketSize);
+    state.counters["pps"] = benchmark::Counter(packets, benchmark::Counter::kIsRate);
+    double cpu = receiveCpu.load() - cpuStart;
+    state.counters["pps_per_core"] = cpu > 0 ? packets / cpu : 0;
+    state.counters["datagrams_per_call"] = (double)stats.mPackets / std::max<uint64_t>(stats.mReceiveCalls, 1);
+    state.counters["lost"] = sent - packets;
+}
+BENCHMARK(BM_UdpSourceIngest)->Arg(1)->Arg(8)->Arg(64)->UseRealTime()->MinTime(2.0);
@@ -0,0 +1,400 @@
+//
+// runScaleHarness -- Scale and soak test of one RISTNetReceiver with many in-process senders
+//
+// For every peer count N the harness starts a listening receiver, connects N senders and sends rate packets/s
+// from each. Every step reports the time from initSender to the first packet of a sender (connect latency),
+// the one way latency of the packets, the RSS and CPU per peer, and, while senders are churned, the reconnect
+// latency, the disconnect detection latency and the time spent in the connect/disconnect callbacks (run by
+// clientConnect/clientDisconnect, the disconnect one under the client list lock). One CSV row per step.
+//
+// runScaleHarness [--peers 1,10,100,500] [--duration 10] [--rate 100] [--size 1316] [--churn 5] [--port 8100]
+//
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "RISTNet.h"
+
+namespace {
+
+struct HarnessSettings {
+    std::vector<size_t> mPeers = {1, 10, 100, 500};
+    std::chrono::seconds mDuration{10};     // Steady and churn phase, each
+    uint32_t mRate = 100;                   // Packets/s per sender
+    size_t mPacketSize = 1316;
+    uint32_t mChurnPerSecond = 5;           // Senders destroyed and recreated per second in the churn phase
+    uint16_t mPort = 8100;
+    std::chrono::seconds mConnectTimeout{30};
+};
+
+struct HarnessPacket {
+    uint32_t mSender;
+    uint32_t mGeneration;                   // Incremented when the sender is recreated
+    uint64_t mSeq;
+    int64_t mSentNs;
+};
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Percentile of the samples, sorts them
+double percentile(std::vector<double> &rSamples, double lPercentile) {
+    if (rSamples.empty()) {
+        return 0;
+    }
+    std::sort(rSamples.begin(), rSamples.end());
+    size_t lIndex = std::min(rSamples.size() - 1, (size_t) (lPercentile / 100.0 * rSamples.size()));
+    return rSamples[lIndex];
+}
+
+size_t residentKB() {
+    std::ifstream lStatus("/proc/self/status");
+    std::string lLine;
+    while (std::getline(lStatus, lLine)) {
+        if (lLine.rfind("VmRSS:", 0) == 0) {
+            return std::stoul(lLine.substr(6));
+        }
+    }
+    return 0;
+}
+
+double cpuSeconds() {
+    rusage lUsage{};
+    getrusage(RUSAGE_SELF, &lUsage);
+    return lUsage.ru_utime.tv_sec + lUsage.ru_stime.tv_sec + (lUsage.ru_utime.tv_usec + lUsage.ru_stime.tv_usec) / 1e6;
+}
+
+// One sender slot, the pacer and the churner take turns under the slot mutex
+struct SenderSlot {
+    std::mutex mSlotMtx;
+    std::unique_ptr<RISTNetSender> mSender;
+    uint32_t mGeneration = 0;
+    uint64_t mSeq = 0;
+    int64_t mInitNs = 0;
+};
+
+// What the receiver callbacks collect, under mStatsMtx
+struct ReceiverStats {
+    std::mutex mStatsMtx;
+    std::vector<int64_t> mFirstPacketNs;     // Per sender, 0 until the current generation delivered a packet
+    std::vector<uint32_t> mGeneration;       // The generation the first packet was seen for
+    std::vector<uint64_t> mNextSeq;
+    std::vector<double> mConnectMs;          // initSender to first packet
+    std::vector<double> mLatencyUs;
+    std::vector<double> mConnectCallbackUs;
+    std::vector<double> mDisconnectCallbackUs;
+    std::vector<double> mDisconnectDetectMs; // destroySender to clientDisconnectedCallback
+    std::vector<int64_t> mDestroyedNs;       // destroySender times not yet detected, FIFO
+    uint64_t mPackets = 0;
+    uint64_t mLost = 0;
+    uint64_t mConnects = 0;
+    uint64_t mDisconnects = 0;
+
+    void reset(size_t lPeers) {
+        std::lock_guard<std::mutex> lLock(mStatsMtx);
+        mFirstPacketNs.assign(lPeers, 0);
+        mGeneration.assign(lPeers, UINT32_MAX);
+        mNextSeq.assign(lPeers, 0);
+        clearSamples();
+        mDestroyedNs.clear();
+        mConnects = 0;
+        mDisconnects = 0;
+    }
+
+    void clearSamples() {
+        mConnectMs.clear();
+        mLatencyUs.clear();
+        mConnectCallbackUs.clear();
+        mDisconnectCallbackUs.clear();
+        mDisconnectDetectMs.clear();
+        mPackets = 0;
+        mLost = 0;
+    }
+};
+
+std::unique_ptr<RISTNetSender> makeSender(const HarnessSettings &rSettings) {
+    std::string lURL;
+    RISTNetTools::buildRISTURL("127.0.0.1", std::to_string(rSettings.mPort), lURL, false);
+    std::vector<std::tuple<std::string, int>> lInterfaces = {{lURL, 5}};
+    RISTNetSender::RISTNetSenderSettings lSenderSettings;
+    lSenderSettings.mLogLevel = RIST_LOG_ERROR;
+    auto lSender = std::make_unique<RISTNetSender>();
+    if (!lSender->initSender(lInterfaces, lSenderSettings)) {
+        return nullptr;
+    }
+    return lSender;
+}
+
+void runStep(const HarnessSettings &rSettings, size_t lPeers) {
+    ReceiverStats lStats;
+    lStats.reset(lPeers);
+
+    RISTNetReceiver lReceiver;
+    lReceiver.validateConnectionCallback = [&](const std::string &rIPAddress, uint16_t lPort) {
+        int64_t lStart = nowNs();
+        auto lConnection = std::make_shared<RISTNetReceiver::NetworkConnection>();
+        std::lock_guard<std::mutex> lLock(lStats.mStatsMtx);
+        lStats.mConnects++;
+        lStats.mConnectCallbackUs.push_back((nowNs() - lStart) / 1000.0);
+        return lConnection;
+    };
+    lReceiver.clientDisconnectedCallback = [&](const std::shared_ptr<RISTNetReceiver::NetworkConnection> &rConnection,
+                                               const rist_peer &rPeer) {
+        int64_t lStart = nowNs();
+        std::lock_guard<std::mutex> lLock(lStats.mStatsMtx);
+        lStats.mDisconnects++;
+        if (!lStats.mDestroyedNs.empty()) {
+            lStats.mDisconnectDetectMs.push_back((lStart - lStats.mDestroyedNs.front()) / 1e6);
+            lStats.mDestroyedNs.erase(lStats.mDestroyedNs.begin());
+        }
+        lStats.mDisconnectCallbackUs.push_back((nowNs() - lStart) / 1000.0);
+    };
+
+    std::vector<SenderSlot> lSlots(lPeers);
+    lReceiver.networkDataCallback = [&](const uint8_t *pBuf, size_t lSize,
+                                        std::shared_ptr<RISTNetReceiver::NetworkConnection> &rConnection,
+                                        rist_peer *pPeer, uint16_t lConnectionID) {
+        int64_t lNow = nowNs();
+        if (lSize < sizeof(HarnessPacket)) {
+            return 0;
+        }
+        HarnessPacket lPacket;
+        memcpy(&lPacket, pBuf, sizeof(lPacket));
+        if (lPacket.mSender >= lPeers) {
+            return 0;
+        }
+        std::lock_guard<std::mutex> lLock(lStats.mStatsMtx);
+        lStats.mPackets++;
+        lStats.mLatencyUs.push_back((lNow - lPacket.mSentNs) / 1000.0);
+        if (lStats.mGeneration[lPacket.mSender] != lPacket.mGeneration) {
+            // The first packet of this sender (generation), the init time travels in the packet
+            lStats.mGeneration[lPacket.mSender] = lPacket.mGeneration;
+            lStats.mFirstPacketNs[lPacket.mSender] = lNow;
+            lStats.mNextSeq[lPacket.mSender] = lPacket.mSeq + 1;
+            return 0;
+        }
+        if (lPacket.mSeq > lStats.mNextSeq[lPacket.mSender]) {
+            lStats.mLost += lPacket.mSeq - lStats.mNextSeq[lPacket.mSender];
+        }
+        lStats.mNextSeq[lPacket.mSender] = std::max(lStats.mNextSeq[lPacket.mSender], lPacket.mSeq + 1);
+        return 0;
+    };
+
+    std::string lURL;
+    RISTNetTools::buildRISTURL("0.0.0.0", std::to_string(rSettings.mPort), lURL, true);
+    std::vector<std::string> lInterfaces = {lURL};
+    RISTNetReceiver::RISTNetReceiverSettings lReceiverSettings;
+    lReceiverSettings.mLogLevel = RIST_LOG_ERROR;
+    if (!lReceiver.initReceiver(lInterfaces, lReceiverSettings)) {
+        std::cerr << "initReceiver failed on port " << rSettings.mPort << std::endl;
+        return;
+    }
+
+    size_t lRSSBefore = residentKB();
+
+    // The pacer sends rate packets/s from every sender, spread over the second
+    std::atomic<bool> lPace{true};
+    std::thread lPacer([&]() {
+        std::vector<uint8_t> lBuffer(std::max(rSettings.mPacketSize, sizeof(HarnessPacket)));
+        auto lInterval = std::chrono::nanoseconds(1000000000LL / rSettings.mRate);
+        auto lNext = std::chrono::steady_clock::now();
+        while (lPace) {
+            for (size_t i = 0; i < lPeers && lPace; i++) {
+                std::lock_guard<std::mutex> lLock(lSlots[i].mSlotMtx);
+                if (!lSlots[i].mSender) {
+                    continue;
+                }
+                HarnessPacket lPacket{(uint32_t) i, lSlots[i].mGeneration, lSlots[i].mSeq++, nowNs()};
+                memcpy(lBuffer.data(), &lPacket, sizeof(lPacket));
+                lSlots[i].mSender->sendData(lBuffer.data(), lBuffer.size());
+            }
+            lNext += lInterval;
+            std::this_thread::sleep_until(lNext);
+        }
+    });
+
+    // Connect all senders, the connect latency is initSender to the first packet received
+    for (size_t i = 0; i < lPeers; i++) {
+        auto lSender = makeSender(rSettings);
+        std::lock_guard<std::mutex> lLock(lSlots[i].mSlotMtx);
+        lSlots[i].mInitNs = nowNs();
+        lSlots[i].mSender = std::move(lSender);
+    }
+    auto lDeadline = std::chrono::steady_clock::now() + rSettings.mConnectTimeout;
+    size_t lConnected = 0;
+    while (std::chrono::steady_clock::now() < lDeadline) {
+        {
+            std::lock_guard<std::mutex> lLock(lStats.mStatsMtx);
+            lConnected = std::count_if(lStats.mFirstPacketNs.begin(), lStats.mFirstPacketNs.end(),
+                                       [](int64_t lTime) { return lTime != 0; });
+        }
+        if (lConnected == lPeers) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    std::vector<double> lConnectMs;
+    {
+        std::lock_guard<std::mutex> lLock(lStats.mStatsMtx);
+        for (size_t i = 0; i < lPeers; i++) {
+            if (lStats.mFirstPacketNs[i]) {
+                lConnectMs.push_back((lStats.mFirstPacketNs[i] - lSlots[i].mInitNs) / 1e6);
+            }
+        }
+        lStats.clearSamples();
+    }
+    size_t lRSSConnected = residentKB();
+
+    // Steady phase
+    double lCPUStart = cpuSeconds();
+    auto lWallStart = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(rSettings.mDuration);
+    double lCPUSeconds = cpuSeconds() - lCPUStart;
+    double lWallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - lWallStart).count();
+    std::vector<double> lSteadyLatency;
+    uint64_t lSteadyPackets;
+    uint64_t lSteadyLost;
+    {
+        std::lock_guard<std::mutex> lLock(lStats.mStatsMtx);
+        lSteadyLatency.swap(lStats.mLatencyUs);
+        lSteadyPackets = lStats.mPackets;
+        lSteadyLost = lStats.mLost;
+        lStats.clearSamples();
+    }
+
+    // Churn phase, destroy and recreate mChurnPerSecond random senders every second
+    std::vector<double> lReconnectMs;
+    std::mt19937 lRandom(42);
+    std::vector<std::pair<size_t, int64_t>> lPendingReconnects;
+    auto lChurnEnd = std::chrono::steady_clock::now() + rSettings.mDuration;
+    while (rSettings.mChurnPerSecond && std::chrono::steady_clock::now() < lChurnEnd) {
+        for (uint32_t c = 0; c < rSettings.mChurnPerSecond; c++) {
+            size_t lIndex = lRandom() % lPeers;
+            std::unique_ptr<RISTNetSender> lOld;
+            {
+                std::lock_guard<std::mutex> lLock(lSlots[lIndex].mSlotMtx);
+                lOld = std::move(lSlots[lIndex].mSender);
+            }
+            if (lOld) {
+                lOld->destroySender();
+                std::lock_guard<std::mutex> lLock(lStats.mStatsMtx);
+                lStats.mDestroyedNs.push_back(nowNs());
+            }
+            auto lSender = makeSender(rSettings);
+            std::lock_guard<std::mutex> lLock(lSlots[lIndex].mSlotMtx);
+            lSlots[lIndex].mGeneration++;
+            lSlots[lIndex].mSeq = 0;
+            lSlots[lIndex].mInitNs = nowNs();
+            lSlots[lIndex].mSender = std::move(lSender);
+            lPendingReconnects.emplace_back(lIndex, lSlots[lIndex].mInitNs);
+        }
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    std::vector<double> lChurnLatency;
+    std::vector<double> lConnectCallbackUs;
+    std::vector<double> lDisconnectCallbackUs;
+    std::vector<double> lDisconnectDetectMs;
+    uint64_t lConnects;
+    uint64_t lDisconnects;
+    {
+        std::lock_guard<std::mutex> lLock(lStats.mStatsMtx);
+        for (auto &rPending: lPendingReconnects) {
+            int64_t lFirst = lStats.mFirstPacketNs[rPending.first];
+            if (lFirst > rPending.second) {
+                lReconnectMs.push_back((lFirst - rPending.second) / 1e6);
+            }
+        }
+        lChurnLatency.swap(lStats.mLatencyUs);
+        lConnectCallbackUs.swap(lStats.mConnectCallbackUs);
+        lDisconnectCallbackUs.swap(lStats.mDisconnectCallbackUs);
+        lDisconnectDetectMs.swap(lStats.mDisconnectDetectMs);
+        lConnects = lStats.mConnects;
+        lDisconnects = lStats.mDisconnects;
+    }
+
+    lPace = false;
+    lPacer.join();
+    for (auto &rSlot: lSlots) {
+        std::lock_guard<std::mutex> lLock(rSlot.mSlotMtx);
+        if (rSlot.mSender) {
+            rSlot.mSender->destroySender();
+            rSlot.mSender.reset();
+        }
+    }
+    lReceiver.destroyReceiver();
+
+    double lRSSPerPeer = lRSSConnected > lRSSBefore ? (double) (lRSSConnected - lRSSBefore) / lPeers : 0;
+    std::cout << lPeers << "," << lConnected << ","
+              << percentile(lConnectMs, 50) << "," << percentile(lConnectMs, 99) << ","
+              << lSteadyPackets << "," << lSteadyLost << ","
+              << percentile(lSteadyLatency, 50) << "," << percentile(lSteadyLatency, 99) << ","
+              << percentile(lSteadyLatency, 100) << ","
+              << lRSSPerPeer << "," << 100.0 * lCPUSeconds / lWallSeconds / lPeers << ","
+              << percentile(lChurnLatency, 99) << "," << percentile(lChurnLatency, 100) << ","
+              << percentile(lReconnectMs, 50) << "," << percentile(lReconnectMs, 99) << ","
+              << percentile(lDisconnectDetectMs, 50) << ","
+              << lConnects << "," << percentile(lConnectCallbackUs, 99) << ","
+              << lDisconnects << "," << percentile(lDisconnectCallbackUs, 99) << std::endl;
+}
+
+bool parseArguments(int argc, char *argv[], HarnessSettings &rSettings) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string lName = argv[i];
+        std::string lValue = argv[i + 1];
+        if (lName == "--peers") {
+            rSettings.mPeers.clear();
+            std::stringstream lList(lValue);
+            std::string lPeers;
+            while (std::getline(lList, lPeers, ',')) {
+                rSettings.mPeers.push_back(std::stoul(lPeers));
+            }
+        } else if (lName == "--duration") {
+            rSettings.mDuration = std::chrono::seconds(std::stoul(lValue));
+        } else if (lName == "--rate") {
+            rSettings.mRate = std::max(1UL, std::stoul(lValue));
+        } else if (lName == "--size") {
+            rSettings.mPacketSize = std::stoul(lValue);
+        } else if (lName == "--churn") {
+            rSettings.mChurnPerSecond = std::stoul(lValue);
+        } else if (lName == "--port") {
+            rSettings.mPort = std::stoul(lValue);
+        } else {
+            return false;
+        }
+    }
+    return (argc % 2) == 1;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    HarnessSettings lSettings;
+    if (!parseArguments(argc, argv, lSettings)) {
+        std::cerr << "runScaleHarness [--peers 1,10,100,500] [--duration 10] [--rate 100] [--size 1316] "
+                     "[--churn 5] [--port 8100]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    RISTNetLog::setLevel(RIST_LOG_ERROR);
+
+    // One row per peer count, the columns are the scaling curves
+    std::cout << "peers,connected,connect_ms_p50,connect_ms_p99,packets,lost,latency_us_p50,latency_us_p99,"
+                 "latency_us_max,rss_kb_per_peer,cpu_pct_per_peer,churn_latency_us_p99,churn_latency_us_max,"
+                 "reconnect_ms_p50,reconnect_ms_p99,disconnect_detect_ms_p50,connects,connect_cb_us_p99,"
+                 "disconnects,disconnect_cb_us_p99" << std::endl;
+    for (size_t lPeers: lSettings.mPeers) {
+        if (lPeers) {
+            runStep(lSettings, lPeers);
+        }
+    }
+    return EXIT_SUCCESS;
+}
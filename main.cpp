@@ -6,12 +6,17 @@
 #include <algorithm>
 #include <thread>
 #include "RISTNet.h"
+#include "RISTNetFileSource.h"
 
 //Create the receiver
 RISTNetReceiver myRISTNetReceiver;
 
 int packetCounter;
 
+//Set when a TS file is played out instead of sending the test vectors, before the receiver threads start
+bool fileMode = false;
+std::atomic<uint64_t> fileModeBytes = 0;
+
 //This is my class managed by the network connection.
 class MyClass {
 public:
@@ -56,6 +61,11 @@ dataFromSender(const uint8_t *buf, size_t len, std::shared_ptr<RISTNetReceiver::
         v->someVariable++;
     }
 
+    if (fileMode) {
+        fileModeBytes += len;
+        return 0; //Keep connection
+    }
+
     //Check the vector integrity
     bool testFail = false;
     for (int x = 0; x < len; x++) {
@@ -103,7 +113,36 @@ void clientDisconnect(const std::shared_ptr<RISTNetReceiver::NetworkConnection>&
     }
 }
 
-int main() {
+//Play out a TS file in real time using the PCR of the file, rist_cpp file.ts [loop]
+int playFile(RISTNetSender &rSender, const std::string &rPath, bool loop) {
+    RISTNetFileSource myRISTNetFileSource;
+    RISTNetFileSource::RISTNetFileSourceSettings myFileSourceConfiguration;
+    myFileSourceConfiguration.mLoop = loop;
+    if (!myRISTNetFileSource.openFile(rPath, myFileSourceConfiguration)) {
+        std::cout << "Failed opening " << rPath << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Playing " << rPath << " duration: " << myRISTNetFileSource.getDuration().count() << " ms" << std::endl;
+    if (!myRISTNetFileSource.startPlayout(rSender)) {
+        std::cout << "Failed starting the playout" << std::endl;
+        return EXIT_FAILURE;
+    }
+    while (myRISTNetFileSource.isPlaying()) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        RISTNetFileSource::FileSourceStatistics stats;
+        myRISTNetFileSource.getStatistics(stats);
+        std::cout << "Position: " << myRISTNetFileSource.getPosition().count() << " ms, chunks sent: "
+                  << stats.mChunksSent << ", late: " << stats.mChunksLate << ", max lateness: "
+                  << stats.mMaxLateness.count() << " us, received: " << fileModeBytes << " bytes" << std::endl;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+
+    //Read by the receiver callbacks, set it before initReceiver starts them
+    fileMode = argc > 1;
 
     uint32_t cppWrapperVersion;
     uint32_t ristMajor;
@@ -179,6 +218,10 @@ int main() {
         std::cout << "initSender fail" << std::endl;
     }
 
+    if (fileMode) {
+        return playFile(myRISTNetSender, argv[1], argc > 2 && std::string(argv[2]) == "loop");
+    }
+
     std::vector<uint8_t> mydata(1000);
     std::generate(mydata.begin(), mydata.end(), [n = 0]() mutable { return n++; });
     while (packetCounter++ < 10) {
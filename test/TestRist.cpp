@@ -1,3 +1,6 @@
+#include <sys/epoll.h>
+#include <unistd.h>
+
 #include <condition_variable>
 #include <thread>
 
@@ -115,7 +118,10 @@ TEST(TestRist, BuildRistUrl) {
     EXPECT_TRUE(RISTNetTools::buildRISTURL("::", "9000", url, true));
     EXPECT_EQ(url, "rist6://@[::]:9000");
 
+    // Names are not resolved here (resolveRISTURL, TestRistResolver), not valid ones or ports are not
     EXPECT_FALSE(RISTNetTools::buildRISTURL("example.com", "9000", url, true));
+    EXPECT_FALSE(RISTNetTools::buildRISTURL("not a host", "9000", url, true));
+    EXPECT_FALSE(RISTNetTools::buildRISTURL("example.com", "65536", url, true));
     EXPECT_FALSE(RISTNetTools::buildRISTURL("0.0.0.0", "65536", url, true));
 }
 
@@ -295,3 +301,74 @@ TEST_F(TestFixtureReceiver, DISABLED_RejectConnection) {
             EXPECT_EQ(activeClients.size(), 0);
         });
 }
+
+TEST(TestRist, EventQueue) {
+    const uint16_t kSentPackets = 5;
+    RISTNetReceiver receiver;
+    RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+    receiverSettings.mEventQueueSize = 1024;
+    auto receiverCtx = std::make_shared<RISTNetReceiver::NetworkConnection>();
+    receiver.validateConnectionCallback = [&](const std::string& ipAddress, uint16_t port) { return receiverCtx; };
+    std::vector<std::string> receiverInterfaces = {"rist://@0.0.0.0:8001"};
+    ASSERT_TRUE(receiver.initReceiver(receiverInterfaces, receiverSettings));
+    int epollFd = epoll_create1(0);
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    ASSERT_EQ(epoll_ctl(epollFd, EPOLL_CTL_ADD, receiver.getEventFd(), &event), 0);
+
+    RISTNetSender sender;
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    std::vector<std::tuple<std::string, int>> senderInterfaces = {{"rist://127.0.0.1:8001", 0}};
+    ASSERT_TRUE(sender.initSender(senderInterfaces, senderSettings));
+
+    // The reactor thread is the only one touching the events
+    std::vector<RISTNetReceiver::NetworkEvent> events;
+    std::vector<RISTNetEventType> types;
+    uint16_t nReceivedPackets = 0;
+    bool sent = false;
+    auto deadline = std::chrono::steady_clock::now() + kConnectTimeout + kReceiveTimeout;
+    while (nReceivedPackets < kSentPackets && std::chrono::steady_clock::now() < deadline) {
+        if (epoll_wait(epollFd, &event, 1, 100) <= 0) {
+            continue;
+        }
+        receiver.drain(events);
+        for (auto& rEvent : events) {
+            types.push_back(rEvent.mType);
+            if (rEvent.mType == RISTNetEventType::kData) {
+                EXPECT_EQ(rEvent.mConnection, receiverCtx);
+                EXPECT_EQ(rEvent.mData.data()[0], '0' + nReceivedPackets);
+                nReceivedPackets++;
+            }
+        }
+        if (!sent && !types.empty() && types[0] == RISTNetEventType::kConnect) {
+            std::vector<uint8_t> sendBuffer(1024);
+            for (auto i = 0; i < kSentPackets; i++) {
+                std::fill(sendBuffer.begin(), sendBuffer.end(), '0' + i);
+                EXPECT_TRUE(sender.sendData(sendBuffer.data(), sendBuffer.size()));
+            }
+            sent = true;
+        }
+    }
+    close(epollFd);
+    ASSERT_FALSE(types.empty());
+    EXPECT_EQ(types[0], RISTNetEventType::kConnect);
+    EXPECT_EQ(nReceivedPackets, kSentPackets);
+
+    // The data path counters of both ends
+    std::vector<RISTNetCounterSnapshot> flows, peers;
+    sender.getCounters(flows);
+    ASSERT_EQ(flows.size(), 1);
+    EXPECT_EQ(flows[0].mPackets, kSentPackets);
+    EXPECT_EQ(flows[0].mBytes, kSentPackets * 1024);
+    EXPECT_EQ(flows[0].mErrors, 0);
+    receiver.getCounters(flows, peers);
+    ASSERT_EQ(flows.size(), 1);
+    ASSERT_EQ(peers.size(), 1);
+    EXPECT_EQ(flows[0].mPackets, kSentPackets);
+    EXPECT_EQ(flows[0].mSeqGaps, 0);
+    EXPECT_EQ(flows[0].mReordered, 0);
+    EXPECT_EQ(peers[0].mBytes, kSentPackets * 1024);
+
+    EXPECT_TRUE(receiver.destroyReceiver());
+    EXPECT_EQ(receiver.getEventFd(), -1);
+}
@@ -0,0 +1,251 @@
+#include <condition_variable>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "RISTNetMockTransport.h"
+
+namespace {
+using CallbackKind = RISTNetCallbackWatchdog::CallbackKind;
+
+RISTNetCallbackWatchdog::CallbackHistogram histogram(RISTNetReceiver& receiver, CallbackKind kind) {
+    std::vector<RISTNetCallbackWatchdog::CallbackHistogram> histograms;
+    EXPECT_TRUE(receiver.getCallbackHistograms(histograms));
+    EXPECT_EQ(histograms.size(), RISTNetCallbackWatchdog::kKinds);
+    return histograms[(size_t)kind];
+}
+
+template <typename F>
+bool waitFor(F condition) {
+    for (int i = 0; i < 500 && !condition(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return condition();
+}
+} // namespace
+
+TEST(TestRistCallbackWatchdog, OffloadSlowPeer) {
+    RISTNetReceiver receiver;
+    receiver.validateConnectionCallback = [](const std::string& ipAddress, uint16_t port) {
+        auto connection = std::make_shared<RISTNetReceiver::NetworkConnection>();
+        connection->mObject = (int)port;
+        return connection;
+    };
+    std::mutex mutex;
+    std::map<int, std::vector<uint64_t>> received; // Port of the connection -> seq
+    std::map<int, std::vector<std::thread::id>> threads;
+    receiver.networkDataBlockCallback = [&](const rist_data_block& rDataBlock,
+                                            std::shared_ptr<RISTNetReceiver::NetworkConnection>& rConnection) {
+        int port = std::any_cast<int>(rConnection->mObject);
+        EXPECT_EQ(rDataBlock.payload_len, 188);
+        EXPECT_EQ(((const uint8_t*)rDataBlock.payload)[0], rDataBlock.seq & 0xff);
+        if (port == 1000) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        received[port].push_back(rDataBlock.seq);
+        threads[port].push_back(std::this_thread::get_id());
+        return 0;
+    };
+    receiver.networkOOBDataCallback = [](const uint8_t* pBuf, size_t size,
+                                         std::shared_ptr<RISTNetReceiver::NetworkConnection>& rConnection,
+                                         rist_peer* pPeer) {};
+    receiver.clientDisconnectedCallback = [](const std::shared_ptr<RISTNetReceiver::NetworkConnection>& rConnection,
+                                             const rist_peer& rPeer) {};
+    std::vector<RISTNetCallbackWatchdog::WatchdogEvent> events;
+    std::thread::id eventThread;
+    receiver.watchdogCallback = [&](const RISTNetCallbackWatchdog::WatchdogEvent& rEvent) {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(rEvent);
+        eventThread = std::this_thread::get_id();
+    };
+
+    RISTNetMockTransport transport;
+    RISTNetReceiver::RISTNetReceiverSettings settings;
+    settings.mCallbackWatchdog = true;
+    settings.mWatchdogSettings.mDataBudget = std::chrono::microseconds(500);
+    settings.mWatchdogSettings.mViolationLimit = 3;
+    settings.mWatchdogSettings.mViolationWindow = std::chrono::seconds(10);
+    ASSERT_TRUE(transport.attachReceiver(receiver, settings));
+    rist_peer* slowPeer = transport.connectPeer("10.0.0.1", 1000);
+    rist_peer* fastPeer = transport.connectPeer("10.0.0.2", 2000);
+    ASSERT_NE(slowPeer, nullptr);
+    ASSERT_NE(fastPeer, nullptr);
+
+    // Three violations of the slow peer offload it, the fast peer stays on the librist thread
+    std::vector<uint8_t> packet(188);
+    for (uint64_t seq = 0; seq < 13; seq++) {
+        packet[0] = seq & 0xff;
+        EXPECT_EQ(transport.injectData(slowPeer, packet.data(), packet.size(), 0, seq), 0);
+        EXPECT_EQ(transport.injectData(fastPeer, packet.data(), packet.size(), 0, seq), 0);
+    }
+    ASSERT_TRUE(waitFor([&] { return histogram(receiver, CallbackKind::kData).mCalls == 26; }));
+
+    std::vector<uint64_t> expected;
+    for (uint64_t seq = 0; seq < 13; seq++) {
+        expected.push_back(seq);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        EXPECT_EQ(received[1000], expected);
+        EXPECT_EQ(received[2000], expected);
+        for (size_t i = 0; i < 13; i++) {
+            EXPECT_EQ(threads[2000][i], std::this_thread::get_id());
+            EXPECT_EQ(threads[1000][i] == std::this_thread::get_id(), i < 3);
+        }
+        ASSERT_EQ(events.size(), 1u);
+        EXPECT_EQ(events[0].mKind, CallbackKind::kData);
+        EXPECT_EQ(events[0].pPeer, slowPeer);
+        EXPECT_EQ(events[0].mViolations, 3u);
+        EXPECT_GE(events[0].mDuration, 2000000u);
+        EXPECT_NE(eventThread, std::this_thread::get_id());
+    }
+
+    auto data = histogram(receiver, CallbackKind::kData);
+    EXPECT_EQ(data.mOffloaded, 10u);
+    EXPECT_GE(data.mViolations, 13u);
+    EXPECT_GE(data.mMaxDuration, 2000000u);
+    uint64_t buckets = 0;
+    uint64_t slow = 0;
+    for (size_t i = 0; i < data.mBuckets.size(); i++) {
+        buckets += data.mBuckets[i];
+        slow += i >= 11 ? data.mBuckets[i] : 0; // 1024 us and more
+    }
+    EXPECT_EQ(buckets, 26u);
+    EXPECT_GE(slow, 13u);
+
+    // The other callbacks are measured
+    EXPECT_EQ(histogram(receiver, CallbackKind::kValidate).mCalls, 2u);
+    EXPECT_EQ(transport.injectOOBData(slowPeer, packet.data(), 10), 0);
+    EXPECT_EQ(histogram(receiver, CallbackKind::kOOBData).mCalls, 1u);
+
+    RISTNetCallbackWatchdog::WatchdogStatistics statistics;
+    ASSERT_TRUE(receiver.getWatchdogStatistics(statistics));
+    EXPECT_EQ(statistics.mOffloadEvents, 1u);
+    EXPECT_EQ(statistics.mOffloadedPeers, 1u);
+    EXPECT_EQ(statistics.mQueued, 10u);
+    EXPECT_EQ(statistics.mDropped, 0u);
+    EXPECT_EQ(statistics.mQueueDepth, 0u);
+
+    // Measured again once it reconnects
+    EXPECT_TRUE(transport.disconnectPeer(slowPeer));
+    EXPECT_EQ(histogram(receiver, CallbackKind::kDisconnect).mCalls, 1u);
+    ASSERT_TRUE(receiver.getWatchdogStatistics(statistics));
+    EXPECT_EQ(statistics.mOffloadedPeers, 0u);
+    transport.detach();
+}
+
+TEST(TestRistCallbackWatchdog, StatisticsOffloadAndDrops) {
+    RISTNetReceiver receiver;
+    std::vector<RISTNetCallbackWatchdog::CallbackHistogram> histograms;
+    RISTNetCallbackWatchdog::WatchdogStatistics statistics;
+    EXPECT_FALSE(receiver.getCallbackHistograms(histograms));
+    EXPECT_FALSE(receiver.getWatchdogStatistics(statistics));
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool blocked = false;
+    std::vector<std::string> received;
+    receiver.statisticsCallback = [&](const rist_stats& rStatistics) {
+        std::unique_lock<std::mutex> lock(mutex);
+        received.push_back(rStatistics.stats_json);
+        if (received.size() <= 2) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(3));
+        }
+        condition.wait(lock, [&] { return !blocked; });
+    };
+
+    RISTNetMockTransport transport;
+    RISTNetReceiver::RISTNetReceiverSettings settings;
+    settings.mCallbackWatchdog = true;
+    settings.mWatchdogSettings.mControlBudget = std::chrono::microseconds(0);
+    EXPECT_FALSE(transport.attachReceiver(receiver, settings));
+    settings.mWatchdogSettings.mControlBudget = std::chrono::microseconds(1000);
+    settings.mWatchdogSettings.mViolationLimit = 2;
+    settings.mWatchdogSettings.mOffloadQueueSize = 2;
+    ASSERT_TRUE(transport.attachReceiver(receiver, settings));
+
+    auto inject = [&](int index) {
+        // The JSON goes away after the callback, as with librist
+        std::string json = "{\"index\":" + std::to_string(index) + "}";
+        rist_stats stats{};
+        stats.stats_json = &json[0];
+        stats.json_size = json.size();
+        EXPECT_EQ(transport.injectStatistics(stats), 0);
+    };
+    inject(0);
+    inject(1);
+    ASSERT_TRUE(receiver.getWatchdogStatistics(statistics));
+    EXPECT_EQ(statistics.mOffloadEvents, 1u);
+
+    // The offload thread blocked in the callback, two are queued and the next dropped
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        blocked = true;
+    }
+    inject(2);
+    ASSERT_TRUE(waitFor([&] {
+        receiver.getWatchdogStatistics(statistics);
+        return statistics.mQueueDepth == 0;
+    }));
+    inject(3);
+    inject(4);
+    inject(5);
+    ASSERT_TRUE(receiver.getWatchdogStatistics(statistics));
+    EXPECT_EQ(statistics.mQueued, 3u);
+    EXPECT_EQ(statistics.mDropped, 1u);
+    EXPECT_EQ(statistics.mQueueDepth, 2u);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        blocked = false;
+    }
+    condition.notify_all();
+    ASSERT_TRUE(waitFor([&] { return histogram(receiver, CallbackKind::kStatistics).mCalls == 5; }));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        EXPECT_EQ(received, std::vector<std::string>({"{\"index\":0}", "{\"index\":1}", "{\"index\":2}",
+                                                      "{\"index\":3}", "{\"index\":4}"}));
+    }
+    auto stats = histogram(receiver, CallbackKind::kStatistics);
+    EXPECT_EQ(stats.mOffloaded, 3u);
+    EXPECT_GE(stats.mViolations, 2u);
+    transport.detach();
+}
+
+// The offloaded peers are found without the lock, past 3/4 of the slots through the locked map
+TEST(TestRistCallbackWatchdog, OffloadedPeers) {
+    RISTNetCallbackWatchdog watchdog;
+    RISTNetCallbackWatchdog::RISTNetCallbackWatchdogSettings settings;
+    settings.mViolationLimit = 1;
+    ASSERT_TRUE(watchdog.initWatchdog(settings));
+    std::vector<uint64_t> peerStorage(400);
+    auto peer = [&](size_t index) { return reinterpret_cast<rist_peer *>(&peerStorage[index]); };
+
+    EXPECT_FALSE(watchdog.isOffloaded(CallbackKind::kData, peer(0)));
+    for (size_t i = 0; i < 300; i++) {
+        watchdog.record(CallbackKind::kData, peer(i), std::chrono::milliseconds(1));
+    }
+    watchdog.record(CallbackKind::kData, peer(300), std::chrono::microseconds(1));
+    for (size_t i = 0; i < 400; i++) {
+        EXPECT_EQ(watchdog.isOffloaded(CallbackKind::kData, peer(i)), i < 300) << i;
+    }
+    EXPECT_FALSE(watchdog.isOffloaded(CallbackKind::kStatistics, nullptr));
+
+    // Forgotten, in the slots and over them, then offloaded again
+    for (size_t i = 0; i < 300; i += 2) {
+        watchdog.forgetPeer(peer(i));
+    }
+    for (size_t i = 0; i < 300; i++) {
+        EXPECT_EQ(watchdog.isOffloaded(CallbackKind::kData, peer(i)), i % 2 == 1) << i;
+    }
+    for (size_t i = 0; i < 300; i += 2) {
+        watchdog.record(CallbackKind::kData, peer(i), std::chrono::milliseconds(1));
+    }
+    for (size_t i = 0; i < 300; i++) {
+        EXPECT_TRUE(watchdog.isOffloaded(CallbackKind::kData, peer(i))) << i;
+    }
+    RISTNetCallbackWatchdog::WatchdogStatistics statistics;
+    watchdog.getStatistics(statistics);
+    EXPECT_EQ(statistics.mOffloadedPeers, 300u);
+    EXPECT_TRUE(watchdog.destroyWatchdog());
+}
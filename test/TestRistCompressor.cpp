@@ -0,0 +1,251 @@
+#include <random>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "RISTNetMockTransport.h"
+
+namespace {
+std::vector<uint8_t> makeJson(int index) {
+    std::string json = "{\"sensor\":\"temperature\",\"index\":" + std::to_string(index) +
+                       ",\"values\":[21.5,21.5,21.6,21.6,21.7,21.7,21.8],\"unit\":\"celsius\",\"status\":\"ok\"}";
+    return std::vector<uint8_t>(json.begin(), json.end());
+}
+
+std::vector<uint8_t> makeRandom(size_t size) {
+    static std::mt19937 random(42);
+    std::vector<uint8_t> payload(size);
+    for (auto& byte: payload) {
+        byte = random();
+    }
+    return payload;
+}
+} // namespace
+
+TEST(TestRistCompressor, RoundTripAndSkip) {
+    RISTNetCompressor compressor;
+    RISTNetCompressor::RISTNetCompressorSettings settings;
+    settings.mAcceleration = 0;
+    EXPECT_FALSE(compressor.initCompressor(settings));
+    settings.mAcceleration = 1;
+    settings.mFlows = {3};
+    settings.mBackoff = 2;
+    ASSERT_TRUE(compressor.initCompressor(settings));
+
+    std::vector<uint8_t> compressed;
+    std::vector<uint8_t> decompressed;
+    std::vector<uint8_t> text;
+    for (int i = 0; i < 10; i++) {
+        auto json = makeJson(i);
+        text.insert(text.end(), json.begin(), json.end());
+    }
+    // Flows not selected are not counted
+    EXPECT_FALSE(compressor.compress(text.data(), text.size(), 4, compressed));
+    ASSERT_TRUE(compressor.compress(text.data(), text.size(), 3, compressed));
+    EXPECT_LT(compressed.size(), text.size() / 2);
+    EXPECT_EQ(compressed[1], RISTNetCompressor::kFormatLz4);
+    ASSERT_TRUE(compressor.decompress(compressed.data(), compressed.size(), decompressed));
+    EXPECT_EQ(decompressed, text);
+    size_t compressedSize = compressed.size();
+
+    // Incompressible and small payloads are sent raw, the flow is not tried for mBackoff payloads
+    auto noise = makeRandom(1316);
+    ASSERT_TRUE(compressor.compress(noise.data(), noise.size(), 3, compressed));
+    EXPECT_EQ(compressed.size(), noise.size() + RISTNetCompressor::kRawHeaderSize);
+    EXPECT_EQ(compressed[1], RISTNetCompressor::kFormatRaw);
+    ASSERT_TRUE(compressor.decompress(compressed.data(), compressed.size(), decompressed));
+    EXPECT_EQ(decompressed, noise);
+    ASSERT_TRUE(compressor.compress(text.data(), 32, 3, compressed));
+    EXPECT_EQ(compressed[1], RISTNetCompressor::kFormatRaw);
+    ASSERT_TRUE(compressor.compress(text.data(), text.size(), 3, compressed));
+    EXPECT_EQ(compressed[1], RISTNetCompressor::kFormatRaw);
+    ASSERT_TRUE(compressor.compress(text.data(), text.size(), 3, compressed));
+    EXPECT_EQ(compressed[1], RISTNetCompressor::kFormatLz4);
+
+    RISTNetCompressor::CompressorStatistics statistics;
+    compressor.getStatistics(statistics);
+    EXPECT_EQ(statistics.mCompressed, 2);
+    EXPECT_EQ(statistics.mSkipped, 3);
+    EXPECT_EQ(statistics.mBytesIn, 3 * text.size() + 1316 + 32);
+    EXPECT_EQ(statistics.mBytesOut, 2 * compressedSize + 1316 + 32 + text.size() + 3 * RISTNetCompressor::kRawHeaderSize);
+    EXPECT_LT(statistics.mRatio, 1.0);
+    EXPECT_GT(statistics.mCompressNs, 0);
+    EXPECT_EQ(statistics.mDecompressed, 1);
+    EXPECT_EQ(statistics.mRawReceived, 1);
+}
+
+TEST(TestRistCompressor, Invalid) {
+    RISTNetCompressor compressor;
+    RISTNetCompressor::RISTNetCompressorSettings settings;
+    ASSERT_TRUE(compressor.initCompressor(settings));
+    auto json = makeJson(0);
+    std::vector<uint8_t> compressed;
+    ASSERT_TRUE(compressor.compress(json.data(), json.size(), 0, compressed));
+    std::vector<uint8_t> decompressed;
+    EXPECT_FALSE(compressor.decompress(json.data(), json.size(), decompressed));
+    EXPECT_FALSE(compressor.decompress(compressed.data(), compressed.size() - 1, decompressed));
+    compressed[2]++; // Original size does not match
+    EXPECT_FALSE(compressor.decompress(compressed.data(), compressed.size(), decompressed));
+    compressed[1] = 0x7f; // Format not known
+    EXPECT_FALSE(compressor.decompress(compressed.data(), compressed.size(), decompressed));
+    EXPECT_FALSE(compressor.decompress(compressed.data(), 1, decompressed));
+    RISTNetCompressor::CompressorStatistics statistics;
+    compressor.getStatistics(statistics);
+    EXPECT_EQ(statistics.mDecompressErrors, 5);
+}
+
+// The per thread state, many threads compressing at once
+TEST(TestRistCompressor, Threads) {
+    RISTNetCompressor compressor;
+    RISTNetCompressor::RISTNetCompressorSettings settings;
+    ASSERT_TRUE(compressor.initCompressor(settings));
+    std::vector<std::thread> threads;
+    std::atomic<int> errors{0};
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&, t] {
+            std::vector<uint8_t> compressed;
+            std::vector<uint8_t> decompressed;
+            for (int i = 0; i < 1000; i++) {
+                auto json = makeJson(t * 1000 + i);
+                if (!compressor.compress(json.data(), json.size(), 0, compressed) ||
+                    !compressor.decompress(compressed.data(), compressed.size(), decompressed) ||
+                    decompressed != json) {
+                    errors++;
+                }
+            }
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    EXPECT_EQ(errors, 0);
+}
+
+// Sender with mCompress and mTsOptimize to receiver with mDecompress and mTsNullReinsertion
+TEST(TestRistCompressor, SenderToReceiver) {
+    RISTNetReceiver receiver;
+    receiver.validateConnectionCallback = [](const std::string& ipAddress, uint16_t port) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    std::vector<std::vector<uint8_t>> received;
+    receiver.networkDataCallback = [&](const uint8_t* pBuf, size_t size,
+                                       std::shared_ptr<RISTNetReceiver::NetworkConnection>& rConnection,
+                                       rist_peer* pPeer, uint16_t connectionID) {
+        received.emplace_back(pBuf, pBuf + size);
+        return 0;
+    };
+    RISTNetMockTransport receiverTransport;
+    RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+    receiverSettings.mDecompress = true;
+    receiverSettings.mDecompressorSettings.mFlows = {1};
+    receiverSettings.mTsNullReinsertion = true;
+    ASSERT_TRUE(receiverTransport.attachReceiver(receiver, receiverSettings));
+    rist_peer* peer = receiverTransport.connectPeer("10.0.0.1", 1000);
+    ASSERT_NE(peer, nullptr);
+
+    RISTNetSender sender;
+    RISTNetMockTransport senderTransport;
+    std::vector<size_t> sent;
+    senderTransport.dataWriteCallback = [&](const rist_data_block& rDataBlock) {
+        sent.push_back(rDataBlock.payload_len);
+        receiverTransport.injectData(peer, (const uint8_t*)rDataBlock.payload, rDataBlock.payload_len,
+                                     rDataBlock.flow_id);
+        return (int)rDataBlock.payload_len;
+    };
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    senderSettings.mCompress = true;
+    senderSettings.mCompressorSettings.mFlows = {1};
+    senderSettings.mTsOptimize = true;
+    ASSERT_TRUE(senderTransport.attachSender(sender, senderSettings));
+
+    // Metadata on flow 1 compressed, noise and TS with nulls on flow 2 not
+    auto json = makeJson(1);
+    auto noise = makeRandom(1000);
+    std::vector<uint8_t> ts(2 * 188, 0xff);
+    ts[0] = 0x47;
+    ts[1] = 0x01;
+    ts[188] = 0x47;
+    ts[189] = 0x1f;
+    ts[191] = 0x10;
+    EXPECT_TRUE(sender.sendData(json.data(), json.size(), 1));
+    EXPECT_TRUE(sender.sendData(noise.data(), noise.size(), 1));
+    EXPECT_TRUE(sender.sendData(ts.data(), ts.size(), 2));
+    ASSERT_EQ(received.size(), 3);
+    EXPECT_EQ(received[0], json);
+    EXPECT_EQ(received[1], noise);
+    EXPECT_EQ(received[2], ts);
+    EXPECT_LT(sent[0], json.size());
+    EXPECT_EQ(sent[1], noise.size() + RISTNetTsOptimizer::kRawHeaderSize + RISTNetCompressor::kRawHeaderSize);
+    EXPECT_LT(sent[2], ts.size());
+
+    RISTNetCompressor::CompressorStatistics statistics;
+    ASSERT_TRUE(sender.getCompressionStatistics(statistics));
+    EXPECT_EQ(statistics.mCompressed, 1);
+    EXPECT_EQ(statistics.mSkipped, 1);
+    ASSERT_TRUE(receiver.getCompressionStatistics(statistics));
+    EXPECT_EQ(statistics.mDecompressed, 1);
+    senderTransport.detach();
+    receiverTransport.detach();
+}
+
+// Payloads starting like a compressed header, raw on a flow selected and on one not selected, arrive as they are
+TEST(TestRistCompressor, RawPayloadWithHeaderBytes) {
+    RISTNetReceiver receiver;
+    receiver.validateConnectionCallback = [](const std::string& ipAddress, uint16_t port) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    std::vector<std::vector<uint8_t>> received;
+    receiver.networkDataCallback = [&](const uint8_t* pBuf, size_t size,
+                                       std::shared_ptr<RISTNetReceiver::NetworkConnection>& rConnection,
+                                       rist_peer* pPeer, uint16_t connectionID) {
+        received.emplace_back(pBuf, pBuf + size);
+        return 0;
+    };
+    RISTNetMockTransport receiverTransport;
+    RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+    receiverSettings.mDecompress = true;
+    receiverSettings.mDecompressorSettings.mFlows = {1};
+    ASSERT_TRUE(receiverTransport.attachReceiver(receiver, receiverSettings));
+    rist_peer* peer = receiverTransport.connectPeer("10.0.0.1", 1000);
+    ASSERT_NE(peer, nullptr);
+
+    RISTNetSender sender;
+    RISTNetMockTransport senderTransport;
+    senderTransport.dataWriteCallback = [&](const rist_data_block& rDataBlock) {
+        receiverTransport.injectData(peer, (const uint8_t*)rDataBlock.payload, rDataBlock.payload_len,
+                                     rDataBlock.flow_id);
+        return (int)rDataBlock.payload_len;
+    };
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    senderSettings.mCompress = true;
+    senderSettings.mCompressorSettings.mFlows = {1};
+    ASSERT_TRUE(senderTransport.attachSender(sender, senderSettings));
+
+    // Too small to compress, incompressible, and on a flow not selected
+    std::vector<uint8_t> small = {0xC4, 0x01, 0x10, 0x00, 0xde, 0xad, 0xbe, 0xef};
+    auto noise = makeRandom(1316);
+    noise[0] = 0xC4;
+    noise[1] = 0x01;
+    noise[2] = 0xff;
+    noise[3] = 0xff;
+    EXPECT_TRUE(sender.sendData(small.data(), small.size(), 1));
+    EXPECT_TRUE(sender.sendData(noise.data(), noise.size(), 1));
+    EXPECT_TRUE(sender.sendData(small.data(), small.size(), 2));
+    EXPECT_TRUE(sender.sendData(noise.data(), noise.size(), 2));
+    ASSERT_EQ(received.size(), 4);
+    EXPECT_EQ(received[0], small);
+    EXPECT_EQ(received[1], noise);
+    EXPECT_EQ(received[2], small);
+    EXPECT_EQ(received[3], noise);
+
+    // A payload of a flow selected without the header is dropped, never guessed
+    EXPECT_EQ(receiverTransport.injectData(peer, small.data(), small.size(), 1), -1);
+    EXPECT_EQ(received.size(), 4);
+    RISTNetCompressor::CompressorStatistics statistics;
+    ASSERT_TRUE(receiver.getCompressionStatistics(statistics));
+    EXPECT_EQ(statistics.mDecompressed, 0);
+    EXPECT_EQ(statistics.mRawReceived, 2);
+    EXPECT_EQ(statistics.mDecompressErrors, 1);
+    senderTransport.detach();
+    receiverTransport.detach();
+}
@@ -0,0 +1,260 @@
+#include <gtest/gtest.h>
+
+#include "RISTNetMockTransport.h"
+
+namespace {
+constexpr uint64_t kPacketBits = 1316 * 8;
+
+// A link of mCapacity bps with a buffer of mBuffer bits, what does not fit is lost and retransmitted.
+// Produces the sender peer statistics librist would report for one interval.
+struct RateLimitedLink {
+    rist_stats_sender_peer interval(uint64_t bitrate, std::chrono::milliseconds duration, uint64_t& rOffered) {
+        double seconds = duration.count() / 1000.0;
+        rOffered = (uint64_t)(bitrate * seconds / kPacketBits);
+        double offeredBits = rOffered * kPacketBits + mLostBits;
+        double drained = std::min(mQueue + offeredBits, mCapacity * seconds);
+        mQueue += offeredBits - drained;
+        double lost = std::max(0.0, mQueue - mBuffer);
+        mQueue -= lost;
+        mLostBits = lost;
+        rist_stats_sender_peer statistics{};
+        statistics.peer_id = 1;
+        statistics.sent = (uint64_t)(drained / kPacketBits);
+        statistics.retransmitted = (uint64_t)(lost / kPacketBits);
+        statistics.bandwidth = (size_t)(drained / seconds);
+        statistics.rtt = (uint32_t)(mBaseRtt + mQueue * 1000.0 / mCapacity);
+        return statistics;
+    }
+
+    double mCapacity = 4000000;
+    double mBuffer = 400000;    // 100 ms at 4 Mbps
+    double mBaseRtt = 20;       // ms
+    double mQueue = 0;
+    double mLostBits = 0;
+};
+} // namespace
+
+// Starting over the capacity of the link the target goes under it, then settles without flapping and follows
+// the capacity up
+TEST(TestRistCongestionMonitor, RateLimitedLink) {
+    RISTNetCongestionMonitor monitor;
+    RISTNetCongestionMonitor::RISTNetCongestionSettings settings;
+    settings.mStartBitrate = 10000000;
+    ASSERT_TRUE(monitor.initMonitor(settings));
+    int changes = 0;
+    monitor.congestionCallback = [&](const RISTNetCongestionMonitor::CongestionSnapshot& rSnapshot) { changes++; };
+
+    RateLimitedLink link;
+    auto now = std::chrono::steady_clock::now();
+    std::vector<uint64_t> targets;
+    auto run = [&](int intervals) {
+        for (int i = 0; i < intervals; i++) {
+            uint64_t offered;
+            auto statistics = link.interval(monitor.getTargetBitrate(), settings.mInterval, offered);
+            monitor.countOffered(offered);
+            now += settings.mInterval;
+            monitor.pushStatistics(statistics, now);
+            targets.push_back(monitor.getTargetBitrate());
+        }
+    };
+
+    // 2 seconds to go under 4 Mbps
+    run(10);
+    EXPECT_LT(targets.back(), 4000000);
+    EXPECT_GT(targets.back(), 1500000);
+    EXPECT_GE(changes, 2);
+
+    // 20 seconds, most of the link used, the queue kept short, the target never goes down right after going up
+    changes = 0;
+    targets.clear();
+    run(100);
+    uint64_t sum = 0;
+    for (auto target: targets) {
+        sum += target;
+        EXPECT_LT(target, 4600000);
+    }
+    EXPECT_GT(sum / targets.size(), 2800000);
+    EXPECT_LE(changes, 60);
+    for (size_t i = 2; i < targets.size(); i++) {
+        bool down = targets[i] < targets[i - 1];
+        bool up = targets[i - 1] > targets[i - 2];
+        EXPECT_FALSE(down && up) << "Flapping at " << i;
+    }
+    EXPECT_LT(link.mQueue, link.mBuffer);
+
+    // More capacity, the target follows within 10 seconds
+    link.mCapacity = 8000000;
+    link.mBuffer = 800000;
+    run(50);
+    EXPECT_GT(monitor.getTargetBitrate(), 6000000);
+
+    RISTNetCongestionMonitor::CongestionSnapshot snapshot;
+    monitor.getSnapshot(snapshot);
+    EXPECT_EQ(snapshot.mUpdates, 160);
+    EXPECT_EQ(snapshot.mPeers, 1);
+    EXPECT_EQ(snapshot.mWorstPeer, 1);
+}
+
+// The worst peer counts, peers not reporting are forgotten
+TEST(TestRistCongestionMonitor, WorstPeer) {
+    RISTNetCongestionMonitor monitor;
+    RISTNetCongestionMonitor::RISTNetCongestionSettings settings;
+    settings.mStartBitrate = 4000000;
+    settings.mMinBitrate = 0;
+    EXPECT_FALSE(monitor.initMonitor(settings));
+    settings.mMinBitrate = 1000000;
+    ASSERT_TRUE(monitor.initMonitor(settings));
+
+    auto now = std::chrono::steady_clock::now();
+    rist_stats_sender_peer good{};
+    good.peer_id = 1;
+    good.sent = 80;
+    good.bandwidth = 4000000;
+    good.rtt = 20;
+    rist_stats_sender_peer lossy = good;
+    lossy.peer_id = 2;
+
+    // One interval both clean
+    now += settings.mInterval;
+    monitor.pushStatistics(good, now);
+    monitor.pushStatistics(lossy, now);
+    // Then peer 2 retransmits 10%, evaluated once both reported
+    lossy.retransmitted = 8;
+    now += settings.mInterval;
+    monitor.pushStatistics(good, now);
+    EXPECT_EQ(monitor.getTargetBitrate(), 4000000);
+    monitor.pushStatistics(lossy, now);
+    RISTNetCongestionMonitor::CongestionSnapshot snapshot;
+    monitor.getSnapshot(snapshot);
+    EXPECT_EQ(snapshot.mState, RISTNetCongestionMonitor::CongestionState::kCongested);
+    EXPECT_EQ(snapshot.mWorstPeer, 2);
+    EXPECT_DOUBLE_EQ(snapshot.mRetransmitRatio, 0.1);
+    EXPECT_EQ(snapshot.mTargetBitrate, 3400000);
+    EXPECT_EQ(snapshot.mPeers, 2);
+
+    // Peer 2 gone, peer 1 alone evaluated after 1.5 intervals
+    for (int i = 0; i < 6; i++) {
+        now += settings.mInterval * 2;
+        monitor.pushStatistics(good, now);
+    }
+    monitor.getSnapshot(snapshot);
+    EXPECT_EQ(snapshot.mPeers, 1);
+    EXPECT_EQ(snapshot.mWorstPeer, 1);
+    EXPECT_GT(snapshot.mTargetBitrate, 3400000);
+}
+
+// Peers duplicating the stream each send every packet offered, with mLoadBalanced they share them
+TEST(TestRistCongestionMonitor, DuplicatePeers) {
+    for (bool loadBalanced: {false, true}) {
+        RISTNetCongestionMonitor monitor;
+        RISTNetCongestionMonitor::RISTNetCongestionSettings settings;
+        settings.mStartBitrate = 4000000;
+        settings.mLoadBalanced = loadBalanced;
+        ASSERT_TRUE(monitor.initMonitor(settings));
+
+        // Two intervals both reporting, from then on evaluated once both reported. Then 100 offered and each of the
+        // two peers sends 50 at 2 Mbps
+        auto now = std::chrono::steady_clock::now();
+        rist_stats_sender_peer first{};
+        first.peer_id = 1;
+        first.rtt = 20;
+        rist_stats_sender_peer second = first;
+        second.peer_id = 2;
+        for (int i = 0; i < 2; i++) {
+            now += settings.mInterval;
+            monitor.pushStatistics(first, now);
+            monitor.pushStatistics(second, now);
+        }
+        first.sent = second.sent = 50;
+        first.bandwidth = second.bandwidth = 2000000;
+        monitor.countOffered(100);
+        now += settings.mInterval;
+        monitor.pushStatistics(first, now);
+        monitor.pushStatistics(second, now);
+
+        RISTNetCongestionMonitor::CongestionSnapshot snapshot;
+        monitor.getSnapshot(snapshot);
+        if (loadBalanced) {
+            EXPECT_DOUBLE_EQ(snapshot.mQueueGrowth, 0.0);
+            EXPECT_EQ(snapshot.mDeliveredBitrate, 4000000);
+            EXPECT_NE(snapshot.mState, RISTNetCongestionMonitor::CongestionState::kCongested);
+            EXPECT_GE(snapshot.mTargetBitrate, 4000000);
+        } else {
+            // Half of the packets not sent by either, smoothed
+            EXPECT_DOUBLE_EQ(snapshot.mQueueGrowth, 0.25);
+            EXPECT_EQ(snapshot.mDeliveredBitrate, 2000000);
+            EXPECT_EQ(snapshot.mState, RISTNetCongestionMonitor::CongestionState::kCongested);
+            EXPECT_EQ(snapshot.mTargetBitrate, 2000000);
+        }
+    }
+}
+
+// A link of 1 ms, a jitter of 1 to 2 ms is not RTT inflation, 10 ms is
+TEST(TestRistCongestionMonitor, LowRttLink) {
+    RISTNetCongestionMonitor monitor;
+    RISTNetCongestionMonitor::RISTNetCongestionSettings settings;
+    settings.mStartBitrate = 4000000;
+    ASSERT_TRUE(monitor.initMonitor(settings));
+
+    auto now = std::chrono::steady_clock::now();
+    rist_stats_sender_peer statistics{};
+    statistics.peer_id = 1;
+    statistics.sent = 80;
+    statistics.bandwidth = 4000000;
+    RISTNetCongestionMonitor::CongestionSnapshot snapshot;
+    for (int i = 0; i < 50; i++) {
+        statistics.rtt = (i % 3) ? 1 : 2;
+        monitor.countOffered(80);
+        now += settings.mInterval;
+        monitor.pushStatistics(statistics, now);
+        monitor.getSnapshot(snapshot);
+        EXPECT_NE(snapshot.mState, RISTNetCongestionMonitor::CongestionState::kCongested) << "At " << i;
+        EXPECT_DOUBLE_EQ(snapshot.mRttInflation, 1.0);
+    }
+    EXPECT_GE(monitor.getTargetBitrate(), 4000000);
+
+    statistics.rtt = 10;
+    monitor.countOffered(80);
+    now += settings.mInterval;
+    monitor.pushStatistics(statistics, now);
+    monitor.getSnapshot(snapshot);
+    EXPECT_EQ(snapshot.mState, RISTNetCongestionMonitor::CongestionState::kCongested);
+    EXPECT_DOUBLE_EQ(snapshot.mRttInflation, 10.0);
+}
+
+// Through the sender, statistics from the transport and the packets offered to sendData
+TEST(TestRistCongestionMonitor, Sender) {
+    RISTNetSender sender;
+    RISTNetMockTransport transport;
+    RISTNetSender::RISTNetSenderSettings settings;
+    settings.mCongestionFeedback = true;
+    settings.mCongestionSettings.mStartBitrate = 4000000;
+    ASSERT_TRUE(transport.attachSender(sender, settings));
+    EXPECT_EQ(sender.getTargetBitrate(), 4000000);
+    std::vector<uint64_t> targets;
+    sender.congestionCallback = [&](const RISTNetCongestionMonitor::CongestionSnapshot& rSnapshot) {
+        targets.push_back(rSnapshot.mTargetBitrate);
+    };
+
+    // 100 packets offered, 50 sent: the send queue grows
+    std::vector<uint8_t> packet(1316);
+    for (int i = 0; i < 100; i++) {
+        EXPECT_TRUE(sender.sendData(packet.data(), packet.size()));
+    }
+    rist_stats statistics{};
+    statistics.stats_type = RIST_STATS_SENDER_PEER;
+    statistics.stats.sender_peer.peer_id = 1;
+    statistics.stats.sender_peer.sent = 50;
+    statistics.stats.sender_peer.bandwidth = 2600000;
+    statistics.stats.sender_peer.rtt = 20;
+    EXPECT_EQ(transport.injectStatistics(statistics), 0);
+    EXPECT_EQ(targets, std::vector<uint64_t>({2600000}));
+    RISTNetCongestionMonitor::CongestionSnapshot snapshot;
+    ASSERT_TRUE(sender.getCongestion(snapshot));
+    EXPECT_DOUBLE_EQ(snapshot.mQueueGrowth, 0.25);
+    transport.detach();
+
+    RISTNetSender plain;
+    EXPECT_FALSE(plain.getCongestion(snapshot));
+    EXPECT_EQ(plain.getTargetBitrate(), 0);
+}
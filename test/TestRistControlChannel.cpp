@@ -0,0 +1,204 @@
+#include <gtest/gtest.h>
+
+#include "RISTNetControlChannel.h"
+#include "RISTNetMockTransport.h"
+
+namespace {
+constexpr uint16_t kKeyframeRequest = 1;
+constexpr uint16_t kBitrateRequest = 2;
+constexpr uint16_t kStatus = 3;
+
+// A receiver and a sender connected through two mock transports, OOB in both directions
+struct MockLink {
+    MockLink() {
+        receiver.validateConnectionCallback = [](const std::string& ipAddress, uint16_t port) {
+            return std::make_shared<RISTNetReceiver::NetworkConnection>();
+        };
+        sender.validateConnectionCallback = [](const std::string& ipAddress, uint16_t port) {
+            return std::make_shared<RISTNetSender::NetworkConnection>();
+        };
+        receiverTransport.oobWriteCallback = [&](const rist_oob_block& rOOBBlock) {
+            return drop ? 0 : senderTransport.injectOOBData(senderPeer, (const uint8_t*)rOOBBlock.payload,
+                                                            rOOBBlock.payload_len);
+        };
+        senderTransport.oobWriteCallback = [&](const rist_oob_block& rOOBBlock) {
+            return drop ? 0 : receiverTransport.injectOOBData(receiverPeer, (const uint8_t*)rOOBBlock.payload,
+                                                              rOOBBlock.payload_len);
+        };
+    }
+
+    bool attach(RISTNetControlChannel& rReceiverChannel, RISTNetControlChannel& rSenderChannel) {
+        RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+        RISTNetSender::RISTNetSenderSettings senderSettings;
+        if (!rReceiverChannel.attachReceiver(receiver) || !rSenderChannel.attachSender(sender) ||
+            !receiverTransport.attachReceiver(receiver, receiverSettings) ||
+            !senderTransport.attachSender(sender, senderSettings)) {
+            return false;
+        }
+        receiverPeer = receiverTransport.connectPeer("10.0.0.2", 2000);
+        senderPeer = senderTransport.connectPeer("10.0.0.1", 1000);
+        return receiverPeer && senderPeer;
+    }
+
+    ~MockLink() {
+        senderTransport.detach();
+        receiverTransport.detach();
+    }
+
+    RISTNetReceiver receiver;
+    RISTNetSender sender;
+    RISTNetMockTransport receiverTransport;
+    RISTNetMockTransport senderTransport;
+    rist_peer* receiverPeer = nullptr; // The sender, seen from the receiver
+    rist_peer* senderPeer = nullptr;   // The receiver, seen from the sender
+    bool drop = false;
+};
+} // namespace
+
+TEST(TestRistControlChannel, RequestResponseBothDirections) {
+    RISTNetControlChannel receiverChannel;
+    RISTNetControlChannel senderChannel;
+    MockLink link;
+
+    // The encoder side answers keyframe and bitrate requests
+    int keyframes = 0;
+    ASSERT_TRUE(senderChannel.setHandler(kKeyframeRequest, [&](const RISTNetControlChannel::ControlMessage& rMessage) {
+        EXPECT_EQ(rMessage.mKind, RISTNetControlChannel::kRequest);
+        EXPECT_EQ(rMessage.pPeer, link.senderPeer);
+        keyframes++;
+        uint8_t ok = 1;
+        EXPECT_TRUE(senderChannel.respond(rMessage, &ok, 1));
+    }));
+    ASSERT_TRUE(senderChannel.setHandler(kBitrateRequest, [&](const RISTNetControlChannel::ControlMessage& rMessage) {
+        uint32_t bitrate;
+        ASSERT_EQ(rMessage.mSize, sizeof(bitrate));
+        memcpy(&bitrate, rMessage.pPayload, sizeof(bitrate));
+        bitrate /= 2;
+        EXPECT_TRUE(senderChannel.respond(rMessage, (const uint8_t*)&bitrate, sizeof(bitrate)));
+    }));
+    // The receiver side gets status notifications and answers status requests
+    std::string status;
+    ASSERT_TRUE(receiverChannel.setHandler(kStatus, [&](const RISTNetControlChannel::ControlMessage& rMessage) {
+        status.assign((const char*)rMessage.pPayload, rMessage.mSize);
+        if (rMessage.mKind == RISTNetControlChannel::kRequest) {
+            EXPECT_TRUE(receiverChannel.respond(rMessage, (const uint8_t*)"good", 4));
+        }
+    }));
+    EXPECT_FALSE(receiverChannel.setHandler(RISTNetControlChannel::kMaxTypes, nullptr));
+    ASSERT_TRUE(link.attach(receiverChannel, senderChannel));
+    EXPECT_FALSE(receiverChannel.setHandler(kStatus, nullptr));
+
+    std::vector<std::pair<uint64_t, std::vector<uint8_t>>> responses;
+    receiverChannel.responseCallback = [&](const RISTNetControlChannel::ControlMessage& rResponse, uint64_t userData,
+                                           std::chrono::nanoseconds roundTrip) {
+        EXPECT_EQ(rResponse.mKind, RISTNetControlChannel::kResponse);
+        EXPECT_GT(roundTrip.count(), 0);
+        responses.emplace_back(userData, std::vector<uint8_t>(rResponse.pPayload, rResponse.pPayload + rResponse.mSize));
+    };
+    uint32_t id = receiverChannel.request(link.receiverPeer, kKeyframeRequest, nullptr, 0, 11);
+    EXPECT_NE(id, 0);
+    uint32_t bitrate = 8000000;
+    EXPECT_NE(receiverChannel.request(link.receiverPeer, kBitrateRequest, (const uint8_t*)&bitrate, sizeof(bitrate), 12),
+              id);
+    ASSERT_EQ(responses.size(), 2);
+    EXPECT_EQ(keyframes, 1);
+    EXPECT_EQ(responses[0], std::make_pair(uint64_t(11), std::vector<uint8_t>({1})));
+    uint32_t halved = 4000000;
+    EXPECT_EQ(responses[1].first, 12);
+    EXPECT_EQ(responses[1].second, std::vector<uint8_t>((uint8_t*)&halved, (uint8_t*)&halved + 4));
+
+    // The other direction
+    std::string senderResponse;
+    senderChannel.responseCallback = [&](const RISTNetControlChannel::ControlMessage& rResponse, uint64_t userData,
+                                         std::chrono::nanoseconds roundTrip) {
+        senderResponse.assign((const char*)rResponse.pPayload, rResponse.mSize);
+    };
+    EXPECT_TRUE(senderChannel.notify(link.senderPeer, kStatus, (const uint8_t*)"encoding", 8));
+    EXPECT_EQ(status, "encoding");
+    EXPECT_NE(senderChannel.request(link.senderPeer, kStatus, (const uint8_t*)"status?", 7), 0);
+    EXPECT_EQ(senderResponse, "good");
+
+    RISTNetControlChannel::ControlStatistics statistics;
+    receiverChannel.getStatistics(statistics);
+    EXPECT_EQ(statistics.mRequests, 2);
+    EXPECT_EQ(statistics.mResponses, 2);
+    EXPECT_EQ(statistics.mSent, 3);
+    EXPECT_EQ(statistics.mReceived, 4);
+    EXPECT_EQ(statistics.mTimeouts + statistics.mUnmatched + statistics.mInvalid + statistics.mUnhandled, 0);
+}
+
+TEST(TestRistControlChannel, TimeoutsAndInvalid) {
+    RISTNetControlChannel receiverChannel;
+    RISTNetControlChannel senderChannel;
+    MockLink link;
+    ASSERT_TRUE(senderChannel.setHandler(kKeyframeRequest, [&](const RISTNetControlChannel::ControlMessage& rMessage) {
+        senderChannel.respond(rMessage, nullptr, 0);
+    }));
+    ASSERT_TRUE(link.attach(receiverChannel, senderChannel));
+    std::vector<uint64_t> timedOut;
+    receiverChannel.timeoutCallback = [&](uint32_t id, uint64_t userData) { timedOut.push_back(userData); };
+    int responses = 0;
+    receiverChannel.responseCallback = [&](const RISTNetControlChannel::ControlMessage& rResponse, uint64_t userData,
+                                           std::chrono::nanoseconds roundTrip) { responses++; };
+
+    // Lost requests expire, more than the table holds pushes the oldest out
+    link.drop = true;
+    for (uint64_t i = 0; i < RISTNetControlChannel::kMaxPending + 1; i++) {
+        EXPECT_NE(receiverChannel.request(link.receiverPeer, kKeyframeRequest, nullptr, 0, i), 0);
+    }
+    EXPECT_EQ(timedOut, std::vector<uint64_t>({0}));
+    EXPECT_EQ(receiverChannel.expireRequests(std::chrono::seconds(10)), 0);
+    EXPECT_EQ(receiverChannel.expireRequests(std::chrono::microseconds(0)), RISTNetControlChannel::kMaxPending);
+    EXPECT_EQ(timedOut.size(), RISTNetControlChannel::kMaxPending + 1);
+
+    link.drop = false;
+    // Not a frame, a type without handler, a response to nothing
+    std::string raw = "raw";
+    EXPECT_EQ(link.receiverTransport.injectOOBData(link.receiverPeer, (const uint8_t*)raw.data(), raw.size()), 0);
+    EXPECT_TRUE(receiverChannel.notify(link.receiverPeer, kStatus, nullptr, 0));
+    uint8_t response[8] = {RISTNetControlChannel::kControlMarker, RISTNetControlChannel::kResponse, 1, 0, 42, 0, 0, 0};
+    EXPECT_EQ(link.receiverTransport.injectOOBData(link.receiverPeer, response, sizeof(response)), 0);
+    EXPECT_EQ(responses, 0);
+
+    // The response to a pending request from another peer, then from the peer asked
+    link.drop = true;
+    uint32_t id = receiverChannel.request(link.receiverPeer, kKeyframeRequest, nullptr, 0);
+    ASSERT_NE(id, 0);
+    link.drop = false;
+    rist_peer* otherPeer = link.receiverTransport.connectPeer("10.0.0.3", 3000);
+    ASSERT_NE(otherPeer, nullptr);
+    memcpy(&response[4], &id, sizeof(id));
+    EXPECT_EQ(link.receiverTransport.injectOOBData(otherPeer, response, sizeof(response)), 0);
+    EXPECT_EQ(responses, 0);
+    EXPECT_EQ(link.receiverTransport.injectOOBData(link.receiverPeer, response, sizeof(response)), 0);
+    EXPECT_EQ(responses, 1);
+
+    RISTNetControlChannel::ControlStatistics statistics;
+    receiverChannel.getStatistics(statistics);
+    EXPECT_EQ(statistics.mTimeouts, RISTNetControlChannel::kMaxPending + 1);
+    EXPECT_EQ(statistics.mInvalid, 1);
+    EXPECT_EQ(statistics.mUnmatched, 2);
+    senderChannel.getStatistics(statistics);
+    EXPECT_EQ(statistics.mUnhandled, 1);
+}
+
+// OOB data from a peer without connection gets the same empty connection, not one allocated per message
+TEST(TestRistControlChannel, EmptyConnection) {
+    RISTNetReceiver receiver;
+    std::vector<RISTNetReceiver::NetworkConnection*> connections;
+    receiver.networkOOBDataCallback = [&](const uint8_t* pBuf, size_t size,
+                                          std::shared_ptr<RISTNetReceiver::NetworkConnection>& rConnection,
+                                          rist_peer* pPeer) {
+        EXPECT_FALSE(rConnection->mObject.has_value());
+        connections.push_back(rConnection.get());
+    };
+    RISTNetMockTransport transport;
+    RISTNetReceiver::RISTNetReceiverSettings settings;
+    ASSERT_TRUE(transport.attachReceiver(receiver, settings));
+    uint8_t data[4] = {};
+    EXPECT_EQ(transport.injectOOBData(nullptr, data, sizeof(data)), 0);
+    EXPECT_EQ(transport.injectOOBData(nullptr, data, sizeof(data)), 0);
+    ASSERT_EQ(connections.size(), 2);
+    EXPECT_EQ(connections[0], connections[1]);
+    transport.detach();
+}
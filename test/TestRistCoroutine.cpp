@@ -0,0 +1,187 @@
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "RISTNetCoroutine.h"
+
+namespace {
+// Stands in for librist calling the receiver callbacks
+void deliver(RISTNetReceiver& receiver, uint8_t value, uint16_t connectionID) {
+    auto buffer = RISTNetPacketPool::defaultPool().copy(&value, 1);
+    std::shared_ptr<RISTNetReceiver::NetworkConnection> connection;
+    receiver.networkBufferCallback(buffer, connection, nullptr, connectionID);
+}
+
+RISTNetTask readAll(RISTNetCoReceiver& coReceiver, std::vector<uint8_t>& values, bool& done) {
+    while (true) {
+        auto packet = co_await coReceiver.read();
+        if (!packet.mData) {
+            break;
+        }
+        values.push_back(packet.mData.data()[0]);
+        EXPECT_EQ(packet.mConnectionID, 7);
+    }
+    done = true;
+}
+
+RISTNetTask acceptAll(RISTNetCoReceiver& coReceiver, std::vector<std::string>& addresses) {
+    while (true) {
+        auto connection = co_await coReceiver.nextConnection();
+        if (!connection.mConnection) {
+            break;
+        }
+        addresses.push_back(connection.mIPAddress);
+    }
+}
+
+RISTNetTask sendAll(RISTNetExecutor& executor, RISTNetCoSender& coSender, int count, std::atomic<int>& sent) {
+    co_await executor.schedule();
+    for (int i = 0; i < count; i++) {
+        uint8_t value = i;
+        if (!co_await coSender.send(&value, 1, 3)) {
+            break;
+        }
+        sent++;
+    }
+    coSender.close();
+}
+
+RISTNetTask scheduleTwice(RISTNetExecutor& executor, std::vector<int>& order, int index) {
+    co_await executor.schedule();
+    order.push_back(index);
+    co_await executor.schedule();
+    order.push_back(index + 1000);
+}
+} // namespace
+
+TEST(TestRistCoroutine, ReadAndConnections) {
+    RISTNetLoopExecutor executor;
+    RISTNetReceiver receiver;
+    receiver.validateConnectionCallback = [](const std::string& ipAddress, uint16_t port) {
+        return ipAddress == "10.0.0.1" ? std::make_shared<RISTNetReceiver::NetworkConnection>() : nullptr;
+    };
+    RISTNetCoReceiver coReceiver(executor, 4);
+    coReceiver.attachReceiver(receiver);
+
+    std::vector<uint8_t> values;
+    std::vector<std::string> addresses;
+    bool done = false;
+    readAll(coReceiver, values, done);
+    acceptAll(coReceiver, addresses);
+
+    // The waiting coroutine gets the first packet, the queue the next 4, the last is dropped
+    for (uint8_t i = 0; i < 6; i++) {
+        deliver(receiver, i, 7);
+    }
+    EXPECT_EQ(coReceiver.getDropped(), 1);
+    EXPECT_TRUE(values.empty());
+    executor.poll();
+    ASSERT_EQ(values.size(), 5);
+    for (uint8_t i = 0; i < 5; i++) {
+        EXPECT_EQ(values[i], i);
+    }
+
+    EXPECT_TRUE(receiver.validateConnectionCallback("10.0.0.1", 1000));
+    EXPECT_FALSE(receiver.validateConnectionCallback("10.0.0.2", 1000));
+    executor.poll();
+    ASSERT_EQ(addresses.size(), 1);
+    EXPECT_EQ(addresses[0], "10.0.0.1");
+
+    coReceiver.close();
+    executor.poll();
+    EXPECT_TRUE(done);
+}
+
+TEST(TestRistCoroutine, SendBackpressure) {
+    RISTNetLoopExecutor executor;
+    std::mutex sentMtx;
+    std::vector<uint8_t> received;
+    std::atomic<bool> blocked{true};
+    RISTNetCoSender coSender(executor, 2);
+    ASSERT_TRUE(coSender.attachSendFunction([&](const uint8_t* data, size_t size, uint16_t connectionID) {
+        while (blocked) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        EXPECT_EQ(connectionID, 3);
+        std::lock_guard<std::mutex> lock(sentMtx);
+        received.push_back(data[0]);
+        return true;
+    }));
+
+    std::thread loop([&]() { executor.run(); });
+    std::atomic<int> sent{0};
+    const int kPackets = 50;
+    sendAll(executor, coSender, kPackets, sent);
+
+    // The send function blocks on the first packet, 2 are queued and the coroutine is suspended
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_LE(sent, 3);
+    blocked = false;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (std::chrono::steady_clock::now() < deadline) {
+        {
+            std::lock_guard<std::mutex> lock(sentMtx);
+            if (received.size() == kPackets) {
+                break;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    executor.stop();
+    loop.join();
+    EXPECT_EQ(sent, kPackets);
+    std::lock_guard<std::mutex> lock(sentMtx);
+    ASSERT_EQ(received.size(), kPackets);
+    for (int i = 0; i < kPackets; i++) {
+        EXPECT_EQ(received[i], i);
+    }
+    EXPECT_EQ(coSender.getFailures(), 0);
+}
+
+TEST(TestRistCoroutine, CloseResumesSenders) {
+    RISTNetLoopExecutor executor;
+    std::atomic<bool> blocked{true};
+    RISTNetCoSender coSender(executor, 1);
+    ASSERT_TRUE(coSender.attachSendFunction([&](const uint8_t* data, size_t size, uint16_t connectionID) {
+        while (blocked) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return false;
+    }));
+    std::atomic<int> sent{0};
+    sendAll(executor, coSender, 10, sent);
+    // One packet in the send function, one queued, the third send waits for room
+    for (int i = 0; i < 2; i++) {
+        executor.poll();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    EXPECT_EQ(sent, 2);
+
+    // Close from another thread while the coroutine waits for room
+    std::thread closer([&]() { coSender.close(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    blocked = false;
+    closer.join();
+    executor.poll();
+    EXPECT_EQ(sent, 2);
+    EXPECT_EQ(coSender.getFailures(), 2);
+}
+
+// More coroutines ready than the ring holds, resumed in the order posted
+TEST(TestRistCoroutine, ExecutorRingGrows) {
+    RISTNetLoopExecutor executor(4);
+    std::vector<int> order;
+    for (int i = 0; i < 100; i++) {
+        scheduleTwice(executor, order, i);
+    }
+    EXPECT_TRUE(order.empty());
+    // The second schedule of each is posted while the first ones are resumed, not resumed by this poll
+    EXPECT_EQ(executor.poll(), 100);
+    EXPECT_EQ(executor.poll(), 100);
+    EXPECT_EQ(executor.poll(), 0);
+    ASSERT_EQ(order.size(), 200);
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(order[i], i);
+        EXPECT_EQ(order[100 + i], 1000 + i);
+    }
+}
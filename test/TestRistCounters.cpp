@@ -0,0 +1,97 @@
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "RISTNetCounters.h"
+
+namespace {
+RISTNetCounterSnapshot find(const std::vector<RISTNetCounterSnapshot>& counters, uint64_t key) {
+    for (auto& counter : counters) {
+        if (counter.mKey == key) {
+            return counter;
+        }
+    }
+    ADD_FAILURE() << "No counters of key " << key;
+    return {};
+}
+} // namespace
+
+TEST(TestRistCounters, PacketsAndErrors) {
+    RISTNetCounterTable table;
+    std::vector<RISTNetCounterSnapshot> counters;
+    table.getCounters(counters);
+    EXPECT_TRUE(counters.empty());
+
+    table.countPacket(1, 100, false);
+    table.countPacket(2, 200, true);
+    table.countPacket(1, 100, false, true);
+    table.getCounters(counters);
+    ASSERT_EQ(counters.size(), 2);
+    auto flow1 = find(counters, 1);
+    EXPECT_EQ(flow1.mPackets, 2);
+    EXPECT_EQ(flow1.mBytes, 200);
+    EXPECT_EQ(flow1.mDiscontinuities, 1);
+    EXPECT_EQ(flow1.mErrors, 0);
+    auto flow2 = find(counters, 2);
+    EXPECT_EQ(flow2.mPackets, 1);
+    EXPECT_EQ(flow2.mErrors, 1);
+}
+
+TEST(TestRistCounters, SequenceGaps) {
+    RISTNetCounterTable table;
+    // 10, 11, (12, 13 missing) 14, 13 late, 15, then a wrap of the 32 bit sequence number
+    for (uint64_t seq : {10, 11, 14, 13, 15}) {
+        table.countPacket(7, 1, false, false, seq);
+    }
+    for (uint64_t seq : {0xfffffffeULL, 0xffffffffULL, 0x100000000ULL}) {
+        table.countPacket(8, 1, false, false, seq);
+    }
+    // A restarted sender is not a loss
+    table.countPacket(8, 1, false, false, 5000000);
+    table.countPacket(8, 1, false, false, 5000002);
+
+    std::vector<RISTNetCounterSnapshot> counters;
+    table.getCounters(counters);
+    auto flow7 = find(counters, 7);
+    EXPECT_EQ(flow7.mPackets, 5);
+    EXPECT_EQ(flow7.mSeqGaps, 2);
+    EXPECT_EQ(flow7.mReordered, 1);
+    auto flow8 = find(counters, 8);
+    EXPECT_EQ(flow8.mPackets, 5);
+    EXPECT_EQ(flow8.mSeqGaps, 1);
+    EXPECT_EQ(flow8.mReordered, 0);
+}
+
+TEST(TestRistCounters, Overflow) {
+    RISTNetCounterTable table;
+    for (uint64_t key = 0; key < RISTNetCounterTable::kSlots + 10; key++) {
+        table.countPacket(key, 1, false);
+    }
+    std::vector<RISTNetCounterSnapshot> counters;
+    table.getCounters(counters);
+    EXPECT_EQ(counters.size(), RISTNetCounterTable::kSlots);
+    EXPECT_EQ(table.getOverflow(), 10);
+}
+
+TEST(TestRistCounters, ConsistentSnapshots) {
+    RISTNetCounterTable table;
+    std::atomic<bool> stop{false};
+    std::thread writer([&]() {
+        uint64_t seq = 0;
+        while (!stop) {
+            table.countPacket(seq % 4, 188, false, false, seq / 4);
+            seq++;
+        }
+    });
+    // Every snapshot of a flow has bytes and packets of the same update
+    std::vector<RISTNetCounterSnapshot> counters;
+    for (int i = 0; i < 10000; i++) {
+        table.getCounters(counters);
+        for (auto& counter : counters) {
+            ASSERT_EQ(counter.mBytes, counter.mPackets * 188);
+            ASSERT_EQ(counter.mSeqGaps, 0);
+        }
+    }
+    stop = true;
+    writer.join();
+}
@@ -0,0 +1,96 @@
+#include <poll.h>
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "RISTNetEventQueue.h"
+
+namespace {
+struct TestEvent {
+    int mValue = 0;
+    std::unique_ptr<int> mPayload; // Move-only like the NetworkEvent packet buffers
+};
+
+bool readable(int fd) {
+    pollfd pfd = {fd, POLLIN, 0};
+    return poll(&pfd, 1, 0) == 1;
+}
+
+TestEvent makeEvent(int value) {
+    TestEvent event;
+    event.mValue = value;
+    event.mPayload = std::make_unique<int>(value);
+    return event;
+}
+} // namespace
+
+TEST(TestRistEventQueue, SignalAndBatches) {
+    RISTNetEventQueue<TestEvent> queue;
+    EXPECT_EQ(queue.getFd(), -1);
+    ASSERT_TRUE(queue.initEventQueue(100));
+    ASSERT_GE(queue.getFd(), 0);
+    EXPECT_FALSE(readable(queue.getFd()));
+
+    for (int i = 0; i < 10; i++) {
+        EXPECT_TRUE(queue.push(makeEvent(i), true));
+    }
+    EXPECT_TRUE(readable(queue.getFd()));
+
+    // A partial drain leaves the fd readable
+    std::vector<TestEvent> events;
+    EXPECT_EQ(queue.drain(events, 4), 4);
+    EXPECT_EQ(events[0].mValue, 0);
+    EXPECT_EQ(*events[3].mPayload, 3);
+    EXPECT_TRUE(readable(queue.getFd()));
+    EXPECT_EQ(queue.drain(events, SIZE_MAX), 6);
+    EXPECT_EQ(events[0].mValue, 4);
+    EXPECT_FALSE(readable(queue.getFd()));
+    EXPECT_EQ(queue.drain(events, SIZE_MAX), 0);
+
+    queue.destroyEventQueue();
+    EXPECT_EQ(queue.getFd(), -1);
+}
+
+TEST(TestRistEventQueue, DropsOnlyDroppable) {
+    RISTNetEventQueue<TestEvent> queue;
+    ASSERT_TRUE(queue.initEventQueue(3));
+    for (int i = 0; i < 5; i++) {
+        queue.push(makeEvent(i), true);
+    }
+    EXPECT_EQ(queue.getDropped(), 2);
+    EXPECT_TRUE(queue.push(makeEvent(100), false));
+    std::vector<TestEvent> events;
+    ASSERT_EQ(queue.drain(events, SIZE_MAX), 4);
+    EXPECT_EQ(events[2].mValue, 2);
+    EXPECT_EQ(events[3].mValue, 100);
+}
+
+TEST(TestRistEventQueue, CrossThread) {
+    RISTNetEventQueue<TestEvent> queue;
+    ASSERT_TRUE(queue.initEventQueue(1000000));
+    const int kEvents = 100000;
+    std::thread producer([&]() {
+        for (int i = 0; i < kEvents; i++) {
+            queue.push(makeEvent(i), true);
+        }
+    });
+    // The reactor: wait for the fd, drain in batches
+    int next = 0;
+    std::vector<TestEvent> events;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (next < kEvents && std::chrono::steady_clock::now() < deadline) {
+        pollfd pfd = {queue.getFd(), POLLIN, 0};
+        if (poll(&pfd, 1, 100) != 1) {
+            continue;
+        }
+        queue.drain(events, 256);
+        for (auto& event : events) {
+            ASSERT_EQ(event.mValue, next);
+            next++;
+        }
+    }
+    producer.join();
+    EXPECT_EQ(next, kEvents);
+    EXPECT_EQ(queue.getDropped(), 0);
+}
@@ -0,0 +1,156 @@
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "RISTNetFileSink.h"
+
+namespace {
+const size_t kPacketSize = 1316;
+
+std::vector<uint8_t> readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+std::vector<uint8_t> makePacket(uint32_t index) {
+    std::vector<uint8_t> packet(kPacketSize);
+    for (size_t i = 0; i < packet.size(); i++) {
+        packet[i] = (index + i) & 0xff;
+    }
+    return packet;
+}
+} // namespace
+
+TEST(TestRistFileSink, Init) {
+    RISTNetFileSink sink;
+    RISTNetFileSink::RISTNetFileSinkSettings settings;
+    EXPECT_FALSE(sink.initFileSink(settings));
+    settings.mPath = testing::TempDir() + "no_such_directory/out.ts";
+    EXPECT_FALSE(sink.initFileSink(settings));
+    auto packet = makePacket(0);
+    EXPECT_FALSE(sink.writeData(packet.data(), packet.size()));
+    EXPECT_FALSE(sink.destroyFileSink());
+}
+
+TEST(TestRistFileSink, WriteAndFlush) {
+    RISTNetFileSink sink;
+    RISTNetFileSink::RISTNetFileSinkSettings settings;
+    settings.mPath = testing::TempDir() + "sink.ts";
+    settings.mBufferSize = 64 * 1024;
+    settings.mBufferCount = 64;
+    settings.mFlushInterval = std::chrono::milliseconds(20);
+    ASSERT_TRUE(sink.initFileSink(settings));
+
+    std::vector<uint8_t> expected;
+    for (uint32_t i = 0; i < 1000; i++) {
+        auto packet = makePacket(i);
+        ASSERT_TRUE(sink.writeData(packet.data(), packet.size()));
+        expected.insert(expected.end(), packet.begin(), packet.end());
+    }
+
+    // The partial buffer is flushed without more data arriving
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_EQ(readFile(settings.mPath), expected);
+
+    auto packet = makePacket(1000);
+    ASSERT_TRUE(sink.writeData(packet.data(), packet.size()));
+    expected.insert(expected.end(), packet.begin(), packet.end());
+    EXPECT_TRUE(sink.destroyFileSink());
+    EXPECT_EQ(readFile(settings.mPath), expected);
+
+    RISTNetFileSink::FileSinkStatistics stats;
+    sink.getStatistics(stats);
+    EXPECT_EQ(stats.mPackets, 1001);
+    EXPECT_EQ(stats.mBytesWritten, expected.size());
+    EXPECT_EQ(stats.mDroppedPackets, 0);
+    EXPECT_EQ(stats.mSegments, 1);
+    std::remove(settings.mPath.c_str());
+}
+
+TEST(TestRistFileSink, SegmentBySize) {
+    RISTNetFileSink sink;
+    RISTNetFileSink::RISTNetFileSinkSettings settings;
+    settings.mPath = testing::TempDir() + "segment.ts";
+    settings.mBufferSize = 8 * 1024;
+    settings.mBufferCount = 256;
+    settings.mSegmentMaxBytes = kPacketSize * 10 + 100;
+    ASSERT_TRUE(sink.initFileSink(settings));
+
+    std::vector<uint8_t> expected;
+    for (uint32_t i = 0; i < 95; i++) {
+        auto packet = makePacket(i);
+        ASSERT_TRUE(sink.writeData(packet.data(), packet.size()));
+        expected.insert(expected.end(), packet.begin(), packet.end());
+    }
+    EXPECT_TRUE(sink.destroyFileSink());
+
+    RISTNetFileSink::FileSinkStatistics stats;
+    sink.getStatistics(stats);
+    EXPECT_EQ(stats.mSegments, 10);
+
+    std::vector<uint8_t> joined;
+    for (int segment = 0; segment < 10; segment++) {
+        char name[64];
+        snprintf(name, sizeof(name), "segment_%06d.ts", segment);
+        std::string path = testing::TempDir() + name;
+        auto content = readFile(path);
+        EXPECT_EQ(content.size(), (segment < 9 ? 10 : 5) * kPacketSize) << "Segment " << segment;
+        joined.insert(joined.end(), content.begin(), content.end());
+        std::remove(path.c_str());
+    }
+    EXPECT_EQ(joined, expected);
+}
+
+TEST(TestRistFileSink, DropAccounting) {
+    RISTNetFileSink sink;
+    RISTNetFileSink::RISTNetFileSinkSettings settings;
+    settings.mPath = testing::TempDir() + "drop.ts";
+    settings.mBufferSize = 4096;
+    settings.mBufferCount = 2;
+    settings.mFsyncPolicy = RISTNetFileSink::FsyncPolicy::kEveryWrite;
+    ASSERT_TRUE(sink.initFileSink(settings));
+
+    const uint32_t kPackets = 20000;
+    uint64_t accepted = 0;
+    auto packet = makePacket(0);
+    for (uint32_t i = 0; i < kPackets; i++) {
+        accepted += sink.writeData(packet.data(), packet.size());
+    }
+    std::vector<uint8_t> tooLarge(settings.mBufferSize + 1);
+    EXPECT_FALSE(sink.writeData(tooLarge.data(), tooLarge.size()));
+    EXPECT_TRUE(sink.destroyFileSink());
+
+    RISTNetFileSink::FileSinkStatistics stats;
+    sink.getStatistics(stats);
+    EXPECT_EQ(stats.mPackets, accepted);
+    EXPECT_EQ(stats.mPackets + stats.mDroppedPackets, kPackets + 1);
+    EXPECT_EQ(stats.mBytesWritten, accepted * kPacketSize);
+    EXPECT_EQ(readFile(settings.mPath).size(), accepted * kPacketSize);
+    EXPECT_LE(stats.mBuffersQueuedMax, 2);
+    std::remove(settings.mPath.c_str());
+}
+
+TEST(TestRistFileSink, DirectIO) {
+    RISTNetFileSink sink;
+    RISTNetFileSink::RISTNetFileSinkSettings settings;
+    settings.mPath = testing::TempDir() + "direct.ts";
+    settings.mBufferSize = 16 * 1024;
+    settings.mBufferCount = 64;
+    settings.mDirectIO = true;
+    if (!sink.initFileSink(settings)) {
+        GTEST_SKIP() << "O_DIRECT not supported in " << testing::TempDir();
+    }
+
+    std::vector<uint8_t> expected;
+    for (uint32_t i = 0; i < 100; i++) {
+        auto packet = makePacket(i);
+        ASSERT_TRUE(sink.writeData(packet.data(), packet.size() - i));
+        expected.insert(expected.end(), packet.begin(), packet.end() - i);
+    }
+    EXPECT_TRUE(sink.destroyFileSink());
+    EXPECT_EQ(readFile(settings.mPath), expected);
+    std::remove(settings.mPath.c_str());
+}
@@ -0,0 +1,175 @@
+#include <condition_variable>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+#include "RISTNetFileSource.h"
+
+namespace {
+const size_t kPacketsPerSecond = 2000;
+const uint64_t kTicksPerPacket = 27000000 / kPacketsPerSecond;
+const uint16_t kPCRPid = 0x100;
+
+// Writes a CBR transport stream with a PCR every 10 packets, the payload carries the packet index
+std::string writeTestStream(const std::string& name, size_t packets, uint64_t firstPCR = 0, bool withPCR = true) {
+    std::string path = testing::TempDir() + name;
+    std::ofstream file(path, std::ios::binary);
+    for (size_t i = 0; i < packets; i++) {
+        uint8_t packet[188];
+        memset(packet, 0xff, sizeof(packet));
+        packet[0] = 0x47;
+        packet[1] = kPCRPid >> 8;
+        packet[2] = kPCRPid & 0xff;
+        if (withPCR && i % 10 == 0) {
+            uint64_t pcr = (firstPCR + i * kTicksPerPacket) % ((1ULL << 33) * 300);
+            uint64_t base = pcr / 300;
+            uint64_t extension = pcr % 300;
+            packet[3] = 0x30;
+            packet[4] = 7;
+            packet[5] = 0x10;
+            packet[6] = base >> 25;
+            packet[7] = base >> 17;
+            packet[8] = base >> 9;
+            packet[9] = base >> 1;
+            packet[10] = ((base & 1) << 7) | 0x7e | (extension >> 8);
+            packet[11] = extension & 0xff;
+        } else {
+            packet[3] = 0x10;
+        }
+        memcpy(&packet[184], &i, sizeof(uint32_t));
+        file.write((const char*)packet, sizeof(packet));
+    }
+    return path;
+}
+
+uint32_t packetIndex(const uint8_t* packet) {
+    uint32_t index;
+    memcpy(&index, &packet[184], sizeof(index));
+    return index;
+}
+
+struct Chunk {
+    std::chrono::steady_clock::time_point mTime;
+    uint32_t mFirstPacket;
+    size_t mSize;
+};
+
+class ChunkCollector {
+public:
+    explicit ChunkCollector(RISTNetFileSource& source) {
+        source.chunkCallback = [&](const uint8_t* buf, size_t size, uint16_t connectionId) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mChunks.push_back({std::chrono::steady_clock::now(), packetIndex(buf), size});
+            return true;
+        };
+    }
+    std::vector<Chunk> chunks() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mChunks;
+    }
+
+private:
+    std::mutex mMutex;
+    std::vector<Chunk> mChunks;
+};
+
+void waitForEnd(RISTNetFileSource& source) {
+    for (int i = 0; i < 500 && source.isPlaying(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+} // namespace
+
+TEST(TestRistFileSource, Open) {
+    RISTNetFileSource source;
+    RISTNetFileSource::RISTNetFileSourceSettings settings;
+    EXPECT_FALSE(source.openFile(testing::TempDir() + "does_not_exist.ts", settings));
+    EXPECT_FALSE(source.startPlayout());
+
+    std::string noPCR = writeTestStream("no_pcr.ts", 100, 0, false);
+    EXPECT_FALSE(source.openFile(noPCR, settings));
+    settings.mFallbackBitrate = kPacketsPerSecond * 188 * 8;
+    ASSERT_TRUE(source.openFile(noPCR, settings));
+    EXPECT_EQ(source.getDuration(), std::chrono::milliseconds(50));
+    EXPECT_TRUE(source.closeFile());
+    std::remove(noPCR.c_str());
+}
+
+TEST(TestRistFileSource, TimingAgainstPCR) {
+    const size_t kPackets = 1000;
+    std::string path = writeTestStream("timing.ts", kPackets);
+    RISTNetFileSource source;
+    RISTNetFileSource::RISTNetFileSourceSettings settings;
+    ChunkCollector collector(source);
+    ASSERT_TRUE(source.openFile(path, settings));
+    EXPECT_EQ(source.getDuration(), std::chrono::milliseconds(500));
+    ASSERT_TRUE(source.startPlayout());
+    waitForEnd(source);
+
+    auto chunks = collector.chunks();
+    ASSERT_EQ(chunks.size(), (kPackets + 6) / 7);
+    std::vector<std::chrono::microseconds> errors;
+    uint32_t expectedPacket = 0;
+    for (auto& chunk : chunks) {
+        EXPECT_EQ(chunk.mFirstPacket, expectedPacket);
+        expectedPacket += chunk.mSize / 188;
+        auto expected = std::chrono::microseconds(chunk.mFirstPacket * 1000000ULL / kPacketsPerSecond);
+        auto actual = std::chrono::duration_cast<std::chrono::microseconds>(chunk.mTime - chunks[0].mTime);
+        errors.push_back(std::chrono::abs(actual - expected));
+    }
+    EXPECT_EQ(expectedPacket, kPackets);
+    // The send times are absolute so a scheduling hiccup does not accumulate, allow for a few on a loaded machine
+    std::sort(errors.begin(), errors.end());
+    EXPECT_LT(errors[errors.size() * 95 / 100], std::chrono::milliseconds(2)) << "Playout deviates from the PCR timeline";
+    EXPECT_LT(errors.back(), std::chrono::milliseconds(20)) << "Playout deviates from the PCR timeline";
+
+    RISTNetFileSource::FileSourceStatistics stats;
+    source.getStatistics(stats);
+    EXPECT_EQ(stats.mChunksSent, chunks.size());
+    EXPECT_EQ(stats.mChunksFailed, 0);
+    std::remove(path.c_str());
+}
+
+TEST(TestRistFileSource, PCRWrap) {
+    // The PCR wraps 100 ms into the file
+    std::string path = writeTestStream("wrap.ts", 1000, (1ULL << 33) * 300 - 200 * kTicksPerPacket);
+    RISTNetFileSource source;
+    RISTNetFileSource::RISTNetFileSourceSettings settings;
+    ASSERT_TRUE(source.openFile(path, settings));
+    EXPECT_EQ(source.getDuration(), std::chrono::milliseconds(500));
+    std::remove(path.c_str());
+}
+
+TEST(TestRistFileSource, SeekAndLoop) {
+    const size_t kPackets = 200; // 100 ms
+    std::string path = writeTestStream("loop.ts", kPackets);
+    RISTNetFileSource source;
+    RISTNetFileSource::RISTNetFileSourceSettings settings;
+    settings.mLoop = true;
+    settings.mPacketsPerChunk = 10;
+    ChunkCollector collector(source);
+    ASSERT_TRUE(source.openFile(path, settings));
+    EXPECT_FALSE(source.seek(std::chrono::milliseconds(200)));
+    ASSERT_TRUE(source.seek(std::chrono::milliseconds(50)));
+    ASSERT_TRUE(source.startPlayout());
+    std::this_thread::sleep_for(std::chrono::milliseconds(220));
+    source.stopPlayout();
+    EXPECT_FALSE(source.isPlaying());
+
+    auto chunks = collector.chunks();
+    ASSERT_GE(chunks.size(), 20);
+    EXPECT_EQ(chunks[0].mFirstPacket, 100);
+    // The timeline continues over the loop point
+    for (size_t i = 1; i < chunks.size(); i++) {
+        EXPECT_EQ(chunks[i].mFirstPacket, (chunks[i - 1].mFirstPacket + 10) % kPackets);
+    }
+    auto span = std::chrono::duration_cast<std::chrono::milliseconds>(chunks.back().mTime - chunks[0].mTime);
+    EXPECT_NEAR(span.count(), (chunks.size() - 1) * 5, 10);
+
+    RISTNetFileSource::FileSourceStatistics stats;
+    source.getStatistics(stats);
+    EXPECT_GE(stats.mLoops, 1);
+    std::remove(path.c_str());
+}
@@ -0,0 +1,187 @@
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "RISTNetInternal.h"
+
+namespace {
+// Collects the records handed to the sink
+class SinkCollector {
+public:
+    explicit SinkCollector(std::chrono::microseconds delay = std::chrono::microseconds(0)) {
+        RISTNetLog::globalLog().logSinkCallback = [this, delay](const RISTNetLogRecord& record) {
+            if (delay.count()) {
+                std::this_thread::sleep_for(delay);
+            }
+            std::lock_guard<std::mutex> lock(mMutex);
+            mRecords.push_back(record);
+        };
+    }
+    ~SinkCollector() {
+        RISTNetLog::globalLog().logSinkCallback = nullptr;
+        RISTNetLog::setLevel(RIST_LOG_NOTICE);
+    }
+    std::vector<RISTNetLogRecord> records() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mRecords;
+    }
+
+private:
+    std::mutex mMutex;
+    std::vector<RISTNetLogRecord> mRecords;
+};
+
+void logFromOneSite(int index) {
+    LOGGER(true, LOGG_WARN, "Site record " << index)
+}
+} // namespace
+
+TEST(TestRistLog, LevelAndRateLimit) {
+    SinkCollector collector;
+    RISTNetLog::setLevel(RIST_LOG_WARN);
+    EXPECT_FALSE(RISTNetLog::isEnabled(RIST_LOG_NOTICE));
+    LOGGER(false, LOGG_NOTIFY, "Not logged")
+    LOGGER(false, LOGG_ERROR, "Logged " << 1)
+    RISTNetLog::setLevel(RIST_LOG_NOTICE);
+    LOGGER(false, LOGG_NOTIFY, "Logged " << 2)
+    auto records = collector.records();
+    ASSERT_EQ(records.size(), 2);
+    EXPECT_STREQ(records[0].mMessage, "Logged 1");
+    EXPECT_EQ(records[0].mLevel, RIST_LOG_ERROR);
+    EXPECT_EQ(records[0].pFile, nullptr);
+    EXPECT_STREQ(records[1].mMessage, "Logged 2");
+
+    // The default burst of a site is 20 records a second
+    RISTNetLog::LogStatistics before;
+    RISTNetLog::globalLog().getStatistics(before);
+    for (int i = 0; i < 100; i++) {
+        logFromOneSite(i);
+    }
+    LOGGER(false, LOGG_WARN, "Another site")
+    records = collector.records();
+    ASSERT_EQ(records.size(), 2 + 20 + 1);
+    EXPECT_STREQ(records[2].mMessage, "Site record 0");
+    EXPECT_NE(records[2].pFile, nullptr);
+    EXPECT_STREQ(records.back().mMessage, "Another site");
+    RISTNetLog::LogStatistics after;
+    RISTNetLog::globalLog().getStatistics(after);
+    EXPECT_EQ(after.mSuppressed - before.mSuppressed, 80);
+    EXPECT_NE(RISTNetLog::formatRecord(records[2]).find("Warning: "), std::string::npos);
+}
+
+TEST(TestRistLog, AsyncWithLibrist) {
+    SinkCollector collector;
+    RISTNetLog& log = RISTNetLog::globalLog();
+    RISTNetLog::RISTNetLogSettings settings;
+    settings.mDrainInterval = std::chrono::milliseconds(1);
+    ASSERT_TRUE(log.startLog(settings));
+    EXPECT_FALSE(log.startLog(settings));
+
+    rist_logging_settings* librist = nullptr;
+    ASSERT_EQ(log.setupLibristLogging(&librist, RIST_LOG_WARN), 0);
+    ASSERT_NE(librist->log_cb, nullptr);
+    LOGGER(false, LOGG_WARN, "First")
+    librist->log_cb(librist->log_cb_arg, RIST_LOG_WARN, "[WARN] Lost 12 packets\n");
+    librist->log_cb(librist->log_cb_arg, RIST_LOG_DEBUG, "Above the level");
+    LOGGER(false, LOGG_ERROR, "Last")
+    EXPECT_TRUE(log.stopLog());
+    EXPECT_FALSE(log.stopLog());
+    free(librist);
+
+    auto records = collector.records();
+    ASSERT_EQ(records.size(), 3);
+    EXPECT_STREQ(records[0].mMessage, "First");
+    EXPECT_FALSE(records[0].mLibrist);
+    EXPECT_STREQ(records[1].mMessage, "[WARN] Lost 12 packets");
+    EXPECT_TRUE(records[1].mLibrist);
+    EXPECT_STREQ(records[2].mMessage, "Last");
+
+    // Messages differing in numbers share a rate limit
+    ASSERT_TRUE(log.startLog(settings));
+    librist = nullptr;
+    log.setupLibristLogging(&librist, RIST_LOG_WARN);
+    for (int i = 0; i < 50; i++) {
+        std::string message = "Lost " + std::to_string(1000 + i) + " packets";
+        librist->log_cb(librist->log_cb_arg, RIST_LOG_WARN, message.c_str());
+    }
+    EXPECT_TRUE(log.stopLog());
+    free(librist);
+    EXPECT_EQ(collector.records().size(), 3 + 20);
+}
+
+TEST(TestRistLog, BurstNeverBlocks) {
+    // A sink far slower than the threads logging
+    SinkCollector collector(std::chrono::microseconds(100));
+    RISTNetLog& log = RISTNetLog::globalLog();
+    RISTNetLog::RISTNetLogSettings settings;
+    settings.mRateLimitBurst = 1000000;
+    ASSERT_TRUE(log.startLog(settings));
+    RISTNetLog::LogStatistics before;
+    log.getStatistics(before);
+
+    const int kThreads = 4;
+    const int kRecords = 10000;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < kRecords; i++) {
+                LOGGER(false, LOGG_WARN, "Packet loss " << t << " " << i)
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+    EXPECT_TRUE(log.stopLog());
+
+    RISTNetLog::LogStatistics after;
+    log.getStatistics(after);
+    uint64_t records = after.mRecords - before.mRecords;
+    uint64_t dropped = after.mDropped - before.mDropped;
+    EXPECT_EQ(records + dropped, kThreads * kRecords);
+    EXPECT_GT(dropped, 0);
+    EXPECT_EQ(collector.records().size(), records);
+    RISTNetLog::RISTNetLogSettings defaults;
+    ASSERT_TRUE(log.startLog(defaults)); // Back to the default rate limit
+    EXPECT_TRUE(log.stopLog());
+}
+
+// Threads logging while the log is stopped, every record is delivered by stopLog or directly after it
+TEST(TestRistLog, StopWhileLogging) {
+    SinkCollector collector;
+    RISTNetLog& log = RISTNetLog::globalLog();
+    RISTNetLog::RISTNetLogSettings settings;
+    settings.mRateLimitBurst = 1000000;
+    ASSERT_TRUE(log.startLog(settings));
+    RISTNetLog::LogStatistics before;
+    log.getStatistics(before);
+
+    const int kThreads = 4;
+    const int kRecords = 5000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < kRecords; i++) {
+                LOGGER(false, LOGG_WARN, "Stopping " << t << " " << i)
+            }
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_TRUE(log.stopLog());
+    size_t stopped = collector.records().size();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    RISTNetLog::LogStatistics after;
+    log.getStatistics(after);
+    uint64_t records = after.mRecords - before.mRecords;
+    uint64_t dropped = after.mDropped - before.mDropped;
+    EXPECT_GE(stopped, records);
+    EXPECT_EQ(collector.records().size() + dropped, kThreads * kRecords);
+    RISTNetLog::RISTNetLogSettings defaults;
+    ASSERT_TRUE(log.startLog(defaults));
+    EXPECT_TRUE(log.stopLog());
+}
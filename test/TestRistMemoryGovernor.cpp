@@ -0,0 +1,238 @@
+#include <gtest/gtest.h>
+
+#include "RISTNetMockTransport.h"
+
+// Sessions are admitted in full, clamped to what is left or rejected, by the policy
+TEST(TestRistMemoryGovernor, Admission) {
+    rist_peer_config config{};
+    config.recovery_maxbitrate = 100000;
+    config.recovery_length_max = 1000;
+    EXPECT_EQ(RISTNetMemoryGovernor::estimateRecoveryBytes(config, 2), 25000000);
+
+    RISTNetMemoryGovernor governor;
+    RISTNetMemoryGovernor::RISTNetMemoryGovernorSettings settings;
+    settings.mShrinkAt = 0.0;
+    EXPECT_FALSE(governor.initGovernor(settings));
+    settings.mShrinkAt = 0.95;
+    settings.mBudget = 100000000;
+    settings.mMinQueueBytes = 50000;
+    ASSERT_TRUE(governor.initGovernor(settings));
+
+    std::unique_ptr<RISTNetMemorySession> first;
+    ASSERT_TRUE(governor.openSession("first", 60000000, 1000000, first));
+    EXPECT_EQ(first->getRecoveryGranted(), 60000000);
+    // The queue floors of both sessions are kept out of the recovery buffers
+    std::unique_ptr<RISTNetMemorySession> second;
+    ASSERT_TRUE(governor.openSession("second", 60000000, 1000000, second));
+    EXPECT_EQ(second->getRecoveryGranted(), 39900000);
+    // Under mMinRecoveryShare of the estimate
+    std::unique_ptr<RISTNetMemorySession> third;
+    EXPECT_FALSE(governor.openSession("third", 60000000, 1000000, third));
+    EXPECT_FALSE(third);
+
+    settings.mPolicy = RISTNetMemoryGovernor::AdmissionPolicy::kReject;
+    ASSERT_TRUE(governor.initGovernor(settings));
+    second.reset();
+    EXPECT_FALSE(governor.openSession("second", 60000000, 1000000, second));
+    ASSERT_TRUE(governor.openSession("second", 30000000, 1000000, second));
+
+    std::vector<RISTNetMemoryGovernor::SessionUsage> sessions;
+    governor.getSessions(sessions);
+    ASSERT_EQ(sessions.size(), 2);
+    EXPECT_EQ(sessions[0].mName, "first");
+    EXPECT_EQ(sessions[1].mRecoveryGranted, 30000000);
+    EXPECT_EQ(sessions[1].mQueueLimit, 1000000);
+
+    RISTNetMemoryGovernor::GovernorStatistics statistics;
+    governor.getStatistics(statistics);
+    EXPECT_EQ(statistics.mSessions, 2);
+    EXPECT_EQ(statistics.mAdmitted, 3);
+    EXPECT_EQ(statistics.mClamped, 1);
+    EXPECT_EQ(statistics.mRejected, 2);
+    EXPECT_EQ(statistics.mUsed, 90000000);
+    EXPECT_EQ(statistics.mCommitted, 92000000);
+}
+
+// Over the shrink level the queue limits shrink and data is dropped, the queues are restored when drained. Only
+// when the recovery buffers and the queue floors do not fit is the largest session reported, once.
+TEST(TestRistMemoryGovernor, ShrinkBeforeOverload) {
+    RISTNetMemoryGovernor governor;
+    RISTNetMemoryGovernor::RISTNetMemoryGovernorSettings settings;
+    settings.mBudget = 10000000;
+    settings.mShrinkAt = 0.8;
+    settings.mMinQueueBytes = 50000;
+    ASSERT_TRUE(governor.initGovernor(settings));
+    std::vector<RISTNetMemoryGovernor::SessionUsage> overloads;
+    governor.overloadCallback = [&](const RISTNetMemoryGovernor::SessionUsage &rUsage) {
+        overloads.push_back(rUsage);
+    };
+
+    std::unique_ptr<RISTNetMemorySession> a, b;
+    ASSERT_TRUE(governor.openSession("a", 1000000, 8000000, a));
+    ASSERT_TRUE(governor.openSession("b", 1000000, 8000000, b));
+
+    // 8 MB used, a and b share the 6 MB left to the queues
+    size_t queued = 0;
+    while (a->reserveQueue(100000)) {
+        queued += 100000;
+    }
+    EXPECT_EQ(queued, 6100000);
+    EXPECT_EQ(a->getQueueLimit(), 3000000);
+    EXPECT_EQ(b->getQueueLimit(), 3000000);
+    EXPECT_FALSE(b->reserveQueue(3100000));
+
+    RISTNetMemoryGovernor::SessionUsage usage;
+    governor.getUsage(*a, usage);
+    EXPECT_EQ(usage.mQueueUsed, 6100000);
+    EXPECT_EQ(usage.mQueuePeak, 6100000);
+    EXPECT_EQ(usage.mQueueDropped, 1);
+    EXPECT_TRUE(overloads.empty());
+
+    // Drained under half the shrink level
+    a->releaseQueue(queued);
+    EXPECT_EQ(a->getQueueLimit(), 8000000);
+
+    // A large session, then the budget lowered under the recovery buffers and queue floors
+    std::unique_ptr<RISTNetMemorySession> c;
+    ASSERT_TRUE(governor.openSession("c", 6000000, 8000000, c));
+    EXPECT_TRUE(a->reserveQueue(1000000));
+    EXPECT_EQ(a->getQueueLimit(), 50000);
+    EXPECT_TRUE(overloads.empty());
+    settings.mBudget = 8000000;
+    ASSERT_TRUE(governor.initGovernor(settings));
+    ASSERT_EQ(overloads.size(), 1);
+    EXPECT_EQ(overloads[0].mName, "c");
+    EXPECT_TRUE(overloads[0].mOverload);
+    ASSERT_TRUE(governor.initGovernor(settings));
+    EXPECT_EQ(overloads.size(), 1);
+
+    // Stopping c brings the sessions under the budget
+    c.reset();
+    a->releaseQueue(1000000);
+    RISTNetMemoryGovernor::GovernorStatistics statistics;
+    governor.getStatistics(statistics);
+    EXPECT_EQ(statistics.mSessions, 2);
+    EXPECT_EQ(statistics.mUsed, 2000000);
+    EXPECT_EQ(statistics.mOverloads, 1);
+    EXPECT_GE(statistics.mShrinks, 4);
+    EXPECT_EQ(a->getQueueLimit(), 8000000);
+}
+
+// Through the receiver, the recovery clamped at init and the event queue accounted and shrunk
+TEST(TestRistMemoryGovernor, Receiver) {
+    RISTNetMemoryGovernor governor;
+    RISTNetMemoryGovernor::RISTNetMemoryGovernorSettings governorSettings;
+    governorSettings.mBudget = 10000000;
+    governorSettings.mMinQueueBytes = 50000;
+    ASSERT_TRUE(governor.initGovernor(governorSettings));
+
+    RISTNetReceiver receiver;
+    RISTNetMockTransport transport;
+    RISTNetReceiver::RISTNetReceiverSettings settings;
+    settings.mEventQueueSize = 100;
+    settings.mMemoryGovernor = &governor;
+    settings.mCNAME = "receiver";
+    ASSERT_TRUE(transport.attachReceiver(receiver, settings));
+    receiver.validateConnectionCallback = [](const std::string &, uint16_t) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    rist_peer *peer = transport.connectPeer("10.0.0.1", 1234);
+    ASSERT_NE(peer, nullptr);
+
+    RISTNetMemoryGovernor::SessionUsage usage;
+    ASSERT_TRUE(receiver.getMemoryUsage(usage));
+    EXPECT_EQ(usage.mName, "receiver");
+    EXPECT_EQ(usage.mRecoveryEstimate, 12500000);
+    EXPECT_EQ(usage.mRecoveryGranted, 9950000);
+    EXPECT_EQ(usage.mQueueEstimate, 100 * RIST_MAX_PACKET_SIZE);
+
+    // The recovery buffers are over the shrink level, the queue holds its floor
+    std::vector<uint8_t> packet(1000);
+    for (int i = 0; i < 60; i++) {
+        EXPECT_EQ(transport.injectData(peer, packet.data(), packet.size()), 0);
+    }
+    ASSERT_TRUE(receiver.getMemoryUsage(usage));
+    EXPECT_EQ(usage.mQueueLimit, 50000);
+    EXPECT_EQ(usage.mQueueUsed, 50000);
+    EXPECT_EQ(usage.mQueueDropped, 10);
+
+    std::vector<RISTNetReceiver::NetworkEvent> events;
+    receiver.drain(events);
+    EXPECT_EQ(events.size(), 51);
+    ASSERT_TRUE(receiver.getMemoryUsage(usage));
+    EXPECT_EQ(usage.mQueueUsed, 0);
+    EXPECT_EQ(usage.mQueuePeak, 50000);
+
+    // A second receiver does not fit
+    RISTNetReceiver second;
+    RISTNetMockTransport secondTransport;
+    EXPECT_FALSE(secondTransport.attachReceiver(second, settings));
+    EXPECT_FALSE(second.getMemoryUsage(usage));
+
+    // Charged per client connected, back to the one URL as they leave
+    rist_peer *secondPeer = transport.connectPeer("10.0.0.2", 1235);
+    rist_peer *thirdPeer = transport.connectPeer("10.0.0.3", 1236);
+    ASSERT_TRUE(receiver.getMemoryUsage(usage));
+    EXPECT_EQ(usage.mPeers, 3);
+    EXPECT_EQ(usage.mRecoveryEstimate, 3 * 12500000);
+    EXPECT_EQ(usage.mRecoveryGranted, 3 * 9950000);
+    EXPECT_TRUE(transport.disconnectPeer(secondPeer));
+    EXPECT_TRUE(transport.disconnectPeer(thirdPeer));
+    ASSERT_TRUE(receiver.getMemoryUsage(usage));
+    EXPECT_EQ(usage.mPeers, 1);
+    EXPECT_EQ(usage.mRecoveryGranted, 9950000);
+    EXPECT_TRUE(transport.disconnectPeer(peer));
+    ASSERT_TRUE(receiver.getMemoryUsage(usage));
+    EXPECT_EQ(usage.mPeers, 1);
+
+    EXPECT_TRUE(receiver.destroyReceiver());
+    EXPECT_FALSE(receiver.getMemoryUsage(usage));
+    std::vector<RISTNetMemoryGovernor::SessionUsage> sessions;
+    governor.getSessions(sessions);
+    EXPECT_TRUE(sessions.empty());
+}
+
+// A failed init closes its session, a recovery length clamped under recovery_rtt_min fails the init
+TEST(TestRistMemoryGovernor, InitFailure) {
+    RISTNetMemoryGovernor governor;
+    RISTNetMemoryGovernor::RISTNetMemoryGovernorSettings governorSettings;
+    governorSettings.mBudget = 10000000;
+    governorSettings.mMinQueueBytes = 50000;
+    governorSettings.mMinRecoveryShare = 0.0;
+    ASSERT_TRUE(governor.initGovernor(governorSettings));
+    std::vector<RISTNetMemoryGovernor::SessionUsage> sessions;
+
+    RISTNetReceiver receiver;
+    RISTNetMockTransport transport;
+    RISTNetReceiver::RISTNetReceiverSettings settings;
+    settings.mMemoryGovernor = &governor;
+    settings.mCallbackWatchdog = true;
+    settings.mWatchdogSettings.mDataBudget = std::chrono::microseconds(0);
+    EXPECT_FALSE(transport.attachReceiver(receiver, settings));
+    governor.getSessions(sessions);
+    EXPECT_TRUE(sessions.empty());
+
+    RISTNetSender sender;
+    RISTNetMockTransport senderTransport;
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    senderSettings.mMemoryGovernor = &governor;
+    senderSettings.mCongestionFeedback = true;
+    senderSettings.mCongestionSettings.mMinBitrate = 0;
+    EXPECT_FALSE(senderTransport.attachSender(sender, senderSettings));
+    governor.getSessions(sessions);
+    EXPECT_TRUE(sessions.empty());
+
+    // 100000 bytes left of 12500000 (no event queue): 8 ms of recovery
+    governorSettings.mBudget = 100000;
+    ASSERT_TRUE(governor.initGovernor(governorSettings));
+    settings.mCallbackWatchdog = false;
+    EXPECT_FALSE(transport.attachReceiver(receiver, settings));
+    governor.getSessions(sessions);
+    EXPECT_TRUE(sessions.empty());
+    settings.mPeerConfig.recovery_rtt_min = 8;
+    ASSERT_TRUE(transport.attachReceiver(receiver, settings));
+    governor.getSessions(sessions);
+    ASSERT_EQ(sessions.size(), 1);
+    EXPECT_EQ(sessions[0].mRecoveryGranted, 100000);
+    transport.detach();
+}
@@ -0,0 +1,247 @@
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "RISTNetMerger.h"
+
+namespace {
+struct MergedPacket {
+    uint8_t mFirstByte;
+    size_t mSize;
+    uint16_t mConnectionID;
+};
+
+std::vector<uint8_t> makePacket(uint8_t lValue, size_t lSize = 188) {
+    return std::vector<uint8_t>(lSize, lValue);
+}
+} // namespace
+
+TEST(TestRistMerger, Init) {
+    RISTNetMerger merger;
+    RISTNetMerger::RISTNetMergerSettings settings;
+    settings.mLegs = 0;
+    EXPECT_FALSE(merger.initMerger(settings));
+    settings.mLegs = 2;
+    EXPECT_TRUE(merger.initMerger(settings));
+    EXPECT_FALSE(merger.initMerger(settings));
+
+    auto packet = makePacket(1);
+    EXPECT_FALSE(merger.pushData(2, packet.data(), packet.size(), 0, 0));
+    EXPECT_TRUE(merger.destroyMerger());
+    EXPECT_FALSE(merger.pushData(0, packet.data(), packet.size(), 0, 0));
+}
+
+TEST(TestRistMerger, SequenceDeduplicateAndOrder) {
+    RISTNetMerger merger;
+    RISTNetMerger::RISTNetMergerSettings settings;
+    settings.mWindowSize = 64;
+    settings.mMaxHoldTime = std::chrono::milliseconds(1000);
+    std::vector<MergedPacket> merged;
+    merger.mergedDataCallback = [&](const uint8_t* buf, size_t size, uint16_t connectionId) {
+        merged.push_back({*buf, size, connectionId});
+    };
+    ASSERT_TRUE(merger.initMerger(settings));
+
+    // Leg 0 loses seq 101, leg 1 lags behind but has it
+    for (uint32_t seq : {100, 102, 103}) {
+        auto packet = makePacket(seq & 0xff);
+        EXPECT_TRUE(merger.pushData(0, packet.data(), packet.size(), 7, seq));
+    }
+    ASSERT_EQ(merged.size(), 1);
+    for (uint32_t seq : {100, 101, 102, 103}) {
+        auto packet = makePacket(seq & 0xff);
+        EXPECT_EQ(merger.pushData(1, packet.data(), packet.size(), 7, seq), seq == 101);
+    }
+
+    ASSERT_EQ(merged.size(), 4);
+    for (size_t i = 0; i < merged.size(); i++) {
+        EXPECT_EQ(merged[i].mFirstByte, 100 + i);
+        EXPECT_EQ(merged[i].mConnectionID, 7);
+    }
+
+    RISTNetMerger::MergerStatistics stats;
+    merger.getStatistics(stats);
+    EXPECT_EQ(stats.mDelivered, 4);
+    EXPECT_EQ(stats.mLost, 0);
+    ASSERT_EQ(stats.mLegs.size(), 2);
+    EXPECT_EQ(stats.mLegs[0].mPackets, 3);
+    EXPECT_EQ(stats.mLegs[0].mContributed, 3);
+    EXPECT_EQ(stats.mLegs[1].mContributed, 1);
+    EXPECT_EQ(stats.mLegs[1].mDuplicates, 3);
+}
+
+TEST(TestRistMerger, SequenceHoldTimeout) {
+    RISTNetMerger merger;
+    RISTNetMerger::RISTNetMergerSettings settings;
+    settings.mWindowSize = 64;
+    settings.mMaxHoldTime = std::chrono::milliseconds(50);
+    std::mutex mergedMutex;
+    std::vector<uint8_t> merged;
+    merger.mergedDataCallback = [&](const uint8_t* buf, size_t size, uint16_t connectionId) {
+        std::lock_guard<std::mutex> lock(mergedMutex);
+        merged.push_back(*buf);
+    };
+    ASSERT_TRUE(merger.initMerger(settings));
+
+    for (uint32_t seq : {10, 12, 13}) {
+        auto packet = makePacket(seq);
+        merger.pushData(0, packet.data(), packet.size(), 0, seq);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    {
+        std::lock_guard<std::mutex> lock(mergedMutex);
+        EXPECT_EQ(merged, std::vector<uint8_t>({10, 12, 13}));
+    }
+
+    // Seq 11 arrives too late
+    auto packet = makePacket(11);
+    EXPECT_FALSE(merger.pushData(1, packet.data(), packet.size(), 0, 11));
+
+    RISTNetMerger::MergerStatistics stats;
+    merger.getStatistics(stats);
+    EXPECT_EQ(stats.mLost, 1);
+    EXPECT_EQ(stats.mLegs[1].mLate, 1);
+}
+
+TEST(TestRistMerger, SequenceWrap) {
+    RISTNetMerger merger;
+    RISTNetMerger::RISTNetMergerSettings settings;
+    settings.mWindowSize = 16;
+    size_t delivered = 0;
+    merger.mergedDataCallback = [&](const uint8_t* buf, size_t size, uint16_t connectionId) { delivered++; };
+    ASSERT_TRUE(merger.initMerger(settings));
+
+    for (uint32_t seq = UINT32_MAX - 100; seq != 100; seq++) {
+        auto packet = makePacket(seq & 0xff);
+        EXPECT_TRUE(merger.pushData(0, packet.data(), packet.size(), 0, seq));
+        EXPECT_FALSE(merger.pushData(1, packet.data(), packet.size(), 0, seq));
+    }
+    EXPECT_EQ(delivered, 201);
+}
+
+// 64 bit sequence numbers do not wrap at 2^32, a jump forward counts the skipped packets as lost
+TEST(TestRistMerger, Sequence64Bit) {
+    RISTNetMerger merger;
+    RISTNetMerger::RISTNetMergerSettings settings;
+    settings.mWindowSize = 16;
+    std::vector<uint8_t> merged;
+    merger.mergedDataCallback = [&](const uint8_t* buf, size_t size, uint16_t connectionId) {
+        merged.push_back(*buf);
+    };
+    ASSERT_TRUE(merger.initMerger(settings));
+
+    uint64_t start = (1ULL << 40) - 50;
+    for (uint64_t seq = start; seq < start + 100; seq++) {
+        auto packet = makePacket(seq & 0xff);
+        EXPECT_TRUE(merger.pushData(0, packet.data(), packet.size(), 0, seq));
+        EXPECT_FALSE(merger.pushData(1, packet.data(), packet.size(), 0, seq));
+    }
+    // 2^32 apart is not a duplicate
+    auto packet = makePacket(1);
+    EXPECT_FALSE(merger.pushData(1, packet.data(), packet.size(), 0, start + 99));
+    EXPECT_TRUE(merger.pushData(1, packet.data(), packet.size(), 0, start + 100 + (1ULL << 32)));
+    EXPECT_EQ(merged.size(), 101);
+
+    RISTNetMerger::MergerStatistics stats;
+    merger.getStatistics(stats);
+    EXPECT_EQ(stats.mLost, 1ULL << 32);
+    EXPECT_EQ(stats.mLegs[1].mDuplicates, 101);
+}
+
+// The flows have their own sequence numbers, the same seq on two flows is not a duplicate
+TEST(TestRistMerger, SequencePerFlow) {
+    RISTNetMerger merger;
+    RISTNetMerger::RISTNetMergerSettings settings;
+    settings.mWindowSize = 64;
+    settings.mMaxHoldTime = std::chrono::milliseconds(1000);
+    std::vector<MergedPacket> merged;
+    merger.mergedDataCallback = [&](const uint8_t* buf, size_t size, uint16_t connectionId) {
+        merged.push_back({*buf, size, connectionId});
+    };
+    ASSERT_TRUE(merger.initMerger(settings));
+
+    // Flow 2 loses seq 11 on leg 0, flow 1 goes on
+    for (uint32_t seq : {10, 11, 12}) {
+        auto packet = makePacket(seq);
+        EXPECT_TRUE(merger.pushData(0, packet.data(), packet.size(), 1, seq));
+        if (seq != 11) {
+            EXPECT_TRUE(merger.pushData(0, packet.data(), packet.size(), 2, seq));
+        }
+    }
+    auto packet = makePacket(11);
+    EXPECT_TRUE(merger.pushData(1, packet.data(), packet.size(), 2, 11));
+    EXPECT_FALSE(merger.pushData(1, packet.data(), packet.size(), 1, 11));
+
+    ASSERT_EQ(merged.size(), 6);
+    std::vector<std::pair<uint16_t, uint8_t>> order;
+    for (auto &rPacket : merged) {
+        order.emplace_back(rPacket.mConnectionID, rPacket.mFirstByte);
+    }
+    EXPECT_EQ(order, (std::vector<std::pair<uint16_t, uint8_t>>(
+                         {{1, 10}, {2, 10}, {1, 11}, {1, 12}, {2, 11}, {2, 12}})));
+    RISTNetMerger::MergerStatistics stats;
+    merger.getStatistics(stats);
+    EXPECT_EQ(stats.mLost, 0);
+}
+
+// The callback is called without the merger lock, it may read the statistics and destroy the merger
+TEST(TestRistMerger, CallbackReentry) {
+    for (bool sequenced : {true, false}) {
+        RISTNetMerger merger;
+        RISTNetMerger::RISTNetMergerSettings settings;
+        settings.mSequenceComparable = sequenced;
+        settings.mWindowSize = 16;
+        std::vector<uint64_t> delivered;
+        merger.mergedDataCallback = [&](const uint8_t* buf, size_t size, uint16_t connectionId) {
+            RISTNetMerger::MergerStatistics stats;
+            merger.getStatistics(stats);
+            delivered.push_back(stats.mDelivered);
+            if (*buf == 3) {
+                EXPECT_TRUE(merger.destroyMerger());
+            }
+        };
+        ASSERT_TRUE(merger.initMerger(settings));
+        for (uint32_t seq = 0; seq < 5; seq++) {
+            auto packet = makePacket(seq);
+            EXPECT_EQ(merger.pushData(0, packet.data(), packet.size(), 0, seq), seq <= 3);
+        }
+        EXPECT_EQ(delivered, std::vector<uint64_t>({1, 2, 3, 4}));
+    }
+}
+
+TEST(TestRistMerger, FingerprintDeduplicate) {
+    RISTNetMerger merger;
+    RISTNetMerger::RISTNetMergerSettings settings;
+    settings.mLegs = 3;
+    settings.mSequenceComparable = false;
+    settings.mWindowSize = 32;
+    std::vector<MergedPacket> merged;
+    merger.mergedDataCallback = [&](const uint8_t* buf, size_t size, uint16_t connectionId) {
+        merged.push_back({*buf, size, connectionId});
+    };
+    ASSERT_TRUE(merger.initMerger(settings));
+
+    // The sequence numbers are unrelated between the legs
+    for (uint32_t i = 0; i < 1000; i++) {
+        auto packet = makePacket(i & 0xff, 100 + i);
+        EXPECT_TRUE(merger.pushData(i % 3, packet.data(), packet.size(), 1, i));
+        EXPECT_FALSE(merger.pushData((i + 1) % 3, packet.data(), packet.size(), 1, i + 5000));
+        EXPECT_FALSE(merger.pushData((i + 2) % 3, packet.data(), packet.size(), 1, i + 9000));
+    }
+    EXPECT_EQ(merged.size(), 1000);
+
+    // The same payload on another flow is not a duplicate
+    auto packet = makePacket(999 & 0xff, 1099);
+    EXPECT_TRUE(merger.pushData(0, packet.data(), packet.size(), 2, 0));
+
+    // Fingerprints fall out of the window
+    auto first = makePacket(0, 100);
+    EXPECT_TRUE(merger.pushData(0, first.data(), first.size(), 1, 0));
+
+    RISTNetMerger::MergerStatistics stats;
+    merger.getStatistics(stats);
+    for (auto& leg : stats.mLegs) {
+        EXPECT_GE(leg.mContributed, 333);
+        EXPECT_GE(leg.mDuplicates, 666);
+    }
+}
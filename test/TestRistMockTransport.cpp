@@ -0,0 +1,307 @@
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "RISTNetMockTransport.h"
+
+TEST(TestRistMockTransport, ReceiverCallbacks) {
+    RISTNetReceiver receiver;
+    receiver.validateConnectionCallback = [](const std::string& ipAddress, uint16_t port) {
+        if (ipAddress == "10.0.0.66") {
+            return std::shared_ptr<RISTNetReceiver::NetworkConnection>();
+        }
+        auto connection = std::make_shared<RISTNetReceiver::NetworkConnection>();
+        connection->mObject = (int)port;
+        return connection;
+    };
+    std::map<int, std::vector<uint64_t>> received; // Port of the connection -> seq
+    receiver.networkDataBlockCallback = [&](const rist_data_block& rDataBlock,
+                                            std::shared_ptr<RISTNetReceiver::NetworkConnection>& rConnection) {
+        EXPECT_EQ(rDataBlock.payload_len, 188);
+        received[std::any_cast<int>(rConnection->mObject)].push_back(rDataBlock.seq);
+        return 0;
+    };
+    std::string oob;
+    receiver.networkOOBDataCallback = [&](const uint8_t* pBuf, size_t size,
+                                          std::shared_ptr<RISTNetReceiver::NetworkConnection>& rConnection,
+                                          rist_peer* pPeer) { oob.assign((const char*)pBuf, size); };
+    std::string statistics;
+    receiver.statisticsCallback = [&](const rist_stats& rStatistics) { statistics = rStatistics.stats_json; };
+    std::vector<int> disconnected;
+    receiver.clientDisconnectedCallback = [&](const std::shared_ptr<RISTNetReceiver::NetworkConnection>& rConnection,
+                                              const rist_peer& rPeer) {
+        disconnected.push_back(std::any_cast<int>(rConnection->mObject));
+    };
+
+    RISTNetMockTransport transport;
+    RISTNetReceiver::RISTNetReceiverSettings settings;
+    ASSERT_TRUE(transport.attachReceiver(receiver, settings));
+    EXPECT_FALSE(transport.attachReceiver(receiver, settings));
+
+    rist_peer* peerA = transport.connectPeer("10.0.0.1", 1000);
+    rist_peer* peerB = transport.connectPeer("10.0.0.2", 2000);
+    ASSERT_NE(peerA, nullptr);
+    ASSERT_NE(peerB, nullptr);
+    EXPECT_EQ(transport.connectPeer("10.0.0.66", 3000), nullptr);
+    EXPECT_EQ(transport.getPeers(), 2);
+
+    std::vector<uint8_t> packet(188);
+    for (uint64_t seq = 0; seq < 10; seq++) {
+        EXPECT_EQ(transport.injectData(seq % 2 ? peerB : peerA, packet.data(), packet.size(), 7, seq), 0);
+    }
+    EXPECT_EQ(received[1000], std::vector<uint64_t>({0, 2, 4, 6, 8}));
+    EXPECT_EQ(received[2000], std::vector<uint64_t>({1, 3, 5, 7, 9}));
+
+    std::vector<RISTNetCounterSnapshot> flows;
+    std::vector<RISTNetCounterSnapshot> peers;
+    receiver.getCounters(flows, peers);
+    ASSERT_EQ(flows.size(), 1);
+    EXPECT_EQ(flows[0].mKey, 7);
+    EXPECT_EQ(flows[0].mPackets, 10);
+    EXPECT_EQ(flows[0].mSeqGaps, 0);
+    EXPECT_EQ(peers.size(), 2);
+
+    std::string hello = "hello";
+    EXPECT_EQ(transport.injectOOBData(peerA, (const uint8_t*)hello.data(), hello.size()), 0);
+    EXPECT_EQ(oob, "hello");
+    std::string json = "{\"receiver-stats\":{}}";
+    rist_stats stats{};
+    stats.stats_json = (char*)json.c_str();
+    stats.json_size = json.size();
+    EXPECT_EQ(transport.injectStatistics(stats), 0);
+    EXPECT_EQ(statistics, json);
+
+    // OOB from the receiver goes to the transport
+    EXPECT_TRUE(receiver.sendOOBData(peerA, (const uint8_t*)hello.data(), hello.size()));
+
+    EXPECT_TRUE(transport.disconnectPeer(peerA));
+    EXPECT_FALSE(transport.disconnectPeer(peerA));
+    EXPECT_EQ(disconnected, std::vector<int>({1000}));
+    EXPECT_TRUE(receiver.closeClientConnection(peerB));
+    EXPECT_EQ(transport.getPeers(), 0);
+
+    RISTNetMockTransport::MockTransportStatistics transportStatistics;
+    transport.getStatistics(transportStatistics);
+    EXPECT_EQ(transportStatistics.mPeersConnected, 2);
+    EXPECT_EQ(transportStatistics.mPeersRejected, 1);
+    EXPECT_EQ(transportStatistics.mPeersDisconnected, 1);
+    EXPECT_EQ(transportStatistics.mPeersClosed, 1);
+    EXPECT_EQ(transportStatistics.mOOBWritten, 1);
+
+    EXPECT_TRUE(receiver.destroyReceiver());
+    EXPECT_EQ(transport.connectPeer("10.0.0.1", 1000), nullptr);
+    EXPECT_FALSE(receiver.sendOOBData(peerA, (const uint8_t*)hello.data(), hello.size()));
+}
+
+TEST(TestRistMockTransport, ReceiverEventQueue) {
+    RISTNetReceiver receiver;
+    receiver.validateConnectionCallback = [](const std::string& ipAddress, uint16_t port) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    RISTNetMockTransport transport;
+    RISTNetReceiver::RISTNetReceiverSettings settings;
+    settings.mEventQueueSize = 64;
+    ASSERT_TRUE(transport.attachReceiver(receiver, settings));
+    EXPECT_GE(receiver.getEventFd(), 0);
+
+    rist_peer* peer = transport.connectPeer("10.0.0.1", 1000);
+    ASSERT_NE(peer, nullptr);
+    std::vector<uint8_t> packet(1316, 0x47);
+    EXPECT_EQ(transport.injectData(peer, packet.data(), packet.size(), 3, 0), 0);
+    EXPECT_TRUE(transport.disconnectPeer(peer));
+
+    std::vector<RISTNetReceiver::NetworkEvent> events;
+    ASSERT_EQ(receiver.drain(events, SIZE_MAX), 3);
+    EXPECT_EQ(events[0].mType, RISTNetEventType::kConnect);
+    EXPECT_EQ(events[1].mType, RISTNetEventType::kData);
+    EXPECT_EQ(events[1].mData.size(), 1316);
+    EXPECT_EQ(events[1].mConnectionID, 3);
+    EXPECT_EQ(events[2].mType, RISTNetEventType::kDisconnect);
+    EXPECT_EQ(events[2].pPeer, peer);
+    transport.detach();
+    EXPECT_EQ(receiver.getEventFd(), -1);
+}
+
+// The OOB data events in the pool of the settings
+TEST(TestRistMockTransport, SenderEventQueue) {
+    RISTNetPacketPool pool;
+    RISTNetPacketPool::RISTNetPacketPoolSettings poolSettings;
+    ASSERT_TRUE(pool.initPacketPool(poolSettings));
+    RISTNetSender sender;
+    sender.validateConnectionCallback = [](const std::string& ipAddress, uint16_t port) {
+        return std::make_shared<RISTNetSender::NetworkConnection>();
+    };
+    RISTNetMockTransport transport;
+    RISTNetSender::RISTNetSenderSettings settings;
+    settings.mEventQueueSize = 64;
+    settings.mPacketPool = &pool;
+    ASSERT_TRUE(transport.attachSender(sender, settings));
+
+    rist_peer* peer = transport.connectPeer("10.0.0.1", 1000);
+    ASSERT_NE(peer, nullptr);
+    std::string hello = "hello";
+    EXPECT_EQ(transport.injectOOBData(peer, (const uint8_t*)hello.data(), hello.size()), 0);
+    {
+        std::vector<RISTNetSender::NetworkEvent> events;
+        ASSERT_EQ(sender.drain(events, SIZE_MAX), 2);
+        EXPECT_EQ(events[0].mType, RISTNetEventType::kConnect);
+        EXPECT_EQ(events[1].mType, RISTNetEventType::kOOBData);
+        EXPECT_EQ(events[1].mData.size(), hello.size());
+        RISTNetPacketPool::PacketPoolStatistics statistics;
+        pool.getStatistics(statistics);
+        EXPECT_EQ(statistics.mAllocations, 1);
+        EXPECT_EQ(statistics.mInUse, 1);
+    }
+    transport.detach();
+    EXPECT_TRUE(pool.destroyPacketPool());
+}
+
+TEST(TestRistMockTransport, SenderWrites) {
+    RISTNetSender sender;
+    sender.validateConnectionCallback = [](const std::string& ipAddress, uint16_t port) {
+        return std::make_shared<RISTNetSender::NetworkConnection>();
+    };
+    RISTNetMockTransport transport;
+    std::vector<uint16_t> flows;
+    int writeLimit = INT32_MAX;
+    transport.dataWriteCallback = [&](const rist_data_block& rDataBlock) {
+        flows.push_back(rDataBlock.flow_id);
+        return std::min((int)rDataBlock.payload_len, writeLimit);
+    };
+    EXPECT_FALSE(sender.sendData((const uint8_t*)"x", 1));
+    RISTNetSender::RISTNetSenderSettings settings;
+    ASSERT_TRUE(transport.attachSender(sender, settings));
+
+    std::vector<uint8_t> packet(1316);
+    EXPECT_TRUE(sender.sendData(packet.data(), packet.size(), 5));
+    EXPECT_TRUE(sender.sendData(packet.data(), packet.size(), 6));
+    writeLimit = 100;
+    EXPECT_FALSE(sender.sendData(packet.data(), packet.size(), 5));
+    EXPECT_EQ(flows, std::vector<uint16_t>({5, 6, 5}));
+
+    rist_peer* peer = transport.connectPeer("10.0.0.1", 1000);
+    ASSERT_NE(peer, nullptr);
+    int peers = 0;
+    sender.getActiveClients([&](std::map<rist_peer*, std::shared_ptr<RISTNetSender::NetworkConnection>>& rClients) {
+        peers = rClients.size();
+    });
+    EXPECT_EQ(peers, 1);
+    EXPECT_TRUE(sender.sendOOBData(peer, packet.data(), 10));
+
+    RISTNetMockTransport::MockTransportStatistics statistics;
+    transport.getStatistics(statistics);
+    EXPECT_EQ(statistics.mPacketsWritten, 3);
+    EXPECT_EQ(statistics.mBytesWritten, 1316 * 2 + 100);
+    EXPECT_EQ(statistics.mOOBWritten, 1);
+
+    // A failing write destroys the sender like a failing rist_sender_data_write
+    writeLimit = -1;
+    EXPECT_FALSE(sender.sendData(packet.data(), packet.size()));
+    EXPECT_EQ(transport.connectPeer("10.0.0.1", 1000), nullptr);
+}
+
+// Threads sending on the same flows at once, every packet counted
+TEST(TestRistMockTransport, SenderConcurrentCounters) {
+    RISTNetSender sender;
+    RISTNetMockTransport transport;
+    transport.dataWriteCallback = [](const rist_data_block& rDataBlock) { return (int)rDataBlock.payload_len; };
+    RISTNetSender::RISTNetSenderSettings settings;
+    ASSERT_TRUE(transport.attachSender(sender, settings));
+
+    constexpr int kThreads = 4;
+    constexpr int kPackets = 2000;
+    std::vector<uint8_t> packet(188);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < kPackets; i++) {
+                sender.sendData(packet.data(), packet.size(), (uint16_t)((t + i) % 3));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::vector<RISTNetCounterSnapshot> flows;
+    sender.getCounters(flows);
+    ASSERT_EQ(flows.size(), 3);
+    uint64_t packets = 0;
+    for (auto& flow : flows) {
+        packets += flow.mPackets;
+        EXPECT_EQ(flow.mBytes, flow.mPackets * 188);
+    }
+    EXPECT_EQ(packets, kThreads * kPackets);
+    transport.detach();
+}
+
+// Driver threads connecting, sending and disconnecting at once while the application walks the peer table
+TEST(TestRistMockTransport, ConcurrentPeers) {
+    RISTNetReceiver receiver;
+    receiver.validateConnectionCallback = [](const std::string& ipAddress, uint16_t port) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    std::atomic<uint64_t> packets{0};
+    std::atomic<uint64_t> disconnects{0};
+    receiver.networkDataCallback = [&](const uint8_t* pBuf, size_t size,
+                                       std::shared_ptr<RISTNetReceiver::NetworkConnection>& rConnection,
+                                       rist_peer* pPeer, uint16_t connectionID) {
+        packets++;
+        return 0;
+    };
+    receiver.clientDisconnectedCallback = [&](const std::shared_ptr<RISTNetReceiver::NetworkConnection>& rConnection,
+                                              const rist_peer& rPeer) { disconnects++; };
+    RISTNetMockTransport transport;
+    RISTNetReceiver::RISTNetReceiverSettings settings;
+    ASSERT_TRUE(transport.attachReceiver(receiver, settings));
+
+    constexpr int kThreads = 4;
+    constexpr int kRounds = 200;
+    constexpr int kPeersPerRound = 4;
+    constexpr int kPacketsPerPeer = 8;
+    std::atomic<bool> run{true};
+    std::thread walker([&]() {
+        while (run) {
+            receiver.getActiveClients([](std::map<rist_peer*, std::shared_ptr<RISTNetReceiver::NetworkConnection>>& rClients) {
+                EXPECT_LE(rClients.size(), kThreads * kPeersPerRound);
+            });
+            std::this_thread::yield();
+        }
+    });
+    std::vector<std::thread> drivers;
+    for (int t = 0; t < kThreads; t++) {
+        drivers.emplace_back([&, t]() {
+            std::vector<uint8_t> packet(188);
+            for (int round = 0; round < kRounds; round++) {
+                std::vector<rist_peer*> peers;
+                for (int p = 0; p < kPeersPerRound; p++) {
+                    peers.push_back(transport.connectPeer("10.0.0." + std::to_string(t), round * kPeersPerRound + p));
+                }
+                for (int i = 0; i < kPacketsPerPeer; i++) {
+                    for (auto pPeer : peers) {
+                        EXPECT_EQ(transport.injectData(pPeer, packet.data(), packet.size(), t, i), 0);
+                    }
+                }
+                for (auto pPeer : peers) {
+                    EXPECT_TRUE(transport.disconnectPeer(pPeer));
+                }
+            }
+        });
+    }
+    for (auto& rDriver : drivers) {
+        rDriver.join();
+    }
+    run = false;
+    walker.join();
+
+    EXPECT_EQ(packets, kThreads * kRounds * kPeersPerRound * kPacketsPerPeer);
+    EXPECT_EQ(disconnects, kThreads * kRounds * kPeersPerRound);
+    EXPECT_EQ(transport.getPeers(), 0);
+    std::vector<RISTNetCounterSnapshot> flows;
+    std::vector<RISTNetCounterSnapshot> peers;
+    receiver.getCounters(flows, peers);
+    ASSERT_EQ(flows.size(), kThreads);
+    for (auto& rFlow : flows) {
+        EXPECT_EQ(rFlow.mPackets, kRounds * kPeersPerRound * kPacketsPerPeer);
+        EXPECT_EQ(rFlow.mErrors, 0);
+    }
+}
@@ -0,0 +1,172 @@
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "RISTNetPacketPool.h"
+
+TEST(TestRistPacketPool, Init) {
+    RISTNetPacketPool pool;
+    RISTNetPacketPool::RISTNetPacketPoolSettings settings;
+    EXPECT_FALSE(pool.allocate(100));
+    settings.mMaxBytes = 1024;
+    EXPECT_FALSE(pool.initPacketPool(settings));
+    settings.mMaxBytes = 16 * RISTNetPacketPool::kSlabSize;
+    ASSERT_TRUE(pool.initPacketPool(settings));
+    EXPECT_FALSE(pool.initPacketPool(settings));
+    EXPECT_TRUE(pool.destroyPacketPool());
+    EXPECT_FALSE(pool.destroyPacketPool());
+}
+
+TEST(TestRistPacketPool, AllocateAndShare) {
+    RISTNetPacketPool pool;
+    RISTNetPacketPool::RISTNetPacketPoolSettings settings;
+    ASSERT_TRUE(pool.initPacketPool(settings));
+
+    std::vector<uint8_t> data(1316);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = i;
+    }
+    RISTNetPacketBuffer buffer = pool.copy(data.data(), data.size());
+    ASSERT_TRUE(buffer);
+    EXPECT_EQ(buffer.size(), data.size());
+    EXPECT_GE(buffer.capacity(), data.size());
+    EXPECT_EQ(memcmp(buffer.data(), data.data(), data.size()), 0);
+    EXPECT_EQ((uintptr_t)buffer.data() % 16, 0);
+    EXPECT_TRUE(buffer.resize(10));
+    EXPECT_FALSE(buffer.resize(buffer.capacity() + 1));
+
+    // Every size up to the max fits its class
+    EXPECT_GE(pool.allocate(1).capacity(), 1);
+    EXPECT_GE(pool.allocate(RIST_MAX_PACKET_SIZE).capacity(), RIST_MAX_PACKET_SIZE);
+    EXPECT_FALSE(pool.allocate(RIST_MAX_PACKET_SIZE + 1));
+
+    RISTNetPacketBuffer shared = buffer.share();
+    EXPECT_EQ(shared.data(), buffer.data());
+    RISTNetPacketPool::PacketPoolStatistics stats;
+    pool.getStatistics(stats);
+    EXPECT_EQ(stats.mInUse, 1);
+    EXPECT_EQ(stats.mFailures, 1);
+    buffer.reset();
+    EXPECT_FALSE(buffer);
+    pool.getStatistics(stats);
+    EXPECT_EQ(stats.mInUse, 1);
+    EXPECT_FALSE(pool.destroyPacketPool());
+    shared.reset();
+    pool.getStatistics(stats);
+    EXPECT_EQ(stats.mInUse, 0);
+    EXPECT_GE(stats.mPeakTaken, 1);
+    EXPECT_TRUE(pool.destroyPacketPool());
+}
+
+TEST(TestRistPacketPool, CapAndPeakTaken) {
+    RISTNetPacketPool pool;
+    RISTNetPacketPool::RISTNetPacketPoolSettings settings;
+    settings.mMaxBytes = RISTNetPacketPool::kSlabSize;
+    settings.mThreadCacheSize = 8;
+    ASSERT_TRUE(pool.initPacketPool(settings));
+
+    // One slab of 2048 byte buffers, the allocations fail when it is used up
+    std::vector<RISTNetPacketBuffer> buffers;
+    while (true) {
+        RISTNetPacketBuffer buffer = pool.allocate(2000);
+        if (!buffer) {
+            break;
+        }
+        buffers.push_back(std::move(buffer));
+        ASSERT_LT(buffers.size(), RISTNetPacketPool::kSlabSize / 2048);
+    }
+    EXPECT_GT(buffers.size(), RISTNetPacketPool::kSlabSize / 2048 / 2);
+    EXPECT_FALSE(pool.allocate(100));
+    RISTNetPacketPool::PacketPoolStatistics stats;
+    pool.getStatistics(stats);
+    EXPECT_EQ(stats.mInUse, buffers.size());
+    EXPECT_EQ(stats.mPeakTaken, buffers.size());
+    EXPECT_EQ(stats.mFailures, 2);
+    EXPECT_EQ(stats.mBytesReserved, RISTNetPacketPool::kSlabSize);
+
+    // Released buffers are reused, no more memory is reserved
+    size_t count = buffers.size();
+    buffers.clear();
+    for (size_t i = 0; i < count; i++) {
+        buffers.push_back(pool.allocate(2000));
+        ASSERT_TRUE(buffers.back());
+    }
+    buffers.clear();
+    pool.getStatistics(stats);
+    EXPECT_EQ(stats.mInUse, 0);
+    EXPECT_EQ(stats.mPeakTaken, count);
+    EXPECT_EQ(stats.mBytesReserved, RISTNetPacketPool::kSlabSize);
+    EXPECT_TRUE(pool.destroyPacketPool());
+}
+
+TEST(TestRistPacketPool, CrossThreadRelease) {
+    RISTNetPacketPool pool;
+    RISTNetPacketPool::RISTNetPacketPoolSettings settings;
+    settings.mMaxBytes = 2 * RISTNetPacketPool::kSlabSize;
+    settings.mThreadCacheSize = 64;
+    ASSERT_TRUE(pool.initPacketPool(settings));
+
+    // A producer allocates, consumers release on their threads. The producer gets ahead until the cap stops it
+    // and then runs on the buffers the consumers return.
+    const size_t kPackets = 100000;
+    const size_t kConsumers = 3;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<RISTNetPacketBuffer> queue;
+    bool done = false;
+    std::atomic<size_t> checked{0};
+    std::vector<std::thread> consumers;
+    for (size_t i = 0; i < kConsumers; i++) {
+        consumers.emplace_back([&]() {
+            while (true) {
+                RISTNetPacketBuffer buffer;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    condition.wait(lock, [&]() { return done || !queue.empty(); });
+                    if (queue.empty()) {
+                        return;
+                    }
+                    buffer = std::move(queue.front());
+                    queue.pop_front();
+                }
+                uint32_t index;
+                memcpy(&index, buffer.data(), sizeof(index));
+                if (buffer.data()[buffer.size() - 1] == (uint8_t)index) {
+                    checked++;
+                }
+            }
+        });
+    }
+    std::thread producer([&]() {
+        for (uint32_t i = 0; i < kPackets; i++) {
+            RISTNetPacketBuffer buffer = pool.allocate(1316);
+            if (!buffer) {
+                std::this_thread::yield();
+                i--;
+                continue;
+            }
+            memcpy(buffer.data(), &i, sizeof(i));
+            buffer.data()[buffer.size() - 1] = (uint8_t)i;
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(std::move(buffer));
+            condition.notify_one();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        condition.notify_all();
+    });
+    producer.join();
+    for (auto& consumer : consumers) {
+        consumer.join();
+    }
+    EXPECT_EQ(checked, kPackets);
+
+    RISTNetPacketPool::PacketPoolStatistics stats;
+    pool.getStatistics(stats);
+    EXPECT_EQ(stats.mInUse, 0);
+    EXPECT_EQ(stats.mAllocations, kPackets);
+    EXPECT_LE(stats.mBytesReserved, 2 * RISTNetPacketPool::kSlabSize);
+    EXPECT_TRUE(pool.destroyPacketPool());
+}
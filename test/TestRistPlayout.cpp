@@ -0,0 +1,175 @@
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "RISTNetPlayout.h"
+
+namespace {
+uint64_t nsToNtp(uint64_t ns) {
+    return ((ns / 1000000000ULL) << 32) + (((ns % 1000000000ULL) << 32) / 1000000000ULL);
+}
+
+rist_data_block makeBlock(const std::vector<uint8_t>& payload, uint32_t flowID, uint64_t ntp, uint32_t flags = 0) {
+    rist_data_block block{};
+    block.payload = payload.data();
+    block.payload_len = payload.size();
+    block.flow_id = flowID;
+    block.ts_ntp = ntp;
+    block.flags = flags;
+    return block;
+}
+
+double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+} // namespace
+
+// A burst of packets sent 5 ms apart comes out 5 ms apart, 50 ms after the first
+TEST(TestRistPlayout, ConstantDelayPacing) {
+    RISTNetPlayout playout;
+    RISTNetPlayout::RISTNetPlayoutSettings settings;
+    settings.mDelay = std::chrono::milliseconds(50);
+    ASSERT_TRUE(playout.initPlayout(settings));
+    std::mutex mtx;
+    std::vector<std::pair<int, double>> delivered;
+    auto start = std::chrono::steady_clock::now();
+    playout.playoutCallback = [&](RISTNetPacketBuffer& rBuffer, uint32_t flowID) {
+        EXPECT_EQ(flowID, 7);
+        std::lock_guard<std::mutex> lock(mtx);
+        delivered.emplace_back(rBuffer.data()[0], msSince(start));
+    };
+    uint64_t ntpBase = nsToNtp(1000000000000ULL);
+    for (int i = 0; i < 20; i++) {
+        std::vector<uint8_t> payload(188, (uint8_t)i);
+        EXPECT_TRUE(playout.pushPacket(makeBlock(payload, 7, ntpBase + nsToNtp(i * 5000000ULL))));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    std::lock_guard<std::mutex> lock(mtx);
+    ASSERT_EQ(delivered.size(), 20);
+    for (int i = 0; i < 20; i++) {
+        EXPECT_EQ(delivered[i].first, i);
+        EXPECT_GE(delivered[i].second, 50 + i * 5 - 0.5);
+        EXPECT_LT(delivered[i].second, 50 + i * 5 + 15);
+    }
+    RISTNetPlayout::PlayoutStatistics statistics;
+    playout.getStatistics(statistics);
+    EXPECT_EQ(statistics.mPackets, 20);
+    EXPECT_EQ(statistics.mUnderruns, 0);
+    EXPECT_EQ(statistics.mQueued, 0);
+
+    // Packets still waiting are released by destroy
+    std::vector<uint8_t> payload(188);
+    EXPECT_TRUE(playout.pushPacket(makeBlock(payload, 7, ntpBase + nsToNtp(1000000000ULL))));
+    EXPECT_TRUE(playout.destroyPlayout());
+}
+
+TEST(TestRistPlayout, LateOverrunResync) {
+    RISTNetPlayout playout;
+    RISTNetPlayout::RISTNetPlayoutSettings settings;
+    settings.mDelay = std::chrono::milliseconds(20);
+    settings.mMaxPacketsPerFlow = 5;
+    ASSERT_TRUE(playout.initPlayout(settings));
+    std::atomic<int> delivered{0};
+    playout.playoutCallback = [&](RISTNetPacketBuffer& rBuffer, uint32_t flowID) { delivered++; };
+    std::vector<uint8_t> payload(188);
+    uint64_t ntpBase = nsToNtp(1000000000000ULL);
+
+    // Flow 1, more than mMaxPacketsPerFlow waiting
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(playout.pushPacket(makeBlock(payload, 1, ntpBase + nsToNtp(i * 1000000ULL))), i < 5);
+    }
+    // Flow 2, a packet 100 ms older than the first misses its deadline
+    EXPECT_TRUE(playout.pushPacket(makeBlock(payload, 2, ntpBase)));
+    EXPECT_FALSE(playout.pushPacket(makeBlock(payload, 2, ntpBase - nsToNtp(100000000ULL))));
+    // Flow 3, a timestamp jump and a discontinuity re-anchor the flow
+    EXPECT_TRUE(playout.pushPacket(makeBlock(payload, 3, ntpBase)));
+    EXPECT_TRUE(playout.pushPacket(makeBlock(payload, 3, ntpBase + nsToNtp(10000000000ULL))));
+    EXPECT_TRUE(playout.pushPacket(makeBlock(payload, 3, ntpBase, RIST_DATA_FLAGS_DISCONTINUITY)));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    EXPECT_EQ(delivered, 9);
+    RISTNetPlayout::PlayoutStatistics statistics;
+    playout.getStatistics(statistics);
+    EXPECT_EQ(statistics.mPackets, 9);
+    EXPECT_EQ(statistics.mOverruns, 5);
+    EXPECT_EQ(statistics.mLate, 1);
+    EXPECT_EQ(statistics.mResyncs, 2);
+    EXPECT_EQ(statistics.mUnderruns, 0);
+    EXPECT_EQ(statistics.mFlows, 3);
+    EXPECT_EQ(statistics.mQueued, 0);
+}
+
+// A packet late with nothing of its flow queued is an underrun, idle flows are forgotten
+TEST(TestRistPlayout, UnderrunAndIdleFlows) {
+    RISTNetPlayout playout;
+    RISTNetPlayout::RISTNetPlayoutSettings settings;
+    settings.mDelay = std::chrono::milliseconds(20);
+    settings.mFlowTimeout = std::chrono::milliseconds(200);
+    ASSERT_TRUE(playout.initPlayout(settings));
+    std::vector<uint8_t> payload(188);
+    uint64_t ntpBase = nsToNtp(1000000000000ULL);
+
+    // Played out, the next packet of the flow comes 100 ms later but was sent 10 ms later
+    EXPECT_TRUE(playout.pushPacket(makeBlock(payload, 1, ntpBase)));
+    EXPECT_TRUE(playout.pushPacket(makeBlock(payload, 2, ntpBase)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_FALSE(playout.pushPacket(makeBlock(payload, 1, ntpBase + nsToNtp(10000000ULL))));
+    RISTNetPlayout::PlayoutStatistics statistics;
+    playout.getStatistics(statistics);
+    EXPECT_EQ(statistics.mPackets, 2);
+    EXPECT_EQ(statistics.mLate, 1);
+    EXPECT_EQ(statistics.mUnderruns, 1);
+    EXPECT_EQ(statistics.mFlows, 2);
+
+    // Flow 2 idle past the timeout is forgotten with the next packet pushed, flow 1 pushed 120 ms ago is kept
+    std::this_thread::sleep_for(std::chrono::milliseconds(120));
+    EXPECT_TRUE(playout.pushPacket(makeBlock(payload, 3, ntpBase)));
+    playout.getStatistics(statistics);
+    EXPECT_EQ(statistics.mFlows, 2);
+    EXPECT_TRUE(playout.destroyPlayout());
+}
+
+// A delay of 30000 ticks goes through every level of the wheel, flows are interleaved
+TEST(TestRistPlayout, ManyFlowsArrivalTime) {
+    RISTNetPlayout playout;
+    RISTNetPlayout::RISTNetPlayoutSettings settings;
+    settings.mDelay = std::chrono::milliseconds(300);
+    settings.mTick = std::chrono::microseconds(10);
+    settings.mUseSenderTime = false;
+    ASSERT_TRUE(playout.initPlayout(settings));
+
+    constexpr int kFlows = 64;
+    constexpr int kPackets = 10;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<double> pushed(kFlows * kPackets);
+    std::vector<double> played(kFlows * kPackets, -1);
+    std::vector<int> next(kFlows, 0);
+    std::atomic<int> delivered{0};
+    playout.playoutCallback = [&](RISTNetPacketBuffer& rBuffer, uint32_t flowID) {
+        int index;
+        memcpy(&index, rBuffer.data(), sizeof(index));
+        played[index] = msSince(start);
+        EXPECT_EQ(index % kPackets, next[flowID]++);
+        delivered++;
+    };
+    std::vector<uint8_t> payload(188);
+    for (int packet = 0; packet < kPackets; packet++) {
+        for (int flow = 0; flow < kFlows; flow++) {
+            int index = flow * kPackets + packet;
+            memcpy(payload.data(), &index, sizeof(index));
+            pushed[index] = msSince(start);
+            EXPECT_TRUE(playout.pushPacket(makeBlock(payload, flow, 0)));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(3));
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (delivered < kFlows * kPackets && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    playout.destroyPlayout();
+    ASSERT_EQ(delivered, kFlows * kPackets);
+    for (int i = 0; i < kFlows * kPackets; i++) {
+        EXPECT_GE(played[i] - pushed[i], 300 - 0.5);
+        EXPECT_LT(played[i] - pushed[i], 300 + 20);
+    }
+}
@@ -0,0 +1,103 @@
+#include <elf.h>
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "RISTNetProbes.h"
+
+namespace {
+// The content of the named section of the test binary, empty if there is none
+std::string elfSection(const std::string& name) {
+    std::ifstream binary("/proc/self/exe", std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(binary)), std::istreambuf_iterator<char>());
+    if (content.size() < sizeof(Elf64_Ehdr)) {
+        return "";
+    }
+    Elf64_Ehdr header;
+    memcpy(&header, content.data(), sizeof(header));
+    if (header.e_ident[EI_CLASS] != ELFCLASS64 ||
+        header.e_shoff + (uint64_t)header.e_shnum * sizeof(Elf64_Shdr) > content.size()) {
+        return "";
+    }
+    std::vector<Elf64_Shdr> sections(header.e_shnum);
+    memcpy(sections.data(), content.data() + header.e_shoff, sections.size() * sizeof(Elf64_Shdr));
+    const Elf64_Shdr& names = sections[header.e_shstrndx];
+    for (auto& section : sections) {
+        if (names.sh_offset + section.sh_name < content.size() &&
+            name == content.c_str() + names.sh_offset + section.sh_name &&
+            section.sh_offset + section.sh_size <= content.size()) {
+            return content.substr(section.sh_offset, section.sh_size);
+        }
+    }
+    return "";
+}
+} // namespace
+
+TEST(TestRistProbes, LockAndScope) {
+    EXPECT_EQ(ristnetProbeSince(0), 0u);
+    uint64_t start = ristnetProbeNow();
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    EXPECT_GE(ristnetProbeSince(start), 2000000u);
+
+    std::mutex mutex;
+    {
+        RISTNetProbeLock lock(mutex, &mutex, "test");
+        EXPECT_FALSE(mutex.try_lock());
+    }
+    EXPECT_TRUE(mutex.try_lock());
+    mutex.unlock();
+
+    int done = 0;
+    {
+        RISTNetProbeScope scope([&] {
+            done++;
+            RISTNET_PROBE(init_receiver, &done, done, 1, 0);
+        });
+        EXPECT_EQ(done, 0);
+    }
+    EXPECT_EQ(done, 1);
+}
+
+// The semaphores of the library switch the probes on, as a tracer attaching does
+TEST(TestRistProbes, Semaphores) {
+#ifndef RISTNET_HAVE_SDT
+    GTEST_SKIP() << "Built without sys/sdt.h";
+#else
+    // The probe notes of the library are linked in, with the provider and the probe names
+    std::string notes = elfSection(".note.stapsdt");
+    EXPECT_NE(notes.find(std::string("ristnet\0lock_wait", 17)), std::string::npos);
+    EXPECT_NE(notes.find(std::string("ristnet\0receive_data", 20)), std::string::npos);
+    EXPECT_FALSE(elfSection(".probes").empty());
+
+    EXPECT_FALSE(RISTNET_PROBE_ENABLED(lock_wait));
+    EXPECT_EQ(RISTNET_PROBE_START(lock_wait), 0u);
+    RISTNET_PROBE_SEMAPHORE(lock_wait) = 1;
+    EXPECT_TRUE(RISTNET_PROBE_ENABLED(lock_wait));
+    EXPECT_NE(RISTNET_PROBE_START(lock_wait), 0u);
+
+    // A lock waited for with the probe enabled, the probe fires without a tracer attached
+    std::mutex mutex;
+    std::atomic<bool> locked{false};
+    std::thread holder([&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        locked = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    });
+    while (!locked) {
+        std::this_thread::yield();
+    }
+    uint64_t start = ristnetProbeNow();
+    {
+        RISTNetProbeLock lock(mutex, &mutex, "test");
+        EXPECT_GE(ristnetProbeSince(start), 1000000u);
+    }
+    holder.join();
+    RISTNET_PROBE_SEMAPHORE(lock_wait) = 0;
+    EXPECT_FALSE(RISTNET_PROBE_ENABLED(lock_wait));
+#endif
+}
@@ -0,0 +1,208 @@
+#include <condition_variable>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "RISTNetRelay.h"
+
+namespace {
+// Collects what an output is sent, optionally slow
+class OutputCollector {
+public:
+    explicit OutputCollector(std::chrono::microseconds delay = std::chrono::microseconds(0)) : mDelay(delay) {}
+
+    std::function<bool(const uint8_t*, size_t, uint16_t)> function() {
+        return [this](const uint8_t* buf, size_t size, uint16_t connectionId) {
+            if (mDelay.count()) {
+                std::this_thread::sleep_for(mDelay);
+            }
+            uint32_t index;
+            memcpy(&index, buf, sizeof(index));
+            std::lock_guard<std::mutex> lock(mMutex);
+            mIndexes.push_back(index);
+            mConnectionIDs.push_back(connectionId);
+            mCondition.notify_all();
+            return true;
+        };
+    }
+    std::vector<uint32_t> waitFor(size_t count) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait_for(lock, std::chrono::seconds(5), [&]() { return mIndexes.size() >= count; });
+        return mIndexes;
+    }
+    std::vector<uint16_t> connectionIDs() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mConnectionIDs;
+    }
+
+private:
+    std::chrono::microseconds mDelay;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::vector<uint32_t> mIndexes;
+    std::vector<uint16_t> mConnectionIDs;
+};
+
+std::vector<uint8_t> makePacket(uint32_t index) {
+    std::vector<uint8_t> packet(1316, 0x47);
+    memcpy(packet.data(), &index, sizeof(index));
+    return packet;
+}
+
+// Waits until nothing is queued or being sent to the output
+bool waitSent(RISTNetRelay& relay, uint32_t outputID) {
+    for (int i = 0; i < 500; i++) {
+        RISTNetRelay::RelayOutputStatistics stats;
+        if (relay.getOutputStatistics(outputID, stats) && !stats.mQueued && !stats.mLag.count()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+} // namespace
+
+TEST(TestRistRelay, Init) {
+    RISTNetRelay relay;
+    RISTNetRelay::RISTNetRelaySettings settings;
+    RISTNetRelay::RelayOutputSettings outputSettings;
+    OutputCollector collector;
+    EXPECT_EQ(relay.addOutput(collector.function(), outputSettings), 0);
+    settings.mThreads = 0;
+    EXPECT_FALSE(relay.initRelay(settings));
+    settings.mThreads = 2;
+    ASSERT_TRUE(relay.initRelay(settings));
+    EXPECT_EQ(relay.addOutput(nullptr, outputSettings), 0);
+    uint32_t id = relay.addOutput(collector.function(), outputSettings);
+    EXPECT_NE(id, 0);
+    EXPECT_TRUE(relay.removeOutput(id));
+    EXPECT_FALSE(relay.removeOutput(id));
+    EXPECT_TRUE(relay.destroyRelay());
+    EXPECT_FALSE(relay.destroyRelay());
+}
+
+TEST(TestRistRelay, FanOutInOrder) {
+    RISTNetRelay relay;
+    RISTNetRelay::RISTNetRelaySettings settings;
+    settings.mThreads = 3;
+    settings.mBurst = 8;
+    ASSERT_TRUE(relay.initRelay(settings));
+
+    const size_t kOutputs = 10;
+    const uint32_t kPackets = 2000;
+    std::vector<std::unique_ptr<OutputCollector>> collectors;
+    RISTNetRelay::RelayOutputSettings outputSettings;
+    outputSettings.mQueueSize = kPackets;
+    for (size_t i = 0; i < kOutputs; i++) {
+        collectors.push_back(std::make_unique<OutputCollector>());
+        ASSERT_NE(relay.addOutput(collectors.back()->function(), outputSettings), 0);
+    }
+    for (uint32_t i = 0; i < kPackets; i++) {
+        auto packet = makePacket(i);
+        ASSERT_TRUE(relay.pushData(packet.data(), packet.size(), 3));
+    }
+    for (auto& collector : collectors) {
+        auto indexes = collector->waitFor(kPackets);
+        ASSERT_EQ(indexes.size(), kPackets);
+        for (uint32_t i = 0; i < kPackets; i++) {
+            ASSERT_EQ(indexes[i], i);
+        }
+        EXPECT_EQ(collector->connectionIDs()[0], 3);
+    }
+    RISTNetRelay::RelayStatistics stats;
+    relay.getStatistics(stats);
+    EXPECT_EQ(stats.mPackets, kPackets);
+    EXPECT_EQ(stats.mOutputs, kOutputs);
+    EXPECT_TRUE(relay.destroyRelay());
+}
+
+TEST(TestRistRelay, SlowOutputIsolated) {
+    RISTNetRelay relay;
+    RISTNetRelay::RISTNetRelaySettings settings;
+    settings.mThreads = 3; // More workers than slow outputs
+    ASSERT_TRUE(relay.initRelay(settings));
+
+    OutputCollector fast;
+    OutputCollector slowOldest(std::chrono::milliseconds(2));
+    OutputCollector slowNewest(std::chrono::milliseconds(2));
+    RISTNetRelay::RelayOutputSettings outputSettings;
+    outputSettings.mQueueSize = 10000;
+    uint32_t fastID = relay.addOutput(fast.function(), outputSettings);
+    outputSettings.mQueueSize = 10;
+    outputSettings.mDropPolicy = RISTNetRelay::DropPolicy::kDropOldest;
+    uint32_t oldestID = relay.addOutput(slowOldest.function(), outputSettings);
+    outputSettings.mDropPolicy = RISTNetRelay::DropPolicy::kDropNewest;
+    uint32_t newestID = relay.addOutput(slowNewest.function(), outputSettings);
+
+    const uint32_t kPackets = 1000;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kPackets; i++) {
+        auto packet = makePacket(i);
+        relay.pushData(packet.data(), packet.size());
+    }
+    // Pushing does not wait for the slow outputs
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+    EXPECT_EQ(fast.waitFor(kPackets).size(), kPackets);
+
+    RISTNetRelay::RelayOutputStatistics oldestStats;
+    ASSERT_TRUE(relay.getOutputStatistics(oldestID, oldestStats));
+    EXPECT_GT(oldestStats.mDropped, 0);
+    EXPECT_LE(oldestStats.mQueued, 10);
+    EXPECT_GT(oldestStats.mLag.count(), 0);
+
+    // Drop oldest ends with the newest packets, drop newest with the first ones
+    ASSERT_TRUE(waitSent(relay, oldestID));
+    auto oldest = slowOldest.waitFor(0);
+    ASSERT_FALSE(oldest.empty());
+    EXPECT_EQ(oldest.back(), kPackets - 1);
+    ASSERT_TRUE(waitSent(relay, newestID));
+    RISTNetRelay::RelayOutputStatistics newestStats;
+    ASSERT_TRUE(relay.getOutputStatistics(newestID, newestStats));
+    auto newest = slowNewest.waitFor(0);
+    EXPECT_EQ(newest.size() + newestStats.mDropped, kPackets);
+    EXPECT_LT(newest.back(), kPackets - 1);
+
+    RISTNetRelay::RelayOutputStatistics fastStats;
+    ASSERT_TRUE(relay.getOutputStatistics(fastID, fastStats));
+    EXPECT_EQ(fastStats.mSent, kPackets);
+    EXPECT_EQ(fastStats.mDropped, 0);
+    EXPECT_TRUE(relay.destroyRelay());
+}
+
+// An output removing itself from its send function, the rest of the batch is not sent
+TEST(TestRistRelay, RemoveFromSend) {
+    RISTNetRelay relay;
+    RISTNetRelay::RISTNetRelaySettings settings;
+    settings.mThreads = 1;
+    settings.mBurst = 8;
+    ASSERT_TRUE(relay.initRelay(settings));
+    RISTNetRelay::RelayOutputSettings outputSettings;
+    std::atomic<uint32_t> id{0};
+    std::atomic<int> sent{0};
+    std::atomic<bool> removed{false};
+    std::mutex startMtx;
+    std::unique_lock<std::mutex> start(startMtx);
+    id = relay.addOutput([&](const uint8_t* buf, size_t size, uint16_t connectionId) {
+        // Held until all packets are queued, so they are sent in one batch
+        std::lock_guard<std::mutex> lock(startMtx);
+        if (++sent == 2) {
+            removed = relay.removeOutput(id);
+        }
+        return true;
+    }, outputSettings);
+    ASSERT_NE(id, 0);
+    for (uint32_t i = 0; i < 8; i++) {
+        auto packet = makePacket(i);
+        ASSERT_TRUE(relay.pushData(packet.data(), packet.size()));
+    }
+    start.unlock();
+    for (int i = 0; i < 500 && !removed; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_TRUE(removed);
+    RISTNetRelay::RelayStatistics stats;
+    relay.getStatistics(stats);
+    EXPECT_EQ(stats.mOutputs, 0);
+    EXPECT_TRUE(relay.destroyRelay());
+    EXPECT_EQ(sent, 2);
+}
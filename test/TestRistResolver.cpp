@@ -0,0 +1,291 @@
+#include <gtest/gtest.h>
+
+#include "RISTNetMockTransport.h"
+#include "RISTNetResolver.h"
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+// A name server on 127.0.0.1 answering A and AAAA queries from mRecords, NXDOMAIN for other names
+class StubNameServer {
+public:
+    StubNameServer(std::map<std::string, std::vector<std::string>> lRecords, uint32_t lTTL)
+        : mRecords(std::move(lRecords)), mTTL(lTTL) {
+        mSocket = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in lAddress{};
+        lAddress.sin_family = AF_INET;
+        lAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(mSocket, (sockaddr *) &lAddress, sizeof(lAddress));
+        socklen_t lSize = sizeof(lAddress);
+        getsockname(mSocket, (sockaddr *) &lAddress, &lSize);
+        mPort = ntohs(lAddress.sin_port);
+        mThread = std::thread(&StubNameServer::serve, this);
+    }
+
+    ~StubNameServer() {
+        mRun = false;
+        mThread.join();
+        close(mSocket);
+    }
+
+    std::string address() const {
+        return "127.0.0.1:" + std::to_string(mPort);
+    }
+
+    std::atomic<int> mQueries{0};
+
+private:
+    void serve() {
+        uint8_t lQuery[512];
+        while (mRun) {
+            pollfd lPoll{mSocket, POLLIN, 0};
+            if (poll(&lPoll, 1, 20) <= 0) {
+                continue;
+            }
+            sockaddr_in lFrom{};
+            socklen_t lFromSize = sizeof(lFrom);
+            ssize_t lSize = recvfrom(mSocket, lQuery, sizeof(lQuery), 0, (sockaddr *) &lFrom, &lFromSize);
+            if (lSize < 17) {
+                continue;
+            }
+            mQueries++;
+            std::string lName;
+            size_t lPos = 12;
+            while (lPos < (size_t) lSize && lQuery[lPos]) {
+                lName += (lName.empty() ? "" : ".") + std::string((char *) lQuery + lPos + 1, lQuery[lPos]);
+                lPos += 1 + lQuery[lPos];
+            }
+            lPos++;
+            uint16_t lType = (lQuery[lPos] << 8) | lQuery[lPos + 1];
+            std::vector<uint8_t> lAnswer(lQuery, lQuery + lPos + 4);
+            lAnswer[2] = 0x81;
+            lAnswer[3] = 0x80;
+            uint16_t lAnswers = 0;
+            auto lRecord = mRecords.find(lName);
+            if (lRecord == mRecords.end()) {
+                lAnswer[3] |= 3;
+            } else {
+                for (auto &rAddress: lRecord->second) {
+                    uint8_t lData[16];
+                    int lFamily = lType == 1 ? AF_INET : AF_INET6;
+                    if (inet_pton(lFamily, rAddress.c_str(), lData) != 1) {
+                        continue;
+                    }
+                    uint8_t lLength = lFamily == AF_INET ? 4 : 16;
+                    lAnswer.insert(lAnswer.end(), {0xc0, 12, 0, (uint8_t) lType, 0, 1, (uint8_t) (mTTL >> 24),
+                                                   (uint8_t) (mTTL >> 16), (uint8_t) (mTTL >> 8), (uint8_t) mTTL,
+                                                   0, lLength});
+                    lAnswer.insert(lAnswer.end(), lData, lData + lLength);
+                    lAnswers++;
+                }
+            }
+            lAnswer[7] = (uint8_t) lAnswers;
+            sendto(mSocket, lAnswer.data(), lAnswer.size(), 0, (sockaddr *) &lFrom, lFromSize);
+        }
+    }
+
+    std::map<std::string, std::vector<std::string>> mRecords;
+    uint32_t mTTL;
+    int mSocket;
+    uint16_t mPort = 0;
+    std::atomic<bool> mRun{true};
+    std::thread mThread;
+};
+} // namespace
+
+// Cached for the TTL, failures for the negative TTL, lookups in flight coalesced, URLs of names and literals
+TEST(TestRistResolver, CacheAndCoalescing) {
+    RISTNetResolver resolver;
+    std::atomic<int> lookups{0};
+    std::mutex gateMtx;
+    std::unique_lock<std::mutex> gate(gateMtx);
+    resolver.lookupCallback = [&](const std::string &rHost, std::vector<std::string> &rAddresses,
+                                  std::chrono::seconds &rTTL, std::string &rError) {
+        lookups++;
+        std::lock_guard<std::mutex> lLock(gateMtx);
+        if (rHost == "missing.test") {
+            rError = "Host not found.";
+            return false;
+        }
+        rAddresses = rHost == "v6.test" ? std::vector<std::string>{"2001:db8::1"}
+                                        : std::vector<std::string>{"10.0.0.1", "10.0.0.2"};
+        rTTL = std::chrono::seconds(1);
+        return true;
+    };
+    RISTNetResolver::RISTNetResolverSettings settings;
+    settings.mMinTTL = std::chrono::seconds(0);
+    settings.mNegativeTTL = std::chrono::seconds(30);
+    ASSERT_TRUE(resolver.initResolver(settings));
+
+    // Three asks while the lookup is held, one lookup
+    std::atomic<int> answered{0};
+    for (int i = 0; i < 3; i++) {
+        std::string host = i ? "Host.Test" : "host.test";
+        bool queued = resolver.resolve(host, [&](const RISTNetResolver::Resolution &rResolution) {
+            EXPECT_EQ(rResolution.mAddresses, (std::vector<std::string>{"10.0.0.1", "10.0.0.2"}));
+            EXPECT_FALSE(rResolution.mCached);
+            answered++;
+        });
+        ASSERT_TRUE(queued);
+    }
+    gate.unlock();
+    while (answered < 3) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(lookups, 1);
+
+    RISTNetResolver::Resolution resolution;
+    EXPECT_TRUE(resolver.resolveBlocking("host.test", resolution));
+    EXPECT_TRUE(resolution.mCached);
+    EXPECT_EQ(resolution.mTTL, std::chrono::seconds(1));
+    EXPECT_FALSE(resolver.resolveBlocking("missing.test", resolution));
+    EXPECT_EQ(resolution.mError, "Host not found.");
+    EXPECT_FALSE(resolver.resolveBlocking("missing.test", resolution));
+    EXPECT_TRUE(resolution.mCached);
+    EXPECT_EQ(lookups, 2);
+    EXPECT_FALSE(resolver.resolve("not a host", [](const RISTNetResolver::Resolution &rResolution) {}));
+
+    // Expired after the TTL
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    EXPECT_TRUE(resolver.resolveBlocking("host.test", resolution));
+    EXPECT_FALSE(resolution.mCached);
+    EXPECT_EQ(lookups, 3);
+
+    std::vector<std::string> urls;
+    EXPECT_TRUE(RISTNetTools::buildRISTURLs({{"host.test", "8000"}, {"v6.test", "8001"}, {"10.0.0.9", "8002"}},
+                                            urls, false, &resolver));
+    EXPECT_EQ(urls, (std::vector<std::string>{"rist://10.0.0.1:8000", "rist6://[2001:db8::1]:8001",
+                                              "rist://10.0.0.9:8002"}));
+    EXPECT_FALSE(RISTNetTools::buildRISTURLs({{"host.test", "8000"}, {"missing.test", "8001"}}, urls, false,
+                                             &resolver));
+    EXPECT_TRUE(urls.empty());
+
+    RISTNetResolver::ResolverStatistics statistics;
+    resolver.getStatistics(statistics);
+    EXPECT_EQ(statistics.mQueries, 4);
+    EXPECT_EQ(statistics.mCoalesced, 2);
+    EXPECT_EQ(statistics.mFailures, 1);
+    EXPECT_EQ(statistics.mCacheEntries, 3);
+
+    // From the cache, no query
+    std::string url;
+    EXPECT_TRUE(RISTNetTools::resolveRISTURL("v6.test", "8001", url, true, &resolver));
+    EXPECT_EQ(url, "rist6://@[2001:db8::1]:8001");
+    EXPECT_FALSE(RISTNetTools::resolveRISTURL("not a host", "8001", url, true, &resolver));
+    resolver.getStatistics(statistics);
+    EXPECT_EQ(statistics.mQueries, 4);
+    EXPECT_TRUE(resolver.destroyResolver());
+}
+
+// Queried directly, the TTL of the answer, the next name server when one does not answer
+TEST(TestRistResolver, NameServer) {
+    StubNameServer server({{"peer.example", {"10.1.2.3", "2001:db8::7"}}, {"v4.example", {"10.1.2.4"}}}, 30);
+
+    // A closed port first
+    int closed = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(closed, (sockaddr *) &address, sizeof(address));
+    socklen_t size = sizeof(address);
+    getsockname(closed, (sockaddr *) &address, &size);
+    close(closed);
+
+    RISTNetResolver resolver;
+    RISTNetResolver::RISTNetResolverSettings settings;
+    settings.mNameServers = {"127.0.0.1:" + std::to_string(ntohs(address.sin_port)), server.address()};
+    settings.mQueryTimeout = std::chrono::milliseconds(500);
+    ASSERT_TRUE(resolver.initResolver(settings));
+
+    RISTNetResolver::Resolution resolution;
+    ASSERT_TRUE(resolver.resolveBlocking("peer.example", resolution));
+    EXPECT_EQ(resolution.mAddresses, (std::vector<std::string>{"10.1.2.3", "2001:db8::7"}));
+    EXPECT_EQ(resolution.mTTL, std::chrono::seconds(30));
+    ASSERT_TRUE(resolver.resolveBlocking("v4.example.", resolution));
+    EXPECT_EQ(resolution.mAddresses, (std::vector<std::string>{"10.1.2.4"}));
+    EXPECT_FALSE(resolver.resolveBlocking("other.example", resolution));
+    EXPECT_EQ(resolution.mError, "Host not found.");
+    EXPECT_EQ(server.mQueries, 6);
+    EXPECT_TRUE(resolver.destroyResolver());
+
+    settings.mNameServers = {"[::1]:53", "127.0.0.1:5353", "::1"};
+    EXPECT_TRUE(resolver.initResolver(settings));
+    EXPECT_TRUE(resolver.destroyResolver());
+    settings.mNameServers = {"127.0.0.1:0"};
+    EXPECT_FALSE(resolver.initResolver(settings));
+    settings.mNameServers = {"name.server"};
+    EXPECT_FALSE(resolver.initResolver(settings));
+}
+
+// A watched name changing address, the sender peer replaced
+TEST(TestRistResolver, WatchUpdatesPeers) {
+    RISTNetResolver resolver;
+    std::mutex addressMtx;
+    std::string current = "10.0.0.1";
+    resolver.lookupCallback = [&](const std::string &rHost, std::vector<std::string> &rAddresses,
+                                  std::chrono::seconds &rTTL, std::string &rError) {
+        std::lock_guard<std::mutex> lLock(addressMtx);
+        rAddresses = {current};
+        rTTL = std::chrono::seconds(1);
+        return true;
+    };
+    RISTNetResolver::RISTNetResolverSettings settings;
+    ASSERT_TRUE(resolver.initResolver(settings));
+
+    RISTNetSender sender;
+    RISTNetMockTransport mock;
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    ASSERT_TRUE(mock.attachSender(sender, senderSettings));
+
+    std::mutex changesMtx;
+    std::condition_variable changed;
+    int changes = 0;
+    uint64_t watchID = resolver.watch("edge.test", [&](const RISTNetResolver::Resolution &rResolution,
+                                                       const std::vector<std::string> &rPrevious) {
+        std::string url;
+        ASSERT_TRUE(RISTNetTools::buildRISTURL(rResolution.mAddresses.front(), "8000", url, false));
+        EXPECT_TRUE(sender.addPeer(url, 5));
+        for (auto &rAddress: rPrevious) {
+            EXPECT_TRUE(sender.removePeer("rist://" + rAddress + ":8000"));
+        }
+        std::lock_guard<std::mutex> lLock(changesMtx);
+        changes++;
+        changed.notify_one();
+    });
+    ASSERT_NE(watchID, 0);
+    {
+        std::unique_lock<std::mutex> lLock(changesMtx);
+        ASSERT_TRUE(changed.wait_for(lLock, std::chrono::seconds(5), [&] { return changes == 1; }));
+    }
+    std::vector<std::string> urls;
+    mock.getPeerURLs(urls);
+    EXPECT_EQ(urls, (std::vector<std::string>{"rist://10.0.0.1:8000"}));
+    EXPECT_FALSE(sender.addPeer("rist://10.0.0.1:8000", 5));
+
+    {
+        std::lock_guard<std::mutex> lLock(addressMtx);
+        current = "10.0.0.2";
+    }
+    {
+        std::unique_lock<std::mutex> lLock(changesMtx);
+        ASSERT_TRUE(changed.wait_for(lLock, std::chrono::seconds(5), [&] { return changes == 2; }));
+    }
+    mock.getPeerURLs(urls);
+    EXPECT_EQ(urls, (std::vector<std::string>{"rist://10.0.0.2:8000"}));
+    EXPECT_TRUE(resolver.unwatch(watchID));
+    EXPECT_FALSE(resolver.unwatch(watchID));
+
+    RISTNetResolver::ResolverStatistics statistics;
+    resolver.getStatistics(statistics);
+    EXPECT_EQ(statistics.mChanges, 1);
+    EXPECT_EQ(statistics.mWatches, 0);
+    RISTNetMockTransport::MockTransportStatistics mockStatistics;
+    mock.getStatistics(mockStatistics);
+    EXPECT_EQ(mockStatistics.mPeersCreated, 2);
+    EXPECT_EQ(mockStatistics.mPeersClosed, 1);
+    EXPECT_FALSE(sender.removePeer("rist://10.0.0.1:8000"));
+    EXPECT_TRUE(sender.destroySender());
+}
@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+
+#include "RISTNetMockTransport.h"
+#include "RISTNetSessionManager.h"
+#include <thread>
+
+namespace {
+// The receivers of the manager driven by mock transports, one per channel
+struct MockChannels {
+    void attach(RISTNetSessionManager &rManager) {
+        rManager.initCallback = [this](uint32_t lChannelID, RISTNetReceiver &rReceiver, std::vector<std::string> &rURLList,
+                                       RISTNetReceiver::RISTNetReceiverSettings &rSettings) {
+            std::lock_guard<std::mutex> lLock(mMtx);
+            auto &rTransport = mTransports[lChannelID];
+            rTransport = std::make_unique<RISTNetMockTransport>();
+            return rTransport->attachReceiver(rReceiver, rSettings);
+        };
+    }
+
+    RISTNetMockTransport &operator[](uint32_t lChannelID) {
+        std::lock_guard<std::mutex> lLock(mMtx);
+        return *mTransports[lChannelID];
+    }
+
+    std::mutex mMtx;
+    std::map<uint32_t, std::unique_ptr<RISTNetMockTransport>> mTransports;
+};
+} // namespace
+
+// Thousands of channels configured, a receiver only for the channel used, reaped when idle and created again
+TEST(TestRistSessionManager, LazyCreateAndReap) {
+    RISTNetSessionManager manager;
+    MockChannels mocks;
+    mocks.attach(manager);
+    RISTNetSessionManager::RISTNetSessionManagerSettings settings;
+    settings.mIdleTimeout = std::chrono::seconds(1);
+    settings.mReapInterval = std::chrono::milliseconds(0);
+    ASSERT_TRUE(manager.initSessionManager(settings));
+    for (uint32_t i = 0; i < 5000; i++) {
+        ASSERT_TRUE(manager.addChannel(i, {"rist://@0.0.0.0:" + std::to_string(10000 + i)}));
+    }
+    EXPECT_FALSE(manager.addChannel(7, {"rist://@0.0.0.0:9999"}));
+
+    std::vector<std::pair<uint32_t, size_t>> received;
+    manager.channelDataCallback = [&](uint32_t lChannelID, const uint8_t *pBuf, size_t lSize,
+                                      std::shared_ptr<RISTNetReceiver::NetworkConnection> &rConnection,
+                                      rist_peer *pPeer, uint16_t lConnectionID) {
+        received.emplace_back(lChannelID, lSize);
+        return 0;
+    };
+    manager.validateConnectionCallback = [](uint32_t lChannelID, std::string lIPAddress, uint16_t lPort) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    std::vector<RISTNetSessionManager::ChannelStatistics> batch;
+    manager.statisticsCallback = [&](const std::vector<RISTNetSessionManager::ChannelStatistics> &rStatistics) {
+        batch = rStatistics;
+    };
+
+    EXPECT_FALSE(manager.isActive(7));
+    ASSERT_TRUE(manager.activateChannel(7));
+    EXPECT_TRUE(manager.isActive(7));
+    EXPECT_TRUE(manager.activateChannel(7));
+    RISTNetSessionManager::SessionManagerStatistics statistics;
+    manager.getStatistics(statistics);
+    EXPECT_EQ(statistics.mChannels, 5000);
+    EXPECT_EQ(statistics.mActive, 1);
+    EXPECT_EQ(statistics.mCreated, 1);
+
+    rist_peer *peer = mocks[7].connectPeer("10.0.0.1", 1234);
+    ASSERT_NE(peer, nullptr);
+    std::vector<uint8_t> packet(1316);
+    EXPECT_EQ(mocks[7].injectData(peer, packet.data(), packet.size()), 0);
+    rist_stats flow{};
+    flow.stats_type = RIST_STATS_RECEIVER_FLOW;
+    flow.stats.receiver_flow.flow_id = 7;
+    EXPECT_EQ(mocks[7].injectStatistics(flow), 0);
+    EXPECT_EQ(received, (std::vector<std::pair<uint32_t, size_t>>{{7, 1316}}));
+
+    RISTNetSessionManager::SessionCost cost;
+    ASSERT_TRUE(manager.getSessionCost(7, cost));
+    EXPECT_TRUE(cost.mActive);
+    EXPECT_EQ(cost.mPeers, 1);
+    EXPECT_EQ(cost.mPackets, 1);
+    EXPECT_EQ(cost.mBytes, 1316);
+    EXPECT_EQ(cost.mCreations, 1);
+    EXPECT_GT(cost.mRecoveryBytes, 0);
+    ASSERT_TRUE(manager.getSessionCost(8, cost));
+    EXPECT_FALSE(cost.mActive);
+    EXPECT_EQ(cost.mRecoveryBytes, 0);
+    EXPECT_FALSE(manager.getSessionCost(5000, cost));
+
+    // The data counts as a use, the statistics come in one batch
+    auto now = std::chrono::steady_clock::now();
+    manager.reapIdle(now);
+    ASSERT_EQ(batch.size(), 1);
+    EXPECT_EQ(batch[0].mChannelID, 7);
+    EXPECT_EQ(batch[0].mStatistics.stats.receiver_flow.flow_id, 7);
+    manager.reapIdle(now + std::chrono::milliseconds(900));
+    EXPECT_TRUE(manager.isActive(7));
+    manager.reapIdle(now + std::chrono::milliseconds(1100));
+    EXPECT_FALSE(manager.isActive(7));
+
+    // Created again on the next use, the counters kept
+    ASSERT_TRUE(manager.activateChannel(7));
+    ASSERT_TRUE(manager.getSessionCost(7, cost));
+    EXPECT_EQ(cost.mCreations, 2);
+    EXPECT_EQ(cost.mPackets, 1);
+    std::vector<RISTNetSessionManager::SessionCost> costs;
+    manager.getSessionCosts(costs);
+    EXPECT_EQ(costs.size(), 5000);
+    manager.getStatistics(statistics);
+    EXPECT_EQ(statistics.mCreated, 2);
+    EXPECT_EQ(statistics.mReaped, 1);
+    EXPECT_EQ(statistics.mStatisticsBatches, 1);
+    EXPECT_TRUE(manager.destroySessionManager());
+}
+
+// The reaper thread, removing active channels and failed creations
+TEST(TestRistSessionManager, ReaperAndRemove) {
+    RISTNetSessionManager manager;
+    MockChannels mocks;
+    mocks.attach(manager);
+    RISTNetSessionManager::RISTNetSessionManagerSettings settings;
+    settings.mIdleTimeout = std::chrono::milliseconds(50);
+    settings.mReapInterval = std::chrono::milliseconds(10);
+    ASSERT_TRUE(manager.initSessionManager(settings));
+    for (uint32_t i = 0; i < 4; i++) {
+        ASSERT_TRUE(manager.addChannel(i, {"rist://@0.0.0.0:" + std::to_string(10000 + i)}));
+    }
+    EXPECT_FALSE(manager.activateChannel(4));
+    ASSERT_TRUE(manager.activateChannel(0));
+    ASSERT_TRUE(manager.activateChannel(1));
+    ASSERT_TRUE(manager.activateChannel(2));
+
+    // Connections rejected without validateConnectionCallback
+    EXPECT_EQ(mocks[2].connectPeer("10.0.0.1", 1234), nullptr);
+
+    EXPECT_TRUE(manager.removeChannel(1));
+    EXPECT_FALSE(manager.isActive(1));
+    EXPECT_FALSE(manager.removeChannel(1));
+    EXPECT_TRUE(manager.deactivateChannel(2));
+    EXPECT_FALSE(manager.deactivateChannel(2));
+
+    // Channel 0 kept in use, channel 3 never created
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(300);
+    while (std::chrono::steady_clock::now() < deadline) {
+        EXPECT_TRUE(manager.activateChannel(0));
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_TRUE(manager.isActive(0));
+    deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (manager.isActive(0) && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_FALSE(manager.isActive(0));
+
+    manager.initCallback = [](uint32_t lChannelID, RISTNetReceiver &rReceiver, std::vector<std::string> &rURLList,
+                              RISTNetReceiver::RISTNetReceiverSettings &rSettings) { return false; };
+    EXPECT_FALSE(manager.activateChannel(3));
+    RISTNetSessionManager::SessionManagerStatistics statistics;
+    manager.getStatistics(statistics);
+    EXPECT_EQ(statistics.mChannels, 3);
+    EXPECT_EQ(statistics.mActive, 0);
+    EXPECT_EQ(statistics.mCreated, 3);
+    EXPECT_EQ(statistics.mReaped, 1);
+    EXPECT_EQ(statistics.mCreateFailures, 1);
+}
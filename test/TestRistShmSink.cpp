@@ -0,0 +1,218 @@
+#include <thread>
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "RISTNetMockTransport.h"
+#include "RISTNetShmSink.h"
+
+namespace {
+// Of the test process, also in a forked child
+const std::string& ringName() {
+    static const std::string name = "/ristnet_test_" + std::to_string(getpid());
+    return name;
+}
+
+std::vector<uint8_t> makePacket(uint32_t index, size_t size = 188) {
+    std::vector<uint8_t> packet(size);
+    for (size_t i = 0; i < packet.size(); i++) {
+        packet[i] = (index + i) & 0xff;
+    }
+    return packet;
+}
+
+bool openReader(RISTNetShmReader& reader, bool fromOldest = false) {
+    RISTNetShmReader::RISTNetShmReaderSettings settings;
+    settings.mName = ringName();
+    settings.mFromOldest = fromOldest;
+    return reader.openReader(settings);
+}
+} // namespace
+
+TEST(TestRistShmSink, PublishAndRead) {
+    RISTNetShmSink sink;
+    RISTNetShmSink::RISTNetShmSinkSettings settings;
+    settings.mName = ringName();
+    settings.mSlots = 100;
+    EXPECT_FALSE(sink.initShmSink(settings));
+    settings.mSlots = 64;
+    settings.mSlotSize = 1316;
+    ASSERT_TRUE(sink.initShmSink(settings));
+
+    RISTNetReceiver receiver;
+    receiver.validateConnectionCallback = [](const std::string& ipAddress, uint16_t port) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    RISTNetMockTransport transport;
+    RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+    ASSERT_TRUE(transport.attachReceiver(receiver, receiverSettings));
+    ASSERT_TRUE(sink.attachReceiver(receiver));
+    rist_peer* peer = transport.connectPeer("10.0.0.1", 1234);
+    ASSERT_NE(peer, nullptr);
+
+    // Every reader gets every packet, with its own cursor
+    RISTNetShmReader readers[2];
+    ASSERT_TRUE(openReader(readers[0]));
+    ASSERT_TRUE(openReader(readers[1]));
+    EXPECT_EQ(readers[0].getSlotSize(), 1316u);
+    for (uint32_t i = 0; i < 40; i++) {
+        auto packet = makePacket(i);
+        EXPECT_EQ(transport.injectData(peer, packet.data(), packet.size(), 5), 0);
+    }
+    std::vector<uint8_t> buffer(readers[0].getSlotSize());
+    uint16_t connectionID = 0;
+    for (auto& reader : readers) {
+        for (uint32_t i = 0; i < 40; i++) {
+            ASSERT_EQ(reader.readPacket(buffer.data(), buffer.size(), connectionID), 188);
+            EXPECT_EQ(connectionID, 5);
+            EXPECT_EQ(std::vector<uint8_t>(buffer.begin(), buffer.begin() + 188), makePacket(i));
+        }
+        EXPECT_EQ(reader.readPacket(buffer.data(), buffer.size(), connectionID), 0);
+    }
+
+    // A late reader from the oldest packets in the ring
+    RISTNetShmReader late;
+    ASSERT_TRUE(openReader(late, true));
+    ASSERT_EQ(late.readPacket(buffer.data(), buffer.size(), connectionID), 188);
+    EXPECT_EQ(std::vector<uint8_t>(buffer.begin(), buffer.begin() + 188), makePacket(0));
+    late.closeReader();
+
+    // A waiting reader is woken by the producer
+    std::thread waiter([&] {
+        std::vector<uint8_t> waitBuffer(1316);
+        uint16_t waitConnectionID = 0;
+        EXPECT_EQ(readers[0].readPacket(waitBuffer.data(), waitBuffer.size(), waitConnectionID,
+                                        std::chrono::milliseconds(5000)), 1316);
+        EXPECT_EQ(waitConnectionID, 9);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto packet = makePacket(40, 1316);
+    EXPECT_TRUE(sink.writeData(packet.data(), packet.size(), 9));
+    waiter.join();
+
+    packet = makePacket(41, 1317);
+    EXPECT_FALSE(sink.writeData(packet.data(), packet.size()));
+    std::vector<RISTNetShmSink::ConsumerStatistics> consumers;
+    sink.getConsumers(consumers);
+    ASSERT_EQ(consumers.size(), 2u);
+    EXPECT_EQ(consumers[0].mPid, getpid());
+    EXPECT_EQ(consumers[0].mRead, 41u);
+    EXPECT_EQ(consumers[0].mLag, 0u);
+    EXPECT_EQ(consumers[1].mLag, 1u);
+
+    readers[1].closeReader();
+    RISTNetShmSink::ShmSinkStatistics statistics;
+    sink.getStatistics(statistics);
+    EXPECT_EQ(statistics.mPackets, 41u);
+    EXPECT_EQ(statistics.mBytes, 40u * 188 + 1316);
+    EXPECT_EQ(statistics.mTooLarge, 1u);
+    EXPECT_EQ(statistics.mConsumers, 1u);
+    transport.detach();
+    EXPECT_TRUE(sink.destroyShmSink());
+}
+
+TEST(TestRistShmSink, LappingAndSlowConsumers) {
+    RISTNetShmSink sink;
+    RISTNetShmSink::RISTNetShmSinkSettings settings;
+    settings.mName = ringName();
+    settings.mSlots = 16;
+    settings.mSlotSize = 188;
+    settings.mScanInterval = 1;
+    std::vector<RISTNetShmSink::ConsumerStatistics> slow;
+    sink.slowConsumerCallback = [&](const RISTNetShmSink::ConsumerStatistics& consumer) {
+        slow.push_back(consumer);
+    };
+    ASSERT_TRUE(sink.initShmSink(settings));
+
+    RISTNetShmReader reader;
+    ASSERT_TRUE(openReader(reader));
+    for (uint32_t i = 0; i < 40; i++) {
+        auto packet = makePacket(i);
+        ASSERT_TRUE(sink.writeData(packet.data(), packet.size()));
+    }
+    // Reported once when it passed half the ring, the producer went on
+    ASSERT_EQ(slow.size(), 1u);
+    EXPECT_EQ(slow[0].mLag, 9u);
+    EXPECT_TRUE(slow[0].mSlow);
+
+    // Lapped, resumes half a ring behind the producer
+    std::vector<uint8_t> buffer(188);
+    uint16_t connectionID = 0;
+    for (uint32_t i = 32; i < 40; i++) {
+        ASSERT_EQ(reader.readPacket(buffer.data(), buffer.size(), connectionID), 188);
+        EXPECT_EQ(buffer, makePacket(i));
+    }
+    EXPECT_EQ(reader.readPacket(buffer.data(), buffer.size(), connectionID), 0);
+    RISTNetShmReader::ShmReaderStatistics readerStatistics;
+    reader.getStatistics(readerStatistics);
+    EXPECT_EQ(readerStatistics.mRead, 8u);
+    EXPECT_EQ(readerStatistics.mLapped, 32u);
+    EXPECT_EQ(readerStatistics.mLag, 0u);
+
+    // Caught up, slow again once it falls behind again
+    for (uint32_t i = 40; i < 52; i++) {
+        auto packet = makePacket(i);
+        ASSERT_TRUE(sink.writeData(packet.data(), packet.size()));
+    }
+    EXPECT_EQ(slow.size(), 2u);
+
+    // A consumer process gone without closeReader is released
+    pid_t child = fork();
+    if (!child) {
+        RISTNetShmReader childReader;
+        _exit(openReader(childReader) ? 0 : 1);
+    }
+    int status = 0;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    std::vector<RISTNetShmSink::ConsumerStatistics> consumers;
+    sink.getConsumers(consumers);
+    EXPECT_EQ(consumers.size(), 2u);
+    auto packet = makePacket(52);
+    ASSERT_TRUE(sink.writeData(packet.data(), packet.size()));
+    sink.getConsumers(consumers);
+    ASSERT_EQ(consumers.size(), 1u);
+    EXPECT_EQ(consumers[0].mPid, getpid());
+
+    // Also a consumer process gone between claiming a slot and making it active
+    child = fork();
+    if (!child) {
+        int fd = shm_open(ringName().c_str(), O_RDWR, 0);
+        void* memory = mmap(nullptr, sizeof(RISTNetShmRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        auto* ring = static_cast<RISTNetShmRing*>(memory);
+        uint64_t free = RISTNetShmRing::owner(RISTNetShmRing::kFree, 0);
+        _exit(ring->mConsumers[1].mOwner.compare_exchange_strong(
+                free, RISTNetShmRing::owner(RISTNetShmRing::kClaimed, getpid())) ? 0 : 1);
+    }
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    packet = makePacket(53);
+    ASSERT_TRUE(sink.writeData(packet.data(), packet.size()));
+    RISTNetShmReader third;
+    ASSERT_TRUE(openReader(third));
+    sink.getConsumers(consumers);
+    ASSERT_EQ(consumers.size(), 2u);
+    EXPECT_EQ(consumers[1].mIndex, 1u);
+    EXPECT_TRUE(third.closeReader());
+
+    RISTNetShmSink::ShmSinkStatistics statistics;
+    sink.getStatistics(statistics);
+    EXPECT_EQ(statistics.mSlowEvents, 2u);
+    EXPECT_EQ(statistics.mReclaimed, 2u);
+
+    // What was published is read after destroy, then -1
+    EXPECT_TRUE(sink.destroyShmSink());
+    size_t remaining = 0;
+    int size;
+    while ((size = reader.readPacket(buffer.data(), buffer.size(), connectionID,
+                                     std::chrono::milliseconds(1000))) > 0) {
+        remaining++;
+    }
+    EXPECT_EQ(size, -1);
+    EXPECT_EQ(remaining, 14u);
+    RISTNetShmReader another;
+    EXPECT_FALSE(openReader(another));
+}
@@ -0,0 +1,191 @@
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <csignal>
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "RISTNetTrace.h"
+
+namespace {
+std::string tracePath(const std::string& name) {
+    return "/tmp/TestRistTrace_" + std::to_string(getpid()) + "_" + name + ".rtrc";
+}
+
+// Records count packets of 100 + i bytes filled with i, every gapMs milliseconds
+void record(RISTNetTraceRecorder& recorder, int count, int gapMs) {
+    std::vector<uint8_t> payload;
+    for (int i = 0; i < count; i++) {
+        payload.assign(100 + i, (uint8_t)i);
+        rist_data_block block{};
+        block.payload = payload.data();
+        block.payload_len = payload.size();
+        block.flow_id = 1000 + (i % 2);
+        block.seq = i;
+        block.peer = (rist_peer*)(uintptr_t)0x1234;
+        block.flags = i == 3 ? RIST_DATA_FLAGS_DISCONTINUITY : 0;
+        EXPECT_TRUE(recorder.recordPacket(block));
+        if (gapMs) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(gapMs));
+        }
+    }
+}
+} // namespace
+
+TEST(TestRistTrace, RecordAndReplayAll) {
+    auto path = tracePath("all");
+    RISTNetTraceRecorder recorder;
+    RISTNetTraceRecorder::RISTNetTraceRecorderSettings recorderSettings;
+    recorderSettings.mPath = path;
+    recorderSettings.mRingSize = 64 * 1024; // Wraps many times
+    recorderSettings.mIndexInterval = 4096;
+    ASSERT_TRUE(recorder.initRecorder(recorderSettings));
+    for (int round = 0; round < 10; round++) {
+        record(recorder, 200, 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(30)); // Let the flush thread catch up
+    }
+    ASSERT_TRUE(recorder.destroyRecorder());
+    RISTNetTraceRecorder::TraceRecorderStatistics recorderStatistics;
+    recorder.getStatistics(recorderStatistics);
+    EXPECT_EQ(recorderStatistics.mPackets + recorderStatistics.mDroppedPackets, 2000);
+
+    RISTNetTracePlayer player;
+    RISTNetTracePlayer::RISTNetTracePlayerSettings playerSettings;
+    ASSERT_TRUE(player.openTrace(path, playerSettings));
+    EXPECT_EQ(player.getPackets(), recorderStatistics.mPackets);
+    EXPECT_GT(player.getHeader().mStartTime, 0);
+
+    uint64_t lastTime = 0;
+    uint64_t packets = 0;
+    player.packetCallback = [&](const RISTNetTraceRecord& rRecord, const uint8_t* pPayload) {
+        int i = rRecord.mSeq;
+        EXPECT_EQ(rRecord.mPayloadSize, 100 + i);
+        EXPECT_EQ(pPayload[0], (uint8_t)i);
+        EXPECT_EQ(pPayload[rRecord.mPayloadSize - 1], (uint8_t)i);
+        EXPECT_EQ(rRecord.mFlowID, 1000 + (i % 2));
+        EXPECT_EQ(rRecord.mPeer, 0x1234);
+        EXPECT_EQ(rRecord.mFlags, i == 3 ? RIST_DATA_FLAGS_DISCONTINUITY : 0);
+        EXPECT_GE(rRecord.mTime, lastTime);
+        lastTime = rRecord.mTime;
+        packets++;
+        return 0;
+    };
+    EXPECT_EQ(player.replayAll(), recorderStatistics.mPackets);
+    EXPECT_EQ(packets, recorderStatistics.mPackets);
+    EXPECT_EQ(player.getDuration().count(), lastTime);
+    player.closeTrace();
+    unlink(path.c_str());
+}
+
+TEST(TestRistTrace, SeekAndUnclosedTrace) {
+    auto path = tracePath("seek");
+    RISTNetTraceRecorder recorder;
+    RISTNetTraceRecorder::RISTNetTraceRecorderSettings recorderSettings;
+    recorderSettings.mPath = path;
+    recorderSettings.mIndexInterval = 1024;
+    ASSERT_TRUE(recorder.initRecorder(recorderSettings));
+    record(recorder, 50, 1);
+    ASSERT_TRUE(recorder.destroyRecorder());
+
+    // Cut off the index and the trailer as if the recorder was killed, the index is rebuilt
+    for (bool cut : {false, true}) {
+        if (cut) {
+            struct stat fileStat{};
+            ASSERT_EQ(stat(path.c_str(), &fileStat), 0);
+            ASSERT_EQ(truncate(path.c_str(), fileStat.st_size - 20), 0);
+        }
+        RISTNetTracePlayer player;
+        RISTNetTracePlayer::RISTNetTracePlayerSettings playerSettings;
+        ASSERT_TRUE(player.openTrace(path, playerSettings));
+        EXPECT_EQ(player.getPackets(), 50);
+
+        // Find the time of packet 30 and seek to it
+        std::vector<uint64_t> times;
+        player.packetCallback = [&](const RISTNetTraceRecord& rRecord, const uint8_t* pPayload) {
+            times.push_back(rRecord.mTime);
+            return 0;
+        };
+        ASSERT_EQ(player.replayAll(), 50);
+        ASSERT_TRUE(player.seek(std::chrono::nanoseconds(times[30])));
+        std::vector<uint64_t> seqs;
+        player.packetCallback = [&](const RISTNetTraceRecord& rRecord, const uint8_t* pPayload) {
+            seqs.push_back(rRecord.mSeq);
+            return 0;
+        };
+        EXPECT_EQ(player.replayAll(), 20);
+        ASSERT_FALSE(seqs.empty());
+        EXPECT_EQ(seqs[0], 30);
+        EXPECT_FALSE(player.seek(player.getDuration() + std::chrono::seconds(1)));
+    }
+    unlink(path.c_str());
+}
+
+// A write error (the file size limit) stops the recording, no index is written after it
+TEST(TestRistTrace, WriteError) {
+    auto path = tracePath("error");
+    RISTNetTraceRecorder recorder;
+    RISTNetTraceRecorder::RISTNetTraceRecorderSettings recorderSettings;
+    recorderSettings.mPath = path;
+    recorderSettings.mIndexInterval = 1024;
+    ASSERT_TRUE(recorder.initRecorder(recorderSettings));
+
+    rlimit limit{};
+    ASSERT_EQ(getrlimit(RLIMIT_FSIZE, &limit), 0);
+    rlimit small = limit;
+    small.rlim_cur = 4096;
+    auto previousHandler = signal(SIGXFSZ, SIG_IGN);
+    ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &small), 0);
+    record(recorder, 50, 0);
+    EXPECT_FALSE(recorder.destroyRecorder());
+    setrlimit(RLIMIT_FSIZE, &limit);
+    signal(SIGXFSZ, previousHandler);
+
+    RISTNetTraceRecorder::TraceRecorderStatistics statistics;
+    recorder.getStatistics(statistics);
+    EXPECT_EQ(statistics.mPackets, 50);
+    EXPECT_EQ(statistics.mWriteErrors, 1);
+    struct stat fileStat{};
+    ASSERT_EQ(stat(path.c_str(), &fileStat), 0);
+    EXPECT_EQ(fileStat.st_size, 4096);
+    unlink(path.c_str());
+}
+
+TEST(TestRistTrace, ReplayTiming) {
+    auto path = tracePath("timing");
+    RISTNetTraceRecorder recorder;
+    RISTNetTraceRecorder::RISTNetTraceRecorderSettings recorderSettings;
+    recorderSettings.mPath = path;
+    ASSERT_TRUE(recorder.initRecorder(recorderSettings));
+    record(recorder, 21, 10);
+    ASSERT_TRUE(recorder.destroyRecorder());
+
+    RISTNetTracePlayer player;
+    RISTNetTracePlayer::RISTNetTracePlayerSettings playerSettings;
+    playerSettings.mSpeed = 2.0;
+    ASSERT_TRUE(player.openTrace(path, playerSettings));
+    std::atomic<uint64_t> packets{0};
+    player.packetCallback = [&](const RISTNetTraceRecord& rRecord, const uint8_t* pPayload) {
+        packets++;
+        return 0;
+    };
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(player.startReplay());
+    while (player.isReplaying() && std::chrono::steady_clock::now() - start < std::chrono::seconds(5)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    player.stopReplay();
+    EXPECT_EQ(packets, 21);
+    // About 200 ms recorded, replayed twice as fast
+    auto expected = player.getDuration() / 2;
+    EXPECT_GE(elapsed, expected - std::chrono::milliseconds(5));
+    EXPECT_LT(elapsed, expected + std::chrono::milliseconds(200));
+    RISTNetTracePlayer::TracePlayerStatistics statistics;
+    player.getStatistics(statistics);
+    EXPECT_EQ(statistics.mPacketsSent, 21);
+    player.closeTrace();
+    unlink(path.c_str());
+}
@@ -0,0 +1,205 @@
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "RISTNetMockTransport.h"
+
+namespace {
+void writePacket(uint8_t* pPacket, uint16_t pid, uint8_t header3, uint8_t fill) {
+    pPacket[0] = 0x47;
+    pPacket[1] = (pid >> 8) & 0x1f;
+    pPacket[2] = pid & 0xff;
+    pPacket[3] = header3;
+    memset(pPacket + 4, fill, 184);
+}
+
+// 7 packets per payload, about 30% nulls, some of them not restorable bit exact and kept
+std::vector<std::vector<uint8_t>> makeCbrStream(size_t payloads) {
+    std::mt19937 random(42);
+    std::vector<std::vector<uint8_t>> stream;
+    uint8_t cc = 0;
+    for (size_t p = 0; p < payloads; p++) {
+        std::vector<uint8_t> payload(7 * 188);
+        for (size_t i = 0; i < 7; i++) {
+            uint8_t* pPacket = payload.data() + i * 188;
+            uint32_t kind = random() % 20;
+            if (kind < 5) {
+                writePacket(pPacket, 0x1FFF, 0x10, 0xff);
+            } else if (kind == 5) {
+                writePacket(pPacket, 0x1FFF, 0x10, 0xff);
+                pPacket[100] = 0x00; // Payload not one fill byte
+            } else if (kind == 6) {
+                writePacket(pPacket, 0x1FFF, 0x10, 0xff);
+                pPacket[1] |= 0x40; // Payload unit start indicator set
+            } else {
+                writePacket(pPacket, 0x100 + kind % 3, 0x10 | (cc++ & 0x0f), 0);
+                for (size_t j = 4; j < 188; j++) {
+                    pPacket[j] = random();
+                }
+            }
+        }
+        stream.push_back(std::move(payload));
+    }
+    return stream;
+}
+} // namespace
+
+TEST(TestRistTsOptimizer, RoundTripBitExact) {
+    RISTNetTsOptimizer optimizer;
+    RISTNetTsOptimizer::RISTNetTsOptimizerSettings settings;
+    ASSERT_TRUE(optimizer.initOptimizer(settings));
+    auto stream = makeCbrStream(1000);
+    size_t bytesIn = 0;
+    size_t bytesSent = 0;
+    std::vector<uint8_t> optimized;
+    std::vector<uint8_t> restored;
+    for (auto& payload: stream) {
+        bytesIn += payload.size();
+        bool deleted = optimizer.optimize(payload.data(), payload.size(), optimized);
+        bytesSent += optimized.size();
+        ASSERT_EQ(optimized[0], RISTNetTsOptimizer::kTsOptimizedMarker);
+        EXPECT_EQ(optimized[1] != 0, deleted);
+        ASSERT_TRUE(optimizer.restore(optimized.data(), optimized.size(), restored));
+        ASSERT_EQ(restored, payload);
+    }
+    RISTNetTsOptimizer::TsOptimizerStatistics statistics;
+    optimizer.getStatistics(statistics);
+    EXPECT_EQ(statistics.mBytesIn, bytesIn);
+    EXPECT_EQ(statistics.mBytesOut, bytesSent);
+    EXPECT_EQ(optimizer.getBytesSaved(), bytesIn - bytesSent);
+    EXPECT_GT(statistics.mNullsDeleted, 1000);
+    EXPECT_EQ(statistics.mPIDsDropped, 0);
+    EXPECT_EQ(statistics.mRestoreErrors, 0);
+    // A quarter of the packets are nulls deleted
+    EXPECT_GT(optimizer.getBytesSaved(), bytesIn / 5);
+}
+
+TEST(TestRistTsOptimizer, DropPIDs) {
+    RISTNetTsOptimizer optimizer;
+    RISTNetTsOptimizer::RISTNetTsOptimizerSettings settings;
+    settings.mDropPIDs = {0x1FFF};
+    EXPECT_FALSE(optimizer.initOptimizer(settings));
+    settings.mDeleteNulls = false;
+    settings.mDropPIDs = {0x101};
+    ASSERT_TRUE(optimizer.initOptimizer(settings));
+
+    std::vector<uint8_t> payload(4 * 188);
+    writePacket(payload.data(), 0x100, 0x10, 1);
+    writePacket(payload.data() + 188, 0x101, 0x11, 2);
+    writePacket(payload.data() + 2 * 188, 0x1FFF, 0x10, 0xff);
+    writePacket(payload.data() + 3 * 188, 0x102, 0x12, 3);
+    std::vector<uint8_t> optimized;
+    ASSERT_TRUE(optimizer.optimize(payload.data(), payload.size(), optimized));
+    EXPECT_EQ(optimized.size(), 4 + 1 + 3 * 188);
+
+    // The blocked PID comes back as a null, the rest bit exact
+    std::vector<uint8_t> restored;
+    ASSERT_TRUE(optimizer.restore(optimized.data(), optimized.size(), restored));
+    std::vector<uint8_t> expected = payload;
+    writePacket(expected.data() + 188, 0x1FFF, 0x10, 0xff);
+    EXPECT_EQ(restored, expected);
+    RISTNetTsOptimizer::TsOptimizerStatistics statistics;
+    optimizer.getStatistics(statistics);
+    EXPECT_EQ(statistics.mPIDsDropped, 1);
+    EXPECT_EQ(statistics.mNullsDeleted, 0);
+}
+
+TEST(TestRistTsOptimizer, PassThroughAndInvalid) {
+    RISTNetTsOptimizer optimizer;
+    RISTNetTsOptimizer::RISTNetTsOptimizerSettings settings;
+    ASSERT_TRUE(optimizer.initOptimizer(settings));
+    std::vector<uint8_t> optimized;
+
+    // Not whole TS packets, no sync byte, nothing to delete
+    std::vector<uint8_t> payload(2 * 188);
+    writePacket(payload.data(), 0x1FFF, 0x10, 0xff);
+    writePacket(payload.data() + 188, 0x100, 0x10, 0);
+    EXPECT_FALSE(optimizer.optimize(payload.data(), 188 + 10, optimized));
+    payload[188] = 0x00;
+    EXPECT_FALSE(optimizer.optimize(payload.data(), payload.size(), optimized));
+    payload[188] = 0x47;
+    EXPECT_FALSE(optimizer.optimize(payload.data() + 188, 188, optimized));
+    EXPECT_EQ(optimizer.getBytesSaved(), 0);
+
+    // Sent as it is behind the raw header, a payload starting like an optimized one included
+    std::vector<uint8_t> restored;
+    ASSERT_EQ(optimized.size(), 188 + RISTNetTsOptimizer::kRawHeaderSize);
+    ASSERT_TRUE(optimizer.restore(optimized.data(), optimized.size(), restored));
+    EXPECT_EQ(restored, std::vector<uint8_t>(payload.begin() + 188, payload.end()));
+    std::vector<uint8_t> lookalike = {0xB7, 0x02, 0x10, 0xff, 0x03, 0x00};
+    EXPECT_FALSE(optimizer.optimize(lookalike.data(), lookalike.size(), optimized));
+    ASSERT_TRUE(optimizer.restore(optimized.data(), optimized.size(), restored));
+    EXPECT_EQ(restored, lookalike);
+
+    ASSERT_TRUE(optimizer.optimize(payload.data(), payload.size(), optimized));
+    EXPECT_FALSE(optimizer.restore(payload.data(), payload.size(), restored));
+    EXPECT_FALSE(optimizer.restore(optimized.data(), optimized.size() - 1, restored));
+    EXPECT_FALSE(optimizer.restore(optimized.data(), 1, restored));
+    optimized[4] = 0x03; // Both deleted, size does not match
+    EXPECT_FALSE(optimizer.restore(optimized.data(), optimized.size(), restored));
+    RISTNetTsOptimizer::TsOptimizerStatistics statistics;
+    optimizer.getStatistics(statistics);
+    EXPECT_EQ(statistics.mRestoreErrors, 4);
+    EXPECT_EQ(statistics.mRestored, 0);
+    EXPECT_EQ(statistics.mRawReceived, 2);
+}
+
+// Sender with mTsOptimize to receiver with mTsNullReinsertion, through two mock transports
+TEST(TestRistTsOptimizer, SenderToReceiver) {
+    RISTNetReceiver receiver;
+    receiver.validateConnectionCallback = [](const std::string& ipAddress, uint16_t port) {
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    std::vector<std::vector<uint8_t>> received;
+    receiver.networkDataBlockCallback = [&](const rist_data_block& rDataBlock,
+                                            std::shared_ptr<RISTNetReceiver::NetworkConnection>& rConnection) {
+        auto pPayload = (const uint8_t*)rDataBlock.payload;
+        received.emplace_back(pPayload, pPayload + rDataBlock.payload_len);
+        return 0;
+    };
+    RISTNetMockTransport receiverTransport;
+    RISTNetReceiver::RISTNetReceiverSettings receiverSettings;
+    receiverSettings.mTsNullReinsertion = true;
+    ASSERT_TRUE(receiverTransport.attachReceiver(receiver, receiverSettings));
+    rist_peer* peer = receiverTransport.connectPeer("10.0.0.1", 1000);
+    ASSERT_NE(peer, nullptr);
+
+    RISTNetSender sender;
+    RISTNetMockTransport senderTransport;
+    size_t bytesSent = 0;
+    senderTransport.dataWriteCallback = [&](const rist_data_block& rDataBlock) {
+        bytesSent += rDataBlock.payload_len;
+        receiverTransport.injectData(peer, (const uint8_t*)rDataBlock.payload, rDataBlock.payload_len);
+        return (int)rDataBlock.payload_len;
+    };
+    RISTNetSender::RISTNetSenderSettings senderSettings;
+    senderSettings.mTsOptimize = true;
+    ASSERT_TRUE(senderTransport.attachSender(sender, senderSettings));
+
+    // Not TS and starting like an optimized payload, sent as they are
+    auto stream = makeCbrStream(200);
+    stream.push_back({0xB7, 0x01, 0x10, 0xff, 0x01});
+    stream.push_back(std::vector<uint8_t>(188, 0xB7));
+    size_t bytesIn = 0;
+    for (auto& payload: stream) {
+        bytesIn += payload.size();
+        EXPECT_TRUE(sender.sendData(payload.data(), payload.size()));
+    }
+    EXPECT_EQ(received, stream);
+
+    // A payload without the header is dropped, never guessed
+    EXPECT_EQ(receiverTransport.injectData(peer, stream[0].data(), stream[0].size()), -1);
+    EXPECT_EQ(received.size(), stream.size());
+
+    RISTNetTsOptimizer::TsOptimizerStatistics statistics;
+    ASSERT_TRUE(sender.getTsStatistics(statistics));
+    EXPECT_EQ(statistics.mBytesIn - statistics.mBytesOut, bytesIn - bytesSent);
+    EXPECT_GT(bytesIn - bytesSent, 0);
+    ASSERT_TRUE(receiver.getTsStatistics(statistics));
+    EXPECT_GT(statistics.mRestored, 0);
+    EXPECT_GE(statistics.mRawReceived, 2);
+    EXPECT_EQ(statistics.mRestored + statistics.mRawReceived, stream.size());
+    EXPECT_EQ(statistics.mRestoreErrors, 1);
+    senderTransport.detach();
+    receiverTransport.detach();
+}
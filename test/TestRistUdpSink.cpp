@@ -0,0 +1,146 @@
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "RISTNetUdpSink.h"
+
+namespace {
+const uint16_t kFirstPort = 18700;
+
+// A blocking UDP socket on the loopback interface collecting what the sink sends
+class DatagramReceiver {
+public:
+    explicit DatagramReceiver(uint16_t port) {
+        mSocket = socket(AF_INET, SOCK_DGRAM, 0);
+        int bufferSize = 8 * 1024 * 1024;
+        setsockopt(mSocket, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+        timeval timeout = {0, 200000};
+        setsockopt(mSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+        bind(mSocket, (sockaddr*)&address, sizeof(address));
+    }
+    ~DatagramReceiver() { close(mSocket); }
+
+    std::vector<std::vector<uint8_t>> receive(size_t maxCount) {
+        std::vector<std::vector<uint8_t>> datagrams;
+        std::vector<uint8_t> buffer(65536);
+        while (datagrams.size() < maxCount) {
+            ssize_t size = recv(mSocket, buffer.data(), buffer.size(), 0);
+            if (size < 0) {
+                break;
+            }
+            datagrams.emplace_back(buffer.begin(), buffer.begin() + size);
+        }
+        return datagrams;
+    }
+
+private:
+    int mSocket;
+};
+
+std::vector<uint8_t> makePayload(uint32_t index, size_t size) {
+    std::vector<uint8_t> payload(size);
+    for (size_t i = 0; i < size; i++) {
+        payload[i] = (index * 3 + i) & 0xff;
+    }
+    return payload;
+}
+} // namespace
+
+TEST(TestRistUdpSink, Init) {
+    RISTNetUdpSink sink;
+    RISTNetUdpSink::RISTNetUdpSinkSettings settings;
+    EXPECT_FALSE(sink.initUdpSink(settings));
+    settings.mOutputs.push_back({"not an address", kFirstPort, "", RISTNetUdpSink::kAllFlows});
+    EXPECT_FALSE(sink.initUdpSink(settings));
+    auto payload = makePayload(0, 100);
+    EXPECT_FALSE(sink.sendData(payload.data(), payload.size()));
+    EXPECT_FALSE(sink.destroyUdpSink());
+}
+
+TEST(TestRistUdpSink, BatchedSend) {
+    for (bool gso : {false, true}) {
+        DatagramReceiver receiver(kFirstPort);
+        RISTNetUdpSink sink;
+        RISTNetUdpSink::RISTNetUdpSinkSettings settings;
+        settings.mOutputs.push_back({"127.0.0.1", kFirstPort, "", RISTNetUdpSink::kAllFlows});
+        settings.mBatchSize = 32;
+        settings.mUseGSO = gso;
+        settings.mTOS = 0xb8; // DSCP EF
+        ASSERT_TRUE(sink.initUdpSink(settings));
+
+        const uint32_t kPackets = 3200;
+        std::vector<std::vector<uint8_t>> expected;
+        for (uint32_t i = 0; i < kPackets; i++) {
+            // Mostly equally sized with a short one now and then, as a TS stream ending a burst
+            expected.push_back(makePayload(i, i % 100 == 99 ? 188 : 1316));
+            ASSERT_TRUE(sink.sendData(expected.back().data(), expected.back().size()));
+        }
+        EXPECT_TRUE(sink.destroyUdpSink());
+
+        auto received = receiver.receive(kPackets);
+        ASSERT_EQ(received.size(), kPackets) << "GSO " << gso;
+        EXPECT_EQ(received, expected) << "GSO " << gso;
+
+        RISTNetUdpSink::UdpSinkStatistics stats;
+        sink.getStatistics(stats);
+        EXPECT_EQ(stats.mPackets, kPackets);
+        EXPECT_EQ(stats.mSendErrors, 0);
+        // One sendto per packet before, now at least an order of magnitude less
+        EXPECT_LE(stats.mSyscalls * 10, kPackets) << "GSO " << gso;
+        if (!gso) {
+            EXPECT_FALSE(stats.mGSO);
+        }
+    }
+}
+
+TEST(TestRistUdpSink, FlushDeadline) {
+    DatagramReceiver receiver(kFirstPort + 1);
+    RISTNetUdpSink sink;
+    RISTNetUdpSink::RISTNetUdpSinkSettings settings;
+    settings.mOutputs.push_back({"127.0.0.1", kFirstPort + 1, "", RISTNetUdpSink::kAllFlows});
+    settings.mFlushDeadline = std::chrono::milliseconds(5);
+    ASSERT_TRUE(sink.initUdpSink(settings));
+
+    auto payload = makePayload(1, 1316);
+    for (int i = 0; i < 3; i++) {
+        ASSERT_TRUE(sink.sendData(payload.data(), payload.size()));
+    }
+    // Arrives without more data or a flush
+    auto start = std::chrono::steady_clock::now();
+    auto received = receiver.receive(3);
+    auto waited = std::chrono::steady_clock::now() - start;
+    EXPECT_EQ(received.size(), 3);
+    EXPECT_LT(waited, std::chrono::milliseconds(100));
+
+    RISTNetUdpSink::UdpSinkStatistics stats;
+    sink.getStatistics(stats);
+    EXPECT_EQ(stats.mDeadlineFlushes, 1);
+    EXPECT_TRUE(sink.destroyUdpSink());
+}
+
+TEST(TestRistUdpSink, PerFlowOutputs) {
+    DatagramReceiver receiverAll(kFirstPort + 2);
+    DatagramReceiver receiverFlow(kFirstPort + 3);
+    RISTNetUdpSink sink;
+    RISTNetUdpSink::RISTNetUdpSinkSettings settings;
+    settings.mOutputs.push_back({"127.0.0.1", kFirstPort + 2, "", RISTNetUdpSink::kAllFlows});
+    settings.mOutputs.push_back({"127.0.0.1", kFirstPort + 3, "", 7});
+    ASSERT_TRUE(sink.initUdpSink(settings));
+
+    for (uint32_t i = 0; i < 10; i++) {
+        auto payload = makePayload(i, 500);
+        ASSERT_TRUE(sink.sendData(payload.data(), payload.size(), i % 2 ? 7 : 8));
+    }
+    sink.flush();
+    EXPECT_EQ(receiverAll.receive(100).size(), 10);
+    auto flow = receiverFlow.receive(100);
+    ASSERT_EQ(flow.size(), 5);
+    EXPECT_EQ(flow[0], makePayload(1, 500));
+    EXPECT_TRUE(sink.destroyUdpSink());
+}
@@ -0,0 +1,187 @@
+#include <arpa/inet.h>
+#include <condition_variable>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "RISTNetUdpSource.h"
+
+namespace {
+const uint16_t kFirstPort = 18500;
+
+struct Datagram {
+    std::vector<uint8_t> mData;
+    uint16_t mConnectionID;
+};
+
+class DatagramCollector {
+public:
+    explicit DatagramCollector(RISTNetUdpSource& source) {
+        source.packetCallback = [&](const uint8_t* buf, size_t size, uint16_t connectionId) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mDatagrams.push_back({std::vector<uint8_t>(buf, buf + size), connectionId});
+            mCondition.notify_one();
+            return true;
+        };
+    }
+    std::vector<Datagram> waitFor(size_t count) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait_for(lock, std::chrono::seconds(5), [&]() { return mDatagrams.size() >= count; });
+        return mDatagrams;
+    }
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::vector<Datagram> mDatagrams;
+};
+
+void sendTo(const std::string& address, uint16_t port, const std::vector<uint8_t>& data) {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in destination = {};
+    destination.sin_family = AF_INET;
+    destination.sin_port = htons(port);
+    inet_pton(AF_INET, address.c_str(), &destination.sin_addr);
+    sendto(sock, data.data(), data.size(), 0, (sockaddr*)&destination, sizeof(destination));
+    close(sock);
+}
+
+std::vector<uint8_t> makePayload(uint32_t index, size_t size) {
+    std::vector<uint8_t> payload(size);
+    for (size_t i = 0; i < size; i++) {
+        payload[i] = (index * 7 + i) & 0xff;
+    }
+    return payload;
+}
+
+std::vector<uint8_t> makeRTP(const std::vector<uint8_t>& payload, uint8_t csrcCount, uint16_t extensionWords,
+                             uint8_t padding) {
+    std::vector<uint8_t> packet(12 + csrcCount * 4, 0);
+    packet[0] = 0x80 | csrcCount | (extensionWords ? 0x10 : 0) | (padding ? 0x20 : 0);
+    packet[1] = 33;
+    if (extensionWords) {
+        packet.insert(packet.end(), {0xbe, 0xde, (uint8_t)(extensionWords >> 8), (uint8_t)extensionWords});
+        packet.insert(packet.end(), extensionWords * 4, 0xee);
+    }
+    packet.insert(packet.end(), payload.begin(), payload.end());
+    if (padding) {
+        packet.insert(packet.end(), padding - 1, 0);
+        packet.push_back(padding);
+    }
+    return packet;
+}
+} // namespace
+
+TEST(TestRistUdpSource, Init) {
+    RISTNetUdpSource source;
+    RISTNetUdpSource::RISTNetUdpSourceSettings settings;
+    EXPECT_FALSE(source.initUdpSource(settings));
+    settings.mInputs.push_back({"not an address", kFirstPort, "", 1, false});
+    EXPECT_FALSE(source.initUdpSource(settings));
+    settings.mInputs[0].mAddress = "127.0.0.1";
+    ASSERT_TRUE(source.initUdpSource(settings));
+    EXPECT_FALSE(source.startUdpSource()) << "No packet callback";
+    EXPECT_TRUE(source.destroyUdpSource());
+    EXPECT_FALSE(source.destroyUdpSource());
+}
+
+TEST(TestRistUdpSource, FlowsAndBoundaries) {
+    RISTNetUdpSource source;
+    RISTNetUdpSource::RISTNetUdpSourceSettings settings;
+    settings.mBatchSize = 8;
+    settings.mInputs.push_back({"127.0.0.1", kFirstPort, "", 10, false});
+    settings.mInputs.push_back({"127.0.0.1", kFirstPort + 1, "", 20, false});
+    DatagramCollector collector(source);
+    ASSERT_TRUE(source.initUdpSource(settings));
+    ASSERT_TRUE(source.startUdpSource());
+
+    const uint32_t kDatagrams = 100;
+    for (uint32_t i = 0; i < kDatagrams; i++) {
+        sendTo("127.0.0.1", kFirstPort + (i & 1), makePayload(i, 100 + i * 13));
+    }
+    // Larger than RIST_MAX_PACKET_SIZE, dropped
+    sendTo("127.0.0.1", kFirstPort, makePayload(0, RIST_MAX_PACKET_SIZE + 1));
+    sendTo("127.0.0.1", kFirstPort, makePayload(kDatagrams, 100));
+
+    auto datagrams = collector.waitFor(kDatagrams + 1);
+    EXPECT_TRUE(source.destroyUdpSource());
+    ASSERT_EQ(datagrams.size(), kDatagrams + 1);
+
+    // Every datagram arrives whole, in order per flow
+    uint32_t next[2] = {0, 1};
+    for (auto& datagram : datagrams) {
+        ASSERT_TRUE(datagram.mConnectionID == 10 || datagram.mConnectionID == 20);
+        uint32_t& index = next[datagram.mConnectionID == 20];
+        if (index >= kDatagrams) {
+            EXPECT_EQ(datagram.mData, makePayload(kDatagrams, 100));
+            continue;
+        }
+        EXPECT_EQ(datagram.mData, makePayload(index, 100 + index * 13));
+        index += 2;
+    }
+
+    RISTNetUdpSource::UdpSourceStatistics stats;
+    source.getStatistics(stats);
+    EXPECT_EQ(stats.mPackets, kDatagrams + 1);
+    EXPECT_EQ(stats.mTruncated, 1);
+    EXPECT_GE(stats.mReceiveCalls, 2);
+    EXPECT_LE(stats.mReceiveCalls, stats.mPackets + stats.mTruncated);
+}
+
+TEST(TestRistUdpSource, StripRTP) {
+    RISTNetUdpSource source;
+    RISTNetUdpSource::RISTNetUdpSourceSettings settings;
+    settings.mInputs.push_back({"127.0.0.1", kFirstPort + 2, "", 5, true});
+    DatagramCollector collector(source);
+    ASSERT_TRUE(source.initUdpSource(settings));
+    ASSERT_TRUE(source.startUdpSource());
+
+    auto payload = makePayload(1, 7 * 188);
+    sendTo("127.0.0.1", kFirstPort + 2, makeRTP(payload, 0, 0, 0));
+    sendTo("127.0.0.1", kFirstPort + 2, makeRTP(payload, 2, 3, 4));
+    sendTo("127.0.0.1", kFirstPort + 2, payload); // Not RTP, dropped
+    sendTo("127.0.0.1", kFirstPort + 2, makeRTP(payload, 15, 0, 0));
+
+    auto datagrams = collector.waitFor(3);
+    EXPECT_TRUE(source.destroyUdpSource());
+    ASSERT_EQ(datagrams.size(), 3);
+    for (auto& datagram : datagrams) {
+        EXPECT_EQ(datagram.mData, payload);
+        EXPECT_EQ(datagram.mConnectionID, 5);
+    }
+    RISTNetUdpSource::UdpSourceStatistics stats;
+    source.getStatistics(stats);
+    EXPECT_EQ(stats.mInvalidRTP, 1);
+}
+
+TEST(TestRistUdpSource, Multicast) {
+    RISTNetUdpSource source;
+    RISTNetUdpSource::RISTNetUdpSourceSettings settings;
+    settings.mReusePort = true;
+    settings.mInputs.push_back({"239.255.18.1", kFirstPort + 3, "127.0.0.1", 1, false});
+    DatagramCollector collector(source);
+    if (!source.initUdpSource(settings)) {
+        GTEST_SKIP() << "Multicast on the loopback interface not available";
+    }
+    ASSERT_TRUE(source.startUdpSource());
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    in_addr interface = {};
+    inet_pton(AF_INET, "127.0.0.1", &interface);
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &interface, sizeof(interface));
+    sockaddr_in destination = {};
+    destination.sin_family = AF_INET;
+    destination.sin_port = htons(kFirstPort + 3);
+    inet_pton(AF_INET, "239.255.18.1", &destination.sin_addr);
+    auto payload = makePayload(3, 1316);
+    sendto(sock, payload.data(), payload.size(), 0, (sockaddr*)&destination, sizeof(destination));
+    close(sock);
+
+    auto datagrams = collector.waitFor(1);
+    EXPECT_TRUE(source.destroyUdpSource());
+    if (datagrams.empty()) {
+        GTEST_SKIP() << "Multicast not routed over the loopback interface";
+    }
+    EXPECT_EQ(datagrams[0].mData, payload);
+}
@@ -0,0 +1,166 @@
+//
+// rist_trace -- Record, inspect and replay RISTNet trace files
+//
+// rist_trace record <trace> <listen port>                      record until enter is pressed
+// rist_trace info <trace>                                      print the trace summary
+// rist_trace replay <trace> <ip> <port> [speed] [loop]         replay to a RIST receiver, speed 0 is as fast as possible
+// rist_trace bench <trace>                                     replay through a callback as fast as possible
+//
+
+#include <iostream>
+#include <map>
+#include <thread>
+#include "RISTNet.h"
+#include "RISTNetTrace.h"
+
+static int usage() {
+    std::cout << "rist_trace record <trace> <listen port>" << std::endl;
+    std::cout << "rist_trace info <trace>" << std::endl;
+    std::cout << "rist_trace replay <trace> <ip> <port> [speed] [loop]" << std::endl;
+    std::cout << "rist_trace bench <trace>" << std::endl;
+    return EXIT_FAILURE;
+}
+
+static int recordTrace(const std::string &rPath, const std::string &rPort) {
+    RISTNetReceiver myRISTNetReceiver;
+    myRISTNetReceiver.validateConnectionCallback = [](const std::string &ipAddress, uint16_t port) {
+        std::cout << "Connecting IP: " << ipAddress << ":" << unsigned(port) << std::endl;
+        return std::make_shared<RISTNetReceiver::NetworkConnection>();
+    };
+    myRISTNetReceiver.networkDataCallback = [](const uint8_t *buf, size_t len,
+                                               std::shared_ptr<RISTNetReceiver::NetworkConnection> &connection,
+                                               rist_peer *pPeer, uint16_t connectionID) {
+        return 0;
+    };
+
+    RISTNetTraceRecorder myRecorder;
+    RISTNetTraceRecorder::RISTNetTraceRecorderSettings myRecorderConfiguration;
+    myRecorderConfiguration.mPath = rPath;
+    if (!myRecorder.initRecorder(myRecorderConfiguration) || !myRecorder.attachReceiver(myRISTNetReceiver)) {
+        std::cout << "Failed creating " << rPath << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string lURL;
+    std::vector<std::string> interfaceListReceiver;
+    if (!RISTNetTools::buildRISTURL("0.0.0.0", rPort, lURL, true)) {
+        return usage();
+    }
+    interfaceListReceiver.push_back(lURL);
+    RISTNetReceiver::RISTNetReceiverSettings myReceiveConfiguration;
+    myReceiveConfiguration.mLogLevel = RIST_LOG_WARN;
+    if (!myRISTNetReceiver.initReceiver(interfaceListReceiver, myReceiveConfiguration)) {
+        std::cout << "Failed starting the receiver" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Recording to " << rPath << ", press enter to stop" << std::endl;
+    std::cin.get();
+    myRISTNetReceiver.destroyReceiver();
+    myRecorder.destroyRecorder();
+
+    RISTNetTraceRecorder::TraceRecorderStatistics stats;
+    myRecorder.getStatistics(stats);
+    std::cout << "Packets: " << stats.mPackets << ", bytes: " << stats.mBytes << ", dropped: "
+              << stats.mDroppedPackets << ", write errors: " << stats.mWriteErrors << std::endl;
+    return EXIT_SUCCESS;
+}
+
+static int traceInfo(RISTNetTracePlayer &rPlayer) {
+    std::map<uint32_t, uint64_t> flows;
+    std::map<uint64_t, uint64_t> peers;
+    uint64_t bytes = 0;
+    uint64_t discontinuities = 0;
+    rPlayer.packetCallback = [&](const RISTNetTraceRecord &rRecord, const uint8_t *pPayload) {
+        flows[rRecord.mFlowID]++;
+        peers[rRecord.mPeer]++;
+        bytes += rRecord.mPayloadSize;
+        discontinuities += (rRecord.mFlags & RIST_DATA_FLAGS_DISCONTINUITY) != 0;
+        return 0;
+    };
+    rPlayer.replayAll();
+    std::cout << "Start: " << rPlayer.getHeader().mStartTime << " ns since the epoch" << std::endl;
+    std::cout << "Duration: " << rPlayer.getDuration().count() / 1000000 << " ms" << std::endl;
+    std::cout << "Packets: " << rPlayer.getPackets() << ", bytes: " << bytes << ", discontinuities: "
+              << discontinuities << ", peers: " << peers.size() << std::endl;
+    for (auto &rFlow: flows) {
+        std::cout << "Flow " << rFlow.first << ": " << rFlow.second << " packets" << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
+
+static int replayTrace(RISTNetTracePlayer &rPlayer, const std::string &rIP, const std::string &rPort) {
+    std::string lURL;
+    std::vector<std::tuple<std::string, int>> interfaceListSender;
+    if (!RISTNetTools::resolveRISTURL(rIP, rPort, lURL, false)) {
+        return usage();
+    }
+    interfaceListSender.push_back(std::tuple<std::string, int>(lURL, 5));
+    RISTNetSender myRISTNetSender;
+    RISTNetSender::RISTNetSenderSettings mySendConfiguration;
+    mySendConfiguration.mLogLevel = RIST_LOG_WARN;
+    if (!myRISTNetSender.initSender(interfaceListSender, mySendConfiguration)) {
+        std::cout << "initSender fail" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!rPlayer.startReplay(myRISTNetSender)) {
+        return EXIT_FAILURE;
+    }
+    while (rPlayer.isReplaying()) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        RISTNetTracePlayer::TracePlayerStatistics stats;
+        rPlayer.getStatistics(stats);
+        std::cout << "Packets sent: " << stats.mPacketsSent << ", failed: " << stats.mPacketsFailed << ", late: "
+                  << stats.mPacketsLate << ", max lateness: " << stats.mMaxLateness.count() << " us" << std::endl;
+    }
+    rPlayer.stopReplay();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    return EXIT_SUCCESS;
+}
+
+static int benchTrace(RISTNetTracePlayer &rPlayer) {
+    uint64_t bytes = 0;
+    rPlayer.packetCallback = [&](const RISTNetTraceRecord &rRecord, const uint8_t *pPayload) {
+        bytes += rRecord.mPayloadSize;
+        return 0;
+    };
+    auto start = std::chrono::steady_clock::now();
+    uint64_t packets = rPlayer.replayAll();
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Replayed " << packets << " packets, " << bytes << " bytes in " << elapsed * 1000.0 << " ms, "
+              << (elapsed > 0 ? packets / elapsed : 0) << " packets/s" << std::endl;
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        return usage();
+    }
+    std::string command = argv[1];
+    if (command == "record") {
+        return argc < 4 ? usage() : recordTrace(argv[2], argv[3]);
+    }
+
+    RISTNetTracePlayer myPlayer;
+    RISTNetTracePlayer::RISTNetTracePlayerSettings myPlayerConfiguration;
+    if (command == "replay") {
+        if (argc < 5) {
+            return usage();
+        }
+        myPlayerConfiguration.mSpeed = argc > 5 ? std::stod(argv[5]) : 1.0;
+        myPlayerConfiguration.mLoop = argc > 6 && std::string(argv[6]) == "loop";
+    }
+    if (!myPlayer.openTrace(argv[2], myPlayerConfiguration)) {
+        std::cout << "Failed opening " << argv[2] << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (command == "info") {
+        return traceInfo(myPlayer);
+    }
+    if (command == "replay") {
+        return replayTrace(myPlayer, argv[3], argv[4]);
+    }
+    if (command == "bench") {
+        return benchTrace(myPlayer);
+    }
+    return usage();
+}